@@ -1,10 +1,15 @@
 #pragma once
 
+#include <mpi.h>
 #include <particle_structure.hpp>
+#include <psAssert.h>
+#include <Kokkos_UnorderedMap.hpp>
+#include <vector>
 namespace particle_structs {
   template <class DataTypes, typename MemSpace = DefaultMemSpace>
   class CSR : public ParticleStructure<DataTypes, MemSpace> {
   public:
+    using typename ParticleStructure<DataTypes, MemSpace>::Types;
     using typename ParticleStructure<DataTypes, MemSpace>::execution_space;
     using typename ParticleStructure<DataTypes, MemSpace>::memory_space;
     using typename ParticleStructure<DataTypes, MemSpace>::device_type;
@@ -13,14 +18,25 @@ namespace particle_structs {
     using typename ParticleStructure<DataTypes, MemSpace>::kkLidHostMirror;
     using typename ParticleStructure<DataTypes, MemSpace>::kkGidHostMirror;
     using typename ParticleStructure<DataTypes, MemSpace>::MTVs;
+    typedef Kokkos::TeamPolicy<execution_space> PolicyType;
+    typedef Kokkos::UnorderedMap<gid_t, lid_t, device_type> GID_Mapping;
 
     CSR() = delete;
     CSR(const CSR&) = delete;
     CSR& operator=(const CSR&) = delete;
 
+    /* Constructor of CSR as particle structure
+       num_elements - the number of elements in the mesh
+       num_particles - the number of particles needed
+       particles_per_element - the number of particles in each element
+       element_gids - (for MPI parallelism) global ids for each element (size 0 is ignored)
+       particle_elements - parent element for each particle (optional)
+       particle_info - Initial values for the particle information (optional)
+       comm - communicator of the processes particles migrate between (optional)
+    */
     CSR(lid_t num_elements, lid_t num_particles, kkLidView particles_per_element,
         kkGidView element_gids, kkLidView particle_elements = kkLidView(),
-        MTVs particle_info = NULL);
+        MTVs particle_info = NULL, MPI_Comm comm = MPI_COMM_WORLD);
     ~CSR();
 
     //Functions from ParticleStructure
@@ -29,19 +45,44 @@ namespace particle_structs {
     using ParticleStructure<DataTypes, MemSpace>::capacity;
     using ParticleStructure<DataTypes, MemSpace>::numRows;
 
-
+    /* Migrates each particle to new_process and to new_element
+       Calls rebuild to recreate the CSR after migrating particles
+       new_element - array sized csr->capacity with the new element for each particle
+       new_process - array sized csr->capacity with the new process for each particle
+    */
     void migrate(kkLidView new_element, kkLidView new_process,
                  kkLidView new_particle_elements = kkLidView(),
                  MTVs new_particle_info = NULL);
 
+    /* Rebuilds the CSR with a counting sort where particles move to new_element[i]
+       new_element - array sized csr->capacity with the new element for each particle
+                     (-1 removes the particle)
+         Optional arguments when adding new particles to the structure
+         new_particle_elements - the new element for each new particle
+         new_particles - the data for the new particles
+    */
     void rebuild(kkLidView new_element, kkLidView new_particle_elements = kkLidView(),
                  MTVs new_particles = NULL);
 
+    /* Performs a parallel for over the elements/particles in the CSR
+       The passed in functor/lambda should take in 3 arguments (int elm_id, int ptcl_id, bool mask)
+       There is no padding in the CSR so mask is always true
+    */
     template <typename FunctionType>
     void parallel_for(FunctionType& fn, std::string s="");
+    //Performs the parallel for over the particles of the elements in the device list elements
+    template <typename FunctionType>
+    void parallel_for(kkLidView elements, FunctionType& fn, std::string s="");
 
     void printMetrics() const;
 
+    MPI_Comm comm() const {return mpi_comm;}
+
+    //Do not call these functions:
+    void constructOffsets(kkLidView ptcls_per_elem, kkLidView& offs, lid_t& cap);
+    void createGlobalMapping(kkGidView elmGid, kkGidView& elm2Gid, GID_Mapping& elmGid2Lid);
+    void initCSRData(kkLidView particle_elements, MTVs particle_info);
+
   private:
     //Variables from ParticleStructure
     using ParticleStructure<DataTypes, MemSpace>::num_elems;
@@ -53,45 +94,416 @@ namespace particle_structs {
 
     //Offsets array into CSR
     kkLidView offsets;
+
+    //mappings from element to element gid and back
+    kkGidView element_to_gid;
+    GID_Mapping element_gid_to_lid;
+
+    //Metric Info
+    lid_t num_empty_elements;
+
+    MPI_Comm mpi_comm;
   };
 
+  template <class DataTypes, typename MemSpace>
+  void CSR<DataTypes, MemSpace>::constructOffsets(kkLidView ptcls_per_elem, kkLidView& offs,
+                                                  lid_t& cap) {
+    offs = kkLidView("csr_offsets", num_elems + 1);
+    Kokkos::parallel_scan("csr_offsets", num_elems,
+                          KOKKOS_LAMBDA(const lid_t& i, lid_t& sum, const bool& final) {
+        sum += ptcls_per_elem(i);
+        if (final)
+          offs(i+1) = sum;
+      });
+    cap = getLastValue<lid_t>(offs);
+  }
+
+  template <class DataTypes, typename MemSpace>
+  void CSR<DataTypes, MemSpace>::createGlobalMapping(kkGidView elmGid, kkGidView& elm2Gid,
+                                                     GID_Mapping& elmGid2Lid) {
+    elm2Gid = kkGidView("element to element gid", num_elems);
+    Kokkos::parallel_for("csr_global_mapping", num_elems, KOKKOS_LAMBDA(const lid_t& i) {
+        const gid_t gid = elmGid(i);
+        elm2Gid(i) = gid;
+        elmGid2Lid.insert(gid, i);
+      });
+  }
+
+  template <class DataTypes, typename MemSpace>
+  void CSR<DataTypes, MemSpace>::initCSRData(kkLidView particle_elements,
+                                             MTVs particle_info) {
+    lid_t given_particles = particle_elements.size();
+    //Setup starting point for each element
+    kkLidView elem_index("elem_index", num_elems + 1);
+    Kokkos::deep_copy(elem_index, offsets);
+    //Determine index for each particle
+    kkLidView particle_indices("new_particle_csr_indices", given_particles);
+    Kokkos::parallel_for("csr_init_indices", given_particles, KOKKOS_LAMBDA(const lid_t& i) {
+        const lid_t elm = particle_elements(i);
+        particle_indices(i) = Kokkos::atomic_fetch_add(&elem_index(elm), 1);
+      });
+
+    CopyViewsToViews<kkLidView, DataTypes>(ptcl_data, particle_info, particle_indices);
+  }
+
   template <class DataTypes, typename MemSpace>
   CSR<DataTypes, MemSpace>::CSR(lid_t num_elements, lid_t num_particles,
                                 kkLidView particles_per_element,
                                 kkGidView element_gids,
                                 kkLidView particle_elements,
-                                MTVs particle_info) {
-    fprintf(stderr, "[WARNING] CSR constructor not implemented\n");
+                                MTVs particle_info, MPI_Comm comm) :
+    ParticleStructure<DataTypes, MemSpace>(), element_gid_to_lid(num_elements),
+    mpi_comm(comm) {
+    Kokkos::Profiling::pushRegion("csr_construction");
+    num_elems = num_elements;
+    num_rows = num_elems;
+    num_ptcls = num_particles;
+
+    constructOffsets(particles_per_element, offsets, capacity_);
+    PS_ALWAYS_ASSERT(capacity_ == num_ptcls);
+
+    kkLidView empty("empty_elements", 1);
+    Kokkos::parallel_for("csr_count_empty", num_elems, KOKKOS_LAMBDA(const lid_t& i) {
+        Kokkos::atomic_fetch_add(&empty(0), particles_per_element(i) == 0);
+      });
+    num_empty_elements = getLastValue<lid_t>(empty);
+
+    if (element_gids.size() > 0)
+      createGlobalMapping(element_gids, element_to_gid, element_gid_to_lid);
+
+    CreateViews<device_type, DataTypes>(ptcl_data, capacity_, "csr_particle_data");
+
+    //If particle info is provided then enter the information
+    lid_t given_particles = particle_elements.size();
+    if (given_particles > 0 && particle_info != NULL)
+      initCSRData(particle_elements, particle_info);
+    Kokkos::Profiling::popRegion();
   }
 
   template <class DataTypes, typename MemSpace>
   CSR<DataTypes, MemSpace>::~CSR() {
-    fprintf(stderr, "[WARNING] CSR deconstructor not implemented\n");
+    destroyViews<DataTypes, memory_space>(ptcl_data);
   }
 
   template <class DataTypes, typename MemSpace>
   void CSR<DataTypes, MemSpace>::migrate(kkLidView new_element, kkLidView new_process,
-               kkLidView new_particle_elements,
-               MTVs new_particle_info) {
-    fprintf(stderr, "[WARNING] CSR migrate(...) not implemented\n");
+                                         kkLidView new_particle_elements,
+                                         MTVs new_particle_info) {
+    Kokkos::Profiling::pushRegion("csr_migrate");
+    /********* Send # of particles being sent to each process *********/
+    int comm_size;
+    MPI_Comm_size(mpi_comm, &comm_size);
+    int comm_rank;
+    MPI_Comm_rank(mpi_comm, &comm_rank);
+
+    if (comm_size == 1) {
+      rebuild(new_element, new_particle_elements, new_particle_info);
+      Kokkos::Profiling::popRegion();
+      return;
+    }
+    //Process of each particle that leaves (-1 if it stays)
+    kkLidView send_rank("csr_send_rank", capacity());
+    kkLidView num_send_particles("num_send_particles", comm_size);
+    auto count_sending_particles = PS_LAMBDA(lid_t element_id, lid_t particle_id, bool mask) {
+      const lid_t process = new_process(particle_id);
+      const bool sent = mask && process != comm_rank;
+      send_rank(particle_id) = sent ? process : -1;
+      if (sent)
+        Kokkos::atomic_fetch_add(&(num_send_particles(process)), 1);
+    };
+    parallel_for(count_sending_particles, "count_sending_particles");
+    kkLidView num_recv_particles("num_recv_particles", comm_size);
+    Kokkos::fence();
+    PS_Comm_Alltoall(num_send_particles, 1, num_recv_particles, 1, mpi_comm);
+
+    lid_t num_sending_to = 0, num_receiving_from = 0;
+    Kokkos::parallel_reduce("sum_senders", comm_size, KOKKOS_LAMBDA (const lid_t& i, lid_t& lsum ) {
+        lsum += (num_send_particles(i) > 0);
+      }, num_sending_to);
+    Kokkos::parallel_reduce("sum_receivers", comm_size, KOKKOS_LAMBDA (const lid_t& i, lid_t& lsum ) {
+        lsum += (num_recv_particles(i) > 0);
+      }, num_receiving_from);
+
+    if (num_sending_to == 0 && num_receiving_from == 0) {
+      rebuild(new_element, new_particle_elements, new_particle_info);
+      Kokkos::Profiling::popRegion();
+      return;
+    }
+    /********** Send particle information to new processes **********/
+    //Perform an ex-sum on num_send_particles & num_recv_particles
+    kkLidView offset_send_particles("offset_send_particles", comm_size+1);
+    kkLidView offset_send_particles_temp("offset_send_particles_temp", comm_size + 1);
+    kkLidView offset_recv_particles("offset_recv_particles", comm_size+1);
+    Kokkos::parallel_scan("csr_offset_send", comm_size, KOKKOS_LAMBDA(const lid_t& i, lid_t& num, const bool& final) {
+        num += num_send_particles(i);
+        if (final) {
+          offset_send_particles(i+1) += num;
+          offset_send_particles_temp(i+1) += num;
+        }
+      });
+    Kokkos::parallel_scan("csr_offset_recv", comm_size, KOKKOS_LAMBDA(const lid_t& i, lid_t& num, const bool& final) {
+        num += num_recv_particles(i);
+        if (final)
+          offset_recv_particles(i+1) += num;
+      });
+    kkLidHostMirror offset_send_particles_host = deviceToHost(offset_send_particles);
+    kkLidHostMirror offset_recv_particles_host = deviceToHost(offset_recv_particles);
+    lid_t np_recv = offset_recv_particles_host(comm_size);
+
+    /* One message per process in the packed layout of SellCSigma::migrate
+         [element gid of n particles][T0 of n particles]...[Tn of n particles]
+    */
+    typedef Kokkos::View<char*, device_type> ByteView;
+    typedef Kokkos::View<std::size_t*, device_type> SizeView;
+    std::vector<std::size_t> send_bytes(comm_size + 1, 0), recv_bytes(comm_size + 1, 0);
+    for (int i = 0; i < comm_size; ++i) {
+      lid_t n = offset_send_particles_host(i+1) - offset_send_particles_host(i);
+      send_bytes[i+1] = send_bytes[i] + packedGidBytes(n, false) +
+        PackedBytes<DataTypes>::bytes(n);
+      n = offset_recv_particles_host(i+1) - offset_recv_particles_host(i);
+      recv_bytes[i+1] = recv_bytes[i] + packedGidBytes(n, false) +
+        PackedBytes<DataTypes>::bytes(n);
+    }
+    ByteView send_buffer("csr_migrate_send_buffer", send_bytes[comm_size]);
+    ByteView recv_buffer("csr_migrate_recv_buffer", recv_bytes[comm_size]);
+    SizeView send_type_offsets("csr_migrate_send_type_offsets", comm_size);
+    SizeView recv_type_offsets("csr_migrate_recv_type_offsets", comm_size);
+    hostToDevice(send_type_offsets, send_bytes.data());
+    hostToDevice(recv_type_offsets, recv_bytes.data());
+
+    //Post the receives before packing
+    std::vector<MPI_Request> send_requests, recv_requests;
+    send_requests.reserve(num_sending_to);
+    recv_requests.reserve(num_receiving_from);
+    for (int i = 0; i < comm_size; ++i) {
+      if (i == comm_rank || recv_bytes[i+1] == recv_bytes[i])
+        continue;
+      recv_requests.push_back(MPI_REQUEST_NULL);
+      PS_Comm_Irecv(recv_buffer, recv_bytes[i], recv_bytes[i+1] - recv_bytes[i], i, 0,
+                    mpi_comm, &recv_requests.back());
+    }
+
+    //Pack the element gid of each sent particle followed by the data types
+    kkLidView send_index("send_particle_index", capacity());
+    auto element_to_gid_local = element_to_gid;
+    auto gatherParticlesToSend = PS_LAMBDA(lid_t element_id, lid_t particle_id, lid_t mask) {
+      const lid_t process = send_rank(particle_id);
+      if (process >= 0) {
+        const lid_t index = Kokkos::atomic_fetch_add(&(offset_send_particles_temp(process)),1);
+        send_index(particle_id) = index;
+        gid_t* gids = reinterpret_cast<gid_t*>(send_buffer.data() + send_type_offsets(process));
+        gids[index - offset_send_particles(process)] =
+          element_to_gid_local(new_element(particle_id));
+      }
+    };
+    parallel_for(gatherParticlesToSend, "gatherParticlesToSend");
+    Kokkos::parallel_for("csr_gid_offsets", comm_size, KOKKOS_LAMBDA(const lid_t& i) {
+        send_type_offsets(i) += packedGidBytes(num_send_particles(i), false);
+      });
+    PackParticles<CSR<DataTypes, MemSpace>, DataTypes>(this, ptcl_data, send_rank, send_index,
+                                                       offset_send_particles,
+                                                       num_send_particles, send_type_offsets,
+                                                       send_buffer);
+    Kokkos::fence();
+    for (int i = 0; i < comm_size; ++i) {
+      if (i == comm_rank || send_bytes[i+1] == send_bytes[i])
+        continue;
+      send_requests.push_back(MPI_REQUEST_NULL);
+      PS_Comm_Isend(send_buffer, send_bytes[i], send_bytes[i+1] - send_bytes[i], i, 0,
+                    mpi_comm, &send_requests.back());
+    }
+    PS_Comm_Waitall<device_type>(recv_requests.size(), recv_requests.data(),
+                                 MPI_STATUSES_IGNORE);
+
+    /********** Unpack the received element gids as element lids and the data types *********/
+    lid_t new_ptcls = new_particle_elements.size();
+    kkLidView recv_element("recv_element", np_recv + new_ptcls);
+    MTVs recv_particle;
+    CreateViews<device_type, DataTypes>(recv_particle, np_recv + new_ptcls, "csr_migrate_recv");
+    auto element_gid_to_lid_local = element_gid_to_lid;
+    Kokkos::parallel_for("csr_gid_to_lid", np_recv, KOKKOS_LAMBDA(const lid_t& i) {
+        const int segment = segmentOf(offset_recv_particles, comm_size, i);
+        const gid_t* gids = reinterpret_cast<const gid_t*>(recv_buffer.data() +
+                                                           recv_type_offsets(segment));
+        const gid_t gid = gids[i - offset_recv_particles(segment)];
+        const lid_t index = element_gid_to_lid_local.find(gid);
+        recv_element(i) = element_gid_to_lid_local.value_at(index);
+      });
+    Kokkos::parallel_for("csr_gid_offsets", comm_size, KOKKOS_LAMBDA(const lid_t& i) {
+        recv_type_offsets(i) += packedGidBytes(num_recv_particles(i), false);
+      });
+    UnpackViews<device_type, DataTypes>(recv_particle, np_recv, offset_recv_particles,
+                                        comm_size, recv_type_offsets, recv_buffer);
+
+    /********** Set particles that were sent to non existent on this process *********/
+    auto removeSentParticles = PS_LAMBDA(lid_t element_id, lid_t particle_id, lid_t mask) {
+      const bool sent = send_rank(particle_id) >= 0;
+      const lid_t elm = new_element(particle_id);
+      //Subtract (its value + 1) to get to -1 if it was sent, 0 otherwise
+      new_element(particle_id) -= (elm + 1) * sent;
+    };
+    parallel_for(removeSentParticles, "removeSentParticles");
+
+    /********** Add new particles to the migrated particles *********/
+    kkLidView new_ptcl_map("new_ptcl_map", new_ptcls);
+    Kokkos::parallel_for("csr_add_new_particles", new_ptcls, KOKKOS_LAMBDA(const lid_t& i) {
+        recv_element(np_recv + i) = new_particle_elements(i);
+        new_ptcl_map(i) = np_recv + i;
+    });
+    if (new_ptcls > 0)
+      CopyViewsToViews<kkLidView, DataTypes>(recv_particle, new_particle_info, new_ptcl_map);
+
+    /********** Combine and shift particles to their new destination **********/
+    rebuild(new_element, recv_element, recv_particle);
+
+    //Cleanup
+    PS_Comm_Waitall<device_type>(send_requests.size(), send_requests.data(),
+                                 MPI_STATUSES_IGNORE);
+    destroyViews<DataTypes, memory_space>(recv_particle);
+    Kokkos::Profiling::popRegion();
   }
 
   template <class DataTypes, typename MemSpace>
   void CSR<DataTypes, MemSpace>::rebuild(kkLidView new_element,
                                          kkLidView new_particle_elements,
                                          MTVs new_particles) {
-    fprintf(stderr, "[WARNING] CSR rebuild(...) not implemented\n");
+    Kokkos::Profiling::pushRegion("csr_rebuild");
+    //Count the particles in each element after the move
+    kkLidView new_particles_per_elem("new_particles_per_elem", num_elems);
+    auto countNewParticles = PS_LAMBDA(lid_t element_id, lid_t particle_id, bool mask) {
+      const lid_t new_elem = new_element(particle_id);
+      if (new_elem != -1)
+        Kokkos::atomic_fetch_add(&(new_particles_per_elem(new_elem)), mask);
+    };
+    parallel_for(countNewParticles, "countNewParticles");
+    lid_t num_new_ptcls = new_particle_elements.size();
+    Kokkos::parallel_for("csr_rebuild_count", num_new_ptcls, KOKKOS_LAMBDA(const lid_t& i) {
+        const lid_t new_elem = new_particle_elements(i);
+        Kokkos::atomic_fetch_add(&(new_particles_per_elem(new_elem)), 1);
+      });
+
+    //Offsets of the new structure
+    kkLidView new_offsets;
+    lid_t new_capacity;
+    constructOffsets(new_particles_per_elem, new_offsets, new_capacity);
+
+    kkLidView empty("empty_elements", 1);
+    Kokkos::parallel_for("csr_count_empty", num_elems, KOKKOS_LAMBDA(const lid_t& i) {
+        Kokkos::atomic_fetch_add(&empty(0), new_particles_per_elem(i) == 0);
+      });
+    num_empty_elements = getLastValue<lid_t>(empty);
+
+    //Counting sort of existing particles into the new layout
+    kkLidView elem_index("elem_index", num_elems + 1);
+    Kokkos::deep_copy(elem_index, new_offsets);
+    kkLidView new_indices("new_csr_index", capacity());
+    auto assignIndices = PS_LAMBDA(lid_t element_id, lid_t particle_id, bool mask) {
+      const lid_t new_elem = new_element(particle_id);
+      if (mask && new_elem != -1)
+        new_indices(particle_id) = Kokkos::atomic_fetch_add(&elem_index(new_elem), 1);
+    };
+    parallel_for(assignIndices, "assignIndices");
+
+    MTVs new_ptcl_data;
+    CreateViews<device_type, DataTypes>(new_ptcl_data, new_capacity, "csr_particle_data");
+    CopyPSToPS<CSR<DataTypes, MemSpace>, DataTypes>(this, new_ptcl_data, ptcl_data,
+                                                    new_element, new_indices);
+
+    //Add new particles
+    kkLidView new_particle_indices("new_particle_csr_indices", num_new_ptcls);
+    Kokkos::parallel_for("csr_set_new_particle", num_new_ptcls, KOKKOS_LAMBDA(const lid_t& i) {
+        const lid_t new_elem = new_particle_elements(i);
+        new_particle_indices(i) = Kokkos::atomic_fetch_add(&elem_index(new_elem), 1);
+      });
+    if (num_new_ptcls > 0)
+      CopyViewsToViews<kkLidView, DataTypes>(new_ptcl_data, new_particles, new_particle_indices);
+
+    //Set csr to point to new values
+    destroyViews<DataTypes, memory_space>(ptcl_data);
+    ptcl_data = new_ptcl_data;
+    offsets = new_offsets;
+    num_ptcls = new_capacity;
+    capacity_ = new_capacity;
+    Kokkos::Profiling::popRegion();
   }
 
   template <class DataTypes, typename MemSpace>
   template <typename FunctionType>
-  void CSR<DataTypes, MemSpace>::parallel_for(FunctionType& fn, std::string s) {
-    fprintf(stderr, "[WARNING] CSR parallel_for(...) not implemented\n");
+  void CSR<DataTypes, MemSpace>::parallel_for(FunctionType& fn, std::string name) {
+    if (num_elems == 0)
+      return;
+    FunctionType* fn_d;
+#ifdef PS_USE_CUDA
+    cudaMalloc(&fn_d, sizeof(FunctionType));
+    cudaMemcpy(fn_d,&fn, sizeof(FunctionType), cudaMemcpyHostToDevice);
+#else
+    fn_d = &fn;
+#endif
+    const PolicyType policy(num_elems, Kokkos::AUTO);
+    auto offsets_cpy = offsets;
+    Kokkos::parallel_for(name, policy,
+                         KOKKOS_LAMBDA(const typename PolicyType::member_type& thread) {
+      const lid_t element_id = thread.league_rank();
+      const lid_t start = offsets_cpy(element_id);
+      const lid_t end = offsets_cpy(element_id+1);
+      Kokkos::parallel_for(Kokkos::TeamThreadRange(thread, start, end), [&] (const lid_t& p) {
+        const lid_t mask = 1;
+        (*fn_d)(element_id, p, mask);
+      });
+    });
+#ifdef PS_USE_CUDA
+    cudaFree(fn_d);
+#endif
+  }
 
+  template <class DataTypes, typename MemSpace>
+  template <typename FunctionType>
+  void CSR<DataTypes, MemSpace>::parallel_for(kkLidView elements, FunctionType& fn,
+                                              std::string name) {
+    const lid_t num_subset = elements.extent(0);
+    if (num_subset == 0)
+      return;
+    FunctionType* fn_d;
+#ifdef PS_USE_CUDA
+    cudaMalloc(&fn_d, sizeof(FunctionType));
+    cudaMemcpy(fn_d,&fn, sizeof(FunctionType), cudaMemcpyHostToDevice);
+#else
+    fn_d = &fn;
+#endif
+    const PolicyType policy(num_subset, Kokkos::AUTO);
+    auto offsets_cpy = offsets;
+    Kokkos::parallel_for(name, policy,
+                         KOKKOS_LAMBDA(const typename PolicyType::member_type& thread) {
+      const lid_t element_id = elements(thread.league_rank());
+      const lid_t start = offsets_cpy(element_id);
+      const lid_t end = offsets_cpy(element_id+1);
+      Kokkos::parallel_for(Kokkos::TeamThreadRange(thread, start, end), [&] (const lid_t& p) {
+        const lid_t mask = 1;
+        (*fn_d)(element_id, p, mask);
+      });
+    });
+#ifdef PS_USE_CUDA
+    cudaFree(fn_d);
+#endif
   }
 
   template <class DataTypes, typename MemSpace>
   void CSR<DataTypes, MemSpace>::printMetrics() const {
-    fprintf(stderr, "[WARNING] CSR printMetrics() not implemented\n");
+    int comm_rank;
+    MPI_Comm_rank(mpi_comm, &comm_rank);
+    char buffer[1000];
+    char* ptr = buffer;
+
+    //Header
+    ptr += sprintf(ptr, "Metrics %d, CSR\n", comm_rank);
+    //Sizes
+    ptr += sprintf(ptr, "Nelems %d, Nptcls %d, Capacity %d, Allocation %d\n",
+                   nElems(), nPtcls(), capacity(), capacity());
+    //Empty Elements
+    ptr += sprintf(ptr, "Empty Elements <Tot %%> %d %.3f\n", num_empty_elements,
+                   num_elems > 0 ? num_empty_elements * 100.0 / num_elems : 0.0);
+
+    printf("%s\n", buffer);
+    printMemoryUsage(stdout);
   }
 }
@@ -5,3 +5,4 @@
 #include <SellCSigma.h>
 #include <csr/CSR.hpp>
 #include "ps_for.hpp"
+#include "ps_species.hpp"
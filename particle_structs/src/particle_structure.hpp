@@ -3,6 +3,7 @@
 #include <PS_Types.h>
 #include <Segment.h>
 #include <MemberTypeLibraries.h>
+#include <MemberTypeAoSoA.h>
 
 namespace particle_structs {
 
@@ -27,6 +28,27 @@ namespace particle_structs {
     lid_t nPtcls() const {return num_ptcls;}
     lid_t capacity() const {return capacity_;}
     lid_t numRows() const {return num_rows;}
+    /* Counter changed whenever the storage or the launch sizes of the structure change
+         Kernels recorded into a graph (see KernelGraph) are only valid for the version they
+         were recorded with.
+    */
+    std::size_t layoutVersion() const {return layout_version;}
+
+    /* Execution space instance that every kernel and device copy of the structure runs on
+         Defaults to the default instance. Structures given separate instances (i.e. CUDA
+         streams of Kokkos::Cuda) run their parallel_for, rebuild and migrate concurrently.
+       Note: Only this instance is fenced where the structure needs values on the host, call
+             executionSpace().fence() before reading particle data from another instance.
+    */
+    void setExecutionSpace(const execution_space& space) {exec_space = space;}
+    const execution_space& executionSpace() const {return exec_space;}
+    //Range policy over [begin, end) on the execution space instance
+    Kokkos::RangePolicy<execution_space> rangePolicy(lid_t end) const {
+      return Kokkos::RangePolicy<execution_space>(exec_space, 0, end);
+    }
+    Kokkos::RangePolicy<execution_space> rangePolicy(lid_t begin, lid_t end) const {
+      return Kokkos::RangePolicy<execution_space>(exec_space, begin, end);
+    }
 
     /* Provides access to the particle info for Nth time of each particle
 
@@ -42,6 +64,25 @@ namespace particle_structs {
       return Slice<N>(*view);
     }
 
+    /* Copies the particle info of every slot into AoSoA storage with tiles of W particles
+       and back. The tile index of particle slot p is p / W, so choosing W as a multiple of
+       the SCS chunk height keeps whole chunk columns in one tile.
+       Note: the copy is separate from the structure, changes to it are not seen by get<N>()
+             or parallel_for until copyFromAoSoA
+     */
+    template <int W>
+    MemberTypeAoSoA<DataTypes, W, device_type> copyToAoSoA() {
+      MemberTypeAoSoA<DataTypes, W, device_type> aosoa(capacity_);
+      if (capacity_ > 0)
+        copyViewsToAoSoA(aosoa, ptcl_data, capacity_);
+      return aosoa;
+    }
+    template <int W>
+    void copyFromAoSoA(const MemberTypeAoSoA<DataTypes, W, device_type>& aosoa) {
+      if (capacity_ > 0)
+        copyAoSoAToViews(ptcl_data, aosoa, capacity_);
+    }
+
 
     virtual void rebuild(kkLidView new_element, kkLidView new_particle_elements = kkLidView(),
                          MemberTypeViews<DataTypes, device_type> new_particle_info = NULL) = 0;
@@ -55,16 +96,21 @@ namespace particle_structs {
     lid_t num_ptcls;
     lid_t capacity_;
     lid_t num_rows;
+    std::size_t layout_version;
 
     //Particle information
     MTVs ptcl_data;
 
+    //Instance the kernels of the structure run on
+    execution_space exec_space;
+
     //Number of Data types
     static constexpr std::size_t num_types = DataTypes::size;
   };
 
   template <class DataTypes, typename MemSpace>
   ParticleStructure<DataTypes, MemSpace>::ParticleStructure() : num_elems(0), num_ptcls(0),
-                                                                capacity_(0), num_rows(0) {
+                                                                capacity_(0), num_rows(0),
+                                                                layout_version(0) {
   }
 }
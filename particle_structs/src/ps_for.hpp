@@ -4,6 +4,10 @@
 #include <SellCSigma.h>
 #include <csr/CSR.hpp>
 namespace particle_structs {
+  /* Performs a parallel for over the particles of any ParticleStructure
+     The concrete structure is found at runtime, prefer the overloads below when
+     the type of the structure is known by the caller
+  */
   template <typename FunctionType, typename DataTypes, typename MemSpace>
   void parallel_for(ParticleStructure<DataTypes, MemSpace>* ps, FunctionType& fn,
                     std::string s="") {
@@ -21,4 +25,41 @@ namespace particle_structs {
             s.c_str());
     throw 1;
   }
+
+  /* Performs a parallel for over the particles of the elements in the device list elements
+     Only the rows (SellCSigma) or offsets (CSR) of the listed elements are visited
+  */
+  template <typename FunctionType, typename DataTypes, typename MemSpace>
+  void parallel_for(ParticleStructure<DataTypes, MemSpace>* ps,
+                    typename ParticleStructure<DataTypes, MemSpace>::kkLidView elements,
+                    FunctionType& fn, std::string s="") {
+    SellCSigma<DataTypes, MemSpace>* scs = dynamic_cast<SellCSigma<DataTypes, MemSpace>*>(ps);
+    if (scs) {
+      scs->parallel_for(elements, fn, s);
+      return;
+    }
+    CSR<DataTypes, MemSpace>* csr = dynamic_cast<CSR<DataTypes, MemSpace>*>(ps);
+    if (csr) {
+      csr->parallel_for(elements, fn, s);
+      return;
+    }
+    fprintf(stderr, "[ERROR] Structure does not support parallel for used on kernel %s\n",
+            s.c_str());
+    throw 1;
+  }
+
+  /* Statically dispatched parallel fors for callers that know the concrete structure
+     These skip the dynamic_cast chain and allow the kernel to be specialized on the layout
+  */
+  template <typename FunctionType, typename DataTypes, typename MemSpace>
+  void parallel_for(SellCSigma<DataTypes, MemSpace>* scs, FunctionType& fn,
+                    std::string s="") {
+    scs->parallel_for(fn, s);
+  }
+
+  template <typename FunctionType, typename DataTypes, typename MemSpace>
+  void parallel_for(CSR<DataTypes, MemSpace>* csr, FunctionType& fn,
+                    std::string s="") {
+    csr->parallel_for(fn, s);
+  }
 }
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "ps_for.hpp"
+#include <RegionTimers.h>
+
+namespace particle_structs {
+
+  /* Several particle species held in one particle structure
+       The species share the elements and rows of the structure, so a step runs one
+       rebuild and one migration (one message per neighbor) for all of them instead of one
+       per species
+     SPECIES - int member holding the species of each particle in [0, numSpecies)
+     Members used by only some species are carried, unused, by the others
+     Usage:
+       //Position, weight and species of ions (0) and electrons (1)
+       typedef MemberTypes<double[3], double, int> Types;
+       MultiSpecies<Types, 2> species(ptcls, 2);
+       species.parallel_for(0, pushIons, "push_ions");
+       species.migrate(new_element, new_process);
+       lid_t num_electrons = species.nPtcls(1);
+     Note: the structure is not owned and must outlive the MultiSpecies
+  */
+  template <class DataTypes, std::size_t SPECIES, typename MemSpace = DefaultMemSpace>
+  class MultiSpecies {
+  public:
+    typedef ParticleStructure<DataTypes, MemSpace> PS;
+    typedef typename PS::kkLidView kkLidView;
+    typedef typename PS::kkLidHostMirror kkLidHostMirror;
+    typedef typename PS::MTVs MTVs;
+    static_assert(std::is_same<typename PS::template DataType<SPECIES>, int>::value,
+                  "The species member must be an int");
+
+    MultiSpecies(PS* ptcls, int num_species);
+
+    PS* structure() const {return ps;}
+    int numSpecies() const {return counts.size();}
+    //Particles of a species as of the last rebuild, migrate or updateCounts
+    lid_t nPtcls(int species) const;
+    lid_t nPtcls() const {return ps->nPtcls();}
+    //Recounts each species when the structure was changed directly
+    void updateCounts();
+
+    /* Performs a parallel for over the particles of one species
+         Slots of the other species are passed with a mask of 0
+       fn - the same function as ParticleStructure parallel_for (element, particle, mask)
+    */
+    template <typename FunctionType>
+    void parallel_for(int species, FunctionType& fn, std::string name = "");
+
+    /* Rebuild and migrate every species together, the arguments are those of the
+         structure and new particles carry their species in SPECIES
+    */
+    void rebuild(kkLidView new_element, kkLidView new_particle_elements = kkLidView(),
+                 MTVs new_particle_info = NULL);
+    void migrate(kkLidView new_element, kkLidView new_process,
+                 kkLidView new_particle_elements = kkLidView(),
+                 MTVs new_particle_info = NULL);
+
+  private:
+    PS* ps;
+    std::vector<lid_t> counts;
+  };
+
+  template <class DataTypes, std::size_t SPECIES, typename MemSpace>
+  MultiSpecies<DataTypes, SPECIES, MemSpace>::MultiSpecies(PS* ptcls, int num_species) :
+    ps(ptcls), counts(num_species > 0 ? num_species : 1, 0) {
+    if (num_species < 1)
+      fprintf(stderr, "[WARNING] MultiSpecies needs at least one species, using one\n");
+    updateCounts();
+  }
+
+  template <class DataTypes, std::size_t SPECIES, typename MemSpace>
+  lid_t MultiSpecies<DataTypes, SPECIES, MemSpace>::nPtcls(int species) const {
+    if (species < 0 || species >= numSpecies()) {
+      fprintf(stderr, "[ERROR] Species %d is not in [0, %d)\n", species, numSpecies());
+      return 0;
+    }
+    return counts[species];
+  }
+
+  template <class DataTypes, std::size_t SPECIES, typename MemSpace>
+  void MultiSpecies<DataTypes, SPECIES, MemSpace>::updateCounts() {
+    const int n = numSpecies();
+    kkLidView species_counts("species_counts", n);
+    if (ps->nPtcls() > 0) {
+      auto species = ps->template get<SPECIES>();
+      auto countSpecies = PS_LAMBDA(const lid_t&, const lid_t& ptcl_id, const bool& mask) {
+        const int s = species(ptcl_id);
+        if (mask && s >= 0 && s < n)
+          Kokkos::atomic_fetch_add(&(species_counts(s)), 1);
+      };
+      particle_structs::parallel_for(ps, countSpecies, "species_count");
+    }
+    kkLidHostMirror counts_host = deviceToHost(ps->executionSpace(), species_counts);
+    lid_t total = 0;
+    for (int i = 0; i < n; ++i) {
+      counts[i] = counts_host(i);
+      total += counts[i];
+    }
+    if (total != ps->nPtcls())
+      fprintf(stderr, "[WARNING] %d particles have a species outside [0, %d)\n",
+              ps->nPtcls() - total, n);
+  }
+
+  template <class DataTypes, std::size_t SPECIES, typename MemSpace>
+  template <typename FunctionType>
+  void MultiSpecies<DataTypes, SPECIES, MemSpace>::parallel_for(int species, FunctionType& fn,
+                                                                std::string name) {
+    if (ps->nPtcls() == 0)
+      return;
+    //Profiling region and timer of the species loop
+    ScopedRegion region("ps_species_" + std::to_string(species));
+    auto species_view = ps->template get<SPECIES>();
+    auto speciesFn = PS_LAMBDA(const lid_t& elm_id, const lid_t& ptcl_id, const bool& mask) {
+      fn(elm_id, ptcl_id, mask && species_view(ptcl_id) == species);
+    };
+    particle_structs::parallel_for(ps, speciesFn, name);
+  }
+
+  template <class DataTypes, std::size_t SPECIES, typename MemSpace>
+  void MultiSpecies<DataTypes, SPECIES, MemSpace>::rebuild(kkLidView new_element,
+                                                           kkLidView new_particle_elements,
+                                                           MTVs new_particle_info) {
+    ps->rebuild(new_element, new_particle_elements, new_particle_info);
+    updateCounts();
+  }
+
+  template <class DataTypes, std::size_t SPECIES, typename MemSpace>
+  void MultiSpecies<DataTypes, SPECIES, MemSpace>::migrate(kkLidView new_element,
+                                                           kkLidView new_process,
+                                                           kkLidView new_particle_elements,
+                                                           MTVs new_particle_info) {
+    ps->migrate(new_element, new_process, new_particle_elements, new_particle_info);
+    updateCounts();
+  }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+namespace particle_structs {
+  template<class DataTypes, typename MemSpace>
+    void SellCSigma<DataTypes, MemSpace>::relayout(lid_t new_C_max, lid_t new_sigma,
+                                                   lid_t new_V) {
+    C_max = new_C_max;
+    sigma = new_sigma;
+    V_ = new_V;
+    //Keep every particle in its element and force a full rebuild with the new parameters
+    kkLidView new_element = pool->template get<lid_t>("relayout_new_element", capacity());
+    auto keepElement = PS_LAMBDA(lid_t element_id, lid_t particle_id, bool mask) {
+      new_element(particle_id) = element_id;
+    };
+    parallel_for(keepElement, "keepElement");
+    const bool shuffle = tryShuffling;
+    tryShuffling = false;
+    rebuild(new_element);
+    tryShuffling = shuffle;
+  }
+
+  template<class DataTypes, typename MemSpace>
+    void SellCSigma<DataTypes, MemSpace>::autotune(std::function<void(SellCSigma*)> run,
+                                                   const TuneGrid& grid, int num_runs) {
+    if (num_ptcls == 0 || !run)
+      return;
+    Kokkos::Profiling::pushRegion("scs_autotune");
+    tuning = true;
+    const lid_t max_team_size = policy.team_size();
+    tune_results.clear();
+    std::size_t best = 0;
+    for (std::size_t c = 0; c < grid.C.size(); ++c) {
+      if (grid.C[c] > max_team_size || grid.C[c] < 1)
+        continue;
+      for (std::size_t s = 0; s < grid.sigma.size(); ++s) {
+        for (std::size_t v = 0; v < grid.V.size(); ++v) {
+          TuneResult result;
+          result.sigma = grid.sigma[s];
+          result.V = grid.V[v];
+          Kokkos::Timer timer;
+          relayout(grid.C[c], result.sigma, result.V);
+          Kokkos::fence();
+          result.rebuild_time = timer.seconds();
+          //Record the chunk height the rebuild chose so the choice is applied as timed
+          result.C = C_;
+          timer.reset();
+          for (int i = 0; i < num_runs; ++i)
+            run(this);
+          Kokkos::fence();
+          result.parallel_for_time = timer.seconds() / num_runs;
+          tune_results.push_back(result);
+          if (result.score(num_runs) < tune_results[best].score(num_runs))
+            best = tune_results.size() - 1;
+        }
+      }
+    }
+    if (tune_results.size() > 0) {
+      tune_choice = tune_results[best];
+      const TuneResult& last = tune_results.back();
+      if (last.C != tune_choice.C || last.sigma != tune_choice.sigma || last.V != tune_choice.V)
+        relayout(tune_choice.C, tune_choice.sigma, tune_choice.V);
+      else
+        C_max = tune_choice.C;
+    }
+    rebuilds_since_tune = 0;
+    tuning = false;
+    Kokkos::Profiling::popRegion();
+  }
+
+  template<class DataTypes, typename MemSpace>
+    void SellCSigma<DataTypes, MemSpace>::setAutotunePeriod(std::function<void(SellCSigma*)>
+                                                            run, const TuneGrid& grid, int n,
+                                                            int num_runs) {
+    autotune_period = n;
+    rebuilds_since_tune = 0;
+    if (n > 0 && run)
+      autotune_fn = [this, run, grid, num_runs]() {autotune(run, grid, num_runs);};
+    else
+      autotune_fn = std::function<void()>();
+  }
+
+  template<class DataTypes, typename MemSpace>
+    void SellCSigma<DataTypes, MemSpace>::checkAutotune() {
+    if (tuning || autotune_period <= 0 || !autotune_fn)
+      return;
+    if (++rebuilds_since_tune >= autotune_period)
+      autotune_fn();
+  }
+}
@@ -4,7 +4,7 @@ namespace particle_structs {
   int SellCSigma<DataTypes, MemSpace>::chooseChunkHeight(int maxC,
                                                          kkLidView ptcls_per_elem) {
     lid_t num_elems_with_ptcls = 0;
-    Kokkos::parallel_reduce("count_elems", ptcls_per_elem.size(),
+    Kokkos::parallel_reduce("count_elems", rangePolicy(ptcls_per_elem.size()),
                             KOKKOS_LAMBDA(const lid_t& i, lid_t& sum) {
       sum += ptcls_per_elem(i) > 0;
     }, num_elems_with_ptcls);
@@ -26,24 +26,24 @@ namespace particle_structs {
     row_element = kkLidView("row_element", nchunks * C_);
     element_row = kkLidView("element_row", nchunks * C_);
     kkLidView empty("empty_elems", 1);
-    Kokkos::parallel_for(num_elems, KOKKOS_LAMBDA(const lid_t& i) {
+    Kokkos::parallel_for("scs_chunk_first_rows", rangePolicy(num_elems), KOKKOS_LAMBDA(const lid_t& i) {
         const lid_t element = ptcls(i).second;
         row_element(i) = element;
         element_row(element) = i;
         Kokkos::atomic_fetch_add(&empty[0], ptcls(i).first == 0);
       });
-    Kokkos::parallel_for(Kokkos::RangePolicy<>(num_elems, nchunks * C_),
+    Kokkos::parallel_for("scs_chunk_padding_rows", rangePolicy(num_elems, nchunks * C_),
                          KOKKOS_LAMBDA(const lid_t& i) {
                            row_element(i) = i;
                            element_row(i) = i;
                            Kokkos::atomic_fetch_add(&empty[0], 1);
                          });
 
-    num_empty_elements = getLastValue<lid_t>(empty);
-    const PolicyType policy(nchunks, C_);
+    num_empty_elements = getLastValue<lid_t>(exec_space, empty);
+    const PolicyType policy(exec_space, nchunks, C_);
     lid_t C_local = C_;
     lid_t num_elems_local = num_elems;
-    Kokkos::parallel_for(policy, KOKKOS_LAMBDA(const typename PolicyType::member_type& thread) {
+    Kokkos::parallel_for("scs_chunk_widths", policy, KOKKOS_LAMBDA(const typename PolicyType::member_type& thread) {
         const lid_t chunk_id = thread.league_rank();
         const lid_t row_num = chunk_id * C_local + thread.team_rank();
         lid_t width = 0;
@@ -58,15 +58,15 @@ namespace particle_structs {
     if (shuffle_padding > 0) {
       lid_t cw_sum, cw_sum_count;
       double cw_sum_inv;
-      Kokkos::parallel_reduce("sum_chunk_widths", nchunks,
+      Kokkos::parallel_reduce("sum_chunk_widths", rangePolicy(nchunks),
                               KOKKOS_LAMBDA(const lid_t& i, lid_t& sum) {
         sum += chunk_widths[i];
       }, cw_sum);
-      Kokkos::parallel_reduce("sum_chunk_widths", nchunks,
+      Kokkos::parallel_reduce("sum_chunk_widths", rangePolicy(nchunks),
                               KOKKOS_LAMBDA(const lid_t& i, lid_t& sum) {
         sum += chunk_widths[i] > 0;
       }, cw_sum_count);
-      Kokkos::parallel_reduce("sum_chunk_widths", nchunks,
+      Kokkos::parallel_reduce("sum_chunk_widths", rangePolicy(nchunks),
                               KOKKOS_LAMBDA(const lid_t& i, double& sum) {
         if (chunk_widths[i] > 0)
           sum += 1.0/ chunk_widths[i];
@@ -76,33 +76,90 @@ namespace particle_structs {
         const lid_t avg_pad = cw_sum * shuffle_padding / cw_sum_count;
         const double local_padding = shuffle_padding;
         if (pad_strat == PAD_EVENLY)
-          Kokkos::parallel_for(nchunks, KOKKOS_LAMBDA(const lid_t& i) {
+          Kokkos::parallel_for("scs_padding_sum", rangePolicy(nchunks), KOKKOS_LAMBDA(const lid_t& i) {
               if (chunk_widths[i] > 0)
                 chunk_widths[i] += avg_pad;
             });
         else if (pad_strat == PAD_PROPORTIONALLY)
-          Kokkos::parallel_for(nchunks, KOKKOS_LAMBDA(const lid_t& i) {
+          Kokkos::parallel_for("scs_padding_proportional", rangePolicy(nchunks), KOKKOS_LAMBDA(const lid_t& i) {
               chunk_widths[i] += chunk_widths[i] * local_padding;
             });
         else if (pad_strat == PAD_INVERSELY)
-          Kokkos::parallel_for(nchunks, KOKKOS_LAMBDA(const lid_t& i) {
+          Kokkos::parallel_for("scs_padding_even", rangePolicy(nchunks), KOKKOS_LAMBDA(const lid_t& i) {
               if (chunk_widths[i] != 0)
                 chunk_widths[i] += cw_sum2 / chunk_widths[i];
             });
+        else if (pad_strat == PAD_ADAPTIVE) {
+          //The padding budget of the other strategies is split by the largest inflow of the
+          //  rows of each chunk, evenly while no element has gained particles
+          kkLidView chunk_demand("chunk_demand", nchunks);
+          double demand_sum = 0;
+          if (element_inflow.size() == (std::size_t)num_elems) {
+            auto inflow = element_inflow;
+            Kokkos::parallel_for("scs_padding_demand", rangePolicy(num_elems), KOKKOS_LAMBDA(const lid_t& i) {
+                const double gain = inflow(ptcls(i).second);
+                if (gain > 0)
+                  Kokkos::atomic_fetch_max(&chunk_demand(i / C_local), (lid_t)ceil(gain));
+              });
+            Kokkos::parallel_reduce("sum_chunk_demand", rangePolicy(nchunks),
+                                    KOKKOS_LAMBDA(const lid_t& i, double& sum) {
+                sum += chunk_demand(i);
+              }, demand_sum);
+          }
+          if (demand_sum > 0) {
+            const double pad_per_demand = cw_sum * shuffle_padding / demand_sum;
+            Kokkos::parallel_for("scs_padding_adaptive", rangePolicy(nchunks), KOKKOS_LAMBDA(const lid_t& i) {
+                chunk_widths[i] += (lid_t)(chunk_demand(i) * pad_per_demand);
+              });
+          }
+          else
+            Kokkos::parallel_for("scs_padding_adaptive_sum", rangePolicy(nchunks), KOKKOS_LAMBDA(const lid_t& i) {
+                if (chunk_widths[i] > 0)
+                  chunk_widths[i] += avg_pad;
+              });
+        }
       }
     }
   }
 
+  template<class DataTypes, typename MemSpace>
+    void SellCSigma<DataTypes, MemSpace>::trackInflow(kkLidView new_element,
+                                                      kkLidView new_particle_elements) {
+    if (element_inflow.size() != (std::size_t)num_elems)
+      element_inflow = Kokkos::View<double*, device_type>("element_inflow", num_elems);
+    //Net particles gained by each element in this rebuild
+    kkLidView gained = pool->template get<lid_t>(exec_space, "inflow_gained", num_elems);
+    auto countMoves = PS_LAMBDA(const lid_t& element_id, const lid_t& particle_id,
+                                const bool& mask) {
+      const lid_t new_elem = new_element(particle_id);
+      if (mask && new_elem != element_id) {
+        Kokkos::atomic_fetch_add(&gained(element_id), -1);
+        if (new_elem != -1)
+          Kokkos::atomic_fetch_add(&gained(new_elem), 1);
+      }
+    };
+    parallel_for(countMoves, "inflow_count_moves");
+    Kokkos::parallel_for("inflow_count_new", rangePolicy(new_particle_elements.size()),
+                         KOKKOS_LAMBDA(const lid_t& i) {
+        Kokkos::atomic_fetch_add(&gained(new_particle_elements(i)), 1);
+      });
+    auto inflow = element_inflow;
+    const double alpha = inflow_smoothing;
+    Kokkos::parallel_for("inflow_smooth", rangePolicy(num_elems), KOKKOS_LAMBDA(const lid_t& i) {
+        inflow(i) = (1 - alpha) * inflow(i) + alpha * gained(i);
+      });
+  }
+
   template<class DataTypes, typename MemSpace>
     void SellCSigma<DataTypes, MemSpace>::createGlobalMapping(kkGidView elmGid,kkGidView& elm2Gid,
                                                               GID_Mapping& elmGid2Lid) {
     elm2Gid = kkGidView("row to element gid", numRows());
-    Kokkos::parallel_for(num_elems, KOKKOS_LAMBDA(const lid_t& i) {
+    Kokkos::parallel_for("scs_gid_to_lid", rangePolicy(num_elems), KOKKOS_LAMBDA(const lid_t& i) {
         const gid_t gid = elmGid(i);
         elm2Gid(i) = gid;
         elmGid2Lid.insert(gid, i);
       });
-    Kokkos::parallel_for(Kokkos::RangePolicy<>(num_elems, numRows()), KOKKOS_LAMBDA(const lid_t& i) {
+    Kokkos::parallel_for("scs_gid_padding_rows", rangePolicy(num_elems, numRows()), KOKKOS_LAMBDA(const lid_t& i) {
         elm2Gid(i) = -1;
       });
   }
@@ -113,7 +170,7 @@ namespace particle_structs {
                                                            kkLidView& s2c, lid_t& cap) {
     kkLidView slices_per_chunk("slices_per_chunk", nChunks);
     const lid_t V_local = V_;
-    Kokkos::parallel_for(nChunks, KOKKOS_LAMBDA(const lid_t& i) {
+    Kokkos::parallel_for("scs_slices_per_chunk", rangePolicy(nChunks), KOKKOS_LAMBDA(const lid_t& i) {
         const lid_t width = chunk_widths(i);
         const lid_t val1 = width / V_local;
         const lid_t val2 = width % V_local;
@@ -121,19 +178,19 @@ namespace particle_structs {
         slices_per_chunk(i) = val1 + val3;
       });
     kkLidView offset_nslices("offset_nslices",nChunks+1);
-    Kokkos::parallel_scan(nChunks, KOKKOS_LAMBDA(const lid_t& i, lid_t& cur, const bool& final) {
+    Kokkos::parallel_scan("scs_offset_nslices", rangePolicy(nChunks), KOKKOS_LAMBDA(const lid_t& i, lid_t& cur, const bool& final) {
         cur += slices_per_chunk(i);
         if (final)
           offset_nslices(i+1) += cur;
       });
 
-    nSlices = getLastValue<lid_t>(offset_nslices);
+    nSlices = getLastValue<lid_t>(exec_space, offset_nslices);
     offs = kkLidView("SCS offset", nSlices + 1);
     s2c = kkLidView("slice to chunk", nSlices);
     kkLidView slice_size("slice_size", nSlices);
     const lid_t nat_size = V_*C_;
     const lid_t C_local = C_;
-    Kokkos::parallel_for(nChunks, KOKKOS_LAMBDA(const lid_t& i) {
+    Kokkos::parallel_for("scs_slice_size", rangePolicy(nChunks), KOKKOS_LAMBDA(const lid_t& i) {
         const lid_t start = offset_nslices(i);
         const lid_t end = offset_nslices(i+1);
         for (lid_t j = start; j < end; ++j) {
@@ -145,14 +202,26 @@ namespace particle_structs {
           slice_size(j) += (is_last) * (val) * C_local;
         }
       });
-    Kokkos::parallel_scan(nSlices, KOKKOS_LAMBDA(const lid_t& i, lid_t& cur, const bool final) {
+    Kokkos::parallel_scan("scs_slice_offsets", rangePolicy(nSlices), KOKKOS_LAMBDA(const lid_t& i, lid_t& cur, const bool final) {
         cur += slice_size(i);
         if (final) {
           const lid_t index = i+1;
           offs(index) += cur;
         }
       });
-    cap = getLastValue<lid_t>(offs);
+    cap = getLastValue<lid_t>(exec_space, offs);
+  }
+  template<class DataTypes, typename MemSpace>
+    void SellCSigma<DataTypes, MemSpace>::constructChunkOffsets(lid_t nChunks,
+                                                                kkLidView chunk_widths,
+                                                                kkLidView& chunk_offs) {
+    chunk_offs = kkLidView("chunk_offsets", nChunks + 1);
+    const lid_t C_local = C_;
+    Kokkos::parallel_scan("scs_chunk_offsets", rangePolicy(nChunks), KOKKOS_LAMBDA(const lid_t& i, lid_t& cur, const bool& final) {
+        cur += chunk_widths(i) * C_local;
+        if (final)
+          chunk_offs(i+1) = cur;
+      });
   }
   template<class DataTypes, typename MemSpace>
     void SellCSigma<DataTypes, MemSpace>::setupParticleMask(kkLidView mask,
@@ -162,7 +231,7 @@ namespace particle_structs {
     auto offsets_cpy = offsets;
     auto slice_to_chunk_cpy = slice_to_chunk;
     kkLidView chunk_starts("chunk_starts", num_chunks);
-    Kokkos::parallel_for(num_slices-1, KOKKOS_LAMBDA(const lid_t& i) {
+    Kokkos::parallel_for("scs_slice_to_chunk", rangePolicy(num_slices-1), KOKKOS_LAMBDA(const lid_t& i) {
         const lid_t my_chunk = slice_to_chunk_cpy(i);
         const lid_t next_chunk = slice_to_chunk_cpy(i+1);
         if (my_chunk != next_chunk) {
@@ -173,9 +242,9 @@ namespace particle_structs {
     const lid_t league_size = num_chunks;
     const lid_t team_size = C_;
     const lid_t ne = num_elems;
-    const PolicyType policy(league_size, team_size);
+    const PolicyType policy(exec_space, league_size, team_size);
     auto row_to_element_cpy = row_to_element;
-    Kokkos::parallel_for(policy, KOKKOS_LAMBDA(const typename PolicyType::member_type& thread) {
+    Kokkos::parallel_for("scs_particle_mask", policy, KOKKOS_LAMBDA(const typename PolicyType::member_type& thread) {
         const lid_t chunk = thread.league_rank();
         const lid_t chunk_row = thread.team_rank();
         const lid_t rowLen = chunk_widths(chunk);
@@ -201,7 +270,7 @@ namespace particle_structs {
     //Setup starting point for each row
     lid_t C_local = C_;
     kkLidView row_index("row_index", numRows());
-    Kokkos::parallel_scan(num_chunks, KOKKOS_LAMBDA(const lid_t& i, lid_t& sum, const bool& final) {
+    Kokkos::parallel_scan("scs_row_index", rangePolicy(num_chunks), KOKKOS_LAMBDA(const lid_t& i, lid_t& sum, const bool& final) {
         if (final) {
           for (lid_t j = 0; j < C_local; ++j)
             row_index(i*C_local+j) = sum + j;
@@ -210,7 +279,7 @@ namespace particle_structs {
       });
     //Determine index for each particle
     kkLidView particle_indices("new_particle_scs_indices", given_particles);
-    Kokkos::parallel_for(given_particles, KOKKOS_LAMBDA(const lid_t& i) {
+    Kokkos::parallel_for("scs_particle_indices", rangePolicy(given_particles), KOKKOS_LAMBDA(const lid_t& i) {
         lid_t new_elem = particle_elements(i);
         lid_t new_row = element_to_row_local(new_elem);
         particle_indices(i) = Kokkos::atomic_fetch_add(&row_index(new_row), C_local);
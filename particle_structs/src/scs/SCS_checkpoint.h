@@ -0,0 +1,260 @@
+#pragma once
+
+#include <vector>
+#include <cstring>
+
+namespace particle_structs {
+
+  /* Binary checkpoint of a SellCSigma shared by every rank of the structure's communicator
+
+     file:  [header][block of rank 0][block of rank 1]...
+     header: char[8] magic, int64 comm_size, int64 number of member types,
+             int64 bytes of one particle, int64 block offsets[comm_size + 1]
+     block:  int64 scalars[SCALARS], double paddings[2], then each array padded to
+             8 bytes: element_to_gid, offsets, slice_to_chunk, row_to_element, element_to_row,
+             chunk_offsets, overflow_offsets, overflow_widths, particle_mask and the member
+             data of every slot packed type by type (the layout of PackParticles)
+  */
+  namespace checkpoint {
+    static const char magic[8] = {'P', 'S', 'S', 'C', 'S', 'C', 'K', '1'};
+    enum Scalars {NUM_ELEMS, NUM_PTCLS, CAPACITY, CURRENT_SIZE, NUM_CHUNKS, NUM_SLICES, NUM_ROWS,
+                  C, C_MAX, SIGMA, V, PAD_STRAT, NUM_GIDS, SCALARS};
+    //Largest transfer of one MPI-IO call
+    static const std::size_t max_io_bytes = 1 << 30;
+
+    inline std::size_t padded(std::size_t bytes) {return (bytes + 7) / 8 * 8;}
+
+    //Copies a device view to/from position pos of a host block
+    template <typename View>
+    void toBlock(std::vector<char>& block, std::size_t& pos, View view) {
+      typedef typename View::non_const_value_type T;
+      Kokkos::View<T*, Kokkos::HostSpace, Kokkos::MemoryTraits<Kokkos::Unmanaged> >
+        host(reinterpret_cast<T*>(block.data() + pos), view.size());
+      Kokkos::deep_copy(host, view);
+      pos += padded(view.size() * sizeof(T));
+    }
+    template <typename View>
+    View fromBlock(const std::vector<char>& block, std::size_t& pos, std::size_t size,
+                   const char* name) {
+      typedef typename View::non_const_value_type T;
+      View view(name, size);
+      Kokkos::View<const T*, Kokkos::HostSpace, Kokkos::MemoryTraits<Kokkos::Unmanaged> >
+        host(reinterpret_cast<const T*>(block.data() + pos), size);
+      Kokkos::deep_copy(view, host);
+      pos += padded(size * sizeof(T));
+      return view;
+    }
+
+    //Collective reads/writes split so each call moves less than max_io_bytes
+    inline void writeAll(MPI_File file, MPI_Offset offset, const char* data, std::size_t bytes,
+                         MPI_Comm comm) {
+      long long calls = (bytes + max_io_bytes - 1) / max_io_bytes;
+      MPI_Allreduce(MPI_IN_PLACE, &calls, 1, MPI_LONG_LONG, MPI_MAX, comm);
+      for (long long i = 0; i < calls; ++i) {
+        const std::size_t start = std::min<std::size_t>(bytes, i * max_io_bytes);
+        const std::size_t count = std::min(bytes - start, max_io_bytes);
+        MPI_File_write_at_all(file, offset + start, data + start, count, MPI_CHAR,
+                              MPI_STATUS_IGNORE);
+      }
+    }
+    inline void readAll(MPI_File file, MPI_Offset offset, char* data, std::size_t bytes,
+                        MPI_Comm comm) {
+      long long calls = (bytes + max_io_bytes - 1) / max_io_bytes;
+      MPI_Allreduce(MPI_IN_PLACE, &calls, 1, MPI_LONG_LONG, MPI_MAX, comm);
+      for (long long i = 0; i < calls; ++i) {
+        const std::size_t start = std::min<std::size_t>(bytes, i * max_io_bytes);
+        const std::size_t count = std::min(bytes - start, max_io_bytes);
+        MPI_File_read_at_all(file, offset + start, data + start, count, MPI_CHAR,
+                             MPI_STATUS_IGNORE);
+      }
+    }
+  }
+
+  template<class DataTypes, typename MemSpace>
+    void SellCSigma<DataTypes, MemSpace>::writeCheckpoint(const std::string& filename) {
+    //The checkpoint holds the layout, so particles are written in the rows of their elements
+    flushLazyRebuild();
+    Kokkos::Profiling::pushRegion("scs_write_checkpoint");
+    int comm_rank, comm_size;
+    MPI_Comm_rank(mpi_comm, &comm_rank);
+    MPI_Comm_size(mpi_comm, &comm_size);
+    using checkpoint::padded;
+
+    //Pack the member data of every slot
+    const lid_t cap = capacity_;
+    const std::size_t data_bytes = PackedBytes<DataTypes>::bytes(cap);
+    Kokkos::View<char*, device_type> buffer("checkpoint_buffer", data_bytes);
+    if (cap > 0) {
+      kkLidView ptcl_segment("checkpoint_segment", cap);
+      kkLidView ptcl_index("checkpoint_index", cap);
+      Kokkos::parallel_for("checkpoint_index", cap, KOKKOS_LAMBDA(const lid_t& i) {
+          ptcl_index(i) = i;
+        });
+      kkLidView segment_offsets("checkpoint_segment_offsets", 2);
+      kkLidView segment_counts("checkpoint_segment_counts", 1);
+      Kokkos::deep_copy(segment_counts, cap);
+      Kokkos::View<std::size_t*, device_type> type_offsets("checkpoint_type_offsets", 1);
+      PackParticles<SellCSigma<DataTypes, MemSpace>, DataTypes>(this, ptcl_data, ptcl_segment,
+                                                                ptcl_index, segment_offsets,
+                                                                segment_counts, type_offsets,
+                                                                buffer);
+    }
+
+    //Fill the block of this rank
+    const std::size_t block_bytes = 8 * checkpoint::SCALARS + 2 * sizeof(double) +
+      padded(element_to_gid.size() * sizeof(gid_t)) +
+      padded((num_slices + 1) * sizeof(lid_t)) + padded(num_slices * sizeof(lid_t)) +
+      2 * padded(num_rows * sizeof(lid_t)) + padded((num_chunks + 1) * sizeof(lid_t)) +
+      2 * padded(num_chunks * sizeof(lid_t)) + padded(cap * sizeof(lid_t)) + data_bytes;
+    std::vector<char> block(block_bytes, 0);
+    long long* scalars = reinterpret_cast<long long*>(block.data());
+    scalars[checkpoint::NUM_ELEMS] = num_elems;
+    scalars[checkpoint::NUM_PTCLS] = num_ptcls;
+    scalars[checkpoint::CAPACITY] = cap;
+    scalars[checkpoint::CURRENT_SIZE] = current_size;
+    scalars[checkpoint::NUM_CHUNKS] = num_chunks;
+    scalars[checkpoint::NUM_SLICES] = num_slices;
+    scalars[checkpoint::NUM_ROWS] = num_rows;
+    scalars[checkpoint::C] = C_;
+    scalars[checkpoint::C_MAX] = C_max;
+    scalars[checkpoint::SIGMA] = sigma;
+    scalars[checkpoint::V] = V_;
+    scalars[checkpoint::PAD_STRAT] = pad_strat;
+    scalars[checkpoint::NUM_GIDS] = element_to_gid.size();
+    double* paddings = reinterpret_cast<double*>(scalars + checkpoint::SCALARS);
+    paddings[0] = shuffle_padding;
+    paddings[1] = extra_padding;
+    std::size_t pos = 8 * checkpoint::SCALARS + 2 * sizeof(double);
+    typedef Kokkos::pair<lid_t, lid_t> Range;
+    checkpoint::toBlock(block, pos, element_to_gid);
+    checkpoint::toBlock(block, pos, Kokkos::subview(offsets, Range(0, num_slices + 1)));
+    checkpoint::toBlock(block, pos, Kokkos::subview(slice_to_chunk, Range(0, num_slices)));
+    checkpoint::toBlock(block, pos, Kokkos::subview(row_to_element, Range(0, num_rows)));
+    checkpoint::toBlock(block, pos, Kokkos::subview(element_to_row, Range(0, num_rows)));
+    checkpoint::toBlock(block, pos, Kokkos::subview(chunk_offsets, Range(0, num_chunks + 1)));
+    checkpoint::toBlock(block, pos, Kokkos::subview(overflow_offsets, Range(0, num_chunks)));
+    checkpoint::toBlock(block, pos, Kokkos::subview(overflow_widths, Range(0, num_chunks)));
+    checkpoint::toBlock(block, pos, Kokkos::subview(particle_mask, Range(0, cap)));
+    checkpoint::toBlock(block, pos, buffer);
+
+    //Block offsets follow the header
+    const long long header_bytes = 32 + 8 * (comm_size + 1);
+    long long my_bytes = block.size();
+    long long my_offset = 0;
+    MPI_Exscan(&my_bytes, &my_offset, 1, MPI_LONG_LONG, MPI_SUM, mpi_comm);
+    if (comm_rank == 0)
+      my_offset = 0;
+    my_offset += header_bytes;
+    std::vector<long long> header(4 + comm_size + 1);
+    MPI_Gather(&my_offset, 1, MPI_LONG_LONG, header.data() + 4, 1, MPI_LONG_LONG, 0, mpi_comm);
+
+    MPI_File file;
+    MPI_File_open(mpi_comm, filename.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                  MPI_INFO_NULL, &file);
+    MPI_File_set_size(file, 0);
+    if (comm_rank == 0) {
+      memcpy(header.data(), checkpoint::magic, 8);
+      header[1] = comm_size;
+      header[2] = DataTypes::size;
+      header[3] = DataTypes::memsize;
+      header[4 + comm_size] = my_offset + my_bytes;
+      //The end of the file is the end of the last block
+      MPI_Status status;
+      if (comm_size > 1)
+        MPI_Recv(&header[4 + comm_size], 1, MPI_LONG_LONG, comm_size - 1, 0, mpi_comm, &status);
+      MPI_File_write_at(file, 0, header.data(), header_bytes, MPI_CHAR, MPI_STATUS_IGNORE);
+    }
+    else if (comm_rank == comm_size - 1) {
+      long long end = my_offset + my_bytes;
+      MPI_Send(&end, 1, MPI_LONG_LONG, 0, 0, mpi_comm);
+    }
+    checkpoint::writeAll(file, my_offset, block.data(), block.size(), mpi_comm);
+    MPI_File_close(&file);
+    Kokkos::Profiling::popRegion();
+  }
+
+  template<class DataTypes, typename MemSpace>
+    void SellCSigma<DataTypes, MemSpace>::readCheckpoint(const std::string& filename) {
+    Kokkos::Profiling::pushRegion("scs_read_checkpoint");
+    int comm_rank, comm_size;
+    MPI_Comm_rank(mpi_comm, &comm_rank);
+    MPI_Comm_size(mpi_comm, &comm_size);
+    MPI_File file;
+    if (MPI_File_open(mpi_comm, filename.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) !=
+        MPI_SUCCESS) {
+      fprintf(stderr, "[ERROR] Rank %d cannot open checkpoint %s\n", comm_rank,
+              filename.c_str());
+      PS_ALWAYS_ASSERT(false);
+    }
+    //Check the header matches this job and structure
+    const long long header_bytes = 32 + 8 * (comm_size + 1);
+    std::vector<long long> header(4 + comm_size + 1);
+    checkpoint::readAll(file, 0, reinterpret_cast<char*>(header.data()), 32, mpi_comm);
+    if (memcmp(header.data(), checkpoint::magic, 8) || header[1] != comm_size ||
+        header[2] != (long long)DataTypes::size || header[3] != (long long)DataTypes::memsize) {
+      fprintf(stderr, "[ERROR] Checkpoint %s was not written by %d ranks with these "
+              "particle types\n", filename.c_str(), comm_size);
+      PS_ALWAYS_ASSERT(false);
+    }
+    checkpoint::readAll(file, 0, reinterpret_cast<char*>(header.data()), header_bytes,
+                        mpi_comm);
+    const long long my_offset = header[4 + comm_rank];
+    std::vector<char> block(header[4 + comm_rank + 1] - my_offset);
+    checkpoint::readAll(file, my_offset, block.data(), block.size(), mpi_comm);
+    MPI_File_close(&file);
+
+    const long long* scalars = reinterpret_cast<const long long*>(block.data());
+    num_elems = scalars[checkpoint::NUM_ELEMS];
+    num_ptcls = scalars[checkpoint::NUM_PTCLS];
+    capacity_ = scalars[checkpoint::CAPACITY];
+    current_size = swap_size = scalars[checkpoint::CURRENT_SIZE];
+    num_chunks = scalars[checkpoint::NUM_CHUNKS];
+    num_slices = scalars[checkpoint::NUM_SLICES];
+    num_rows = scalars[checkpoint::NUM_ROWS];
+    C_ = scalars[checkpoint::C];
+    C_max = scalars[checkpoint::C_MAX];
+    sigma = scalars[checkpoint::SIGMA];
+    V_ = scalars[checkpoint::V];
+    pad_strat = static_cast<PaddingStrategy>(scalars[checkpoint::PAD_STRAT]);
+    const std::size_t num_gids = scalars[checkpoint::NUM_GIDS];
+    const double* paddings = reinterpret_cast<const double*>(scalars + checkpoint::SCALARS);
+    shuffle_padding = paddings[0];
+    extra_padding = paddings[1];
+    std::size_t pos = 8 * checkpoint::SCALARS + 2 * sizeof(double);
+    kkGidView gids = checkpoint::fromBlock<kkGidView>(block, pos, num_gids, "element_gids");
+    offsets = checkpoint::fromBlock<kkLidView>(block, pos, num_slices + 1, "offsets");
+    slice_to_chunk = checkpoint::fromBlock<kkLidView>(block, pos, num_slices, "slice_to_chunk");
+    row_to_element = checkpoint::fromBlock<kkLidView>(block, pos, num_rows, "row_element");
+    element_to_row = checkpoint::fromBlock<kkLidView>(block, pos, num_rows, "element_row");
+    chunk_offsets = checkpoint::fromBlock<kkLidView>(block, pos, num_chunks + 1,
+                                                     "chunk_offsets");
+    overflow_offsets = checkpoint::fromBlock<kkLidView>(block, pos, num_chunks,
+                                                        "overflow_offsets");
+    overflow_widths = checkpoint::fromBlock<kkLidView>(block, pos, num_chunks,
+                                                       "overflow_widths");
+    particle_mask = checkpoint::fromBlock<kkLidView>(block, pos, capacity_, "particle_mask");
+    Kokkos::View<char*, device_type> buffer =
+      checkpoint::fromBlock<Kokkos::View<char*, device_type> >(block, pos,
+                                                               PackedBytes<DataTypes>::bytes(capacity_),
+                                                               "checkpoint_buffer");
+    if (num_gids > 0) {
+      element_gid_to_lid = GID_Mapping(num_elems);
+      createGlobalMapping(gids, element_to_gid, element_gid_to_lid);
+    }
+
+    //Unpack the member data into the slots it was written from
+    CreateViews<device_type, DataTypes>(ptcl_data, current_size, "scs_particle_data");
+    CreateViews<device_type, DataTypes>(scs_data_swap, swap_size, "scs_particle_data");
+    if (capacity_ > 0) {
+      kkLidView segment_offsets("checkpoint_segment_offsets", 2);
+      Kokkos::deep_copy(Kokkos::subview(segment_offsets, 1), capacity_);
+      Kokkos::View<std::size_t*, device_type> type_offsets("checkpoint_type_offsets", 1);
+      UnpackViews<device_type, DataTypes>(ptcl_data, capacity_, segment_offsets, 1,
+                                          type_offsets, buffer);
+    }
+    trackLayout();
+    updatePolicy();
+    ++layout_version;
+    Kokkos::Profiling::popRegion();
+  }
+}
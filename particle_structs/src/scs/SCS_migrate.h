@@ -1,146 +1,590 @@
 #pragma once
 namespace particle_structs {
+  /* Smallest destination above prev of the slots [first, last) of a migration block, -1 if
+       there is none. Called by every thread of team, which all get the destination.
+  */
+  template <class TeamMember, class View>
+  KOKKOS_INLINE_FUNCTION lid_t nextBlockDestination(const TeamMember& team, const View& dests,
+                                                    const lid_t first, const lid_t last,
+                                                    const lid_t prev) {
+    lid_t next;
+    Kokkos::parallel_reduce(Kokkos::TeamThreadRange(team, first, last),
+                            [=](const lid_t& i, lid_t& min) {
+      const lid_t dest = dests(i);
+      if (dest > prev && dest < min)
+        min = dest;
+    }, Kokkos::Min<lid_t>(next));
+    return next == Kokkos::reduction_identity<lid_t>::min() ? -1 : next;
+  }
+
+  template<class DataTypes, typename MemSpace>
+    void SellCSigma<DataTypes, MemSpace>::setMigrationNeighbors(const std::vector<int>& ranks) {
+    int comm_rank, comm_size;
+    MPI_Comm_rank(mpi_comm, &comm_rank);
+    MPI_Comm_size(mpi_comm, &comm_size);
+    if (neighbor_comm != MPI_COMM_NULL)
+      MPI_Comm_free(&neighbor_comm);
+    neighbor_send_ranks.clear();
+    neighbor_recv_ranks.clear();
+    rank_to_send_index = kkLidView();
+
+    //Remove this process from the list of destinations
+    std::vector<int> dests;
+    for (std::size_t i = 0; i < ranks.size(); ++i)
+      if (ranks[i] != comm_rank)
+        dests.push_back(ranks[i]);
+
+    //Turn off neighborhood migration if no process provides neighbors
+    int has_neighbors = ranks.size() > 0, any_neighbors;
+    MPI_Allreduce(&has_neighbors, &any_neighbors, 1, MPI_INT, MPI_MAX, mpi_comm);
+    if (!any_neighbors)
+      return;
+
+    //Build the graph from the destinations of each process to find who sends to each process
+    int degree = dests.size();
+    MPI_Dist_graph_create(mpi_comm, 1, &comm_rank, &degree, dests.data(), MPI_UNWEIGHTED,
+                          MPI_INFO_NULL, 0, &neighbor_comm);
+    int indegree, outdegree, weighted;
+    MPI_Dist_graph_neighbors_count(neighbor_comm, &indegree, &outdegree, &weighted);
+    neighbor_recv_ranks.resize(indegree);
+    neighbor_send_ranks.resize(outdegree);
+    MPI_Dist_graph_neighbors(neighbor_comm, indegree, neighbor_recv_ranks.data(), MPI_UNWEIGHTED,
+                             outdegree, neighbor_send_ranks.data(), MPI_UNWEIGHTED);
+
+    kkLidHostMirror rank_to_send_index_host("rank_to_send_index_host", comm_size);
+    Kokkos::deep_copy(rank_to_send_index_host, -1);
+    for (int i = 0; i < outdegree; ++i)
+      rank_to_send_index_host(neighbor_send_ranks[i]) = i;
+    rank_to_send_index = kkLidView("rank_to_send_index", comm_size);
+    Kokkos::deep_copy(rank_to_send_index, rank_to_send_index_host);
+  }
+
+  template<class DataTypes, typename MemSpace>
+    void SellCSigma<DataTypes, MemSpace>::setMigrationCompression(const std::vector<PackCodec>&
+                                                                  codecs) {
+    migration_codecs.clear();
+    if (codecs.size() > 0) {
+      migration_codecs.assign(num_types, PACK_EXACT);
+      for (std::size_t i = 0; i < codecs.size() && i < (std::size_t)num_types; ++i)
+        migration_codecs[i] = codecs[i];
+    }
+    updateCompactGids();
+  }
+
+  template<class DataTypes, typename MemSpace>
+    void SellCSigma<DataTypes, MemSpace>::updateCompactGids() {
+    compact_gids = false;
+    if (migration_codecs.size() == 0)
+      return;
+    kkGidView element_to_gid_local = element_to_gid;
+    int wide = 0;
+    Kokkos::parallel_reduce("migrate_wide_gids", rangePolicy(element_to_gid.size()),
+                            KOKKOS_LAMBDA(const lid_t& i, int& sum) {
+        const gid_t gid = element_to_gid_local(i);
+        sum += gid < INT_MIN || gid > INT_MAX;
+      }, wide);
+    MPI_Allreduce(MPI_IN_PLACE, &wide, 1, MPI_INT, MPI_MAX, mpi_comm);
+    compact_gids = wide == 0;
+  }
+
   template<class DataTypes, typename MemSpace>
     void SellCSigma<DataTypes, MemSpace>::migrate(kkLidView new_element, kkLidView new_process,
                                                   kkLidView new_particle_elements,
                                                   MTVs new_particle_info) {
-    //TODO use new_particle_elements, new_particle_info
-    const auto btime = prebarrier();
-    Kokkos::Profiling::pushRegion("scs_migrate");
+    if (!checkResident("migrate"))
+      return;
+    MemoryPhase memory_phase("scs_migrate");
+    MigrateHandle handle = migrate_begin(new_element, new_process, new_particle_elements,
+                                         new_particle_info);
+    migrate_end(handle);
+  }
+
+  template<class DataTypes, typename MemSpace>
+    typename SellCSigma<DataTypes, MemSpace>::MigrateHandle
+    SellCSigma<DataTypes, MemSpace>::migrate_begin(kkLidView new_element,
+                                                   kkLidView new_process,
+                                                   kkLidView new_particle_elements,
+                                                   MTVs new_particle_info) {
+    MigrateHandle handle;
+    if (!checkResident("migrate_begin"))
+      return handle;
+    handle.btime = prebarrier(mpi_comm);
+    recordImbalance("ps_migrate", handle.btime, num_ptcls);
+    Kokkos::Profiling::pushRegion("scs_migrate_begin");
+    MemoryPhase memory_phase("scs_migrate_begin");
     Kokkos::Timer timer;
+    handle.active = true;
+    handle.communicate = false;
+    handle.packed = packed_migration;
+    handle.compact_gids = compact_gids;
+    handle.codecs = migration_codecs;
+    handle.new_element = new_element;
+    handle.new_process = new_process;
+    handle.new_particle_elements = new_particle_elements;
+    handle.new_particle_info = new_particle_info;
     /********* Send # of particles being sent to each process *********/
     int comm_size;
-    MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+    MPI_Comm_size(mpi_comm, &comm_size);
     int comm_rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+    MPI_Comm_rank(mpi_comm, &comm_rank);
 
     if (comm_size == 1) {
-      rebuild(new_element, new_particle_elements, new_particle_info);
-      if(!comm_rank || comm_rank == comm_size/2)
-        fprintf(stderr, "%d ps particle migration (seconds) %f\n", comm_rank, timer.seconds());
+      //Only a rebuild is needed, it is done in migrate_end
+      handle.begin_time = timer.seconds();
       Kokkos::Profiling::popRegion();
-      return;
+      return handle;
     }
-    kkLidView num_send_particles("num_send_particles", comm_size);
-    auto count_sending_particles = PS_LAMBDA(lid_t element_id, lid_t particle_id, bool mask) {
-      const lid_t process = new_process(particle_id);
-      Kokkos::atomic_fetch_add(&(num_send_particles(process)), mask * (process != comm_rank));
-    };
-    parallel_for(count_sending_particles);
-    kkLidView num_recv_particles("num_recv_particles", comm_size);
-    PS_Comm_Alltoall(num_send_particles, 1, num_recv_particles, 1, MPI_COMM_WORLD);
+
+    /* Ranks that particles are exchanged with
+         The counts and offsets are indexed by the position in these lists
+    */
+    const bool use_neighbors = neighbor_comm != MPI_COMM_NULL;
+    std::vector<int> all_ranks;
+    if (!use_neighbors) {
+      all_ranks.resize(comm_size);
+      for (int i = 0; i < comm_size; ++i)
+        all_ranks[i] = i;
+    }
+    const std::vector<int>& send_ranks = use_neighbors ? neighbor_send_ranks : all_ranks;
+    const std::vector<int>& recv_ranks = use_neighbors ? neighbor_recv_ranks : all_ranks;
+    const lid_t num_send_ranks = send_ranks.size();
+    const lid_t num_recv_ranks = recv_ranks.size();
+    kkLidView rank_to_send_index_local = rank_to_send_index;
+
+    /* Destination of each slot's particle (-1 if it stays) counted in blocks of contiguous
+         slots. The scan of the block counts ordered by destination then block gives each
+         block its first send index per destination, so the messages are filled in slot
+         order without atomics (deterministic, and a hot destination does not serialize).
+         One team works on each block, it visits the destinations of its block in order and
+         counts or scans the slots of each over its threads.
+    */
+    const lid_t cap = capacity();
+    kkLidView send_rank_index = pool->template get<lid_t>(exec_space, "migrate_send_rank_index",
+                                                          cap, false);
+    kkLidView not_neighbor = pool->template get<lid_t>(exec_space, "migrate_not_neighbor", 1);
+    auto particle_mask_local = particle_mask;
+    Kokkos::parallel_for("migrate_send_rank", rangePolicy(cap), KOKKOS_LAMBDA(const lid_t& i) {
+        const lid_t process = new_process(i);
+        lid_t dest = -1;
+        if (particle_mask_local(i) && process != comm_rank) {
+          dest = use_neighbors ? rank_to_send_index_local(process) : process;
+          if (dest < 0)
+            not_neighbor(0) = 1;
+        }
+        send_rank_index(i) = dest;
+      });
+    //The block by destination counts are bounded by shrinking the number of blocks
+    const lid_t max_block_counts = 1 << 22;
+    lid_t num_blocks = (cap + 255) / 256;
+    if (num_send_ranks > 0 && (long)num_blocks * num_send_ranks > max_block_counts)
+      num_blocks = max_block_counts / num_send_ranks;
+    if (num_blocks < 1)
+      num_blocks = 1;
+    const lid_t block_size = (cap + num_blocks - 1) / num_blocks;
+    kkLidView block_offsets = pool->template get<lid_t>(exec_space, "migrate_block_offsets",
+                                                        num_blocks * num_send_ranks);
+    const PolicyType block_policy(exec_space, num_blocks, Kokkos::AUTO);
+    Kokkos::parallel_for("count_sending_particles", block_policy,
+                         KOKKOS_LAMBDA(const TeamMember& team) {
+        const lid_t b = team.league_rank();
+        const lid_t first = b * block_size;
+        const lid_t last = first + block_size < cap ? first + block_size : cap;
+        for (lid_t dest = nextBlockDestination(team, send_rank_index, first, last, -1);
+             dest >= 0;
+             dest = nextBlockDestination(team, send_rank_index, first, last, dest)) {
+          lid_t count = 0;
+          Kokkos::parallel_reduce(Kokkos::TeamThreadRange(team, first, last),
+                                  [=](const lid_t& i, lid_t& sum) {
+            sum += send_rank_index(i) == dest;
+          }, count);
+          Kokkos::single(Kokkos::PerTeam(team), [=]() {
+            block_offsets(dest * num_blocks + b) = count;
+          });
+        }
+      });
+    kkLidView num_send_particles = pool->template get<lid_t>(exec_space, "migrate_num_send_particles",
+                                                             num_send_ranks, false);
+    Kokkos::parallel_for("sum_sending_particles", rangePolicy(num_send_ranks),
+                         KOKKOS_LAMBDA(const lid_t& dest) {
+        lid_t sum = 0;
+        for (lid_t b = 0; b < num_blocks; ++b)
+          sum += block_offsets(dest * num_blocks + b);
+        num_send_particles(dest) = sum;
+      });
+    if (use_neighbors && getLastValue<lid_t>(exec_space, not_neighbor)) {
+      fprintf(stderr, "[ERROR] Rank %d is sending particles to a rank that is not a migration "
+              "neighbor\n", comm_rank);
+      PS_ALWAYS_ASSERT(false);
+    }
+    kkLidView num_recv_particles = pool->template get<lid_t>(exec_space, "migrate_num_recv_particles",
+                                                             num_recv_ranks);
+    //MPI reads the counts once the kernels of this instance finish
+    exec_space.fence();
+    Kokkos::Profiling::pushRegion("scs_migrate_counts");
+    if (use_neighbors)
+      PS_Comm_Neighbor_alltoall(num_send_particles, 1, num_recv_particles, 1, neighbor_comm);
+    else
+      PS_Comm_Alltoall(num_send_particles, 1, num_recv_particles, 1, mpi_comm);
+    Kokkos::Profiling::popRegion();
 
     lid_t num_sending_to = 0, num_receiving_from = 0;
-    Kokkos::parallel_reduce("sum_senders", comm_size, KOKKOS_LAMBDA (const lid_t& i, lid_t& lsum ) {
+    Kokkos::parallel_reduce("sum_senders", rangePolicy(num_send_ranks),
+                            KOKKOS_LAMBDA (const lid_t& i, lid_t& lsum ) {
         lsum += (num_send_particles(i) > 0);
       }, num_sending_to);
-    Kokkos::parallel_reduce("sum_receivers", comm_size, KOKKOS_LAMBDA (const lid_t& i, lid_t& lsum ) {
+    Kokkos::parallel_reduce("sum_receivers", rangePolicy(num_recv_ranks),
+                            KOKKOS_LAMBDA (const lid_t& i, lid_t& lsum ) {
         lsum += (num_recv_particles(i) > 0);
       }, num_receiving_from);
 
     if (num_sending_to == 0 && num_receiving_from == 0) {
-      rebuild(new_element, new_particle_elements, new_particle_info);
-      if(!comm_rank || comm_rank == comm_size/2)
-        fprintf(stderr, "%d ps particle migration (seconds) %f\n", comm_rank, timer.seconds());
+      //Only a rebuild is needed, it is done in migrate_end
+      handle.begin_time = timer.seconds();
       Kokkos::Profiling::popRegion();
-      return;
+      return handle;
     }
     /********** Send particle information to new processes **********/
     //Perform an ex-sum on num_send_particles & num_recv_particles
-    kkLidView offset_send_particles("offset_send_particles", comm_size+1);
-    kkLidView offset_send_particles_temp("offset_send_particles_temp", comm_size + 1);
-    kkLidView offset_recv_particles("offset_recv_particles", comm_size+1);
-    Kokkos::parallel_scan(comm_size, KOKKOS_LAMBDA(const lid_t& i, lid_t& num, const bool& final) {
+    kkLidView offset_send_particles =
+      pool->template get<lid_t>(exec_space, "migrate_offset_send_particles", num_send_ranks + 1);
+    kkLidView offset_recv_particles =
+      pool->template get<lid_t>(exec_space, "migrate_offset_recv_particles", num_recv_ranks + 1);
+    Kokkos::parallel_scan("migrate_offset_send", rangePolicy(num_send_ranks),
+                          KOKKOS_LAMBDA(const lid_t& i, lid_t& num, const bool& final) {
         num += num_send_particles(i);
-        if (final) {
+        if (final)
           offset_send_particles(i+1) += num;
-          offset_send_particles_temp(i+1) += num;
-        }
       });
-    Kokkos::parallel_scan(comm_size, KOKKOS_LAMBDA(const lid_t& i, lid_t& num, const bool& final) {
+    Kokkos::parallel_scan("migrate_block_offsets", rangePolicy(num_blocks * num_send_ranks),
+                          KOKKOS_LAMBDA(const lid_t& i, lid_t& cur, const bool& final) {
+        const lid_t count = block_offsets(i);
+        if (final)
+          block_offsets(i) = cur;
+        cur += count;
+      });
+    Kokkos::parallel_scan("migrate_offset_recv", rangePolicy(num_recv_ranks),
+                          KOKKOS_LAMBDA(const lid_t& i, lid_t& num, const bool& final) {
         num += num_recv_particles(i);
         if (final)
           offset_recv_particles(i+1) += num;
       });
-    kkLidHostMirror offset_send_particles_host = deviceToHost(offset_send_particles);
-    kkLidHostMirror offset_recv_particles_host = deviceToHost(offset_recv_particles);
-
-    //Create arrays for particles being sent
-    lid_t np_send = offset_send_particles_host(comm_size);
-    kkLidView send_element("send_element", np_send);
-    MTVs send_particle;
-    //Allocate views for each data type into send_particle[type]
-    CreateViews<device_type, DataTypes>(send_particle, np_send);
-    kkLidView send_index("send_particle_index", capacity());
+    kkLidHostMirror offset_send_particles_host = deviceToHost(exec_space, offset_send_particles);
+    kkLidHostMirror offset_recv_particles_host = deviceToHost(exec_space, offset_recv_particles);
+
+    lid_t np_send = offset_send_particles_host(num_send_ranks);
+    lid_t new_ptcls = new_particle_elements.size();
+    lid_t np_recv = offset_recv_particles_host(num_recv_ranks);
+    kkLidView send_index = pool->template get<lid_t>(exec_space, "migrate_send_index", capacity());
     auto element_to_gid_local = element_to_gid;
-    auto gatherParticlesToSend = PS_LAMBDA(lid_t element_id, lid_t particle_id, lid_t mask) {
-      const lid_t process = new_process(particle_id);
-      if (mask && process != comm_rank) {
-        send_index(particle_id) =
-          Kokkos::atomic_fetch_add(&(offset_send_particles_temp(process)),1);
-        const lid_t index = send_index(particle_id);
-        send_element(index) = element_to_gid_local(new_element(particle_id));
-      }
-    };
-    parallel_for(gatherParticlesToSend);
-    //Copy the values from ptcl_data[type][particle_id] into send_particle[type](index) for each data type
-    CopyParticlesToSend<SellCSigma<DataTypes, MemSpace>, DataTypes>(this, send_particle,
-                                                                    ptcl_data,
-                                                                    new_process,
-                                                                    send_index);
 
     //Create arrays for particles being received
-    lid_t new_ptcls = new_particle_elements.size();
-    lid_t np_recv = offset_recv_particles_host(comm_size);
-    kkLidView recv_element("recv_element", np_recv + new_ptcls);
-    MTVs recv_particle;
-    //Allocate views for each data type into recv_particle[type]
-    CreateViews<device_type, DataTypes>(recv_particle, np_recv + new_ptcls);
+    kkLidView recv_element = pool->template get<lid_t>(exec_space, "migrate_recv_element",
+                                                       np_recv + new_ptcls);
+    //Views for each data type in recv_particle[type]
+    MTVs recv_particle = pool->template getMemberViews<DataTypes>("migrate_recv_particle",
+                                                                  np_recv + new_ptcls);
+    handle.communicate = true;
+    handle.np_recv = np_recv;
+    handle.num_recv_ranks = num_recv_ranks;
+    handle.recv_element = recv_element;
+    handle.recv_particle = recv_particle;
+    handle.offset_recv_particles = offset_recv_particles;
+    handle.num_recv_particles = num_recv_particles;
 
-    //Get pointers to the data for MPI calls
     lid_t send_num = 0, recv_num = 0;
-    lid_t num_sends = num_sending_to * (num_types + 1);
-    lid_t num_recvs = num_receiving_from * (num_types + 1);
-    MPI_Request* send_requests = new MPI_Request[num_sends];
-    MPI_Request* recv_requests = new MPI_Request[num_recvs];
-    //Send the particles to each neighbor
-    for (lid_t i = 0; i < comm_size; ++i) {
-      if (i == comm_rank)
-        continue;
-
-      //Sending
-      lid_t num_send = offset_send_particles_host(i+1) - offset_send_particles_host(i);
-      if (num_send > 0) {
-        lid_t start_index = offset_send_particles_host(i);
-        PS_Comm_Isend(send_element, start_index, num_send, i, 0, MPI_COMM_WORLD,
-                      send_requests +send_num);
-        send_num++;
-        SendViews<device_type, DataTypes>(send_particle, start_index, num_send, i, 1,
-                                          send_requests + send_num);
-        send_num+=num_types;
+    lid_t num_sends, num_recvs;
+    MPI_Request* send_requests;
+    MPI_Request* recv_requests;
+    if (packed_migration) {
+      /* One message per rank holding the element gids followed by each data type
+           [gid of n particles][T0 of n particles]...[Tn of n particles]
+         With compression the gids are 32-bit and the types are packed with their codec
+      */
+      typedef Kokkos::View<char*, device_type> ByteView;
+      typedef Kokkos::View<std::size_t*, device_type> SizeView;
+      const bool compact = handle.compact_gids;
+      const int* codecs = handle.codecs.size() > 0 ? handle.codecs.data() : NULL;
+      std::vector<std::size_t> send_bytes(num_send_ranks + 1, 0);
+      std::vector<std::size_t> recv_bytes(num_recv_ranks + 1, 0);
+      for (lid_t i = 0; i < num_send_ranks; ++i) {
+        lid_t n = offset_send_particles_host(i+1) - offset_send_particles_host(i);
+        send_bytes[i+1] = send_bytes[i] + packedGidBytes(n, compact) +
+          PackedBytes<DataTypes>::bytes(n, codecs);
+      }
+      for (lid_t i = 0; i < num_recv_ranks; ++i) {
+        lid_t n = offset_recv_particles_host(i+1) - offset_recv_particles_host(i);
+        recv_bytes[i+1] = recv_bytes[i] + packedGidBytes(n, compact) +
+          PackedBytes<DataTypes>::bytes(n, codecs);
+      }
+      ByteView send_buffer = pool->template get<char>(exec_space, "migrate_send_buffer",
+                                                      send_bytes[num_send_ranks], false);
+      ByteView recv_buffer = pool->template get<char>(exec_space, "migrate_recv_buffer",
+                                                      recv_bytes[num_recv_ranks], false);
+      //Byte offset of the next type to pack/unpack in each message
+      SizeView send_type_offsets =
+        pool->template get<std::size_t>(exec_space, "migrate_send_type_offsets", num_send_ranks);
+      SizeView recv_type_offsets =
+        pool->template get<std::size_t>(exec_space, "migrate_recv_type_offsets", num_recv_ranks);
+      hostToDevice(send_type_offsets, send_bytes.data());
+      hostToDevice(recv_type_offsets, recv_bytes.data());
+
+      handle.recv_buffer = recv_buffer;
+      handle.recv_type_offsets = recv_type_offsets;
+
+      /* When MPI can not read device memory the messages go through persistent host
+           buffers (pinned on CUDA) with one copy of each buffer instead of per message
+           temporaries
+      */
+      const bool staged = NeedsStaging<device_type>::value;
+      Kokkos::View<char*, StagingDevice> send_stage, recv_stage;
+      char* send_data = send_buffer.data();
+      char* recv_data = recv_buffer.data();
+      if (staged) {
+        send_stage = staging_pool.template get<char>("migrate_send_stage",
+                                                     send_bytes[num_send_ranks], false);
+        recv_stage = staging_pool.template get<char>("migrate_recv_stage",
+                                                     recv_bytes[num_recv_ranks], false);
+        send_data = send_stage.data();
+        recv_data = recv_stage.data();
       }
-      //Receiving
-      lid_t num_recv = offset_recv_particles_host(i+1) - offset_recv_particles_host(i);
-      if (num_recv > 0) {
-        lid_t start_index = offset_recv_particles_host(i);
-        PS_Comm_Irecv(recv_element, start_index, num_recv, i, 0, MPI_COMM_WORLD,
-                      recv_requests + recv_num);
+      handle.recv_stage = recv_stage;
+      handle.recv_bytes = recv_bytes;
+
+      //Post the receives before packing
+      num_sends = num_sending_to;
+      num_recvs = num_receiving_from;
+      handle.send_requests.resize(num_sends);
+      handle.recv_requests.resize(num_recvs);
+      handle.recv_request_rank.resize(num_recvs);
+      send_requests = handle.send_requests.data();
+      recv_requests = handle.recv_requests.data();
+      for (lid_t i = 0; i < num_recv_ranks; ++i) {
+        const int rank = recv_ranks[i];
+        if (rank == comm_rank || recv_bytes[i+1] == recv_bytes[i])
+          continue;
+        MPI_Irecv(recv_data + recv_bytes[i], recv_bytes[i+1] - recv_bytes[i], MPI_CHAR, rank, 0,
+                  mpi_comm, recv_requests + recv_num);
+        handle.recv_request_rank[recv_num] = i;
         recv_num++;
-        RecvViews<device_type, DataTypes>(recv_particle,start_index, num_recv, i, 1,
-                                          recv_requests + recv_num);
-        recv_num+=num_types;
       }
+
+      //Pack the element gid of each sent particle followed by the data types
+      Kokkos::parallel_for("gatherParticlesToSend", block_policy,
+                           KOKKOS_LAMBDA(const TeamMember& team) {
+          const lid_t b = team.league_rank();
+          const lid_t first = b * block_size;
+          const lid_t last = first + block_size < cap ? first + block_size : cap;
+          for (lid_t dest = nextBlockDestination(team, send_rank_index, first, last, -1);
+               dest >= 0;
+               dest = nextBlockDestination(team, send_rank_index, first, last, dest)) {
+            const lid_t block_first = block_offsets(dest * num_blocks + b);
+            char* gids = send_buffer.data() + send_type_offsets(dest);
+            const lid_t message_first = offset_send_particles(dest);
+            Kokkos::parallel_scan(Kokkos::TeamThreadRange(team, first, last),
+                                  [=](const lid_t& i, lid_t& cur, const bool& final) {
+              if (send_rank_index(i) == dest) {
+                if (final) {
+                  const lid_t index = block_first + cur;
+                  send_index(i) = index;
+                  const gid_t gid = element_to_gid_local(new_element(i));
+                  if (compact)
+                    reinterpret_cast<int*>(gids)[index - message_first] = gid;
+                  else
+                    reinterpret_cast<gid_t*>(gids)[index - message_first] = gid;
+                }
+                ++cur;
+              }
+            });
+          }
+        });
+      Kokkos::parallel_for("migrate_gid_offsets", rangePolicy(num_send_ranks), KOKKOS_LAMBDA(const lid_t& i) {
+        send_type_offsets(i) += packedGidBytes(num_send_particles(i), compact);
+      });
+      PackParticles<SellCSigma<DataTypes, MemSpace>, DataTypes>(this, ptcl_data,
+                                                               send_rank_index, send_index,
+                                                               offset_send_particles,
+                                                               num_send_particles,
+                                                               send_type_offsets,
+                                                               send_buffer, codecs);
+      if (staged)
+        Kokkos::deep_copy(exec_space, send_stage, send_buffer);
+      exec_space.fence();
+
+      for (lid_t i = 0; i < num_send_ranks; ++i) {
+        const int rank = send_ranks[i];
+        if (rank == comm_rank || send_bytes[i+1] == send_bytes[i])
+          continue;
+        MPI_Isend(send_data + send_bytes[i], send_bytes[i+1] - send_bytes[i], MPI_CHAR, rank, 0,
+                  mpi_comm, send_requests + send_num);
+        send_num++;
+      }
+      recordKernelWork("ps_migrate", send_bytes[num_send_ranks], np_send);
+    }
+    else {
+      //Create arrays for particles being sent
+      kkLidView send_element = pool->template get<lid_t>(exec_space, "migrate_send_element",
+                                                         np_send);
+      //Views for each data type in send_particle[type]
+      MTVs send_particle = pool->template getMemberViews<DataTypes>("migrate_send_particle",
+                                                                    np_send);
+      Kokkos::parallel_for("gatherParticlesToSend", block_policy,
+                           KOKKOS_LAMBDA(const TeamMember& team) {
+          const lid_t b = team.league_rank();
+          const lid_t first = b * block_size;
+          const lid_t last = first + block_size < cap ? first + block_size : cap;
+          for (lid_t dest = nextBlockDestination(team, send_rank_index, first, last, -1);
+               dest >= 0;
+               dest = nextBlockDestination(team, send_rank_index, first, last, dest)) {
+            const lid_t block_first = block_offsets(dest * num_blocks + b);
+            Kokkos::parallel_scan(Kokkos::TeamThreadRange(team, first, last),
+                                  [=](const lid_t& i, lid_t& cur, const bool& final) {
+              if (send_rank_index(i) == dest) {
+                if (final) {
+                  send_index(i) = block_first + cur;
+                  send_element(block_first + cur) = element_to_gid_local(new_element(i));
+                }
+                ++cur;
+              }
+            });
+          }
+        });
+      //Copy the values from ptcl_data[type][particle_id] into send_particle[type](index) for each data type
+      CopyParticlesToSend<SellCSigma<DataTypes, MemSpace>, DataTypes>(this, send_particle,
+                                                                      ptcl_data,
+                                                                      new_process,
+                                                                      send_index, mpi_comm);
+
+      //Get pointers to the data for MPI calls
+      num_sends = num_sending_to * (num_types + 1);
+      num_recvs = num_receiving_from * (num_types + 1);
+      handle.send_requests.resize(num_sends);
+      handle.recv_requests.resize(num_recvs);
+      send_requests = handle.send_requests.data();
+      recv_requests = handle.recv_requests.data();
+      //Send the particles to each neighbor
+      for (lid_t i = 0; i < num_send_ranks; ++i) {
+        const int rank = send_ranks[i];
+        if (rank == comm_rank)
+          continue;
+        lid_t num_send = offset_send_particles_host(i+1) - offset_send_particles_host(i);
+        if (num_send > 0) {
+          lid_t start_index = offset_send_particles_host(i);
+          PS_Comm_Isend(send_element, start_index, num_send, rank, 0, mpi_comm,
+                        send_requests +send_num);
+          send_num++;
+          SendViews<device_type, DataTypes>(send_particle, start_index, num_send, rank, 1,
+                                            send_requests + send_num, mpi_comm);
+          send_num+=num_types;
+        }
+      }
+      recordKernelWork("ps_migrate", np_send * (PackedBytes<DataTypes>::bytes(1) +
+                                                sizeof(gid_t)), np_send);
+      //Receive particles from each neighbor
+      for (lid_t i = 0; i < num_recv_ranks; ++i) {
+        const int rank = recv_ranks[i];
+        if (rank == comm_rank)
+          continue;
+        lid_t num_recv = offset_recv_particles_host(i+1) - offset_recv_particles_host(i);
+        if (num_recv > 0) {
+          lid_t start_index = offset_recv_particles_host(i);
+          PS_Comm_Irecv(recv_element, start_index, num_recv, rank, 0, mpi_comm,
+                        recv_requests + recv_num);
+          recv_num++;
+          RecvViews<device_type, DataTypes>(recv_particle,start_index, num_recv, rank, 1,
+                                            recv_requests + recv_num, mpi_comm);
+          recv_num+=num_types;
+        }
+      }
+    }
+    handle.begin_time = timer.seconds();
+    Kokkos::Profiling::popRegion();
+    return handle;
+  }
+
+  template<class DataTypes, typename MemSpace>
+    void SellCSigma<DataTypes, MemSpace>::migrate_end(MigrateHandle& handle) {
+    if (!handle.active) {
+      fprintf(stderr, "[ERROR] migrate_end called without an active migration\n");
+      return;
     }
-    PS_Comm_Waitall<device_type>(num_recvs, recv_requests, MPI_STATUSES_IGNORE);
-    delete [] recv_requests;
+    Kokkos::Profiling::pushRegion("scs_migrate_end");
+    MemoryPhase memory_phase("scs_migrate_end");
+    Kokkos::Timer timer;
+    handle.active = false;
+    kkLidView new_element = handle.new_element;
+    kkLidView new_process = handle.new_process;
+    kkLidView new_particle_elements = handle.new_particle_elements;
+    MTVs new_particle_info = handle.new_particle_info;
+    int comm_size;
+    MPI_Comm_size(mpi_comm, &comm_size);
+    int comm_rank;
+    MPI_Comm_rank(mpi_comm, &comm_rank);
 
-    /********** Convert the received element from element gid to element lid *********/
+    if (!handle.communicate) {
+      rebuild(new_element, new_particle_elements, new_particle_info);
+      addRegionTime("ps_migrate", handle.begin_time + timer.seconds());
+      if((!comm_rank || comm_rank == comm_size/2) && timePrintsEnabled())
+        fprintf(stderr, "%d ps particle migration (seconds) %f\n", comm_rank,
+                handle.begin_time + timer.seconds());
+      Kokkos::Profiling::popRegion();
+      return;
+    }
+    const lid_t np_recv = handle.np_recv;
+    const lid_t num_recv_ranks = handle.num_recv_ranks;
+    const lid_t new_ptcls = new_particle_elements.size();
+    kkLidView recv_element = handle.recv_element;
+    MTVs recv_particle = handle.recv_particle;
+    kkLidView offset_recv_particles = handle.offset_recv_particles;
+    kkLidView num_recv_particles = handle.num_recv_particles;
     auto element_gid_to_lid_local = element_gid_to_lid;
-    Kokkos::parallel_for(np_recv, KOKKOS_LAMBDA(const lid_t& i) {
-        const gid_t gid = recv_element(i);
+    const bool compact = handle.compact_gids;
+    const int* codecs = handle.codecs.size() > 0 ? handle.codecs.data() : NULL;
+    Kokkos::Profiling::pushRegion("scs_migrate_wait");
+    if (handle.packed) {
+      Kokkos::View<char*, device_type> recv_buffer = handle.recv_buffer;
+      Kokkos::View<std::size_t*, device_type> recv_type_offsets = handle.recv_type_offsets;
+      if (handle.recv_stage.size() > 0) {
+        //Copy each message to the device as it arrives while the others are in flight
+        typedef Kokkos::pair<std::size_t, std::size_t> Range;
+        const int num_recvs = handle.recv_requests.size();
+        for (int i = 0; i < num_recvs; ++i) {
+          int index;
+          MPI_Waitany(num_recvs, handle.recv_requests.data(), &index, MPI_STATUS_IGNORE);
+          const int rank_index = handle.recv_request_rank[index];
+          Range range(handle.recv_bytes[rank_index], handle.recv_bytes[rank_index + 1]);
+          Kokkos::deep_copy(exec_space, Kokkos::subview(recv_buffer, range),
+                            Kokkos::subview(handle.recv_stage, range));
+        }
+      }
+      else
+        MPI_Waitall(handle.recv_requests.size(), handle.recv_requests.data(),
+                    MPI_STATUSES_IGNORE);
+      Kokkos::Profiling::popRegion();
+      /********** Unpack the received element gids as element lids and the data types *******/
+      Kokkos::parallel_for("migrate_recv_segments", rangePolicy(np_recv), KOKKOS_LAMBDA(const lid_t& i) {
+        const int segment = segmentOf(offset_recv_particles, num_recv_ranks, i);
+        const char* gids = recv_buffer.data() + recv_type_offsets(segment);
+        const lid_t index_in_segment = i - offset_recv_particles(segment);
+        const gid_t gid = compact ? reinterpret_cast<const int*>(gids)[index_in_segment] :
+          reinterpret_cast<const gid_t*>(gids)[index_in_segment];
         const lid_t index = element_gid_to_lid_local.find(gid);
         recv_element(i) = element_gid_to_lid_local.value_at(index);
       });
+      Kokkos::parallel_for("migrate_recv_gid_offsets", rangePolicy(num_recv_ranks), KOKKOS_LAMBDA(const lid_t& i) {
+        recv_type_offsets(i) += packedGidBytes(num_recv_particles(i), compact);
+      });
+    }
+    else {
+      PS_Comm_Waitall<device_type>(handle.recv_requests.size(), handle.recv_requests.data(),
+                                   MPI_STATUSES_IGNORE);
+      Kokkos::Profiling::popRegion();
+      /********** Convert the received element from element gid to element lid *********/
+      Kokkos::parallel_for("migrate_recv_gids", rangePolicy(np_recv), KOKKOS_LAMBDA(const lid_t& i) {
+          const gid_t gid = recv_element(i);
+          const lid_t index = element_gid_to_lid_local.find(gid);
+          recv_element(i) = element_gid_to_lid_local.value_at(index);
+        });
+    }
 
     /********** Set particles that were sent to non existent on this process *********/
     auto removeSentParticles = PS_LAMBDA(lid_t element_id, lid_t particle_id, lid_t mask) {
@@ -151,25 +595,172 @@ namespace particle_structs {
     };
     parallel_for(removeSentParticles);
 
-    /********** Add new particles to the migrated particles *********/
-    kkLidView new_ptcl_map("new_ptcl_map", new_ptcls);
-    Kokkos::parallel_for(new_ptcls, KOKKOS_LAMBDA(const lid_t& i) {
-        recv_element(np_recv + i) = new_particle_elements(i);
-        new_ptcl_map(i) = np_recv + i;
-    });
-    CopyViewsToViews<kkLidView, DataTypes>(recv_particle, new_particle_info, new_ptcl_map);
+    bool shuffled = false;
+    bool reshuffle_failed = false;
+    if (handle.packed) {
+      Kokkos::View<char*, device_type> recv_buffer = handle.recv_buffer;
+      Kokkos::View<std::size_t*, device_type> recv_type_offsets = handle.recv_type_offsets;
+      /* When the particles of this process reshuffle, the received particles are unpacked
+           from the buffer straight into holes of their rows, skipping recv_particle and the
+           rebuild
+      */
+      //Without received or new particles the rebuild below may be lazy
+      const bool lazy = lazy_threshold > 0 && np_recv == 0 && new_ptcls == 0;
+      if (!lazy && tryShuffling && row_sort_keys.size() == 0 && pad_strat != PAD_ADAPTIVE) {
+        const lid_t old_capacity = capacity_;
+        const lid_t old_slices = num_slices;
+        const lid_t old_active_slices = num_active_slices;
+        lid_t* old_mask = particle_mask.data();
+        shuffled = reshuffle(new_element, new_particle_elements, new_particle_info);
+        reshuffle_failed = !shuffled;
+        if (shuffled && np_recv > 0) {
+          kkLidView elements = pool->template get<lid_t>(exec_space, "migrate_recv_elements",
+                                                         np_recv, false);
+          Kokkos::parallel_for("migrate_recv_elements", rangePolicy(np_recv), KOKKOS_LAMBDA(const lid_t& i) {
+              elements(i) = recv_element(i);
+            });
+          kkLidView indices = pool->template get<lid_t>(exec_space, "migrate_recv_indices",
+                                                        np_recv, false);
+          kkLidView holes = pool->template get<lid_t>(exec_space, "migrate_recv_holes",
+                                                      np_recv, false);
+          if (fillHoles(elements, indices, holes)) {
+            kkLidView slots = pool->template get<lid_t>(exec_space, "migrate_recv_slots",
+                                                        np_recv, false);
+            Kokkos::parallel_for("migrate_recv_slots", rangePolicy(np_recv), KOKKOS_LAMBDA(const lid_t& i) {
+                slots(indices(i)) = holes(i);
+              });
+            UnpackViews<device_type, DataTypes>(ptcl_data, np_recv, offset_recv_particles,
+                                                num_recv_ranks, recv_type_offsets, recv_buffer,
+                                                slots, codecs);
+            if (id_member >= 0) {
+              kkLidView ids = idView(ptcl_data);
+              kkLidView index = id_to_slot;
+              kkLidView misses = id_index_misses;
+              Kokkos::parallel_for("migrate_index_ids", rangePolicy(np_recv),
+                                   KOKKOS_LAMBDA(const lid_t& i) {
+                  indexId(index, misses, ids(slots(i)), slots(i));
+                });
+              reportIdIndexMisses("migrate");
+            }
+            num_ptcls += np_recv;
+            if (skip_empty_slices)
+              updateActiveSlices();
+          }
+          else {
+            //Not enough holes, the received particles are added through a rebuild
+            UnpackViews<device_type, DataTypes>(recv_particle, np_recv, offset_recv_particles,
+                                                num_recv_ranks, recv_type_offsets, recv_buffer,
+                                                kkLidView(), codecs);
+            addParticles(elements, recv_particle);
+          }
+        }
+        if (shuffled) {
+          if (capacity_ != old_capacity || num_slices != old_slices ||
+              num_active_slices != old_active_slices || particle_mask.data() != old_mask)
+            ++layout_version;
+          //The rebuild is skipped, so the layout is recorded here as rebuild would
+          trackLayout();
+          updatePolicy();
+          checkAutotune();
+        }
+      }
+      if (!shuffled)
+        UnpackViews<device_type, DataTypes>(recv_particle, np_recv, offset_recv_particles,
+                                            num_recv_ranks, recv_type_offsets, recv_buffer,
+                                            kkLidView(), codecs);
+    }
+
+    if (!shuffled) {
+      /********** Add new particles to the migrated particles *********/
+      kkLidView new_ptcl_map = pool->template get<lid_t>(exec_space, "migrate_new_ptcl_map",
+                                                         new_ptcls);
+      Kokkos::parallel_for("migrate_new_elements", rangePolicy(new_ptcls), KOKKOS_LAMBDA(const lid_t& i) {
+          recv_element(np_recv + i) = new_particle_elements(i);
+          new_ptcl_map(i) = np_recv + i;
+      });
+      CopyViewsToViews<kkLidView, DataTypes>(recv_particle, new_particle_info, new_ptcl_map);
 
-    /********** Combine and shift particles to their new destination **********/
-    rebuild(new_element, recv_element, recv_particle);
+      /********** Combine and shift particles to their new destination **********/
+      //The reshuffle already failed above, so the rebuild goes straight to the full rebuild
+      const bool shuffling = tryShuffling;
+      const RebuildReason reason = last_rebuild_reason;
+      if (reshuffle_failed)
+        tryShuffling = false;
+      rebuild(new_element, recv_element, recv_particle);
+      tryShuffling = shuffling;
+      if (reshuffle_failed)
+        last_rebuild_reason = reason;
+    }
 
     //Cleanup
-    PS_Comm_Waitall<device_type>(num_sends, send_requests, MPI_STATUSES_IGNORE);
-    delete [] send_requests;
-    destroyViews<DataTypes, memory_space>(send_particle);
-    destroyViews<DataTypes, memory_space>(recv_particle);
-    if(!comm_rank || comm_rank == comm_size/2)
+    Kokkos::Profiling::pushRegion("scs_migrate_send_wait");
+    PS_Comm_Waitall<device_type>(handle.send_requests.size(), handle.send_requests.data(),
+                                 MPI_STATUSES_IGNORE);
+    Kokkos::Profiling::popRegion();
+    handle.send_requests.clear();
+    handle.recv_requests.clear();
+    addRegionTime("ps_migrate", handle.begin_time + timer.seconds());
+    addRegionTime("ps_migrate_prebarrier", handle.btime);
+    if((!comm_rank || comm_rank == comm_size/2) && timePrintsEnabled())
       fprintf(stderr, "%d ps particle migration (seconds) %f pre-barrier (seconds) %f\n",
-              comm_rank, timer.seconds(), btime);
+              comm_rank, handle.begin_time + timer.seconds(), handle.btime);
+    Kokkos::Profiling::popRegion();
+  }
+
+  template<class DataTypes, typename MemSpace>
+    void SellCSigma<DataTypes, MemSpace>::repartition(kkLidView new_process,
+                                                      kkGidView element_ids, lid_t ne,
+                                                      kkGidView new_element_ids) {
+    Kokkos::Profiling::pushRegion("scs_repartition");
+    int comm_rank;
+    MPI_Comm_rank(mpi_comm, &comm_rank);
+    //Particles are sent with the id of their current element
+    kkLidView new_element("repartition_new_element", capacity());
+    auto setCurrentElement = PS_LAMBDA(lid_t element_id, lid_t particle_id, bool mask) {
+      new_element(particle_id) = mask ? element_id : -1;
+    };
+    parallel_for(setCurrentElement, "setCurrentElement");
+    element_to_gid = element_ids;
+    updateCompactGids();
+    MigrateHandle handle = migrate_begin(new_element, new_process);
+
+    /* Switch to the new elements before migrate_end converts the received ids to lids
+         Particles staying on this process find their new element by id
+    */
+    GID_Mapping new_gid_to_lid(ne);
+    Kokkos::parallel_for("repartition_gid_to_lid", rangePolicy(ne), KOKKOS_LAMBDA(const lid_t& i) {
+        new_gid_to_lid.insert(new_element_ids(i), i);
+      });
+    kkLidView missing("repartition_missing", 1);
+    auto setStayingElement = PS_LAMBDA(lid_t element_id, lid_t particle_id, bool mask) {
+      if (mask && new_process(particle_id) == comm_rank) {
+        const lid_t index = new_gid_to_lid.find(element_ids(element_id));
+        const bool found = new_gid_to_lid.valid_at(index);
+        new_element(particle_id) = found ? new_gid_to_lid.value_at(index) : -1;
+        if (!found)
+          missing(0) = 1;
+      }
+    };
+    parallel_for(setStayingElement, "setStayingElement");
+    if (getLastValue<lid_t>(exec_space, missing))
+      fprintf(stderr, "[WARNING] Rank %d removed particles whose element is not one of its "
+              "new elements\n", comm_rank);
+    num_elems = ne;
+    element_gid_to_lid = new_gid_to_lid;
+
+    //Rows of the new elements only exist after a full rebuild
+    const bool shuffling = tryShuffling;
+    tryShuffling = false;
+    migrate_end(handle);
+    tryShuffling = shuffling;
+
+    const lid_t nrows = numRows() > ne ? numRows() : ne;
+    element_to_gid = kkGidView("row to element gid", nrows);
+    kkGidView element_to_gid_local = element_to_gid;
+    Kokkos::parallel_for("repartition_element_to_gid", rangePolicy(nrows), KOKKOS_LAMBDA(const lid_t& i) {
+        element_to_gid_local(i) = i < ne ? new_element_ids(i) : -1;
+      });
+    updateCompactGids();
     Kokkos::Profiling::popRegion();
   }
 }
@@ -5,11 +5,29 @@ namespace particle_structs {
     bool SellCSigma<DataTypes,MemSpace>::reshuffle(kkLidView new_element,
                                                    kkLidView new_particle_elements,
                                                    MTVs new_particles) {
+    if (!checkResident("reshuffle"))
+      return false;
+    //new_element holds the element of every particle, misplaced ones included
+    dropLazyElements();
+    ++reshuffle_attempts;
     //Count current/new particles per row
-    kkLidView new_particles_per_row("new_particles_per_row", numRows());
-    kkLidView num_holes_per_row("num_holes_per_row", numRows());
+    kkLidView new_particles_per_row = pool->template get<lid_t>(exec_space, "reshuffle_new_particles_per_row",
+                                                                     numRows());
+    kkLidView num_holes_per_row = pool->template get<lid_t>(exec_space, "reshuffle_num_holes_per_row",
+                                                                 numRows());
     kkLidView element_to_row_local = element_to_row;
     auto particle_mask_local = particle_mask;
+    if (id_member >= 0 && capacity_ > 0) {
+      //Particles leaving the structure leave the id index (before the mask drops them)
+      kkLidView ids = idView(ptcl_data);
+      kkLidView index = id_to_slot;
+      kkLidView misses = id_index_misses;
+      auto removeIds = PS_LAMBDA(lid_t, lid_t particle_id, bool mask) {
+        if (mask && new_element(particle_id) == -1)
+          indexId(index, misses, ids(particle_id), -1);
+      };
+      parallel_for(removeIds, "reshuffle_remove_ids");
+    }
     auto countNewParticles = PS_LAMBDA(lid_t element_id,lid_t particle_id, bool mask){
       const lid_t new_elem = new_element(particle_id);
 
@@ -23,30 +41,35 @@ namespace particle_structs {
       particle_mask_local(particle_id) = is_particle;
       Kokkos::atomic_fetch_add(&(num_holes_per_row(row)), !is_particle);
     };
-    parallel_for(countNewParticles, "countNewParticles");
+    //Holes are counted too so every slot is visited
+    parallel_for_slices(countNewParticles, "countNewParticles", false, false);
     // Add new particles to counts
-    Kokkos::parallel_for("reshuffle_count", new_particle_elements.size(), KOKKOS_LAMBDA(const lid_t& i) {
+    Kokkos::parallel_for("reshuffle_count", rangePolicy(new_particle_elements.size()), KOKKOS_LAMBDA(const lid_t& i) {
         const lid_t new_elem = new_particle_elements(i);
         const lid_t new_row = element_to_row_local(new_elem);
         Kokkos::atomic_fetch_add(&(new_particles_per_row(new_row)), 1);
       });
 
     //Check if the particles will fit in current structure
-    kkLidView fail("fail",1);
-    Kokkos::parallel_for(numRows(), KOKKOS_LAMBDA(const lid_t& i) {
+    kkLidView fail = pool->template get<lid_t>(exec_space, "reshuffle_fail", 1);
+    Kokkos::parallel_for("reshuffle_fail_check", rangePolicy(numRows()), KOKKOS_LAMBDA(const lid_t& i) {
         if( new_particles_per_row(i) > num_holes_per_row(i))
           fail(0) = 1;
       });
 
-    if (getLastValue<lid_t>(fail)) {
-      //Reshuffle fails
-      return false;
+    if (getLastValue<lid_t>(exec_space, fail)) {
+      //Borrow slots from the tail of the allocation, reshuffle fails if there are not enough
+      if (!addOverflowSlices(new_particles_per_row, num_holes_per_row))
+        return false;
+      particle_mask_local = particle_mask;
     }
 
     //Offset moving particles
-    kkLidView offset_new_particles("offset_new_particles", numRows() + 1);
-    kkLidView counting_offset_index("counting_offset_index", numRows() + 1);
-    Kokkos::parallel_scan(numRows(), KOKKOS_LAMBDA(const lid_t& i, lid_t& cur, const bool& final) {
+    kkLidView offset_new_particles =
+      pool->template get<lid_t>(exec_space, "reshuffle_offset_new_particles", numRows() + 1);
+    kkLidView counting_offset_index =
+      pool->template get<lid_t>(exec_space, "reshuffle_counting_offset_index", numRows() + 1);
+    Kokkos::parallel_scan("reshuffle_offsets", rangePolicy(numRows()), KOKKOS_LAMBDA(const lid_t& i, lid_t& cur, const bool& final) {
         cur += new_particles_per_row(i);
         if (final) {
           offset_new_particles(i+1) = cur;
@@ -54,20 +77,25 @@ namespace particle_structs {
         }
       });
 
-    int num_moving_ptcls = getLastValue<lid_t>(offset_new_particles);
+    int num_moving_ptcls = getLastValue<lid_t>(exec_space, offset_new_particles);
     if (num_moving_ptcls == 0) {
-      Kokkos::parallel_reduce(capacity(), KOKKOS_LAMBDA(const lid_t& i, lid_t& sum) {
+      Kokkos::parallel_reduce("reshuffle_count_particles", rangePolicy(capacity()), KOKKOS_LAMBDA(const lid_t& i, lid_t& sum) {
           sum += particle_mask_local(i);
         }, num_ptcls);
+      if (skip_empty_slices)
+        updateActiveSlices();
+      ++reshuffle_successes;
       return true;
     }
-    kkLidView movingPtclIndices("movingPtclIndices", num_moving_ptcls);
-    kkLidView isFromSCS("isFromSCS", num_moving_ptcls);
+    kkLidView movingPtclIndices = pool->template get<lid_t>(exec_space, "reshuffle_movingPtclIndices",
+                                                                num_moving_ptcls);
+    kkLidView isFromSCS = pool->template get<lid_t>(exec_space, "reshuffle_isFromSCS",
+                                                    num_moving_ptcls);
     //Gather moving particle list
     auto gatherMovingPtcls = PS_LAMBDA(const lid_t& element_id,const lid_t& particle_id, const bool& mask){
-      const lid_t new_elem = new_element(particle_id);
+      //Overflow slots are holes past the end of new_element
+      const lid_t new_elem = mask ? new_element(particle_id) : -1;
 
-      const lid_t row = element_to_row_local(element_id);
       const bool is_moving = new_elem != -1 & new_elem != element_id & mask;
       if (is_moving) {
         const lid_t new_row = element_to_row_local(new_elem);
@@ -79,7 +107,7 @@ namespace particle_structs {
     parallel_for(gatherMovingPtcls, "gatherMovingPtcls");
 
     //Gather new particles in list
-    Kokkos::parallel_for("reshuffle_count", new_particle_elements.size(), KOKKOS_LAMBDA(const lid_t& i) {
+    Kokkos::parallel_for("reshuffle_count", rangePolicy(new_particle_elements.size()), KOKKOS_LAMBDA(const lid_t& i) {
         const lid_t new_elem = new_particle_elements(i);
         const lid_t new_row = element_to_row_local(new_elem);
         const lid_t index = Kokkos::atomic_fetch_add(&(counting_offset_index(new_row)), 1);
@@ -88,7 +116,8 @@ namespace particle_structs {
       });
 
     //Assign hole index for moving particles
-    kkLidView holes("holeIndex", num_moving_ptcls);
+    kkLidView holes = pool->template get<lid_t>(exec_space, "reshuffle_holeIndex",
+                                                num_moving_ptcls);
     auto assignPtclsToHoles = PS_LAMBDA(const lid_t& element_id,const lid_t& particle_id, const bool& mask){
       const lid_t row = element_to_row_local(element_id);
       if (!mask) {
@@ -99,10 +128,10 @@ namespace particle_structs {
         }
       }
     };
-    parallel_for(assignPtclsToHoles, "assignPtclsToHoles");
+    parallel_for_slices(assignPtclsToHoles, "assignPtclsToHoles", false, false);
 
     //Update particle mask
-    Kokkos::parallel_for(num_moving_ptcls, KOKKOS_LAMBDA(const lid_t& i) {
+    Kokkos::parallel_for("reshuffle_moving_ptcls", rangePolicy(num_moving_ptcls), KOKKOS_LAMBDA(const lid_t& i) {
         const lid_t old_index = movingPtclIndices(i);
         const lid_t new_index = holes(i);
         const lid_t fromSCS = isFromSCS(i);
@@ -116,11 +145,334 @@ namespace particle_structs {
                                                                  new_particles,
                                                                  movingPtclIndices, holes,
                                                                  isFromSCS);
+    if (id_member >= 0) {
+      //Moved and new particles are indexed at their holes
+      kkLidView ids = idView(ptcl_data);
+      kkLidView index = id_to_slot;
+      kkLidView misses = id_index_misses;
+      Kokkos::parallel_for("reshuffle_index_ids", rangePolicy(num_moving_ptcls),
+                           KOKKOS_LAMBDA(const lid_t& i) {
+          const lid_t new_index = holes(i);
+          indexId(index, misses, ids(new_index), new_index);
+        });
+      reportIdIndexMisses("reshuffle");
+    }
 
     //Count number of active particles
-    Kokkos::parallel_reduce(capacity(), KOKKOS_LAMBDA(const lid_t& i, lid_t& sum) {
+    Kokkos::parallel_reduce("reshuffle_num_ptcls", rangePolicy(capacity()), KOKKOS_LAMBDA(const lid_t& i, lid_t& sum) {
         sum += particle_mask_local(i);
       }, num_ptcls);
+    if (skip_empty_slices)
+      updateActiveSlices();
+    ++reshuffle_successes;
+    recordKernelWork("ps_reshuffle", 2LL * num_moving_ptcls * PackedBytes<DataTypes>::bytes(1),
+                     num_moving_ptcls);
+    return true;
+  }
+
+  template<class DataTypes, typename MemSpace>
+    bool SellCSigma<DataTypes,MemSpace>::addParticles(kkLidView new_particle_elements,
+                                                      MTVs new_particles) {
+    if (!checkResident("addParticles"))
+      return false;
+    const lid_t num_new = new_particle_elements.size();
+    if (num_new == 0)
+      return true;
+    Kokkos::Profiling::pushRegion("scs_add_particles");
+    MemoryPhase memory_phase("scs_add_particles");
+    kkLidView newPtclIndices = pool->template get<lid_t>(exec_space, "add_newPtclIndices",
+                                                         num_new);
+    kkLidView holes = pool->template get<lid_t>(exec_space, "add_holeIndex", num_new);
+    if (!fillHoles(new_particle_elements, newPtclIndices, holes)) {
+      //Every particle stays in its element while the new particles are added
+      kkLidView new_element = pool->template get<lid_t>(exec_space, "add_new_element",
+                                                        capacity(), false);
+      auto stay = PS_LAMBDA(const lid_t& element_id, const lid_t& particle_id, const bool& mask) {
+        new_element(particle_id) = mask ? element_id : -1;
+      };
+      parallel_for_slices(stay, "add_stay", false, false);
+      rebuild(new_element, new_particle_elements, new_particles);
+      Kokkos::Profiling::popRegion();
+      return false;
+    }
+
+    kkLidView isFromSCS = pool->template get<lid_t>(exec_space, "add_isFromSCS", num_new);
+    ShuffleParticles<SellCSigma<DataTypes, MemSpace>, DataTypes>(ptcl_data,
+                                                                 new_particles,
+                                                                 newPtclIndices, holes,
+                                                                 isFromSCS);
+    if (id_member >= 0) {
+      kkLidView ids = idView(ptcl_data);
+      kkLidView index = id_to_slot;
+      kkLidView misses = id_index_misses;
+      Kokkos::parallel_for("add_index_ids", rangePolicy(num_new),
+                           KOKKOS_LAMBDA(const lid_t& i) {
+          const lid_t new_index = holes(i);
+          indexId(index, misses, ids(new_index), new_index);
+        });
+      reportIdIndexMisses("addParticles");
+    }
+    num_ptcls += num_new;
+    if (skip_empty_slices)
+      updateActiveSlices();
+    Kokkos::Profiling::popRegion();
+    return true;
+  }
+
+  template<class DataTypes, typename MemSpace>
+    bool SellCSigma<DataTypes,MemSpace>::fillHoles(kkLidView elements, kkLidView indices,
+                                                   kkLidView holes) {
+    //Sorted rows have no holes to fill
+    if (row_sort_keys.size() > 0)
+      return false;
+    const lid_t num_new = elements.size();
+    kkLidView element_to_row_local = element_to_row;
+    kkLidView new_particles_per_row = pool->template get<lid_t>(exec_space, "fill_new_particles_per_row",
+                                                                numRows());
+    kkLidView num_holes_per_row = pool->template get<lid_t>(exec_space, "fill_num_holes_per_row",
+                                                            numRows());
+    Kokkos::parallel_for("fill_count", rangePolicy(num_new), KOKKOS_LAMBDA(const lid_t& i) {
+        const lid_t new_row = element_to_row_local(elements(i));
+        Kokkos::atomic_fetch_add(&(new_particles_per_row(new_row)), 1);
+      });
+
+    //Holes are only counted in the rows receiving particles
+    const lid_t C_local = C_;
+    const PolicyType policy(exec_space, numRows(), Kokkos::AUTO);
+    {
+      auto chunk_offsets_cpy = chunk_offsets;
+      auto overflow_offsets_cpy = overflow_offsets;
+      auto overflow_widths_cpy = overflow_widths;
+      auto particle_mask_cpy = particle_mask;
+      Kokkos::parallel_for("fill_count_holes", policy, KOKKOS_LAMBDA(const TeamMember& team) {
+          const lid_t row = team.league_rank();
+          if (new_particles_per_row(row) == 0)
+            return;
+          const lid_t chunk = row / C_local;
+          const lid_t row_in_chunk = row % C_local;
+          const lid_t start = chunk_offsets_cpy(chunk);
+          const RowParticles slots(start + row_in_chunk, C_local,
+                                   (chunk_offsets_cpy(chunk+1) - start) / C_local,
+                                   overflow_offsets_cpy(chunk) + row_in_chunk,
+                                   overflow_widths_cpy(chunk), particle_mask_cpy);
+          lid_t holes = 0;
+          Kokkos::parallel_reduce(Kokkos::TeamThreadRange(team, slots.size()),
+                                  [=](const lid_t& i, lid_t& sum) {
+            sum += !slots.mask(i);
+          }, holes);
+          Kokkos::single(Kokkos::PerTeam(team), [=]() {
+            num_holes_per_row(row) = holes;
+          });
+        });
+    }
+    kkLidView fail = pool->template get<lid_t>(exec_space, "fill_fail", 1);
+    Kokkos::parallel_for("fill_overflow_check", rangePolicy(numRows()), KOKKOS_LAMBDA(const lid_t& i) {
+        if (new_particles_per_row(i) > num_holes_per_row(i))
+          fail(0) = 1;
+      });
+    if (getLastValue<lid_t>(exec_space, fail) &&
+        !addOverflowSlices(new_particles_per_row, num_holes_per_row))
+      return false;
+
+    //Offset and gather the new particles by row
+    kkLidView offset_new_particles =
+      pool->template get<lid_t>(exec_space, "fill_offset_new_particles", numRows() + 1);
+    kkLidView counting_offset_index =
+      pool->template get<lid_t>(exec_space, "fill_counting_offset_index", numRows() + 1);
+    Kokkos::parallel_scan("fill_offsets", rangePolicy(numRows()), KOKKOS_LAMBDA(const lid_t& i, lid_t& cur, const bool& final) {
+        cur += new_particles_per_row(i);
+        if (final) {
+          offset_new_particles(i+1) = cur;
+          counting_offset_index(i+1) = cur;
+        }
+      });
+    Kokkos::parallel_for("fill_gather", rangePolicy(num_new), KOKKOS_LAMBDA(const lid_t& i) {
+        const lid_t new_row = element_to_row_local(elements(i));
+        const lid_t index = Kokkos::atomic_fetch_add(&(counting_offset_index(new_row)), 1);
+        indices(index) = i;
+      });
+
+    //The first holes of each receiving row (including a new overflow slice) take the particles
+    {
+      auto chunk_offsets_cpy = chunk_offsets;
+      auto overflow_offsets_cpy = overflow_offsets;
+      auto overflow_widths_cpy = overflow_widths;
+      auto particle_mask_cpy = particle_mask;
+      Kokkos::parallel_for("fill_assign_holes", policy, KOKKOS_LAMBDA(const TeamMember& team) {
+          const lid_t row = team.league_rank();
+          const lid_t need = new_particles_per_row(row);
+          if (need == 0)
+            return;
+          const lid_t chunk = row / C_local;
+          const lid_t row_in_chunk = row % C_local;
+          const lid_t start = chunk_offsets_cpy(chunk);
+          const RowParticles slots(start + row_in_chunk, C_local,
+                                   (chunk_offsets_cpy(chunk+1) - start) / C_local,
+                                   overflow_offsets_cpy(chunk) + row_in_chunk,
+                                   overflow_widths_cpy(chunk), particle_mask_cpy);
+          const lid_t first = offset_new_particles(row);
+          Kokkos::parallel_scan(Kokkos::TeamThreadRange(team, slots.size()),
+                                [=](const lid_t& i, lid_t& cur, const bool& final) {
+            if (!slots.mask(i)) {
+              if (final && cur < need)
+                holes(first + cur) = slots(i);
+              ++cur;
+            }
+          });
+        });
+    }
+    auto particle_mask_local = particle_mask;
+    Kokkos::parallel_for("fill_mask", rangePolicy(num_new), KOKKOS_LAMBDA(const lid_t& i) {
+        particle_mask_local(holes(i)) = 1;
+      });
+    return true;
+  }
+
+  template<class DataTypes, typename MemSpace>
+    bool SellCSigma<DataTypes,MemSpace>::addOverflowSlices(kkLidView new_particles_per_row,
+                                                           kkLidView num_holes_per_row) {
+    //Width needed by each chunk to fit its rows with more incoming particles than holes
+    const lid_t nchunks = num_chunks;
+    const lid_t C_local = C_;
+    kkLidView chunk_need = pool->template get<lid_t>(exec_space, "overflow_chunk_need", nchunks);
+    Kokkos::parallel_for("overflow_need", rangePolicy(numRows()), KOKKOS_LAMBDA(const lid_t& i) {
+        const lid_t deficit = new_particles_per_row(i) - num_holes_per_row(i);
+        if (deficit > 0)
+          Kokkos::atomic_fetch_max(&chunk_need(i / C_local), deficit);
+      });
+    //A chunk can only borrow one overflow slice between full rebuilds
+    kkLidView overflow_offsets_local = overflow_offsets;
+    kkLidView overflow_widths_local = overflow_widths;
+    lid_t blocked = 0;
+    Kokkos::parallel_reduce("overflow_blocked", rangePolicy(nchunks),
+                            KOKKOS_LAMBDA(const lid_t& i, lid_t& sum) {
+        sum += chunk_need(i) > 0 && overflow_widths_local(i) > 0;
+      }, blocked);
+    if (blocked) {
+      last_rebuild_reason = REBUILD_OVERFLOW_TAKEN;
+      return false;
+    }
+    kkLidView slot_offsets = pool->template get<lid_t>(exec_space, "overflow_slot_offsets",
+                                                       nchunks + 1);
+    kkLidView slice_index = pool->template get<lid_t>(exec_space, "overflow_slice_index",
+                                                      nchunks + 1);
+    Kokkos::parallel_scan("overflow_offsets", rangePolicy(nchunks),
+                          KOKKOS_LAMBDA(const lid_t& i, lid_t& cur, const bool& final) {
+        cur += chunk_need(i) * C_local;
+        if (final)
+          slot_offsets(i+1) = cur;
+      });
+    Kokkos::parallel_scan("overflow_slices", rangePolicy(nchunks),
+                          KOKKOS_LAMBDA(const lid_t& i, lid_t& cur, const bool& final) {
+        cur += chunk_need(i) > 0;
+        if (final)
+          slice_index(i+1) = cur;
+      });
+    const lid_t new_slots = getLastValue<lid_t>(exec_space, slot_offsets);
+    const lid_t new_slices = getLastValue<lid_t>(exec_space, slice_index);
+    //Full rebuild when the allocation has no room left
+    const lid_t old_cap = capacity_;
+    if ((std::size_t)(old_cap + new_slots) > current_size) {
+      last_rebuild_reason = REBUILD_NO_CAPACITY;
+      return false;
+    }
+
+    //Append one slice per chunk in need after the current capacity
+    const lid_t old_slices = num_slices;
+    typedef Kokkos::pair<lid_t, lid_t> Range;
+    kkLidView new_offsets("offsets", old_slices + new_slices + 1);
+    kkLidView new_slice_to_chunk("slice_to_chunk", old_slices + new_slices);
+    Kokkos::deep_copy(exec_space, Kokkos::subview(new_offsets, Range(0, old_slices + 1)),
+                      Kokkos::subview(offsets, Range(0, old_slices + 1)));
+    Kokkos::deep_copy(exec_space, Kokkos::subview(new_slice_to_chunk, Range(0, old_slices)),
+                      Kokkos::subview(slice_to_chunk, Range(0, old_slices)));
+    Kokkos::parallel_for("overflow_slices", rangePolicy(nchunks), KOKKOS_LAMBDA(const lid_t& i) {
+        const lid_t need = chunk_need(i);
+        if (need > 0) {
+          const lid_t slice = old_slices + slice_index(i);
+          new_slice_to_chunk(slice) = i;
+          new_offsets(slice + 1) = old_cap + slot_offsets(i+1);
+          overflow_offsets_local(i) = old_cap + slot_offsets(i);
+          overflow_widths_local(i) = need;
+        }
+      });
+    Kokkos::parallel_for("overflow_holes", rangePolicy(numRows()), KOKKOS_LAMBDA(const lid_t& i) {
+        num_holes_per_row(i) += chunk_need(i / C_local);
+      });
+    kkLidView new_particle_mask("particle_mask", old_cap + new_slots);
+    Kokkos::deep_copy(exec_space, Kokkos::subview(new_particle_mask, Range(0, old_cap)),
+                      Kokkos::subview(particle_mask, Range(0, old_cap)));
+    particle_mask = new_particle_mask;
+    offsets = new_offsets;
+    slice_to_chunk = new_slice_to_chunk;
+    num_slices = old_slices + new_slices;
+    capacity_ = old_cap + new_slots;
+    return true;
+  }
+
+  template<class DataTypes, typename MemSpace>
+    bool SellCSigma<DataTypes,MemSpace>::recordLazyRebuild(kkLidView new_element,
+                                                           kkLidView new_particle_elements) {
+    //New particles, sorted rows and full rebuilds need the particles in their rows
+    if (lazy_threshold <= 0 || !tryShuffling || row_sort_keys.size() > 0 ||
+        new_particle_elements.size() > 0 || capacity_ == 0)
+      return false;
+    kkLidView misplaced = pool->template get<lid_t>(exec_space, "lazy_misplaced", 1);
+    kkLidView removed = pool->template get<lid_t>(exec_space, "lazy_removed", 1);
+    auto countMisplaced = PS_LAMBDA(const lid_t& element_id, const lid_t& particle_id,
+                                    const bool& mask) {
+      if (mask) {
+        const lid_t new_elem = new_element(particle_id);
+        if (new_elem == -1)
+          Kokkos::atomic_fetch_add(&(removed(0)), 1);
+        else if (new_elem != element_id)
+          Kokkos::atomic_fetch_add(&(misplaced(0)), 1);
+      }
+    };
+    parallel_for_slices(countMisplaced, "lazy_count_misplaced", skip_empty_slices, true, true);
+    const lid_t num_removed = getLastValue<lid_t>(exec_space, removed);
+    const lid_t new_misplaced = getLastValue<lid_t>(exec_space, misplaced);
+    const lid_t remaining = num_ptcls - num_removed;
+    if (remaining == 0 || new_misplaced > lazy_threshold * remaining)
+      return false;
+
+    if (current_element.size() < (std::size_t)capacity_) {
+      current_element = kkLidView("current_element", capacity_);
+      ++layout_version;
+    }
+    else if ((num_misplaced > 0) != (new_misplaced > 0))
+      ++layout_version;
+    if (id_member >= 0 && num_removed > 0) {
+      //Particles leaving the structure leave the id index (before the mask drops them)
+      kkLidView ids = idView(ptcl_data);
+      kkLidView index = id_to_slot;
+      kkLidView misses = id_index_misses;
+      auto removeIds = PS_LAMBDA(lid_t, lid_t particle_id, bool mask) {
+        if (mask && new_element(particle_id) == -1)
+          indexId(index, misses, ids(particle_id), -1);
+      };
+      parallel_for_slices(removeIds, "lazy_remove_ids", skip_empty_slices, true, true);
+    }
+    //Every slot is recorded, holes and particles in the row of their element as -1
+    kkLidView current_element_local = current_element;
+    kkLidView particle_mask_local = particle_mask;
+    auto recordElements = PS_LAMBDA(const lid_t& element_id, const lid_t& particle_id,
+                                    const bool& mask) {
+      //Overflow slots are holes past the end of new_element
+      const lid_t new_elem = mask ? new_element(particle_id) : -1;
+      current_element_local(particle_id) = new_elem == element_id ? -1 : new_elem;
+      if (new_elem == -1)
+        particle_mask_local(particle_id) = 0;
+    };
+    parallel_for_slices(recordElements, "lazy_record_elements", false, false, true);
+    num_misplaced = new_misplaced;
+    num_ptcls = remaining;
+    if (num_removed > 0 && skip_empty_slices) {
+      const lid_t old_active_slices = num_active_slices;
+      updateActiveSlices();
+      if (num_active_slices != old_active_slices)
+        ++layout_version;
+    }
     return true;
   }
 
@@ -128,19 +480,56 @@ namespace particle_structs {
     void SellCSigma<DataTypes,MemSpace>::rebuild(kkLidView new_element,
                                                  kkLidView new_particle_elements,
                                                  MTVs new_particles) {
-    const auto btime = prebarrier();
+    if (!checkResident("rebuild"))
+      return;
+    const auto btime = prebarrier(mpi_comm);
+    recordImbalance("ps_rebuild", btime, num_ptcls);
     Kokkos::Profiling::pushRegion("scs_rebuild");
+    MemoryPhase memory_phase("scs_rebuild");
     Kokkos::Timer timer;
     int comm_rank, comm_size;
-    MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
-    MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+    MPI_Comm_rank(mpi_comm, &comm_rank);
+    MPI_Comm_size(mpi_comm, &comm_size);
+
+    if (pad_strat == PAD_ADAPTIVE)
+      trackInflow(new_element, new_particle_elements);
+
+    if (recordLazyRebuild(new_element, new_particle_elements)) {
+      addRegionTime("ps_lazy_rebuild", timer.seconds());
+      trackLayout();
+      Kokkos::Profiling::popRegion();
+      return;
+    }
+    //From here on new_element places every particle
+    dropLazyElements();
 
     //If tryShuffling is on and shuffling works then rebuild is complete
-    if (tryShuffling && reshuffle(new_element, new_particle_elements, new_particles)) {
+    const bool sort_rows = row_sort_keys.size() > 0;
+    if (!tryShuffling)
+      last_rebuild_reason = REBUILD_SHUFFLING_OFF;
+    else if (sort_rows)
+      last_rebuild_reason = REBUILD_ROW_SORT;
+    const lid_t old_capacity = capacity_;
+    const lid_t old_slices = num_slices;
+    const lid_t old_active_slices = num_active_slices;
+    lid_t* old_mask = particle_mask.data();
+    if (tryShuffling && !sort_rows &&
+        reshuffle(new_element, new_particle_elements, new_particles)) {
+      //Overflow slices and changes of the active slices alter the launches
+      if (capacity_ != old_capacity || num_slices != old_slices ||
+          num_active_slices != old_active_slices || particle_mask.data() != old_mask)
+        ++layout_version;
+      addRegionTime("ps_reshuffle", timer.seconds());
+      trackLayout();
+      updatePolicy();
       Kokkos::Profiling::popRegion();
+      checkAutotune();
       return;
     }
-    kkLidView new_particles_per_elem("new_particles_per_elem", numRows());
+    //The elements may outnumber the current rows after repartition
+    const lid_t num_counts = numRows() > num_elems ? numRows() : num_elems;
+    kkLidView new_particles_per_elem =
+      pool->template get<lid_t>(exec_space, "rebuild_new_particles_per_elem", num_counts);
     auto countNewParticles = PS_LAMBDA(lid_t element_id,lid_t particle_id, bool mask){
       const lid_t new_elem = new_element(particle_id);
       if (new_elem != -1)
@@ -148,20 +537,28 @@ namespace particle_structs {
     };
     parallel_for(countNewParticles, "countNewParticles");
     // Add new particles to counts
-    Kokkos::parallel_for("rebuild_count", new_particle_elements.size(), KOKKOS_LAMBDA(const lid_t& i) {
+    Kokkos::parallel_for("rebuild_count", rangePolicy(new_particle_elements.size()), KOKKOS_LAMBDA(const lid_t& i) {
         const lid_t new_elem = new_particle_elements(i);
         Kokkos::atomic_fetch_add(&(new_particles_per_elem(new_elem)), 1);
       });
     lid_t activePtcls;
-    Kokkos::parallel_reduce(numRows(), KOKKOS_LAMBDA(const lid_t& i, lid_t& sum) {
+    Kokkos::parallel_reduce("rebuild_active_ptcls", rangePolicy(num_counts), KOKKOS_LAMBDA(const lid_t& i, lid_t& sum) {
         sum+= new_particles_per_elem(i);
       }, activePtcls);
     //If there are no particles left, then destroy the structure
     if(activePtcls == 0) {
+      if (id_member >= 0)
+        Kokkos::deep_copy(exec_space, id_to_slot, -1);
+      row_sort_keys = kkGidView();
+      new_row_sort_keys = kkGidView();
       num_ptcls = 0;
       num_slices = 0;
       capacity_ = 0;
       num_rows = 0;
+      num_active_slices = 0;
+      ++layout_version;
+      trackLayout();
+      updatePolicy();
       return;
     }
     lid_t new_num_ptcls = activePtcls;
@@ -189,28 +586,48 @@ namespace particle_structs {
     //Create offsets into each chunk/vertical slice
     constructOffsets(new_nchunks, new_num_slices, chunk_widths, new_offsets, new_slice_to_chunk,
                      new_capacity);
+    kkLidView new_chunk_offsets;
+    constructChunkOffsets(new_nchunks, chunk_widths, new_chunk_offsets);
 
     //Allocate the SCS
-    lid_t new_cap = getLastValue<lid_t>(new_offsets);
-    kkLidView new_particle_mask("new_particle_mask", new_cap);
-    if (swap_size < new_cap) {
-      destroyViews<DataTypes, memory_space>(scs_data_swap);
-      CreateViews<device_type, DataTypes>(scs_data_swap, new_cap*1.1);
+    lid_t new_cap = getLastValue<lid_t>(exec_space, new_offsets);
+    //Reuse the mask from the previous rebuild if it is large enough
+    kkLidView new_particle_mask;
+    if (particle_mask_swap.size() >= (std::size_t)new_cap) {
+      new_particle_mask = Kokkos::subview(particle_mask_swap, std::make_pair(0, new_cap));
+      Kokkos::deep_copy(exec_space, new_particle_mask, 0);
+    }
+    else
+      new_particle_mask = kkLidView("new_particle_mask", new_cap);
+    if (low_memory_rebuild) {
+      //The swap views are not kept between rebuilds
+      if (swap_size > 0) {
+        destroyViews<DataTypes, memory_space>(scs_data_swap);
+        scs_data_swap = NULL;
+        swap_size = 0;
+      }
+    }
+    else if (swap_size < new_cap) {
+      if (scs_data_swap)
+        destroyViews<DataTypes, memory_space>(scs_data_swap);
+      CreateViews<device_type, DataTypes>(scs_data_swap, new_cap*1.1, "scs_particle_data");
       swap_size = new_cap * 1.1;
     }
 
 
     /* //Fill the SCS */
-    kkLidView interior_slice_of_chunk("interior_slice_of_chunk", new_num_slices);
-    Kokkos::parallel_for("set_interior_slice_of_chunk", Kokkos::RangePolicy<>(1,new_num_slices),
+    kkLidView interior_slice_of_chunk =
+      pool->template get<lid_t>(exec_space, "rebuild_interior_slice_of_chunk", new_num_slices);
+    Kokkos::parallel_for("set_interior_slice_of_chunk", rangePolicy(1,new_num_slices),
                          KOKKOS_LAMBDA(const lid_t& i) {
                            const lid_t my_chunk = new_slice_to_chunk(i);
                            const lid_t prev_chunk = new_slice_to_chunk(i-1);
                            interior_slice_of_chunk(i) = my_chunk == prev_chunk;
                          });
     lid_t C_local = C_;
-    kkLidView element_index("element_index", new_nchunks * C_local);
-    Kokkos::parallel_for("set_element_index", new_num_slices, KOKKOS_LAMBDA(const lid_t& i) {
+    kkLidView element_index = pool->template get<lid_t>(exec_space, "rebuild_element_index",
+                                                           new_nchunks * C_local);
+    Kokkos::parallel_for("set_element_index", rangePolicy(new_num_slices), KOKKOS_LAMBDA(const lid_t& i) {
         const lid_t chunk = new_slice_to_chunk(i);
         for (lid_t e = 0; e < C_local; ++e) {
           Kokkos::atomic_fetch_add(&element_index(chunk*C_local + e),
@@ -218,35 +635,84 @@ namespace particle_structs {
         }
       });
     C_ = old_C;
-    kkLidView new_indices("new_scs_index", capacity());
-    auto copySCS = PS_LAMBDA(lid_t elm_id, lid_t ptcl_id, bool mask) {
-      const lid_t new_elem = new_element(ptcl_id);
-      //TODO remove conditional
-      if (mask && new_elem != -1) {
-        const lid_t new_row = new_element_to_row(new_elem);
-        new_indices(ptcl_id) = Kokkos::atomic_fetch_add(&element_index(new_row), new_C);
-        const lid_t new_index = new_indices(ptcl_id);
-        new_particle_mask(new_index) = 1;
+    kkLidView new_indices = pool->template get<lid_t>(exec_space, "rebuild_new_scs_index",
+                                                      capacity());
+    lid_t num_new_ptcls = new_particle_elements.size();
+    kkLidView new_particle_indices =
+      pool->template get<lid_t>(exec_space, "rebuild_new_particle_scs_indices", num_new_ptcls);
+    if (sort_rows) {
+      //Place the particles of each row in key order
+      rowSort(new_element, new_particle_elements, new_element_to_row, element_index, new_C,
+              new_nchunks * new_C, new_num_ptcls, new_indices, new_particle_indices,
+              new_particle_mask);
+      row_sort_keys = kkGidView();
+      new_row_sort_keys = kkGidView();
+    }
+    else {
+      auto copySCS = PS_LAMBDA(lid_t elm_id, lid_t ptcl_id, bool mask) {
+        const lid_t new_elem = new_element(ptcl_id);
+        //TODO remove conditional
+        if (mask && new_elem != -1) {
+          const lid_t new_row = new_element_to_row(new_elem);
+          new_indices(ptcl_id) = Kokkos::atomic_fetch_add(&element_index(new_row), new_C);
+          const lid_t new_index = new_indices(ptcl_id);
+          new_particle_mask(new_index) = 1;
+        }
+      };
+      parallel_for(copySCS);
+
+      Kokkos::parallel_for("set_new_particle", rangePolicy(num_new_ptcls), KOKKOS_LAMBDA(const lid_t& i) {
+          lid_t new_elem = new_particle_elements(i);
+          lid_t new_row = new_element_to_row(new_elem);
+          new_particle_indices(i) = Kokkos::atomic_fetch_add(&element_index(new_row), new_C);
+          lid_t new_index = new_particle_indices(i);
+          new_particle_mask(new_index) = 1;
+        });
+    }
+
+    if (id_member >= 0) {
+      //Remap the id index with the new slots of the old and new particles
+      kkLidView ids = idView(ptcl_data);
+      kkLidView index = id_to_slot;
+      kkLidView misses = id_index_misses;
+      auto remapIds = PS_LAMBDA(lid_t, lid_t ptcl_id, bool mask) {
+        if (mask)
+          indexId(index, misses, ids(ptcl_id),
+                  new_element(ptcl_id) != -1 ? new_indices(ptcl_id) : -1);
+      };
+      parallel_for(remapIds, "rebuild_remap_ids");
+      if (num_new_ptcls > 0) {
+        kkLidView new_ids = idView(new_particles);
+        Kokkos::parallel_for("rebuild_index_new_ids", rangePolicy(num_new_ptcls),
+                             KOKKOS_LAMBDA(const lid_t& i) {
+            indexId(index, misses, new_ids(i), new_particle_indices(i));
+          });
       }
-    };
-    parallel_for(copySCS);
+      reportIdIndexMisses("rebuild");
+    }
+    if (low_memory_rebuild) {
+      //Each type moves to a view of the new layout and its old view is freed
+      const std::size_t new_size = new_cap * 1.1;
+      ReplacePSViews<SellCSigma<DataTypes, MemSpace>, DataTypes>(this, ptcl_data, new_particles,
+                                                                 new_element, new_indices,
+                                                                 new_particle_indices,
+                                                                 new_size);
+      current_size = new_size;
+    }
+    else {
+      CopyPSToPS<SellCSigma<DataTypes, MemSpace>, DataTypes>(this, scs_data_swap, ptcl_data,
+                                                             new_element, new_indices);
+      //Add new particles
 
-    CopyPSToPS<SellCSigma<DataTypes, MemSpace>, DataTypes>(this, scs_data_swap, ptcl_data,
-                                                           new_element, new_indices);
-    //Add new particles
-    lid_t num_new_ptcls = new_particle_elements.size();
-    kkLidView new_particle_indices("new_particle_scs_indices", num_new_ptcls);
-
-    Kokkos::parallel_for("set_new_particle", num_new_ptcls, KOKKOS_LAMBDA(const lid_t& i) {
-        lid_t new_elem = new_particle_elements(i);
-        lid_t new_row = new_element_to_row(new_elem);
-        new_particle_indices(i) = Kokkos::atomic_fetch_add(&element_index(new_row), new_C);
-        lid_t new_index = new_particle_indices(i);
-        new_particle_mask(new_index) = 1;
-      });
+      if (new_particle_elements.size() > 0)
+        CopyViewsToViews<kkLidView, DataTypes>(scs_data_swap, new_particles,
+                                               new_particle_indices);
+    }
 
-    if (new_particle_elements.size() > 0)
-      CopyViewsToViews<kkLidView, DataTypes>(scs_data_swap, new_particles, new_particle_indices);
+    //The new layout is held together with the current one until the swap
+    trackLayout(viewBytes(new_row_to_element) + viewBytes(new_element_to_row) +
+                viewBytes(new_offsets) + viewBytes(new_chunk_offsets) +
+                viewBytes(new_slice_to_chunk) + viewBytes(new_particle_mask));
 
     //set scs to point to new values
     C_ = new_C;
@@ -258,18 +724,34 @@ namespace particle_structs {
     row_to_element = new_row_to_element;
     element_to_row = new_element_to_row;
     offsets = new_offsets;
+    chunk_offsets = new_chunk_offsets;
+    overflow_offsets = kkLidView("overflow_offsets", num_chunks);
+    overflow_widths = kkLidView("overflow_widths", num_chunks);
     slice_to_chunk = new_slice_to_chunk;
+    particle_mask_swap = particle_mask;
     particle_mask = new_particle_mask;
-    MTVs tmp = ptcl_data;
-    ptcl_data = scs_data_swap;
-    scs_data_swap = tmp;
-    std::size_t tmp_size = current_size;
-    current_size = swap_size;
-    swap_size = tmp_size;
-    if(!comm_rank || comm_rank == comm_size/2)
+    if (!low_memory_rebuild) {
+      MTVs tmp = ptcl_data;
+      ptcl_data = scs_data_swap;
+      scs_data_swap = tmp;
+      std::size_t tmp_size = current_size;
+      current_size = swap_size;
+      swap_size = tmp_size;
+    }
+    if (skip_empty_slices)
+      updateActiveSlices();
+    trackLayout();
+    updatePolicy();
+    ++layout_version;
+    recordKernelWork("ps_rebuild", 2LL * num_ptcls * PackedBytes<DataTypes>::bytes(1),
+                     num_ptcls);
+    addRegionTime("ps_rebuild", timer.seconds());
+    addRegionTime("ps_rebuild_prebarrier", btime);
+    if((!comm_rank || comm_rank == comm_size/2) && timePrintsEnabled())
       fprintf(stderr, "%d ps rebuild (seconds) %f pre-barrier (seconds) %f\n",
               comm_rank, timer.seconds(), btime);
     Kokkos::Profiling::popRegion();
+    checkAutotune();
   }
 
 }
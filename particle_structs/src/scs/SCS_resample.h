@@ -0,0 +1,140 @@
+#pragma once
+
+namespace particle_structs {
+  template<class DataTypes, typename MemSpace>
+  template <int PTCL_W, int PTCL_V>
+  lid_t SellCSigma<DataTypes,MemSpace>::resample(lid_t max_ptcls, lid_t min_ptcls) {
+    if (max_ptcls < 2 || (min_ptcls > 0 && 2 * min_ptcls > max_ptcls)) {
+      fprintf(stderr, "[ERROR] resample requires 2 <= max_ptcls and 2 * min_ptcls <= "
+              "max_ptcls (given %d and %d)\n", max_ptcls, min_ptcls);
+      return 0;
+    }
+    if (!checkResident("resample"))
+      return 0;
+    flushLazyRebuild();
+    Kokkos::Profiling::pushRegion("scs_resample");
+    auto w = this->template get<PTCL_W>();
+    auto v = this->template get<PTCL_V>();
+    kkLidView new_element = pool->template get<lid_t>(exec_space, "resample_new_element",
+                                                      capacity_, false);
+    kkLidView split = pool->template get<lid_t>(exec_space, "resample_split", capacity_);
+    kkLidView num_changed = pool->template get<lid_t>(exec_space, "resample_num_changed", 1);
+    //Holes are skipped with skip_masked, so they are marked removed beforehand
+    Kokkos::deep_copy(exec_space, new_element, -1);
+    auto keepParticles = PS_LAMBDA(const lid_t& elm_id, const lid_t& ptcl_id, const bool& mask) {
+      new_element(ptcl_id) = mask ? elm_id : -1;
+    };
+    parallel_for(keepParticles, "resample_keep_particles");
+
+    /* Dense elements: the particles are partitioned into max_ptcls / 2 runs, each merged into
+         its first two particles with half the weight of the run each. With W, P and E the
+         weight, momentum (sum w v) and energy (sum w |v|^2) of the run, the two particles move
+         at P / W +- s d, s^2 = E / W - |P / W|^2, which conserves all three.
+       Sparse elements: up to min_ptcls - n particles split in two, each with half the weight
+    */
+    const lid_t num_runs_max = max_ptcls / 2;
+    auto resampleElement = PS_LAMBDA(const TeamMember& team, const lid_t& elm_id,
+                                     const ElementGroup& group) {
+      const lid_t n = group.size();
+      if (n > max_ptcls) {
+        Kokkos::parallel_for(Kokkos::TeamThreadRange(team, num_runs_max), [=](const lid_t& r) {
+          const lid_t first = (lid_t)((long)r * n / num_runs_max);
+          const lid_t last = (lid_t)((long)(r + 1) * n / num_runs_max);
+          double W = 0, E = 0;
+          double P[3] = {0, 0, 0};
+          for (lid_t i = first; i < last; ++i) {
+            const lid_t p = group(i);
+            for (int j = 0; j < 3; ++j) {
+              P[j] += w(p) * v(p, j);
+              E += w(p) * v(p, j) * v(p, j);
+            }
+            W += w(p);
+          }
+          if (W <= 0)
+            return;
+          double u[3], d[3];
+          double u2 = 0, d2 = 0;
+          const lid_t a = group(first);
+          const lid_t b = group(first + 1);
+          for (int j = 0; j < 3; ++j) {
+            u[j] = P[j] / W;
+            u2 += u[j] * u[j];
+            d[j] = v(a, j) - u[j];
+            d2 += d[j] * d[j];
+          }
+          const double s2 = E / W - u2;
+          const double s = s2 > 0 ? sqrt(s2) : 0;
+          if (d2 > 0) {
+            const double dn = sqrt(d2);
+            for (int j = 0; j < 3; ++j)
+              d[j] /= dn;
+          }
+          else {
+            d[0] = 1;
+            d[1] = d[2] = 0;
+          }
+          w(a) = w(b) = W / 2;
+          for (int j = 0; j < 3; ++j) {
+            v(a, j) = u[j] + s * d[j];
+            v(b, j) = u[j] - s * d[j];
+          }
+          for (lid_t i = first + 2; i < last; ++i)
+            new_element(group(i)) = -1;
+        });
+        Kokkos::single(Kokkos::PerTeam(team), [=]() {
+          Kokkos::atomic_fetch_add(&num_changed(0), n - 2 * num_runs_max);
+        });
+      }
+      else if (n > 0 && n < min_ptcls) {
+        const lid_t num_splits = min_ptcls - n < n ? min_ptcls - n : n;
+        Kokkos::parallel_for(Kokkos::TeamThreadRange(team, num_splits), [=](const lid_t& i) {
+          const lid_t p = group(i);
+          w(p) /= 2;
+          split(p) = 1;
+        });
+        Kokkos::single(Kokkos::PerTeam(team), [=]() {
+          Kokkos::atomic_fetch_add(&num_changed(0), num_splits);
+        });
+      }
+    };
+    parallel_for_element_groups(resampleElement, "resample_elements");
+    if (getLastValue<lid_t>(num_changed) == 0) {
+      Kokkos::Profiling::popRegion();
+      return 0;
+    }
+
+    //The halves of split particles are copied out and added back as new particles
+    kkLidView split_index = pool->template get<lid_t>(exec_space, "resample_split_index",
+                                                      capacity_, false);
+    lid_t num_new = 0;
+    Kokkos::parallel_scan("resample_split_index", rangePolicy(capacity_),
+                          KOKKOS_LAMBDA(const lid_t& i, lid_t& cur, const bool& final) {
+      if (final)
+        split_index(i) = cur;
+      cur += split(i);
+    }, num_new);
+    kkLidView new_particle_elements = pool->template get<lid_t>(exec_space,
+                                                                "resample_new_elements",
+                                                                num_new, false);
+    auto setNewElements = PS_LAMBDA(const lid_t& elm_id, const lid_t& ptcl_id, const bool& mask) {
+      if (mask && split(ptcl_id))
+        new_particle_elements(split_index(ptcl_id)) = elm_id;
+    };
+    parallel_for(setNewElements, "resample_new_elements");
+    //Slot of the particle each new particle is split from
+    kkLidView split_slots = pool->template get<lid_t>(exec_space, "resample_split_slots",
+                                                      num_new, false);
+    Kokkos::parallel_for("resample_split_slots", rangePolicy(capacity_),
+                         KOKKOS_LAMBDA(const lid_t& i) {
+      if (split(i))
+        split_slots(split_index(i)) = i;
+    });
+    MTVs new_particles = pool->template getMemberViews<DataTypes>("resample_new_particles",
+                                                                   num_new);
+    exec_space.fence();
+    CopyViewsToViews<kkLidView, DataTypes>(new_particles, ptcl_data, kkLidView(), split_slots);
+    rebuild(new_element, new_particle_elements, new_particles);
+    Kokkos::Profiling::popRegion();
+    return getLastValue<lid_t>(num_changed);
+  }
+}
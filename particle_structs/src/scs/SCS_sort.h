@@ -7,12 +7,12 @@ namespace particle_structs {
                                                     lid_t sigma){
     //Make temporary copy of the particle counts for sorting
     ptcl_pairs = PairView("ptcl_pairs", num_elems);
-    if (sigma > 1) {
-      lid_t i;
+    if (sigma > 1 && num_elems > 0) {
 #ifdef PS_USE_CUDA
+      lid_t i;
       Kokkos::View<lid_t*, typename MemSpace::device_type> elem_ids("elem_ids", num_elems);
       Kokkos::View<lid_t*, typename MemSpace::device_type> temp_ppe("temp_ppe", num_elems);
-      Kokkos::parallel_for(num_elems, KOKKOS_LAMBDA(const lid_t& i) {
+      Kokkos::parallel_for("sigma_sort_counts", rangePolicy(num_elems), KOKKOS_LAMBDA(const lid_t& i) {
           temp_ppe(i) = ptcls_per_elem(i);
           elem_ids(i) = i;
         });
@@ -22,29 +22,187 @@ namespace particle_structs {
         thrust::sort_by_key(thrust::device, ptcls_t + i, ptcls_t + i + sigma, elem_ids_t + i);
       }
       thrust::sort_by_key(thrust::device, ptcls_t + i, ptcls_t + num_elems, elem_ids_t + i);
-      Kokkos::parallel_for(num_elems, KOKKOS_LAMBDA(const lid_t& i) {
+      Kokkos::parallel_for("sigma_sort_reverse", rangePolicy(num_elems), KOKKOS_LAMBDA(const lid_t& i) {
           ptcl_pairs(num_elems - 1 - i).first = temp_ppe(i);
           ptcl_pairs(num_elems - 1 - i).second = elem_ids(i);
         });
 #else
-      Kokkos::parallel_for(num_elems, KOKKOS_LAMBDA(const lid_t& i) {
-          ptcl_pairs(num_elems).first = ptcls_per_elem(i);
-          ptcl_pairs(num_elems).second = i;
-        });
-      PairView::HostMirror ptcl_pairs_host = deviceToHost(ptcl_pairs);
-      MyPair* ptcl_pair_data = ptcl_pairs_host.data();
-      for (i = 0; i < num_elems - sigma; i+=sigma) {
-        std::sort(ptcl_pair_data + i, ptcl_pair_data + i + sigma);
+      /* Segmented sort on the device by binning one unique key per element
+           key = (sigma segment, descending particle count, element id)
+         which gives the same ordering as the reversed MyPair comparison for each segment.
+         The keys span num_elems * (max particles per element + 1) values, when that
+         overflows gid_t the segments are sorted on the host with MyPair instead.
+      */
+      const lid_t seg_size = sigma < num_elems ? sigma : num_elems;
+      lid_t max_ppe = 0;
+      Kokkos::parallel_reduce("sigma_sort_max", rangePolicy(num_elems),
+                              KOKKOS_LAMBDA(const lid_t& i, lid_t& mx) {
+          if (ptcls_per_elem(i) > mx)
+            mx = ptcls_per_elem(i);
+        }, Kokkos::Max<lid_t>(max_ppe));
+      const gid_t num_counts = max_ppe + 1;
+      const gid_t num_segments = (num_elems + seg_size - 1) / seg_size;
+      const gid_t span = num_segments * seg_size;
+      if (num_counts <= std::numeric_limits<gid_t>::max() / span) {
+        typedef Kokkos::View<gid_t*, typename MemSpace::device_type> KeyView;
+        KeyView keys("sigma_sort_keys", num_elems);
+        Kokkos::parallel_for("sigma_sort_keys", rangePolicy(num_elems), KOKKOS_LAMBDA(const lid_t& i) {
+            const gid_t segment = i / seg_size;
+            const gid_t local = i - segment * seg_size;
+            keys(i) = (segment * num_counts + (max_ppe - ptcls_per_elem(i))) * seg_size + local;
+          });
+        typedef Kokkos::BinOp1D<KeyView> BinOp;
+        BinOp bin_op(num_elems, 0, span * num_counts);
+        Kokkos::BinSort<KeyView, BinOp> bin_sort(keys, bin_op, true);
+        bin_sort.create_permute_vector();
+        auto permute = bin_sort.get_permute_vector();
+        Kokkos::parallel_for("sigma_sort_pairs", rangePolicy(num_elems), KOKKOS_LAMBDA(const lid_t& i) {
+            const lid_t elem = permute(i);
+            ptcl_pairs(i).first = ptcls_per_elem(elem);
+            ptcl_pairs(i).second = elem;
+          });
+      }
+      else {
+        //The keys would overflow gid_t, sort each segment on the host instead
+        Kokkos::parallel_for("sigma_sort_pairs", rangePolicy(num_elems), KOKKOS_LAMBDA(const lid_t& i) {
+            ptcl_pairs(i).first = ptcls_per_elem(i);
+            ptcl_pairs(i).second = i;
+          });
+        typename PairView::HostMirror ptcl_pairs_host = deviceToHost(exec_space, ptcl_pairs);
+        MyPair* ptcl_pair_data = ptcl_pairs_host.data();
+        for (lid_t i = 0; i < num_elems; i += seg_size) {
+          const lid_t end = i + seg_size < num_elems ? i + seg_size : num_elems;
+          std::sort(ptcl_pair_data + i, ptcl_pair_data + end);
+        }
+        Kokkos::deep_copy(exec_space, ptcl_pairs, ptcl_pairs_host);
+        exec_space.fence();
       }
-      std::sort(ptcl_pair_data + i, ptcl_pair_data + num_elems);
-      hostToDevice(ptcl_pairs,  ptcl_pair_data);
 #endif
     }
     else {
-      Kokkos::parallel_for(num_elems, KOKKOS_LAMBDA(const lid_t& i) {
+      Kokkos::parallel_for("sigma_sort_pairs", rangePolicy(num_elems), KOKKOS_LAMBDA(const lid_t& i) {
           ptcl_pairs(i).first = ptcls_per_elem(i);
           ptcl_pairs(i).second = i;
         });
     }
   }
+
+  template <class DataTypes, typename MemSpace>
+    void SellCSigma<DataTypes, MemSpace>::rowSort(kkLidView new_element,
+                                                  kkLidView new_particle_elements,
+                                                  kkLidView new_element_to_row,
+                                                  kkLidView row_start, lid_t new_C,
+                                                  lid_t new_num_rows, lid_t num_entries,
+                                                  kkLidView new_indices,
+                                                  kkLidView new_particle_indices,
+                                                  kkLidView new_particle_mask) {
+    Kokkos::Profiling::pushRegion("scs_row_sort");
+    /* Gather every kept and new particle as an entry
+         source >= 0 is the current index of the particle, source < 0 is new particle -source-1
+    */
+    kkLidView entry_source = pool->template get<lid_t>(exec_space, "row_sort_source",
+                                                       num_entries, false);
+    kkLidView entry_row = pool->template get<lid_t>(exec_space, "row_sort_row", num_entries, false);
+    kkGidView entry_key = pool->template get<gid_t>(exec_space, "row_sort_key", num_entries, false);
+    kkLidView counter = pool->template get<lid_t>(exec_space, "row_sort_counter", 1);
+    kkGidView keys = row_sort_keys;
+    kkGidView new_keys = new_row_sort_keys;
+    auto gatherEntries = PS_LAMBDA(lid_t elm_id, lid_t ptcl_id, bool mask) {
+      const lid_t new_elem = new_element(ptcl_id);
+      if (mask && new_elem != -1) {
+        const lid_t index = Kokkos::atomic_fetch_add(&counter(0), 1);
+        entry_source(index) = ptcl_id;
+        entry_row(index) = new_element_to_row(new_elem);
+        entry_key(index) = keys(ptcl_id);
+      }
+    };
+    parallel_for(gatherEntries, "row_sort_gather");
+    const lid_t num_new_ptcls = new_particle_elements.size();
+    const bool has_new_keys = new_keys.size() >= (std::size_t)num_new_ptcls;
+    Kokkos::parallel_for("row_sort_gather_new", rangePolicy(num_new_ptcls), KOKKOS_LAMBDA(const lid_t& i) {
+        const lid_t index = Kokkos::atomic_fetch_add(&counter(0), 1);
+        entry_source(index) = -(i + 1);
+        entry_row(index) = new_element_to_row(new_particle_elements(i));
+        entry_key(index) = has_new_keys ? new_keys(i) : 0;
+      });
+
+    /* Sort the entries by (row, key) with two bin sorts
+         the first ranks the keys, the second sorts by row * num_entries + rank
+    */
+    typedef Kokkos::BinOp1D<kkGidView> BinOp;
+    gid_t min_key = 0, max_key = 0;
+    Kokkos::parallel_reduce("row_sort_min_key", rangePolicy(num_entries),
+                            KOKKOS_LAMBDA(const lid_t& i, gid_t& mn) {
+        if (entry_key(i) < mn)
+          mn = entry_key(i);
+      }, Kokkos::Min<gid_t>(min_key));
+    Kokkos::parallel_reduce("row_sort_max_key", rangePolicy(num_entries),
+                            KOKKOS_LAMBDA(const lid_t& i, gid_t& mx) {
+        if (entry_key(i) > mx)
+          mx = entry_key(i);
+      }, Kokkos::Max<gid_t>(max_key));
+    kkGidView row_key = pool->template get<gid_t>(exec_space, "row_sort_row_key",
+                                                  num_entries, false);
+    const gid_t n = num_entries;
+    if (min_key < max_key) {
+      BinOp key_op(num_entries, min_key, max_key + 1);
+      Kokkos::BinSort<kkGidView, BinOp> key_sort(entry_key, key_op, true);
+      key_sort.create_permute_vector();
+      auto key_permute = key_sort.get_permute_vector();
+      Kokkos::parallel_for("row_sort_rank", rangePolicy(num_entries), KOKKOS_LAMBDA(const lid_t& i) {
+          const lid_t e = key_permute(i);
+          row_key(e) = entry_row(e) * n + i;
+        });
+    }
+    else {
+      Kokkos::parallel_for("row_sort_rank", rangePolicy(num_entries), KOKKOS_LAMBDA(const lid_t& i) {
+          row_key(i) = entry_row(i) * n;
+        });
+    }
+    BinOp row_op(num_entries, 0, new_num_rows * n);
+    Kokkos::BinSort<kkGidView, BinOp> row_sort(row_key, row_op, true);
+    row_sort.create_permute_vector();
+    auto permute = row_sort.get_permute_vector();
+
+    //Assign slots in sorted order starting from the first slot of each row
+    kkLidView row_first = pool->template get<lid_t>(exec_space, "row_sort_row_first",
+                                                    new_num_rows, false);
+    Kokkos::parallel_for("row_sort_row_first", rangePolicy(num_entries), KOKKOS_LAMBDA(const lid_t& i) {
+        const lid_t row = entry_row(permute(i));
+        if (i == 0 || entry_row(permute(i-1)) != row)
+          row_first(row) = i;
+      });
+    Kokkos::parallel_for("row_sort_assign", rangePolicy(num_entries), KOKKOS_LAMBDA(const lid_t& i) {
+        const lid_t e = permute(i);
+        const lid_t row = entry_row(e);
+        const lid_t index = row_start(row) + (i - row_first(row)) * new_C;
+        new_particle_mask(index) = 1;
+        const lid_t source = entry_source(e);
+        if (source >= 0)
+          new_indices(source) = index;
+        else
+          new_particle_indices(-source - 1) = index;
+      });
+    Kokkos::Profiling::popRegion();
+  }
+
+  template <class DataTypes, typename MemSpace>
+    template <std::size_t N>
+    typename SellCSigma<DataTypes, MemSpace>::kkGidView
+    SellCSigma<DataTypes, MemSpace>::mortonKeys(const double lo[3], const double hi[3]) {
+    double lo_l[3], hi_l[3];
+    for (int i = 0; i < 3; ++i) {
+      lo_l[i] = lo[i];
+      hi_l[i] = hi[i];
+    }
+    kkGidView keys("morton_keys", capacity());
+    auto coords = this->template get<N>();
+    auto setKeys = PS_LAMBDA(const lid_t& elm_id, const lid_t& ptcl_id, const bool& mask) {
+      if (mask)
+        keys(ptcl_id) = mortonCode3(coords(ptcl_id, 0), coords(ptcl_id, 1), coords(ptcl_id, 2),
+                                    lo_l, hi_l);
+    };
+    parallel_for(setKeys, "morton_keys");
+    return keys;
+  }
 }
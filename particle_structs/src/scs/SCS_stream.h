@@ -0,0 +1,216 @@
+#pragma once
+
+namespace particle_structs {
+  template<class DataTypes, typename MemSpace>
+  bool SellCSigma<DataTypes, MemSpace>::checkResident(const char* op) const {
+    if (!evicted)
+      return true;
+    fprintf(stderr, "[ERROR] %s needs the particle information on the device, call "
+            "restoreToDevice first\n", op);
+    return false;
+  }
+
+  template<class DataTypes, typename MemSpace>
+  void SellCSigma<DataTypes, MemSpace>::streamBatch(MTVs views, lid_t batch,
+                                                    lid_t first_index, std::size_t byte_offset,
+                                                    bool pack) {
+    const lid_t n = batch_offsets[batch + 1] - batch_offsets[batch];
+    kkLidView indices = pool->template get<lid_t>(exec_space, "stream_indices", n, false);
+    Kokkos::parallel_for("stream_indices", rangePolicy(n), KOKKOS_LAMBDA(const lid_t& i) {
+      indices(i) = first_index + i;
+    });
+    kkLidView segment_offsets = pool->template get<lid_t>(exec_space, "stream_segment_offsets",
+                                                          2);
+    Kokkos::deep_copy(exec_space, Kokkos::subview(segment_offsets, 1), n);
+    Kokkos::View<std::size_t*, device_type> type_offsets =
+      pool->template get<std::size_t>(exec_space, "stream_type_offsets", 1, false);
+    Kokkos::deep_copy(exec_space, type_offsets, byte_offset);
+    exec_space.fence();
+    if (pack)
+      PackViews<device_type, DataTypes>(views, n, segment_offsets, 1, type_offsets,
+                                        stream_buffer, indices);
+    else
+      UnpackViews<device_type, DataTypes>(views, n, segment_offsets, 1, type_offsets,
+                                          stream_buffer, indices);
+    Kokkos::fence();
+  }
+
+  template<class DataTypes, typename MemSpace>
+  void SellCSigma<DataTypes, MemSpace>::evictToHost(lid_t batch_slots) {
+    if (evicted) {
+      fprintf(stderr, "[WARNING] The particle information is already in host memory\n");
+      return;
+    }
+    if (batch_slots < 1 || num_chunks < 1) {
+      fprintf(stderr, "[ERROR] evictToHost needs batch_slots > 0 and a structure with "
+              "chunks\n");
+      return;
+    }
+    flushLazyRebuild();
+    Kokkos::Profiling::pushRegion("scs_evict");
+    //Overflow slices are folded back into their chunks so each batch is one slot range
+    lid_t borrowed = 0;
+    kkLidView overflow_widths_local = overflow_widths;
+    Kokkos::parallel_reduce("evict_overflow", rangePolicy(num_chunks),
+                            KOKKOS_LAMBDA(const lid_t& c, lid_t& sum) {
+      sum += overflow_widths_local(c) > 0;
+    }, borrowed);
+    if (borrowed > 0) {
+      kkLidView new_element = pool->template get<lid_t>(exec_space, "evict_new_element",
+                                                        capacity_, false);
+      auto stay = PS_LAMBDA(const lid_t& elm_id, const lid_t& ptcl_id, const bool& mask) {
+        new_element(ptcl_id) = mask ? elm_id : -1;
+      };
+      parallel_for_slices(stay, "evict_stay", false, false);
+      const bool shuffling = tryShuffling;
+      const RebuildReason reason = last_rebuild_reason;
+      tryShuffling = false;
+      rebuild(new_element);
+      tryShuffling = shuffling;
+      last_rebuild_reason = reason;
+    }
+
+    //Batches of whole chunks with up to batch_slots slots, a wider chunk is its own batch
+    kkLidHostMirror chunk_offsets_host = deviceToHost(exec_space, chunk_offsets);
+    batch_offsets.assign(1, 0);
+    for (lid_t c = 1; c < num_chunks; ++c)
+      if (chunk_offsets_host(c + 1) - batch_offsets.back() > batch_slots)
+        batch_offsets.push_back(chunk_offsets_host(c));
+    batch_offsets.push_back(chunk_offsets_host(num_chunks));
+    const lid_t num_batches = batch_offsets.size() - 1;
+    stream_window = 0;
+    batch_bytes.assign(1, 0);
+    for (lid_t k = 0; k < num_batches; ++k) {
+      const lid_t n = batch_offsets[k + 1] - batch_offsets[k];
+      stream_window = std::max(stream_window, n);
+      batch_bytes.push_back(batch_bytes.back() + PackedBytes<DataTypes>::bytes(n));
+    }
+    const std::size_t half_bytes = PackedBytes<DataTypes>::bytes(stream_window);
+    evicted_data = Kokkos::View<char*, StagingDevice>(
+      Kokkos::view_alloc(Kokkos::WithoutInitializing, "scs_evicted_data"), batch_bytes.back());
+    stream_buffer = Kokkos::View<char*, device_type>(
+      Kokkos::view_alloc(Kokkos::WithoutInitializing, "scs_stream_buffer"), 2 * half_bytes);
+
+    //Pack each batch on the device and copy it to the host
+    for (lid_t k = 0; k < num_batches; ++k) {
+      streamBatch(ptcl_data, k, batch_offsets[k], 0, true);
+      const std::size_t bytes = batch_bytes[k + 1] - batch_bytes[k];
+      Kokkos::deep_copy(exec_space,
+                        Kokkos::subview(evicted_data, std::make_pair(batch_bytes[k],
+                                                                     batch_bytes[k + 1])),
+                        Kokkos::subview(stream_buffer, std::make_pair((std::size_t)0, bytes)));
+      exec_space.fence();
+    }
+
+    //The device keeps the layout and a working set of two batches
+    destroyViews<DataTypes, memory_space>(ptcl_data);
+    if (scs_data_swap)
+      destroyViews<DataTypes, memory_space>(scs_data_swap);
+    scs_data_swap = NULL;
+    swap_size = 0;
+    CreateViews<device_type, DataTypes>(ptcl_data, 2 * stream_window, "scs_particle_data");
+    //The device batch buffer is held with the layout until the restore
+    trackLayout(viewBytes(stream_buffer));
+    evicted = true;
+    ++layout_version;
+    Kokkos::Profiling::popRegion();
+  }
+
+  template<class DataTypes, typename MemSpace>
+  void SellCSigma<DataTypes, MemSpace>::restoreToDevice() {
+    if (!evicted)
+      return;
+    Kokkos::Profiling::pushRegion("scs_restore");
+    destroyViews<DataTypes, memory_space>(ptcl_data);
+    CreateViews<device_type, DataTypes>(ptcl_data, current_size, "scs_particle_data");
+    const lid_t num_batches = batch_offsets.size() - 1;
+    for (lid_t k = 0; k < num_batches; ++k) {
+      const std::size_t bytes = batch_bytes[k + 1] - batch_bytes[k];
+      Kokkos::deep_copy(exec_space,
+                        Kokkos::subview(stream_buffer, std::make_pair((std::size_t)0, bytes)),
+                        Kokkos::subview(evicted_data, std::make_pair(batch_bytes[k],
+                                                                     batch_bytes[k + 1])));
+      exec_space.fence();
+      streamBatch(ptcl_data, k, batch_offsets[k], 0, false);
+    }
+    if (!low_memory_rebuild) {
+      CreateViews<device_type, DataTypes>(scs_data_swap, current_size, "scs_particle_data");
+      swap_size = current_size;
+    }
+    evicted_data = Kokkos::View<char*, StagingDevice>();
+    stream_buffer = Kokkos::View<char*, device_type>();
+    batch_offsets.clear();
+    batch_bytes.clear();
+    stream_window = 0;
+    trackLayout();
+    evicted = false;
+    ++layout_version;
+    Kokkos::Profiling::popRegion();
+  }
+
+  template<class DataTypes, typename MemSpace>
+  template <typename FunctionType>
+  void SellCSigma<DataTypes, MemSpace>::parallel_for_streamed(FunctionType& fn,
+                                                              std::string name) {
+    parallel_for_streamed(fn, exec_space, name);
+  }
+
+  template<class DataTypes, typename MemSpace>
+  template <typename FunctionType>
+  void SellCSigma<DataTypes, MemSpace>::parallel_for_streamed(FunctionType& fn,
+                                                              const execution_space& copy_space,
+                                                              std::string name) {
+    if (!evicted) {
+      parallel_for(fn, name);
+      return;
+    }
+    if (nPtcls() == 0)
+      return;
+    Kokkos::Profiling::pushRegion("scs_parallel_for_streamed");
+    const lid_t num_batches = batch_offsets.size() - 1;
+    const std::size_t half_bytes = PackedBytes<DataTypes>::bytes(stream_window);
+    kkLidView chunk_offsets_local = chunk_offsets;
+    kkLidView row_to_element_local = row_to_element;
+    kkLidView particle_mask_local = particle_mask;
+    const lid_t C_local = C_;
+    const lid_t nchunks = num_chunks;
+    /* Batch k goes through half k % 2 of the working set
+         the copy of batch k + 1 to the device runs on copy_space while batch k is unpacked,
+         computed and packed on the execution space of the structure
+    */
+    Kokkos::View<char*, StagingDevice> host_data = evicted_data;
+    Kokkos::View<char*, device_type> buffer = stream_buffer;
+    auto hostBatch = [&](lid_t k) {
+      return Kokkos::subview(host_data, std::make_pair(batch_bytes[k], batch_bytes[k + 1]));
+    };
+    auto deviceBatch = [&](lid_t k) {
+      return Kokkos::subview(buffer, std::make_pair((k % 2) * half_bytes,
+                                                    (k % 2) * half_bytes + batch_bytes[k + 1] -
+                                                    batch_bytes[k]));
+    };
+    Kokkos::deep_copy(copy_space, deviceBatch(0), hostBatch(0));
+    for (lid_t k = 0; k < num_batches; ++k) {
+      //Batch k is on the device and batch k - 1 is back on the host
+      copy_space.fence();
+      if (k + 1 < num_batches)
+        Kokkos::deep_copy(copy_space, deviceBatch(k + 1), hostBatch(k + 1));
+      const lid_t half = k % 2;
+      const lid_t window_first = half * stream_window;
+      const lid_t first = batch_offsets[k];
+      const lid_t n = batch_offsets[k + 1] - first;
+      streamBatch(ptcl_data, k, window_first, half * half_bytes, false);
+      Kokkos::parallel_for(name, rangePolicy(n), KOKKOS_LAMBDA(const lid_t& i) {
+        const lid_t slot = first + i;
+        const lid_t chunk = segmentOf(chunk_offsets_local, nchunks, slot);
+        const lid_t row = chunk * C_local + (slot - chunk_offsets_local(chunk)) % C_local;
+        const bool mask = particle_mask_local(slot);
+        fn(row_to_element_local(row), window_first + i, mask);
+      });
+      exec_space.fence();
+      streamBatch(ptcl_data, k, window_first, half * half_bytes, true);
+      Kokkos::deep_copy(copy_space, hostBatch(k), deviceBatch(k));
+    }
+    copy_space.fence();
+    Kokkos::Profiling::popRegion();
+  }
+}
@@ -9,10 +9,10 @@ namespace particle_structs {
     ps_prebarrier_enabled = true;
   }
 
-  double prebarrier() {
+  double prebarrier(MPI_Comm comm) {
     if(ps_prebarrier_enabled) {
       Kokkos::Timer timer;
-      MPI_Barrier(MPI_COMM_WORLD);
+      MPI_Barrier(comm);
       return timer.seconds();
     } else {
       return 0.0;
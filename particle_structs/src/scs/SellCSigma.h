@@ -7,8 +7,18 @@
 #include <mpi.h>
 #include <unordered_map>
 #include <climits>
+#include <limits>
+#include <cstring>
+#include <type_traits>
+#include <typeinfo>
+#include <cstdint>
+#include <cmath>
 #include <particle_structure.hpp>
 #include <psAssert.h>
+#include <BufferPool.h>
+#include <RegionTimers.h>
+#include <MemoryTracker.h>
+#include <ImbalanceMonitor.h>
 #include <Kokkos_UnorderedMap.hpp>
 #include <Kokkos_Pair.hpp>
 #include <Kokkos_Sort.hpp>
@@ -22,7 +32,7 @@
 namespace particle_structs {
 
 void enable_prebarrier();
-double prebarrier();
+double prebarrier(MPI_Comm comm = MPI_COMM_WORLD);
 
 
 template<class DataTypes, typename MemSpace = DefaultMemSpace>
@@ -57,13 +67,39 @@ class SellCSigma : public ParticleStructure<DataTypes, MemSpace> {
     element_gids - (for MPI parallelism) global ids for each element (size 0 is ignored)
     particle_elements - parent element for each particle (optional)
     particle_info - Initial values for the particle information (optional)
+    comm - communicator of the processes particles are migrated between (optional)
+           The communicator must outlive the structure
   */
   SellCSigma(PolicyType& p,
              lid_t sigma, lid_t vertical_chunk_size, lid_t num_elements, lid_t num_particles,
              kkLidView particles_per_element, kkGidView element_gids,
              kkLidView particle_elements = kkLidView(),
-             MTVs particle_info = NULL);
+             MTVs particle_info = NULL, MPI_Comm comm = MPI_COMM_WORLD);
+  /* Constructor with the team policy chosen from the backend, see recommendedPolicy
+       The league size is re-derived from the slices of each rebuild, the arguments are those
+       of the constructor above
+  */
+  SellCSigma(lid_t sigma, lid_t vertical_chunk_size, lid_t num_elements, lid_t num_particles,
+             kkLidView particles_per_element, kkGidView element_gids,
+             kkLidView particle_elements = kkLidView(),
+             MTVs particle_info = NULL, MPI_Comm comm = MPI_COMM_WORLD);
+  /* Constructor from unsorted particles
+       The particles per element are counted on the device and every particle is placed in
+       its row in the same pass that copies its information
+    particle_elements - parent element for each particle (its size is the number of particles)
+    particle_info - values for the particle information
+    The other arguments are those of the constructor above
+  */
+  SellCSigma(PolicyType& p, lid_t sigma, lid_t vertical_chunk_size, lid_t num_elements,
+             kkGidView element_gids, kkLidView particle_elements, MTVs particle_info,
+             MPI_Comm comm = MPI_COMM_WORLD);
   SellCSigma(SCS_Input<DataTypes, MemSpace>&);
+  /* Restores a structure written by writeCheckpoint without rebuilding its layout
+    p - a Kokkos::TeamPolicy for the parallel_fors of the structure
+    checkpoint - file written by writeCheckpoint with the same number of ranks in comm
+    comm - communicator of the processes particles are migrated between (optional)
+  */
+  SellCSigma(PolicyType& p, const std::string& checkpoint, MPI_Comm comm = MPI_COMM_WORLD);
   ~SellCSigma();
 
   //Functions from ParticleStructure
@@ -71,15 +107,134 @@ class SellCSigma : public ParticleStructure<DataTypes, MemSpace> {
   using ParticleStructure<DataTypes, MemSpace>::nPtcls;
   using ParticleStructure<DataTypes, MemSpace>::capacity;
   using ParticleStructure<DataTypes, MemSpace>::numRows;
+  using ParticleStructure<DataTypes, MemSpace>::rangePolicy;
+  using ParticleStructure<DataTypes, MemSpace>::layoutVersion;
 
   //Returns the horizontal slicing(C)
   lid_t C() const {return C_;}
   //Returns the vertical slicing(V)
   lid_t V() const {return V_;}
+  //Returns the sorting parameter(sigma)
+  lid_t Sigma() const {return sigma;}
+  //Returns the team policy (league size of the last rebuild for chosen policies)
+  const PolicyType& policyUsed() const {return policy;}
+
+  /* Team policy chosen from the backend
+       Device: teams of one warp/wavefront of rows (PolicyType::vector_length_max) limited by
+         team_size_recommended, so the threads of a team read each column of a chunk with one
+         coalesced access. Chunks shorter than a warp spread the particles of each row over
+         vector lanes to fill it.
+       Host: teams of the SIMD width in doubles (PS_SIMD_BYTES) limited by team_size_max,
+         see setColumnWise to vectorize each column
+     league_size - number of slices
+  */
+  static PolicyType recommendedPolicy(lid_t league_size = 1);
 
 
   //Change whether or not to try shuffling
   void setShuffling(bool newS) {tryShuffling = newS;}
+  /* Low memory rebuilds move the particle data to the new layout one member type at a time
+       instead of through a second full copy of every member kept between rebuilds, so peak
+       memory is the particle data plus its largest member. Each member waits for its copy
+       to finish, which costs rebuild time. Reshuffles are unaffected.
+  */
+  void setLowMemoryRebuild(bool on) {low_memory_rebuild = on;}
+  bool lowMemoryRebuild() const {return low_memory_rebuild;}
+  /* Lazy rebuilds leave particles that change elements on this process in their slots
+       max_misplaced - fraction of the particles allowed outside the rows of their elements
+                       in [0, 1] (0 turns lazy rebuilds off, the default)
+     A rebuild without new particles records the element of each moved particle instead of
+       moving it and parallel_for passes the recorded element to the functor. Removed
+       particles leave holes. The rebuild that would leave more than max_misplaced of the
+       particles misplaced moves all of them (reshuffle or full rebuild).
+     Loops over the rows of elements (parallel_for over elements, parallel_for_elements,
+       parallel_for_element_groups and _pairs), resample, writeCheckpoint and evictToHost
+       move the misplaced particles first. Lazy rebuilds need shuffling (see setShuffling).
+  */
+  void setLazyRebuild(double max_misplaced);
+  double lazyRebuildThreshold() const {return lazy_threshold;}
+  //Particles outside the rows of their elements
+  lid_t numMisplaced() const {return num_misplaced;}
+  //Moves the misplaced particles to the rows of their elements
+  void flushLazyRebuild();
+
+  /* Out of core storage for structures larger than device memory
+       evictToHost - moves the particle information to pinned host memory in batches of
+                     whole chunks of up to batch_slots slots (a wider chunk is its own
+                     batch), the device keeps the layout and a working set of two batches
+       restoreToDevice - moves the particle information back to the device
+     While evicted get<N>() returns the working set and only parallel_for_streamed may run
+       over the particles, rebuild, migrate and the other loops need restoreToDevice first
+  */
+  void evictToHost(lid_t batch_slots);
+  void restoreToDevice();
+  bool isEvicted() const {return evicted;}
+  /* Runs fn (element_id, particle_id, mask) over the particles of each batch
+       particle_id indexes the working set, the batch is copied back to the host after fn
+     copy_space - execution space instance for the host transfers (i.e. a second CUDA stream)
+                  so the copy of the next batch overlaps fn on the current batch
+     Without eviction this is parallel_for
+  */
+  template <typename FunctionType>
+  void parallel_for_streamed(FunctionType& fn, std::string name = "");
+  template <typename FunctionType>
+  void parallel_for_streamed(FunctionType& fn, const execution_space& copy_space,
+                             std::string name = "");
+
+  /* Change which slots parallel_for visits
+       skip_empty - only launch teams for slices holding at least one particle, a compact list
+                    of these slices is maintained on every rebuild
+       skip_masked - do not call the functor for empty slots (mask is always 1 when called)
+     Both default to off so every slot is passed to the functor
+  */
+  void setSkipEmpty(bool skip_empty, bool skip_masked = false);
+  //Returns the number of slices holding particles (only maintained when skipping empty slices)
+  lid_t numActiveSlices() const {return num_active_slices;}
+  /* Run parallel_for column by column on host backends
+       Each slice is handled by one thread that walks its columns, the C slots of a column
+       are contiguous so the loop over them is vectorized (masked stores of the functor
+       become SIMD masked stores). Ignored when the particles are not in host memory.
+  */
+  void setColumnWise(bool column) {column_wise = column;}
+
+  /* Order the particles of each element by a sort key in the next rebuild
+       keys - array sized scs->capacity with the key of each particle
+       new_keys - array with the key of each new particle passed to rebuild (key 0 if empty)
+     The next rebuild skips reshuffling and stores the particles of each row in ascending
+     key order, keys are dropped afterwards so sorting is only paid for when requested
+  */
+  void setRowSortKeys(kkGidView keys, kkGidView new_keys = kkGidView()) {
+    row_sort_keys = keys;
+    new_row_sort_keys = new_keys;
+  }
+
+  /* Maintain an index from particle ids to the slots of the particles
+       N - member holding the particle ids (lid_t), unique on this process in [0, max_id)
+     idIndex()(id) is the slot of the particle with the id, or -1 if it is not on this
+     process. Rebuild, reshuffle and migrate update the index from the slots they move
+     particles between, so lookups never scan the structure.
+     Ids outside of [0, max_id) are not indexed, each operation that meets them warns and
+     idIndexMisses() counts them.
+     Note: particle data written to the id member outside of rebuild is not tracked, call
+           enableIdIndex again after changing ids
+  */
+  template <std::size_t N>
+  void enableIdIndex(lid_t max_id);
+  void disableIdIndex() {id_member = -1; id_to_slot = kkLidView(); id_index_misses = kkLidView();}
+  kkLidView idIndex() const {return id_to_slot;}
+  //Ids outside of the index met since enableIdIndex
+  lid_t idIndexMisses() const {return id_index_miss_total;}
+  /* Morton (Z-order) keys of a double[3] member N (ex PTCL_COORDS) for setRowSortKeys
+       lo, hi: corners of the bounding box that is quantized to 2^21 cells per dimension
+  */
+  template <std::size_t N>
+  kkGidView mortonKeys(const double lo[3], const double hi[3]);
+
+  /* Use a user supplied pool for the temporaries of migrate/rebuild
+       A pool can be shared by structures that do not migrate/rebuild at the same time
+       Passing NULL returns to the pool owned by the structure
+  */
+  void setBufferPool(BufferPool<device_type>* p) {pool = p ? p : &own_pool;}
 
   /* Migrates each particle to new_process and to new_element
      Calls rebuild to recreate the SCS after migrating particles
@@ -90,8 +245,117 @@ class SellCSigma : public ParticleStructure<DataTypes, MemSpace> {
                kkLidView new_particle_elements = kkLidView(),
                MTVs new_particle_info = NULL);
 
+  /* State of a migration between migrate_begin and migrate_end
+       Only valid for the structure that created it
+  */
+  class MigrateHandle {
+  public:
+    MigrateHandle() : active(false), communicate(false), packed(false), compact_gids(false),
+                      new_particle_info(NULL),
+                      np_recv(0), num_recv_ranks(0), recv_particle(NULL), btime(0),
+                      begin_time(0) {}
+    MigrateHandle(const MigrateHandle&) = delete;
+    MigrateHandle& operator=(const MigrateHandle&) = delete;
+    MigrateHandle(MigrateHandle&&) = default;
+    MigrateHandle& operator=(MigrateHandle&&) = default;
+    //True between migrate_begin and migrate_end
+    bool isActive() const {return active;}
+  private:
+    friend class SellCSigma;
+    bool active;
+    //False if only a rebuild is needed
+    bool communicate;
+    bool packed;
+    //Compression of the packed messages (see setMigrationCompression)
+    bool compact_gids;
+    std::vector<int> codecs;
+    kkLidView new_element, new_process, new_particle_elements;
+    MTVs new_particle_info;
+    lid_t np_recv, num_recv_ranks;
+    kkLidView recv_element;
+    MTVs recv_particle;
+    kkLidView offset_recv_particles, num_recv_particles;
+    Kokkos::View<char*, device_type> recv_buffer;
+    Kokkos::View<std::size_t*, device_type> recv_type_offsets;
+    //Host staging of the packed messages (non device aware MPI only)
+    Kokkos::View<char*, StagingDevice> recv_stage;
+    std::vector<std::size_t> recv_bytes;
+    //Index in recv_bytes of the message of each receive request
+    std::vector<int> recv_request_rank;
+    std::vector<MPI_Request> send_requests, recv_requests;
+    double btime, begin_time;
+  };
+
+  /* Two phase migration to overlap communication with other work
+     migrate_begin - counts and packs the particles leaving this process and posts the
+                     sends and receives, arguments are the same as migrate
+     migrate_end - completes the communication and rebuilds the structure
+     migrate is migrate_begin immediately followed by migrate_end
+     Notes:
+       The structure may be read between the two calls, but must not be rebuilt, migrated
+         or have its particles changed
+       The views passed to migrate_begin must stay valid until migrate_end
+       Like any collective, migrate_begin must be called in the same order on every process
+         when several structures migrate at once
+       Structures that share a BufferPool can not have migrations in flight at the same time
+  */
+  MigrateHandle migrate_begin(kkLidView new_element, kkLidView new_process,
+                              kkLidView new_particle_elements = kkLidView(),
+                              MTVs new_particle_info = NULL);
+  void migrate_end(MigrateHandle& handle);
+
+  /* Restricts migration to a list of neighboring ranks
+       ranks - the ranks that particles may be sent to (i.e. pumipic::Mesh::bufferedRanks)
+     The ranks sending to this process are found once here. Every following migrate only
+       exchanges counts (MPI_Neighbor_alltoall) and particles with the neighbors
+     Passing an empty list on every rank returns to migrating over all ranks
+     Note: this is a collective call
+  */
+  void setMigrationNeighbors(const std::vector<int>& ranks);
+
+  /* Moves every particle to a new set of elements and processes in one migration
+     (i.e. after the mesh elements are repartitioned)
+       new_process - array sized scs->capacity with the new process for each particle
+       element_ids - id of each current element sized nElems
+       ne - number of elements of the structure after repartitioning
+       new_element_ids - id of each element after repartitioning sized ne
+     Each particle moves to the element on its new process with the id of its current element,
+       the ids must identify an element the same way on every process (i.e. full mesh element
+       ids from pumipic::Mesh::fullMeshElementIds). new_element_ids become the element gids.
+     Note: this is a collective call, particles whose element is not on their new process are
+           removed
+  */
+  void repartition(kkLidView new_process, kkGidView element_ids, lid_t ne,
+                   kkGidView new_element_ids);
+
+  /* Change how particles are communicated in migrate
+       true (default) - all particle data to a rank is packed into one message, received
+                        particles are unpacked straight into holes when the structure
+                        reshuffles (see reshuffle)
+       false - one message per data type to each rank, kept for debugging
+  */
+  void setPackedMigration(bool packed) {packed_migration = packed;}
+  /* Compression of the packed migration messages
+       codecs - PackCodec of each member (PACK_FLOAT sends members of doubles in single
+                precision), members past the end of the list are sent exactly
+     Element gids are sent as 32-bit integers when every gid fits, which is lossless
+     An empty list turns compression off
+     Note: this is a collective call, every process must use the same codecs
+  */
+  void setMigrationCompression(const std::vector<PackCodec>& codecs);
+
+  //Communicator used by all collectives and messages of the structure
+  MPI_Comm comm() const {return mpi_comm;}
+
+  /* Writes the layout and particle data to one binary file shared by all ranks of comm()
+     Collective over comm(), every rank writes its own block with MPI-IO
+  */
+  void writeCheckpoint(const std::string& filename);
+
   /*
     Reshuffles the scs values to the element in new_element[i]
+    Rows with more incoming particles than holes borrow an overflow slice for their chunk
+      from the unused tail of the allocation (one per chunk between full rebuilds)
     Calls rebuild if there is not enough space for the shuffle
     new_element - array sized scs->capacity with the new element for each particle
       Optional arguments when adding new particles to the structure
@@ -100,6 +364,18 @@ class SellCSigma : public ParticleStructure<DataTypes, MemSpace> {
   */
   bool reshuffle(kkLidView new_element, kkLidView new_particle_elements = kkLidView(),
                  MTVs new_particles = NULL);
+  /*
+    Adds particles to the structure without moving the current particles
+    The new particles fill the holes of their rows, rows without enough holes borrow an
+      overflow slice for their chunk (as in reshuffle), and only when neither is possible
+      (or rows are sorted, see setRowSortKeys) the structure is rebuilt
+    Only the rows receiving particles are visited, so steady sources into fixed elements
+      cost work proportional to the added particles instead of the capacity
+    new_particle_elements - the element of each new particle
+    new_particles - the data for the new particles
+    Returns true if the particles were added without a rebuild
+  */
+  bool addParticles(kkLidView new_particle_elements, MTVs new_particles);
   /*
     Rebuilds a new SCS where particles move to the element in new_element[i]
     new_element - array sized scs->capacity with the new element for each particle
@@ -110,10 +386,24 @@ class SellCSigma : public ParticleStructure<DataTypes, MemSpace> {
   */
   void rebuild(kkLidView new_element, kkLidView new_particle_elements = kkLidView(),
                MTVs new_particles = NULL);
+  /*
+    Resamples the particles of each element to bound the particles per element
+    Elements with more than max_ptcls particles are merged down to at most max_ptcls and
+      elements with fewer than min_ptcls particles split particles towards min_ptcls
+    Merges conserve the weight, momentum and energy of the element and splits halve the
+      weight of a particle between itself and a copy, followed by a rebuild
+    PTCL_W - member of the (scalar) particle weights
+    PTCL_V - member of the particle velocities (3 components)
+    max_ptcls - at least 2 and at least twice min_ptcls
+    Returns the number of particles removed and added (0 if nothing changed)
+  */
+  template <int PTCL_W, int PTCL_V>
+  lid_t resample(lid_t max_ptcls, lid_t min_ptcls = 0);
 
   /*
     Performs a parallel for over the elements/particles in the SCS
     The passed in functor/lambda should take in 3 arguments (int elm_id, int ptcl_id, bool mask)
+    elm_id of particles misplaced by a lazy rebuild is their recorded element (see setLazyRebuild)
     Example usage with lambda:
     auto lamb = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
       do stuff...
@@ -122,6 +412,142 @@ class SellCSigma : public ParticleStructure<DataTypes, MemSpace> {
   */
   template <typename FunctionType>
   void parallel_for(FunctionType& fn, std::string s="");
+  /*
+    Performs a parallel for over the particles of a subset of the elements
+    elements - device list of element ids, only the rows of these elements are visited so
+               the work scales with the particles of the subset
+    The passed in functor/lambda has the same arguments as parallel_for
+    Example usage with lambda, only visiting unsafe elements:
+    scs->parallel_for(unsafe_elements, lamb);
+  */
+  template <typename FunctionType>
+  void parallel_for(kkLidView elements, FunctionType& fn, std::string s="");
+
+  typedef typename PolicyType::member_type TeamMember;
+  //Particle slots of one element (row) of the SCS
+  //  The slots of the chunk's overflow slice (if any) follow the slots of the chunk
+  struct RowParticles {
+    KOKKOS_INLINE_FUNCTION RowParticles(lid_t s, lid_t st, lid_t n, lid_t os, lid_t on,
+                                        kkLidView m) :
+      start(s), stride(st), num_slots(n), overflow_start(os), overflow_slots(on),
+      particle_mask(m) {}
+    //Number of particle slots in the row
+    KOKKOS_INLINE_FUNCTION lid_t size() const {return num_slots + overflow_slots;}
+    //Particle index (ptcl_id) of the i-th slot
+    KOKKOS_INLINE_FUNCTION lid_t operator()(const lid_t& i) const {
+      return i < num_slots ? start + i * stride : overflow_start + (i - num_slots) * stride;
+    }
+    //1 if there is a particle in the i-th slot, 0 otherwise
+    KOKKOS_INLINE_FUNCTION lid_t mask(const lid_t& i) const {
+      return particle_mask((*this)(i));
+    }
+    lid_t start, stride, num_slots;
+    lid_t overflow_start, overflow_slots;
+    kkLidView particle_mask;
+  };
+  /*
+    Performs a parallel for over the elements of the SCS with one team per element (row)
+    The passed in functor/lambda is called by every thread of the team and should take in
+      3 arguments (const TeamMember& team, int elm_id, const RowParticles& row)
+    scratch_bytes - team scratch memory per element, accessed through team.team_shmem()
+    team_size - threads per team (-1 lets Kokkos choose)
+    Example usage with lambda, gather element data once and reduce before one atomic:
+    auto lamb = PS_LAMBDA(const SCS::TeamMember& team, const int& elm_id,
+                          const SCS::RowParticles& row) {
+      double* coords = (double*)team.team_shmem().get_shmem(bytes);
+      load coords with Kokkos::TeamThreadRange, then team.team_barrier()...
+      double sum = 0;
+      Kokkos::parallel_reduce(Kokkos::TeamThreadRange(team, row.size()),
+                              [&](const int& i, double& lsum) {
+        if (row.mask(i)) lsum += value(row(i));
+      }, sum);
+    };
+    scs->parallel_for_elements(lamb, bytes);
+  */
+  template <typename FunctionType>
+  void parallel_for_elements(FunctionType& fn, std::size_t scratch_bytes = 0,
+                             int team_size = -1, std::string s="");
+
+  //Compact list of the particles (ptcl_id) of one element, held in team scratch
+  struct ElementGroup {
+    KOKKOS_INLINE_FUNCTION ElementGroup(lid_t* p, lid_t n) : ptcls(p), num_ptcls(n) {}
+    KOKKOS_INLINE_FUNCTION lid_t size() const {return num_ptcls;}
+    KOKKOS_INLINE_FUNCTION lid_t operator()(const lid_t& i) const {return ptcls[i];}
+    lid_t* ptcls;
+    lid_t num_ptcls;
+  };
+  /*
+    Performs a parallel for over the elements of the SCS with one team per element (row)
+      where the team is given only the particles of the element, without empty slots
+    The passed in functor/lambda is called by every thread of the team after the group is
+      gathered and should take in 3 arguments
+      (const TeamMember& team, int elm_id, const ElementGroup& group)
+    The group may be reordered by the functor (i.e. shuffled), followed by team.team_barrier()
+    Example usage with lambda:
+    auto lamb = PS_LAMBDA(const SCS::TeamMember& team, const int& elm_id,
+                          const SCS::ElementGroup& group) {
+      Kokkos::parallel_for(Kokkos::TeamThreadRange(team, group.size()), [=](const int& i) {
+        do stuff with particle group(i)...
+      });
+    };
+    scs->parallel_for_element_groups(lamb);
+  */
+  template <typename FunctionType>
+  void parallel_for_element_groups(FunctionType& fn, std::string s="");
+  /*
+    Performs a parallel for over disjoint pairs of particles within each element
+      (i.e. binary collision operators)
+    The passed in functor/lambda should take in 3 arguments (int elm_id, int ptcl_a, int ptcl_b)
+    shuffle - pair the particles of each element in a random order, otherwise consecutive
+              slots are paired
+    seed - random seed of the shuffle, combined with the element id (change it every step)
+    The last particle of an element with an odd count is left unpaired
+    Example usage with lambda:
+    auto lamb = PS_LAMBDA(const int& elm_id, const int& ptcl_a, const int& ptcl_b) {
+      collide ptcl_a and ptcl_b...
+    };
+    scs->parallel_for_pairs(lamb, true, step);
+  */
+  template <typename FunctionType>
+  void parallel_for_pairs(FunctionType& fn, bool shuffle = true, std::size_t seed = 0,
+                          std::string s="");
+
+  //Candidate layout parameters for autotune, every combination is tried
+  struct TuneGrid {
+    std::vector<lid_t> C, sigma, V;
+  };
+  //Timings of one candidate of autotune
+  struct TuneResult {
+    TuneResult() : C(0), sigma(0), V(0), rebuild_time(0), parallel_for_time(0) {}
+    lid_t C, sigma, V;
+    double rebuild_time, parallel_for_time;
+    double score(int num_runs) const {return rebuild_time + num_runs * parallel_for_time;}
+  };
+  /* Opt-in autotuning of the layout parameters C, sigma and V
+     run(scs) - runs representative kernels (i.e. a parallel_for) on scs, timed for each
+                candidate. Every candidate rebuilds the structure, so run fetches the
+                views it reads with get<N> on every call.
+     grid - candidate values
+     num_runs - number of calls of run timed per candidate
+     Rebuilds the structure with each candidate and keeps the one with the smallest
+       rebuild time + num_runs * run time. The C of a candidate is the chunk height the
+       rebuild used, which is smaller than the grid value when fewer elements have particles
+     Candidates with C larger than the team size of the policy are skipped
+     Note: run must only read the particles since it is called several times per candidate
+     Note: on CUDA define the device lambdas of run in a named function, i.e.
+             void readValues(SCS* scs) {
+               auto values = scs->get<0>();
+               auto fn = PS_LAMBDA(...) {...};
+               scs->parallel_for(fn);
+             }
+  */
+  void autotune(std::function<void(SellCSigma*)> run, const TuneGrid& grid, int num_runs = 5);
+  /* Re-run autotune every n rebuilds with run (n = 0 turns it off)
+  */
+  void setAutotunePeriod(std::function<void(SellCSigma*)> run, const TuneGrid& grid, int n,
+                         int num_runs = 5);
+  //Candidate applied by the last autotune
+  const TuneResult& tuneChoice() const {return tune_choice;}
 
   //Prints the format of the SCS labeled by prefix
   void printFormat(const char* prefix = "") const;
@@ -129,6 +555,37 @@ class SellCSigma : public ParticleStructure<DataTypes, MemSpace> {
   //Prints metrics of the SCS
   void printMetrics() const;
 
+  //Why the last full rebuild was done instead of a reshuffle
+  enum RebuildReason {
+    REBUILD_NONE,           //No full rebuild since construction
+    REBUILD_SHUFFLING_OFF,  //Reshuffling disabled (setShuffling/relayout)
+    REBUILD_ROW_SORT,       //Row sort keys were set
+    REBUILD_OVERFLOW_TAKEN, //A chunk in need already borrowed an overflow slice
+    REBUILD_NO_CAPACITY     //The allocation had no room left for overflow slices
+  };
+  //Layout quality of the SCS on this process
+  struct LayoutMetrics {
+    lid_t num_elems, num_rows, num_chunks, num_slices, num_ptcls, capacity;
+    //Bytes allocated for the particle data (current and swap)
+    std::size_t allocation;
+    //Slots without a particle and their fraction of the capacity
+    lid_t padded_cells;
+    double padding_fraction;
+    //Rows that hold no particles (includes padding rows of the last chunk)
+    lid_t empty_rows;
+    //Holes per row
+    lid_t min_holes_per_row, max_holes_per_row;
+    double mean_holes_per_row;
+    //chunk_width_histogram[i] counts chunks of width in [2^(i-1), 2^i), [0] is width 0
+    std::vector<lid_t> chunk_width_histogram;
+    //Rebuild calls that were completed by reshuffling
+    lid_t reshuffle_attempts, reshuffle_successes;
+    double reshuffle_success_rate;
+    RebuildReason last_rebuild_reason;
+  };
+  //Computes the layout metrics of this process
+  LayoutMetrics getMetrics() const;
+
   //Do not call these functions:
   int chooseChunkHeight(int maxC, kkLidView ptcls_per_elem);
   void sigmaSort(PairView& ptcl_pairs, lid_t num_elems,
@@ -139,9 +596,32 @@ class SellCSigma : public ParticleStructure<DataTypes, MemSpace> {
   void createGlobalMapping(kkGidView elmGid, kkGidView& elm2Gid, GID_Mapping& elmGid2Lid);
   void constructOffsets(lid_t nChunks, lid_t& nSlices, kkLidView chunk_widths,
                         kkLidView& offs, kkLidView& s2e, lid_t& capacity);
+  void constructChunkOffsets(lid_t nChunks, kkLidView chunk_widths, kkLidView& chunk_offs);
   void setupParticleMask(kkLidView mask, PairView ptcls, kkLidView chunk_widths);
   void initSCSData(kkLidView chunk_widths, kkLidView particle_elements,
                    MTVs particle_info);
+  void rowSort(kkLidView new_element, kkLidView new_particle_elements,
+               kkLidView new_element_to_row, kkLidView row_start, lid_t new_C,
+               lid_t new_num_rows, lid_t num_entries, kkLidView new_indices,
+               kkLidView new_particle_indices, kkLidView new_particle_mask);
+  void relayout(lid_t new_C_max, lid_t new_sigma, lid_t new_V);
+  void updateActiveSlices();
+  void readCheckpoint(const std::string& filename);
+  bool addOverflowSlices(kkLidView new_particles_per_row, kkLidView num_holes_per_row);
+  /* Marks an empty slot of the row of elements[i] for each new particle as a particle
+       (borrowing overflow slices like reshuffle), particle indices[j] takes slot holes[j]
+     Returns false without changing the structure if the rows are sorted or full
+  */
+  bool fillHoles(kkLidView elements, kkLidView indices, kkLidView holes);
+  //Checks if every element gid fits the 32-bit gids of compressed migration (collective)
+  void updateCompactGids();
+  /* parallel_for over every slice (or only active slices) passing every slot (or only particles)
+       physical - pass the element of the row of each slot to misplaced particles too
+  */
+  template <typename FunctionType>
+  void parallel_for_slices(FunctionType& fn, std::string s, bool active_only,
+                           bool particles_only, bool physical = false);
+  void checkAutotune();
  private:
 
   //Variables from ParticleStructure
@@ -151,9 +631,16 @@ class SellCSigma : public ParticleStructure<DataTypes, MemSpace> {
   using ParticleStructure<DataTypes, MemSpace>::num_rows;
   using ParticleStructure<DataTypes, MemSpace>::ptcl_data;
   using ParticleStructure<DataTypes, MemSpace>::num_types;
+  using ParticleStructure<DataTypes, MemSpace>::exec_space;
+  using ParticleStructure<DataTypes, MemSpace>::layout_version;
 
   //The User defined kokkos policy
   PolicyType policy;
+  //The policy was chosen by recommendedPolicy and follows the layout of each rebuild
+  bool auto_policy;
+  //Vector lanes of each row in the slice launches
+  lid_t vector_length;
+  void updatePolicy();
   //Chunk size
   lid_t C_;
   //Max Chunk size from policy
@@ -174,6 +661,11 @@ class SellCSigma : public ParticleStructure<DataTypes, MemSpace> {
   kkLidView particle_mask;
   //offsets into the scs structure
   kkLidView offsets;
+  //offsets of each chunk, particle p of row r in chunk c is at chunk_offsets(c) + p*C + r
+  kkLidView chunk_offsets;
+  //start and width of the overflow slice borrowed by each chunk during reshuffle (0 if none)
+  kkLidView overflow_offsets;
+  kkLidView overflow_widths;
 
   //map from row to element
   // row = slice_to_chunk[slice] + row_in_chunk
@@ -192,11 +684,89 @@ class SellCSigma : public ParticleStructure<DataTypes, MemSpace> {
   double extra_padding;
   double shuffle_padding;
   PaddingStrategy pad_strat;
+  //PAD_ADAPTIVE: exponentially smoothed net particles gained per rebuild by each element
+  double inflow_smoothing;
+  Kokkos::View<double*, device_type> element_inflow;
+  void trackInflow(kkLidView new_element, kkLidView new_particle_elements);
   //True - try shuffling every rebuild, false - only rebuild
   bool tryShuffling;
+  //Rebuild one member type at a time without the swap views, see setLowMemoryRebuild
+  bool low_memory_rebuild;
+  //Lazy rebuilds, see setLazyRebuild
+  double lazy_threshold;
+  lid_t num_misplaced;
+  //Element of each misplaced particle, -1 for slots in the row of their element
+  //  Only read while num_misplaced > 0
+  kkLidView current_element;
+  //Records the elements of a rebuild without moving particles, false if they must move
+  bool recordLazyRebuild(kkLidView new_element, kkLidView new_particle_elements);
+  //Forgets the recorded elements once new_element holds the element of every particle
+  void dropLazyElements();
+  //Out of core storage, see evictToHost
+  bool evicted;
+  //First slot of each batch (num_batches + 1) and ex-sum of the packed bytes of each batch
+  std::vector<lid_t> batch_offsets;
+  std::vector<std::size_t> batch_bytes;
+  //Slots of the largest batch, the working set holds two batches
+  lid_t stream_window;
+  Kokkos::View<char*, StagingDevice> evicted_data;
+  Kokkos::View<char*, device_type> stream_buffer;
+  bool checkResident(const char* op) const;
+  void streamBatch(MTVs views, lid_t batch, lid_t first_index, std::size_t byte_offset,
+                   bool pack);
+  //Device bytes of the layout views tracked as scs_layout, see MemoryTracker.h
+  TrackedBytes layout_memory;
+  //Tracks the current layout views and transient bytes of views about to replace them
+  void trackLayout(long long transient = 0);
+  //Reshuffle statistics for getMetrics
+  lid_t reshuffle_attempts;
+  lid_t reshuffle_successes;
+  RebuildReason last_rebuild_reason;
+  //Slices that hold at least one particle
+  bool skip_empty_slices;
+  bool skip_masked_slots;
+  //Host parallel_for over the columns of each slice
+  bool column_wise;
+  kkLidView active_slices;
+  lid_t num_active_slices;
+  //Keys ordering particles within each row during the next rebuild
+  kkGidView row_sort_keys;
+  kkGidView new_row_sort_keys;
   //Metric Info
   lid_t num_empty_elements;
 
+  //Communicator of the processes particles are migrated between
+  MPI_Comm mpi_comm;
+
+  //Reused temporaries for migrate/rebuild
+  BufferPool<device_type> own_pool;
+  BufferPool<device_type>* pool;
+  //Host buffers for packed messages when MPI can not read device memory
+  BufferPool<StagingDevice> staging_pool;
+  //Previous particle mask reused by the next rebuild
+  kkLidView particle_mask_swap;
+
+  //Neighborhood migration
+  MPI_Comm neighbor_comm;
+  std::vector<int> neighbor_send_ranks;
+  std::vector<int> neighbor_recv_ranks;
+  //Index of each rank in neighbor_send_ranks (-1 if it is not a neighbor)
+  kkLidView rank_to_send_index;
+  //True - send one packed message per rank in migrate, false - one message per type
+  bool packed_migration;
+  //PackCodec of each member in packed migration (empty if not compressed)
+  std::vector<int> migration_codecs;
+  //True if element gids are packed as 32-bit integers
+  bool compact_gids;
+
+  //Autotuning
+  bool tuning;
+  int autotune_period;
+  int rebuilds_since_tune;
+  std::function<void()> autotune_fn;
+  std::vector<TuneResult> tune_results;
+  TuneResult tune_choice;
+
   //Private construct function
   void construct(kkLidView ptcls_per_elem,
                  kkGidView element_gids,
@@ -204,6 +774,47 @@ class SellCSigma : public ParticleStructure<DataTypes, MemSpace> {
                  MTVs particle_info);
   void destroy();
 
+  //Particle id index, see enableIdIndex (id_member is -1 when off)
+  int id_member;
+  kkLidView id_to_slot;
+  //Ids outside of id_to_slot since the last report and since enableIdIndex
+  kkLidView id_index_misses;
+  lid_t id_index_miss_total;
+  //Sets the slot of id in index, ids outside of index are counted in misses
+  static KOKKOS_INLINE_FUNCTION void indexId(const kkLidView& index, const kkLidView& misses,
+                                             const lid_t id, const lid_t slot) {
+    if (id >= 0 && id < (lid_t)index.extent(0))
+      index(id) = slot;
+    else
+      Kokkos::atomic_fetch_add(&misses(0), 1);
+  }
+  //Warns about the ids outside of the index met since the last report
+  void reportIdIndexMisses(const char* operation);
+  kkLidView idView(MTVs views) const {
+    return *static_cast<MemberTypeView<lid_t, device_type>*>(views[id_member]);
+  }
+  void indexAllIds();
+
+  //Device copies of functors for parallel_for and parallel_for_elements
+  template <typename FunctionType>
+  FunctionType* functorToDevice(FunctionType& fn, bool& captured);
+  template <typename FunctionType>
+  void releaseFunctor(FunctionType* fn_d, bool captured);
+  /* Pinned host and device copies of the functor of a captured kernel, kept for graph
+       replays until a later capture records a kernel of the same functor type (i.e.
+       KernelGraph recording again after the layout changed), which replaces the graph
+  */
+  struct GraphFunctor {
+    void* host;
+    void* device;
+    std::size_t type;
+    unsigned long long capture;
+  };
+  std::vector<GraphFunctor> graph_functors;
+  //Copies of replaced graphs, freed by the next launch outside of a capture
+  std::vector<GraphFunctor> stale_functors;
+  void freeGraphFunctors(std::vector<GraphFunctor>& functors);
+
 };
 
 template<class DataTypes, typename MemSpace>
@@ -212,22 +823,35 @@ void SellCSigma<DataTypes, MemSpace>::construct(kkLidView ptcls_per_elem,
                                                 kkLidView particle_elements,
                                                 MTVs particle_info) {
   Kokkos::Profiling::pushRegion("scs_construction");
+  MemoryPhase memory_phase("scs_construction");
   tryShuffling = true;
+  low_memory_rebuild = false;
+  lazy_threshold = 0;
+  num_misplaced = 0;
+  evicted = false;
+  stream_window = 0;
+  skip_empty_slices = false;
+  skip_masked_slots = false;
+  column_wise = false;
+  num_active_slices = 0;
+  reshuffle_attempts = reshuffle_successes = 0;
+  last_rebuild_reason = REBUILD_NONE;
   int comm_size;
-  MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+  MPI_Comm_size(mpi_comm, &comm_size);
   int comm_rank;
-  MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+  MPI_Comm_rank(mpi_comm, &comm_rank);
 
   C_max = policy.team_size();
   C_ = chooseChunkHeight(C_max, ptcls_per_elem);
 
-  if(!comm_rank)
+  if(!comm_rank && timePrintsEnabled())
     fprintf(stderr, "Building SCS with C: %d sigma: %d V: %d\n",C_,sigma,V_);
   //Perform sorting
   PairView ptcls;
   Kokkos::Timer timer;
   sigmaSort(ptcls, num_elems,ptcls_per_elem, sigma);
-  if(comm_rank == 0 || comm_rank == comm_size/2)
+  addRegionTime("scs_construct_sort", timer.seconds());
+  if((comm_rank == 0 || comm_rank == comm_size/2) && timePrintsEnabled())
     fprintf(stderr,"%d SCS sorting time (seconds) %f\n", comm_rank, timer.seconds());
 
   // Number of chunks without vertical slicing
@@ -241,14 +865,17 @@ void SellCSigma<DataTypes, MemSpace>::construct(kkLidView ptcls_per_elem,
 
   //Create offsets into each chunk/vertical slice
   constructOffsets(num_chunks, num_slices, chunk_widths, offsets, slice_to_chunk,capacity_);
+  constructChunkOffsets(num_chunks, chunk_widths, chunk_offsets);
+  overflow_offsets = kkLidView("overflow_offsets", num_chunks);
+  overflow_widths = kkLidView("overflow_widths", num_chunks);
 
   //Allocate the SCS and backup with 10% extra space
   lid_t cap = getLastValue<lid_t>(offsets);
   particle_mask = kkLidView("particle_mask", cap);
   if (extra_padding > 0)
     cap *= (1 + extra_padding);
-  CreateViews<device_type, DataTypes>(ptcl_data, cap);
-  CreateViews<device_type, DataTypes>(scs_data_swap, cap);
+  CreateViews<device_type, DataTypes>(ptcl_data, cap, "scs_particle_data");
+  CreateViews<device_type, DataTypes>(scs_data_swap, cap, "scs_particle_data");
   swap_size = current_size = cap;
 
   if (num_ptcls > 0)
@@ -259,6 +886,8 @@ void SellCSigma<DataTypes, MemSpace>::construct(kkLidView ptcls_per_elem,
   if (given_particles > 0 && particle_info != NULL) {
     initSCSData(chunk_widths, particle_elements, particle_info);
   }
+  trackLayout();
+  updatePolicy();
   Kokkos::Profiling::popRegion();
 }
 
@@ -268,9 +897,14 @@ SellCSigma<DataTypes, MemSpace>::SellCSigma(PolicyType& p, lid_t sig, lid_t v, l
                                             lid_t np, kkLidView ptcls_per_elem,
                                             kkGidView element_gids,
                                             kkLidView particle_elements,
-                                            MTVs particle_info) :
-  ParticleStructure<DataTypes, MemSpace>(), policy(p), element_gid_to_lid(ne) {
+                                            MTVs particle_info, MPI_Comm comm) :
+  ParticleStructure<DataTypes, MemSpace>(), policy(p), element_gid_to_lid(ne), mpi_comm(comm),
+  pool(&own_pool), staging_pool(1.1, "ps_staging_pool"), neighbor_comm(MPI_COMM_NULL),
+  packed_migration(true), compact_gids(false), tuning(false), autotune_period(0),
+  rebuilds_since_tune(0), id_member(-1), id_index_miss_total(0) {
   //Set variables
+  auto_policy = false;
+  vector_length = 1;
   sigma = sig;
   V_ = v;
   num_elems = ne;
@@ -278,12 +912,79 @@ SellCSigma<DataTypes, MemSpace>::SellCSigma(PolicyType& p, lid_t sig, lid_t v, l
   shuffle_padding = 0.0;
   extra_padding = 0.1;
   pad_strat = PAD_EVENLY;
+  inflow_smoothing = 0.5;
+  construct(ptcls_per_elem, element_gids, particle_elements, particle_info);
+}
+
+template<class DataTypes, typename MemSpace>
+SellCSigma<DataTypes, MemSpace>::SellCSigma(lid_t sig, lid_t v, lid_t ne, lid_t np,
+                                            kkLidView ptcls_per_elem,
+                                            kkGidView element_gids,
+                                            kkLidView particle_elements,
+                                            MTVs particle_info, MPI_Comm comm) :
+  ParticleStructure<DataTypes, MemSpace>(), policy(recommendedPolicy()),
+  element_gid_to_lid(ne), mpi_comm(comm), pool(&own_pool),
+  staging_pool(1.1, "ps_staging_pool"), neighbor_comm(MPI_COMM_NULL),
+  packed_migration(true), compact_gids(false), tuning(false), autotune_period(0),
+  rebuilds_since_tune(0), id_member(-1), id_index_miss_total(0) {
+  auto_policy = true;
+  vector_length = 1;
+  sigma = sig;
+  V_ = v;
+  num_elems = ne;
+  num_ptcls = np;
+  shuffle_padding = 0.0;
+  extra_padding = 0.1;
+  pad_strat = PAD_EVENLY;
+  inflow_smoothing = 0.5;
+  construct(ptcls_per_elem, element_gids, particle_elements, particle_info);
+}
+
+template<class DataTypes, typename MemSpace>
+SellCSigma<DataTypes, MemSpace>::SellCSigma(PolicyType& p, lid_t sig, lid_t v, lid_t ne,
+                                            kkGidView element_gids,
+                                            kkLidView particle_elements,
+                                            MTVs particle_info, MPI_Comm comm) :
+  ParticleStructure<DataTypes, MemSpace>(), policy(p), element_gid_to_lid(ne), mpi_comm(comm),
+  pool(&own_pool), staging_pool(1.1, "ps_staging_pool"), neighbor_comm(MPI_COMM_NULL),
+  packed_migration(true), compact_gids(false), tuning(false), autotune_period(0),
+  rebuilds_since_tune(0), id_member(-1), id_index_miss_total(0) {
+  auto_policy = false;
+  vector_length = 1;
+  sigma = sig;
+  V_ = v;
+  num_elems = ne;
+  num_ptcls = particle_elements.size();
+  shuffle_padding = 0.0;
+  extra_padding = 0.1;
+  pad_strat = PAD_EVENLY;
+  inflow_smoothing = 0.5;
+  //Histogram of the particle elements
+  kkLidView ptcls_per_elem("ptcls_per_elem", ne);
+  kkLidView invalid("invalid_elements", 1);
+  Kokkos::parallel_for("scs_count_elements", rangePolicy(num_ptcls),
+                       KOKKOS_LAMBDA(const lid_t& i) {
+      const lid_t elem = particle_elements(i);
+      if (elem < 0 || elem >= ne)
+        invalid(0) = 1;
+      else
+        Kokkos::atomic_fetch_add(&(ptcls_per_elem(elem)), 1);
+    });
+  if (getLastValue<lid_t>(exec_space, invalid)) {
+    fprintf(stderr, "[ERROR] Particle elements must be in [0, %d)\n", ne);
+    PS_ALWAYS_ASSERT(false);
+  }
   construct(ptcls_per_elem, element_gids, particle_elements, particle_info);
 }
 
 template<class DataTypes, typename MemSpace>
 SellCSigma<DataTypes, MemSpace>::SellCSigma(Input_T& input) :
-  ParticleStructure<DataTypes, MemSpace>(), policy(input.policy), element_gid_to_lid(input.ne) {
+  ParticleStructure<DataTypes, MemSpace>(), policy(input.policy), element_gid_to_lid(input.ne),
+  mpi_comm(input.mpi_comm), pool(&own_pool), staging_pool(1.1, "ps_staging_pool"),
+  neighbor_comm(MPI_COMM_NULL), packed_migration(true), compact_gids(false), tuning(false),
+  autotune_period(0), rebuilds_since_tune(0), id_member(-1), id_index_miss_total(0) {
+  auto_policy = false;
+  vector_length = 1;
   sigma = input.sig;
   V_ = input.V;
   num_elems = input.ne;
@@ -291,12 +992,54 @@ SellCSigma<DataTypes, MemSpace>::SellCSigma(Input_T& input) :
   shuffle_padding = input.shuffle_padding;
   extra_padding = input.extra_padding;
   pad_strat = input.padding_strat;
+  inflow_smoothing = input.inflow_smoothing;
   construct(input.ppe, input.e_gids, input.particle_elms, input.p_info);
 }
 template<class DataTypes, typename MemSpace>
+SellCSigma<DataTypes, MemSpace>::SellCSigma(PolicyType& p, const std::string& checkpoint,
+                                            MPI_Comm comm) :
+  ParticleStructure<DataTypes, MemSpace>(), policy(p), element_gid_to_lid(0),
+  mpi_comm(comm), pool(&own_pool), staging_pool(1.1, "ps_staging_pool"),
+  neighbor_comm(MPI_COMM_NULL), packed_migration(true), compact_gids(false), tuning(false),
+  autotune_period(0), rebuilds_since_tune(0), id_member(-1), id_index_miss_total(0) {
+  auto_policy = false;
+  vector_length = 1;
+  tryShuffling = true;
+  low_memory_rebuild = false;
+  lazy_threshold = 0;
+  num_misplaced = 0;
+  evicted = false;
+  stream_window = 0;
+  skip_empty_slices = false;
+  skip_masked_slots = false;
+  column_wise = false;
+  num_active_slices = 0;
+  reshuffle_attempts = reshuffle_successes = 0;
+  last_rebuild_reason = REBUILD_NONE;
+  inflow_smoothing = 0.5;
+  readCheckpoint(checkpoint);
+}
+template<class DataTypes, typename MemSpace>
 void SellCSigma<DataTypes, MemSpace>::destroy() {
   destroyViews<DataTypes, memory_space>(ptcl_data);
-  destroyViews<DataTypes, memory_space>(scs_data_swap);
+  if (scs_data_swap)
+    destroyViews<DataTypes, memory_space>(scs_data_swap);
+  int finalized;
+  MPI_Finalized(&finalized);
+  if (neighbor_comm != MPI_COMM_NULL && !finalized)
+    MPI_Comm_free(&neighbor_comm);
+  freeGraphFunctors(graph_functors);
+  freeGraphFunctors(stale_functors);
+}
+template<class DataTypes, typename MemSpace>
+void SellCSigma<DataTypes, MemSpace>::freeGraphFunctors(std::vector<GraphFunctor>& functors) {
+#ifdef PS_USE_CUDA
+  for (std::size_t i = 0; i < functors.size(); ++i) {
+    cudaFreeHost(functors[i].host);
+    cudaFree(functors[i].device);
+  }
+#endif
+  functors.clear();
 }
 template<class DataTypes, typename MemSpace>
 SellCSigma<DataTypes, MemSpace>::~SellCSigma() {
@@ -308,11 +1051,11 @@ SellCSigma<DataTypes, MemSpace>::~SellCSigma() {
 template<class DataTypes, typename MemSpace>
 void SellCSigma<DataTypes,MemSpace>::printFormat(const char* prefix) const {
   //Transfer everything to the host
-  kkLidHostMirror slice_to_chunk_host = deviceToHost(slice_to_chunk);
-  kkGidHostMirror element_to_gid_host = deviceToHost(element_to_gid);
-  kkLidHostMirror row_to_element_host = deviceToHost(row_to_element);
-  kkLidHostMirror offsets_host = deviceToHost(offsets);
-  kkLidHostMirror particle_mask_host = deviceToHost(particle_mask);
+  kkLidHostMirror slice_to_chunk_host = deviceToHost(exec_space, slice_to_chunk);
+  kkGidHostMirror element_to_gid_host = deviceToHost(exec_space, element_to_gid);
+  kkLidHostMirror row_to_element_host = deviceToHost(exec_space, row_to_element);
+  kkLidHostMirror offsets_host = deviceToHost(exec_space, offsets);
+  kkLidHostMirror particle_mask_host = deviceToHost(exec_space, particle_mask);
   char message[10000];
   char* cur = message;
   cur += sprintf(cur, "%s\n", prefix);
@@ -385,7 +1128,7 @@ void SellCSigma<DataTypes, MemSpace>::printMetrics() const {
   lid_t num_padded_slices = getLastValue<lid_t>(padded_slices);
 
   int comm_rank;
-  MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+  MPI_Comm_rank(mpi_comm, &comm_rank);
   char buffer[1000];
   char* ptr = buffer;
 
@@ -404,30 +1147,263 @@ void SellCSigma<DataTypes, MemSpace>::printMetrics() const {
   //Empty Elements
   ptr += sprintf(ptr, "Empty Rows <Tot %%> %d %.3f\n", num_empty_elements,
                  num_empty_elements * 100.0 / numRows());
+  //Buffer pool
+  ptr += sprintf(ptr, "Buffer Pool <Current High-water> %lu %lu\n", pool->currentBytes(),
+                 pool->highWaterBytes());
+  //Reshuffling
+  ptr += sprintf(ptr, "Reshuffles <Attempts Successes LastRebuildReason> %d %d %d\n",
+                 reshuffle_attempts, reshuffle_successes, last_rebuild_reason);
+  //Autotuning
+  if (tune_results.size() > 0)
+    ptr += sprintf(ptr, "Autotune <Candidates C sigma V Rebuild(s) Parallel_for(s)> "
+                   "%lu %d %d %d %f %f\n", tune_results.size(), tune_choice.C,
+                   tune_choice.sigma, tune_choice.V, tune_choice.rebuild_time,
+                   tune_choice.parallel_for_time);
 
   printf("%s\n",buffer);
+  printMemoryUsage(stdout);
+}
+
+template <class DataTypes, typename MemSpace>
+void SellCSigma<DataTypes, MemSpace>::trackLayout(long long transient) {
+  long long bytes = viewBytes(slice_to_chunk) + viewBytes(particle_mask) + viewBytes(offsets) +
+    viewBytes(chunk_offsets) + viewBytes(overflow_offsets) + viewBytes(overflow_widths) +
+    viewBytes(row_to_element) + viewBytes(element_to_row) + viewBytes(element_to_gid) +
+    viewBytes(element_inflow) + viewBytes(active_slices) + viewBytes(row_sort_keys) +
+    viewBytes(new_row_sort_keys) + viewBytes(rank_to_send_index) + viewBytes(id_to_slot) +
+    viewBytes(current_element);
+  //The previous mask is only separate memory when the current mask is not a part of it
+  if (particle_mask_swap.data() != particle_mask.data())
+    bytes += viewBytes(particle_mask_swap);
+  bytes += (long long)element_gid_to_lid.capacity() * (sizeof(gid_t) + sizeof(lid_t));
+  layout_memory.track("scs_layout", bytes + transient);
+}
+
+template <class DataTypes, typename MemSpace>
+typename SellCSigma<DataTypes, MemSpace>::PolicyType
+SellCSigma<DataTypes, MemSpace>::recommendedPolicy(lid_t league_size) {
+  if (league_size < 1)
+    league_size = 1;
+  const PolicyType probe(league_size, 1);
+  //Stands in for the slice loops of parallel_for
+  auto sliceLoop = KOKKOS_LAMBDA(const typename PolicyType::member_type& thread) {
+    thread.team_barrier();
+  };
+  int team_size = 1;
+  if (std::is_same<memory_space, Kokkos::HostSpace>::value) {
+    team_size = PS_SIMD_BYTES / sizeof(double);
+    const int team_max = probe.team_size_max(sliceLoop, Kokkos::ParallelForTag());
+    if (team_size > team_max)
+      team_size = team_max;
+  }
+  else {
+    const int warp = PolicyType::vector_length_max();
+    const int recommended = probe.team_size_recommended(sliceLoop, Kokkos::ParallelForTag());
+    team_size = recommended < warp ? recommended : warp;
+  }
+  if (team_size < 1)
+    team_size = 1;
+  return PolicyType(league_size, team_size);
+}
+
+template <class DataTypes, typename MemSpace>
+void SellCSigma<DataTypes, MemSpace>::updatePolicy() {
+  if (!auto_policy)
+    return;
+  vector_length = 1;
+  if (!std::is_same<memory_space, Kokkos::HostSpace>::value && C_ > 0) {
+    //Largest power of two lanes that keeps a team within one warp
+    const int warp = PolicyType::vector_length_max();
+    while (C_ * vector_length * 2 <= warp)
+      vector_length *= 2;
+  }
+  //The team size stays the largest chunk height so autotune keeps every candidate
+  policy = PolicyType(exec_space, num_slices > 0 ? num_slices : 1, policy.team_size(),
+                      vector_length);
+}
+
+template <class DataTypes, typename MemSpace>
+typename SellCSigma<DataTypes, MemSpace>::LayoutMetrics
+SellCSigma<DataTypes, MemSpace>::getMetrics() const {
+  LayoutMetrics metrics;
+  metrics.num_elems = num_elems;
+  metrics.num_rows = num_rows;
+  metrics.num_chunks = num_chunks;
+  metrics.num_slices = num_slices;
+  metrics.num_ptcls = num_ptcls;
+  metrics.capacity = capacity_;
+  metrics.allocation = (current_size + swap_size) * DataTypes::memsize;
+  metrics.padded_cells = capacity_ - num_ptcls;
+  metrics.padding_fraction = capacity_ > 0 ? (double)metrics.padded_cells / capacity_ : 0;
+
+  //Holes and particles of each row
+  metrics.empty_rows = metrics.min_holes_per_row = metrics.max_holes_per_row = 0;
+  metrics.mean_holes_per_row = 0;
+  if (num_rows > 0) {
+    kkLidView ptcls_per_row("metrics_ptcls_per_row", num_rows);
+    kkLidView holes_per_row("metrics_holes_per_row", num_rows);
+    const lid_t league_size = num_slices;
+    const lid_t team_size = C_;
+    const PolicyType policy(league_size, team_size);
+    auto offsets_cpy = offsets;
+    auto slice_to_chunk_cpy = slice_to_chunk;
+    auto particle_mask_cpy = particle_mask;
+    Kokkos::parallel_for("GatherRowMetrics", policy,
+                         KOKKOS_LAMBDA(const typename PolicyType::member_type& thread) {
+      const lid_t slice = thread.league_rank();
+      const lid_t slice_row = thread.team_rank();
+      const lid_t rowLen = (offsets_cpy(slice+1)-offsets_cpy(slice))/team_size;
+      const lid_t start = offsets_cpy(slice) + slice_row;
+      const lid_t row = slice_to_chunk_cpy(slice) * team_size + slice_row;
+      lid_t np = 0;
+      for (lid_t p = 0; p < rowLen; ++p)
+        np += particle_mask_cpy(start + p * team_size);
+      Kokkos::atomic_fetch_add(&ptcls_per_row(row), np);
+      Kokkos::atomic_fetch_add(&holes_per_row(row), rowLen - np);
+    });
+    lid_t empty = 0, min_holes = 0, max_holes = 0, total_holes = 0;
+    Kokkos::parallel_reduce("metrics_empty_rows", num_rows,
+                            KOKKOS_LAMBDA(const lid_t& i, lid_t& sum) {
+        sum += ptcls_per_row(i) == 0;
+      }, empty);
+    Kokkos::parallel_reduce("metrics_min_holes", num_rows,
+                            KOKKOS_LAMBDA(const lid_t& i, lid_t& mn) {
+        if (holes_per_row(i) < mn)
+          mn = holes_per_row(i);
+      }, Kokkos::Min<lid_t>(min_holes));
+    Kokkos::parallel_reduce("metrics_max_holes", num_rows,
+                            KOKKOS_LAMBDA(const lid_t& i, lid_t& mx) {
+        if (holes_per_row(i) > mx)
+          mx = holes_per_row(i);
+      }, Kokkos::Max<lid_t>(max_holes));
+    Kokkos::parallel_reduce("metrics_total_holes", num_rows,
+                            KOKKOS_LAMBDA(const lid_t& i, lid_t& sum) {
+        sum += holes_per_row(i);
+      }, total_holes);
+    metrics.empty_rows = empty;
+    metrics.min_holes_per_row = min_holes;
+    metrics.max_holes_per_row = max_holes;
+    metrics.mean_holes_per_row = (double)total_holes / num_rows;
+
+    //Histogram of chunk widths including overflow slices
+    kkLidHostMirror chunk_offsets_host = deviceToHost(exec_space, chunk_offsets);
+    kkLidHostMirror overflow_widths_host = deviceToHost(exec_space, overflow_widths);
+    for (lid_t i = 0; i < num_chunks; ++i) {
+      const lid_t width = (chunk_offsets_host(i+1) - chunk_offsets_host(i)) / C_ +
+        overflow_widths_host(i);
+      std::size_t bucket = 0;
+      while ((1 << bucket) <= width)
+        ++bucket;
+      if (metrics.chunk_width_histogram.size() <= bucket)
+        metrics.chunk_width_histogram.resize(bucket + 1, 0);
+      ++metrics.chunk_width_histogram[bucket];
+    }
+  }
+
+  metrics.reshuffle_attempts = reshuffle_attempts;
+  metrics.reshuffle_successes = reshuffle_successes;
+  metrics.reshuffle_success_rate = reshuffle_attempts > 0 ?
+    (double)reshuffle_successes / reshuffle_attempts : 0;
+  metrics.last_rebuild_reason = last_rebuild_reason;
+  return metrics;
 }
 
 template <class DataTypes, typename MemSpace>
 template <typename FunctionType>
 void SellCSigma<DataTypes, MemSpace>::parallel_for(FunctionType& fn, std::string name) {
-  FunctionType* fn_d;
-#ifdef PS_USE_CUDA
-  cudaMalloc(&fn_d, sizeof(FunctionType));
-  cudaMemcpy(fn_d,&fn, sizeof(FunctionType), cudaMemcpyHostToDevice);
-#else
-  fn_d = &fn;
-#endif
-  const lid_t league_size = num_slices;
+  parallel_for_slices(fn, name, skip_empty_slices, skip_masked_slots);
+  if (!name.empty())
+    recordKernelWork(name, 0, num_ptcls);
+}
+
+template <class DataTypes, typename MemSpace>
+template <typename FunctionType>
+void SellCSigma<DataTypes, MemSpace>::parallel_for(kkLidView elements, FunctionType& fn,
+                                                   std::string name) {
+  flushLazyRebuild();
+  const lid_t num_subset = elements.extent(0);
+  if (num_subset == 0 || num_rows == 0)
+    return;
+  bool captured;
+  FunctionType* fn_d = functorToDevice(fn, captured);
+  const bool particles_only = skip_masked_slots;
+  const lid_t C_local = C_;
+  auto element_to_row_cpy = element_to_row;
+  auto chunk_offsets_cpy = chunk_offsets;
+  auto overflow_offsets_cpy = overflow_offsets;
+  auto overflow_widths_cpy = overflow_widths;
+  auto particle_mask_cpy = particle_mask;
+  const PolicyType policy(exec_space, num_subset, Kokkos::AUTO);
+  Kokkos::parallel_for(name, policy, KOKKOS_LAMBDA(const TeamMember& team) {
+    const lid_t element_id = elements(team.league_rank());
+    const lid_t row = element_to_row_cpy(element_id);
+    const lid_t chunk = row / C_local;
+    const lid_t row_in_chunk = row % C_local;
+    const lid_t start = chunk_offsets_cpy(chunk);
+    const lid_t num_slots = (chunk_offsets_cpy(chunk+1) - start) / C_local;
+    const RowParticles particles(start + row_in_chunk, C_local, num_slots,
+                                 overflow_offsets_cpy(chunk) + row_in_chunk,
+                                 overflow_widths_cpy(chunk), particle_mask_cpy);
+    Kokkos::parallel_for(Kokkos::TeamThreadRange(team, particles.size()), [&](const lid_t& i) {
+      const lid_t particle_id = particles(i);
+      const lid_t mask = particle_mask_cpy(particle_id);
+      if (mask || !particles_only)
+        (*fn_d)(element_id, particle_id, mask);
+    });
+  });
+  releaseFunctor(fn_d, captured);
+}
+
+template <class DataTypes, typename MemSpace>
+template <typename FunctionType>
+void SellCSigma<DataTypes, MemSpace>::parallel_for_slices(FunctionType& fn, std::string name,
+                                                          bool active_only,
+                                                          bool particles_only,
+                                                          bool physical) {
+  const lid_t league_size = active_only ? num_active_slices : num_slices;
+  if (league_size == 0)
+    return;
+  bool captured;
+  FunctionType* fn_d = functorToDevice(fn, captured);
   const lid_t team_size = C_;
-  const PolicyType policy(league_size, team_size);
   auto offsets_cpy = offsets;
   auto slice_to_chunk_cpy = slice_to_chunk;
   auto row_to_element_cpy = row_to_element;
   auto particle_mask_cpy = particle_mask;
+  auto active_slices_cpy = active_slices;
+  //Misplaced particles of lazy rebuilds are passed their recorded element
+  const bool lazy = !physical && num_misplaced > 0;
+  auto current_element_cpy = current_element;
+  //Overflow slots borrowed after the last lazy rebuild are not recorded
+  const lid_t num_recorded = current_element.size();
+  if (column_wise && std::is_same<memory_space, Kokkos::HostSpace>::value) {
+    Kokkos::parallel_for(name, rangePolicy(league_size), KOKKOS_LAMBDA(const lid_t& i) {
+      const lid_t slice = active_only ? active_slices_cpy(i) : i;
+      const lid_t first_row = slice_to_chunk_cpy(slice) * team_size;
+      const lid_t start = offsets_cpy(slice);
+      const lid_t rowLen = (offsets_cpy(slice+1) - start) / team_size;
+      for (lid_t p = 0; p < rowLen; ++p) {
+        const lid_t column = start + p * team_size;
+        PS_SIMD
+        for (lid_t r = 0; r < team_size; ++r) {
+          const lid_t particle_id = column + r;
+          const lid_t mask = particle_mask_cpy[particle_id];
+          const lid_t recorded = lazy && particle_id < num_recorded ?
+            current_element_cpy(particle_id) : -1;
+          if (mask || !particles_only)
+            (*fn_d)(recorded >= 0 ? recorded : row_to_element_cpy(first_row + r),
+                    particle_id, mask);
+        }
+      }
+    });
+    releaseFunctor(fn_d, captured);
+    return;
+  }
+  const PolicyType policy(exec_space, league_size, team_size, vector_length);
   Kokkos::parallel_for(name, policy,
                        KOKKOS_LAMBDA(const typename PolicyType::member_type& thread) {
-    const lid_t slice = thread.league_rank();
+    const lid_t slice = active_only ? active_slices_cpy(thread.league_rank()) :
+      thread.league_rank();
     const lid_t slice_row = thread.team_rank();
     const lid_t rowLen = (offsets_cpy(slice+1)-offsets_cpy(slice))/team_size;
     const lid_t start = offsets_cpy(slice) + slice_row;
@@ -437,10 +1413,325 @@ void SellCSigma<DataTypes, MemSpace>::parallel_for(FunctionType& fn, std::string
       Kokkos::parallel_for(Kokkos::ThreadVectorRange(thread, rowLen), [&] (lid_t& p) {
         const lid_t particle_id = start+(p*team_size);
         const lid_t mask = particle_mask_cpy[particle_id];
-        (*fn_d)(element_id, particle_id, mask);
+        const lid_t recorded = lazy && particle_id < num_recorded ?
+          current_element_cpy(particle_id) : -1;
+        if (mask || !particles_only)
+          (*fn_d)(recorded >= 0 ? recorded : element_id, particle_id, mask);
       });
     });
   });
+  releaseFunctor(fn_d, captured);
+}
+
+template <class DataTypes, typename MemSpace>
+template <typename FunctionType>
+FunctionType* SellCSigma<DataTypes, MemSpace>::functorToDevice(FunctionType& fn,
+                                                               bool& captured) {
+  captured = false;
+#ifdef PS_USE_CUDA
+  cudaStreamCaptureStatus status = cudaStreamCaptureStatusNone;
+  unsigned long long capture = 0;
+  cudaStreamGetCaptureInfo(exec_space.cuda_stream(), &status, &capture);
+  captured = status == cudaStreamCaptureStatusActive;
+  //Freeing synchronizes the device, so the copies of replaced graphs wait for a launch
+  if (!captured && !stale_functors.empty())
+    freeGraphFunctors(stale_functors);
+  FunctionType* fn_d;
+  cudaMalloc(&fn_d, sizeof(FunctionType));
+  if (captured) {
+    //Copies of the same kernel recorded by an earlier capture belong to a replaced graph
+    const std::size_t type = typeid(FunctionType).hash_code();
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < graph_functors.size(); ++i) {
+      if (graph_functors[i].type == type && graph_functors[i].capture != capture)
+        stale_functors.push_back(graph_functors[i]);
+      else
+        graph_functors[kept++] = graph_functors[i];
+    }
+    graph_functors.resize(kept);
+    //The copy is recorded into the graph, so its source must outlive the capture
+    void* fn_h;
+    cudaMallocHost(&fn_h, sizeof(FunctionType));
+    memcpy(fn_h, &fn, sizeof(FunctionType));
+    cudaMemcpyAsync(fn_d, fn_h, sizeof(FunctionType), cudaMemcpyHostToDevice,
+                    exec_space.cuda_stream());
+    const GraphFunctor copies = {fn_h, (void*)fn_d, type, capture};
+    graph_functors.push_back(copies);
+  }
+  else
+    cudaMemcpy(fn_d,&fn, sizeof(FunctionType), cudaMemcpyHostToDevice);
+  return fn_d;
+#else
+  return &fn;
+#endif
+}
+
+template <class DataTypes, typename MemSpace>
+template <typename FunctionType>
+void SellCSigma<DataTypes, MemSpace>::releaseFunctor(FunctionType* fn_d, bool captured) {
+#ifdef PS_USE_CUDA
+  //Captured kernels are not run yet, their functors are freed when the graph is replaced
+  if (!captured) {
+    exec_space.fence();
+    cudaFree(fn_d);
+  }
+#endif
+}
+
+template <class DataTypes, typename MemSpace>
+void SellCSigma<DataTypes, MemSpace>::setLazyRebuild(double max_misplaced) {
+  if (max_misplaced < 0 || max_misplaced > 1) {
+    fprintf(stderr, "[WARNING] Lazy rebuild fraction %f is not in [0, 1], using %d\n",
+            max_misplaced, max_misplaced > 1);
+    max_misplaced = max_misplaced > 1;
+  }
+  lazy_threshold = max_misplaced;
+  if (lazy_threshold == 0)
+    flushLazyRebuild();
+}
+
+template <class DataTypes, typename MemSpace>
+void SellCSigma<DataTypes, MemSpace>::flushLazyRebuild() {
+  if (num_misplaced == 0)
+    return;
+  //Every particle moves to its recorded element
+  kkLidView new_element = pool->template get<lid_t>(exec_space, "lazy_flush_new_element",
+                                                    capacity_, false);
+  auto recordedElement = PS_LAMBDA(const lid_t& element_id, const lid_t& particle_id,
+                                   const bool& mask) {
+    new_element(particle_id) = mask ? element_id : -1;
+  };
+  parallel_for_slices(recordedElement, "lazy_flush_elements", false, false);
+  const double threshold = lazy_threshold;
+  lazy_threshold = 0;
+  rebuild(new_element);
+  lazy_threshold = threshold;
+}
+
+template <class DataTypes, typename MemSpace>
+void SellCSigma<DataTypes, MemSpace>::dropLazyElements() {
+  if (num_misplaced == 0)
+    return;
+  //The launches stop reading the recorded elements
+  num_misplaced = 0;
+  ++layout_version;
+}
+
+template <class DataTypes, typename MemSpace>
+void SellCSigma<DataTypes, MemSpace>::setSkipEmpty(bool skip_empty, bool skip_masked) {
+  skip_empty_slices = skip_empty;
+  skip_masked_slots = skip_masked;
+  if (skip_empty_slices)
+    updateActiveSlices();
+  ++layout_version;
+}
+
+template <class DataTypes, typename MemSpace>
+template <std::size_t N>
+void SellCSigma<DataTypes, MemSpace>::enableIdIndex(lid_t max_id) {
+  static_assert(std::is_same<typename ParticleStructure<DataTypes, MemSpace>::template
+                DataType<N>, lid_t>::value, "The id member must be of type lid_t");
+  id_member = N;
+  id_to_slot = kkLidView("id_to_slot", max_id);
+  id_index_misses = kkLidView("id_index_misses", 1);
+  id_index_miss_total = 0;
+  indexAllIds();
+  reportIdIndexMisses("enableIdIndex");
+}
+
+template <class DataTypes, typename MemSpace>
+void SellCSigma<DataTypes, MemSpace>::indexAllIds() {
+  Kokkos::deep_copy(exec_space, id_to_slot, -1);
+  if (capacity_ == 0)
+    return;
+  kkLidView ids = idView(ptcl_data);
+  kkLidView index = id_to_slot;
+  kkLidView misses = id_index_misses;
+  auto particle_mask_cpy = particle_mask;
+  Kokkos::parallel_for("index_all_ids", rangePolicy(capacity_), KOKKOS_LAMBDA(const lid_t& p) {
+      if (particle_mask_cpy(p))
+        indexId(index, misses, ids(p), p);
+    });
+}
+
+template <class DataTypes, typename MemSpace>
+void SellCSigma<DataTypes, MemSpace>::reportIdIndexMisses(const char* operation) {
+  const lid_t misses = getLastValue(exec_space, id_index_misses);
+  if (misses == 0)
+    return;
+  id_index_miss_total += misses;
+  fprintf(stderr, "[WARNING] %s met %d particle ids outside of the id index [0, %d), they are "
+          "not indexed\n", operation, misses, (int)id_to_slot.extent(0));
+  Kokkos::deep_copy(exec_space, id_index_misses, 0);
+}
+
+template <class DataTypes, typename MemSpace>
+void SellCSigma<DataTypes, MemSpace>::updateActiveSlices() {
+  if (num_slices == 0) {
+    num_active_slices = 0;
+    return;
+  }
+  if (active_slices.size() < (std::size_t)num_slices)
+    active_slices = kkLidView("active_slices", num_slices);
+  kkLidView slice_active = pool->template get<lid_t>(exec_space, "active_slice_flags",
+                                                     num_slices, false);
+  auto offsets_cpy = offsets;
+  auto particle_mask_cpy = particle_mask;
+  Kokkos::parallel_for("find_active_slices", rangePolicy(num_slices), KOKKOS_LAMBDA(const lid_t& i) {
+      lid_t active = 0;
+      for (lid_t j = offsets_cpy(i); j < offsets_cpy(i+1) && !active; ++j)
+        active = particle_mask_cpy(j);
+      slice_active(i) = active;
+    });
+  auto active_slices_cpy = active_slices;
+  Kokkos::parallel_scan("compact_active_slices", rangePolicy(num_slices),
+                        KOKKOS_LAMBDA(const lid_t& i, lid_t& cur, const bool& final) {
+      if (final && slice_active(i))
+        active_slices_cpy(cur) = i;
+      cur += slice_active(i);
+    }, num_active_slices);
+}
+
+template <class DataTypes, typename MemSpace>
+template <typename FunctionType>
+void SellCSigma<DataTypes, MemSpace>::parallel_for_elements(FunctionType& fn,
+                                                            std::size_t scratch_bytes,
+                                                            int team_size, std::string name) {
+  flushLazyRebuild();
+  if (num_rows == 0)
+    return;
+  bool captured;
+  FunctionType* fn_d = functorToDevice(fn, captured);
+  PolicyType policy = team_size > 0 ? PolicyType(exec_space, num_rows, team_size) :
+    PolicyType(exec_space, num_rows, Kokkos::AUTO);
+  if (scratch_bytes > 0)
+    policy.set_scratch_size(0, Kokkos::PerTeam(scratch_bytes));
+  const lid_t C_local = C_;
+  auto chunk_offsets_cpy = chunk_offsets;
+  auto overflow_offsets_cpy = overflow_offsets;
+  auto overflow_widths_cpy = overflow_widths;
+  auto row_to_element_cpy = row_to_element;
+  auto particle_mask_cpy = particle_mask;
+  Kokkos::parallel_for(name, policy, KOKKOS_LAMBDA(const TeamMember& team) {
+    const lid_t row = team.league_rank();
+    const lid_t chunk = row / C_local;
+    const lid_t row_in_chunk = row % C_local;
+    const lid_t start = chunk_offsets_cpy(chunk);
+    const lid_t num_slots = (chunk_offsets_cpy(chunk+1) - start) / C_local;
+    const lid_t element_id = row_to_element_cpy(row);
+    const RowParticles particles(start + row_in_chunk, C_local, num_slots,
+                                 overflow_offsets_cpy(chunk) + row_in_chunk,
+                                 overflow_widths_cpy(chunk), particle_mask_cpy);
+    (*fn_d)(team, element_id, particles);
+  });
+  releaseFunctor(fn_d, captured);
+}
+
+template <class DataTypes, typename MemSpace>
+template <typename FunctionType>
+void SellCSigma<DataTypes, MemSpace>::parallel_for_element_groups(FunctionType& fn,
+                                                                  std::string name) {
+  flushLazyRebuild();
+  if (num_rows == 0)
+    return;
+  const lid_t C_local = C_;
+  auto chunk_offsets_cpy = chunk_offsets;
+  auto overflow_offsets_cpy = overflow_offsets;
+  auto overflow_widths_cpy = overflow_widths;
+  auto row_to_element_cpy = row_to_element;
+  auto particle_mask_cpy = particle_mask;
+  //The group of the widest row bounds the scratch of every team
+  lid_t max_row = 0;
+  Kokkos::parallel_reduce("max_row_size", rangePolicy(num_chunks),
+                          KOKKOS_LAMBDA(const lid_t& i, lid_t& mx) {
+      const lid_t width = (chunk_offsets_cpy(i+1) - chunk_offsets_cpy(i)) / C_local +
+        overflow_widths_cpy(i);
+      if (width > mx)
+        mx = width;
+    }, Kokkos::Max<lid_t>(max_row));
+  const std::size_t bytes = (max_row + 1) * sizeof(lid_t);
+  const int level = bytes <= (std::size_t)PolicyType::scratch_size_max(0) ? 0 : 1;
+  bool captured;
+  FunctionType* fn_d = functorToDevice(fn, captured);
+  PolicyType policy(exec_space, num_rows, Kokkos::AUTO);
+  policy.set_scratch_size(level, Kokkos::PerTeam(bytes));
+  Kokkos::parallel_for(name, policy, KOKKOS_LAMBDA(const TeamMember& team) {
+    lid_t* ptcls = (lid_t*)team.team_scratch(level).get_shmem(bytes);
+    const lid_t row = team.league_rank();
+    const lid_t chunk = row / C_local;
+    const lid_t row_in_chunk = row % C_local;
+    const lid_t start = chunk_offsets_cpy(chunk);
+    const lid_t num_slots = (chunk_offsets_cpy(chunk+1) - start) / C_local;
+    const lid_t element_id = row_to_element_cpy(row);
+    const RowParticles slots(start + row_in_chunk, C_local, num_slots,
+                             overflow_offsets_cpy(chunk) + row_in_chunk,
+                             overflow_widths_cpy(chunk), particle_mask_cpy);
+    lid_t num_ptcls = 0;
+    Kokkos::parallel_reduce(Kokkos::TeamThreadRange(team, slots.size()),
+                            [=](const lid_t& i, lid_t& sum) {
+      sum += slots.mask(i) != 0;
+    }, num_ptcls);
+    Kokkos::parallel_scan(Kokkos::TeamThreadRange(team, slots.size()),
+                          [=](const lid_t& i, lid_t& cur, const bool& final) {
+      if (slots.mask(i)) {
+        if (final)
+          ptcls[cur] = slots(i);
+        ++cur;
+      }
+    });
+    team.team_barrier();
+    (*fn_d)(team, element_id, ElementGroup(ptcls, num_ptcls));
+  });
+  releaseFunctor(fn_d, captured);
+}
+
+namespace scs_pairs {
+  //Device random number from a seed, element and index (splitmix64 finalizer)
+  KOKKOS_INLINE_FUNCTION std::uint64_t pairHash(std::uint64_t seed, lid_t elm, lid_t i) {
+    std::uint64_t z = seed +
+      0x9E3779B97F4A7C15ull * ((std::uint64_t)elm * 0x100000001ull + i + 1);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  //Shuffles each element group and calls the pair functor for consecutive particles
+  template <typename SCS, typename FunctionType>
+  struct PairGroups {
+    PairGroups(const FunctionType& f, bool sh, std::size_t sd) : fn(f), shuffle(sh), seed(sd) {}
+    KOKKOS_INLINE_FUNCTION void operator()(const typename SCS::TeamMember& team,
+                                           const lid_t& elm_id,
+                                           const typename SCS::ElementGroup& group) const {
+      if (shuffle && group.size() > 2) {
+        const std::size_t s = seed;
+        Kokkos::single(Kokkos::PerTeam(team), [=]() {
+          for (lid_t i = group.size() - 1; i > 0; --i) {
+            const lid_t j = pairHash(s, elm_id, i) % (i + 1);
+            const lid_t tmp = group.ptcls[i];
+            group.ptcls[i] = group.ptcls[j];
+            group.ptcls[j] = tmp;
+          }
+        });
+        team.team_barrier();
+      }
+      const FunctionType& f = fn;
+      Kokkos::parallel_for(Kokkos::TeamThreadRange(team, group.size() / 2),
+                           [&](const lid_t& i) {
+        f(elm_id, group(2 * i), group(2 * i + 1));
+      });
+    }
+    FunctionType fn;
+    bool shuffle;
+    std::size_t seed;
+  };
+}
+
+template <class DataTypes, typename MemSpace>
+template <typename FunctionType>
+void SellCSigma<DataTypes, MemSpace>::parallel_for_pairs(FunctionType& fn, bool shuffle,
+                                                         std::size_t seed, std::string name) {
+  scs_pairs::PairGroups<SellCSigma<DataTypes, MemSpace>, FunctionType> pairs(fn, shuffle, seed);
+  parallel_for_element_groups(pairs, name);
 }
 
 } // end namespace particle_structs
@@ -449,6 +1740,10 @@ void SellCSigma<DataTypes, MemSpace>::parallel_for(FunctionType& fn, std::string
 #include "SCS_sort.h"
 #include "SCS_buildFns.h"
 #include "SCS_rebuild.h"
+#include "SCS_resample.h"
+#include "SCS_stream.h"
 #include "SCS_migrate.h"
+#include "SCS_autotune.h"
+#include "SCS_checkpoint.h"
 
 #endif
@@ -7,7 +7,10 @@ namespace particle_structs {
       //Divide padding proportionally (more particles in element = more padding)
       PAD_PROPORTIONALLY,
       //Divide padding inverse-proportionally (more particles in element = less padding)
-      PAD_INVERSELY
+      PAD_INVERSELY,
+      //Divide padding by the smoothed net inflow of particles to each element over the
+      //  previous rebuilds (elements that keep gaining particles = more padding)
+      PAD_ADAPTIVE
     };
   template <class DataTypes, typename MemSpace>
   class SellCSigma;
@@ -30,6 +33,11 @@ namespace particle_structs {
 
     //Padding strategy
     PaddingStrategy padding_strat;
+    //Weight of the latest rebuild in the smoothed inflow of PAD_ADAPTIVE [default = 0.5]
+    double inflow_smoothing;
+
+    //Communicator of the processes particles are migrated between [default = MPI_COMM_WORLD]
+    MPI_Comm mpi_comm;
 
     friend class SellCSigma<DataTypes, MemSpace>;
   protected:
@@ -51,5 +59,7 @@ namespace particle_structs {
     shuffle_padding = 0.1;
     extra_padding = 0.05;
     padding_strat = PAD_EVENLY;
+    inflow_smoothing = 0.5;
+    mpi_comm = MPI_COMM_WORLD;
   }
 }
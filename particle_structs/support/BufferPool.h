@@ -0,0 +1,130 @@
+#pragma once
+
+#include "MemberTypeLibraries.h"
+#include <Kokkos_Core.hpp>
+#include <functional>
+#include <string>
+#include <map>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+
+namespace particle_structs {
+
+  /* Persistent, growable pool of device buffers keyed by name
+
+     Temporaries of repeated operations (migrate/rebuild) are requested by name every call.
+     The allocation behind a name is only replaced when a larger size is requested, so
+     steady state calls reuse memory instead of allocating and freeing each time.
+
+     The memory of the pool is tracked (see MemoryTracker.h) as <label>_<first word of the
+       buffer name>, i.e. ps_pool_migrate for the buffers named migrate_*.
+
+     Usage:
+       BufferPool<Device> pool;
+       auto view = pool.get<lid_t>("name", size); //zero initialized view of length size
+       auto buffer = pool.get<char>("name", size, false); //uninitialized view of length size
+       auto views = pool.getMemberViews<DataTypes>("name", size); //uninitialized member views
+
+     Note: Views returned by the pool do not own their memory, they are only valid until the
+           same name is requested again or the pool is destroyed. Views of different names
+           can be used at the same time.
+     Note: Member views are kept per name and DataTypes, so structures of different types
+           sharing a pool never receive each other's member views.
+   */
+  template <typename Device>
+  class BufferPool {
+  public:
+    typedef Kokkos::View<char*, Device> ByteView;
+
+    BufferPool(double growth_factor = 1.1, const std::string& pool_label = "ps_pool") :
+      growth(growth_factor), label(pool_label), current_bytes(0), high_water_bytes(0) {}
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+    ~BufferPool() {
+      for (auto itr = buffers.begin(); itr != buffers.end(); ++itr)
+        trackMemory(subsystem(itr->first), -(long long)itr->second.size());
+      for (auto itr = member_buffers.begin(); itr != member_buffers.end(); ++itr)
+        itr->second.destroy(itr->second.views);
+    }
+
+    template <typename T>
+    Kokkos::View<T*, Device> get(const std::string& name, std::size_t size,
+                                 bool initialize = true) {
+      Kokkos::View<T*, Device> view = getUninitialized<T>(name, size);
+      if (initialize)
+        Kokkos::deep_copy(view, T());
+      return view;
+    }
+    //Zero initializes the view on the execution space instance space without a fence
+    template <typename T, typename ExecSpace>
+    Kokkos::View<T*, Device> get(const ExecSpace& space, const std::string& name,
+                                 std::size_t size, bool initialize = true) {
+      Kokkos::View<T*, Device> view = getUninitialized<T>(name, size);
+      if (initialize)
+        Kokkos::deep_copy(space, view, T());
+      return view;
+    }
+
+    template <typename DataTypes>
+    MemberTypeViews<DataTypes, Device> getMemberViews(const std::string& name,
+                                                      std::size_t size) {
+      const MemberKey key(name, std::type_index(typeid(DataTypes)));
+      MemberBuffer& buffer = member_buffers[key];
+      if (buffer.views == NULL || buffer.size < size) {
+        if (buffer.views != NULL) {
+          buffer.destroy(buffer.views);
+          current_bytes -= buffer.size * DataTypes::memsize;
+        }
+        buffer.size = size * growth;
+        CreateViews<Device, DataTypes>(buffer.views, buffer.size, subsystem(name).c_str());
+        buffer.destroy = [](MemberTypeViews<DataTypes, Device> views) {
+          DestroyViews<Device, DataTypes>(views + 0);
+        };
+        addBytes(buffer.size * DataTypes::memsize);
+      }
+      return buffer.views;
+    }
+
+    //Bytes currently held by the pool
+    std::size_t currentBytes() const {return current_bytes;}
+    //Most bytes held by the pool at once
+    std::size_t highWaterBytes() const {return high_water_bytes;}
+
+  private:
+    template <typename T>
+    Kokkos::View<T*, Device> getUninitialized(const std::string& name, std::size_t size) {
+      const std::size_t bytes = size * sizeof(T);
+      ByteView& buffer = buffers[name];
+      if (buffer.size() < bytes) {
+        const long long old_bytes = buffer.size();
+        current_bytes -= old_bytes;
+        buffer = ByteView(Kokkos::ViewAllocateWithoutInitializing(name), bytes * growth);
+        addBytes(buffer.size());
+        trackMemory(subsystem(name), (long long)buffer.size() - old_bytes);
+      }
+      return Kokkos::View<T*, Device>(reinterpret_cast<T*>(buffer.data()), size);
+    }
+    typedef std::pair<std::string, std::type_index> MemberKey;
+    struct MemberBuffer {
+      MemberBuffer() : views(NULL), size(0) {}
+      void** views;
+      std::size_t size;
+      std::function<void(void**)> destroy;
+    };
+    std::string subsystem(const std::string& name) const {
+      return label + "_" + name.substr(0, name.find('_'));
+    }
+    void addBytes(std::size_t bytes) {
+      current_bytes += bytes;
+      if (current_bytes > high_water_bytes)
+        high_water_bytes = current_bytes;
+    }
+    double growth;
+    std::string label;
+    std::size_t current_bytes;
+    std::size_t high_water_bytes;
+    std::map<std::string, ByteView> buffers;
+    std::map<MemberKey, MemberBuffer> member_buffers;
+  };
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <Kokkos_Core.hpp>
+#include <Kokkos_Random.hpp>
+#include <cstdio>
+#include <cstdint>
+#include <cmath>
+#include "PS_Types.h"
+
+namespace particle_structs {
+
+  /* Distributions of particles to elements generated on the device
+       DIST_EVEN - np / ne particles per element, the remainder to the first elements
+       DIST_UNIFORM - each particle in a uniformly random element
+       DIST_GAUSSIAN - normal around element ne / 2 with deviation ne / 5
+       DIST_EXPONENTIAL - exponential with rate 4 over [0, 1) scaled to the elements
+       DIST_WEIGHTED - each element chosen proportional to a given weight
+     The first four match the strategies of the test distribute_particles
+  */
+  enum DeviceDistribution {
+    DIST_EVEN = 0,
+    DIST_UNIFORM = 1,
+    DIST_GAUSSIAN = 2,
+    DIST_EXPONENTIAL = 3,
+    DIST_WEIGHTED = 4
+  };
+
+  namespace distribute_impl {
+    //Mixes a seed, rank and block index into a generator state (splitmix64)
+    KOKKOS_INLINE_FUNCTION uint64_t blockSeed(uint64_t seed, int rank, lid_t block) {
+      uint64_t z = seed + 0x9e3779b97f4a7c15ULL * ((uint64_t)rank * 0x100000001ULL + block + 1);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      z ^= z >> 31;
+      return z ? z : 1;
+    }
+    //First index of cdf[0, size) greater than value
+    template <typename View>
+    KOKKOS_INLINE_FUNCTION lid_t upperBound(const View& cdf, lid_t size, double value) {
+      lid_t first = 0;
+      while (size > 0) {
+        const lid_t half = size / 2;
+        if (cdf(first + half) <= value) {
+          first += half + 1;
+          size -= half + 1;
+        }
+        else
+          size = half;
+      }
+      return first;
+    }
+  }
+
+  /* Generates the element of np particles over ne elements on the device
+       strat - DeviceDistribution
+       seed, rank - the particles of a (seed, rank) pair are the same on every run and
+                    execution space, i.e. pass the MPI rank for independent processes
+       ptcls_per_elem - view of ne entries set to the particles of each element
+       particle_elements - view of np entries set to the element of each particle
+       weights - weight of each element (DIST_WEIGHTED only, not normalized)
+     Returns false if the arguments are not valid
+     Usage:
+       kkLidView ptcls_per_elem("ptcls_per_elem", ne);
+       kkLidView particle_elements("particle_elements", np);
+       distributeParticles(ne, np, DIST_GAUSSIAN, seed, comm_rank, ptcls_per_elem,
+                           particle_elements);
+  */
+  template <typename Device>
+  bool distributeParticles(lid_t ne, lid_t np, int strat, uint64_t seed, int rank,
+                           Kokkos::View<lid_t*, Device> ptcls_per_elem,
+                           Kokkos::View<lid_t*, Device> particle_elements,
+                           Kokkos::View<double*, Device> weights =
+                           Kokkos::View<double*, Device>()) {
+    typedef typename Device::execution_space ExecSpace;
+    typedef Kokkos::RangePolicy<ExecSpace> Policy;
+    if (ne <= 0 || np < 0 || (lid_t)ptcls_per_elem.size() < ne ||
+        (lid_t)particle_elements.size() < np) {
+      fprintf(stderr, "[ERROR] distributeParticles needs ne > 0 and views of ne and np "
+              "entries\n");
+      return false;
+    }
+    if (strat < DIST_EVEN || strat > DIST_WEIGHTED) {
+      fprintf(stderr, "[ERROR] Unknown device distribution %d\n", strat);
+      return false;
+    }
+    if (strat == DIST_WEIGHTED && (lid_t)weights.size() < ne) {
+      fprintf(stderr, "[ERROR] The weighted distribution needs a weight per element\n");
+      return false;
+    }
+    //Inclusive sums of the weights, the total is the last entry
+    Kokkos::View<double*, Device> cdf;
+    double total = 0;
+    if (strat == DIST_WEIGHTED) {
+      cdf = Kokkos::View<double*, Device>("distribute_cdf", ne);
+      Kokkos::parallel_scan("distribute_cdf", Policy(0, ne),
+                            KOKKOS_LAMBDA(const lid_t& i, double& cur, const bool& final) {
+        cur += weights(i) > 0 ? weights(i) : 0;
+        if (final)
+          cdf(i) = cur;
+      }, total);
+      if (!(total > 0)) {
+        fprintf(stderr, "[ERROR] The weighted distribution needs a positive weight\n");
+        return false;
+      }
+    }
+
+    /* One generator per block of particles seeded by (seed, rank, block), so the result
+         does not depend on which thread runs a block
+    */
+    typedef Kokkos::Random_XorShift64<Device> Generator;
+    const lid_t block_size = 256;
+    const lid_t num_blocks = (np + block_size - 1) / block_size;
+    const lid_t per_elem = np / ne;
+    const lid_t remainder = np % ne;
+    const double exp_norm = 1 - exp(-4.0);
+    Kokkos::deep_copy(ptcls_per_elem, 0);
+    Kokkos::parallel_for("distribute_particles", Policy(0, num_blocks),
+                         KOKKOS_LAMBDA(const lid_t& b) {
+      Generator gen(distribute_impl::blockSeed(seed, rank, b), b);
+      const lid_t first = b * block_size;
+      const lid_t last = first + block_size < np ? first + block_size : np;
+      for (lid_t i = first; i < last; ++i) {
+        lid_t elem;
+        if (strat == DIST_EVEN) {
+          const lid_t big = remainder * (per_elem + 1);
+          elem = i < big ? i / (per_elem + 1) : remainder + (i - big) / per_elem;
+        }
+        else if (strat == DIST_UNIFORM)
+          elem = gen.urand(ne);
+        else if (strat == DIST_GAUSSIAN) {
+          do {
+            elem = round(gen.normal(ne / 2.0, ne / 5.0));
+          } while (elem < 0 || elem >= ne);
+        }
+        else if (strat == DIST_EXPONENTIAL) {
+          //Inverse of the exponential truncated to [0, 1)
+          const double x = -log(1 - gen.drand() * exp_norm) / 4;
+          elem = ne * x;
+          elem = elem < ne ? elem : ne - 1;
+        }
+        else {
+          elem = distribute_impl::upperBound(cdf, ne, gen.drand() * total);
+          elem = elem < ne ? elem : ne - 1;
+        }
+        particle_elements(i) = elem;
+        Kokkos::atomic_fetch_add(&(ptcls_per_elem(elem)), 1);
+      }
+    });
+    return true;
+  }
+}
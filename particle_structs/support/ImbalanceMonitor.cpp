@@ -0,0 +1,157 @@
+#include "ImbalanceMonitor.h"
+#include <vector>
+
+namespace particle_structs {
+  namespace {
+    //Samples of one phase on this rank since the previous reduction
+    struct Samples {
+      Samples() : count(0), wait(0), busy(0), particles(0) {}
+      long long count;
+      double wait, busy, particles;
+    };
+    std::map<std::string, Samples> samples;
+    std::map<std::string, ImbalanceStats> imbalance;
+    //Time this rank last left a prebarrier, negative before the first sample
+    double last_exit = -1;
+    int imbalance_period = 1;
+    int steps_since_reduce = 0;
+    double smoothing = 0.5;
+
+    double ratio(double max, double mean) {
+      return mean > 0 ? max / mean : 1;
+    }
+
+    void update(ImbalanceStats& stats, double time_imbalance, double particle_imbalance) {
+      stats.time_imbalance = time_imbalance;
+      stats.particle_imbalance = particle_imbalance;
+      if (stats.reductions == 0) {
+        stats.running_time_imbalance = time_imbalance;
+        stats.running_particle_imbalance = particle_imbalance;
+      }
+      else {
+        stats.running_time_imbalance = smoothing * time_imbalance +
+          (1 - smoothing) * stats.running_time_imbalance;
+        stats.running_particle_imbalance = smoothing * particle_imbalance +
+          (1 - smoothing) * stats.running_particle_imbalance;
+      }
+      ++stats.reductions;
+    }
+  }
+
+  void recordImbalance(const std::string& phase, double wait, long long particles) {
+    const double now = MPI_Wtime();
+    Samples& s = samples[phase];
+    ++s.count;
+    s.wait += wait;
+    s.particles += particles;
+    if (last_exit >= 0 && now - last_exit > wait)
+      s.busy += now - last_exit - wait;
+    last_exit = now;
+  }
+
+  void reduceImbalance(MPI_Comm comm) {
+    int comm_rank, comm_size;
+    MPI_Comm_rank(comm, &comm_rank);
+    MPI_Comm_size(comm, &comm_size);
+    const int n = samples.size();
+    int counts[2] = {n, -n};
+    MPI_Allreduce(MPI_IN_PLACE, counts, 2, MPI_INT, MPI_MAX, comm);
+    if (counts[0] != -counts[1]) {
+      if (!comm_rank)
+        fprintf(stderr, "[WARNING] Ranks recorded between %d and %d imbalance phases, the "
+                "samples are not reduced\n", -counts[1], counts[0]);
+      return;
+    }
+    if (n == 0)
+      return;
+
+    //Count, wait, busy and particles summed and the per sample wait, busy time and
+    //  per sample particles maximized over the ranks for each phase and the total
+    std::vector<double> sums(4 * (n + 1), 0), maxs(3 * (n + 1), 0);
+    std::vector<std::string> names;
+    for (auto itr = samples.begin(); itr != samples.end(); ++itr) {
+      const int i = names.size();
+      const Samples& s = itr->second;
+      names.push_back(itr->first);
+      sums[4 * i] = s.count;
+      sums[4 * i + 1] = s.wait;
+      sums[4 * i + 2] = s.busy;
+      sums[4 * i + 3] = s.particles;
+      sums[4 * n] += s.count;
+      sums[4 * n + 1] += s.wait;
+      sums[4 * n + 2] += s.busy;
+      sums[4 * n + 3] += s.particles;
+    }
+    names.push_back("total");
+    for (int i = 0; i <= n; ++i) {
+      const double count = sums[4 * i];
+      maxs[3 * i] = count > 0 ? sums[4 * i + 1] / count : 0;
+      maxs[3 * i + 1] = sums[4 * i + 2];
+      maxs[3 * i + 2] = count > 0 ? sums[4 * i + 3] / count : 0;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, sums.data(), sums.size(), MPI_DOUBLE, MPI_SUM, comm);
+    MPI_Allreduce(MPI_IN_PLACE, maxs.data(), maxs.size(), MPI_DOUBLE, MPI_MAX, comm);
+
+    for (int i = 0; i <= n; ++i) {
+      ImbalanceStats& stats = imbalance[names[i]];
+      const double count = sums[4 * i];
+      stats.samples = count / comm_size;
+      stats.mean_wait = count > 0 ? sums[4 * i + 1] / count : 0;
+      stats.max_wait = maxs[3 * i];
+      stats.mean_particles = count > 0 ? sums[4 * i + 3] / count : 0;
+      stats.max_particles = maxs[3 * i + 2];
+      update(stats, ratio(maxs[3 * i + 1], sums[4 * i + 2] / comm_size),
+             ratio(stats.max_particles, stats.mean_particles));
+    }
+    samples.clear();
+  }
+
+  bool imbalanceStep(MPI_Comm comm) {
+    if (++steps_since_reduce < imbalance_period)
+      return false;
+    steps_since_reduce = 0;
+    reduceImbalance(comm);
+    return true;
+  }
+
+  void setImbalancePeriod(int period) {
+    if (period < 1) {
+      fprintf(stderr, "[WARNING] Imbalance period %d is less than 1, using 1\n", period);
+      period = 1;
+    }
+    imbalance_period = period;
+  }
+
+  void setImbalanceSmoothing(double weight) {
+    if (weight <= 0 || weight > 1) {
+      fprintf(stderr, "[WARNING] Imbalance smoothing %f is not in (0, 1], using 1\n", weight);
+      weight = 1;
+    }
+    smoothing = weight;
+  }
+
+  const std::map<std::string, ImbalanceStats>& getImbalance() {return imbalance;}
+
+  double imbalanceMetric() {
+    auto itr = imbalance.find("total");
+    return itr == imbalance.end() ? 1 : itr->second.running_time_imbalance;
+  }
+
+  void resetImbalance() {
+    samples.clear();
+    imbalance.clear();
+    last_exit = -1;
+    steps_since_reduce = 0;
+  }
+
+  void printImbalance(FILE* out) {
+    fprintf(out, "%-32s %8s %12s %12s %8s %8s %10s %10s\n", "Imbalance", "Samples",
+            "MeanWait(s)", "MaxWait(s)", "Time", "Ptcls", "RunTime", "RunPtcls");
+    for (auto itr = imbalance.begin(); itr != imbalance.end(); ++itr) {
+      const ImbalanceStats& s = itr->second;
+      fprintf(out, "%-32s %8lld %12.6f %12.6f %8.3f %8.3f %10.3f %10.3f\n",
+              itr->first.c_str(), s.samples, s.mean_wait, s.max_wait, s.time_imbalance,
+              s.particle_imbalance, s.running_time_imbalance, s.running_particle_imbalance);
+    }
+  }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <mpi.h>
+#include <cstdio>
+#include <map>
+#include <string>
+
+namespace particle_structs {
+
+  /* Load imbalance of the phases entered through a prebarrier
+
+     Every rank exits a barrier at the same time, so the time between two prebarriers minus
+     the wait in the second is the busy time of the rank before the phase. The rebuild,
+     migrate and searches record their prebarrier wait (0 when prebarriers are disabled) and
+     particles here every call without communication. The first sample of a run only starts
+     the clock of the busy time.
+
+     reduceImbalance combines the samples since the previous reduction across ranks with
+     three small allreduces, so it is cheap to call every few steps, imbalanceStep does it
+     every period calls. The result is the same on every rank and is kept per phase and in
+     "total" (the busy time and particles of the step); the running metrics smooth the
+     imbalances of the reductions.
+
+     Usage:
+       setImbalancePeriod(10);
+       for (int step = 0; step < nsteps; ++step) {
+         ... //push, search, rebuild and migrate
+         if (imbalanceStep() && imbalanceMetric() > 1.2)
+           ... //i.e. rebalance with pumipic::Mesh::balancedPartition
+       }
+     Note: reduceImbalance and imbalanceStep are collective, every rank must record the same
+           phases (the instrumented operations are collective)
+  */
+  struct ImbalanceStats {
+    ImbalanceStats() : samples(0), reductions(0), mean_wait(0), max_wait(0),
+                       time_imbalance(1), mean_particles(0), max_particles(0),
+                       particle_imbalance(1), running_time_imbalance(1),
+                       running_particle_imbalance(1) {}
+    //Samples per rank in the last reduction and reductions so far
+    long long samples;
+    long long reductions;
+    //Prebarrier wait per sample in seconds
+    double mean_wait, max_wait;
+    //Max over mean busy time of the ranks
+    double time_imbalance;
+    //Particles per sample
+    double mean_particles, max_particles;
+    double particle_imbalance;
+    //Exponential moving averages of the imbalances over the reductions
+    double running_time_imbalance;
+    double running_particle_imbalance;
+  };
+
+  //Adds a sample of this rank to a phase, wait is the prebarrier time in seconds
+  void recordImbalance(const std::string& phase, double wait, long long particles);
+
+  //Collective over comm, reduces the samples since the previous reduction
+  void reduceImbalance(MPI_Comm comm = MPI_COMM_WORLD);
+  /* Calls reduceImbalance every period calls (default 1)
+       returns true when the statistics were reduced
+  */
+  bool imbalanceStep(MPI_Comm comm = MPI_COMM_WORLD);
+  void setImbalancePeriod(int period);
+  //Weight of the last reduction in the running metrics in (0, 1] (default 0.5)
+  void setImbalanceSmoothing(double weight);
+
+  //Statistics of the last reduction of each phase and of "total"
+  const std::map<std::string, ImbalanceStats>& getImbalance();
+  //Running time imbalance of the step (1 before the first reduction)
+  double imbalanceMetric();
+  void resetImbalance();
+
+  //Table of the last reduction, call from one rank
+  void printImbalance(FILE* out = stdout);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <Kokkos_Core.hpp>
+#include <cstdio>
+#include <cstddef>
+
+namespace particle_structs {
+
+  /* Records a sequence of kernels into a CUDA graph and replays it
+
+     run(space, key, fn) calls fn the first time a key is seen while space's stream is being
+     captured, then launches the recorded graph. Later calls with the same key only launch the
+     graph, so the kernels of fn cost one launch. A new key records fn again.
+
+     Requirements of fn:
+       Every kernel and copy must be on space, which must not be the default (legacy) stream
+       No host synchronization (fences, copies to the host, MPI, parallel_reduce to a host
+         scalar), so counts and sizes are fixed by the caller
+       The key must change whenever the kernels would change, i.e. the sizes of fn or the
+         ParticleStructure::layoutVersion of the structures it runs on
+     A capture that fails (i.e. fn synchronized) is reported once, fn is called again to run
+     its kernels and is called directly from then on. Without CUDA, and on the default
+     stream, fn is always called directly.
+
+     Stages that size their own work on the host can not be recorded, so a timestep records
+     the kernels between them (i.e. the push and the deposit) and runs these stages directly:
+       The reshuffle reads the moving particles and new slots (getLastValue) to decide if
+         the layout fits and to size its overflow slices
+       The rebuild reads the new capacity and allocates the layout and the swap views
+       The searches loop until every particle ended (get_min of the done flags) and the
+         migrations that follow them exchange counts and particles with MPI
+
+     Usage:
+       KernelGraph<Kokkos::Cuda> push_graph;
+       push_graph.run(ptcls->executionSpace(), ptcls->layoutVersion(), [&]() {
+         ptcls->parallel_for(push, "push");
+       });
+  */
+  template <typename ExecSpace>
+  class KernelGraph {
+  public:
+    KernelGraph() : has_graph(false), disabled(false), key(0), num_replays(0) {}
+    KernelGraph(const KernelGraph&) = delete;
+    KernelGraph& operator=(const KernelGraph&) = delete;
+    ~KernelGraph() {reset();}
+
+    template <typename Fn>
+    void run(const ExecSpace& space, std::size_t run_key, Fn fn) {
+      if (disabled || !capture(space, run_key, fn))
+        fn();
+    }
+    //True once a graph of the current key is recorded
+    bool recorded() const {return has_graph;}
+    //Launches of the recorded graphs after their first
+    std::size_t replays() const {return num_replays;}
+    //Drops the recorded graph, the next run records again
+    void reset() {
+#ifdef PS_USE_CUDA
+      if (has_graph)
+        cudaGraphExecDestroy(graph_exec);
+#endif
+      has_graph = false;
+    }
+
+  private:
+#ifdef PS_USE_CUDA
+    template <typename Fn>
+    bool capture(const ExecSpace& space, std::size_t run_key, Fn& fn) {
+      cudaStream_t stream = space.cuda_stream();
+      if (stream == 0)
+        return false;
+      if (has_graph && run_key == key) {
+        ++num_replays;
+        return cudaGraphLaunch(graph_exec, stream) == cudaSuccess;
+      }
+      reset();
+      //Relaxed so the structures can allocate the buffers their captured kernels keep
+      if (cudaStreamBeginCapture(stream, cudaStreamCaptureModeRelaxed) != cudaSuccess)
+        return disable("begin");
+      fn();
+      cudaGraph_t graph;
+      if (cudaStreamEndCapture(stream, &graph) != cudaSuccess)
+        return disable("end");
+      const cudaError_t instantiated = cudaGraphInstantiate(&graph_exec, graph, NULL, NULL, 0);
+      cudaGraphDestroy(graph);
+      if (instantiated != cudaSuccess)
+        return disable("instantiate");
+      has_graph = true;
+      key = run_key;
+      cudaGraphLaunch(graph_exec, stream);
+      return true;
+    }
+    bool disable(const char* stage) {
+      //Clear the error of the capture so later calls are not reported as failing
+      cudaGetLastError();
+      fprintf(stderr, "[WARNING] Kernel graph capture failed at %s, kernels are launched "
+              "directly\n", stage);
+      disabled = true;
+      return false;
+    }
+    cudaGraphExec_t graph_exec;
+#else
+    template <typename Fn>
+    bool capture(const ExecSpace&, std::size_t, Fn&) {return false;}
+#endif
+    bool has_graph;
+    bool disabled;
+    std::size_t key;
+    std::size_t num_replays;
+  };
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "Segment.h"
+#include <type_traits>
+
+namespace particle_structs {
+
+  /* Array-of-structs-of-arrays copy of MemberTypes
+
+     This is a conversion target, not a storage option of the particle structures: they
+     keep one view per member, which is what get<N>(), parallel_for, rebuild and the
+     migration helpers work on. Code that needs the particles in tiles (i.e. to hand them to
+     a library expecting that layout) copies them in with ParticleStructure::copyToAoSoA,
+     works on the copy and copies changed members back. No kernel of the structures is
+     measured to run faster on the copy, the two copies are extra traffic.
+
+     Particles are grouped into tiles of W particles. Each tile stores every member type
+     for its W particles back to back with the components of array members laid out
+     as structs of arrays:
+
+       tile t: [T0 of W particles][T1 comp 0 of W particles][T1 comp 1 ...]...[Tn ...]
+
+     All members of a particle therefore live within one tile, and each component of W
+     consecutive particles is contiguous. W a multiple of the chunk height C of the SCS
+     maps a chunk column onto whole tiles. Compact members are tiled
+     and accessed in their storage type.
+
+     Usage:
+       MemberTypeAoSoA<DataTypes, W, Device> aosoa(num_particles);
+       auto seg = aosoa.get<N>(); //Indexed the same as the Segment from get<N>()
+       copyViewsToAoSoA(aosoa, views, num_particles);
+       copyAoSoAToViews(views, aosoa, num_particles);
+   */
+  template <typename DataTypes, int W, typename Device> class MemberTypeAoSoA;
+
+  //Offset in bytes of member N within one tile of W particles
+  template <std::size_t N, int W, typename... Types> struct AoSoAOffset;
+  template <int W, typename... Types> struct AoSoAOffset<0, W, Types...> {
+    static constexpr std::size_t value = 0;
+  };
+  template <std::size_t N, int W, typename T, typename... Types>
+  struct AoSoAOffset<N, W, T, Types...> {
+    static constexpr std::size_t value = sizeof(StorageType<T>) * W + AoSoAOffset<N-1, W, Types...>::value;
+  };
+
+  //Accessor for one member type stored in an AoSoA, provides the same indexing as Segment
+  template <typename Type, int W, typename Device>
+  class SegmentAoSoA {
+  public:
+    using Base=typename BaseType<Type>::type;
+    using ViewType=Kokkos::View<char*, Device>;
+
+    SegmentAoSoA() : offset(0), tile_bytes(0) {}
+    SegmentAoSoA(ViewType v, std::size_t off, std::size_t tile) :
+      view(v), offset(off), tile_bytes(tile) {}
+
+    template <typename U = Type>
+    KOKKOS_INLINE_FUNCTION typename std::enable_if<std::rank<Type>::value == 0 && std::is_same<U, Type>::value, Base>::type&
+      operator()(const int& particle_index) const {
+      return at(particle_index, 0);
+    }
+    template <typename U = Type>
+    KOKKOS_INLINE_FUNCTION typename std::enable_if<std::rank<Type>::value == 1 && std::is_same<U, Type>::value, Base>::type&
+      operator()(const int& particle_index, const int& i) const {
+      return at(particle_index, i);
+    }
+    template <typename U = Type>
+    KOKKOS_INLINE_FUNCTION typename std::enable_if<std::rank<Type>::value == 2 && std::is_same<U, Type>::value, Base>::type&
+      operator()(const int& particle_index, const int& i, const int& j) const {
+      return at(particle_index, i * std::extent<Type, 1>::value + j);
+    }
+    template <typename U = Type>
+    KOKKOS_INLINE_FUNCTION typename std::enable_if<std::rank<Type>::value == 3 && std::is_same<U, Type>::value, Base>::type&
+      operator()(const int& particle_index, const int& i, const int& j, const int& k) const {
+      return at(particle_index, (i * std::extent<Type, 1>::value + j) *
+                std::extent<Type, 2>::value + k);
+    }
+
+  private:
+    KOKKOS_INLINE_FUNCTION Base& at(const int& particle_index, const int& component) const {
+      const std::size_t tile = particle_index / W;
+      const int lane = particle_index % W;
+      Base* member = reinterpret_cast<Base*>(view.data() + tile * tile_bytes + offset);
+      return member[component * W + lane];
+    }
+    ViewType view;
+    std::size_t offset;
+    std::size_t tile_bytes;
+  };
+
+  template <int W, typename Device, typename... Types>
+  class MemberTypeAoSoA<MemberTypes<Types...>, W, Device> {
+  public:
+    static_assert(W > 0 && W % 8 == 0, "AoSoA tile width must be a multiple of 8");
+    typedef MemberTypes<Types...> DataTypes;
+    typedef Kokkos::View<char*, Device> ViewType;
+    template <std::size_t N> using DataType = typename MemberTypeAtIndex<N, DataTypes>::type;
+    template <std::size_t N> using Slice = SegmentAoSoA<StorageType<DataType<N> >, W, Device>;
+    static constexpr int tile_width = W;
+    static constexpr std::size_t tile_bytes = DataTypes::memsize * W;
+
+    MemberTypeAoSoA() : size_(0), num_tiles(0) {}
+    MemberTypeAoSoA(int size) : size_(size), num_tiles((size + W - 1) / W),
+                                data("aosoa_data", num_tiles * tile_bytes) {}
+
+    int size() const {return size_;}
+    int numTiles() const {return num_tiles;}
+    ViewType raw() const {return data;}
+
+    template <std::size_t N>
+    Slice<N> get() const {
+      return Slice<N>(data, AoSoAOffset<N, W, Types...>::value, tile_bytes);
+    }
+
+    //Copies ntiles whole tiles of src starting at src_tile into this starting at dst_tile
+    void copyTiles(int dst_tile, const MemberTypeAoSoA& src, int src_tile, int ntiles) {
+      typedef Kokkos::pair<std::size_t, std::size_t> Range;
+      auto dst_range = Range(dst_tile * tile_bytes, (dst_tile + ntiles) * tile_bytes);
+      auto src_range = Range(src_tile * tile_bytes, (src_tile + ntiles) * tile_bytes);
+      Kokkos::deep_copy(Kokkos::subview(data, dst_range), Kokkos::subview(src.data, src_range));
+    }
+
+  private:
+    int size_;
+    int num_tiles;
+    ViewType data;
+  };
+
+  //Copies one entry of a member between two accessors with the same indexing (Segment/AoSoA)
+  template <class T, int Rank = std::rank<T>::value> struct CopySegmentEntry;
+  template <class T> struct CopySegmentEntry<T, 0> {
+    template <class Dst, class Src>
+    KOKKOS_INLINE_FUNCTION static void copy(const Dst& dst, int dst_index,
+                                            const Src& src, int src_index) {
+      dst(dst_index) = src(src_index);
+    }
+  };
+  template <class T> struct CopySegmentEntry<T, 1> {
+    template <class Dst, class Src>
+    KOKKOS_INLINE_FUNCTION static void copy(const Dst& dst, int dst_index,
+                                            const Src& src, int src_index) {
+      for (int i = 0; i < (int)std::extent<T, 0>::value; ++i)
+        dst(dst_index, i) = src(src_index, i);
+    }
+  };
+  template <class T> struct CopySegmentEntry<T, 2> {
+    template <class Dst, class Src>
+    KOKKOS_INLINE_FUNCTION static void copy(const Dst& dst, int dst_index,
+                                            const Src& src, int src_index) {
+      for (int i = 0; i < (int)std::extent<T, 0>::value; ++i)
+        for (int j = 0; j < (int)std::extent<T, 1>::value; ++j)
+          dst(dst_index, i, j) = src(src_index, i, j);
+    }
+  };
+  template <class T> struct CopySegmentEntry<T, 3> {
+    template <class Dst, class Src>
+    KOKKOS_INLINE_FUNCTION static void copy(const Dst& dst, int dst_index,
+                                            const Src& src, int src_index) {
+      for (int i = 0; i < (int)std::extent<T, 0>::value; ++i)
+        for (int j = 0; j < (int)std::extent<T, 1>::value; ++j)
+          for (int k = 0; k < (int)std::extent<T, 2>::value; ++k)
+            dst(dst_index, i, j, k) = src(src_index, i, j, k);
+    }
+  };
+
+  //Copy per member views to/from an AoSoA member by member
+  template <typename DataTypes, int W, typename Device, std::size_t N,
+            std::size_t Size = DataTypes::size> struct CopyViewsAoSoAImpl {
+    typedef typename MemberTypeAtIndex<N, DataTypes>::type Member;
+    typedef StorageType<Member> T;
+    //Accessor of the member view in the storage form and layout of the member
+    typedef Segment<T, Device, typename MemberLayout<Member>::type> ViewSegment;
+    static void toAoSoA(const MemberTypeAoSoA<DataTypes, W, Device>& aosoa,
+                        MemberTypeViews<DataTypes, Device> views, int size) {
+      ViewSegment seg(*static_cast<MemberTypeView<Member, Device>*>(views[N]));
+      auto tile_seg = aosoa.template get<N>();
+      Kokkos::parallel_for("copy_views_to_aosoa", size, KOKKOS_LAMBDA(const int& i) {
+        CopySegmentEntry<T>::copy(tile_seg, i, seg, i);
+      });
+      CopyViewsAoSoAImpl<DataTypes, W, Device, N+1>::toAoSoA(aosoa, views, size);
+    }
+    static void fromAoSoA(MemberTypeViews<DataTypes, Device> views,
+                          const MemberTypeAoSoA<DataTypes, W, Device>& aosoa, int size) {
+      ViewSegment seg(*static_cast<MemberTypeView<Member, Device>*>(views[N]));
+      auto tile_seg = aosoa.template get<N>();
+      Kokkos::parallel_for("copy_aosoa_to_views", size, KOKKOS_LAMBDA(const int& i) {
+        CopySegmentEntry<T>::copy(seg, i, tile_seg, i);
+      });
+      CopyViewsAoSoAImpl<DataTypes, W, Device, N+1>::fromAoSoA(views, aosoa, size);
+    }
+  };
+  template <typename DataTypes, int W, typename Device, std::size_t Size>
+  struct CopyViewsAoSoAImpl<DataTypes, W, Device, Size, Size> {
+    static void toAoSoA(const MemberTypeAoSoA<DataTypes, W, Device>&,
+                        MemberTypeViews<DataTypes, Device>, int) {}
+    static void fromAoSoA(MemberTypeViews<DataTypes, Device>,
+                          const MemberTypeAoSoA<DataTypes, W, Device>&, int) {}
+  };
+
+  template <typename DataTypes, int W, typename Device>
+  void copyViewsToAoSoA(const MemberTypeAoSoA<DataTypes, W, Device>& aosoa,
+                        MemberTypeViews<DataTypes, Device> views, int size) {
+    CopyViewsAoSoAImpl<DataTypes, W, Device, 0>::toAoSoA(aosoa, views, size);
+  }
+  template <typename DataTypes, int W, typename Device>
+  void copyAoSoAToViews(MemberTypeViews<DataTypes, Device> views,
+                        const MemberTypeAoSoA<DataTypes, W, Device>& aosoa, int size) {
+    CopyViewsAoSoAImpl<DataTypes, W, Device, 0>::fromAoSoA(views, aosoa, size);
+  }
+}
@@ -5,16 +5,27 @@
 #include "MemberTypeArray.h"
 #include "PS_Macros.h"
 #include "PS_Types.h"
+#include "MemoryTracker.h"
 #include <Kokkos_Core.hpp>
 #include <mpi.h>
 #include <cstdlib>
+#include <type_traits>
 
 namespace particle_structs {
 
   //This type represents an array of views for each type of the given DataTypes
   template <typename DataTypes, typename Device> using MemberTypeViews = void**;
   template <typename DataTypes, typename Device> using MemberTypeViewsConst = void* const*;
-  template <typename T, typename Device> using MemberTypeView = Kokkos::View<T*, Device>;
+  //View of entries of type S in Layout, void is the default layout of the device
+  template <typename S, typename Layout, typename Device> struct LayoutView {
+    using type = Kokkos::View<S*, Layout, Device>;
+  };
+  template <typename S, typename Device> struct LayoutView<S, void, Device> {
+    using type = Kokkos::View<S*, Device>;
+  };
+  //Compact member types are held in their storage form and WithLayout types in their layout
+  template <typename T, typename Device> using MemberTypeView =
+    typename LayoutView<StorageType<T>, typename MemberLayout<T>::type, Device>::type;
 
   /* Template Fuctions for external usage
        Note: MemorySpace defaults to the default memory space if none is provided
@@ -40,7 +51,8 @@ namespace particle_structs {
 
   /******* Template Structs ******/
   /* CreateViews<DataTypes, Device> - creates and allocates member views
-       Usage: CreateViews<Device, DataTypes>(MemberTypeViews, size)
+       Usage: CreateViews<Device, DataTypes>(MemberTypeViews, size[, subsystem])
+       Note: The views are labeled and their memory tracked by subsystem (see MemoryTracker.h)
    */
   template <typename Device, typename... Types> struct CreateViews;
   /* DestroyViews<DataTypes> - deallocates member views
@@ -53,7 +65,9 @@ namespace particle_structs {
                                                                 DestinationMemberTypeViews,
                                                                 SourceMemberTypeViews,
                                                                 NewProcessPerParticle,
-                                                                MapFromPSToSendArray);
+                                                                MapFromPSToSendArray,
+                                                                Communicator);
+       Note: Communicator defaults to MPI_COMM_WORLD
    */
   template <typename PS, typename... Types> struct CopyParticlesToSend;
   /* CopyPSToPS<ParticleStructure, DataTypes> - copies particle info from ps to ps
@@ -64,11 +78,28 @@ namespace particle_structs {
                                                          DestinationIndexForParticle);
    */
   template <typename PS, typename... Types> struct CopyPSToPS;
+  /* ReplacePSViews<ParticleStructure, DataTypes> - moves particle info of a ps into new views
+                                                    one type at a time, freeing each old view
+                                                    before the next type is copied
+       Usage: ReplacePSViews<ParticleStructure, MemberTypes>(ParticleStructure,
+                                                             PSMemberTypeViews,
+                                                             NewMemberTypeViews,
+                                                             NewRowIndexForParticle,
+                                                             DestinationIndexForParticle,
+                                                             DestinationIndexForNew,
+                                                             NewSize);
+       Note: Only one type is allocated twice at once, the views of PSMemberTypeViews are
+             replaced in place
+   */
+  template <typename PS, typename... Types> struct ReplacePSViews;
   /* CopyViewsToViews<ViewType, DataTypes> - copies particle info from one view to specific
                                              indices in another view
        Usage: CopyViewsToViews<ViewType, MemberTypes>(DestiationMemberTypeViews,
                                                       SourceMemberTypeViews,
-                                                      DestionationIndexPerSource);
+                                                      DestionationIndexPerSource,
+                                                      [SourceIndexPerEntry]);
+       Note: with SourceIndexPerEntry entry i copies source SourceIndexPerEntry(i), an empty
+             DestionationIndexPerSource then copies entry i to destination i
   */
   template <typename PS, typename... Types> struct CopyViewsToViews;
   /* ShuffleParticles<ParticleStructure, DataTypes> - shuffles particle info within a ps
@@ -83,15 +114,99 @@ namespace particle_structs {
   /* SendViews<Device, DataTypes> - sends views with MPI communications
        Usage: SendViews<Device, MemberTypes>(MemberTypesViews, offsetFromStart,
                                              numberOfEntries, destinationRank, initialTag,
-                                             ArrayOfRequests);
+                                             ArrayOfRequests, Communicator);
+       Note: Communicator defaults to MPI_COMM_WORLD
    */
   template <typename Device, typename... Types> struct SendViews;
   /* RecvViews<Device, DataTypes> - recvs views from MPI communications
        Usage: RecvViews<Device, MemberTypes>(MemberTypeViews, offsetFromStart,
                                              numberOfEntries, sendingRank, initialTag,
-                                             ArrayOfRequests);
+                                             ArrayOfRequests, Communicator);
+       Note: Communicator defaults to MPI_COMM_WORLD
    */
   template <typename Device, typename... Types> struct RecvViews;
+  /* Encoding of a member in packed buffers
+       PACK_EXACT - the member as stored
+       PACK_FLOAT - members of doubles in single precision (relative error below 2^-24),
+                    other members are packed exactly
+  */
+  enum PackCodec {
+    PACK_EXACT = 0,
+    PACK_FLOAT = 1
+  };
+  /* PackedBytes<DataTypes> - bytes needed to pack size entries of each type
+                              Each type is padded to a multiple of 8 bytes
+       Usage: PackedBytes<MemberTypes>::bytes(numberOfEntries, [CodecPerType]);
+   */
+  template <typename... Types> struct PackedBytes;
+  /* PackParticles<ParticleStructure, DataTypes> - packs particles into one byte buffer
+                                                   with one contiguous message per segment
+                                                   Each message is laid out type by type:
+                                                   [T0 of n particles][T1 of n particles]...
+       Usage: PackParticles<ParticleStructure, MemberTypes>(ParticleStructure,
+                                                           SourceMemberTypeViews,
+                                                           SegmentPerParticle (-1 if not packed),
+                                                           IndexPerParticle,
+                                                           OffsetOfSegment,
+                                                           CountPerSegment,
+                                                           ByteOffsetOfTypePerSegment,
+                                                           Buffer, [CodecPerType]);
+       Note: ByteOffsetOfTypePerSegment starts at the first type of each message and is
+             advanced past every type as it is packed
+       Note: CodecPerType (PackCodec of each type, default PACK_EXACT) must match on unpack
+   */
+  template <typename PS, typename... Types> struct PackParticles;
+  /* UnpackViews<Device, DataTypes> - unpacks a buffer created by PackParticles into views
+       Usage: UnpackViews<Device, MemberTypes>(DestinationMemberTypeViews, numberOfEntries,
+                                               OffsetOfSegment, numberOfSegments,
+                                               ByteOffsetOfTypePerSegment, Buffer,
+                                               [DestinationIndices], [CodecPerType]);
+       Entry i is unpacked to DestinationIndices(i) if given, otherwise to i
+   */
+  template <typename Device, typename... Types> struct UnpackViews;
+  /* PackViews<Device, DataTypes> - packs views into the layout read by UnpackViews
+       Usage: PackViews<Device, MemberTypes>(SourceMemberTypeViews, numberOfEntries,
+                                             OffsetOfSegment, numberOfSegments,
+                                             ByteOffsetOfTypePerSegment, Buffer,
+                                             [SourceIndices]);
+       Entry i is packed from SourceIndices(i) if given, otherwise from i
+   */
+  template <typename Device, typename... Types> struct PackViews;
+
+  //Index of the segment containing index i given ex-sum offsets of nsegs segments
+  template <typename View>
+  KOKKOS_INLINE_FUNCTION int segmentOf(const View& offsets, int nsegs, int i) {
+    int low = 0, high = nsegs;
+    while (high - low > 1) {
+      const int mid = (low + high) / 2;
+      if (offsets(mid) <= i)
+        low = mid;
+      else
+        high = mid;
+    }
+    return low;
+  }
+  //Bytes of size entries of type T padded to a multiple of 8 bytes
+  template <typename T>
+  KOKKOS_INLINE_FUNCTION std::size_t packedBytes(std::size_t size) {
+    return (size * sizeof(StorageType<T>) + 7) / 8 * 8;
+  }
+  //Bytes of size element gids, packed as 32-bit integers if compact
+  KOKKOS_INLINE_FUNCTION std::size_t packedGidBytes(std::size_t size, bool compact) {
+    return compact ? packedBytes<int>(size) : packedBytes<gid_t>(size);
+  }
+  //True if codec changes how members of type T are packed
+  template <typename T>
+  KOKKOS_INLINE_FUNCTION bool packNarrowed(int codec) {
+    return codec == PACK_FLOAT && std::is_same<BT<T>, double>::value;
+  }
+  //Bytes of size entries of type T packed with codec
+  template <typename T>
+  KOKKOS_INLINE_FUNCTION std::size_t packedBytes(std::size_t size, int codec) {
+    if (packNarrowed<T>(codec))
+      return (size * BaseType<T>::size * sizeof(float) + 7) / 8 * 8;
+    return packedBytes<T>(size);
+  }
 
   //Functions
   template <typename DataTypes,typename MemSpace>
@@ -114,21 +229,24 @@ namespace particle_structs {
   //Create Views Templated Struct
   template <typename Device, typename... Types> struct CreateViewsImpl;
   template <typename Device> struct CreateViewsImpl<Device> {
-    CreateViewsImpl(MemberTypeViews<MemberTypes<void>, Device>, int) {}
+    CreateViewsImpl(MemberTypeViews<MemberTypes<void>, Device>, int, const char*) {}
   };
   template <typename Device, typename T, typename... Types> struct CreateViewsImpl<Device, T, Types...> {
-    CreateViewsImpl(MemberTypeViews<MemberTypes<T, Types...>, Device > views, int size) {
+    CreateViewsImpl(MemberTypeViews<MemberTypes<T, Types...>, Device > views, int size,
+                    const char* subsystem) {
 
-      views[0] = new MemberTypeView<T, Device>("datatype_view", size);
+      views[0] = new MemberTypeView<T, Device>(subsystem, size);
       MemberTypeView<T, Device> view = *static_cast<MemberTypeView<T, Device>*>(views[0]);
-      CreateViewsImpl<Device, Types...>(views+1, size);
+      trackAllocation(view.data(), subsystem, viewBytes(view));
+      CreateViewsImpl<Device, Types...>(views+1, size, subsystem);
     }
   };
 
   template <typename Device, typename... Types> struct CreateViews<Device, MemberTypes<Types...> > {
-    CreateViews(MemberTypeViews<MemberTypes<Types...>, Device>& views, int size) {
+    CreateViews(MemberTypeViews<MemberTypes<Types...>, Device>& views, int size,
+                const char* subsystem = "ps_member_views") {
       views = new void*[MemberTypes<Types...>::size];
-      CreateViewsImpl<Device, Types...>(views, size);
+      CreateViewsImpl<Device, Types...>(views, size, subsystem);
     }
   };
 
@@ -139,22 +257,20 @@ namespace particle_structs {
     typedef typename PS::device_type Device;
     CopyParticlesToSendImpl(PS* ps, MemberTypeViewsConst<MemberTypes<void>, Device >,
                             MemberTypeViewsConst<MemberTypes<void>, Device >,
-                       typename PS::kkLidView, typename PS::kkLidView) {}
+                       typename PS::kkLidView, typename PS::kkLidView, int) {}
   };
   template <typename PS, typename T, typename... Types> struct CopyParticlesToSendImpl<PS, T,Types...> {
     typedef typename PS::device_type Device;
     CopyParticlesToSendImpl(PS* ps, MemberTypeViewsConst<MemberTypes<T, Types...>, Device> dsts,
                             MemberTypeViewsConst<MemberTypes<T, Types...>, Device> srcs,
                        typename PS::kkLidView ps_to_array,
-                       typename PS::kkLidView array_indices) {
-      enclose(ps, dsts, srcs,ps_to_array, array_indices);
+                       typename PS::kkLidView array_indices, int comm_rank) {
+      enclose(ps, dsts, srcs,ps_to_array, array_indices, comm_rank);
     }
     void enclose(PS* ps, MemberTypeViewsConst<MemberTypes<T, Types...>, Device> dsts,
                  MemberTypeViewsConst<MemberTypes<T, Types...>, Device> srcs,
                  typename PS::kkLidView ps_to_array,
-                 typename PS::kkLidView array_indices) {
-      int comm_rank;
-      MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+                 typename PS::kkLidView array_indices, int comm_rank) {
       MemberTypeView<T, Device> dst = *static_cast<MemberTypeView<T, Device> const*>(dsts[0]);
       MemberTypeView<T, Device> src = *static_cast<MemberTypeView<T, Device> const*>(srcs[0]);
       auto copyPSToArray = PS_LAMBDA(int elm_id, int ptcl_id, bool mask) {
@@ -166,7 +282,7 @@ namespace particle_structs {
       };
       parallel_for(ps, copyPSToArray);
       CopyParticlesToSendImpl<PS, Types...>(ps, dsts+1, srcs+1, ps_to_array,
-                                            array_indices);
+                                            array_indices, comm_rank);
     }
 
   };
@@ -175,8 +291,11 @@ namespace particle_structs {
     CopyParticlesToSend(PS* ps, MemberTypeViewsConst<MemberTypes<Types...>, Device > dsts,
                         MemberTypeViewsConst<MemberTypes<Types...>, Device > srcs,
                    typename PS::kkLidView ps_to_array,
-                   typename PS::kkLidView array_indices) {
-      CopyParticlesToSendImpl<PS, Types...>(ps, dsts, srcs, ps_to_array, array_indices);
+                   typename PS::kkLidView array_indices, MPI_Comm comm = MPI_COMM_WORLD) {
+      int comm_rank;
+      MPI_Comm_rank(comm, &comm_rank);
+      CopyParticlesToSendImpl<PS, Types...>(ps, dsts, srcs, ps_to_array, array_indices,
+                                            comm_rank);
     }
   };
 
@@ -224,39 +343,102 @@ namespace particle_structs {
   };
 
 
+  template <typename PS, typename... Types> struct ReplacePSViewsImpl;
+  template <typename PS> struct ReplacePSViewsImpl<PS> {
+    typedef typename PS::device_type Device;
+    ReplacePSViewsImpl(PS* ps, MemberTypeViews<MemberTypes<void>, Device>,
+                       MemberTypeViewsConst<MemberTypes<void>, Device>, typename PS::kkLidView,
+                       typename PS::kkLidView, typename PS::kkLidView, int) {}
+  };
+  template <typename PS, typename T, typename... Types> struct ReplacePSViewsImpl<PS, T,Types...> {
+    typedef typename PS::device_type Device;
+    ReplacePSViewsImpl(PS* ps, MemberTypeViews<MemberTypes<T, Types...>, Device> views,
+                       MemberTypeViewsConst<MemberTypes<T, Types...>, Device> new_views,
+                       typename PS::kkLidView new_element, typename PS::kkLidView ps_indices,
+                       typename PS::kkLidView new_indices, int size) {
+      enclose(ps, views, new_views, new_element, ps_indices, new_indices, size);
+    }
+    void enclose(PS* ps, MemberTypeViews<MemberTypes<T, Types...>, Device> views,
+                 MemberTypeViewsConst<MemberTypes<T, Types...>, Device> new_views,
+                 typename PS::kkLidView new_element, typename PS::kkLidView ps_indices,
+                 typename PS::kkLidView new_indices, int size) {
+      MemberTypeView<T, Device> src = *static_cast<MemberTypeView<T, Device>*>(views[0]);
+      //The replacement keeps the subsystem of the view it replaces
+      const std::string subsystem = src.label();
+      MemberTypeView<T, Device>* dst_ptr = new MemberTypeView<T, Device>(subsystem, size);
+      MemberTypeView<T, Device> dst = *dst_ptr;
+      trackAllocation(dst.data(), subsystem, viewBytes(dst));
+      auto copyPSToView = PS_LAMBDA(int elm_id, int ptcl_id, bool mask) {
+        const lid_t new_elem = new_element(ptcl_id);
+        if (mask && new_elem != -1)
+          CopyViewToView<T,Device>(dst, ps_indices(ptcl_id), src, ptcl_id);
+      };
+      parallel_for(ps, copyPSToView);
+      if (new_indices.size() > 0) {
+        MemberTypeView<T, Device> new_src =
+          *static_cast<MemberTypeView<T, Device> const*>(new_views[0]);
+        Kokkos::parallel_for("ps_copy_new_particles", ps->rangePolicy(new_indices.size()),
+                             KOKKOS_LAMBDA(const int& i) {
+          CopyViewToView<T,Device>(dst, new_indices(i), new_src, i);
+        });
+      }
+      //Release the old view before the next type is allocated
+      ps->executionSpace().fence();
+      untrackAllocation(src.data());
+      delete static_cast<MemberTypeView<T, Device>*>(views[0]);
+      views[0] = dst_ptr;
+      ReplacePSViewsImpl<PS, Types...>(ps, views+1, new_views+1, new_element, ps_indices,
+                                       new_indices, size);
+    }
+  };
+  template <typename PS,typename... Types> struct ReplacePSViews<PS, MemberTypes<Types...> > {
+    typedef typename PS::device_type Device;
+    ReplacePSViews(PS* ps, MemberTypeViews<MemberTypes<Types...>, Device> views,
+                   MemberTypeViewsConst<MemberTypes<Types...>, Device> new_views,
+                   typename PS::kkLidView new_element, typename PS::kkLidView ps_indices,
+                   typename PS::kkLidView new_indices, int size) {
+      ReplacePSViewsImpl<PS, Types...>(ps, views, new_views, new_element, ps_indices,
+                                       new_indices, size);
+    }
+  };
+
   template <typename View, typename... Types> struct CopyViewsToViewsImpl;
   template <typename View> struct CopyViewsToViewsImpl<View> {
     typedef typename View::device_type Device;
     CopyViewsToViewsImpl(MemberTypeViewsConst<MemberTypes<void>, Device>,
                              MemberTypeViewsConst<MemberTypes<void>, Device>,
-                             View) {}
+                             View, View) {}
   };
   template <typename View, typename T, typename... Types> struct CopyViewsToViewsImpl<View, T,Types...> {
     typedef typename View::device_type Device;
     CopyViewsToViewsImpl(MemberTypeViewsConst<MemberTypes<T, Types...>, Device> dsts,
                              MemberTypeViewsConst<MemberTypes<T, Types...>, Device> srcs,
-                             View ps_indices) {
-      enclose(dsts,srcs, ps_indices);
+                             View ps_indices, View src_indices) {
+      enclose(dsts,srcs, ps_indices, src_indices);
     }
     void enclose(MemberTypeViewsConst<MemberTypes<T, Types...>, Device> dsts,
                  MemberTypeViewsConst<MemberTypes<T, Types...>, Device> srcs,
-                 View ps_indices) {
+                 View ps_indices, View src_indices) {
       MemberTypeView<T, Device> dst = *static_cast<MemberTypeView<T, Device> const*>(dsts[0]);
       MemberTypeView<T, Device> src = *static_cast<MemberTypeView<T, Device> const*>(srcs[0]);
-      Kokkos::parallel_for(ps_indices.size(), KOKKOS_LAMBDA(const int& i) {
-        const int index = ps_indices(i);
-        CopyViewToView<T,Device>(dst, index, src, i);
+      const bool map_dst = ps_indices.size() > 0;
+      const bool map_src = src_indices.size() > 0;
+      const int n = map_dst ? ps_indices.size() : src_indices.size();
+      Kokkos::parallel_for("ps_copy_particles_to_send", n, KOKKOS_LAMBDA(const int& i) {
+        const int index = map_dst ? ps_indices(i) : i;
+        const int src_index = map_src ? src_indices(i) : i;
+        CopyViewToView<T,Device>(dst, index, src, src_index);
       });
-      CopyViewsToViewsImpl<View, Types...>(dsts+1, srcs+1, ps_indices);
+      CopyViewsToViewsImpl<View, Types...>(dsts+1, srcs+1, ps_indices, src_indices);
     }
   };
   template <typename View, typename... Types> struct CopyViewsToViews<View, MemberTypes<Types...> > {
     typedef typename View::device_type Device;
     CopyViewsToViews(MemberTypeViewsConst<MemberTypes<Types...>, Device> dsts,
                          MemberTypeViewsConst<MemberTypes<Types...>, Device> srcs,
-                         View ps_indices) {
+                         View ps_indices, View src_indices = View()) {
       if (dsts != NULL && srcs != NULL)
-        CopyViewsToViewsImpl<View, Types...>(dsts, srcs, ps_indices);
+        CopyViewsToViewsImpl<View, Types...>(dsts, srcs, ps_indices, src_indices);
     }
   };
 
@@ -289,7 +471,7 @@ namespace particle_structs {
         new_particles++;
       }
 
-      Kokkos::parallel_for(nMoving, KOKKOS_LAMBDA(const lid_t& i) {
+      Kokkos::parallel_for("ps_shuffle_particles", nMoving, KOKKOS_LAMBDA(const lid_t& i) {
           const lid_t old_index = old_indices(i);
           const lid_t new_index = new_indices(i);
           const lid_t isPS = fromPS(i);
@@ -313,42 +495,247 @@ namespace particle_structs {
   template <typename Device, typename... Types> struct SendViewsImpl;
   template <typename Device> struct SendViewsImpl<Device> {
     SendViewsImpl(MemberTypeViews<MemberTypes<void>, Device> views, int offset, int size,
-                  int dest, int tag, MPI_Request* reqs) {}
+                  int dest, int tag, MPI_Request* reqs, MPI_Comm comm) {}
   };
   template <typename Device, typename T, typename... Types> struct SendViewsImpl<Device, T, Types...> {
     SendViewsImpl(MemberTypeViews<MemberTypes<T, Types...>, Device> views, int offset, int size,
-                  int dest, int tag, MPI_Request* reqs) {
+                  int dest, int tag, MPI_Request* reqs, MPI_Comm comm) {
       MemberTypeView<T, Device> v = *static_cast<MemberTypeView<T, Device>*>(views[0]);
-      PS_Comm_Isend(v, offset, size, dest, tag, MPI_COMM_WORLD, reqs);
-      SendViewsImpl<Device, Types...>(views+1, offset, size, dest, tag + 1, reqs + 1);
+      PS_Comm_Isend(v, offset, size, dest, tag, comm, reqs);
+      SendViewsImpl<Device, Types...>(views+1, offset, size, dest, tag + 1, reqs + 1, comm);
     }
   };
 
   template <typename Device, typename... Types> struct SendViews<Device, MemberTypes<Types...>> {
     SendViews(MemberTypeViews<MemberTypes<Types...>, Device> views, int offset, int size,
-              int dest, int start_tag, MPI_Request* reqs) {
-      SendViewsImpl<Device, Types...>(views, offset, size, dest, start_tag, reqs);
+              int dest, int start_tag, MPI_Request* reqs, MPI_Comm comm = MPI_COMM_WORLD) {
+      SendViewsImpl<Device, Types...>(views, offset, size, dest, start_tag, reqs, comm);
     }
   };
 
   template <typename Device, typename... Types> struct RecvViewsImpl;
   template <typename Device> struct RecvViewsImpl<Device> {
     RecvViewsImpl(MemberTypeViews<MemberTypes<void>, Device> views, int offset, int size,
-                  int dest, int tag, MPI_Request* reqs) {}
+                  int dest, int tag, MPI_Request* reqs, MPI_Comm comm) {}
   };
   template <typename Device, typename T, typename... Types> struct RecvViewsImpl<Device, T, Types...> {
     RecvViewsImpl(MemberTypeViews<MemberTypes<T, Types...>, Device > views,
-                  int offset, int size, int dest, int tag, MPI_Request* reqs) {
+                  int offset, int size, int dest, int tag, MPI_Request* reqs, MPI_Comm comm) {
       MemberTypeView<T, Device> v = *static_cast<MemberTypeView<T, Device>*>(views[0]);
-      PS_Comm_Irecv(v, offset, size, dest, tag, MPI_COMM_WORLD, reqs);
-      RecvViewsImpl<Device, Types...>(views+1, offset, size, dest, tag + 1, reqs + 1);
+      PS_Comm_Irecv(v, offset, size, dest, tag, comm, reqs);
+      RecvViewsImpl<Device, Types...>(views+1, offset, size, dest, tag + 1, reqs + 1, comm);
     }
   };
 
   template <typename Device, typename... Types> struct RecvViews<Device, MemberTypes<Types...> > {
     RecvViews(MemberTypeViews<MemberTypes<Types...>, Device> views, int offset, int size,
-              int dest, int start_tag, MPI_Request* reqs) {
-      RecvViewsImpl<Device, Types...>(views, offset, size, dest, start_tag, reqs);
+              int dest, int start_tag, MPI_Request* reqs, MPI_Comm comm = MPI_COMM_WORLD) {
+      RecvViewsImpl<Device, Types...>(views, offset, size, dest, start_tag, reqs, comm);
+    }
+  };
+
+  template <> struct PackedBytes<> {
+    static std::size_t bytes(std::size_t, const int* = NULL) {return 0;}
+  };
+  template <typename T, typename... Types> struct PackedBytes<T, Types...> {
+    static std::size_t bytes(std::size_t size, const int* codecs = NULL) {
+      return packedBytes<T>(size, codecs ? codecs[0] : PACK_EXACT) +
+        PackedBytes<Types...>::bytes(size, codecs ? codecs + 1 : NULL);
+    }
+  };
+  template <typename... Types> struct PackedBytes<MemberTypes<Types...> > {
+    static std::size_t bytes(std::size_t size, const int* codecs = NULL) {
+      return PackedBytes<Types...>::bytes(size, codecs);
+    }
+  };
+
+  template <typename PS, typename... Types> struct PackParticlesImpl;
+  template <typename PS> struct PackParticlesImpl<PS> {
+    typedef typename PS::device_type Device;
+    typedef typename PS::kkLidView LidView;
+    typedef Kokkos::View<std::size_t*, Device> SizeView;
+    typedef Kokkos::View<char*, Device> ByteView;
+    PackParticlesImpl(PS*, MemberTypeViewsConst<MemberTypes<void>, Device>, LidView, LidView,
+                      LidView, LidView, SizeView, ByteView, const int*) {}
+  };
+  template <typename PS, typename T, typename... Types> struct PackParticlesImpl<PS, T, Types...> {
+    typedef typename PS::device_type Device;
+    typedef typename PS::kkLidView LidView;
+    typedef Kokkos::View<std::size_t*, Device> SizeView;
+    typedef Kokkos::View<char*, Device> ByteView;
+    PackParticlesImpl(PS* ps, MemberTypeViewsConst<MemberTypes<T, Types...>, Device> srcs,
+                      LidView ptcl_segment, LidView ptcl_index, LidView segment_offsets,
+                      LidView segment_counts, SizeView type_offsets, ByteView buffer,
+                      const int* codecs) {
+      enclose(ps, srcs, ptcl_segment, ptcl_index, segment_offsets, segment_counts,
+              type_offsets, buffer, codecs);
+    }
+    void enclose(PS* ps, MemberTypeViewsConst<MemberTypes<T, Types...>, Device> srcs,
+                 LidView ptcl_segment, LidView ptcl_index, LidView segment_offsets,
+                 LidView segment_counts, SizeView type_offsets, ByteView buffer,
+                 const int* codecs) {
+      MemberTypeView<T, Device> src = *static_cast<MemberTypeView<T, Device> const*>(srcs[0]);
+      const int codec = codecs ? codecs[0] : PACK_EXACT;
+      if (packNarrowed<T>(codec)) {
+        auto packType = PS_LAMBDA(int elm_id, int ptcl_id, bool mask) {
+          const lid_t segment = ptcl_segment(ptcl_id);
+          if (mask && segment >= 0) {
+            const lid_t index = ptcl_index(ptcl_id) - segment_offsets(segment);
+            float* dst = reinterpret_cast<float*>(buffer.data() + type_offsets(segment)) +
+              index * BaseType<T>::size;
+            BT<T> entry[BaseType<T>::size];
+            PackEntry<T, Device>::pack(entry, src, ptcl_id);
+            for (int j = 0; j < BaseType<T>::size; ++j)
+              dst[j] = entry[j];
+          }
+        };
+        parallel_for(ps, packType);
+      }
+      else {
+        auto packType = PS_LAMBDA(int elm_id, int ptcl_id, bool mask) {
+          const lid_t segment = ptcl_segment(ptcl_id);
+          if (mask && segment >= 0) {
+            const lid_t index = ptcl_index(ptcl_id) - segment_offsets(segment);
+            BT<T>* dst = reinterpret_cast<BT<T>*>(buffer.data() + type_offsets(segment));
+            PackEntry<T, Device>::pack(dst + index * BaseType<T>::size, src, ptcl_id);
+          }
+        };
+        parallel_for(ps, packType);
+      }
+      Kokkos::parallel_for("ps_pack_offsets", type_offsets.size(), KOKKOS_LAMBDA(const lid_t& i) {
+        type_offsets(i) += packedBytes<T>(segment_counts(i), codec);
+      });
+      PackParticlesImpl<PS, Types...>(ps, srcs+1, ptcl_segment, ptcl_index, segment_offsets,
+                                      segment_counts, type_offsets, buffer,
+                                      codecs ? codecs + 1 : NULL);
+    }
+  };
+  template <typename PS, typename... Types> struct PackParticles<PS, MemberTypes<Types...> > {
+    typedef typename PS::device_type Device;
+    typedef typename PS::kkLidView LidView;
+    typedef Kokkos::View<std::size_t*, Device> SizeView;
+    typedef Kokkos::View<char*, Device> ByteView;
+    PackParticles(PS* ps, MemberTypeViewsConst<MemberTypes<Types...>, Device> srcs,
+                  LidView ptcl_segment, LidView ptcl_index, LidView segment_offsets,
+                  LidView segment_counts, SizeView type_offsets, ByteView buffer,
+                  const int* codecs = NULL) {
+      PackParticlesImpl<PS, Types...>(ps, srcs, ptcl_segment, ptcl_index, segment_offsets,
+                                      segment_counts, type_offsets, buffer, codecs);
+    }
+  };
+
+  template <typename Device, typename... Types> struct UnpackViewsImpl;
+  template <typename Device> struct UnpackViewsImpl<Device> {
+    typedef Kokkos::View<lid_t*, Device> LidView;
+    typedef Kokkos::View<std::size_t*, Device> SizeView;
+    typedef Kokkos::View<char*, Device> ByteView;
+    UnpackViewsImpl(MemberTypeViewsConst<MemberTypes<void>, Device>, int, LidView, int,
+                    SizeView, ByteView, LidView, const int*) {}
+  };
+  template <typename Device, typename T, typename... Types>
+  struct UnpackViewsImpl<Device, T, Types...> {
+    typedef Kokkos::View<lid_t*, Device> LidView;
+    typedef Kokkos::View<std::size_t*, Device> SizeView;
+    typedef Kokkos::View<char*, Device> ByteView;
+    UnpackViewsImpl(MemberTypeViewsConst<MemberTypes<T, Types...>, Device> dsts, int size,
+                    LidView segment_offsets, int nsegs, SizeView type_offsets,
+                    ByteView buffer, LidView dst_indices, const int* codecs) {
+      enclose(dsts, size, segment_offsets, nsegs, type_offsets, buffer, dst_indices, codecs);
+    }
+    void enclose(MemberTypeViewsConst<MemberTypes<T, Types...>, Device> dsts, int size,
+                 LidView segment_offsets, int nsegs, SizeView type_offsets, ByteView buffer,
+                 LidView dst_indices, const int* codecs) {
+      MemberTypeView<T, Device> dst = *static_cast<MemberTypeView<T, Device> const*>(dsts[0]);
+      const bool indexed = dst_indices.size() > 0;
+      const int codec = codecs ? codecs[0] : PACK_EXACT;
+      if (packNarrowed<T>(codec)) {
+        Kokkos::parallel_for("ps_unpack_narrowed", size, KOKKOS_LAMBDA(const lid_t& i) {
+          const int segment = segmentOf(segment_offsets, nsegs, i);
+          const lid_t index = i - segment_offsets(segment);
+          const float* src = reinterpret_cast<const float*>(buffer.data() +
+                                                            type_offsets(segment)) +
+            index * BaseType<T>::size;
+          BT<T> entry[BaseType<T>::size];
+          for (int j = 0; j < BaseType<T>::size; ++j)
+            entry[j] = src[j];
+          PackEntry<T, Device>::unpack(dst, indexed ? dst_indices(i) : i, entry);
+        });
+      }
+      else {
+        Kokkos::parallel_for("ps_unpack", size, KOKKOS_LAMBDA(const lid_t& i) {
+          const int segment = segmentOf(segment_offsets, nsegs, i);
+          const lid_t index = i - segment_offsets(segment);
+          const BT<T>* src = reinterpret_cast<const BT<T>*>(buffer.data() +
+                                                            type_offsets(segment));
+          PackEntry<T, Device>::unpack(dst, indexed ? dst_indices(i) : i,
+                                       src + index * BaseType<T>::size);
+        });
+      }
+      Kokkos::parallel_for("ps_unpack_offsets", nsegs, KOKKOS_LAMBDA(const lid_t& i) {
+        type_offsets(i) += packedBytes<T>(segment_offsets(i+1) - segment_offsets(i), codec);
+      });
+      UnpackViewsImpl<Device, Types...>(dsts+1, size, segment_offsets, nsegs, type_offsets,
+                                        buffer, dst_indices, codecs ? codecs + 1 : NULL);
+    }
+  };
+  template <typename Device, typename... Types> struct UnpackViews<Device, MemberTypes<Types...> > {
+    typedef Kokkos::View<lid_t*, Device> LidView;
+    typedef Kokkos::View<std::size_t*, Device> SizeView;
+    typedef Kokkos::View<char*, Device> ByteView;
+    UnpackViews(MemberTypeViewsConst<MemberTypes<Types...>, Device> dsts, int size,
+                LidView segment_offsets, int nsegs, SizeView type_offsets, ByteView buffer,
+                LidView dst_indices = LidView(), const int* codecs = NULL) {
+      UnpackViewsImpl<Device, Types...>(dsts, size, segment_offsets, nsegs, type_offsets,
+                                        buffer, dst_indices, codecs);
+    }
+  };
+
+  template <typename Device, typename... Types> struct PackViewsImpl;
+  template <typename Device> struct PackViewsImpl<Device> {
+    typedef Kokkos::View<lid_t*, Device> LidView;
+    typedef Kokkos::View<std::size_t*, Device> SizeView;
+    typedef Kokkos::View<char*, Device> ByteView;
+    PackViewsImpl(MemberTypeViewsConst<MemberTypes<void>, Device>, int, LidView, int,
+                  SizeView, ByteView, LidView) {}
+  };
+  template <typename Device, typename T, typename... Types>
+  struct PackViewsImpl<Device, T, Types...> {
+    typedef Kokkos::View<lid_t*, Device> LidView;
+    typedef Kokkos::View<std::size_t*, Device> SizeView;
+    typedef Kokkos::View<char*, Device> ByteView;
+    PackViewsImpl(MemberTypeViewsConst<MemberTypes<T, Types...>, Device> srcs, int size,
+                  LidView segment_offsets, int nsegs, SizeView type_offsets,
+                  ByteView buffer, LidView src_indices) {
+      enclose(srcs, size, segment_offsets, nsegs, type_offsets, buffer, src_indices);
+    }
+    void enclose(MemberTypeViewsConst<MemberTypes<T, Types...>, Device> srcs, int size,
+                 LidView segment_offsets, int nsegs, SizeView type_offsets, ByteView buffer,
+                 LidView src_indices) {
+      MemberTypeView<T, Device> src = *static_cast<MemberTypeView<T, Device> const*>(srcs[0]);
+      const bool indexed = src_indices.size() > 0;
+      Kokkos::parallel_for("ps_pack_views", size, KOKKOS_LAMBDA(const lid_t& i) {
+        const int segment = segmentOf(segment_offsets, nsegs, i);
+        const lid_t index = i - segment_offsets(segment);
+        BT<T>* dst = reinterpret_cast<BT<T>*>(buffer.data() + type_offsets(segment));
+        PackEntry<T, Device>::pack(dst + index * BaseType<T>::size, src,
+                                   indexed ? src_indices(i) : i);
+      });
+      Kokkos::parallel_for("ps_pack_views_offsets", nsegs, KOKKOS_LAMBDA(const lid_t& i) {
+        type_offsets(i) += packedBytes<T>(segment_offsets(i+1) - segment_offsets(i));
+      });
+      PackViewsImpl<Device, Types...>(srcs+1, size, segment_offsets, nsegs, type_offsets,
+                                      buffer, src_indices);
+    }
+  };
+  template <typename Device, typename... Types> struct PackViews<Device, MemberTypes<Types...> > {
+    typedef Kokkos::View<lid_t*, Device> LidView;
+    typedef Kokkos::View<std::size_t*, Device> SizeView;
+    typedef Kokkos::View<char*, Device> ByteView;
+    PackViews(MemberTypeViewsConst<MemberTypes<Types...>, Device> srcs, int size,
+              LidView segment_offsets, int nsegs, SizeView type_offsets, ByteView buffer,
+              LidView src_indices = LidView()) {
+      PackViewsImpl<Device, Types...>(srcs, size, segment_offsets, nsegs, type_offsets,
+                                      buffer, src_indices);
     }
   };
 
@@ -359,7 +746,9 @@ namespace particle_structs {
   };
   template <typename Device, typename T, typename... Types> struct DestroyViewsImpl<Device, T,Types...> {
     DestroyViewsImpl(MemberTypeViews<MemberTypes<T,Types...>, Device > data) {
-      delete static_cast<MemberTypeView<T, Device>*>(data[0]);
+      MemberTypeView<T, Device>* view = static_cast<MemberTypeView<T, Device>*>(data[0]);
+      untrackAllocation(view->data());
+      delete view;
       DestroyViewsImpl<Device, Types...>(data+1);
     }
   };
@@ -5,6 +5,62 @@
 
 namespace particle_structs {
 
+/* Member type stored in reduced precision
+     Compute is the type seen by kernels (ex. double[3]) and Storage replaces its base type
+     in memory (ex. float). Views, migration, packing and checkpoints hold the storage form
+     while Segment accessors convert to and from the compute base type.
+
+   Usage: MemberTypes<Compact<double[3], float>, int>
+*/
+template <typename Compute, typename Storage>
+struct Compact {};
+
+/* Member type held in the Kokkos layout Layout in place of the default of the device
+     Only changes how the components of a multidimensional member are ordered in memory:
+     LayoutLeft places component i of consecutive particles next to each other (coalesced
+     access from GPU threads) and LayoutRight places the components of one particle next to
+     each other (cache friendly on CPUs). T may be a Compact member. Packing, migration and
+     checkpoints use the order of the default layout so layouts can differ between builds.
+     The tiles of an AoSoA structure have their own layout and ignore the annotation.
+
+   Usage: MemberTypes<WithLayout<double[3], Kokkos::LayoutLeft>, int>
+*/
+template <typename T, typename Layout>
+struct WithLayout {};
+
+//Replaces the base type of T (keeping array extents) with S
+template <class T, class S>
+struct ReplaceBase {
+  using type = S;
+};
+template <class T, class S, int N>
+struct ReplaceBase<T[N], S> {
+  using type = typename ReplaceBase<T, S>::type[N];
+};
+
+//Type held in memory for a member type
+template <class T>
+struct MemberStorage {
+  using type = T;
+};
+template <class Compute, class Storage>
+struct MemberStorage<Compact<Compute, Storage> > {
+  using type = typename ReplaceBase<Compute, Storage>::type;
+};
+template <class T, class Layout>
+struct MemberStorage<WithLayout<T, Layout> > : MemberStorage<T> {};
+template <class T> using StorageType = typename MemberStorage<T>::type;
+
+//Layout of the view of a member type, void is the default layout of the device
+template <class T>
+struct MemberLayout {
+  using type = void;
+};
+template <class T, class Layout>
+struct MemberLayout<WithLayout<T, Layout> > {
+  using type = Layout;
+};
+
 template<std::size_t N, typename T, typename... Types>
 struct MemberSize;
 
@@ -15,7 +71,7 @@ struct MemberSize<0, T,Types...> {
 
 template<std::size_t N, typename T, typename... Types>
 struct MemberSize {
-  static constexpr std::size_t memsize = sizeof(T) + MemberSize<N-1, Types...>::memsize;
+  static constexpr std::size_t memsize = sizeof(StorageType<T>) + MemberSize<N-1, Types...>::memsize;
 };
 
 template<typename... Types>
@@ -30,7 +86,7 @@ struct MemberTypes<> {
 template<typename H, typename... T>
   struct MemberTypes<H,T...> {
   static constexpr std::size_t size = 1 + MemberTypes<T...>::size;
-  static constexpr std::size_t memsize = sizeof(H) + MemberTypes<T...>::memsize;
+  static constexpr std::size_t memsize = sizeof(StorageType<H>) + MemberTypes<T...>::memsize;
 
   template <std::size_t I>
     static std::size_t sizeToIndex() {return MemberSize<I,H,T...,void>::memsize;}
@@ -70,6 +126,11 @@ struct BaseType<T[N]> {
   using type = typename BaseType<T>::type;
   static constexpr int size = N * BaseType<T>::size;
 };
+//Compact members are stored (and packed) as their storage type
+template <class Compute, class Storage>
+struct BaseType<Compact<Compute, Storage> > : BaseType<StorageType<Compact<Compute, Storage> > > {};
+template <class T, class Layout>
+struct BaseType<WithLayout<T, Layout> > : BaseType<T> {};
 
 }
 
@@ -0,0 +1,80 @@
+#include "MemoryTracker.h"
+
+namespace particle_structs {
+  namespace {
+    std::map<std::string, MemoryStats> memory_usage;
+    MemoryStats total_usage;
+    std::vector<std::string> phases;
+    //Subsystem and bytes of each tracked allocation
+    std::map<const void*, std::pair<std::string, long long> > allocations;
+
+    std::string currentPhase() {
+      std::string phase;
+      for (std::size_t i = 0; i < phases.size(); ++i)
+        phase += (i ? "/" : "") + phases[i];
+      return phase;
+    }
+
+    void update(MemoryStats& stats, long long bytes) {
+      stats.current += bytes;
+      if (bytes > 0)
+        ++stats.allocations;
+      if (stats.current > stats.peak) {
+        stats.peak = stats.current;
+        stats.peak_phase = currentPhase();
+      }
+    }
+  }
+
+  void trackMemory(const std::string& subsystem, long long bytes) {
+    if (bytes == 0)
+      return;
+    update(memory_usage[subsystem], bytes);
+    update(total_usage, bytes);
+  }
+
+  void trackAllocation(const void* data, const std::string& subsystem, long long bytes) {
+    if (data == NULL || bytes == 0)
+      return;
+    untrackAllocation(data);
+    allocations[data] = std::make_pair(subsystem, bytes);
+    trackMemory(subsystem, bytes);
+  }
+
+  void untrackAllocation(const void* data) {
+    auto itr = allocations.find(data);
+    if (itr == allocations.end())
+      return;
+    trackMemory(itr->second.first, -itr->second.second);
+    allocations.erase(itr);
+  }
+
+  const std::map<std::string, MemoryStats>& getMemoryUsage() {return memory_usage;}
+  MemoryStats getTotalMemoryUsage() {return total_usage;}
+
+  void resetMemoryPeaks() {
+    const std::string phase = currentPhase();
+    for (auto itr = memory_usage.begin(); itr != memory_usage.end(); ++itr) {
+      itr->second.peak = itr->second.current;
+      itr->second.peak_phase = phase;
+    }
+    total_usage.peak = total_usage.current;
+    total_usage.peak_phase = phase;
+  }
+
+  void printMemoryUsage(FILE* out) {
+    fprintf(out, "%-32s %14s %14s %12s %s\n", "Memory", "Current(B)", "Peak(B)", "Allocations",
+            "PeakPhase");
+    for (auto itr = memory_usage.begin(); itr != memory_usage.end(); ++itr)
+      fprintf(out, "%-32s %14lld %14lld %12lld %s\n", itr->first.c_str(), itr->second.current,
+              itr->second.peak, itr->second.allocations, itr->second.peak_phase.c_str());
+    fprintf(out, "%-32s %14lld %14lld %12lld %s\n", "total", total_usage.current,
+            total_usage.peak, total_usage.allocations, total_usage.peak_phase.c_str());
+  }
+
+  void pushMemoryPhase(const std::string& phase) {phases.push_back(phase);}
+  void popMemoryPhase() {
+    if (phases.size() > 0)
+      phases.pop_back();
+  }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace particle_structs {
+
+  /* Accounting of the memory held by particle_structs and pumipic by subsystem
+
+     Allocations and frees of the member views (CreateViews/DestroyViews, labeled by the
+     view label), buffer pools (<pool>_<first word of the buffer name>), the SellCSigma
+     layout, the search scratch and the comm plans are recorded here with the current bytes
+     and high-water mark of each subsystem and of all of them together. The phase
+     (MemoryPhase names joined by '/') active when each peak was reached is kept, so the
+     step that needs the most memory (i.e. scs_migrate/scs_rebuild) can be found.
+
+     Usage:
+       {
+         MemoryPhase phase("my_phase");
+         trackMemory("my_subsystem", bytes); //allocated
+         ...
+         trackMemory("my_subsystem", -bytes); //freed
+       }
+       MemoryStats total = getTotalMemoryUsage();
+       printMemoryUsage(); //Table of the subsystems of this rank
+  */
+  struct MemoryStats {
+    MemoryStats() : current(0), peak(0), allocations(0) {}
+    long long current;
+    long long peak;
+    long long allocations;
+    //Phase when the peak was reached (empty outside of every phase)
+    std::string peak_phase;
+  };
+
+  //Adds bytes (negative when freed) to the current bytes of a subsystem
+  void trackMemory(const std::string& subsystem, long long bytes);
+  /* Tracks the bytes of the allocation at data in a subsystem until untrackAllocation
+     Only allocations tracked here are freed, so views allocated elsewhere and freed by
+       the same code (i.e. user views passed to DestroyViews) leave the subsystems unchanged
+  */
+  void trackAllocation(const void* data, const std::string& subsystem, long long bytes);
+  void untrackAllocation(const void* data);
+
+  //Memory of each subsystem and of every subsystem together on this rank
+  const std::map<std::string, MemoryStats>& getMemoryUsage();
+  MemoryStats getTotalMemoryUsage();
+  //Sets every peak to the current bytes
+  void resetMemoryPeaks();
+
+  void printMemoryUsage(FILE* out = stdout);
+
+  void pushMemoryPhase(const std::string& phase);
+  void popMemoryPhase();
+
+  //Names the phase of the allocations made during its lifetime
+  class MemoryPhase {
+  public:
+    MemoryPhase(const std::string& phase) {pushMemoryPhase(phase);}
+    ~MemoryPhase() {popMemoryPhase();}
+  private:
+    MemoryPhase(const MemoryPhase&);
+    MemoryPhase& operator=(const MemoryPhase&);
+  };
+
+  //Bytes held by one owner in a subsystem, freed when the owner is destroyed
+  class TrackedBytes {
+  public:
+    TrackedBytes() : bytes(0) {}
+    ~TrackedBytes() {
+      if (bytes != 0)
+        trackMemory(name, -bytes);
+    }
+    //Tracks the change from the last total of the owner
+    void track(const std::string& subsystem, long long total) {
+      if (subsystem != name) {
+        if (bytes != 0)
+          trackMemory(name, -bytes);
+        name = subsystem;
+        bytes = 0;
+      }
+      trackMemory(name, total - bytes);
+      bytes = total;
+    }
+    long long get() const {return bytes;}
+  private:
+    TrackedBytes(const TrackedBytes&);
+    TrackedBytes& operator=(const TrackedBytes&);
+    std::string name;
+    long long bytes;
+  };
+
+  //Bytes of the allocation of a Kokkos view
+  template <typename View>
+  long long viewBytes(const View& view) {
+    return view.span() * sizeof(typename View::value_type);
+  }
+}
@@ -11,3 +11,19 @@
 #define PS_LAMBDA [=]
 #define PS_DEVICE_VAR
 #endif
+
+//Asks the host compiler to vectorize the following loop
+#ifdef PS_USE_OPENMP
+#define PS_SIMD _Pragma("omp simd")
+#else
+#define PS_SIMD
+#endif
+
+//Bytes of the widest SIMD registers of the host target
+#if defined(__AVX512F__)
+#define PS_SIMD_BYTES 64
+#elif defined(__AVX__)
+#define PS_SIMD_BYTES 32
+#else
+#define PS_SIMD_BYTES 16
+#endif
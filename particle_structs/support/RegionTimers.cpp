@@ -0,0 +1,242 @@
+#include "RegionTimers.h"
+#include <vector>
+
+namespace particle_structs {
+  namespace {
+    std::map<std::string, RegionStats> region_times;
+    std::map<std::string, long long> counters;
+    bool time_prints = true;
+    bool kernel_work = false;
+
+    //Statistics of one value across ranks
+    struct Summary {
+      std::string name;
+      double min, max, mean;
+      long long calls;
+    };
+
+    //Union of the names on every rank of comm in the same order on every rank
+    std::vector<std::string> allNames(const std::vector<std::string>& names, MPI_Comm comm) {
+      std::string local;
+      for (std::size_t i = 0; i < names.size(); ++i)
+        local += names[i] + '\n';
+      int comm_size;
+      MPI_Comm_size(comm, &comm_size);
+      int length = local.size();
+      std::vector<int> lengths(comm_size), displs(comm_size + 1, 0);
+      MPI_Allgather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, comm);
+      for (int i = 0; i < comm_size; ++i)
+        displs[i + 1] = displs[i] + lengths[i];
+      std::string all(displs[comm_size], '\0');
+      MPI_Allgatherv(&local[0], length, MPI_CHAR, &all[0], lengths.data(), displs.data(),
+                     MPI_CHAR, comm);
+      std::map<std::string, int> unique;
+      std::size_t start = 0;
+      for (std::size_t i = 0; i < all.size(); ++i) {
+        if (all[i] == '\n') {
+          unique[all.substr(start, i - start)] = 0;
+          start = i + 1;
+        }
+      }
+      std::vector<std::string> result;
+      for (auto itr = unique.begin(); itr != unique.end(); ++itr)
+        result.push_back(itr->first);
+      return result;
+    }
+
+    //Reduces values[i] of every rank to min/max/mean on rank 0
+    std::vector<Summary> summarize(const std::vector<std::string>& names,
+                                   std::vector<double>& values, std::vector<long long>& calls,
+                                   MPI_Comm comm) {
+      int comm_size;
+      MPI_Comm_size(comm, &comm_size);
+      const int n = names.size();
+      std::vector<double> mins(n), maxs(n), sums(n);
+      std::vector<long long> total_calls(n);
+      MPI_Reduce(values.data(), mins.data(), n, MPI_DOUBLE, MPI_MIN, 0, comm);
+      MPI_Reduce(values.data(), maxs.data(), n, MPI_DOUBLE, MPI_MAX, 0, comm);
+      MPI_Reduce(values.data(), sums.data(), n, MPI_DOUBLE, MPI_SUM, 0, comm);
+      MPI_Reduce(calls.data(), total_calls.data(), n, MPI_LONG_LONG, MPI_SUM, 0, comm);
+      std::vector<Summary> result(n);
+      for (int i = 0; i < n; ++i) {
+        result[i].name = names[i];
+        result[i].min = mins[i];
+        result[i].max = maxs[i];
+        result[i].mean = sums[i] / comm_size;
+        result[i].calls = total_calls[i];
+      }
+      return result;
+    }
+
+    void gatherSummaries(MPI_Comm comm, std::vector<Summary>& times,
+                         std::vector<Summary>& counts) {
+      std::vector<std::string> names;
+      for (auto itr = region_times.begin(); itr != region_times.end(); ++itr)
+        names.push_back(itr->first);
+      names = allNames(names, comm);
+      std::vector<double> values(names.size(), 0);
+      std::vector<long long> calls(names.size(), 0);
+      for (std::size_t i = 0; i < names.size(); ++i) {
+        auto itr = region_times.find(names[i]);
+        if (itr != region_times.end()) {
+          values[i] = itr->second.total;
+          calls[i] = itr->second.calls;
+        }
+      }
+      times = summarize(names, values, calls, comm);
+
+      names.clear();
+      for (auto itr = counters.begin(); itr != counters.end(); ++itr)
+        names.push_back(itr->first);
+      names = allNames(names, comm);
+      values.assign(names.size(), 0);
+      calls.assign(names.size(), 0);
+      for (std::size_t i = 0; i < names.size(); ++i) {
+        auto itr = counters.find(names[i]);
+        if (itr != counters.end()) {
+          values[i] = itr->second;
+          calls[i] = 1;
+        }
+      }
+      counts = summarize(names, values, calls, comm);
+    }
+
+    //Mean work per second of each region with recorded work
+    struct Rate {
+      Rate() : bytes(0), particles(0) {}
+      std::string name;
+      double bytes, particles;
+    };
+    bool hasSuffix(const std::string& name, const std::string& suffix) {
+      return name.size() > suffix.size() &&
+        name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+    std::vector<Rate> computeRates(const std::vector<Summary>& times,
+                                   const std::vector<Summary>& counts) {
+      std::map<std::string, Rate> rates;
+      for (std::size_t i = 0; i < counts.size(); ++i) {
+        const bool bytes = hasSuffix(counts[i].name, "_bytes");
+        if (!bytes && !hasSuffix(counts[i].name, "_particles"))
+          continue;
+        const std::string region = counts[i].name.substr(0, counts[i].name.rfind('_'));
+        for (std::size_t j = 0; j < times.size(); ++j) {
+          if (times[j].name != region || times[j].mean <= 0)
+            continue;
+          Rate& rate = rates[region];
+          rate.name = region;
+          (bytes ? rate.bytes : rate.particles) = counts[i].mean / times[j].mean;
+        }
+      }
+      std::vector<Rate> result;
+      for (auto itr = rates.begin(); itr != rates.end(); ++itr)
+        result.push_back(itr->second);
+      return result;
+    }
+  }
+
+  void addRegionTime(const std::string& region, double seconds) {
+    RegionStats& stats = region_times[region];
+    if (stats.calls == 0 || seconds < stats.min)
+      stats.min = seconds;
+    if (stats.calls == 0 || seconds > stats.max)
+      stats.max = seconds;
+    stats.total += seconds;
+    ++stats.calls;
+  }
+
+  void addToCounter(const std::string& counter, long long value) {
+    counters[counter] += value;
+  }
+
+  const std::map<std::string, RegionStats>& getRegionTimes() {return region_times;}
+  const std::map<std::string, long long>& getCounters() {return counters;}
+
+  void resetRegionTimes() {
+    region_times.clear();
+    counters.clear();
+  }
+
+  void setTimePrints(bool enable) {time_prints = enable;}
+  bool timePrintsEnabled() {return time_prints;}
+
+  void setKernelWork(bool enable) {kernel_work = enable;}
+  bool kernelWorkEnabled() {return kernel_work;}
+  void recordKernelWork(const std::string& name, long long bytes, long long particles) {
+    if (!kernel_work)
+      return;
+    if (bytes > 0)
+      counters[name + "_bytes"] += bytes;
+    counters[name + "_particles"] += particles;
+  }
+
+  void printRegionSummary(MPI_Comm comm, FILE* out) {
+    std::vector<Summary> times, counts;
+    gatherSummaries(comm, times, counts);
+    int comm_rank;
+    MPI_Comm_rank(comm, &comm_rank);
+    if (comm_rank)
+      return;
+    fprintf(out, "%-40s %10s %12s %12s %12s\n", "Region", "Calls", "Min(s)", "Max(s)",
+            "Mean(s)");
+    for (std::size_t i = 0; i < times.size(); ++i)
+      fprintf(out, "%-40s %10lld %12f %12f %12f\n", times[i].name.c_str(), times[i].calls,
+              times[i].min, times[i].max, times[i].mean);
+    if (counts.size() > 0)
+      fprintf(out, "%-40s %10s %12s %12s %12s\n", "Counter", "Ranks", "Min", "Max", "Mean");
+    for (std::size_t i = 0; i < counts.size(); ++i)
+      fprintf(out, "%-40s %10lld %12.0f %12.0f %12f\n", counts[i].name.c_str(), counts[i].calls,
+              counts[i].min, counts[i].max, counts[i].mean);
+    const std::vector<Rate> rates = computeRates(times, counts);
+    if (rates.size() > 0)
+      fprintf(out, "%-40s %12s %16s\n", "Rate", "GB/s", "Particles/s");
+    for (std::size_t i = 0; i < rates.size(); ++i)
+      fprintf(out, "%-40s %12f %16.0f\n", rates[i].name.c_str(), rates[i].bytes / 1e9,
+              rates[i].particles);
+  }
+
+  void writeRegionSummary(const std::string& filename, MPI_Comm comm) {
+    std::vector<Summary> times, counts;
+    gatherSummaries(comm, times, counts);
+    int comm_rank, comm_size;
+    MPI_Comm_rank(comm, &comm_rank);
+    MPI_Comm_size(comm, &comm_size);
+    if (comm_rank)
+      return;
+    FILE* out = fopen(filename.c_str(), "w");
+    if (!out) {
+      fprintf(stderr, "[ERROR] Cannot open %s to write the timing summary\n", filename.c_str());
+      return;
+    }
+    const bool json = filename.size() >= 5 &&
+      filename.compare(filename.size() - 5, 5, ".json") == 0;
+    if (json) {
+      fprintf(out, "{\n  \"ranks\": %d,\n  \"regions\": [", comm_size);
+      for (std::size_t i = 0; i < times.size(); ++i)
+        fprintf(out, "%s\n    {\"name\": \"%s\", \"calls\": %lld, \"min\": %g, \"max\": %g, "
+                "\"mean\": %g}", i ? "," : "", times[i].name.c_str(), times[i].calls,
+                times[i].min, times[i].max, times[i].mean);
+      fprintf(out, "\n  ],\n  \"counters\": [");
+      for (std::size_t i = 0; i < counts.size(); ++i)
+        fprintf(out, "%s\n    {\"name\": \"%s\", \"min\": %.0f, \"max\": %.0f, \"mean\": %g}",
+                i ? "," : "", counts[i].name.c_str(), counts[i].min, counts[i].max,
+                counts[i].mean);
+      const std::vector<Rate> rates = computeRates(times, counts);
+      fprintf(out, "\n  ],\n  \"rates\": [");
+      for (std::size_t i = 0; i < rates.size(); ++i)
+        fprintf(out, "%s\n    {\"name\": \"%s\", \"bytes_per_second\": %g, "
+                "\"particles_per_second\": %g}", i ? "," : "", rates[i].name.c_str(),
+                rates[i].bytes, rates[i].particles);
+      fprintf(out, "\n  ]\n}\n");
+    }
+    else {
+      fprintf(out, "type,name,calls,min,max,mean\n");
+      for (std::size_t i = 0; i < times.size(); ++i)
+        fprintf(out, "region,%s,%lld,%g,%g,%g\n", times[i].name.c_str(), times[i].calls,
+                times[i].min, times[i].max, times[i].mean);
+      for (std::size_t i = 0; i < counts.size(); ++i)
+        fprintf(out, "counter,%s,%lld,%.0f,%.0f,%g\n", counts[i].name.c_str(), counts[i].calls,
+                counts[i].min, counts[i].max, counts[i].mean);
+    }
+    fclose(out);
+  }
+}
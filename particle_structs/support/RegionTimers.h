@@ -0,0 +1,97 @@
+#pragma once
+
+#include <mpi.h>
+#include <Kokkos_Core.hpp>
+#include <cstdio>
+#include <map>
+#include <string>
+
+namespace particle_structs {
+
+  /* Registry of timers and counters keyed by region name shared by particle_structs and pumipic
+
+     Timings of construction/rebuild/migrate and searches are recorded here every call so they
+     can be queried by the program instead of read from stderr.
+
+     Usage:
+       {
+         RegionTimer t("my_region"); //Adds the lifetime of t to my_region
+         ...
+       }
+       addRegionTime("my_region", seconds);
+       addToCounter("my_counter", value);
+       std::map<std::string, RegionStats> times = getRegionTimes();
+       writeRegionSummary("times.json"); //Collective, min/max/mean across ranks from rank 0
+
+     Kernel and region names are stable so Kokkos tools see the same labels every run, the
+     profiling regions nest as step > species (ps_species_<n>) > search/rebuild/migrate
+     when the step and species are wrapped in ScopedRegions
+  */
+  struct RegionStats {
+    RegionStats() : calls(0), total(0), min(0), max(0) {}
+    long long calls;
+    //Sum, shortest and longest call in seconds
+    double total, min, max;
+  };
+
+  void addRegionTime(const std::string& region, double seconds);
+  void addToCounter(const std::string& counter, long long value);
+
+  //Timers and counters recorded on this rank
+  const std::map<std::string, RegionStats>& getRegionTimes();
+  const std::map<std::string, long long>& getCounters();
+  void resetRegionTimes();
+
+  /* Turns the per call timing messages on stderr on/off (on by default)
+       The registry is filled either way
+  */
+  void setTimePrints(bool enable);
+  bool timePrintsEnabled();
+
+  /* Work counters for bandwidth and throughput reports (off by default)
+       recordKernelWork adds to the counters <name>_bytes and <name>_particles, the summaries
+       divide them by the time of the region name to report bytes/s and particles/s
+     Recorded by rebuild (ps_rebuild, ps_reshuffle), migrate (ps_migrate, bytes sent), the
+       searches and named SellCSigma parallel_for calls (particles only)
+  */
+  void setKernelWork(bool enable);
+  bool kernelWorkEnabled();
+  void recordKernelWork(const std::string& name, long long bytes, long long particles);
+
+  /* Collective over comm, rank 0 writes min/max/mean across ranks of each region and counter
+       printRegionSummary writes a table, writeRegionSummary writes JSON if the filename ends
+       with .json and CSV otherwise
+  */
+  void printRegionSummary(MPI_Comm comm = MPI_COMM_WORLD, FILE* out = stdout);
+  void writeRegionSummary(const std::string& filename, MPI_Comm comm = MPI_COMM_WORLD);
+
+  //Profiling region (Kokkos::Profiling::pushRegion) timed like RegionTimer
+  class ScopedRegion {
+  public:
+    ScopedRegion(const std::string& region) : name(region) {
+      Kokkos::Profiling::pushRegion(name);
+    }
+    ~ScopedRegion() {
+      Kokkos::Profiling::popRegion();
+      addRegionTime(name, timer.seconds());
+    }
+  private:
+    ScopedRegion(const ScopedRegion&);
+    ScopedRegion& operator=(const ScopedRegion&);
+    std::string name;
+    Kokkos::Timer timer;
+  };
+
+  //Adds the time between construction and destruction to a region
+  class RegionTimer {
+  public:
+    RegionTimer(const std::string& region) : name(region) {}
+    ~RegionTimer() {addRegionTime(name, timer.seconds());}
+    double seconds() const {return timer.seconds();}
+  private:
+    RegionTimer(const RegionTimer&);
+    RegionTimer& operator=(const RegionTimer&);
+    std::string name;
+    Kokkos::Timer timer;
+  };
+}
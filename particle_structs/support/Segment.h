@@ -4,12 +4,15 @@
 #include <type_traits>
 namespace particle_structs {
 
-template <typename Type, typename Device>
+/* Accessor of the view of a member type
+     Layout is the Kokkos layout of the view, void for the default layout of the device
+*/
+template <typename Type, typename Device, typename Layout = void>
 class Segment {
 public:
   using Base=typename BaseType<Type>::type;
 
-  using ViewType=Kokkos::View<Type*, Device>;
+  using ViewType=typename LayoutView<Type, Layout, Device>::type;
   Segment() {}
   Segment(ViewType v) : view(v){}
 
@@ -38,4 +41,85 @@ private:
   ViewType view;
 };
 
+/* Reference to one reduced precision value that reads and writes the compute type
+     Returned by the Segment of a Compact member in place of Base&
+*/
+template <typename Storage, typename Compute>
+class CompactRef {
+public:
+  KOKKOS_INLINE_FUNCTION CompactRef(Storage& v) : value(v) {}
+  KOKKOS_INLINE_FUNCTION operator Compute() const {return static_cast<Compute>(value);}
+  KOKKOS_INLINE_FUNCTION const CompactRef& operator=(const Compute& v) const {
+    value = static_cast<Storage>(v);
+    return *this;
+  }
+  KOKKOS_INLINE_FUNCTION const CompactRef& operator=(const CompactRef& other) const {
+    value = other.value;
+    return *this;
+  }
+  KOKKOS_INLINE_FUNCTION const CompactRef& operator+=(const Compute& v) const {
+    return *this = static_cast<Compute>(value) + v;
+  }
+  KOKKOS_INLINE_FUNCTION const CompactRef& operator-=(const Compute& v) const {
+    return *this = static_cast<Compute>(value) - v;
+  }
+  KOKKOS_INLINE_FUNCTION const CompactRef& operator*=(const Compute& v) const {
+    return *this = static_cast<Compute>(value) * v;
+  }
+  KOKKOS_INLINE_FUNCTION const CompactRef& operator/=(const Compute& v) const {
+    return *this = static_cast<Compute>(value) / v;
+  }
+private:
+  Storage& value;
+};
+
+//Segment of a reduced precision member, indexed the same as the compute type
+template <typename Compute, typename Storage, typename Device, typename Layout>
+class Segment<Compact<Compute, Storage>, Device, Layout> {
+public:
+  using Base=typename BaseType<Compute>::type;
+  using Ref=CompactRef<Storage, Base>;
+
+  using ViewType=typename LayoutView<StorageType<Compact<Compute, Storage> >, Layout,
+                                     Device>::type;
+  Segment() {}
+  Segment(ViewType v) : view(v){}
+
+  template <typename U = Compute>
+  KOKKOS_INLINE_FUNCTION typename std::enable_if<std::rank<Compute>::value == 0 && std::is_same<U, Compute>::value, Ref>::type
+    operator()(const int& particle_index) const {
+    return Ref(view(particle_index));
+  }
+  template <typename U = Compute>
+  KOKKOS_INLINE_FUNCTION typename std::enable_if<std::rank<Compute>::value == 1 && std::is_same<U, Compute>::value, Ref>::type
+    operator()(const int& particle_index, const int& i) const {
+    return Ref(view(particle_index, i));
+  }
+  template <typename U = Compute>
+  KOKKOS_INLINE_FUNCTION typename std::enable_if<std::rank<Compute>::value == 2 && std::is_same<U, Compute>::value, Ref>::type
+    operator()(const int& particle_index, const int& i, const int& j) const {
+    return Ref(view(particle_index, i, j));
+  }
+  template <typename U = Compute>
+  KOKKOS_INLINE_FUNCTION typename std::enable_if<std::rank<Compute>::value == 3 && std::is_same<U, Compute>::value, Ref>::type
+    operator()(const int& particle_index, const int& i, const int& j, const int& k) const {
+    return Ref(view(particle_index, i, j, k));
+  }
+
+  //The compact storage view
+  ViewType storage() const {return view;}
+
+private:
+  ViewType view;
+};
+
+//Segment of a member in an explicit layout, indexed the same as the default layout
+template <typename Type, typename Layout, typename Device>
+class Segment<WithLayout<Type, Layout>, Device, void> : public Segment<Type, Device, Layout> {
+public:
+  using ViewType=typename Segment<Type, Device, Layout>::ViewType;
+  Segment() {}
+  Segment(ViewType v) : Segment<Type, Device, Layout>(v) {}
+};
+
 }
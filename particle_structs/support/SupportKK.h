@@ -1,6 +1,7 @@
 #pragma once
 
 #include <Kokkos_Core.hpp>
+#include "MemberTypes.h"
 
 namespace particle_structs {
 
@@ -10,6 +11,14 @@ namespace particle_structs {
     Kokkos::deep_copy(hv, view);
     return hv;
   }
+  //Waits only on the work of space before copying
+  template <class ExecSpace, class View>
+    typename View::HostMirror deviceToHost(const ExecSpace& space, View view) {
+    auto hv = Kokkos::create_mirror_view(view);
+    Kokkos::deep_copy(space, hv, view);
+    space.fence();
+    return hv;
+  }
 
  template <class T, typename Device> struct HostToDevice;
 
@@ -28,6 +37,18 @@ T getLastValue(Kokkos::View<T*, Device> view) {
   return lastVal;
 }
 
+//Waits only on the work of space before reading the last value
+template <typename T, typename ExecSpace, typename Device>
+T getLastValue(const ExecSpace& space, Kokkos::View<T*, Device> view) {
+  const int size = view.size();
+  if (size == 0)
+    return 0;
+  T lastVal;
+  Kokkos::deep_copy(space, lastVal, Kokkos::subview(view,size-1));
+  space.fence();
+  return lastVal;
+}
+
 template <class T, typename Device> struct CopyViewToView {
   KOKKOS_INLINE_FUNCTION CopyViewToView(Kokkos::View<T*, Device> dst, int dst_index,
                                               Kokkos::View<T*, Device> src, int src_index) {
@@ -63,11 +84,214 @@ template <class T, typename Device, int N, int M, int P>
   }
 };
 
+//Spreads the low 21 bits of v so there are two zero bits between each bit
+KOKKOS_INLINE_FUNCTION unsigned long long spreadBits3(unsigned long long v) {
+  v &= 0x1fffff;
+  v = (v | v << 32) & 0x1f00000000ffffULL;
+  v = (v | v << 16) & 0x1f0000ff0000ffULL;
+  v = (v | v << 8) & 0x100f00f00f00f00fULL;
+  v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+  v = (v | v << 2) & 0x1249249249249249ULL;
+  return v;
+}
+
+/* Morton (Z-order) code of (x, y, z) in the box [lo, hi]
+     Each dimension is quantized to 2^21 cells, points outside the box are clamped
+*/
+KOKKOS_INLINE_FUNCTION long mortonCode3(double x, double y, double z,
+                                        const double* lo, const double* hi) {
+  const double p[3] = {x, y, z};
+  unsigned long long code = 0;
+  for (int i = 0; i < 3; ++i) {
+    const double range = hi[i] - lo[i];
+    double t = range > 0 ? (p[i] - lo[i]) / range : 0;
+    t = t < 0 ? 0 : (t > 1 ? 1 : t);
+    const unsigned long long cell = t * 0x1fffff;
+    code |= spreadBits3(cell) << i;
+  }
+  return code;
+}
+
+template <class Compute, class Storage, typename Device>
+struct CopyViewToView<Compact<Compute, Storage>, Device> {
+  typedef Kokkos::View<StorageType<Compact<Compute, Storage> >*, Device> View;
+  KOKKOS_INLINE_FUNCTION CopyViewToView(View dst, int dst_index, View src, int src_index) {
+    CopyViewToView<StorageType<Compact<Compute, Storage> >, Device>(dst, dst_index,
+                                                                    src, src_index);
+  }
+};
+
+/* Copies one entry of a view to/from a flat array of its base type
+     Used to pack member views into contiguous byte buffers for communication
+*/
+template <class T, typename Device> struct PackEntry {
+  KOKKOS_INLINE_FUNCTION static void pack(T* dst, Kokkos::View<T*, Device> src, int src_index) {
+    dst[0] = src(src_index);
+  }
+  KOKKOS_INLINE_FUNCTION static void unpack(Kokkos::View<T*, Device> dst, int dst_index,
+                                            const T* src) {
+    dst(dst_index) = src[0];
+  }
+};
+template <class T, typename Device, int N> struct PackEntry<T[N], Device> {
+  KOKKOS_INLINE_FUNCTION static void pack(T* dst, Kokkos::View<T*[N], Device> src,
+                                          int src_index) {
+    for (int i = 0; i < N; ++i)
+      dst[i] = src(src_index, i);
+  }
+  KOKKOS_INLINE_FUNCTION static void unpack(Kokkos::View<T*[N], Device> dst, int dst_index,
+                                            const T* src) {
+    for (int i = 0; i < N; ++i)
+      dst(dst_index, i) = src[i];
+  }
+};
+template <class T, typename Device, int N, int M> struct PackEntry<T[N][M], Device> {
+  KOKKOS_INLINE_FUNCTION static void pack(T* dst, Kokkos::View<T*[N][M], Device> src,
+                                          int src_index) {
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < M; ++j)
+        dst[i * M + j] = src(src_index, i, j);
+  }
+  KOKKOS_INLINE_FUNCTION static void unpack(Kokkos::View<T*[N][M], Device> dst, int dst_index,
+                                            const T* src) {
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < M; ++j)
+        dst(dst_index, i, j) = src[i * M + j];
+  }
+};
+template <class T, typename Device, int N, int M, int P> struct PackEntry<T[N][M][P], Device> {
+  KOKKOS_INLINE_FUNCTION static void pack(T* dst, Kokkos::View<T*[N][M][P], Device> src,
+                                          int src_index) {
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < M; ++j)
+        for (int k = 0; k < P; ++k)
+          dst[(i * M + j) * P + k] = src(src_index, i, j, k);
+  }
+  KOKKOS_INLINE_FUNCTION static void unpack(Kokkos::View<T*[N][M][P], Device> dst,
+                                            int dst_index, const T* src) {
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < M; ++j)
+        for (int k = 0; k < P; ++k)
+          dst(dst_index, i, j, k) = src[(i * M + j) * P + k];
+  }
+};
+
+//Compact members are packed in their storage form
+template <class Compute, class Storage, typename Device>
+struct PackEntry<Compact<Compute, Storage>, Device> {
+  typedef StorageType<Compact<Compute, Storage> > S;
+  typedef typename BaseType<S>::type B;
+  KOKKOS_INLINE_FUNCTION static void pack(B* dst, Kokkos::View<S*, Device> src, int src_index) {
+    PackEntry<S, Device>::pack(dst, src, src_index);
+  }
+  KOKKOS_INLINE_FUNCTION static void unpack(Kokkos::View<S*, Device> dst, int dst_index,
+                                            const B* src) {
+    PackEntry<S, Device>::unpack(dst, dst_index, src);
+  }
+};
+
+/* Entry access of views in any layout, used for members annotated WithLayout
+     The components are visited (and packed) in the order of the default layout
+*/
+template <class S> struct LayoutEntry {
+  template <class Dst, class Src>
+  KOKKOS_INLINE_FUNCTION static void copy(Dst dst, int dst_index, Src src, int src_index) {
+    dst(dst_index) = src(src_index);
+  }
+  template <class B, class Src>
+  KOKKOS_INLINE_FUNCTION static void pack(B* dst, Src src, int src_index) {
+    dst[0] = src(src_index);
+  }
+  template <class Dst, class B>
+  KOKKOS_INLINE_FUNCTION static void unpack(Dst dst, int dst_index, const B* src) {
+    dst(dst_index) = src[0];
+  }
+};
+template <class S, int N> struct LayoutEntry<S[N]> {
+  template <class Dst, class Src>
+  KOKKOS_INLINE_FUNCTION static void copy(Dst dst, int dst_index, Src src, int src_index) {
+    for (int i = 0; i < N; ++i)
+      dst(dst_index, i) = src(src_index, i);
+  }
+  template <class B, class Src>
+  KOKKOS_INLINE_FUNCTION static void pack(B* dst, Src src, int src_index) {
+    for (int i = 0; i < N; ++i)
+      dst[i] = src(src_index, i);
+  }
+  template <class Dst, class B>
+  KOKKOS_INLINE_FUNCTION static void unpack(Dst dst, int dst_index, const B* src) {
+    for (int i = 0; i < N; ++i)
+      dst(dst_index, i) = src[i];
+  }
+};
+template <class S, int N, int M> struct LayoutEntry<S[N][M]> {
+  template <class Dst, class Src>
+  KOKKOS_INLINE_FUNCTION static void copy(Dst dst, int dst_index, Src src, int src_index) {
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < M; ++j)
+        dst(dst_index, i, j) = src(src_index, i, j);
+  }
+  template <class B, class Src>
+  KOKKOS_INLINE_FUNCTION static void pack(B* dst, Src src, int src_index) {
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < M; ++j)
+        dst[i * M + j] = src(src_index, i, j);
+  }
+  template <class Dst, class B>
+  KOKKOS_INLINE_FUNCTION static void unpack(Dst dst, int dst_index, const B* src) {
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < M; ++j)
+        dst(dst_index, i, j) = src[i * M + j];
+  }
+};
+template <class S, int N, int M, int P> struct LayoutEntry<S[N][M][P]> {
+  template <class Dst, class Src>
+  KOKKOS_INLINE_FUNCTION static void copy(Dst dst, int dst_index, Src src, int src_index) {
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < M; ++j)
+        for (int k = 0; k < P; ++k)
+          dst(dst_index, i, j, k) = src(src_index, i, j, k);
+  }
+  template <class B, class Src>
+  KOKKOS_INLINE_FUNCTION static void pack(B* dst, Src src, int src_index) {
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < M; ++j)
+        for (int k = 0; k < P; ++k)
+          dst[(i * M + j) * P + k] = src(src_index, i, j, k);
+  }
+  template <class Dst, class B>
+  KOKKOS_INLINE_FUNCTION static void unpack(Dst dst, int dst_index, const B* src) {
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < M; ++j)
+        for (int k = 0; k < P; ++k)
+          dst(dst_index, i, j, k) = src[(i * M + j) * P + k];
+  }
+};
+
+template <class T, class Layout, typename Device>
+struct CopyViewToView<WithLayout<T, Layout>, Device> {
+  typedef Kokkos::View<StorageType<T>*, Layout, Device> View;
+  KOKKOS_INLINE_FUNCTION CopyViewToView(View dst, int dst_index, View src, int src_index) {
+    LayoutEntry<StorageType<T> >::copy(dst, dst_index, src, src_index);
+  }
+};
+template <class T, class Layout, typename Device>
+struct PackEntry<WithLayout<T, Layout>, Device> {
+  typedef Kokkos::View<StorageType<T>*, Layout, Device> View;
+  typedef typename BaseType<T>::type B;
+  KOKKOS_INLINE_FUNCTION static void pack(B* dst, View src, int src_index) {
+    LayoutEntry<StorageType<T> >::pack(dst, src, src_index);
+  }
+  KOKKOS_INLINE_FUNCTION static void unpack(View dst, int dst_index, const B* src) {
+    LayoutEntry<StorageType<T> >::unpack(dst, dst_index, src);
+  }
+};
+
   template <typename T> struct Subview {
     template <typename View>
     static View subview(View view, int start, int size) {
       View new_view("subview", size);
-      Kokkos::parallel_for(size, KOKKOS_LAMBDA(const int& i) {
+      Kokkos::parallel_for("ps_subview", size, KOKKOS_LAMBDA(const int& i) {
         new_view(i) = view(start + i);
       });
       return new_view;
@@ -77,7 +301,7 @@ template <class T, typename Device, int N, int M, int P>
     template <typename View>
     static View subview(View view, int start, int size) {
       View new_view("subview", size);
-      Kokkos::parallel_for(size, KOKKOS_LAMBDA(const int& i) {
+      Kokkos::parallel_for("ps_subview", size, KOKKOS_LAMBDA(const int& i) {
         for (int j = 0; j < N; ++j)
           new_view(i,j) = view(start + i,j);
       });
@@ -89,7 +313,7 @@ template <class T, typename Device, int N, int M, int P>
     template <typename View>
     static View subview(View view, int start, int size) {
       View new_view("subview", size);
-      Kokkos::parallel_for(size, KOKKOS_LAMBDA(const int& i) {
+      Kokkos::parallel_for("ps_subview", size, KOKKOS_LAMBDA(const int& i) {
         for (int j = 0; j < N; ++j)
           for (int k = 0; k < M; ++k)
             new_view(i,j,k) = view(start + i,j,k);
@@ -102,7 +326,7 @@ template <class T, typename Device, int N, int M, int P>
     template <typename View>
     static View subview(View view, int start, int size) {
       View new_view("subview", size);
-      Kokkos::parallel_for(size, KOKKOS_LAMBDA(const int& i) {
+      Kokkos::parallel_for("ps_subview", size, KOKKOS_LAMBDA(const int& i) {
         for (int j = 0; j < N; ++j)
           for (int k = 0; k < M; ++k)
             for (int l = 0; l < P; ++l)
@@ -4,6 +4,7 @@
 #include "SupportKK.h"
 #include "MemberTypes.h"
 #include <unordered_map>
+#include <functional>
 #include <mpi.h>
 namespace particle_structs {
   template <typename T> struct MpiType;
@@ -41,6 +42,17 @@ namespace particle_structs {
      MPI_Waitany
    */
 
+  //Runs and removes the callbacks of completed requests that were added to get_map()
+  inline void PS_Comm_Complete(int num_reqs, MPI_Request* reqs) {
+    for (int i = 0; i < num_reqs; ++i) {
+      Irecv_Map::iterator itr = get_map().find(reqs + i);
+      if (itr != get_map().end()) {
+        (itr->second)();
+        get_map().erase(itr);
+      }
+    }
+  }
+
   /************** Host Communication functions **************/
   template <typename Device> using IsHost =
     typename std::enable_if<std::is_same<typename Device::memory_space, Kokkos::HostSpace>::value, int>::type;
@@ -79,7 +91,9 @@ namespace particle_structs {
   //Waitall
   template <typename Device>
   IsHost<Device> PS_Comm_Waitall(int num_reqs, MPI_Request* reqs, MPI_Status* stats) {
-    return MPI_Waitall(num_reqs, reqs, stats);
+    int ret = MPI_Waitall(num_reqs, reqs, stats);
+    PS_Comm_Complete(num_reqs, reqs);
+    return ret;
   }
   //Alltoall
   template <typename T, typename Device>
@@ -89,6 +103,14 @@ namespace particle_structs {
     return MPI_Alltoall(send.data(), send_size, MpiType<BT<T> >::mpitype(),
                         recv.data(), recv_size, MpiType<BT<T> >::mpitype(), comm);
   }
+  //Neighbor Alltoall over a distributed graph communicator
+  template <typename T, typename Device>
+  IsHost<Device> PS_Comm_Neighbor_alltoall(Kokkos::View<T*, Device> send, int send_size,
+                                           Kokkos::View<T*, Device> recv, int recv_size,
+                                           MPI_Comm comm) {
+    return MPI_Neighbor_alltoall(send.data(), send_size, MpiType<BT<T> >::mpitype(),
+                                 recv.data(), recv_size, MpiType<BT<T> >::mpitype(), comm);
+  }
 
   /************** Cuda Communication functions **************/
 #ifdef PS_USE_CUDA
@@ -133,7 +155,7 @@ namespace particle_structs {
     //Copy received values to device and move it to the proper indices of the view
     Kokkos::deep_copy(new_view, view_host);
 #endif
-    Kokkos::parallel_for(size, KOKKOS_LAMBDA(const int& i) {
+    Kokkos::parallel_for("ps_recv_view", size, KOKKOS_LAMBDA(const int& i) {
       CopyViewToView<T, Device>(view,i+offset, new_view, i);
     });
     return ret;
@@ -178,7 +200,7 @@ namespace particle_structs {
 #ifndef PS_CUDA_AWARE_MPI
       Kokkos::deep_copy(new_view, view_host);
 #endif
-      Kokkos::parallel_for(size, KOKKOS_LAMBDA(const int& i) {
+      Kokkos::parallel_for("ps_recv_view", size, KOKKOS_LAMBDA(const int& i) {
         CopyViewToView<T, Device>(view,i+offset, new_view, i);
       });
     };
@@ -189,20 +211,9 @@ namespace particle_structs {
   //Waitall
   template <typename Device>
   IsCuda<Device> PS_Comm_Waitall(int num_reqs, MPI_Request* reqs, MPI_Status* stats) {
-#ifdef PS_CUDA_AWARE_MPI
-    return MPI_Waitall(num_reqs, reqs, stats);
-#else
     int ret = MPI_Waitall(num_reqs, reqs, stats);
-    for (int i = 0; i < num_reqs; ++i) {
-      Irecv_Map::iterator itr = get_map().find(reqs + i);
-      if (itr != get_map().end()) {
-        (itr->second)();
-        get_map().erase(itr);
-      }
-    }
+    PS_Comm_Complete(num_reqs, reqs);
     return ret;
-#endif
-
   }
 
   //Alltoall
@@ -223,8 +234,95 @@ namespace particle_structs {
 #endif
   }
 
+  //Neighbor Alltoall over a distributed graph communicator
+  template <typename T, typename Device>
+  IsCuda<Device> PS_Comm_Neighbor_alltoall(Kokkos::View<T*, Device> send, int send_size,
+                                           Kokkos::View<T*, Device> recv, int recv_size,
+                                           MPI_Comm comm) {
+#ifdef PS_CUDA_AWARE_MPI
+    return MPI_Neighbor_alltoall(send.data(), send_size, MpiType<BT<T> >::mpitype(),
+                                 recv.data(), recv_size, MpiType<BT<T> >::mpitype(), comm);
+#else
+    typename Kokkos::View<T*, Device>::HostMirror send_host = deviceToHost(send);
+    typename Kokkos::View<T*, Device>::HostMirror recv_host = Kokkos::create_mirror_view(recv);
+    int ret = MPI_Neighbor_alltoall(send_host.data(), send_size, MpiType<BT<T> >::mpitype(),
+                                    recv_host.data(), recv_size, MpiType<BT<T> >::mpitype(),
+                                    comm);
+    Kokkos::deep_copy(recv, recv_host);
+    return ret;
 #endif
+  }
 
+#endif
 
+  /************** Communication of views in an explicit layout **************/
+  /* Views of WithLayout members do not hold the entries of a particle contiguously
+       The entries are sent from and received into a view in the default layout, the
+       copy is kept (and for receives moved into the view) when PS_Comm_Waitall completes
+  */
+  //Isend
+  template <typename T, typename Layout, typename Device>
+  int PS_Comm_Isend(Kokkos::View<T*, Layout, Device> view, int offset, int size,
+                    int dest, int tag, MPI_Comm comm, MPI_Request* req) {
+    typedef typename Device::execution_space ExecSpace;
+    Kokkos::View<T*, Device> entries("layout_isend_view", size);
+    Kokkos::parallel_for("ps_layout_send_view", Kokkos::RangePolicy<ExecSpace>(0, size),
+                         KOKKOS_LAMBDA(const int& i) {
+      LayoutEntry<T>::copy(entries, i, view, i + offset);
+    });
+    Kokkos::fence();
+    int ret = PS_Comm_Isend(entries, 0, size, dest, tag, comm, req);
+    std::function<void()> staged;
+    Irecv_Map::iterator itr = get_map().find(req);
+    if (itr != get_map().end())
+      staged = itr->second;
+    //Noop (after any staging callback) that keeps the entries until the send completes
+    get_map()[req] = [=]() {
+      if (staged)
+        staged();
+      (void)entries;
+    };
+    return ret;
+  }
+  //Irecv
+  template <typename T, typename Layout, typename Device>
+  int PS_Comm_Irecv(Kokkos::View<T*, Layout, Device> view, int offset, int size,
+                    int sender, int tag, MPI_Comm comm, MPI_Request* req) {
+    typedef typename Device::execution_space ExecSpace;
+    Kokkos::View<T*, Device> entries("layout_irecv_view", size);
+    int ret = PS_Comm_Irecv(entries, 0, size, sender, tag, comm, req);
+    std::function<void()> staged;
+    Irecv_Map::iterator itr = get_map().find(req);
+    if (itr != get_map().end())
+      staged = itr->second;
+    get_map()[req] = [=]() {
+      if (staged)
+        staged();
+      Kokkos::parallel_for("ps_layout_recv_view", Kokkos::RangePolicy<ExecSpace>(0, size),
+                           KOKKOS_LAMBDA(const int& i) {
+        LayoutEntry<T>::copy(view, i + offset, entries, i);
+      });
+    };
+    return ret;
+  }
+
+  /* Host memory used to stage device buffers for MPI that can not read device memory
+       Pinned on CUDA so the copies run asynchronously at full bandwidth
+  */
+#ifdef PS_USE_CUDA
+  typedef Kokkos::CudaHostPinnedSpace StagingSpace;
+#else
+  typedef Kokkos::HostSpace StagingSpace;
+#endif
+  typedef Kokkos::Device<Kokkos::DefaultHostExecutionSpace, StagingSpace> StagingDevice;
+  //True if messages of views on Device must be staged through host memory
+  template <typename Device> struct NeedsStaging {
+#if defined(PS_USE_CUDA) && !defined(PS_CUDA_AWARE_MPI)
+    static constexpr bool value =
+      !std::is_same<typename Device::memory_space, Kokkos::HostSpace>::value;
+#else
+    static constexpr bool value = false;
+#endif
+  };
 
 }
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <Kokkos_Core.hpp>
+
+#include <MemberTypes.h>
+#include <MemberTypeAoSoA.h>
+#include <SellCSigma.h>
+
+#include <psAssert.h>
+#include "Distribute.h"
+
+using particle_structs::SellCSigma;
+using particle_structs::MemberTypes;
+using particle_structs::MemberTypeAoSoA;
+using particle_structs::distribute_particles;
+
+typedef MemberTypes<int, double[3], char> Type;
+typedef Kokkos::DefaultExecutionSpace exe_space;
+typedef SellCSigma<Type,exe_space> SCS;
+
+int main(int argc, char* argv[]) {
+  MPI_Init(&argc, &argv);
+  Kokkos::initialize(argc, argv);
+
+  //Tile layout offsets
+  typedef MemberTypeAoSoA<Type, 32, SCS::device_type> AoSoA;
+  PS_ALWAYS_ASSERT(AoSoA::tile_bytes == 32 * (sizeof(int) + 3 * sizeof(double) + sizeof(char)));
+  PS_ALWAYS_ASSERT((particle_structs::AoSoAOffset<1, 32, int, double[3], char>::value ==
+                    32 * sizeof(int)));
+  PS_ALWAYS_ASSERT((particle_structs::AoSoAOffset<2, 32, int, double[3], char>::value ==
+                    32 * (sizeof(int) + 3 * sizeof(double))));
+
+  int ne = 5;
+  int np = 100;
+  int* ptcls_per_elem = new int[ne];
+  std::vector<int>* ids = new std::vector<int>[ne];
+  distribute_particles(ne, np, 0, ptcls_per_elem, ids);
+  Kokkos::TeamPolicy<exe_space> po(4, 32);
+  int fails = 0;
+  {
+    SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+    SCS::kkGidView element_gids_v("", 0);
+    particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+
+    SCS* scs = new SCS(po, 5, 2, ne, np, ptcls_per_elem_v, element_gids_v);
+    delete [] ptcls_per_elem;
+    delete [] ids;
+
+    auto ids_scs = scs->get<0>();
+    auto vec_scs = scs->get<1>();
+    auto setValues = PS_LAMBDA(const int& eid, const int& pid, const int& mask) {
+      ids_scs(pid) = pid;
+      for (int i = 0; i < 3; ++i)
+        vec_scs(pid, i) = pid * 3 + i;
+    };
+    scs->parallel_for(setValues);
+
+    //Copy into tiles and check the values through the AoSoA accessors
+    AoSoA aosoa = scs->copyToAoSoA<32>();
+    auto ids_tile = aosoa.get<0>();
+    auto vec_tile = aosoa.get<1>();
+    Kokkos::View<int*> failures("failures", 1);
+    auto checkAndUpdate = PS_LAMBDA(const int& eid, const int& pid, const int& mask) {
+      bool bad = ids_tile(pid) != pid;
+      for (int i = 0; i < 3; ++i)
+        bad |= vec_tile(pid, i) != pid * 3 + i;
+      Kokkos::atomic_fetch_add(&failures(0), (int)bad);
+      ids_tile(pid) = -pid;
+    };
+    scs->parallel_for(checkAndUpdate);
+    fails += particle_structs::getLastValue<int>(failures);
+
+    //Copy back and check the structure sees the updated values
+    scs->copyFromAoSoA(aosoa);
+    Kokkos::deep_copy(failures, 0);
+    auto checkCopyBack = PS_LAMBDA(const int& eid, const int& pid, const int& mask) {
+      Kokkos::atomic_fetch_add(&failures(0), (int)(ids_scs(pid) != -pid));
+    };
+    scs->parallel_for(checkCopyBack);
+    fails += particle_structs::getLastValue<int>(failures);
+
+    delete scs;
+  }
+  Kokkos::finalize();
+  MPI_Finalize();
+  if (fails == 0)
+    printf("All tests passed\n");
+  else
+    printf("%d tests failed\n", fails);
+  return fails;
+}
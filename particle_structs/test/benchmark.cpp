@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <climits>
+#include <string>
+#include <vector>
+#include <Kokkos_Core.hpp>
+
+#include <MemberTypes.h>
+#include <SellCSigma.h>
+
+#include <psAssert.h>
+#include "Distribute.h"
+
+/* Benchmark of the particle structure operations
+
+   Times construction, parallel_for, reshuffle, rebuild and migrate for every combination of
+   the swept parameters and writes particles/second of each operation as JSON.
+   parallel_for is timed with the team loop and with the column wise loop (host backends).
+
+   Usage: ./scs_benchmark [-e elements,...] [-p particles,...] [-d distributions,...]
+                          [-C C,...] [-s sigma,...] [-V V,...] [-r repetitions] [-o file.json]
+     Element and particle counts are per rank, distributions are those of Distribute.cpp
+*/
+
+using particle_structs::SellCSigma;
+using particle_structs::MemberTypes;
+using particle_structs::distribute_particles;
+using particle_structs::distribute_name;
+using particle_structs::lid_t;
+
+typedef Kokkos::DefaultExecutionSpace exe_space;
+typedef MemberTypes<int, double[3]> Type;
+typedef SellCSigma<Type> SCS;
+
+namespace {
+  std::vector<int> parseList(const char* arg) {
+    std::vector<int> values;
+    std::string list(arg);
+    std::size_t start = 0;
+    while (start <= list.size()) {
+      std::size_t end = list.find(',', start);
+      if (end == std::string::npos)
+        end = list.size();
+      if (end > start)
+        values.push_back(atoi(list.substr(start, end - start).c_str()));
+      start = end + 1;
+    }
+    return values;
+  }
+
+  //Slowest rank's time of an operation
+  double maxTime(double seconds) {
+    double max;
+    MPI_Allreduce(&seconds, &max, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    return max;
+  }
+
+  struct Result {
+    int ne, np, dist, C, sigma, V;
+    double construct, parallel_for, parallel_for_columns, reshuffle, rebuild, migrate;
+  };
+
+  //Moves every tenth particle to the next element
+  void setNewElements(SCS* scs, SCS::kkLidView new_element, int ne) {
+    auto setElements = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+      new_element(ptcl_id) = mask ? (ptcl_id % 10 == 0 ? (elm_id + 1) % ne : elm_id) : -1;
+    };
+    scs->parallel_for(setElements, "benchmark_new_elements");
+  }
+
+  Result runCase(int ne, int np, int dist, int C, int sigma, int V, int reps) {
+    int comm_rank, comm_size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+    Result result = {ne, np, dist, C, sigma, V, 0, 0, 0, 0, 0, 0};
+    int* ptcls_per_elem = new int[ne];
+    std::vector<int>* ids = new std::vector<int>[ne];
+    distribute_particles(ne, np, dist, ptcls_per_elem, ids);
+    delete [] ids;
+    SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+    SCS::kkGidView element_gids_v("element_gids_v", ne);
+    particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+    delete [] ptcls_per_elem;
+    //Every rank holds a copy of the same element gids so particles can migrate anywhere
+    Kokkos::parallel_for(ne, KOKKOS_LAMBDA(const int& i) {
+      element_gids_v(i) = i;
+    });
+
+    Kokkos::TeamPolicy<exe_space> policy(128, C);
+    MPI_Barrier(MPI_COMM_WORLD);
+    Kokkos::Timer timer;
+    SCS* scs = new SCS(policy, sigma, V, ne, np, ptcls_per_elem_v, element_gids_v);
+    Kokkos::fence();
+    result.construct = maxTime(timer.seconds());
+
+    //parallel_for throughput with a push like kernel
+    auto ids_scs = scs->get<0>();
+    auto pos = scs->get<1>();
+    auto push = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+      if (mask) {
+        ids_scs(ptcl_id) = elm_id;
+        for (int i = 0; i < 3; ++i)
+          pos(ptcl_id, i) += 0.5 * i;
+      }
+    };
+    timer.reset();
+    for (int i = 0; i < reps; ++i)
+      scs->parallel_for(push, "benchmark_push");
+    Kokkos::fence();
+    result.parallel_for = maxTime(timer.seconds()) / reps;
+    scs->setColumnWise(true);
+    timer.reset();
+    for (int i = 0; i < reps; ++i)
+      scs->parallel_for(push, "benchmark_push_columns");
+    Kokkos::fence();
+    result.parallel_for_columns = maxTime(timer.seconds()) / reps;
+    scs->setColumnWise(false);
+
+    //Reshuffle and rebuild moving 10% of the particles
+    SCS::kkLidView new_element("new_element", scs->capacity());
+    setNewElements(scs, new_element, ne);
+    timer.reset();
+    scs->reshuffle(new_element);
+    Kokkos::fence();
+    result.reshuffle = maxTime(timer.seconds());
+
+    new_element = SCS::kkLidView("new_element", scs->capacity());
+    setNewElements(scs, new_element, ne);
+    scs->setShuffling(false);
+    timer.reset();
+    scs->rebuild(new_element);
+    Kokkos::fence();
+    result.rebuild = maxTime(timer.seconds());
+    scs->setShuffling(true);
+
+    //Migrate 10% of the particles to the next rank
+    new_element = SCS::kkLidView("new_element", scs->capacity());
+    SCS::kkLidView new_process("new_process", scs->capacity());
+    auto setProcess = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+      new_element(ptcl_id) = mask ? elm_id : -1;
+      new_process(ptcl_id) = ptcl_id % 10 == 0 ? (comm_rank + 1) % comm_size : comm_rank;
+    };
+    scs->parallel_for(setProcess, "benchmark_new_process");
+    timer.reset();
+    scs->migrate(new_element, new_process);
+    Kokkos::fence();
+    result.migrate = maxTime(timer.seconds());
+    delete scs;
+    return result;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  MPI_Init(&argc, &argv);
+  Kokkos::initialize(argc, argv);
+  int comm_rank, comm_size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+
+  std::vector<int> elements(1, 1000), particles(1, 100000), dists(1, 1);
+  std::vector<int> Cs(1, 32), sigmas(1, INT_MAX), Vs(1, 32);
+  int reps = 10;
+  std::string output = "scs_benchmark.json";
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "-e")) elements = parseList(argv[i+1]);
+    else if (!strcmp(argv[i], "-p")) particles = parseList(argv[i+1]);
+    else if (!strcmp(argv[i], "-d")) dists = parseList(argv[i+1]);
+    else if (!strcmp(argv[i], "-C")) Cs = parseList(argv[i+1]);
+    else if (!strcmp(argv[i], "-s")) sigmas = parseList(argv[i+1]);
+    else if (!strcmp(argv[i], "-V")) Vs = parseList(argv[i+1]);
+    else if (!strcmp(argv[i], "-r")) reps = atoi(argv[i+1]);
+    else if (!strcmp(argv[i], "-o")) output = argv[i+1];
+    else if (!comm_rank)
+      fprintf(stderr, "Unknown argument %s\n", argv[i]);
+  }
+  particle_structs::setTimePrints(false);
+
+  std::vector<Result> results;
+  for (std::size_t e = 0; e < elements.size(); ++e)
+    for (std::size_t p = 0; p < particles.size(); ++p)
+      for (std::size_t d = 0; d < dists.size(); ++d)
+        for (std::size_t c = 0; c < Cs.size(); ++c)
+          for (std::size_t s = 0; s < sigmas.size(); ++s)
+            for (std::size_t v = 0; v < Vs.size(); ++v) {
+              results.push_back(runCase(elements[e], particles[p], dists[d], Cs[c], sigmas[s],
+                                        Vs[v], reps));
+              const Result& r = results.back();
+              if (!comm_rank)
+                printf("ne %d np %d dist %s C %d sigma %d V %d: construct %f parallel_for %f "
+                       "(columns %f, speedup %.2f) reshuffle %f rebuild %f migrate %f "
+                       "(seconds)\n", r.ne, r.np, distribute_name(r.dist), r.C, r.sigma, r.V,
+                       r.construct, r.parallel_for, r.parallel_for_columns,
+                       r.parallel_for / r.parallel_for_columns, r.reshuffle, r.rebuild,
+                       r.migrate);
+            }
+
+  //Particles per second of each operation over all ranks
+  if (!comm_rank) {
+    FILE* out = fopen(output.c_str(), "w");
+    PS_ALWAYS_ASSERT(out != NULL);
+    fprintf(out, "{\n  \"ranks\": %d,\n  \"repetitions\": %d,\n  \"results\": [", comm_size, reps);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+      const Result& r = results[i];
+      const double np = (double)r.np * comm_size;
+      fprintf(out, "%s\n    {\"elements\": %d, \"particles\": %d, \"distribution\": \"%s\", "
+              "\"C\": %d, \"sigma\": %d, \"V\": %d, \"particles_per_second\": {"
+              "\"construct\": %g, \"parallel_for\": %g, \"parallel_for_columns\": %g, "
+              "\"reshuffle\": %g, \"rebuild\": %g, \"migrate\": %g}}", i ? "," : "", r.ne,
+              r.np, distribute_name(r.dist), r.C, r.sigma, r.V, np / r.construct,
+              np / r.parallel_for, np / r.parallel_for_columns, np / r.reshuffle,
+              np / r.rebuild, np / r.migrate);
+    }
+    fprintf(out, "\n  ]\n}\n");
+    fclose(out);
+  }
+  Kokkos::finalize();
+  MPI_Finalize();
+  return 0;
+}
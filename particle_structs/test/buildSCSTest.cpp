@@ -1,4 +1,7 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
 #include <Kokkos_Core.hpp>
 
 #include <MemberTypes.h>
@@ -20,6 +23,7 @@ typedef SellCSigma<Type,exe_space> SCS;
 bool defaultTest(int ne, int np, SCS::kkLidView ptcls_per_elem, SCS::kkGidView element_gids);
 bool noSortTest(int ne, int np, SCS::kkLidView ptcls_per_elem, SCS::kkGidView element_gids);
 bool largeCTest(int ne, int np, SCS::kkLidView ptcls_per_elem, SCS::kkGidView element_gids);
+bool checkpointTest(int ne, int np, SCS::kkLidView ptcls_per_elem, SCS::kkGidView element_gids);
 
 int main(int argc, char* argv[]) {
   MPI_Init(&argc, &argv);
@@ -40,6 +44,7 @@ int main(int argc, char* argv[]) {
     success &= defaultTest(ne, np, ptcls_per_elem_v, element_gids_v);
     success &= noSortTest(ne, np, ptcls_per_elem_v, element_gids_v);
     success &= largeCTest(ne, np, ptcls_per_elem_v, element_gids_v);
+    success &= checkpointTest(ne, np, ptcls_per_elem_v, element_gids_v);
   }
   Kokkos::finalize();
   MPI_Finalize();
@@ -131,3 +136,43 @@ bool largeCTest(int ne, int np, SCS::kkLidView ptcls_per_elem, SCS::kkGidView el
   delete scs;
   return f == 0;
 }
+
+bool checkpointTest(int ne, int np, SCS::kkLidView ptcls_per_elem, SCS::kkGidView element_gids) {
+  printf("\nBeginning Checkpoint Test\n");
+  Kokkos::TeamPolicy<exe_space> po(4, 4);
+  SCS* scs = new SCS(po, INT_MAX, 2, ne, np, ptcls_per_elem, element_gids);
+  auto values = scs->get<0>();
+  auto setValues = PS_LAMBDA(const int& eid, const int& pid, const int& mask) {
+    values(pid) = mask ? eid * 1000 + pid : -1;
+  };
+  scs->parallel_for(setValues);
+  //Every rank writes the same file, name it after the process id of rank 0
+  int comm_rank, pid = getpid();
+  MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+  MPI_Bcast(&pid, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  const char* tmp_dir = getenv("TMPDIR");
+  const std::string path = std::string(tmp_dir ? tmp_dir : "/tmp") + "/buildSCSTest_" +
+    std::to_string(pid) + ".ckpt";
+  scs->writeCheckpoint(path);
+
+  //The restored structure must have the same layout and values
+  SCS* restored = new SCS(po, path);
+  bool success = restored->nPtcls() == scs->nPtcls() && restored->capacity() == scs->capacity() &&
+    restored->nElems() == scs->nElems() && restored->C() == scs->C();
+  auto restored_values = restored->get<0>();
+  SCS::kkLidView fail("fail", 1);
+  auto check = PS_LAMBDA(const int& eid, const int& pid, const int& mask) {
+    if (mask && restored_values(pid) != eid * 1000 + pid)
+      fail(0) = 1;
+  };
+  restored->parallel_for(check);
+  success &= particle_structs::getLastValue<particle_structs::lid_t>(fail) == 0;
+  if (!success)
+    printf("[ERROR] Restored structure does not match the checkpoint\n");
+  delete restored;
+  delete scs;
+  MPI_Barrier(MPI_COMM_WORLD);
+  if (comm_rank == 0)
+    remove(path.c_str());
+  return success;
+}
@@ -5,6 +5,7 @@
 #include <SellCSigma.h>
 
 #include <psAssert.h>
+#include <DeviceDistribute.h>
 #include "Distribute.h"
 
 using particle_structs::SellCSigma;
@@ -17,6 +18,9 @@ typedef MemberTypes<int> Type;
 typedef Kokkos::DefaultExecutionSpace exe_space;
 typedef SellCSigma<Type,exe_space> SCS;
 
+int testDeviceDistribution(int strat);
+int testUnsortedConstruction();
+
 int main(int argc, char* argv[]) {
   MPI_Init(&argc, &argv);
   Kokkos::initialize(argc, argv);
@@ -65,9 +69,93 @@ int main(int argc, char* argv[]) {
     particle_structs::destroyViews<Type>(particle_info);
 
   }
+  for (int strat = particle_structs::DIST_EVEN; strat <= particle_structs::DIST_WEIGHTED; ++strat)
+    f += testDeviceDistribution(strat);
+  f += testUnsortedConstruction();
   Kokkos::finalize();
   MPI_Finalize();
   if (!f)
     printf("All tests passed\n");
   return f;
 }
+
+//The counts match the elements, the same seed gives the same particles and zero weights get none
+int testDeviceDistribution(int strat) {
+  typedef SCS::kkLidView kkLidView;
+  const int ne = 7;
+  const int np = 2000;
+  kkLidView ptcls_per_elem("ptcls_per_elem", ne);
+  kkLidView particle_elements("particle_elements", np);
+  kkLidView ptcls_per_elem2("ptcls_per_elem2", ne);
+  kkLidView particle_elements2("particle_elements2", np);
+  Kokkos::View<double*, SCS::device_type> weights("weights", ne);
+  Kokkos::parallel_for(ne, KOKKOS_LAMBDA(const int& i) {
+    weights(i) = i == 2 ? 0 : i + 1;
+  });
+  if (!particle_structs::distributeParticles(ne, np, strat, 42, 3, ptcls_per_elem,
+                                             particle_elements, weights) ||
+      !particle_structs::distributeParticles(ne, np, strat, 42, 3, ptcls_per_elem2,
+                                             particle_elements2, weights)) {
+    printf("[ERROR] Device distribution %d failed\n", strat);
+    return 1;
+  }
+  kkLidView counts("counts", ne);
+  kkLidView fail("fail", 1);
+  Kokkos::parallel_for(np, KOKKOS_LAMBDA(const int& i) {
+    const int elem = particle_elements(i);
+    if (elem < 0 || elem >= ne || elem != particle_elements2(i))
+      fail(0) = 1;
+    else
+      Kokkos::atomic_fetch_add(&(counts(elem)), 1);
+  });
+  Kokkos::parallel_for(ne, KOKKOS_LAMBDA(const int& i) {
+    if (counts(i) != ptcls_per_elem(i) ||
+        (strat == particle_structs::DIST_WEIGHTED && i == 2 && counts(i) != 0))
+      fail(0) = 1;
+  });
+  if (particle_structs::getLastValue<particle_structs::lid_t>(fail)) {
+    printf("[ERROR] Device distribution %d is not consistent\n", strat);
+    return 1;
+  }
+  return 0;
+}
+
+//Particles given in no particular order are counted and placed by the structure
+int testUnsortedConstruction() {
+  const int ne = 11;
+  const int np = 500;
+  SCS::kkLidView particle_element("particle_element", np);
+  auto particle_info = particle_structs::createMemberViews<Type>(np);
+  auto elem_info = particle_structs::getMemberView<Type, 0>(particle_info);
+  Kokkos::parallel_for(np, KOKKOS_LAMBDA(const int& i) {
+    particle_element(i) = (i * 7) % ne;
+    elem_info(i) = (i * 7) % ne;
+  });
+  SCS::kkGidView element_gids_v("", 0);
+  Kokkos::TeamPolicy<exe_space> po(4, 4);
+  SCS* scs = new SCS(po, INT_MAX, 2, ne, element_gids_v, particle_element, particle_info);
+  particle_structs::destroyViews<Type>(particle_info);
+  int f = 0;
+  if (scs->nPtcls() != np) {
+    printf("[ERROR] Unsorted construction has %d particles instead of %d\n", scs->nPtcls(), np);
+    f = 1;
+  }
+  SCS::kkLidView fail("fail", 1);
+  SCS::kkLidView count("count", 1);
+  auto elem_scs = scs->get<0>();
+  auto check = PS_LAMBDA(const int eid, const int pid, const bool mask) {
+    if (mask) {
+      Kokkos::atomic_fetch_add(&(count(0)), 1);
+      if (eid != elem_scs(pid))
+        fail(0) = 1;
+    }
+  };
+  scs->parallel_for(check);
+  if (particle_structs::getLastValue<particle_structs::lid_t>(fail) ||
+      particle_structs::getLastValue<particle_structs::lid_t>(count) != np) {
+    printf("[ERROR] Unsorted construction placed particles in the wrong elements\n");
+    f = 1;
+  }
+  delete scs;
+  return f;
+}
@@ -27,6 +27,7 @@ int main(int argc, char* argv[]) {
   std::vector<int>* ids = new std::vector<int>[ne];
   distribute_particles(ne, np, 0, ptcls_per_elem, ids);
   Kokkos::TeamPolicy<exe_space> po(4, 32);
+  int fails = 0;
   {
     SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
     SCS::kkGidView element_gids_v("", 0);
@@ -44,10 +45,141 @@ int main(int argc, char* argv[]) {
 
     scs->parallel_for(lamb);
 
+    //Count the particles of each element with one team per element through team scratch
+    Kokkos::View<int*> failures("failures", 1);
+    auto countElement = PS_LAMBDA(const SCS::TeamMember& team, const int& eid,
+                                  const SCS::RowParticles& row) {
+      int* count = (int*)team.team_shmem().get_shmem(sizeof(int));
+      Kokkos::single(Kokkos::PerTeam(team), [=]() {
+        *count = 0;
+      });
+      team.team_barrier();
+      Kokkos::parallel_for(Kokkos::TeamThreadRange(team, row.size()), [=](const int& i) {
+        if (row.mask(i))
+          Kokkos::atomic_fetch_add(count, 1);
+      });
+      team.team_barrier();
+      Kokkos::single(Kokkos::PerTeam(team), [=]() {
+        if (eid < ne && *count != ptcls_per_elem_v(eid))
+          Kokkos::atomic_fetch_add(&failures(0), 1);
+      });
+    };
+    scs->parallel_for_elements(countElement, sizeof(int));
+    fails = particle_structs::getLastValue<int>(failures);
+
+    //Element groups hold exactly the particles of the element
+    Kokkos::deep_copy(failures, 0);
+    auto pidElems = scs->get<0>();
+    auto setPidElements = PS_LAMBDA(const int& eid, const int& pid, const int& mask) {
+      pidElems(pid) = mask ? eid : -1;
+    };
+    scs->parallel_for(setPidElements);
+    auto checkGroup = PS_LAMBDA(const SCS::TeamMember& team, const int& eid,
+                                const SCS::ElementGroup& group) {
+      Kokkos::single(Kokkos::PerTeam(team), [=]() {
+        if (eid < ne && group.size() != ptcls_per_elem_v(eid))
+          Kokkos::atomic_fetch_add(&failures(0), 1);
+      });
+      Kokkos::parallel_for(Kokkos::TeamThreadRange(team, group.size()), [=](const int& i) {
+        if (pidElems(group(i)) != eid)
+          Kokkos::atomic_fetch_add(&failures(0), 1);
+      });
+    };
+    scs->parallel_for_element_groups(checkGroup);
+    fails += particle_structs::getLastValue<int>(failures);
+
+    //Every particle is in at most one pair and the pairs share an element
+    Kokkos::deep_copy(failures, 0);
+    Kokkos::View<int*> paired("paired", scs->capacity());
+    auto countPairs = PS_LAMBDA(const int& eid, const int& a, const int& b) {
+      if (a == b || pidElems(a) != eid || pidElems(b) != eid)
+        Kokkos::atomic_fetch_add(&failures(0), 1);
+      Kokkos::atomic_fetch_add(&paired(a), 1);
+      Kokkos::atomic_fetch_add(&paired(b), 1);
+    };
+    scs->parallel_for_pairs(countPairs, true, 7);
+    int num_paired = 0;
+    int expected_paired = 0;
+    Kokkos::parallel_reduce(scs->capacity(), KOKKOS_LAMBDA(const int& i, int& sum) {
+        if (paired(i) > 1)
+          Kokkos::atomic_fetch_add(&failures(0), 1);
+        sum += paired(i);
+      }, num_paired);
+    Kokkos::parallel_reduce(ne, KOKKOS_LAMBDA(const int& i, int& sum) {
+        sum += ptcls_per_elem_v(i) / 2 * 2;
+      }, expected_paired);
+    if (num_paired != expected_paired) {
+      printf("Paired %d particles instead of %d\n", num_paired, expected_paired);
+      ++fails;
+    }
+    fails += particle_structs::getLastValue<int>(failures);
+
+    //A subset loop only visits the particles of the listed elements
+    Kokkos::deep_copy(failures, 0);
+    SCS::kkLidView subset("subset", 2);
+    Kokkos::parallel_for(2, KOKKOS_LAMBDA(const int& i) {
+      subset(i) = 2 * i;
+    });
+    Kokkos::View<int*> subset_ptcls("subset_ptcls", 1);
+    auto countSubset = PS_LAMBDA(const int& eid, const int& pid, const int& mask) {
+      if (eid != 0 && eid != 2)
+        Kokkos::atomic_fetch_add(&failures(0), 1);
+      if (mask)
+        Kokkos::atomic_fetch_add(&subset_ptcls(0), 1);
+    };
+    scs->parallel_for(subset, countSubset);
+    int expected_subset = 0;
+    Kokkos::parallel_reduce(2, KOKKOS_LAMBDA(const int& i, int& sum) {
+        sum += ptcls_per_elem_v(2 * i);
+      }, expected_subset);
+    if (particle_structs::getLastValue<int>(subset_ptcls) != expected_subset) {
+      printf("Subset loop visited %d particles instead of %d\n",
+             particle_structs::getLastValue<int>(subset_ptcls), expected_subset);
+      ++fails;
+    }
+    fails += particle_structs::getLastValue<int>(failures);
+
+    //Only particles are passed to the functor when skipping empty slices and slots
+    scs->setSkipEmpty(true, true);
+    Kokkos::deep_copy(failures, 0);
+    Kokkos::View<int*> calls("calls", 1);
+    auto countCalls = PS_LAMBDA(const int& eid, const int& pid, const int& mask) {
+      Kokkos::atomic_fetch_add(&calls(0), 1);
+      if (!mask)
+        Kokkos::atomic_fetch_add(&failures(0), 1);
+    };
+    scs->parallel_for(countCalls);
+    if (particle_structs::getLastValue<int>(calls) != np) {
+      printf("Functor called %d times for %d particles\n",
+             particle_structs::getLastValue<int>(calls), np);
+      ++fails;
+    }
+    fails += particle_structs::getLastValue<int>(failures);
+
+    //The column wise loop visits the same slots with the same elements
+    scs->setSkipEmpty(false);
+    Kokkos::deep_copy(failures, 0);
+    auto elems = scs->get<0>();
+    auto setElements = PS_LAMBDA(const int& eid, const int& pid, const int& mask) {
+      elems(pid) = eid;
+    };
+    scs->parallel_for(setElements);
+    scs->setColumnWise(true);
+    auto checkElements = PS_LAMBDA(const int& eid, const int& pid, const int& mask) {
+      if (elems(pid) != eid)
+        Kokkos::atomic_fetch_add(&failures(0), 1);
+    };
+    scs->parallel_for(checkElements);
+    scs->setColumnWise(false);
+    fails += particle_structs::getLastValue<int>(failures);
+
     delete scs;
   }
   Kokkos::finalize();
   MPI_Finalize();
-  printf("All tests passed\n");
-  return 0;
+  if (fails == 0)
+    printf("All tests passed\n");
+  else
+    printf("%d tests failed\n", fails);
+  return fails;
 }
@@ -16,8 +16,12 @@ using particle_structs::distribute_elements;
 typedef MemberTypes<int, double[3]> Type;
 typedef Kokkos::DefaultExecutionSpace exe_space;
 typedef SellCSigma<Type, exe_space> SCS;
+typedef MemberTypes<double[2], int> OtherType;
+typedef SellCSigma<OtherType, exe_space> OtherSCS;
 
-bool sendToOne(int ne, int np);
+bool sendToOne(int ne, int np, bool packed, bool compressed = false);
+bool repartitionElements(int ne, int np);
+bool sharedPoolTest(int ne, int np);
 
 int main(int argc, char* argv[]) {
   Kokkos::initialize(argc, argv);
@@ -82,7 +86,20 @@ int main(int argc, char* argv[]) {
       scs->parallel_for(setElmProcess);
     }
 
-    scs->migrate(new_element, new_process);
+    //Split migration, the structure can be read while particles are in flight
+    auto handle = scs->migrate_begin(new_element, new_process);
+    SCS::kkLidView num_masked("num_masked", 1);
+    auto countMasked = PS_LAMBDA(int elm_id, int ptcl_id, int mask) {
+      Kokkos::atomic_fetch_add(&num_masked(0), mask);
+    };
+    scs->parallel_for(countMasked);
+    int masked = particle_structs::getLastValue<int>(num_masked);
+    if (masked != scs->nPtcls()) {
+      printf("%d particles counted during migration %d != %d\n", comm_rank, masked,
+             scs->nPtcls());
+      fails++;
+    }
+    scs->migrate_end(handle);
 
 
     int_slice = scs->get<0>();
@@ -115,10 +132,26 @@ int main(int argc, char* argv[]) {
     delete scs;
   }
 
-  if (!sendToOne(5000, 100000)) {
+  if (!sendToOne(5000, 100000, true)) {
     printf("SendToOne failed on rank %d\n", comm_rank);
     fails++;
   }
+  if (!sendToOne(5000, 100000, true, true)) {
+    printf("SendToOne with compressed messages failed on rank %d\n", comm_rank);
+    fails++;
+  }
+  if (!sendToOne(5000, 100000, false)) {
+    printf("SendToOne with per type messages failed on rank %d\n", comm_rank);
+    fails++;
+  }
+  if (!repartitionElements(500, 10000)) {
+    printf("Repartition failed on rank %d\n", comm_rank);
+    fails++;
+  }
+  if (!sharedPoolTest(100, 2000)) {
+    printf("Migration with a shared buffer pool failed on rank %d\n", comm_rank);
+    fails++;
+  }
   Kokkos::finalize();
   int total_fails;
   MPI_Reduce(&fails, &total_fails, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
@@ -128,7 +161,7 @@ int main(int argc, char* argv[]) {
   return 0;
 }
 
-bool sendToOne(int ne, int np) {
+bool sendToOne(int ne, int np, bool packed, bool compressed) {
   int comm_rank;
   int comm_size;
   MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
@@ -154,6 +187,12 @@ bool sendToOne(int ne, int np) {
   int sigma = ne;
   int V = 100;
   SCS* scs = new SCS(po, sigma, V, ne, np, ptcls_per_elem_v, element_gids_v);
+  scs->setPackedMigration(packed);
+  if (compressed) {
+    std::vector<particle_structs::PackCodec> codecs(2, particle_structs::PACK_EXACT);
+    codecs[1] = particle_structs::PACK_FLOAT;
+    scs->setMigrationCompression(codecs);
+  }
 
   typedef SCS::kkLidView kkLidView;
   kkLidView new_element("new_element", scs->capacity());
@@ -204,3 +243,170 @@ bool sendToOne(int ne, int np) {
   int f = particle_structs::getLastValue(fail);
   return f == 0;
 }
+
+/* Each rank takes the elements of the next rank plus as many new empty elements, so every
+   particle moves to the previous rank into a structure with twice the elements */
+bool repartitionElements(int ne, int np) {
+  int comm_rank;
+  int comm_size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+
+  int* ptcls_per_elem = new int[ne];
+  std::vector<int>* ids = new std::vector<int>[ne];
+  distribute_particles(ne, np, 2, ptcls_per_elem, ids);
+  delete [] ids;
+  SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+  particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+  delete [] ptcls_per_elem;
+  SCS::kkGidView element_gids_v("element_gids_v", ne);
+  const int next = (comm_rank + 1) % comm_size;
+  const int prev = (comm_rank + comm_size - 1) % comm_size;
+  const int new_ne = 2 * ne;
+  SCS::kkGidView new_gids_v("new_gids_v", new_ne);
+  Kokkos::parallel_for(ne, KOKKOS_LAMBDA(const int& i) {
+    element_gids_v(i) = comm_rank * ne + i;
+  });
+  //The received elements are stored in reverse after the empty elements
+  Kokkos::parallel_for(new_ne, KOKKOS_LAMBDA(const int& i) {
+    new_gids_v(i) = i < ne ? (comm_size + comm_rank) * ne + i : next * ne + (new_ne - 1 - i);
+  });
+  Kokkos::TeamPolicy<exe_space> po(4, 32);
+  SCS* scs = new SCS(po, ne, 100, ne, np, ptcls_per_elem_v, element_gids_v);
+
+  typedef SCS::kkLidView kkLidView;
+  kkLidView new_process("new_process", scs->capacity());
+  auto int_slice = scs->get<0>();
+  auto double_slice = scs->get<1>();
+  auto setValues = PS_LAMBDA(int elem_id, int ptcl_id, int mask) {
+    int_slice(ptcl_id) = comm_rank;
+    double_slice(ptcl_id, 0) = element_gids_v(elem_id);
+    new_process(ptcl_id) = prev;
+  };
+  scs->parallel_for(setValues);
+
+  scs->repartition(new_process, element_gids_v, new_ne, new_gids_v);
+
+  if (scs->nElems() != new_ne || scs->nPtcls() != np) {
+    fprintf(stderr, "Rank %d has %d elements and %d particles after repartition "
+            "(%d %d expected)\n", comm_rank, scs->nElems(), scs->nPtcls(), new_ne, np);
+    return false;
+  }
+  int_slice = scs->get<0>();
+  double_slice = scs->get<1>();
+  kkLidView fail("fail", 1);
+  auto checkValues = PS_LAMBDA(int elm_id, int ptcl_id, int mask) {
+    if (mask && (int_slice(ptcl_id) != next || elm_id < ne ||
+                 fabs(double_slice(ptcl_id, 0) - new_gids_v(elm_id)) > .0005))
+      fail(0) = 1;
+  };
+  scs->parallel_for(checkValues);
+  delete scs;
+  return particle_structs::getLastValue(fail) == 0;
+}
+
+//Structure of type PS with the same ne elements (gids 0 to ne-1) on every rank
+template <class PS>
+PS* buildSameElements(int ne, int np) {
+  particle_structs::gid_t* gids = new particle_structs::gid_t[ne];
+  for (int i = 0; i < ne; ++i)
+    gids[i] = i;
+  int* ptcls_per_elem = new int[ne];
+  std::vector<int>* ids = new std::vector<int>[ne];
+  //Even distribution so every rank gets back as many particles as it sends
+  distribute_particles(ne, np, 0, ptcls_per_elem, ids);
+  delete [] ids;
+  typename PS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+  typename PS::kkGidView element_gids_v("element_gids_v", ne);
+  particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+  particle_structs::hostToDevice(element_gids_v, gids);
+  delete [] ptcls_per_elem;
+  delete [] gids;
+  Kokkos::TeamPolicy<exe_space> po(4, 32);
+  PS* ps = new PS(po, ne, 100, ne, np, ptcls_per_elem_v, element_gids_v);
+  //Per type messages so the send and receive member views come from the pool
+  ps->setPackedMigration(false);
+  return ps;
+}
+
+//Particles of even elements move to the next rank, the others stay
+template <class PS>
+void migrateEvenElements(PS* ps) {
+  int comm_rank, comm_size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+  typename PS::kkLidView new_element("new_element", ps->capacity());
+  typename PS::kkLidView new_process("new_process", ps->capacity());
+  auto setDestination = PS_LAMBDA(int elm_id, int ptcl_id, int mask) {
+    new_element(ptcl_id) = elm_id;
+    new_process(ptcl_id) = elm_id % 2 == 0 ? (comm_rank + 1) % comm_size : comm_rank;
+  };
+  ps->parallel_for(setDestination);
+  ps->migrate(new_element, new_process);
+}
+
+/* Two structures of different member types share one buffer pool and migrate in turns,
+   the values of each structure must survive the other's use of the pool */
+bool sharedPoolTest(int ne, int np) {
+  int comm_rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+  particle_structs::BufferPool<SCS::device_type> pool;
+  SCS* scs = buildSameElements<SCS>(ne, np);
+  OtherSCS* other = buildSameElements<OtherSCS>(ne, np);
+  scs->setBufferPool(&pool);
+  other->setBufferPool(&pool);
+
+  for (int step = 0; step < 2; ++step) {
+    auto int_slice = scs->get<0>();
+    auto double3_slice = scs->get<1>();
+    auto setValues = PS_LAMBDA(int elm_id, int ptcl_id, int mask) {
+      int_slice(ptcl_id) = elm_id;
+      for (int i = 0; i < 3; ++i)
+        double3_slice(ptcl_id, i) = elm_id * (i + 1);
+    };
+    scs->parallel_for(setValues);
+    auto double2_slice = other->get<0>();
+    auto other_int_slice = other->get<1>();
+    auto setOtherValues = PS_LAMBDA(int elm_id, int ptcl_id, int mask) {
+      double2_slice(ptcl_id, 0) = elm_id + 0.5;
+      double2_slice(ptcl_id, 1) = -elm_id;
+      other_int_slice(ptcl_id) = 2 * elm_id;
+    };
+    other->parallel_for(setOtherValues);
+
+    migrateEvenElements(scs);
+    migrateEvenElements(other);
+  }
+
+  SCS::kkLidView fail("fail", 1);
+  auto int_slice = scs->get<0>();
+  auto double3_slice = scs->get<1>();
+  auto checkValues = PS_LAMBDA(int elm_id, int ptcl_id, int mask) {
+    if (mask) {
+      bool wrong = int_slice(ptcl_id) != elm_id;
+      for (int i = 0; i < 3; ++i)
+        wrong |= fabs(double3_slice(ptcl_id, i) - elm_id * (i + 1)) > .0005;
+      if (wrong)
+        fail(0) = 1;
+    }
+  };
+  scs->parallel_for(checkValues);
+  auto double2_slice = other->get<0>();
+  auto other_int_slice = other->get<1>();
+  auto checkOtherValues = PS_LAMBDA(int elm_id, int ptcl_id, int mask) {
+    if (mask && (fabs(double2_slice(ptcl_id, 0) - (elm_id + 0.5)) > .0005 ||
+                 fabs(double2_slice(ptcl_id, 1) + elm_id) > .0005 ||
+                 other_int_slice(ptcl_id) != 2 * elm_id))
+      fail(0) = 1;
+  };
+  other->parallel_for(checkOtherValues);
+  bool passed = particle_structs::getLastValue(fail) == 0;
+  if (scs->nPtcls() != np || other->nPtcls() != np) {
+    fprintf(stderr, "Rank %d has %d and %d particles after migrating with a shared pool "
+            "(%d expected)\n", comm_rank, scs->nPtcls(), other->nPtcls(), np);
+    passed = false;
+  }
+  delete scs;
+  delete other;
+  return passed;
+}
@@ -1,10 +1,13 @@
 #include <stdio.h>
+#include <math.h>
 #include <Kokkos_Core.hpp>
 
 #include <MemberTypes.h>
 #include <SellCSigma.h>
 
 #include <psAssert.h>
+#include <KernelGraph.h>
+#include <ps_species.hpp>
 #include "Distribute.h"
 
 using particle_structs::SellCSigma;
@@ -20,12 +23,26 @@ typedef SellCSigma<Type> SCS;
 bool shuffleParticlesTests();
 bool resortElementsTest();
 bool reshuffleTests();
+bool autotuneTest();
+bool rowSortTest();
+bool overflowTest();
+bool instanceTest();
+bool graphTest();
+bool idIndexTest();
+bool addParticlesTest();
+bool multiSpeciesTest();
+bool streamedTest();
+bool autoPolicyTest();
+bool lazyRebuildTest();
+bool resampleTest();
+bool lowMemoryRebuildTest();
 
 int main(int argc, char* argv[]) {
   MPI_Init(&argc, &argv);
   Kokkos::initialize(argc, argv);
 
   bool passed = true;
+  particle_structs::setKernelWork(true);
   if (!shuffleParticlesTests()) {
     passed = false;
     printf("[ERROR] shuffleParticlesTests() failed\n");
@@ -38,6 +55,102 @@ int main(int argc, char* argv[]) {
     passed = false;
     printf("[ERROR] reshuffleTests() failed\n");
   }
+  if (!autotuneTest()) {
+    passed = false;
+    printf("[ERROR] autotuneTest() failed\n");
+  }
+  if (!rowSortTest()) {
+    passed = false;
+    printf("[ERROR] rowSortTest() failed\n");
+  }
+  if (!overflowTest()) {
+    passed = false;
+    printf("[ERROR] overflowTest() failed\n");
+  }
+  if (!instanceTest()) {
+    passed = false;
+    printf("[ERROR] instanceTest() failed\n");
+  }
+  if (!graphTest()) {
+    passed = false;
+    printf("[ERROR] graphTest() failed\n");
+  }
+  if (!idIndexTest()) {
+    passed = false;
+    printf("[ERROR] idIndexTest() failed\n");
+  }
+  if (!addParticlesTest()) {
+    passed = false;
+    printf("[ERROR] addParticlesTest() failed\n");
+  }
+  if (!multiSpeciesTest()) {
+    passed = false;
+    printf("[ERROR] multiSpeciesTest() failed\n");
+  }
+  if (!streamedTest()) {
+    passed = false;
+    printf("[ERROR] streamedTest() failed\n");
+  }
+  if (!autoPolicyTest()) {
+    passed = false;
+    printf("[ERROR] autoPolicyTest() failed\n");
+  }
+  if (!lazyRebuildTest()) {
+    passed = false;
+    printf("[ERROR] lazyRebuildTest() failed\n");
+  }
+  if (!resampleTest()) {
+    passed = false;
+    printf("[ERROR] resampleTest() failed\n");
+  }
+  if (!lowMemoryRebuildTest()) {
+    passed = false;
+    printf("[ERROR] lowMemoryRebuildTest() failed\n");
+  }
+  //Rebuild and reshuffle times are recorded in the timing registry
+  const std::map<std::string, particle_structs::RegionStats>& times =
+    particle_structs::getRegionTimes();
+  if (times.find("ps_rebuild") == times.end() || times.find("ps_reshuffle") == times.end()) {
+    passed = false;
+    printf("[ERROR] rebuild times were not recorded\n");
+  }
+  const std::map<std::string, long long>& counters = particle_structs::getCounters();
+  if (counters.find("ps_rebuild_particles") == counters.end() ||
+      counters.find("ps_reshuffle_bytes") == counters.end()) {
+    passed = false;
+    printf("[ERROR] rebuild work was not recorded\n");
+  }
+  //Destroying views that were not created by CreateViews frees none of the tracked bytes
+  {
+    typedef particle_structs::DefaultMemSpace::device_type Device;
+    particle_structs::MemberTypeViews<Type, Device> user_views = new void*[1];
+    user_views[0] = new particle_structs::MemberTypeView<int, Device>("scs_particle_data", 100);
+    particle_structs::destroyViews<Type>(user_views);
+  }
+  //The particle data of every deleted structure is freed, its peak stays recorded
+  const std::map<std::string, particle_structs::MemoryStats>& memory =
+    particle_structs::getMemoryUsage();
+  auto particle_memory = memory.find("scs_particle_data");
+  if (particle_memory == memory.end() || particle_memory->second.current != 0 ||
+      particle_memory->second.peak <= 0 ||
+      particle_memory->second.peak_phase.find("scs_") == std::string::npos) {
+    passed = false;
+    printf("[ERROR] particle data memory was not tracked\n");
+  }
+  //A single rank is balanced
+  particle_structs::reduceImbalance();
+  const std::map<std::string, particle_structs::ImbalanceStats>& imbalance =
+    particle_structs::getImbalance();
+  auto rebuild_imbalance = imbalance.find("ps_rebuild");
+  if (rebuild_imbalance == imbalance.end() || rebuild_imbalance->second.samples <= 0 ||
+      rebuild_imbalance->second.particle_imbalance != 1 ||
+      particle_structs::imbalanceMetric() != 1) {
+    passed = false;
+    printf("[ERROR] rebuild imbalance was not recorded\n");
+  }
+  particle_structs::printRegionSummary();
+  particle_structs::printMemoryUsage();
+  particle_structs::printImbalance();
 
   Kokkos::finalize();
   MPI_Finalize();
@@ -323,3 +436,948 @@ bool reshuffleTests() {
   int f = particle_structs::getLastValue<lid_t>(fail);
   return !f;
 }
+
+//Kernel timed by autotune, counts the particles whose value is not their element
+int autotune_wrong = 0;
+void readAutotuneValues(SCS* scs) {
+  auto values = scs->get<0>();
+  SCS::kkLidView wrong("wrong", 1);
+  auto readValues = PS_LAMBDA(int elm_id, int ptcl_id, bool mask) {
+    if (mask && values(ptcl_id) != elm_id)
+      Kokkos::atomic_fetch_add(&wrong(0), 1);
+  };
+  scs->parallel_for(readValues);
+  autotune_wrong += getLastValue<lid_t>(wrong);
+}
+
+bool autotuneTest() {
+  int ne = 20;
+  int np = 1000;
+  int* ptcls_per_elem = new int[ne];
+  std::vector<int>* ids = new std::vector<int>[ne];
+  distribute_particles(ne, np, 2, ptcls_per_elem, ids);
+  delete [] ids;
+  Kokkos::TeamPolicy<exe_space> po(128, 4);
+  SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+  SCS::kkGidView element_gids_v("", 0);
+  particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+  delete [] ptcls_per_elem;
+  SCS* scs = new SCS(po, 1, 2, ne, np, ptcls_per_elem_v, element_gids_v);
+
+  auto values = scs->get<0>();
+  auto setValues = PS_LAMBDA(int elm_id, int ptcl_id, bool mask) {
+    values(ptcl_id) = elm_id;
+  };
+  scs->parallel_for(setValues);
+
+  SCS::TuneGrid grid;
+  grid.C = {1, 2, 4, 8};
+  grid.sigma = {1, INT_MAX};
+  grid.V = {2, 64};
+  autotune_wrong = 0;
+  scs->autotune(readAutotuneValues, grid, 2);
+  scs->printMetrics();
+
+  bool passed = true;
+  //Every candidate must be timed on the views of its own layout
+  if (autotune_wrong != 0) {
+    printf("Autotune ran on stale views (%d wrong values)\n", autotune_wrong);
+    passed = false;
+  }
+  if (scs->C() != scs->tuneChoice().C) {
+    printf("Autotune chose C %d but the layout uses %d\n", scs->tuneChoice().C, scs->C());
+    passed = false;
+  }
+  if (scs->nPtcls() != np) {
+    printf("Autotune changed the number of particles (%d != %d)\n", scs->nPtcls(), np);
+    passed = false;
+  }
+  if (scs->C() > 4) {
+    printf("Autotune chose C larger than the team size (%d)\n", scs->C());
+    passed = false;
+  }
+  //Particles must stay in their element
+  values = scs->get<0>();
+  SCS::kkLidView fail("fail", 1);
+  auto checkValues = PS_LAMBDA(int elm_id, int ptcl_id, bool mask) {
+    if (mask && values(ptcl_id) != elm_id)
+      fail(0) = 1;
+  };
+  scs->parallel_for(checkValues);
+  if (getLastValue<lid_t>(fail)) {
+    printf("Particles changed elements during autotune\n");
+    passed = false;
+  }
+
+  //Periodic autotune after every rebuild, run fetches the views of the current layout
+  scs->setAutotunePeriod(readAutotuneValues, grid, 1, 1);
+  for (int i = 0; i < 2; ++i) {
+    SCS::kkLidView new_element("new_element", scs->capacity());
+    auto keepElement = PS_LAMBDA(int elm_id, int ptcl_id, bool mask) {
+      new_element(ptcl_id) = mask ? elm_id : -1;
+    };
+    scs->parallel_for(keepElement);
+    scs->rebuild(new_element);
+  }
+  if (autotune_wrong != 0) {
+    printf("Periodic autotune ran on stale views (%d wrong values)\n", autotune_wrong);
+    passed = false;
+  }
+  if (scs->C() != scs->tuneChoice().C || scs->nPtcls() != np) {
+    printf("Periodic autotune layout does not match its choice (C %d != %d)\n", scs->C(),
+           scs->tuneChoice().C);
+    passed = false;
+  }
+  delete scs;
+  return passed;
+}
+
+bool rowSortTest() {
+  int ne = 10;
+  int np = 500;
+  int* ptcls_per_elem = new int[ne];
+  std::vector<int>* ids = new std::vector<int>[ne];
+  distribute_particles(ne, np, 2, ptcls_per_elem, ids);
+  delete [] ids;
+  Kokkos::TeamPolicy<exe_space> po(128, 4);
+  SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+  SCS::kkGidView element_gids_v("", 0);
+  particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+  delete [] ptcls_per_elem;
+  SCS* scs = new SCS(po, 4, 2, ne, np, ptcls_per_elem_v, element_gids_v);
+
+  //Use a scrambled value of each particle as its key and keep particles in their element
+  auto values = scs->get<0>();
+  SCS::kkLidView new_element("new_element", scs->capacity());
+  SCS::kkGidView keys("keys", scs->capacity());
+  auto setValues = PS_LAMBDA(int elm_id, int ptcl_id, bool mask) {
+    values(ptcl_id) = (ptcl_id * 7919) % 1013;
+    keys(ptcl_id) = values(ptcl_id);
+    new_element(ptcl_id) = mask ? elm_id : -1;
+  };
+  scs->parallel_for(setValues);
+
+  //Add new particles with keys to element 0
+  const int nnp = 5;
+  SCS::kkLidView new_particle_elements("new_particle_elements", nnp);
+  SCS::kkGidView new_keys("new_keys", nnp);
+  auto new_particle_info = particle_structs::createMemberViews<Type>(nnp);
+  auto new_values = particle_structs::getMemberView<Type, 0>(new_particle_info);
+  Kokkos::parallel_for(nnp, KOKKOS_LAMBDA(const int& i) {
+    new_values(i) = 1013 - i;
+    new_keys(i) = new_values(i);
+  });
+  scs->setRowSortKeys(keys, new_keys);
+  scs->rebuild(new_element, new_particle_elements, new_particle_info);
+
+  bool passed = true;
+  if (scs->nPtcls() != np + nnp) {
+    printf("Row sort changed the number of particles (%d != %d)\n", scs->nPtcls(), np + nnp);
+    passed = false;
+  }
+  //Values within each row must be in ascending order
+  values = scs->get<0>();
+  SCS::kkLidView fail("fail", 1);
+  auto checkOrder = PS_LAMBDA(const SCS::TeamMember& team, const int& elm_id,
+                              const SCS::RowParticles& row) {
+    Kokkos::single(Kokkos::PerTeam(team), [=]() {
+      int prev = -1;
+      for (int i = 0; i < row.size(); ++i) {
+        if (!row.mask(i))
+          continue;
+        if (values(row(i)) < prev)
+          fail(0) = 1;
+        prev = values(row(i));
+      }
+    });
+  };
+  scs->parallel_for_elements(checkOrder);
+  if (getLastValue<lid_t>(fail)) {
+    printf("Particles are not sorted within their rows\n");
+    passed = false;
+  }
+  delete scs;
+  return passed;
+}
+
+bool overflowTest() {
+  int ne = 4;
+  int np = 400;
+  int* ptcls_per_elem = new int[ne];
+  std::vector<int>* ids = new std::vector<int>[ne];
+  distribute_particles(ne, np, 0, ptcls_per_elem, ids);
+  delete [] ids;
+  Kokkos::TeamPolicy<exe_space> po(128, 4);
+  SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+  SCS::kkGidView element_gids_v("", 0);
+  particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+  const int elm0_ptcls = ptcls_per_elem[0];
+  delete [] ptcls_per_elem;
+  SCS* scs = new SCS(po, 1, 1024, ne, np, ptcls_per_elem_v, element_gids_v);
+  const int capacity = scs->capacity();
+
+  //Move 5 particles of element 1 into the full element 0
+  auto pids = scs->get<0>();
+  SCS::kkLidView new_element("new_element", capacity);
+  SCS::kkLidView moved("moved", 1);
+  auto setElements = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    pids(ptcl_id) = ptcl_id;
+    new_element(ptcl_id) = mask ? elm_id : -1;
+    if (mask && elm_id == 1 && Kokkos::atomic_fetch_add(&moved(0), 1) < 5)
+      new_element(ptcl_id) = 0;
+  };
+  scs->parallel_for(setElements);
+  scs->rebuild(new_element);
+
+  bool passed = true;
+  if (scs->capacity() <= capacity) {
+    printf("Reshuffle did not borrow slots from the padding (%d <= %d)\n", scs->capacity(),
+           capacity);
+    passed = false;
+  }
+  //Particles that did not move must keep their slot and the new ones are in element 0
+  SCS::kkLidView fail("fail", 1);
+  SCS::kkLidView elm0_count("elm0_count", 1);
+  pids = scs->get<0>();
+  auto checkSlots = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    if (mask && ptcl_id < capacity && new_element(ptcl_id) == elm_id && pids(ptcl_id) != ptcl_id)
+      fail(0) = 1;
+    if (mask && elm_id == 0)
+      Kokkos::atomic_fetch_add(&elm0_count(0), 1);
+  };
+  scs->parallel_for(checkSlots);
+  if (getLastValue<lid_t>(fail)) {
+    printf("Particles were moved by the overflow reshuffle\n");
+    passed = false;
+  }
+  if (getLastValue<lid_t>(elm0_count) != elm0_ptcls + 5 || scs->nPtcls() != np) {
+    printf("Element 0 has %d particles instead of %d\n", getLastValue<lid_t>(elm0_count),
+           elm0_ptcls + 5);
+    passed = false;
+  }
+  SCS::LayoutMetrics metrics = scs->getMetrics();
+  if (metrics.reshuffle_successes != 1 || metrics.last_rebuild_reason != SCS::REBUILD_NONE ||
+      metrics.padded_cells != scs->capacity() - np || metrics.empty_rows != 0) {
+    printf("Layout metrics do not match the structure\n");
+    passed = false;
+  }
+  delete scs;
+  return passed;
+}
+
+//Two structures on their own execution space instances are rebuilt interleaved
+bool instanceTest() {
+  const int ne = 20;
+  const int np = 400;
+  const int num_structs = 2;
+#ifdef PS_USE_CUDA
+  cudaStream_t streams[num_structs];
+  for (int s = 0; s < num_structs; ++s)
+    cudaStreamCreate(streams + s);
+#endif
+  Kokkos::TeamPolicy<exe_space> po(32, 4);
+  SCS* structs[num_structs];
+  for (int s = 0; s < num_structs; ++s) {
+    particle_structs::gid_t* gids = new particle_structs::gid_t[ne];
+    distribute_elements(ne, 0, 0, 1, gids);
+    int* ptcls_per_elem = new int[ne];
+    std::vector<int>* ids = new std::vector<int>[ne];
+    distribute_particles(ne, np, 0, ptcls_per_elem, ids);
+    SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+    SCS::kkGidView element_gids_v("element_gids_v", ne);
+    particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+    particle_structs::hostToDevice(element_gids_v, gids);
+    structs[s] = new SCS(po, 4, 8, ne, np, ptcls_per_elem_v, element_gids_v);
+#ifdef PS_USE_CUDA
+    structs[s]->setExecutionSpace(exe_space(streams[s]));
+#else
+    structs[s]->setExecutionSpace(exe_space());
+#endif
+    delete [] ptcls_per_elem;
+    delete [] ids;
+    delete [] gids;
+  }
+
+  //Each structure moves its particles by a different offset
+  for (int s = 0; s < num_structs; ++s) {
+    auto values = structs[s]->get<0>();
+    SCS::kkLidView new_element("new_element", structs[s]->capacity());
+    const int shift = s + 1;
+    auto moveParticles = PS_LAMBDA(int elm_id, int ptcl_id, bool mask) {
+      if (mask) {
+        new_element(ptcl_id) = (elm_id + shift) % ne;
+        values(ptcl_id) = new_element(ptcl_id);
+      }
+    };
+    structs[s]->parallel_for(moveParticles, "moveParticles");
+    structs[s]->rebuild(new_element);
+  }
+  bool passed = true;
+  for (int s = 0; s < num_structs; ++s) {
+    auto values = structs[s]->get<0>();
+    SCS::kkLidView fail("fail", 1);
+    auto checkParticles = PS_LAMBDA(int elm_id, int ptcl_id, bool mask) {
+      if (mask && values(ptcl_id) != elm_id)
+        fail(0) = 1;
+    };
+    structs[s]->parallel_for(checkParticles, "checkParticles");
+    if (getLastValue<lid_t>(structs[s]->executionSpace(), fail)) {
+      printf("Value mismatch on structure %d\n", s);
+      passed = false;
+    }
+    if (structs[s]->nPtcls() != np) {
+      printf("Particles lost on structure %d\n", s);
+      passed = false;
+    }
+    delete structs[s];
+  }
+#ifdef PS_USE_CUDA
+  for (int s = 0; s < num_structs; ++s)
+    cudaStreamDestroy(streams[s]);
+#endif
+  return passed;
+}
+
+//Replays of a recorded parallel_for run its kernel again
+bool graphTest() {
+  const int ne = 20;
+  const int np = 400;
+  const int num_runs = 3;
+#ifdef PS_USE_CUDA
+  cudaStream_t stream;
+  cudaStreamCreate(&stream);
+#endif
+  Kokkos::TeamPolicy<exe_space> po(32, 4);
+  particle_structs::gid_t* gids = new particle_structs::gid_t[ne];
+  distribute_elements(ne, 0, 0, 1, gids);
+  int* ptcls_per_elem = new int[ne];
+  std::vector<int>* ids = new std::vector<int>[ne];
+  distribute_particles(ne, np, 0, ptcls_per_elem, ids);
+  SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+  SCS::kkGidView element_gids_v("element_gids_v", ne);
+  particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+  particle_structs::hostToDevice(element_gids_v, gids);
+  SCS* scs = new SCS(po, 4, 8, ne, np, ptcls_per_elem_v, element_gids_v);
+  delete [] ptcls_per_elem;
+  delete [] ids;
+  delete [] gids;
+#ifdef PS_USE_CUDA
+  scs->setExecutionSpace(exe_space(stream));
+#endif
+
+  auto values = scs->get<0>();
+  auto zero = PS_LAMBDA(int elm_id, int ptcl_id, bool mask) {
+    values(ptcl_id) = 0;
+  };
+  scs->parallel_for(zero, "zero");
+  auto increment = PS_LAMBDA(int elm_id, int ptcl_id, bool mask) {
+    if (mask)
+      values(ptcl_id) += 1;
+  };
+  particle_structs::KernelGraph<exe_space> graph;
+  for (int i = 0; i < num_runs; ++i)
+    graph.run(scs->executionSpace(), scs->layoutVersion(), [&]() {
+      scs->parallel_for(increment, "increment");
+    });
+
+  bool passed = true;
+#ifdef PS_USE_CUDA
+  if (graph.recorded() && graph.replays() != num_runs - 1) {
+    printf("Graph replayed %lu times\n", graph.replays());
+    passed = false;
+  }
+#endif
+  SCS::kkLidView fail("fail", 1);
+  auto checkValues = PS_LAMBDA(int elm_id, int ptcl_id, bool mask) {
+    if (mask && values(ptcl_id) != num_runs)
+      fail(0) = 1;
+  };
+  scs->parallel_for(checkValues, "checkValues");
+  if (getLastValue<lid_t>(scs->executionSpace(), fail)) {
+    printf("Values do not match the number of runs\n");
+    passed = false;
+  }
+  delete scs;
+#ifdef PS_USE_CUDA
+  cudaStreamDestroy(stream);
+#endif
+  return passed;
+}
+
+//Checks that the id index points every particle on the structure at its slot
+bool checkIdIndex(SCS* scs, int max_id) {
+  SCS::kkLidView index = scs->idIndex();
+  auto pids = scs->get<0>();
+  SCS::kkLidView fail("fail", 1);
+  auto checkSlots = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    if (mask && index(pids(ptcl_id)) != ptcl_id)
+      fail(0) = 1;
+  };
+  scs->parallel_for(checkSlots);
+  lid_t indexed = 0;
+  Kokkos::parallel_reduce(max_id, KOKKOS_LAMBDA(const lid_t& i, lid_t& sum) {
+      sum += index(i) >= 0;
+    }, indexed);
+  return !getLastValue<lid_t>(fail) && indexed == scs->nPtcls();
+}
+
+bool idIndexTest() {
+  int ne = 5;
+  int np = 500;
+  int* ptcls_per_elem = new int[ne];
+  std::vector<int>* ids = new std::vector<int>[ne];
+  distribute_particles(ne, np, 0, ptcls_per_elem, ids);
+  delete [] ids;
+  Kokkos::TeamPolicy<exe_space> po(128, 4);
+  SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+  SCS::kkGidView element_gids_v("", 0);
+  particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+  delete [] ptcls_per_elem;
+  SCS* scs = new SCS(po, 1, 1024, ne, np, ptcls_per_elem_v, element_gids_v);
+
+  SCS::kkLidView counter("counter", 1);
+  auto pids = scs->get<0>();
+  auto setIds = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    if (mask)
+      pids(ptcl_id) = Kokkos::atomic_fetch_add(&counter(0), 1);
+  };
+  scs->parallel_for(setIds);
+  scs->enableIdIndex<0>(np);
+  bool passed = true;
+  if (!checkIdIndex(scs, np)) {
+    printf("Id index does not match the constructed structure\n");
+    passed = false;
+  }
+
+  //Reshuffle then full rebuild, moving particles to the next element and removing some
+  for (int i = 0; i < 2; ++i) {
+    scs->setShuffling(i == 0);
+    SCS::kkLidView new_element("new_element", scs->capacity());
+    pids = scs->get<0>();
+    auto setElements = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+      new_element(ptcl_id) = -1;
+      if (mask && pids(ptcl_id) % 7 != i)
+        new_element(ptcl_id) = pids(ptcl_id) % 3 == 0 ? (elm_id + 1) % ne : elm_id;
+    };
+    scs->parallel_for(setElements);
+    scs->rebuild(new_element);
+    if (!checkIdIndex(scs, np)) {
+      printf("Id index does not match the structure after %s\n", i ? "rebuild" : "reshuffle");
+      passed = false;
+    }
+  }
+
+  //Ids past max_id are counted and left out of the index instead of written past its end
+  const int max_id = np / 2;
+  pids = scs->get<0>();
+  SCS::kkLidView over("over", 1);
+  auto countOver = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    if (mask && pids(ptcl_id) >= max_id)
+      Kokkos::atomic_fetch_add(&over(0), 1);
+  };
+  scs->parallel_for(countOver);
+  const lid_t num_over = getLastValue<lid_t>(over);
+  scs->enableIdIndex<0>(max_id);
+  if (num_over == 0 || scs->idIndexMisses() != num_over) {
+    printf("Id index missed %d ids instead of %d\n", scs->idIndexMisses(), num_over);
+    passed = false;
+  }
+  SCS::kkLidView next_element("next_element", scs->capacity());
+  auto moveNext = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    next_element(ptcl_id) = mask ? (elm_id + 1) % ne : -1;
+  };
+  scs->parallel_for(moveNext);
+  scs->rebuild(next_element);
+  if (scs->idIndexMisses() != 2 * num_over) {
+    printf("Id index missed %d ids after rebuild instead of %d\n", scs->idIndexMisses(),
+           2 * num_over);
+    passed = false;
+  }
+  SCS::kkLidView index = scs->idIndex();
+  pids = scs->get<0>();
+  SCS::kkLidView fail("fail", 1);
+  auto checkInRange = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    if (mask && pids(ptcl_id) < max_id && index(pids(ptcl_id)) != ptcl_id)
+      fail(0) = 1;
+  };
+  scs->parallel_for(checkInRange);
+  if (getLastValue<lid_t>(fail)) {
+    printf("Id index does not match the ids below max_id\n");
+    passed = false;
+  }
+  delete scs;
+  return passed;
+}
+
+//Adds particles into holes, then more than the structure can hold without a rebuild
+bool addParticlesTest() {
+  int ne = 5;
+  int np = 50;
+  int* ptcls_per_elem = new int[ne];
+  std::vector<int>* ids = new std::vector<int>[ne];
+  distribute_particles(ne, np, 0, ptcls_per_elem, ids);
+  delete [] ids;
+  Kokkos::TeamPolicy<exe_space> po(128, 4);
+  SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+  SCS::kkGidView element_gids_v("", 0);
+  particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+  delete [] ptcls_per_elem;
+  SCS* scs = new SCS(po, 1, 1024, ne, np, ptcls_per_elem_v, element_gids_v);
+  auto pids = scs->get<0>();
+  auto setIds = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    pids(ptcl_id) = mask ? 0 : -1;
+  };
+  scs->parallel_for(setIds);
+
+  bool passed = true;
+  const int sizes[2] = {2, 500};
+  int total = np;
+  for (int i = 0; i < 2; ++i) {
+    const int num_new = sizes[i];
+    SCS::kkLidView new_particle_elems("new_particle_elems", num_new);
+    auto new_particle_info = particle_structs::createMemberViews<Type>(num_new);
+    auto new_pids = particle_structs::getMemberView<Type, 0>(new_particle_info);
+    Kokkos::parallel_for(num_new, KOKKOS_LAMBDA(const int& j) {
+      new_particle_elems(j) = j % 2 * 3;
+      new_pids(j) = 1 + j % 2;
+    });
+    scs->addParticles(new_particle_elems, new_particle_info);
+    particle_structs::destroyViews<Type>(new_particle_info);
+    total += num_new;
+    if (scs->nPtcls() != total) {
+      printf("Structure has %d particles instead of %d\n", scs->nPtcls(), total);
+      passed = false;
+    }
+    SCS::kkLidView fail("fail", 1);
+    pids = scs->get<0>();
+    auto checkElements = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+      if (mask && ((pids(ptcl_id) == 1 && elm_id != 0) || (pids(ptcl_id) == 2 && elm_id != 3)))
+        fail(0) = 1;
+    };
+    scs->parallel_for(checkElements);
+    if (getLastValue<lid_t>(fail)) {
+      printf("New particles were not added to their elements\n");
+      passed = false;
+    }
+  }
+  delete scs;
+  return passed;
+}
+
+//Particles of odd elements are species 1, the rebuild moves species 1 to element 0
+bool multiSpeciesTest() {
+  int ne = 5;
+  int np = 50;
+  int* ptcls_per_elem = new int[ne];
+  std::vector<int>* ids = new std::vector<int>[ne];
+  distribute_particles(ne, np, 0, ptcls_per_elem, ids);
+  delete [] ids;
+  int expected[2] = {0, 0};
+  for (int i = 0; i < ne; ++i)
+    expected[i % 2] += ptcls_per_elem[i];
+  Kokkos::TeamPolicy<exe_space> po(128, 4);
+  SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+  SCS::kkGidView element_gids_v("", 0);
+  particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+  delete [] ptcls_per_elem;
+  SCS* scs = new SCS(po, 1, 1024, ne, np, ptcls_per_elem_v, element_gids_v);
+  auto species = scs->get<0>();
+  auto setSpecies = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    species(ptcl_id) = elm_id % 2;
+  };
+  scs->parallel_for(setSpecies);
+
+  bool passed = true;
+  particle_structs::MultiSpecies<Type, 0> multi(scs, 2);
+  if (multi.nPtcls(0) != expected[0] || multi.nPtcls(1) != expected[1]) {
+    printf("Species counts are %d %d instead of %d %d\n", multi.nPtcls(0), multi.nPtcls(1),
+           expected[0], expected[1]);
+    passed = false;
+  }
+  SCS::kkLidView new_element("new_element", scs->capacity());
+  SCS::kkLidView visited("visited", 1);
+  auto moveSpecies = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    if (mask) {
+      new_element(ptcl_id) = 0;
+      Kokkos::atomic_fetch_add(&(visited(0)), 1);
+    }
+  };
+  multi.parallel_for(1, moveSpecies, "move_species");
+  if (getLastValue<lid_t>(visited) != expected[1]) {
+    printf("Species loop visited %d particles instead of %d\n", getLastValue<lid_t>(visited),
+           expected[1]);
+    passed = false;
+  }
+  auto stay = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    if (mask)
+      new_element(ptcl_id) = elm_id;
+  };
+  multi.parallel_for(0, stay, "stay_species");
+  multi.rebuild(new_element);
+  if (multi.nPtcls(0) != expected[0] || multi.nPtcls(1) != expected[1]) {
+    printf("Species counts changed in the rebuild\n");
+    passed = false;
+  }
+  SCS::kkLidView fail("fail", 1);
+  species = scs->get<0>();
+  auto checkElements = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    if (mask && species(ptcl_id) == 1 && elm_id != 0)
+      fail(0) = 1;
+  };
+  scs->parallel_for(checkElements);
+  if (getLastValue<lid_t>(fail)) {
+    printf("Species 1 particles were not moved to element 0\n");
+    passed = false;
+  }
+  delete scs;
+  return passed;
+}
+
+bool streamedTest() {
+  int ne = 20;
+  int np = 200;
+  int* ptcls_per_elem = new int[ne];
+  std::vector<int>* ids = new std::vector<int>[ne];
+  distribute_particles(ne, np, 2, ptcls_per_elem, ids);
+  delete [] ids;
+  Kokkos::TeamPolicy<exe_space> po(128, 4);
+  SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+  SCS::kkGidView element_gids_v("", 0);
+  particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+  delete [] ptcls_per_elem;
+  SCS* scs = new SCS(po, 1, 1024, ne, np, ptcls_per_elem_v, element_gids_v);
+  auto data = scs->get<0>();
+  auto setElements = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    if (mask)
+      data(ptcl_id) = elm_id;
+  };
+  scs->parallel_for(setElements);
+
+  bool passed = true;
+  //Batches of a few chunks go through the device working set
+  scs->evictToHost(16);
+  if (!scs->isEvicted()) {
+    printf("The particle information was not evicted\n");
+    delete scs;
+    return false;
+  }
+  SCS::kkLidView visited("visited", 1);
+  SCS::kkLidView fail("fail", 1);
+  data = scs->get<0>();
+  auto increment = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    if (mask) {
+      if (data(ptcl_id) != elm_id)
+        fail(0) = 1;
+      data(ptcl_id) += 1;
+      Kokkos::atomic_fetch_add(&(visited(0)), 1);
+    }
+  };
+  scs->parallel_for_streamed(increment, "streamed_increment");
+  if (getLastValue<lid_t>(visited) != np || getLastValue<lid_t>(fail)) {
+    printf("Streamed loop visited %d particles instead of %d (fail %d)\n",
+           getLastValue<lid_t>(visited), np, getLastValue<lid_t>(fail));
+    passed = false;
+  }
+  scs->restoreToDevice();
+  data = scs->get<0>();
+  auto checkData = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    if (mask && data(ptcl_id) != elm_id + 1)
+      fail(0) = 1;
+  };
+  scs->parallel_for(checkData);
+  if (getLastValue<lid_t>(fail)) {
+    printf("Streamed updates were not restored to the device\n");
+    passed = false;
+  }
+  delete scs;
+  return passed;
+}
+
+//Structure built with the policy chosen for the backend
+bool autoPolicyTest() {
+  int ne = 40;
+  int np = 400;
+  int* ptcls_per_elem = new int[ne];
+  std::vector<int>* ids = new std::vector<int>[ne];
+  distribute_particles(ne, np, 2, ptcls_per_elem, ids);
+  delete [] ids;
+  SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+  SCS::kkGidView element_gids_v("", 0);
+  particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+  delete [] ptcls_per_elem;
+  SCS* scs = new SCS(INT_MAX, 1024, ne, np, ptcls_per_elem_v, element_gids_v);
+
+  bool passed = true;
+  for (int i = 0; i < 2; ++i) {
+    if (scs->C() < 1 || scs->C() > scs->policyUsed().team_size() ||
+        scs->policyUsed().league_size() < 1) {
+      printf("Chunk height %d does not fit the chosen team size %d (league %d)\n", scs->C(),
+             scs->policyUsed().team_size(), scs->policyUsed().league_size());
+      passed = false;
+    }
+    SCS::kkLidView count("count", 1);
+    SCS::kkLidView new_element("new_element", scs->capacity());
+    auto countParticles = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+      if (mask) {
+        Kokkos::atomic_fetch_add(&(count(0)), 1);
+        new_element(ptcl_id) = (elm_id + ptcl_id) % ne;
+      }
+    };
+    scs->parallel_for(countParticles);
+    if (getLastValue<lid_t>(count) != np) {
+      printf("Visited %d particles instead of %d\n", getLastValue<lid_t>(count), np);
+      passed = false;
+    }
+    scs->setShuffling(false);
+    scs->rebuild(new_element);
+  }
+  delete scs;
+  return passed;
+}
+
+//Counts the particles whose element is not the one stored in their member
+lid_t wrongElements(SCS* scs) {
+  auto elements = scs->get<0>();
+  SCS::kkLidView wrong("wrong", 1);
+  auto checkElement = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    if (mask && elements(ptcl_id) != elm_id)
+      Kokkos::atomic_fetch_add(&(wrong(0)), 1);
+  };
+  scs->parallel_for(checkElement);
+  return getLastValue<lid_t>(wrong);
+}
+
+bool lazyRebuildTest() {
+  int ne = 20;
+  int np = 200;
+  int* ptcls_per_elem = new int[ne];
+  std::vector<int>* ids = new std::vector<int>[ne];
+  distribute_particles(ne, np, 0, ptcls_per_elem, ids);
+  delete [] ids;
+  SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+  SCS::kkGidView element_gids_v("", 0);
+  particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+  delete [] ptcls_per_elem;
+  Kokkos::TeamPolicy<exe_space> policy(10, 4);
+  SCS* scs = new SCS(policy, 5, 10, ne, np, ptcls_per_elem_v, element_gids_v);
+  scs->setLazyRebuild(0.5);
+
+  bool passed = true;
+  /* Steps 0 and 2 move every tenth slot to the next element and remove every fifteenth,
+       which is recorded. Step 1 moves every particle, more than half of them, so the
+       particles are moved. The particles of step 2 are moved by flushLazyRebuild.
+  */
+  for (int step = 0; step < 3; ++step) {
+    const lid_t capacity = scs->capacity();
+    const lid_t old_ptcls = scs->nPtcls();
+    auto elements = scs->get<0>();
+    SCS::kkLidView new_element("new_element", capacity);
+    SCS::kkLidView counts("counts", 2);
+    auto moveParticles = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+      if (mask) {
+        const bool removed = step != 1 && ptcl_id % 15 == 0;
+        const bool moved = !removed && (step == 1 || ptcl_id % 10 == 0);
+        new_element(ptcl_id) = removed ? -1 : (moved ? (elm_id + 1) % ne : elm_id);
+        elements(ptcl_id) = new_element(ptcl_id);
+        Kokkos::atomic_fetch_add(&(counts(0)), (lid_t)moved);
+        Kokkos::atomic_fetch_add(&(counts(1)), (lid_t)removed);
+      }
+    };
+    scs->parallel_for(moveParticles);
+    auto counts_h = particle_structs::deviceToHost(counts);
+    scs->rebuild(new_element);
+    if (step == 2)
+      scs->flushLazyRebuild();
+    const lid_t misplaced = step == 0 ? counts_h(0) : 0;
+    if (scs->numMisplaced() != misplaced) {
+      printf("Step %d left %d particles misplaced instead of %d\n", step, scs->numMisplaced(),
+             misplaced);
+      passed = false;
+    }
+    if (step == 0 && scs->capacity() != capacity) {
+      printf("Lazy rebuild changed the capacity from %d to %d\n", capacity, scs->capacity());
+      passed = false;
+    }
+    if (scs->nPtcls() != old_ptcls - counts_h(1)) {
+      printf("Step %d has %d particles instead of %d\n", step, scs->nPtcls(),
+             old_ptcls - counts_h(1));
+      passed = false;
+    }
+    const lid_t wrong = wrongElements(scs);
+    if (wrong > 0) {
+      printf("Step %d passed the wrong element to %d particles\n", step, wrong);
+      passed = false;
+    }
+  }
+  delete scs;
+  return passed;
+}
+
+//Weight and momentum of the particles of each element and the particles per element
+typedef MemberTypes<double, double[3]> ResampleType;
+typedef SellCSigma<ResampleType> ResampleSCS;
+void elementSums(ResampleSCS* scs, Kokkos::View<double*[4]> sums,
+                 ResampleSCS::kkLidView counts) {
+  Kokkos::deep_copy(sums, 0);
+  Kokkos::deep_copy(counts, 0);
+  auto w = scs->get<0>();
+  auto v = scs->get<1>();
+  auto sumParticles = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    if (mask) {
+      Kokkos::atomic_fetch_add(&(sums(elm_id, 0)), w(ptcl_id));
+      for (int j = 0; j < 3; ++j)
+        Kokkos::atomic_fetch_add(&(sums(elm_id, j + 1)), w(ptcl_id) * v(ptcl_id, j));
+      Kokkos::atomic_fetch_add(&(counts(elm_id)), 1);
+    }
+  };
+  scs->parallel_for(sumParticles);
+}
+
+bool resampleTest() {
+  //Element 0 is merged, element 1 split and elements 2 and 3 are kept
+  const int ne = 4;
+  const lid_t max_ptcls = 20;
+  const lid_t min_ptcls = 5;
+  int ptcls_per_elem[ne] = {30, 3, 10, 0};
+  const lid_t expected[ne] = {20, 5, 10, 0};
+  int np = 0;
+  for (int i = 0; i < ne; ++i)
+    np += ptcls_per_elem[i];
+  ResampleSCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+  ResampleSCS::kkGidView element_gids_v("", 0);
+  particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+  Kokkos::TeamPolicy<exe_space> policy(10, 4);
+  ResampleSCS* scs = new ResampleSCS(policy, 2, 10, ne, np, ptcls_per_elem_v,
+                                     element_gids_v);
+  //Holes are not visited by the resample
+  scs->setSkipEmpty(true, true);
+  auto w = scs->get<0>();
+  auto v = scs->get<1>();
+  auto setParticles = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    if (mask) {
+      w(ptcl_id) = 1 + ptcl_id % 3;
+      for (int j = 0; j < 3; ++j)
+        v(ptcl_id, j) = (ptcl_id % 7) - 3 + j;
+    }
+  };
+  scs->parallel_for(setParticles);
+
+  Kokkos::View<double*[4]> sums("sums", ne);
+  Kokkos::View<double*[4]> new_sums("new_sums", ne);
+  ResampleSCS::kkLidView counts("counts", ne);
+  elementSums(scs, sums, counts);
+  const lid_t changed = scs->resample<0, 1>(max_ptcls, min_ptcls);
+  elementSums(scs, new_sums, counts);
+  auto sums_h = particle_structs::deviceToHost(sums);
+  auto new_sums_h = particle_structs::deviceToHost(new_sums);
+  auto counts_h = particle_structs::deviceToHost(counts);
+
+  bool passed = true;
+  if (changed != 10 + 2) {
+    printf("Resample changed %d particles instead of %d\n", changed, 10 + 2);
+    passed = false;
+  }
+  lid_t total = 0;
+  for (int i = 0; i < ne; ++i) {
+    total += counts_h(i);
+    if (counts_h(i) != expected[i]) {
+      printf("Element %d has %d particles instead of %d after the resample\n", i,
+             counts_h(i), expected[i]);
+      passed = false;
+    }
+    for (int j = 0; j < 4; ++j) {
+      if (fabs(new_sums_h(i, j) - sums_h(i, j)) > 1e-10 * (1 + fabs(sums_h(i, j)))) {
+        printf("Element %d %s changed from %f to %f\n", i, j ? "momentum" : "weight",
+               sums_h(i, j), new_sums_h(i, j));
+        passed = false;
+      }
+    }
+  }
+  if (scs->nPtcls() != total) {
+    printf("Structure has %d particles instead of %d\n", scs->nPtcls(), total);
+    passed = false;
+  }
+  delete scs;
+  return passed;
+}
+
+//Value of each slot, -1 for empty slots
+SCS::kkLidView slotValues(SCS* scs) {
+  SCS::kkLidView slots("slots", scs->capacity());
+  auto values = scs->get<0>();
+  auto setSlots = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+    slots(ptcl_id) = mask ? values(ptcl_id) : -1;
+  };
+  scs->parallel_for(setSlots);
+  return slots;
+}
+
+//The low memory rebuild moves and adds the particles like the rebuild with the swap views
+bool lowMemoryRebuildTest() {
+  int ne = 10;
+  int np = 100;
+  int* ptcls_per_elem = new int[ne];
+  std::vector<int>* ids = new std::vector<int>[ne];
+  distribute_particles(ne, np, 0, ptcls_per_elem, ids);
+  delete [] ids;
+  SCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+  SCS::kkGidView element_gids_v("", 0);
+  particle_structs::hostToDevice(ptcls_per_elem_v, ptcls_per_elem);
+  delete [] ptcls_per_elem;
+  Kokkos::TeamPolicy<exe_space> policy(10, 4);
+  SCS* structures[2];
+  for (int i = 0; i < 2; ++i) {
+    structures[i] = new SCS(policy, 5, 10, ne, np, ptcls_per_elem_v, element_gids_v);
+    structures[i]->setShuffling(false);
+    auto values = structures[i]->get<0>();
+    auto setValues = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+      values(ptcl_id) = mask ? ptcl_id : -1;
+    };
+    structures[i]->parallel_for(setValues);
+  }
+  structures[1]->setLowMemoryRebuild(true);
+
+  bool passed = true;
+  const int num_new = 30;
+  for (int step = 0; step < 2; ++step) {
+    SCS::kkLidView new_particle_elems("new_particle_elems", num_new);
+    auto new_particle_info = particle_structs::createMemberViews<Type>(num_new);
+    auto new_values = particle_structs::getMemberView<Type, 0>(new_particle_info);
+    Kokkos::parallel_for(num_new, KOKKOS_LAMBDA(const int& j) {
+      new_particle_elems(j) = (j * 3) % ne;
+      new_values(j) = 1000 * (step + 1) + j;
+    });
+    for (int i = 0; i < 2; ++i) {
+      SCS* scs = structures[i];
+      SCS::kkLidView new_element("new_element", scs->capacity());
+      auto moveParticles = PS_LAMBDA(const int& elm_id, const int& ptcl_id, const bool& mask) {
+        if (mask)
+          new_element(ptcl_id) = ptcl_id % 7 == 0 ? -1 : (elm_id + ptcl_id % 3) % ne;
+      };
+      scs->parallel_for(moveParticles);
+      scs->rebuild(new_element, new_particle_elems, new_particle_info);
+    }
+    particle_structs::destroyViews<Type>(new_particle_info);
+
+    if (structures[0]->nPtcls() != structures[1]->nPtcls() ||
+        structures[0]->capacity() != structures[1]->capacity()) {
+      printf("Step %d: low memory rebuild has %d particles in %d slots instead of %d in %d\n",
+             step, structures[1]->nPtcls(), structures[1]->capacity(),
+             structures[0]->nPtcls(), structures[0]->capacity());
+      passed = false;
+      break;
+    }
+    auto slots = particle_structs::deviceToHost(slotValues(structures[0]));
+    auto low_slots = particle_structs::deviceToHost(slotValues(structures[1]));
+    lid_t differ = 0;
+    for (lid_t i = 0; i < (lid_t)slots.size(); ++i)
+      differ += slots(i) != low_slots(i);
+    if (differ > 0) {
+      printf("Step %d: %d slots differ after the low memory rebuild\n", step, differ);
+      passed = false;
+    }
+  }
+  delete structures[0];
+  delete structures[1];
+  return passed;
+}
@@ -21,6 +21,7 @@ typedef ps::SCS_Input<Type> Input;
 bool padEvenly(Input& input);
 bool padProportionally(Input& input);
 bool padInversely(Input& input);
+bool padAdaptive(Input& input);
 
 int main(int argc, char* argv[]) {
   MPI_Init(&argc, &argv);
@@ -57,6 +58,10 @@ int main(int argc, char* argv[]) {
       ++fails;
       printf("[ERROR] padInversely() failed\n");
     }
+    if (!padAdaptive(input)) {
+      ++fails;
+      printf("[ERROR] padAdaptive() failed\n");
+    }
   }
   Kokkos::finalize();
   MPI_Finalize();
@@ -112,3 +117,41 @@ bool padInversely(Input& input) {
   delete scs;
   return true;
 }
+
+//Moves every tenth particle to element 0 and returns the empty slots of its rows after a rebuild
+lid_t inflowPadding(Input& input) {
+  SCS* scs = new SCS(input);
+  scs->setShuffling(false);
+  SCS::kkLidView new_element("new_element", scs->capacity());
+  auto moveToFirst = PS_LAMBDA(const lid_t& elem, const lid_t& ptcl, const bool& mask) {
+    if (mask)
+      new_element(ptcl) = ptcl % 10 == 0 ? 0 : elem;
+  };
+  ps::parallel_for(scs, moveToFirst, "pad_move_to_first");
+  scs->rebuild(new_element);
+  SCS::kkLidView empty("empty", 1);
+  auto countEmpty = PS_LAMBDA(const lid_t& elem, const lid_t& ptcl, const bool& mask) {
+    if (!mask && elem == 0)
+      Kokkos::atomic_fetch_add(&(empty(0)), 1);
+  };
+  ps::parallel_for(scs, countEmpty, "pad_count_empty");
+  delete scs;
+  return getLastValue<lid_t>(empty);
+}
+
+//The padding of the adaptive rebuild goes to the chunk of the only element gaining particles
+bool padAdaptive(Input& input) {
+  input.padding_strat = ps::PAD_EVENLY;
+  const lid_t even_padding = inflowPadding(input);
+  input.padding_strat = ps::PAD_ADAPTIVE;
+  input.inflow_smoothing = 1;
+  const lid_t adaptive_padding = inflowPadding(input);
+  printf("\nPadAdaptive\nEmpty slots of the inflow element %d (%d padded evenly)\n",
+         adaptive_padding, even_padding);
+  if (adaptive_padding <= even_padding) {
+    printf("Adaptive padding gave the inflow element %d empty slots, not more than the %d "
+           "of even padding\n", adaptive_padding, even_padding);
+    return false;
+  }
+  return true;
+}
@@ -62,10 +62,8 @@ int main(int argc, char* argv[]) {
     fails += addSCSs(structures, names, num_elems, num_ptcls, ppe, element_gids,
                      particle_elements, particle_info);
     //Add CSR
-    /* Uncomment when CSR is being implemented
     fails += addCSRs(structures, names, num_elems, num_ptcls, ppe, element_gids,
                      particle_elements, particle_info);
-    */
 
 
 
@@ -10,10 +10,17 @@ add_test(NAME rebuild COMMAND ./rebuild)
 
 add_test(NAME lambdaTest COMMAND ./lambdaTest)
 
+add_test(NAME aosoaTest COMMAND ./aosoaTest)
+
 add_test(NAME migrateNothing COMMAND ./migrateTest)
 
 add_test(NAME migrate4 COMMAND mpirun -np 4 ./migrateTest)
 
+add_test(NAME benchmark_small COMMAND ./scs_benchmark -e 100 -p 1000 -d 0,1,2,3 -C 4,32
+  -s 1,1024 -V 32 -r 2 -o benchmark_small.json)
+add_test(NAME benchmark_small_4 COMMAND mpirun -np 4 ./scs_benchmark -e 100 -p 1000 -d 1
+  -o benchmark_small_4.json)
+
 add_test(NAME write_ptcl_small COMMAND ./write_particles 5 25 0 0 small_ptcls_e5_p25_r0)
 add_test(NAME write_ptcl_small_4 COMMAND mpirun -np 4 ./write_particles 5 25 0 2
   small_ptcls_e5_p25_r4)
@@ -9,6 +9,8 @@
 
 using particle_structs::SellCSigma;
 using particle_structs::MemberTypes;
+using particle_structs::Compact;
+using particle_structs::WithLayout;
 using particle_structs::distribute_elements;
 using particle_structs::distribute_particles;
 
@@ -18,6 +20,9 @@ int main(int argc, char** argv) {
   typedef MemberTypes<int> Type1;
   typedef MemberTypes<int,double[2]> Type2;
   typedef MemberTypes<int[3],double[2],char> Type3;
+  typedef MemberTypes<Compact<double[3], float>, int> Type4;
+  typedef MemberTypes<WithLayout<double[3], Kokkos::LayoutLeft>, int,
+                      WithLayout<Compact<double[2], float>, Kokkos::LayoutRight> > Type5;
 
   printf("Type1: %lu\n",Type1::memsize);
   PS_ALWAYS_ASSERT(Type1::memsize == sizeof(int));
@@ -27,6 +32,10 @@ int main(int argc, char** argv) {
   PS_ALWAYS_ASSERT(Type3::memsize == 3*sizeof(int) + 2*sizeof(double) + sizeof(char));
   printf("Type3 start of doubles: %lu\n",Type3::sizeToIndex<1>());
   PS_ALWAYS_ASSERT(Type3::sizeToIndex<1>() == 3*sizeof(int));
+  printf("Type4: %lu\n",Type4::memsize);
+  PS_ALWAYS_ASSERT(Type4::memsize == 3*sizeof(float) + sizeof(int));
+  printf("Type5: %lu\n",Type5::memsize);
+  PS_ALWAYS_ASSERT(Type5::memsize == 3*sizeof(double) + sizeof(int) + 2*sizeof(float));
 
   int ne = 5;
   int np = 10;
@@ -65,6 +74,101 @@ int main(int argc, char** argv) {
     scs->parallel_for(setValues);
     delete scs;
   }
+  {
+    //Reduced precision member is written and read through the compute type
+    typedef SellCSigma<Type4> CompactSCS;
+    CompactSCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+    CompactSCS::kkGidView element_gids_v("", 0);
+    Kokkos::deep_copy(ptcls_per_elem_v, np / ne);
+    CompactSCS* scs = new CompactSCS(po, 1, 10000, ne, np, ptcls_per_elem_v, element_gids_v);
+    auto pos = scs->get<0>(); //float[3] storing double[3]
+    auto elem = scs->get<1>();
+    auto setValues = PS_LAMBDA(int element_id, int particle_id, bool mask) {
+      if (mask) {
+        elem(particle_id) = element_id;
+        for (int i = 0; i < 3; ++i) {
+          pos(particle_id, i) = element_id / 3.0;
+          pos(particle_id, i) += i;
+        }
+      }
+    };
+    scs->parallel_for(setValues);
+    //Move every particle to the next element so the compact form is copied
+    CompactSCS::kkLidView new_element("new_element", scs->capacity());
+    auto moveParticles = PS_LAMBDA(int element_id, int particle_id, bool mask) {
+      new_element(particle_id) = mask ? (element_id + 1) % ne : -1;
+    };
+    scs->parallel_for(moveParticles);
+    scs->rebuild(new_element);
+    Kokkos::View<int*> fails("fails", 1);
+    auto checkValues = PS_LAMBDA(int element_id, int particle_id, bool mask) {
+      if (mask) {
+        if (elem(particle_id) != (element_id + ne - 1) % ne)
+          Kokkos::atomic_fetch_add(&fails(0), 1);
+        for (int i = 0; i < 3; ++i) {
+          const double x = pos(particle_id, i);
+          const double expected = elem(particle_id) / 3.0 + i;
+          if (x - expected > 1e-6 || expected - x > 1e-6)
+            Kokkos::atomic_fetch_add(&fails(0), 1);
+        }
+      }
+    };
+    scs->parallel_for(checkValues);
+    PS_ALWAYS_ASSERT(particle_structs::getLastValue<int>(fails) == 0);
+    delete scs;
+  }
+  {
+    //Members in an explicit layout are indexed the same and survive a rebuild
+    typedef SellCSigma<Type5> LayoutSCS;
+    LayoutSCS::kkLidView ptcls_per_elem_v("ptcls_per_elem_v", ne);
+    LayoutSCS::kkGidView element_gids_v("", 0);
+    Kokkos::deep_copy(ptcls_per_elem_v, np / ne);
+    LayoutSCS* scs = new LayoutSCS(po, 1, 10000, ne, np, ptcls_per_elem_v, element_gids_v);
+    auto pos = scs->get<0>(); //double[3] in LayoutLeft
+    auto elem = scs->get<1>();
+    auto weights = scs->get<2>(); //float[2] storing double[2] in LayoutRight
+    static_assert(std::is_same<decltype(pos)::ViewType::array_layout,
+                  Kokkos::LayoutLeft>::value, "position member is not in LayoutLeft");
+    static_assert(std::is_same<decltype(weights)::ViewType::array_layout,
+                  Kokkos::LayoutRight>::value, "weight member is not in LayoutRight");
+    auto setValues = PS_LAMBDA(int element_id, int particle_id, bool mask) {
+      if (mask) {
+        elem(particle_id) = element_id;
+        for (int i = 0; i < 3; ++i)
+          pos(particle_id, i) = element_id + i / 4.0;
+        weights(particle_id, 0) = element_id;
+        weights(particle_id, 1) = -element_id;
+      }
+    };
+    scs->parallel_for(setValues);
+    LayoutSCS::kkLidView new_element("new_element", scs->capacity());
+    auto moveParticles = PS_LAMBDA(int element_id, int particle_id, bool mask) {
+      new_element(particle_id) = mask ? (element_id + 1) % ne : -1;
+    };
+    scs->parallel_for(moveParticles);
+    scs->rebuild(new_element);
+    pos = scs->get<0>();
+    elem = scs->get<1>();
+    weights = scs->get<2>();
+    Kokkos::View<int*> fails("fails", 1);
+    auto checkValues = PS_LAMBDA(int element_id, int particle_id, bool mask) {
+      if (mask) {
+        const int old_element = elem(particle_id);
+        if (old_element != (element_id + ne - 1) % ne)
+          Kokkos::atomic_fetch_add(&fails(0), 1);
+        for (int i = 0; i < 3; ++i)
+          if (pos(particle_id, i) != old_element + i / 4.0)
+            Kokkos::atomic_fetch_add(&fails(0), 1);
+        const double w0 = weights(particle_id, 0);
+        const double w1 = weights(particle_id, 1);
+        if (w0 != old_element || w1 != -old_element)
+          Kokkos::atomic_fetch_add(&fails(0), 1);
+      }
+    };
+    scs->parallel_for(checkValues);
+    PS_ALWAYS_ASSERT(particle_structs::getLastValue<int>(fails) == 0);
+    delete scs;
+  }
 
   Kokkos::finalize();
   MPI_Finalize();
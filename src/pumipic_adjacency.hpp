@@ -2,6 +2,7 @@
 #define PUMIPIC_ADJACENCY_HPP
 
 #include <iostream>
+#include <cfloat>
 
 #include "Omega_h_for.hpp"
 #include "Omega_h_adj.hpp"
@@ -14,6 +15,7 @@
 #include "pumipic_constants.hpp"
 #include "pumipic_kktypes.hpp"
 #include "pumipic_profiling.hpp"
+#include "pumipic_mesh.hpp"
 
 namespace o = Omega_h;
 namespace ps = particle_structs;
@@ -232,6 +234,155 @@ OMEGA_H_INLINE bool line_triangle_intx_simple(const Omega_h::Few<Omega_h::Vector
   return found;
 }
 
+/* Mixed precision containment tests (SearchContext::setMixedPrecision)
+     The barycentric coordinates are first evaluated in float relative to the first vertex
+     of the element along with a bound on their rounding error. Only coordinates within
+     that bound of -tol are re-evaluated with barycentric_tri or find_barycentric_tet, so
+     the result is always the one of the double precision test.
+*/
+//Returns 1 if pos is certainly in the triangle, 0 if it certainly is not (with min3 of the
+//coordinates in min_edge) and -1 if the test must be done in double precision
+OMEGA_H_DEVICE int classify_tri_float(const o::Matrix<TriDim, TriVerts> &faceCoords,
+                                      const o::Vector<TriDim> &pos,
+                                      const o::Real parent_area, const o::Real tol,
+                                      int& min_edge) {
+  const float u = FLT_EPSILON;
+  float x[3][2], p[2];
+  for(int c=0; c<2; ++c) {
+    p[c] = (float)(pos[c] - faceCoords[0][c]);
+    for(int v=0; v<3; ++v)
+      x[v][c] = (float)(faceCoords[v][c] - faceCoords[0][c]);
+  }
+  const float inv_area = 1.0f / (float)parent_area;
+  float bcc[3], err[3];
+  bool inside = true, outside = false;
+  for(int i=0; i<3; i++) {
+    const auto k = simplex_down_template(o::FACE, o::EDGE, i, 0);
+    const auto l = simplex_down_template(o::FACE, o::EDGE, i, 1);
+    const float ax = x[l][0] - x[k][0], ay = x[l][1] - x[k][1];
+    const float bx = p[0] - x[k][0], by = p[1] - x[k][1];
+    const float mag = (fabsf(x[l][0]) + fabsf(x[k][0])) * (fabsf(p[1]) + fabsf(x[k][1])) +
+                      (fabsf(x[l][1]) + fabsf(x[k][1])) * (fabsf(p[0]) + fabsf(x[k][0]));
+    bcc[i] = 0.5f * (ax * by - ay * bx) * inv_area;
+    err[i] = 16 * u * (0.5f * mag * inv_area + fabsf(bcc[i]));
+    inside = inside && bcc[i] - err[i] > -tol;
+    outside = outside || bcc[i] + err[i] < -tol;
+  }
+  if(inside)
+    return 1;
+  if(!outside)
+    return -1;
+  int idx = (bcc[0] < bcc[1]) ? 0 : 1;
+  idx = (bcc[idx] < bcc[2]) ? idx : 2;
+  for(int i=0; i<3; i++)
+    if(i != idx && bcc[i] - err[i] <= bcc[idx] + err[idx])
+      return -1;
+  min_edge = idx;
+  return 0;
+}
+
+//Returns 1 if pos is certainly in the tet, 0 if it certainly is not and -1 if the test
+//must be done in double precision
+OMEGA_H_DEVICE int classify_tet_float(const o::Matrix<DIM, 4> &Mat,
+                                      const o::Vector<DIM> &pos, const o::Real tol) {
+  const float u = FLT_EPSILON;
+  float x[4][3], p[3];
+  float h = 0, P = 0;
+  for(int c=0; c<3; ++c) {
+    p[c] = (float)(pos[c] - Mat[0][c]);
+    P = fmaxf(P, fabsf(p[c]));
+    for(int v=0; v<4; ++v) {
+      x[v][c] = (float)(Mat[v][c] - Mat[0][c]);
+      h = fmaxf(h, fabsf(x[v][c]));
+    }
+  }
+  P = fmaxf(P, h);
+  float vals[4];
+  for(int iface=0; iface<4; ++iface) {
+    const float* a = x[simplex_down_template(DIM, FDIM, iface, 0)];
+    const float* b = x[simplex_down_template(DIM, FDIM, iface, 1)];
+    const float* c = x[simplex_down_template(DIM, FDIM, iface, 2)];
+    const float ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    const float ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    const float ap[3] = {p[0] - a[0], p[1] - a[1], p[2] - a[2]};
+    vals[iface] = ap[0] * (ac[1] * ab[2] - ac[2] * ab[1]) +
+                  ap[1] * (ac[2] * ab[0] - ac[0] * ab[2]) +
+                  ap[2] * (ac[0] * ab[1] - ac[1] * ab[0]);
+  }
+  //volume using bottom face=0 as find_barycentric_tet
+  const float* a = x[simplex_down_template(DIM, FDIM, 0, 0)];
+  const float* b = x[simplex_down_template(DIM, FDIM, 0, 1)];
+  const float* c = x[simplex_down_template(DIM, FDIM, 0, 2)];
+  const float* d = x[simplex_opposite_template(DIM, FDIM, 0)];
+  const float ab[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+  const float ac[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+  const float ad[3] = {d[0] - a[0], d[1] - a[1], d[2] - a[2]};
+  const float vol6 = ad[0] * (ac[1] * ab[2] - ac[2] * ab[1]) +
+                     ad[1] * (ac[2] * ab[0] - ac[0] * ab[2]) +
+                     ad[2] * (ac[0] * ab[1] - ac[1] * ab[0]);
+  const float err_vol = 512 * u * h * h * h;
+  const float err_val = 512 * u * h * h * P;
+  if(vol6 - err_vol <= EPSILON)
+    return -1;
+  bool inside = true, outside = false;
+  for(int i=0; i<4; ++i) {
+    const float bcc = vals[i] / vol6;
+    const float err = (err_val + fabsf(bcc) * err_vol) / (vol6 - err_vol) + 4 * u * fabsf(bcc);
+    inside = inside && bcc - err > -tol;
+    outside = outside || bcc + err < -tol;
+  }
+  if(inside)
+    return 1;
+  return outside ? 0 : -1;
+}
+
+//all_positive(bcc, tol) of find_barycentric_tet(M, pos, bcc), tried in float if mixed
+OMEGA_H_DEVICE bool tet_contains(const o::Matrix<DIM, 4> &M, const o::Vector<DIM> &pos,
+                                 const bool mixed, const o::Real tol = 0) {
+  if(mixed) {
+    const int inside = classify_tet_float(M, pos, tol);
+    if(inside >= 0)
+      return inside;
+  }
+  o::Vector<4> bcc;
+  find_barycentric_tet(M, pos, bcc);
+  return all_positive(bcc, tol);
+}
+
+//tet_contains that also sets the double precision bcc whenever false is returned
+OMEGA_H_DEVICE bool tet_contains(const o::Matrix<DIM, 4> &M, const o::Vector<DIM> &pos,
+                                 o::Vector<4> &bcc, const bool mixed,
+                                 const o::Real tol = 0) {
+  if(mixed && classify_tet_float(M, pos, tol) == 1)
+    return true;
+  find_barycentric_tet(M, pos, bcc);
+  return all_positive(bcc, tol);
+}
+
+//all_positive(bcc, tol) of barycentric_tri, tried in float if mixed
+//  min_edge is set to min3(bcc) whenever false is returned
+OMEGA_H_DEVICE bool tri_contains(const o::Reals triArea,
+                                 const o::Matrix<TriDim, TriVerts> &faceCoords,
+                                 const o::Vector<TriDim> &pos, const int searchElm,
+                                 const bool mixed, const o::Real tol, int& min_edge) {
+  if(mixed) {
+    const int inside = classify_tri_float(faceCoords, pos, triArea[searchElm], tol, min_edge);
+    if(inside >= 0)
+      return inside;
+  }
+  o::Vector<3> bcc;
+  barycentric_tri(triArea, faceCoords, pos, bcc, searchElm);
+  min_edge = min3(bcc);
+  return all_positive(bcc, tol);
+}
+
+template <int N, typename Segment>
+OMEGA_H_DEVICE o::Vector<N> makeVector(int pid, Segment xyz) {
+  o::Vector<N> v;
+  for(int i=0; i<N; ++i)
+    v[i] = xyz(pid,i);
+  return v;
+}
 template <typename Segment>
 OMEGA_H_DEVICE o::Vector<3> makeVector3(int pid, Segment xyz) {
   o::Vector<3> v;
@@ -258,332 +409,1417 @@ OMEGA_H_DEVICE o::Matrix<3, 4> gatherVectors4x3(o::Reals const& a, o::Few<o::LO,
   return o::gather_vectors<4, 3>(a, v);
 }
 
-//How to avoid redefining the MemberType? each application will define it
-//differently. Templating search_mesh with
-//template < typename ParticleType >
-//results in an error on get<> as an unresolved function.
+/* Compact device buffer of the particles leaving the domain through an exposed side
 
-template < class ParticleType>
-bool search_mesh(o::Mesh& mesh, ps::ParticleStructure< ParticleType >* ptcls,
-                 Segment3d x_ps_d, Segment3d xtgt_ps_d, SegmentInt pid_d,
-                 o::Write<o::LO> elem_ids, o::Write<o::Real> xpoints_d,
-                 o::Write<o::LO> xface_id, int looplimit=0) {
-  const int debug = 0;
-
-  const auto dual = mesh.ask_dual();
-  const auto down_r2f = mesh.ask_down(3, 2);
-  const auto side_is_exposed = mark_exposed_sides(&mesh);
-  const auto mesh2verts = mesh.ask_elem_verts();
-  const auto coords = mesh.coords();
-  const auto face_verts =  mesh.ask_verts_of(2);
-  const auto down_r2fs = down_r2f.ab2b;
-  const auto dual_faces = dual.ab2b;
-  const auto dual_elems = dual.a2ab;
+   Every exit found by search_mesh, search_mesh_walk and search_mesh_team appends the
+   particle slot, the last element it was in, the exposed side (mesh face), the exit point
+   and the fraction of the segment from the particle position to its target before the
+   exit. The particle data is unchanged by the search, so wall models read it through the
+   slots until the next rebuild.
 
-  const auto psCapacity = ptcls->capacity();
+   count keeps growing past capacity so overflow is detected with size() > capacity, only
+   the first capacity exits are stored. Filled through SearchContext::enableBoundaryBuffer.
+*/
+struct BoundaryHits {
+  BoundaryHits() : capacity(0) {}
+  explicit BoundaryHits(o::LO cap) :
+    count(1, 0, "boundary_hits_count"), ptcls(cap, "boundary_hits_ptcls"),
+    elems(cap, "boundary_hits_elems"), sides(cap, "boundary_hits_sides"),
+    xpoints(3 * cap, "boundary_hits_xpoints"), fractions(cap, "boundary_hits_fractions"),
+    capacity(cap) {}
+  bool enabled() const {return capacity > 0;}
+  //Number of exits since the last clear (may exceed capacity)
+  o::LO size() const {return enabled() ? o::HostRead<o::LO>(o::LOs(count))[0] : 0;}
+  void clear() {
+    if (enabled())
+      o::fill(count, 0);
+  }
+  OMEGA_H_DEVICE void append(const o::LO pid, const o::LO elm, const o::LO side,
+                             const o::Vector<3>& xpoint, const o::Real t) const {
+    if (capacity == 0)
+      return;
+    const o::LO i = Kokkos::atomic_fetch_add(&count[0], 1);
+    if (i >= capacity)
+      return;
+    ptcls[i] = pid;
+    elems[i] = elm;
+    sides[i] = side;
+    for (int c = 0; c < 3; ++c)
+      xpoints[i * 3 + c] = xpoint[c];
+    fractions[i] = t;
+  }
 
-  // ptcl_done[i] = 1 : particle i has hit a boundary or reached its destination
-  o::Write<o::LO> ptcl_done(psCapacity, 1, "ptcl_done");
-  // particle intersection points
-  o::Write<o::Real> xpoints(3*psCapacity, 0);
-  // store the next parent for each particle
-  o::Write<o::LO> elem_ids_next(psCapacity,-1);
-  // flag to move origin if intersection fails
-  auto lamb = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
-    if(mask > 0) {
-      elem_ids[pid] = e;
-      ptcl_done[pid] = 0;
-      if (debug)
-        printf("pid %3d mask %1d elem_ids %6d\n", pid, mask, elem_ids[pid]);
-    } else {
-      elem_ids[pid] = -1;
-      ptcl_done[pid] = 1;
+  o::Write<o::LO> count;
+  o::Write<o::LO> ptcls;
+  o::Write<o::LO> elems;
+  o::Write<o::LO> sides;
+  o::Write<o::Real> xpoints;
+  o::Write<o::Real> fractions;
+  o::LO capacity;
+};
+
+//Fraction of the segment orig->dest before point x on it
+OMEGA_H_DEVICE o::Real segment_fraction(const o::Vector<3>& orig, const o::Vector<3>& dest,
+                                        const o::Vector<3>& x) {
+  const o::Real len = o::norm(dest - orig);
+  return len > 0 ? o::norm(x - orig) / len : 0;
+}
+
+/* Mesh adjacency and scratch arrays reused by every search on one mesh
+
+   The connectivity, exposed side flags and element measures needed by search_mesh
+   (3d) or search_mesh_2d (2d) are computed once at construction. The per particle
+   scratch arrays only grow when the particle structure capacity exceeds their size.
+   The mesh topology must not change while the context is in use, updateCoordinates()
+   refreshes the geometry after the mesh vertices move.
+
+   cacheGeometry() optionally stores the outward plane of every element side so the
+   searches find element exits with a few dot products instead of gathering vertices for
+   barycentric coordinates and face intersections. clearGeometryCache() drops it.
+
+   setMixedPrecision(true) evaluates the barycentric containment tests in float first,
+   falling back to double only when the float result is within its rounding error of the
+   tolerance. Search results are unchanged, see classify_tri_float/classify_tet_float.
+
+   enableContinuation(picparts) lets search_mesh_2d_continued hand particles that leave
+   the buffered region of the picpart over to the rank owning the last element reached.
+
+   enableStatistics() makes the searches count crossings, domain exits and element visits
+   until resetStatistics(). Without it no counting is done.
+
+   setStartFromElemIds(true) makes search_mesh and search_mesh_2d start each particle
+   from the element in elem_ids (from the previous search) instead of its element in the
+   particle structure, so particles can be searched several times between rebuilds.
+   Particles starting in element -1 are skipped.
+
+   enableBoundaryBuffer(capacity) makes the 3d searches append the particles leaving the
+   domain to a BoundaryHits buffer, kept until clearBoundaryBuffer().
+
+   setStayed(flags) marks particles whose target is known to be in their current element
+   (i.e. tested by the push), search_mesh and search_mesh_2d finish them in that element
+   without walking. The flags, sized by the capacity of the structure, only apply to
+   searches starting from the elements of the particle structure and are kept until
+   clearStayed().
+
+   Usage:
+     SearchContext search(picparts);
+     while (stepping) {
+       ...
+       search_mesh_2d(search, ptcls, x, xtgt, pid, elem_ids, maxLoops);
+     }
+*/
+class SearchContext {
+public:
+  explicit SearchContext(o::Mesh& mesh) {
+    build(mesh);
+  }
+  explicit SearchContext(Mesh& picparts) {
+    build(*picparts.mesh());
+  }
+  int dim() const {return mesh_dim;}
+  bool hasGeometryCache() const {return side_planes.exists();}
+  void setMixedPrecision(bool on) {mixed = on;}
+  bool mixedPrecision() const {return mixed;}
+  void setStartFromElemIds(bool on) {start_from_ids = on;}
+  bool startFromElemIds() const {return start_from_ids;}
+  void setStayed(o::Read<o::I8> flags) {stayed = flags;}
+  void clearStayed() {stayed = o::Read<o::I8>();}
+  bool hasStayed() const {return stayed.exists();}
+  bool hasContinuation() const {return part_boundary.exists();}
+  bool hasStatistics() const {return crossing_histogram.exists();}
+  //Buffer of the next capacity domain exits, see BoundaryHits
+  void enableBoundaryBuffer(o::LO capacity) {
+    if (mesh_dim != 3) {
+      fprintf(stderr, "[ERROR] The boundary buffer is only supported by the 3d searches\n");
+      return;
     }
-  };
-  ps::parallel_for(ptcls, lamb, "init_search");
-  bool found = false;
-  int loops = 0;
-  while(!found) {
-    if(debug) {
-      fprintf(stderr, "------------ %d ------------\n", loops);
-    }
-    //pid is same for a particle between iterations in this while loop
-    auto lamb = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
-      //inactive particle that is still moving to its target position
-      if( mask > 0 && !ptcl_done[pid] ) {
-        auto elmId = e;
-        auto ptcl = pid_d(pid);
-        if(debug)
-          printf("Elem %d ptcl: %d\n", elmId, ptcl);
-        if(elmId != elem_ids[pid]) {
-          elmId = elem_ids[pid];
-          if(debug)
-            printf("Switching: Elem %d ptcl: %d\n", elmId, ptcl);
+    boundary_buffer = BoundaryHits(capacity);
+    updateMemory();
+  }
+  void disableBoundaryBuffer() {
+    boundary_buffer = BoundaryHits();
+    updateMemory();
+  }
+  void clearBoundaryBuffer() {boundary_buffer.clear();}
+  bool hasBoundaryBuffer() const {return boundary_buffer.enabled();}
+  const BoundaryHits& boundaryBuffer() const {return boundary_buffer;}
+
+  /* Accumulates statistics of every search using this context
+       crossingHistogram: particles per number of elements crossed in one search, the last
+                          of num_bins bins holds num_bins-1 or more crossings
+       boundaryHits: particles that left the domain through an exposed side
+       elementVisits: times each element was checked by a walking particle
+       elementStragglers: particles starting in each element that landed in the last bin
+                          or were not found within the loop limit
+  */
+  void enableStatistics(int num_bins = 64) {
+    if (num_bins < 2) {
+      fprintf(stderr, "[ERROR] Search statistics need at least 2 bins\n");
+      return;
+    }
+    crossing_histogram = o::Write<o::LO>(num_bins, 0, "search_crossing_histogram");
+    element_visits = o::Write<o::LO>(num_elems, 0, "search_element_visits");
+    element_stragglers = o::Write<o::LO>(num_elems, 0, "search_element_stragglers");
+    boundary_hits = o::Write<o::LO>(1, 0, "search_boundary_hits");
+    const o::LO capacity = scratch_size > 0 ? scratch_size : 0;
+    ptcl_crossings = o::Write<o::LO>(capacity, -1, "search_ptcl_crossings");
+    ptcl_start = o::Write<o::LO>(capacity, -1, "search_ptcl_start");
+    updateMemory();
+  }
+  void resetStatistics() {
+    if (!hasStatistics())
+      return;
+    o::fill(crossing_histogram, 0);
+    o::fill(element_visits, 0);
+    o::fill(element_stragglers, 0);
+    o::fill(boundary_hits, 0);
+  }
+  o::LOs crossingHistogram() const {return o::LOs(crossing_histogram);}
+  o::LOs elementVisits() const {return o::LOs(element_visits);}
+  o::LOs elementStragglers() const {return o::LOs(element_stragglers);}
+  o::LO boundaryHits() const {return o::HostRead<o::LO>(o::LOs(boundary_hits))[0];}
+
+  //Adds the crossings of the last search of capacity particle slots to the histogram
+  void accumulateStatistics(o::LO capacity) {
+    const auto crossings = ptcl_crossings;
+    const auto start = ptcl_start;
+    const auto done = ptcl_done;
+    auto histogram = crossing_histogram;
+    auto stragglers = element_stragglers;
+    const o::LO last_bin = crossing_histogram.size() - 1;
+    auto binCrossings = OMEGA_H_LAMBDA(const o::LO& pid) {
+      const o::LO c = crossings[pid];
+      if (c < 0)
+        return;
+      const o::LO bin = c < last_bin ? c : last_bin;
+      Kokkos::atomic_add(&histogram[bin], 1);
+      if (bin == last_bin || !done[pid])
+        Kokkos::atomic_add(&stragglers[start[pid]], 1);
+    };
+    o::parallel_for(capacity, binCrossings, "search_bin_crossings");
+  }
+
+  /* Marks the exposed sides of the picpart that are interior to the full mesh
+       search_mesh_2d stops particles crossing them in the last element reached instead of
+       removing them, see search_mesh_2d_continued. Collective over the ranks of picparts.
+  */
+  void enableContinuation(Mesh& picparts) {
+    if (mesh_dim != 2) {
+      fprintf(stderr, "[ERROR] Search continuation is only supported by search_mesh_2d\n");
+      return;
+    }
+    const int dim = mesh_dim;
+    const o::LO nsides = mesh_ptr->nents(dim - 1);
+    o::Write<o::I8> boundary(nsides, 0, "search_part_boundary");
+    //Every side of a full mesh picpart is interior or on the model boundary
+    if (!picparts.isFullMesh()) {
+      const int rank = picparts.comm()->rank();
+      const auto owners = picparts.entOwners(dim);
+      const auto sides2elems = mesh_ptr->ask_up(dim - 1, dim);
+      const auto s2e_offsets = sides2elems.a2ab;
+      const auto s2e_vals = sides2elems.ab2b;
+      //Elements of the full mesh bounded by each side, each counted by its owner
+      o::Write<o::LO> full_elems = picparts.createCommArray<o::LO>(dim - 1, 1, 0);
+      auto countOwnedElems = OMEGA_H_LAMBDA(const o::LO& side) {
+        for (o::LO i = s2e_offsets[side]; i < s2e_offsets[side + 1]; ++i)
+          full_elems[side] += owners[s2e_vals[i]] == rank;
+      };
+      o::parallel_for(nsides, countOwnedElems, "search_count_owned_elems");
+      picparts.reduceCommArray(dim - 1, Mesh::SUM_OP, full_elems);
+      const auto exposed = side_is_exposed;
+      auto markPartBoundary = OMEGA_H_LAMBDA(const o::LO& side) {
+        boundary[side] = exposed[side] && full_elems[side] > 1;
+      };
+      o::parallel_for(nsides, markPartBoundary, "search_mark_part_boundary");
+    }
+    part_boundary = boundary;
+    updateMemory();
+  }
+
+  /* Precomputes the outward unit normal and offset of each side of every element
+       Costs (dim+1)^2 reals and 2*(dim+1) integers per element
+  */
+  void cacheGeometry() {
+    if (hasGeometryCache())
+      return;
+    const int dim = mesh_dim;
+    const int nsides = dim + 1;
+    const o::LO nelems = mesh_ptr->nelems();
+    const auto elem2sides = mesh_ptr->ask_down(dim, dim - 1).ab2b;
+    const auto side2verts = mesh_ptr->ask_verts_of(dim - 1);
+    const auto sides2elems = mesh_ptr->ask_up(dim - 1, dim);
+    const auto s2e_offsets = sides2elems.a2ab;
+    const auto s2e_vals = sides2elems.ab2b;
+    const auto elm2verts = elem_verts;
+    const auto coords_l = coords;
+    o::Write<o::Real> planes(nsides * nsides * nelems, "search_side_planes");
+    o::Write<o::LO> adj(nsides * nelems, "search_side_adj");
+    o::Write<o::LO> ents(nsides * nelems, "search_side_ents");
+    auto buildPlanes = OMEGA_H_LAMBDA(const o::LO& e) {
+      o::Real centroid[3] = {0, 0, 0};
+      for (int v = 0; v < nsides; ++v)
+        for (int c = 0; c < dim; ++c)
+          centroid[c] += coords_l[elm2verts[e * nsides + v] * dim + c] / nsides;
+      for (int s = 0; s < nsides; ++s) {
+        const o::LO side = elem2sides[e * nsides + s];
+        o::Real a[3] = {0, 0, 0}, ab[3] = {0, 0, 0}, ac[3] = {0, 0, 0}, n[3] = {0, 0, 0};
+        for (int c = 0; c < dim; ++c) {
+          a[c] = coords_l[side2verts[side * dim] * dim + c];
+          ab[c] = coords_l[side2verts[side * dim + 1] * dim + c] - a[c];
+          if (dim == 3)
+            ac[c] = coords_l[side2verts[side * dim + 2] * dim + c] - a[c];
         }
-        OMEGA_H_CHECK(elmId >= 0);
-        auto tetv2v = o::gather_verts<4>(mesh2verts, elmId);
-        auto M = gatherVectors4x3(coords, tetv2v);
-        auto dest = makeVector3(pid, xtgt_ps_d);
-        auto orig = makeVector3(pid, x_ps_d);
-        Omega_h::Vector<4> bcc;
-        if(loops == 0) {
-          //make sure particle origin is in initial element
-          find_barycentric_tet(M, orig, bcc);
-          if(!all_positive(bcc, 0)) {
-            printf("ptcl %d elem %d => %d orig %.3f %.3f %.3f dest %.3f %.3f %.3f\n",
-              ptcl, e, elmId, orig[0], orig[1], orig[2], dest[0], dest[1], dest[2]);
-            printf("Particle doesn't belong to this element at loops=0");
-            OMEGA_H_CHECK(false);
-          }
+        if (dim == 3) {
+          n[0] = ab[1] * ac[2] - ab[2] * ac[1];
+          n[1] = ab[2] * ac[0] - ab[0] * ac[2];
+          n[2] = ab[0] * ac[1] - ab[1] * ac[0];
         }
-        //check if the destination is this element
-        find_barycentric_tet(M, dest, bcc);
-        if(all_positive(bcc, 0)) {
-          if(debug)
-            printf("ptcl %d is in destination elm %d\n", ptcl, elmId);
-          elem_ids_next[pid] = elem_ids[pid];
-          ptcl_done[pid] = 1;
-        } else {
-          if(debug)
-            printf("ptcl %d checking adj elms\n", ptcl);
-          //get element ID
-          auto dface_ind = dual_elems[elmId];
-          const auto beg_face = elmId *4;
-          const auto end_face = beg_face +4;
-          o::LO f_index = 0;
-          bool detected = false;
-          for(auto iface = beg_face; iface < end_face; ++iface) {
-            const auto face_id = down_r2fs[iface];
-            auto xpoint = o::zero_vector<3>();
-            bool exposed = side_is_exposed[face_id];
-            auto fv2v = o::gather_verts<3>(face_verts, face_id);
-            const auto face = gatherVectors3x3(coords, fv2v);
-            o::LO matInd1 = getfmap(f_index*2);
-            o::LO matInd2 = getfmap(f_index*2+1);
-            bool inverse = true;
-            if(fv2v[1] == tetv2v[matInd1] && fv2v[2] == tetv2v[matInd2])
-              inverse = false;
-
-            detected = line_triangle_intx_simple(face, orig, dest, xpoint, inverse);
-            if(debug)
-              printf("\t :ptcl %d faceid %d flipped %d exposed %d detected %d\n", ptcl,
-                face_id, inverse, exposed, detected);
-
-            if(detected && exposed) {
-              ptcl_done[pid] = 1;
-              for(o::LO i=0; i<3; ++i)
-                xpoints[pid*3+i] = xpoint[i];
-              elem_ids_next[pid] = -1;
-              if(debug) {
-                printf("ptcl %d faceid %d detected and exposed, next parent elm %d\n",
-                    ptcl, face_id, elem_ids_next[pid]);
-              }
-              break;
-            } else if(detected && !exposed) {
-              auto adj_elem  = dual_faces[dface_ind];
-              elem_ids_next[pid] = adj_elem;
-              if(debug) {
-                printf("ptcl %d faceid %d detected and !exposed, next parent elm %d\n",
-                    ptcl, face_id, elem_ids_next[pid]);
-              }
-              break;
-            }
-            // no line triangle intersection found for the current face
-            // appears to be a guess at the next element based on the smallest BCC
-            if(!exposed) {
-              if(debug)
-                printf("ptcl %d faceid %d !detected and !exposed\n", pid, face_id);
-              ++dface_ind;
-              const o::LO min_ind = min_index(bcc, 4);
-              if(f_index == min_ind) {
-                elem_ids_next[pid] = dual_faces[dface_ind];
-              }
-            }
-            ++f_index;
-          } //for iface
-
-        } //else not in current element
-      } //if active particle
+        else {
+          n[0] = ab[1];
+          n[1] = -ab[0];
+        }
+        o::Real len = 0, d = 0, toCentroid = 0;
+        for (int c = 0; c < dim; ++c)
+          len += n[c] * n[c];
+        len = std::sqrt(len);
+        for (int c = 0; c < dim; ++c) {
+          n[c] /= len;
+          d += n[c] * a[c];
+          toCentroid += n[c] * centroid[c];
+        }
+        //The centroid must be behind each outward plane
+        const o::Real sign = toCentroid > d ? -1 : 1;
+        for (int c = 0; c < dim; ++c)
+          planes[(c * nsides + s) * nelems + e] = sign * n[c];
+        planes[(dim * nsides + s) * nelems + e] = sign * d;
+        o::LO other = -1;
+        for (o::LO k = s2e_offsets[side]; k < s2e_offsets[side + 1]; ++k)
+          if (s2e_vals[k] != e)
+            other = s2e_vals[k];
+        adj[e * nsides + s] = other;
+        ents[e * nsides + s] = side;
+      }
     };
+    o::parallel_for(nelems, buildPlanes, "search_side_planes");
+    side_planes = planes;
+    side_adj = adj;
+    side_ents = ents;
+    num_elems = nelems;
+    updateMemory();
+  }
 
-    ps::parallel_for(ptcls, lamb, "adj_search");
+  //Drops the side planes, the searches use the mesh coordinates again
+  void clearGeometryCache() {
+    side_planes = o::Reals();
+    side_adj = o::LOs();
+    side_ents = o::LOs();
+    updateMemory();
+  }
 
-    found = true;
-    auto cp_elm_ids = OMEGA_H_LAMBDA( o::LO i) {
-      elem_ids[i] = elem_ids_next[i];
-    };
-    o::parallel_for(elem_ids.size(), cp_elm_ids, "copy_elem_ids");
+  /* Reads the vertex coordinates of the mesh again after they changed (i.e. set_coords)
+       The element areas (2d) and the geometry cache, when present, are recomputed
+  */
+  void updateCoordinates() {
+    coords = mesh_ptr->coords();
+    if (mesh_dim == 2)
+      tri_area = measure_elements_real(mesh_ptr);
+    if (hasGeometryCache()) {
+      clearGeometryCache();
+      cacheGeometry();
+    }
+  }
 
-    o::LOs ptcl_done_r(ptcl_done);
-    auto minFlag = o::get_min(ptcl_done_r);
-    if(minFlag == 0)
-      found = false;
-    //Copy particle data from previous to next (adjacent) element
-    ++loops;
+  //Grows the scratch arrays to hold at least capacity particles
+  void reserve(o::LO capacity) {
+    if (capacity <= scratch_size)
+      return;
+    scratch_size = capacity;
+    ptcl_done = o::Write<o::LO>(capacity, 1, "ptcl_done");
+    buffer_exit = o::Write<o::LO>(capacity, -1, "buffer_exit");
+    worklist = o::Write<o::LO>(capacity, "search_worklist");
+    worklist_next = o::Write<o::LO>(capacity, "search_worklist_next");
+    if (mesh_dim == 3)
+      xpoints = o::Write<o::Real>(3 * capacity, 0, "xpoints");
+    if (hasStatistics()) {
+      ptcl_crossings = o::Write<o::LO>(capacity, -1, "search_ptcl_crossings");
+      ptcl_start = o::Write<o::LO>(capacity, -1, "search_ptcl_start");
+    }
+    updateMemory();
+  }
 
-    if(looplimit && loops > looplimit) {
-      if (debug)
-        fprintf(stderr, "ERROR:loop limit %d exceeded\n", looplimit);
-      break;
+  o::Reals coords;
+  o::Read<o::I8> side_is_exposed;
+  o::LOs elem_verts;
+  //3d: element to face, element to element across faces and face to vertex
+  o::LOs down_r2fs;
+  o::LOs dual_faces;
+  o::LOs dual_elems;
+  o::LOs face_verts;
+  //2d: face to edge, edge to face CSR and face areas
+  o::LOs face_edges;
+  o::LOs e2f_vals;
+  o::LOs e2f_offsets;
+  o::Reals tri_area;
+  //Optional cache: component c (normal components then offset) of side s of element e at
+  //  (c * (dim+1) + s) * num_elems + e, the element across and the mesh side at e*(dim+1)+s
+  o::Reals side_planes;
+  o::LOs side_adj;
+  o::LOs side_ents;
+  o::LO num_elems;
+  //Searches start from the elements of elem_ids
+  bool start_from_ids;
+  //Optional: 1 for particles whose target is in their element of the particle structure
+  o::Read<o::I8> stayed;
+  //2d: edge to vertex, locates the exit points of the walks
+  o::LOs edge_verts;
+  //Optional continuation: sides on the picpart boundary interior to the full mesh and the
+  //  continuation round of search_mesh_2d_continued (0 outside of it)
+  o::Read<o::I8> part_boundary;
+  int continuation_round;
+
+  //Scratch per particle slot
+  o::Write<o::LO> ptcl_done;
+  //3d: exit points of the particles leaving the domain
+  o::Write<o::Real> xpoints;
+  //Picpart boundary side crossed by particles that left the buffered region, -1 if none
+  o::Write<o::LO> buffer_exit;
+  //Optional statistics, see enableStatistics
+  o::Write<o::LO> crossing_histogram;
+  o::Write<o::LO> element_visits;
+  o::Write<o::LO> element_stragglers;
+  o::Write<o::LO> boundary_hits;
+  //Elements crossed in the current search (-1 for empty slots) and starting element per slot
+  o::Write<o::LO> ptcl_crossings;
+  o::Write<o::LO> ptcl_start;
+  //Slots of the particles still searching, the list of the next pass is built in worklist_next
+  o::Write<o::LO> worklist;
+  o::Write<o::LO> worklist_next;
+  //Optional compact list of domain exits, see enableBoundaryBuffer
+  BoundaryHits boundary_buffer;
+  //Bytes of the arrays owned by the context, tracked as pumipic_search
+  ps::TrackedBytes memory;
+
+private:
+  template <typename T>
+  static long long arrayBytes(const o::Read<T>& a) {
+    return a.exists() ? (long long)a.size() * sizeof(T) : 0;
+  }
+  //The mesh adjacencies are held by the mesh and not counted
+  void updateMemory() {
+    long long bytes = arrayBytes(side_planes) + arrayBytes(side_adj) +
+      arrayBytes(side_ents) + arrayBytes(part_boundary);
+    bytes += arrayBytes(o::Read<o::LO>(ptcl_done)) + arrayBytes(o::Read<o::Real>(xpoints)) +
+      arrayBytes(o::Read<o::LO>(buffer_exit)) + arrayBytes(o::Read<o::LO>(worklist)) +
+      arrayBytes(o::Read<o::LO>(worklist_next));
+    bytes += arrayBytes(o::Read<o::LO>(crossing_histogram)) +
+      arrayBytes(o::Read<o::LO>(element_visits)) +
+      arrayBytes(o::Read<o::LO>(element_stragglers)) +
+      arrayBytes(o::Read<o::LO>(boundary_hits)) + arrayBytes(o::Read<o::LO>(ptcl_crossings)) +
+      arrayBytes(o::Read<o::LO>(ptcl_start));
+    if (boundary_buffer.enabled()) {
+      const long long cap = boundary_buffer.capacity;
+      bytes += sizeof(o::LO) * (1 + 3 * cap) + sizeof(o::Real) * 4 * cap;
     }
+    memory.track("pumipic_search", bytes);
   }
-  return found;
+
+  void build(o::Mesh& mesh) {
+    mesh_ptr = &mesh;
+    mesh_dim = mesh.dim();
+    num_elems = mesh.nelems();
+    scratch_size = -1;
+    mixed = false;
+    start_from_ids = false;
+    continuation_round = 0;
+    coords = mesh.coords();
+    side_is_exposed = mark_exposed_sides(&mesh);
+    elem_verts = mesh.ask_elem_verts();
+    if (mesh_dim == 3) {
+      const auto dual = mesh.ask_dual();
+      dual_faces = dual.ab2b;
+      dual_elems = dual.a2ab;
+      down_r2fs = mesh.ask_down(3, 2).ab2b;
+      face_verts = mesh.ask_verts_of(2);
+    }
+    else {
+      const auto edges2faces = mesh.ask_up(o::EDGE, o::FACE);
+      face_edges = mesh.ask_down(o::FACE, o::EDGE).ab2b;
+      e2f_vals = edges2faces.ab2b;
+      e2f_offsets = edges2faces.a2ab;
+      tri_area = measure_elements_real(&mesh);
+      edge_verts = mesh.ask_verts_of(o::EDGE);
+    }
+  }
+  o::Mesh* mesh_ptr;
+  int mesh_dim;
+  o::LO scratch_size;
+  bool mixed;
+};
+
+/* Device copyable counters of SearchContext::enableStatistics used inside the searches
+     Every call is a no-op when the statistics are not enabled
+*/
+struct SearchStats {
+  explicit SearchStats(const SearchContext& s) :
+    enabled(s.hasStatistics()), crossings(s.ptcl_crossings), start_elem(s.ptcl_start),
+    visits(s.element_visits), hits(s.boundary_hits) {}
+
+  OMEGA_H_DEVICE void start(const o::LO pid, const o::LO elm, const bool active) const {
+    if(enabled) {
+      crossings[pid] = active ? 0 : -1;
+      start_elem[pid] = elm;
+    }
+  }
+  OMEGA_H_DEVICE void visit(const o::LO elm) const {
+    if(enabled)
+      Kokkos::atomic_add(&visits[elm], 1);
+  }
+  OMEGA_H_DEVICE void cross(const o::LO pid, const int n = 1) const {
+    if(enabled)
+      crossings[pid] += n;
+  }
+  OMEGA_H_DEVICE void exitDomain() const {
+    if(enabled)
+      Kokkos::atomic_add(&hits[0], 1);
+  }
+  //Records a particle walked from elm in one kernel, crossing n elements
+  OMEGA_H_DEVICE void walked(const o::LO pid, const o::LO elm, const int n,
+                             const bool left_domain) const {
+    start(pid, elm, true);
+    cross(pid, n);
+    if(left_domain)
+      exitDomain();
+  }
+
+  bool enabled;
+  o::Write<o::LO> crossings;
+  o::Write<o::LO> start_elem;
+  o::Write<o::LO> visits;
+  o::Write<o::LO> hits;
+};
+
+/* Exit of the segment orig->dest from element elm using the planes of SearchContext
+     Returns -1 if dest is inside every side plane (within tol), otherwise the local side
+     the segment leaves through and t, the fraction of the segment before that side
+*/
+template <int DIM>
+OMEGA_H_DEVICE o::LO side_exit(const o::Reals& planes, const o::LO nelems, const o::LO elm,
+                               const o::Vector<DIM>& orig, const o::Vector<DIM>& dest,
+                               o::Real& t, const o::Real tol = EPSILON) {
+  const int nsides = DIM + 1;
+  o::LO exit_side = -1;
+  t = 1;
+  for (int s = 0; s < nsides; ++s) {
+    const o::Real d = planes[(DIM * nsides + s) * nelems + elm];
+    o::Real dist_orig = -d, dist_dest = -d;
+    for (int c = 0; c < DIM; ++c) {
+      const o::Real n = planes[(c * nsides + s) * nelems + elm];
+      dist_orig += n * orig[c];
+      dist_dest += n * dest[c];
+    }
+    if (dist_dest > tol) {
+      const o::Real ts = dist_dest > dist_orig ? dist_orig / (dist_orig - dist_dest) : 0;
+      if (exit_side < 0 || ts < t) {
+        exit_side = s;
+        t = ts;
+      }
+    }
+  }
+  return exit_side;
 }
 
-template < class ParticleStruct>
-bool search_mesh_2d(o::Mesh& mesh, // (in) mesh
-                 ParticleStruct* ptcls, // (in) particle structure
-                 Segment3d x_ps_d, // (in) starting particle positions
-                 Segment3d xtgt_ps_d, // (in) target particle positions
-                 SegmentInt pid_d, // (in) particle ids
-                 o::Write<o::LO> elem_ids, // (out) parent element ids for the target positions
-                 int looplimit=0) {
-  const auto btime = pumipic_prebarrier();
-  Kokkos::Profiling::pushRegion("pumpipic_search_mesh_2d");
-  Kokkos::Timer timer;
+/* Marks every slot of policy done and not in an element
+     The search kernels skip the empty slots when the structure skips them (setSkipEmpty),
+     so the slots of holes would keep the state of the previous search
+*/
+template <class Policy>
+inline void reset_search_slots(const Policy& policy, o::Write<o::LO> ptcl_done,
+                               o::Write<o::LO> elem_ids) {
+  Kokkos::parallel_for("pumipic_reset_search_slots", policy, KOKKOS_LAMBDA(const o::LO& pid) {
+    ptcl_done[pid] = 1;
+    elem_ids[pid] = -1;
+  });
+}
+
+/* Writes the unfinished particles among the first count entries of worklist into next
+     When all_slots is true worklist is ignored and particle slots [0, count) are checked
+     Returns the number of unfinished particles written
+*/
+inline o::LO compact_unfinished(o::Write<o::LO> ptcl_done, o::Write<o::LO> worklist,
+                                o::LO count, o::Write<o::LO> next, bool all_slots = false) {
+  o::LO num_unfinished = 0;
+  Kokkos::parallel_scan("pumipic_compact_unfinished", count,
+    KOKKOS_LAMBDA(const o::LO& i, o::LO& offset, const bool& final) {
+      const o::LO pid = all_slots ? i : worklist[i];
+      if (!ptcl_done[pid]) {
+        if (final)
+          next[offset] = pid;
+        ++offset;
+      }
+    }, num_unfinished);
+  return num_unfinished;
+}
+
+/* Finds where a particle moving from orig to dest leaves tet elmId
+     bcc holds the barycentric coordinates of dest in elmId (dest is not in elmId)
+     Returns true if the particle leaves the domain through an exposed face, next is set to
+       -1, xpoint to the intersection and exit_face (if given) to the face. Otherwise next is the adjacent element across the
+       intersected face, or the guess from the smallest barycentric coordinate if no
+       intersection is detected (next is unchanged if there is neither).
+*/
+OMEGA_H_DEVICE bool tet_exit(const o::LOs& mesh2verts, const o::Reals& coords,
+                             const o::LOs& face_verts, const o::LOs& down_r2fs,
+                             const o::LOs& dual_faces, const o::LOs& dual_elems,
+                             const o::Read<o::I8>& side_is_exposed, const o::LO elmId,
+                             const o::Few<o::LO, 4>& tetv2v, const o::Vector<4>& bcc,
+                             const o::Vector<3>& orig, const o::Vector<3>& dest,
+                             o::LO& next, o::Vector<3>& xpoint, o::LO* exit_face = NULL) {
+  auto dface_ind = dual_elems[elmId];
+  const auto beg_face = elmId *4;
+  const auto end_face = beg_face +4;
+  o::LO f_index = 0;
+  for(auto iface = beg_face; iface < end_face; ++iface) {
+    const auto face_id = down_r2fs[iface];
+    xpoint = o::zero_vector<3>();
+    bool exposed = side_is_exposed[face_id];
+    auto fv2v = o::gather_verts<3>(face_verts, face_id);
+    const auto face = gatherVectors3x3(coords, fv2v);
+    o::LO matInd1 = getfmap(f_index*2);
+    o::LO matInd2 = getfmap(f_index*2+1);
+    bool inverse = true;
+    if(fv2v[1] == tetv2v[matInd1] && fv2v[2] == tetv2v[matInd2])
+      inverse = false;
+
+    const bool detected = line_triangle_intx_simple(face, orig, dest, xpoint, inverse);
+    if(detected && exposed) {
+      next = -1;
+      if(exit_face)
+        *exit_face = face_id;
+      return true;
+    } else if(detected && !exposed) {
+      next = dual_faces[dface_ind];
+      return false;
+    }
+    // no line triangle intersection found for the current face
+    // appears to be a guess at the next element based on the smallest BCC
+    if(!exposed) {
+      ++dface_ind;
+      const o::LO min_ind = min_index(bcc, 4);
+      if(f_index == min_ind)
+        next = dual_faces[dface_ind];
+    }
+    ++f_index;
+  }
+  return false;
+}
+
+//Last element, exposed side and segment fraction of a particle leaving the domain
+struct DomainExit {
+  OMEGA_H_DEVICE DomainExit() : elm(-1), face(-1), t(0) {}
+  o::LO elm;
+  o::LO face;
+  o::Real t;
+};
+
+//Outcome of one step of a walk, see TetWalk::step
+enum WalkStep {
+  WALK_INSIDE,  //dest is in the element
+  WALK_CROSSED, //next is the element across the side the segment leaves through
+  WALK_EXITED,  //the segment leaves the domain (or picpart) through an exposed side
+  WALK_NO_EXIT  //no side was intersected and the guess is an exposed side
+};
+
+/* Device copyable walk of one particle through the mesh shared by the walk and team searches
+     Moves elm toward dest crossing at most looplimit elements (0 for no limit), crossings
+     counts the elements left. Returns 1 if the walk ended, dest is in elm or elm is -1
+     after leaving the domain (with the exit point in xpoint and the exit in exit), and 0 at
+     the loop limit or when no exit of elm is found (elm is the last element reached).
+     Without a loop limit a walk stops after crossing as many elements as the mesh has, a
+     segment does not enter a tet twice so only a cycle of guesses gets there.
+   step() checks one element, the worklist searches call it once per pass.
+*/
+struct TetWalk {
+  explicit TetWalk(const SearchContext& s) :
+    mesh2verts(s.elem_verts), coords(s.coords), face_verts(s.face_verts),
+    down_r2fs(s.down_r2fs), dual_faces(s.dual_faces), dual_elems(s.dual_elems),
+    side_is_exposed(s.side_is_exposed), side_planes(s.side_planes), side_adj(s.side_adj),
+    side_ents(s.side_ents), nelems(s.num_elems), cached(s.hasGeometryCache()),
+    mixed(s.mixedPrecision()), stats(s) {}
+
+  enum {dim = 3, verts = 4};
+  //Tolerances of the origin and destination tests of the walk and team searches
+  OMEGA_H_INLINE static constexpr o::Real originTol() {return 0;}
+  OMEGA_H_INLINE static constexpr o::Real destTol() {return 0;}
+
+  //Vertex coordinates of element elm
+  OMEGA_H_DEVICE o::Matrix<3, 4> elementCoords(const o::LO elm) const {
+    return gatherVectors4x3(coords, o::gather_verts<4>(mesh2verts, elm));
+  }
+  //True if p is in element elm with vertex coordinates M
+  OMEGA_H_DEVICE bool contains(const o::Matrix<3, 4>& M, const o::LO, const o::Vector<3>& p,
+                               const o::Real tol) const {
+    return tet_contains(M, p, mixed, tol);
+  }
+  //True if p is in element elm, the side planes are only exact to EPSILON
+  OMEGA_H_DEVICE bool contains(const o::LO elm, const o::Vector<3>& p,
+                               const o::Real tol = 0) const {
+    if(cached) {
+      o::Real t;
+      return side_exit<3>(side_planes, nelems, elm, p, p, t, tol > EPSILON ? tol : EPSILON) < 0;
+    }
+    return tet_contains(gatherVectors4x3(coords, o::gather_verts<4>(mesh2verts, elm)), p,
+                        mixed, tol);
+  }
+
+  OMEGA_H_DEVICE o::LO operator()(o::LO& elm, const o::Vector<3>& orig,
+                                  const o::Vector<3>& dest, const int looplimit,
+                                  int& crossings, o::Vector<3>& xpoint) const {
+    DomainExit exit;
+    return (*this)(elm, orig, dest, looplimit, crossings, xpoint, exit);
+  }
+  OMEGA_H_DEVICE o::LO operator()(o::LO& elm, const o::Vector<3>& orig,
+                                  const o::Vector<3>& dest, const int looplimit,
+                                  int& crossings, o::Vector<3>& xpoint,
+                                  DomainExit& exit) const {
+    const int limit = looplimit ? looplimit : nelems;
+    while(true) {
+      OMEGA_H_CHECK(elm >= 0);
+      stats.visit(elm);
+      o::LO next = elm;
+      const int status = step(elm, orig, dest, next, xpoint, exit);
+      if(status == WALK_INSIDE)
+        return 1;
+      if(crossings >= limit || status == WALK_NO_EXIT)
+        return 0;
+      ++crossings;
+      elm = next;
+      if(elm < 0)
+        return 1;
+    }
+  }
+
+  /* Checks if the segment orig->dest ends in element elm, see WalkStep
+       next is the element across the side left (-1 for exposed sides), on WALK_EXITED
+       xpoint is the exit point and exit the exit of elm
+  */
+  OMEGA_H_DEVICE int step(const o::LO elm, const o::Vector<3>& orig, const o::Vector<3>& dest,
+                          o::LO& next, o::Vector<3>& xpoint, DomainExit& exit) const {
+    if(cached) {
+      o::Real t;
+      const o::LO side = side_exit<3>(side_planes, nelems, elm, orig, dest, t);
+      if(side < 0)
+        return WALK_INSIDE;
+      next = side_adj[elm * 4 + side];
+      if(next >= 0)
+        return WALK_CROSSED;
+      for(o::LO i=0; i<3; ++i)
+        xpoint[i] = orig[i] + t * (dest[i] - orig[i]);
+      exit.elm = elm;
+      exit.face = side_ents[elm * 4 + side];
+      exit.t = t;
+      return WALK_EXITED;
+    }
+    const auto tetv2v = o::gather_verts<4>(mesh2verts, elm);
+    Omega_h::Vector<4> bcc;
+    if(tet_contains(gatherVectors4x3(coords, tetv2v), dest, bcc, mixed))
+      return WALK_INSIDE;
+    next = elm;
+    if(tet_exit(mesh2verts, coords, face_verts, down_r2fs, dual_faces, dual_elems,
+                side_is_exposed, elm, tetv2v, bcc, orig, dest, next, xpoint, &exit.face)) {
+      exit.elm = elm;
+      exit.t = segment_fraction(orig, dest, xpoint);
+      return WALK_EXITED;
+    }
+    return next == elm ? WALK_NO_EXIT : WALK_CROSSED;
+  }
+
+  o::LOs mesh2verts;
+  o::Reals coords;
+  o::LOs face_verts;
+  o::LOs down_r2fs;
+  o::LOs dual_faces;
+  o::LOs dual_elems;
+  o::Read<o::I8> side_is_exposed;
+  o::Reals side_planes;
+  o::LOs side_adj;
+  o::LOs side_ents;
+  o::LO nelems;
+  bool cached;
+  bool mixed;
+  SearchStats stats;
+};
+
+/* 2d version of TetWalk, particles leaving the domain end with elm = -1
+     Without a loop limit a walk also stops after crossing as many elements as the mesh
+     has, a cycle of edge guesses between triangles would otherwise never end.
+*/
+struct TriWalk {
+  explicit TriWalk(const SearchContext& s) :
+    faces2verts(s.elem_verts), coords(s.coords), faceEdges(s.face_edges),
+    triArea(s.tri_area), e2f_vals(s.e2f_vals), e2f_offsets(s.e2f_offsets),
+    side_is_exposed(s.side_is_exposed), edge_verts(s.edge_verts), side_planes(s.side_planes),
+    side_adj(s.side_adj), side_ents(s.side_ents), nelems(s.num_elems),
+    cached(s.hasGeometryCache()), mixed(s.mixedPrecision()), stats(s) {}
+
+  enum {dim = 2, verts = 3};
+  OMEGA_H_INLINE static constexpr o::Real originTol() {return 1e-8;}
+  OMEGA_H_INLINE static constexpr o::Real destTol() {return EPSILON;}
+
+  OMEGA_H_DEVICE o::Matrix<2, 3> elementCoords(const o::LO elm) const {
+    return o::gather_vectors<3,2>(coords, o::gather_verts<3>(faces2verts, elm));
+  }
+  OMEGA_H_DEVICE bool contains(const o::Matrix<2, 3>& M, const o::LO elm,
+                               const o::Vector<2>& p, const o::Real tol) const {
+    int minEdge;
+    return tri_contains(triArea, M, p, elm, mixed, tol, minEdge);
+  }
+  //True if p is in element elm
+  OMEGA_H_DEVICE bool contains(const o::LO elm, const o::Vector<2>& p,
+                               const o::Real tol = EPSILON) const {
+    if(cached) {
+      o::Real t;
+      return side_exit<2>(side_planes, nelems, elm, p, p, t, tol) < 0;
+    }
+    const auto faceVerts = o::gather_verts<3>(faces2verts, elm);
+    int minEdge;
+    return tri_contains(triArea, o::gather_vectors<3,2>(coords, faceVerts), p, elm, mixed,
+                        tol, minEdge);
+  }
+
+  OMEGA_H_DEVICE o::LO operator()(o::LO& elm, const o::Vector<2>& orig,
+                                  const o::Vector<2>& dest, const int looplimit,
+                                  int& crossings) const {
+    auto xpoint = o::zero_vector<2>();
+    DomainExit exit;
+    return (*this)(elm, orig, dest, looplimit, crossings, xpoint, exit);
+  }
+  OMEGA_H_DEVICE o::LO operator()(o::LO& elm, const o::Vector<2>& orig,
+                                  const o::Vector<2>& dest, const int looplimit,
+                                  int& crossings, o::Vector<2>& xpoint,
+                                  DomainExit& exit) const {
+    const int limit = looplimit ? looplimit : nelems;
+    while(true) {
+      stats.visit(elm);
+      o::LO next = -1;
+      const int status = step(elm, orig, dest, next, xpoint, exit);
+      if(status == WALK_INSIDE)
+        return 1;
+      if(crossings >= limit)
+        return 0;
+      ++crossings;
+      elm = next;
+      if(elm < 0)
+        return 1;
+    }
+  }
+
+  //See TetWalk::step, the exit point is on the edge left (clamped to the segment)
+  OMEGA_H_DEVICE int step(const o::LO elm, const o::Vector<2>& orig, const o::Vector<2>& dest,
+                          o::LO& next, o::Vector<2>& xpoint, DomainExit& exit) const {
+    o::LO bridge;
+    o::Real t = 0;
+    if(cached) {
+      const o::LO side = side_exit<2>(side_planes, nelems, elm, orig, dest, t);
+      if(side < 0)
+        return WALK_INSIDE;
+      next = side_adj[elm * 3 + side];
+      bridge = side_ents[elm * 3 + side];
+    } else {
+      const auto faceVerts = o::gather_verts<3>(faces2verts, elm);
+      int minEdge;
+      if(tri_contains(triArea, o::gather_vectors<3,2>(coords, faceVerts), dest, elm, mixed,
+                      EPSILON, minEdge))
+        return WALK_INSIDE;
+      const auto edges = o::gather_down<3>(faceEdges, elm);
+      bridge = edges[minEdge];
+      next = -1;
+      //leaves domain if exposed
+      if(!side_is_exposed[bridge]) {
+        const auto e2f_first = e2f_offsets[bridge];
+        assert(e2f_offsets[bridge+1] - e2f_first == 2);
+        const auto faceA = e2f_vals[e2f_first];
+        const auto faceB = e2f_vals[e2f_first+1];
+        assert(faceA == elm || faceB == elm);
+        next = (faceA == elm) ? faceB : faceA;
+      } else {
+        const auto line = dest - orig;
+        const auto a = o::get_vector<2>(coords, edge_verts[bridge*2]);
+        const auto edge = o::get_vector<2>(coords, edge_verts[bridge*2+1]) - a;
+        const o::Real denom = o::cross(line, edge);
+        t = denom != 0 ? o::cross(a - orig, edge) / denom : 0;
+        t = t < 0 ? 0 : (t > 1 ? 1 : t);
+      }
+    }
+    if(next >= 0)
+      return WALK_CROSSED;
+    for(int j=0; j<2; ++j)
+      xpoint[j] = orig[j] + t * (dest[j] - orig[j]);
+    exit.elm = elm;
+    exit.face = bridge;
+    exit.t = t;
+    return WALK_EXITED;
+  }
+
+  o::LOs faces2verts;
+  o::Reals coords;
+  o::LOs faceEdges;
+  o::Reals triArea;
+  o::LOs e2f_vals;
+  o::LOs e2f_offsets;
+  o::Read<o::I8> side_is_exposed;
+  o::LOs edge_verts;
+  o::Reals side_planes;
+  o::LOs side_adj;
+  o::LOs side_ents;
+  o::LO nelems;
+  bool cached;
+  bool mixed;
+  SearchStats stats;
+};
+
+//Walk of each dimension, see TetWalk
+template <int DIM> struct SimplexWalk;
+template <> struct SimplexWalk<3> {typedef TetWalk type;};
+template <> struct SimplexWalk<2> {typedef TriWalk type;};
+
+//Exit point and boundary hit of a particle leaving the domain (3d only)
+OMEGA_H_DEVICE void record_exit(const BoundaryHits& hits, const o::Write<o::Real>& xpoints,
+                                const o::LO pid, const DomainExit& exit,
+                                const o::Vector<3>& xpoint) {
+  for(o::LO i=0; i<3; ++i)
+    xpoints[pid*3+i] = xpoint[i];
+  hits.append(pid, exit.elm, exit.face, xpoint, exit.t);
+}
+OMEGA_H_DEVICE void record_exit(const BoundaryHits&, const o::Write<o::Real>&, const o::LO,
+                                const DomainExit&, const o::Vector<2>&) {}
+
+template <int N>
+OMEGA_H_DEVICE void origin_not_in_element(const int rank, const o::LO ptcl, const o::LO elm,
+                                          const o::Vector<N>& orig) {
+  printf("%d Particle not in element! ptcl %d elem %d orig", rank, ptcl, elm);
+  for(int i=0; i<N; ++i)
+    printf(" %.15f", orig[i]);
+  printf("\n");
+  OMEGA_H_CHECK(false);
+}
 
+//Records and prints the time and crossings (or passes) of a search
+inline void report_search(const std::string& name, double seconds, double btime,
+                          int loops, const char* loops_label = "max crossings") {
   int rank, comm_size;
   MPI_Comm_rank(MPI_COMM_WORLD,&rank);
   MPI_Comm_size(MPI_COMM_WORLD,&comm_size);
+  ps::addRegionTime(name, seconds);
+  ps::addRegionTime(name + "_prebarrier", btime);
+  ps::addToCounter(name + "_loops", loops);
+  if((!rank || rank == comm_size/2) && ps::timePrintsEnabled()) {
+    fprintf(stderr, "%d %s (seconds) %f pre-barrier (seconds) %f\n",
+        rank, name.c_str(), seconds, btime);
+    fprintf(stderr, "%d %s %s %d\n", rank, name.c_str(), loops_label, loops);
+  }
+}
+
+/* Single kernel searches of either dimension
+     walk_search - each thread walks its particle to the destination
+     team_search - one team per element (row) of a SellCSigma stages the vertex coordinates
+                   of its element in scratch memory, only particles leaving the element
+                   read the mesh arrays
+   DIM selects the walk (SimplexWalk), so the 2d and 3d searches share the kernels,
+   diagnostics and reporting. Each particle stops after crossing looplimit elements (0 for
+   no limit). Particles leaving the domain end with elem_ids -1, in 3d with the exit point
+   in search.xpoints and a boundary hit.
+     name - region, timer and counter (name_loops) of the search
+*/
+template <int DIM, class ParticleStruct>
+bool walk_search(SearchContext& search, ParticleStruct* ptcls, Segment3d x_ps_d,
+                 Segment3d xtgt_ps_d, SegmentInt pid_d, o::Write<o::LO> elem_ids,
+                 int looplimit, const std::string& name, const std::string& kernel) {
+  typedef typename SimplexWalk<DIM>::type Walk;
+  const auto btime = pumipic_prebarrier();
+  ps::recordImbalance(name, btime, ptcls->nPtcls());
+  Kokkos::Profiling::pushRegion(name);
+  ps::MemoryPhase memory_phase(name);
+  Kokkos::Timer timer;
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
   const auto rank_d = rank;
 
-  const auto faces2edges = mesh.ask_down(o::FACE, o::EDGE);
-  const auto edges2faces = mesh.ask_up(o::EDGE, o::FACE);
-  const auto side_is_exposed = mark_exposed_sides(&mesh);
-  const auto faces2verts = mesh.ask_elem_verts();
-  const auto coords = mesh.coords();
-  const auto edge_verts =  mesh.ask_verts_of(o::EDGE);
-  const auto faceEdges = faces2edges.ab2b;
-  const auto triArea = measure_elements_real(&mesh);
+  const auto psCapacity = ptcls->capacity();
+  search.reserve(psCapacity);
+  auto ptcl_done = search.ptcl_done;
+  reset_search_slots(ptcls->rangePolicy(psCapacity), ptcl_done, elem_ids);
+  auto xpoints = search.xpoints;
+  const Walk walker(search);
+  const SearchStats stats(search);
+  const BoundaryHits hits = search.boundaryBuffer();
+  Kokkos::View<int> max_crossings("max_crossings");
+  auto walk = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask > 0) {
+      const auto dest = makeVector<DIM>(pid, xtgt_ps_d);
+      const auto orig = makeVector<DIM>(pid, x_ps_d);
+      //make sure particle origin is in initial element
+      if(!walker.contains(e, orig, Walk::originTol()))
+        origin_not_in_element(rank_d, pid_d(pid), e, orig);
+      o::LO elmId = e;
+      int crossings = 0;
+      auto xpoint = o::zero_vector<DIM>();
+      DomainExit exit;
+      const o::LO done = walker(elmId, orig, dest, looplimit, crossings, xpoint, exit);
+      if(elmId < 0)
+        record_exit(hits, xpoints, pid, exit, xpoint);
+      if(!done)
+        printf("rank %d elm %d ptcl %d not found after %d crossings\n",
+            rank_d, elmId, pid_d(pid), crossings);
+      elem_ids[pid] = elmId;
+      ptcl_done[pid] = done;
+      stats.walked(pid, e, crossings, elmId < 0);
+      Kokkos::atomic_fetch_max(&max_crossings(), crossings);
+    } else {
+      elem_ids[pid] = -1;
+      ptcl_done[pid] = 1;
+      stats.start(pid, e, false);
+    }
+  };
+  ps::parallel_for(ptcls, walk, kernel);
+  int loops = 0;
+  //The walk ran on the instance of the particles, wait on it before the omega_h reductions
+  Kokkos::deep_copy(ptcls->executionSpace(), loops, max_crossings);
+  ptcls->executionSpace().fence();
+  if(stats.enabled)
+    search.accumulateStatistics(psCapacity);
+  const bool found = psCapacity == 0 || o::get_min(o::LOs(ptcl_done)) == 1;
+  if(!found)
+    fprintf(stderr, "ERROR:loop limit %d exceeded\n", looplimit);
+  ps::recordKernelWork(name, 0, ptcls->nPtcls());
+  report_search(name, timer.seconds(), btime, loops);
+  Kokkos::Profiling::popRegion();
+  return found;
+}
+
+template <int DIM, class SCS>
+bool team_search(SearchContext& search, SCS* ptcls, Segment3d x_ps_d, Segment3d xtgt_ps_d,
+                 SegmentInt pid_d, o::Write<o::LO> elem_ids, int looplimit,
+                 const std::string& name, const std::string& kernel) {
+  typedef typename SimplexWalk<DIM>::type Walk;
+  typedef typename SCS::TeamMember TeamMember;
+  typedef typename SCS::RowParticles RowParticles;
+  const auto btime = pumipic_prebarrier();
+  ps::recordImbalance(name, btime, ptcls->nPtcls());
+  Kokkos::Profiling::pushRegion(name);
+  ps::MemoryPhase memory_phase(name);
+  Kokkos::Timer timer;
 
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  const auto rank_d = rank;
+
+  const auto nelems = search.num_elems;
   const auto psCapacity = ptcls->capacity();
+  search.reserve(psCapacity);
+  auto ptcl_done = search.ptcl_done;
+  reset_search_slots(ptcls->rangePolicy(psCapacity), ptcl_done, elem_ids);
+  auto xpoints = search.xpoints;
+  const Walk walker(search);
+  const SearchStats stats(search);
+  const BoundaryHits hits = search.boundaryBuffer();
+  Kokkos::View<int> max_crossings("max_crossings");
+  const std::size_t scratch_bytes = Walk::verts * DIM * sizeof(o::Real);
+  auto lamb = PS_LAMBDA(const TeamMember& team, const int& elm, const RowParticles& row) {
+    //padding rows hold no particles
+    if(elm >= nelems) {
+      Kokkos::parallel_for(Kokkos::TeamThreadRange(team, row.size()), [&](const int& i) {
+        elem_ids[row(i)] = -1;
+        ptcl_done[row(i)] = 1;
+        stats.start(row(i), elm, false);
+      });
+      return;
+    }
+    o::Real* staged = (o::Real*) team.team_shmem().get_shmem(scratch_bytes);
+    Kokkos::single(Kokkos::PerTeam(team), [&]() {
+      const auto coords = walker.elementCoords(elm);
+      for(int v = 0; v < Walk::verts; ++v)
+        for(int c = 0; c < DIM; ++c)
+          staged[v * DIM + c] = coords[v][c];
+    });
+    team.team_barrier();
+    o::Matrix<DIM, Walk::verts> M;
+    for(int v = 0; v < Walk::verts; ++v)
+      for(int c = 0; c < DIM; ++c)
+        M[v][c] = staged[v * DIM + c];
+    Kokkos::parallel_for(Kokkos::TeamThreadRange(team, row.size()), [&](const int& i) {
+      const o::LO pid = row(i);
+      if(!row.mask(i)) {
+        elem_ids[pid] = -1;
+        ptcl_done[pid] = 1;
+        stats.start(pid, elm, false);
+        return;
+      }
+      const auto dest = makeVector<DIM>(pid, xtgt_ps_d);
+      const auto orig = makeVector<DIM>(pid, x_ps_d);
+      //make sure particle origin is in initial element
+      if(!walker.contains(M, elm, orig, Walk::originTol()))
+        origin_not_in_element(rank_d, pid_d(pid), elm, orig);
+      o::LO elmId = elm;
+      o::LO done = 1;
+      int crossings = 0;
+      if(!walker.contains(M, elm, dest, Walk::destTol())) {
+        auto xpoint = o::zero_vector<DIM>();
+        DomainExit exit;
+        done = walker(elmId, orig, dest, looplimit, crossings, xpoint, exit);
+        if(elmId < 0)
+          record_exit(hits, xpoints, pid, exit, xpoint);
+        Kokkos::atomic_fetch_max(&max_crossings(), crossings);
+      } else {
+        stats.visit(elm);
+      }
+      stats.walked(pid, elm, crossings, elmId < 0);
+      elem_ids[pid] = elmId;
+      ptcl_done[pid] = done;
+    });
+  };
+  ptcls->parallel_for_elements(lamb, scratch_bytes, -1, kernel);
+  int loops = 0;
+  //The walk ran on the instance of the particles, wait on it before the omega_h reductions
+  Kokkos::deep_copy(ptcls->executionSpace(), loops, max_crossings);
+  ptcls->executionSpace().fence();
+  if(stats.enabled)
+    search.accumulateStatistics(psCapacity);
+  const bool found = psCapacity == 0 || o::get_min(o::LOs(ptcl_done)) == 1;
+  if(!found)
+    fprintf(stderr, "ERROR:loop limit %d exceeded\n", looplimit);
+  ps::recordKernelWork(name, 0, ptcls->nPtcls());
+  report_search(name, timer.seconds(), btime, loops);
+  Kokkos::Profiling::popRegion();
+  return found;
+}
+
+//Search completion that does nothing, see MigrateTargets
+struct NoSearchFinish {
+  OMEGA_H_DEVICE void operator()(const o::LO, const o::LO) const {}
+};
+
+/* Host loop search of either dimension over a worklist of the particles still searching
+     Each pass visits the worklist with one kernel taking one step of SimplexWalk<DIM> per
+     particle: particles whose target is in their element finish there, particles leaving
+     the domain finish in element -1 (in 3d with the exit point in search.xpoints and a
+     boundary hit) and the others move to the element across the side they leave through.
+     The unfinished particles are then compacted into the worklist of the next pass.
+     With SearchContext::enableContinuation particles crossing the picpart boundary stop in
+     the last element with the exit point as their origin, see search_mesh_2d_continued.
+     The search stops after looplimit passes (0 for no limit), loops is set to the number
+     of passes. finish is called with each particle and its element as its search ends.
+       name - region, timer and counter (name_loops) of the search
+*/
+template <int DIM, class ParticleStruct, class SearchFinish>
+bool worklist_search(SearchContext& search, ParticleStruct* ptcls, Segment3d x_ps_d,
+                     Segment3d xtgt_ps_d, SegmentInt pid_d, o::Write<o::LO> elem_ids,
+                     int looplimit, const SearchFinish& finish, const std::string& name,
+                     int& loops) {
+  typedef typename SimplexWalk<DIM>::type Walk;
+  const auto btime = pumipic_prebarrier();
+  ps::recordImbalance(name, btime, ptcls->nPtcls());
+  Kokkos::Profiling::pushRegion(name);
+  ps::MemoryPhase memory_phase(name);
+  Kokkos::Timer timer;
 
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  const auto rank_d = rank;
+
+  const auto psCapacity = ptcls->capacity();
+  search.reserve(psCapacity);
   // ptcl_done[i] = 1 : particle i has hit a boundary or reached its destination
-  o::Write<o::LO> ptcl_done(psCapacity, 1, "ptcl_done");
-  // store the last crossed edge
-  o::Write<o::LO> lastEdge(psCapacity,-1);
-  auto lamb = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
-    if(mask > 0) {
-      elem_ids[pid] = e;
+  auto ptcl_done = search.ptcl_done;
+  reset_search_slots(ptcls->rangePolicy(psCapacity), ptcl_done, elem_ids);
+  auto xpoints = search.xpoints;
+  const Walk walker(search);
+  const SearchStats stats(search);
+  const BoundaryHits hits = search.boundaryBuffer();
+  // particles crossing the picpart boundary stop in the last element
+  const bool resume = search.hasContinuation();
+  const auto part_boundary = search.part_boundary;
+  auto buffer_exit = search.buffer_exit;
+  const bool from_ids = search.startFromElemIds();
+  const bool use_stayed = search.hasStayed() && !from_ids;
+  const auto stayed = search.stayed;
+  //resumed particles start on the picpart boundary of an earlier round and the particles
+  //  finished by an earlier round are not counted again
+  const bool first_round = search.continuation_round == 0;
+  auto init = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    buffer_exit[pid] = -1;
+    const int start = from_ids ? elem_ids[pid] : e;
+    const bool skip = use_stayed && stayed[pid];
+    stats.start(pid, start, mask > 0 && start >= 0 && (first_round || !skip));
+    if(mask > 0 && start >= 0) {
+      elem_ids[pid] = start;
       ptcl_done[pid] = 0;
+      if(skip) {
+        ptcl_done[pid] = 1;
+        finish(pid, start);
+        return;
+      }
+      //make sure particle origin is in initial element
+      const auto orig = makeVector<DIM>(pid, x_ps_d);
+      if(first_round && !walker.contains(start, orig, Walk::originTol()))
+        origin_not_in_element(rank_d, pid_d(pid), start, orig);
     } else {
       elem_ids[pid] = -1;
       ptcl_done[pid] = 1;
     }
   };
-  ps::parallel_for(ptcls, lamb);
-
-  auto checkParent = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
-    //inactive particle that is still moving to its target position
-    if( mask > 0 && !ptcl_done[pid] ) {
-      auto searchElm = elem_ids[pid];
-      auto ptcl = pid_d(pid);
-      OMEGA_H_CHECK(searchElm >= 0);
-      auto faceVerts = o::gather_verts<3>(faces2verts, searchElm);
-      const auto faceCoords = o::gather_vectors<3,2>(coords, faceVerts);
-      auto ptclOrigin = makeVector2(pid, x_ps_d);
-      Omega_h::Vector<3> faceBcc;
-      barycentric_tri(triArea, faceCoords, ptclOrigin, faceBcc, searchElm);
-      if(!all_positive(faceBcc,1e-8)) {
-        printf("%d Particle not in element! ptcl %d elem %d => %d "
-          "orig %.15f %.15f bcc %.3f %.3f %.3f\n",
-          rank_d, ptcl, e, searchElm, ptclOrigin[0], ptclOrigin[1],
-          faceBcc[0], faceBcc[1], faceBcc[2]);
-        OMEGA_H_CHECK(false);
-      }
-    } //if active
-  };
-  ps::parallel_for(ptcls, checkParent);
+  ps::parallel_for(ptcls, init, name + "_init");
 
+  //only the particles still searching are visited by each pass, the kernels setting
+  //  ptcl_done ran on the instance of the particles
+  ptcls->executionSpace().fence();
+  auto worklist = search.worklist;
+  auto worklist_next = search.worklist_next;
+  o::LO num_active = compact_unfinished(ptcl_done, worklist, psCapacity, worklist, true);
+  // particles without an exit from their element
+  Kokkos::View<int> no_exit("search_no_exit");
+  const std::string step_kernel = name + "_step";
   bool found = false;
-  int loops = 0;
+  loops = 0;
   while(!found) {
-    auto checkCurrentElm = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
-      //active particle that is still moving to its target position
-      if( mask > 0 && !ptcl_done[pid] ) {
-        auto searchElm = elem_ids[pid];
-        auto ptcl = pid_d(pid);
-        OMEGA_H_CHECK(searchElm >= 0);
-        const auto edges = o::gather_down<3>(faceEdges, searchElm);
-        const auto faceVerts = o::gather_verts<3>(faces2verts, searchElm);
-        const auto faceCoords = o::gather_vectors<3,2>(coords, faceVerts);
-        const auto ptclDest = makeVector2(pid, xtgt_ps_d);
-        const auto ptclOrigin = makeVector2(pid, x_ps_d);
-        Omega_h::Vector<3> faceBcc;
-        barycentric_tri(triArea, faceCoords, ptclDest, faceBcc, searchElm);
-        auto isDestInParentElm = all_positive(faceBcc);
-        ptcl_done[pid] = isDestInParentElm;
-        const int idx = min3(faceBcc);
-        lastEdge[pid] = edges[idx];
-      }
-    };
-    ps::parallel_for(ptcls, checkCurrentElm);
-
-    auto checkExposedEdges = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
-      if( mask > 0 && !ptcl_done[pid] ) {
-        auto searchElm = elem_ids[pid];
-        auto ptcl = pid_d(pid);
-        assert(lastEdge[pid] != -1);
-        auto bridge = lastEdge[pid];
-        auto exposed = side_is_exposed[bridge];
-        ptcl_done[pid] = exposed;
-        elem_ids[pid] = exposed ? -1 : elem_ids[pid]; //leaves domain if exposed
-      }
-    };
-    ps::parallel_for(ptcls, checkExposedEdges, "pumipic_checkExposedEdges");
-
-    auto e2f_vals = edges2faces.ab2b; // CSR value array
-    auto e2f_offsets = edges2faces.a2ab; // CSR offset array, index by mesh edge ids
-    auto setNextElm = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
-      if( mask > 0 && !ptcl_done[pid] ) {
-        auto searchElm = elem_ids[pid];
-        auto ptcl = pid_d(pid);
-        auto bridge = lastEdge[pid];
-        auto e2f_first = e2f_offsets[bridge];
-        auto e2f_last = e2f_offsets[bridge+1];
-        auto upFaces = e2f_last - e2f_first;
-        assert(upFaces==2);
-        auto faceA = e2f_vals[e2f_first];
-        auto faceB = e2f_vals[e2f_first+1];
-        assert(faceA != faceB);
-        assert(faceA == searchElm || faceB == searchElm);
-        auto nextElm = (faceA == searchElm) ? faceB : faceA;
-        elem_ids[pid] = nextElm;
+    auto walkStep = OMEGA_H_LAMBDA(const o::LO& i) {
+      const o::LO pid = worklist[i];
+      const o::LO elm = elem_ids[pid];
+      OMEGA_H_CHECK(elm >= 0);
+      stats.visit(elm);
+      const auto orig = makeVector<DIM>(pid, x_ps_d);
+      const auto dest = makeVector<DIM>(pid, xtgt_ps_d);
+      o::LO next = elm;
+      auto xpoint = o::zero_vector<DIM>();
+      DomainExit exit;
+      const int status = walker.step(elm, orig, dest, next, xpoint, exit);
+      if(status == WALK_INSIDE) {
+        ptcl_done[pid] = 1;
+        finish(pid, elm);
+      } else if(status == WALK_CROSSED) {
+        elem_ids[pid] = next;
+        stats.cross(pid);
+      } else if(status == WALK_EXITED) {
+        ptcl_done[pid] = 1;
+        if(resume && part_boundary[exit.face]) {
+          //left the buffered region, resume from the exit point in the last element
+          for(int j=0; j<DIM; ++j)
+            x_ps_d(pid, j) = xpoint[j];
+          buffer_exit[pid] = exit.face;
+        } else {
+          elem_ids[pid] = -1;
+          stats.cross(pid);
+          stats.exitDomain();
+          record_exit(hits, xpoints, pid, exit, xpoint);
+          finish(pid, -1);
+        }
+      } else {
+        //the particle stays in its last element and is not found
+        printf("ptcl %d has no exit from elm %d\n", pid_d(pid), elm);
+        ptcl_done[pid] = 1;
+        Kokkos::atomic_fetch_add(&no_exit(), 1);
       }
     };
-    ps::parallel_for(ptcls, setNextElm, "pumipic_setNextElm");
+    o::parallel_for(num_active, walkStep, step_kernel.c_str());
 
-    found = true;
-    o::LOs ptcl_done_r(ptcl_done);
-    auto minFlag = o::get_min(ptcl_done_r);
-    if(minFlag == 0)
-      found = false;
+    num_active = compact_unfinished(ptcl_done, worklist, num_active, worklist_next);
+    std::swap(worklist, worklist_next);
+    found = num_active == 0;
     ++loops;
 
-    if(looplimit && loops >= looplimit) {
-      auto ptclsNotFound = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
-        if( mask > 0 && !ptcl_done[pid] ) {
-          auto searchElm = elem_ids[pid];
-          auto ptcl = pid_d(pid);
-          const auto ptclDest = makeVector2(pid, xtgt_ps_d);
-          const auto ptclOrigin = makeVector2(pid, x_ps_d);
-          printf("rank %d elm %d ptcl %d notFound %.15f %.15f to %.15f %.15f\n",
-              rank_d,
-              searchElm, ptcl,
-              ptclOrigin[0], ptclOrigin[1],
-              ptclDest[0], ptclDest[1]);
-        }
+    if(!found && looplimit && loops >= looplimit) {
+      auto ptclsNotFound = OMEGA_H_LAMBDA(const o::LO& i) {
+        const o::LO pid = worklist[i];
+        printf("rank %d elm %d ptcl %d notFound orig", rank_d, elem_ids[pid], pid_d(pid));
+        for(int j=0; j<DIM; ++j)
+          printf(" %.15f", x_ps_d(pid, j));
+        printf(" dest");
+        for(int j=0; j<DIM; ++j)
+          printf(" %.15f", xtgt_ps_d(pid, j));
+        printf("\n");
       };
-      ps::parallel_for(ptcls, ptclsNotFound, "ptclsNotFound");
+      o::parallel_for(num_active, ptclsNotFound, "ptclsNotFound");
       fprintf(stderr, "ERROR:loop limit %d exceeded\n", looplimit);
       break;
     }
   }
-  if(!rank || rank == comm_size/2) {
-    fprintf(stderr, "%d pumipic search_2d (seconds) %f pre-barrier (seconds) %f\n",
-        rank, timer.seconds(), btime);
-    fprintf(stderr, "%d pumipic search_2d loops %d\n", rank, loops);
+  int num_no_exit = 0;
+  Kokkos::deep_copy(num_no_exit, no_exit);
+  if(num_no_exit) {
+    fprintf(stderr, "ERROR:%d particles have no exit from their element\n", num_no_exit);
+    found = false;
   }
+  if(stats.enabled)
+    search.accumulateStatistics(psCapacity);
+  ps::recordKernelWork(name, 0, ptcls->nPtcls());
+  report_search(name, timer.seconds(), btime, loops, "loops");
+  Kokkos::Profiling::popRegion();
+  return found;
+}
+
+/* 3d search, see worklist_search
+     Stops after looplimit passes (0 for no limit). xpoints_d and xface_id are unused, the
+     exit points are in search.xpoints and the exits in the boundary buffer. finish is
+     called with each particle and its element as its search ends (i.e.
+     BarycentricFinish<3>). ParticleStruct is any particle structure, passing the concrete
+     structure (i.e. SellCSigma) dispatches the kernels statically.
+*/
+template < class ParticleStruct, class SearchFinish = NoSearchFinish>
+bool search_mesh(SearchContext& search, ParticleStruct* ptcls,
+                 Segment3d x_ps_d, Segment3d xtgt_ps_d, SegmentInt pid_d,
+                 o::Write<o::LO> elem_ids, o::Write<o::Real> xpoints_d,
+                 o::Write<o::LO> xface_id, int looplimit=0,
+                 const SearchFinish& finish=SearchFinish()) {
+  int loops;
+  return worklist_search<3>(search, ptcls, x_ps_d, xtgt_ps_d, pid_d, elem_ids, looplimit,
+                            finish, "pumipic_search_mesh", loops);
+}
+
+//Search that computes the mesh adjacency every call, see SearchContext to reuse it
+template < class ParticleStruct, class SearchFinish = NoSearchFinish>
+bool search_mesh(o::Mesh& mesh, ParticleStruct* ptcls,
+                 Segment3d x_ps_d, Segment3d xtgt_ps_d, SegmentInt pid_d,
+                 o::Write<o::LO> elem_ids, o::Write<o::Real> xpoints_d,
+                 o::Write<o::LO> xface_id, int looplimit=0,
+                 const SearchFinish& finish=SearchFinish()) {
+  SearchContext search(mesh);
+  return search_mesh(search, ptcls, x_ps_d, xtgt_ps_d, pid_d, elem_ids, xpoints_d, xface_id,
+                     looplimit, finish);
+}
+
+/* Search where each thread walks its particle to the destination in one kernel
+     Uses the same element exits as search_mesh without a host loop or reduction per
+     crossing, each particle stops after crossing looplimit elements (0 for no limit).
+     Suited to particles that cross many elements per step, search_mesh remains the
+     default.
+*/
+template < class ParticleStruct>
+bool search_mesh_walk(SearchContext& search, ParticleStruct* ptcls,
+                      Segment3d x_ps_d, Segment3d xtgt_ps_d, SegmentInt pid_d,
+                      o::Write<o::LO> elem_ids, o::Write<o::Real> xpoints_d,
+                      o::Write<o::LO> xface_id, int looplimit=0) {
+  return walk_search<3>(search, ptcls, x_ps_d, xtgt_ps_d, pid_d, elem_ids, looplimit,
+                        "pumipic_search_walk", "adj_search_walk");
+}
+
+/* Search with one team per element (row) of a SellCSigma
+     The team stages the vertices and coordinates of its tet in scratch memory once, each
+     particle checks its origin and destination against the staged tet and only particles
+     leaving the element read the mesh arrays, walking on like search_mesh_walk.
+     Requires SellCSigma::parallel_for_elements.
+*/
+template < class SCS>
+bool search_mesh_team(SearchContext& search, SCS* ptcls,
+                      Segment3d x_ps_d, Segment3d xtgt_ps_d, SegmentInt pid_d,
+                      o::Write<o::LO> elem_ids, o::Write<o::Real> xpoints_d,
+                      o::Write<o::LO> xface_id, int looplimit=0) {
+  return team_search<3>(search, ptcls, x_ps_d, xtgt_ps_d, pid_d, elem_ids, looplimit,
+                        "pumipic_search_team", "adj_search_team");
+}
+
+/* Search completion writing the migrate inputs of each particle as its search finishes
+     new_element is the element found (-1 outside the domain) and new_process is the owner
+     of that element when it is not safe, this rank otherwise. Unless swap_positions is
+     false the destination also becomes the particle position (x = xtgt, xtgt = 0), so
+     push-search-migrate drivers need no sweeps between the search and migrate.
+     Particles not found within the loop limit or continued on another rank
+     (search_mesh_2d_continued) are not finished.
+*/
+struct MigrateTargets {
+  MigrateTargets(Mesh& picparts, kkLidView new_elem, kkLidView new_proc, Segment3d x_ps,
+                 Segment3d xtgt_ps, bool swap_positions = true) :
+    new_element(new_elem), new_process(new_proc), is_safe(picparts.safeTag()),
+    owners(picparts.entOwners(picparts.dim())), comm_rank(picparts.comm()->rank()),
+    x(x_ps), xtgt(xtgt_ps), swap(swap_positions) {}
+
+  OMEGA_H_DEVICE void operator()(const o::LO pid, const o::LO elm) const {
+    new_element(pid) = elm;
+    new_process(pid) = (elm >= 0 && !is_safe[elm]) ? owners[elm] : comm_rank;
+    if(swap) {
+      for(int i=0; i<3; ++i) {
+        x(pid,i) = xtgt(pid,i);
+        xtgt(pid,i) = 0;
+      }
+    }
+  }
+
+  kkLidView new_element;
+  kkLidView new_process;
+  o::LOs is_safe;
+  o::LOs owners;
+  int comm_rank;
+  Segment3d x;
+  Segment3d xtgt;
+  bool swap;
+};
+
+/* Search completion storing the barycentric coordinates of the destination
+     The DIM+1 coordinates of xtgt in the element found are written to a particle member
+     in the vertex order of the element (bcc(pid, i) weights vertex i), then finish is
+     called. The member moves with the particles through rebuild and migration, so kernels
+     of the next step (i.e. pushBoris with cached weights, charge deposition) can read it
+     instead of solving for it. Particles leaving the domain keep their old coordinates.
+   DIM is the mesh dimension, search_mesh takes BarycentricFinish<3> and search_mesh_2d
+   BarycentricFinish<2>.
+   Usage:
+     auto finish = makeBarycentricFinish<2>(search, xtgt, ptcls->get<PTCL_BCC>(), targets);
+     search_mesh_2d(search, ptcls, x, xtgt, pid, elem_ids, maxLoops, finish);
+*/
+template <int DIM, class BccSegment, class SearchFinish = NoSearchFinish>
+struct BarycentricFinish {
+  BarycentricFinish(const SearchContext& search, Segment3d xtgt_ps, BccSegment bcc_ps,
+                    const SearchFinish& next_finish = SearchFinish()) :
+    elem_verts(search.elem_verts), coords(search.coords), xtgt(xtgt_ps), bcc(bcc_ps),
+    next(next_finish) {}
+
+  OMEGA_H_DEVICE void operator()(const o::LO pid, const o::LO elm) const {
+    if(elm >= 0) {
+      const auto verts = o::gather_verts<DIM + 1>(elem_verts, elm);
+      const auto vertCoords = o::gather_vectors<DIM + 1, DIM>(coords, verts);
+      o::Vector<DIM> dest;
+      for(int i=0; i<DIM; ++i)
+        dest[i] = xtgt(pid,i);
+      const auto weights = o::barycentric_from_global<DIM, DIM>(dest, vertCoords);
+      for(int i=0; i<DIM + 1; ++i)
+        bcc(pid,i) = weights[i];
+    }
+    next(pid, elm);
+  }
+
+  o::LOs elem_verts;
+  o::Reals coords;
+  Segment3d xtgt;
+  BccSegment bcc;
+  SearchFinish next;
+};
+
+template <int DIM, class BccSegment, class SearchFinish>
+BarycentricFinish<DIM, BccSegment, SearchFinish>
+makeBarycentricFinish(const SearchContext& search, Segment3d xtgt, BccSegment bcc,
+                      const SearchFinish& next) {
+  return BarycentricFinish<DIM, BccSegment, SearchFinish>(search, xtgt, bcc, next);
+}
+
+/* 2d search, see worklist_search
+     Stops after looplimit passes (0 for no limit) and reduces the number of passes over
+     every rank, so it must be called by every rank of MPI_COMM_WORLD.
+*/
+template < class ParticleStruct, class SearchFinish = NoSearchFinish>
+bool search_mesh_2d(SearchContext& search, // (in) mesh adjacency and scratch
+                 ParticleStruct* ptcls, // (in) particle structure
+                 Segment3d x_ps_d, // (in) starting particle positions
+                 Segment3d xtgt_ps_d, // (in) target particle positions
+                 SegmentInt pid_d, // (in) particle ids
+                 o::Write<o::LO> elem_ids, // (out) parent element ids for the target positions
+                 int looplimit=0,
+                 // (in) called with each particle and its element as its search finishes
+                 const SearchFinish& finish=SearchFinish()) {
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  int loops;
+  const bool found = worklist_search<2>(search, ptcls, x_ps_d, xtgt_ps_d, pid_d, elem_ids,
+                                        looplimit, finish, "pumipic_search_2d", loops);
+  const int psCapacity = ptcls->capacity();
   int maxLoops = 0;
   MPI_Allreduce(&loops, &maxLoops, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
   int minLoops = 0;
@@ -595,16 +1831,149 @@ bool search_mesh_2d(o::Mesh& mesh, // (in) mesh
   const int hasPtcls = (psCapacity > 0);
   MPI_Allreduce(&hasPtcls, &ranksWithPtcls, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
   const double avgLoops = (double) totLoops / ranksWithPtcls;
-  if(maxLoops == loops)
+  if(maxLoops == loops && ps::timePrintsEnabled())
     fprintf(stderr, "pumipic search_2d maxLoops %d on rank %d\n", maxLoops, rank);
-  if(minLoops == loops)
+  if(minLoops == loops && ps::timePrintsEnabled())
     fprintf(stderr, "pumipic search_2d minLoops %d on rank %d\n", minLoops, rank);
-  if(!rank)
+  if(!rank && ps::timePrintsEnabled())
     fprintf(stderr, "pumipic search_2d totLoops %ld ranksWithPtcls %d average loops %f\n",
             totLoops, ranksWithPtcls, avgLoops);
-  Kokkos::Profiling::popRegion();
   return found;
 }
 
+//Search that computes the mesh adjacency every call, see SearchContext to reuse it
+template < class ParticleStruct, class SearchFinish = NoSearchFinish>
+bool search_mesh_2d(o::Mesh& mesh, // (in) mesh
+                 ParticleStruct* ptcls, // (in) particle structure
+                 Segment3d x_ps_d, // (in) starting particle positions
+                 Segment3d xtgt_ps_d, // (in) target particle positions
+                 SegmentInt pid_d, // (in) particle ids
+                 o::Write<o::LO> elem_ids, // (out) parent element ids for the target positions
+                 int looplimit=0,
+                 // (in) called with each particle and its element as its search finishes
+                 const SearchFinish& finish=SearchFinish()) {
+  SearchContext search(mesh);
+  return search_mesh_2d(search, ptcls, x_ps_d, xtgt_ps_d, pid_d, elem_ids, looplimit, finish);
+}
+
+/* 2d search that continues the walk of particles leaving the buffered region on other ranks
+     Requires SearchContext::enableContinuation. Each round runs search_mesh_2d, particles
+     crossing the picpart boundary keep the last element reached in elem_ids and the exit
+     point as their origin (x), and are migrated to the owner of that element, which
+     resumes their walk in the next round. Rounds end when no rank has such particles or
+     after max_rounds. elem_ids is reallocated for the particles held after the last round.
+     The particles finished by earlier rounds are migrated to the element found, so later
+     rounds mark them as stayed (SearchContext::setStayed) with one containment test and
+     only the particles in flight walk. The stayed flags of the caller apply to the first
+     round and are restored at the end. num_rounds (if given) is set to the rounds run.
+     Must be called by every rank of the picparts.
+*/
+template <int PTCL_X, int PTCL_XTGT, int PTCL_ID, class ParticleStruct>
+bool search_mesh_2d_continued(SearchContext& search, // (in) mesh adjacency and scratch
+                 Mesh& picparts, // (in) picparts of the search mesh
+                 ParticleStruct* ptcls, // (in) particle structure
+                 o::Write<o::LO>& elem_ids, // (out) parent element ids for the target positions
+                 int looplimit=0, int max_rounds=8, int* num_rounds=NULL) {
+  if(!search.hasContinuation()) {
+    fprintf(stderr, "[ERROR] search_mesh_2d_continued requires "
+            "SearchContext::enableContinuation\n");
+    return false;
+  }
+  const int comm_rank = picparts.comm()->rank();
+  const auto owners = picparts.entOwners(picparts.dim());
+  const auto user_stayed = search.stayed;
+  const bool from_ids = search.startFromElemIds();
+  const TriWalk walker(search);
+  bool found = false;
+  for(int round = 0; round < max_rounds; ++round) {
+    if(num_rounds)
+      *num_rounds = round + 1;
+    if(round > 0) {
+      //particles that moved in from another rank are the only ones not in their target
+      o::Write<o::I8> finished(ptcls->capacity(), 0, "continuation_finished");
+      auto xtgt = ptcls->template get<PTCL_XTGT>();
+      auto markFinished = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+        if(mask)
+          finished[pid] = walker.contains(e, makeVector2(pid, xtgt), TriWalk::destTol());
+      };
+      ps::parallel_for(ptcls, markFinished, "pumipic_continuation_finished");
+      search.setStayed(finished);
+      search.setStartFromElemIds(false);
+    }
+    elem_ids = o::Write<o::LO>(ptcls->capacity(), -1, "elem_ids");
+    search.continuation_round = round;
+    found = search_mesh_2d(search, ptcls, ptcls->template get<PTCL_X>(),
+                           ptcls->template get<PTCL_XTGT>(),
+                           ptcls->template get<PTCL_ID>(), elem_ids, looplimit);
+    auto buffer_exit = search.buffer_exit;
+    o::LO leaving = 0;
+    Kokkos::parallel_reduce("pumipic_count_buffer_exits", ptcls->capacity(),
+      KOKKOS_LAMBDA(const o::LO& pid, o::LO& count) {
+        count += buffer_exit[pid] >= 0;
+      }, leaving);
+    MPI_Allreduce(MPI_IN_PLACE, &leaving, 1, MPI_INT, MPI_SUM, picparts.comm()->get_impl());
+    if(leaving == 0)
+      break;
+    //hand the particles that left over to the owner of their last element
+    typename ParticleStruct::kkLidView new_element("new_element", ptcls->capacity());
+    typename ParticleStruct::kkLidView new_process("new_process", ptcls->capacity());
+    auto setOwners = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+      new_element(pid) = mask ? elem_ids[pid] : -1;
+      new_process(pid) = comm_rank;
+      if(mask && buffer_exit[pid] >= 0)
+        new_process(pid) = owners[elem_ids[pid]];
+    };
+    ps::parallel_for(ptcls, setOwners, "pumipic_continuation_owners");
+    ptcls->migrate(new_element, new_process);
+    if(round == max_rounds - 1) {
+      if(!comm_rank)
+        fprintf(stderr, "[ERROR] search_mesh_2d_continued did not finish in %d rounds\n",
+                max_rounds);
+      found = false;
+    }
+  }
+  search.continuation_round = 0;
+  search.setStayed(user_stayed);
+  search.setStartFromElemIds(from_ids);
+  return found;
+}
+
+
+/* 2d search where each thread walks its particle to the destination in one kernel
+     Uses the same edge exits as search_mesh_2d without a host loop or reduction per
+     crossing, each particle stops after crossing looplimit elements (0 for no limit).
+     Suited to particles that cross many elements per step, search_mesh_2d remains the
+     default.
+*/
+template < class ParticleStruct>
+bool search_mesh_2d_walk(SearchContext& search, // (in) mesh adjacency and scratch
+                 ParticleStruct* ptcls, // (in) particle structure
+                 Segment3d x_ps_d, // (in) starting particle positions
+                 Segment3d xtgt_ps_d, // (in) target particle positions
+                 SegmentInt pid_d, // (in) particle ids
+                 o::Write<o::LO> elem_ids, // (out) parent element ids for the target positions
+                 int looplimit=0) {
+  return walk_search<2>(search, ptcls, x_ps_d, xtgt_ps_d, pid_d, elem_ids, looplimit,
+                        "pumipic_search_2d_walk", "pumipic_search_2d_walk");
+}
+
+/* 2d search with one team per element (row) of a SellCSigma
+     The team stages the vertex coordinates of its element in scratch memory once, each
+     particle checks its origin and destination against the staged triangle and only
+     particles leaving the element read the mesh arrays, walking on like
+     search_mesh_2d_walk. Requires SellCSigma::parallel_for_elements.
+*/
+template < class SCS>
+bool search_mesh_2d_team(SearchContext& search, // (in) mesh adjacency and scratch
+                 SCS* ptcls, // (in) particle structure
+                 Segment3d x_ps_d, // (in) starting particle positions
+                 Segment3d xtgt_ps_d, // (in) target particle positions
+                 SegmentInt pid_d, // (in) particle ids
+                 o::Write<o::LO> elem_ids, // (out) parent element ids for the target positions
+                 int looplimit=0) {
+  return team_search<2>(search, ptcls, x_ps_d, xtgt_ps_d, pid_d, elem_ids, looplimit,
+                        "pumipic_search_2d_team", "pumipic_search_2d_team");
+}
+
 } //namespace
 #endif //define
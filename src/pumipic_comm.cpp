@@ -4,13 +4,41 @@
 #include <Omega_h_array_ops.hpp>
 #include <mpi.h>
 #include <Omega_h_comm.hpp>
+#include <vector>
 
 using Omega_h::MpiTraits;
 
 namespace pumipic {
+  //Host buffers and requests of one dimension between the phases of setupComm
+  struct Mesh::CommSetup {
+    CommSetup() : exchange(false) {}
+    //False for the element dimension, which has no boundary part information
+    bool exchange;
+    int dim;
+    int num_bounded;
+    Omega_h::HostRead<Omega_h::LO> is_complete_host;
+    Omega_h::HostRead<Omega_h::LO> boundary_degree_host;
+    Omega_h::HostRead<Omega_h::LO> boundary_ent_offsets_host;
+    Omega_h::HostWrite<Omega_h::LO> boundary_rlids_host;
+    Omega_h::HostWrite<Omega_h::LO> recv_boundary_degree_host;
+    Omega_h::HostWrite<Omega_h::LO> recv_boundary_offset_host;
+    Omega_h::HostWrite<Omega_h::LO> recv_rlids;
+    MPI_Request alltoall_request;
+    std::vector<MPI_Request> requests;
+  };
+
   void Mesh::setupComm(int edim, Omega_h::LOs global_ents_per_rank,
                        Omega_h::LOs picpart_ents_per_rank,
                        Omega_h::LOs ent_owners) {
+    CommSetup setup;
+    setupComm_begin(edim, global_ents_per_rank, picpart_ents_per_rank, ent_owners, setup);
+    setupComm_exchange(setup);
+    setupComm_end(setup);
+  }
+
+  void Mesh::setupComm_begin(int edim, Omega_h::LOs global_ents_per_rank,
+                             Omega_h::LOs picpart_ents_per_rank,
+                             Omega_h::LOs ent_owners, CommSetup& setup) {
     int rank = commptr->rank();
     int comm_size = commptr->size();
 
@@ -83,7 +111,6 @@ namespace pumipic {
 
     offset_ents_per_rank_per_dim[edim] = Omega_h::LOs(picpart_ents_per_rank);
     ent_to_comm_arr_index_per_dim[edim] = Omega_h::LOs(comm_arr_index);
-    ent_local_rank_id_per_dim[edim] = Omega_h::LOs(ent_rank_lids);
     is_complete_part[edim] = Omega_h::HostRead<Omega_h::LO>(is_complete);
     num_boundaries[edim] = 0;
     num_bounds[edim] = 0;
@@ -97,18 +124,20 @@ namespace pumipic {
 
     Omega_h::LO num_bounded = num_cores[edim] - num_cores[dim()];
     num_bounds[edim] = num_bounded;
+    setup.exchange = true;
+    setup.dim = edim;
+    setup.num_bounded = num_bounded;
     //Alltoall the number of boundary entities to each owner
-    Omega_h::HostRead<Omega_h::LO> is_complete_host = is_complete_part[edim];
-    Omega_h::HostRead<Omega_h::LO> boundary_degree_host(boundary_degree);
-    Omega_h::HostWrite<Omega_h::LO> recv_boundary_degree_host(comm_size);
-    MPI_Request alltoall_request;
-    MPI_Ialltoall(boundary_degree_host.data(), 1, MPI_INT,
-                  recv_boundary_degree_host.data(), 1, MPI_INT,
-                  commptr->get_impl(), &alltoall_request);
+    setup.is_complete_host = is_complete_part[edim];
+    setup.boundary_degree_host = Omega_h::HostRead<Omega_h::LO>(boundary_degree);
+    setup.recv_boundary_degree_host = Omega_h::HostWrite<Omega_h::LO>(comm_size);
+    MPI_Ialltoall(setup.boundary_degree_host.data(), 1, MPI_INT,
+                  setup.recv_boundary_degree_host.data(), 1, MPI_INT,
+                  commptr->get_impl(), &(setup.alltoall_request));
 
     //Create buffers to collect boundary entity ids
-    Omega_h::HostRead<Omega_h::LO> boundary_ent_offsets_host(boundary_ent_offsets);
-    Omega_h::LO num_bound_ents = boundary_ent_offsets_host[comm_size];
+    setup.boundary_ent_offsets_host = Omega_h::HostRead<Omega_h::LO>(boundary_ent_offsets);
+    Omega_h::LO num_bound_ents = setup.boundary_ent_offsets_host[comm_size];
     Omega_h::Write<Omega_h::LO> boundary_rlids(num_bound_ents);
     Omega_h::LOs ent_rlids = rank_lids_per_dim[edim];
     auto gatherBoundedEnts = OMEGA_H_LAMBDA(const Omega_h::LO& ent_id) {
@@ -120,11 +149,20 @@ namespace pumipic {
       }
     };
     Omega_h::parallel_for(nents,gatherBoundedEnts, "gatherBoundedEnts");
+    //Copied to the host while the alltoall is in flight
+    setup.boundary_rlids_host = Omega_h::HostWrite<Omega_h::LO>(boundary_rlids);
+  }
 
+  void Mesh::setupComm_exchange(CommSetup& setup) {
+    if (!setup.exchange)
+      return;
+    const int edim = setup.dim;
+    const int comm_size = commptr->size();
     //Wait for number sends & receives to finish
-    MPI_Wait(&alltoall_request, MPI_STATUS_IGNORE);
+    MPI_Wait(&(setup.alltoall_request), MPI_STATUS_IGNORE);
 
     //Create offset sum of recv boundary ents
+    Omega_h::HostWrite<Omega_h::LO>& recv_boundary_degree_host = setup.recv_boundary_degree_host;
     int num_recv_bounded = 0;
     Omega_h::HostWrite<Omega_h::LO> recv_boundary_offset_host(comm_size + 1);
     recv_boundary_offset_host[0] = 0;
@@ -136,51 +174,102 @@ namespace pumipic {
     num_boundaries[edim] = num_recv_bounded;
     //Compute the parts that have boundaries of this part
     Omega_h::HostWrite<Omega_h::LO> boundary_part_list(num_boundaries[edim]);
-    index = 0;
+    int index = 0;
     for (int i = 0; i < recv_boundary_degree_host.size(); ++i) {
       if (recv_boundary_offset_host[i] != recv_boundary_offset_host[i+1] && i != commptr->rank())
         boundary_part_list[index++] = i;
     }
     boundary_parts[edim] = Omega_h::HostWrite<Omega_h::LO>(boundary_part_list);
     int num_recv_bound_ents = recv_boundary_offset_host[comm_size];
+    setup.recv_boundary_offset_host = recv_boundary_offset_host;
 
     //Send and Recv boundary rank lids
-    MPI_Request* send_requests = NULL;
-    if (num_bounded > 0)
-      send_requests = new MPI_Request[num_bounded];
-    MPI_Request* recv_requests = NULL;
-    if (num_recv_bounded)
-      recv_requests = new MPI_Request[num_recv_bounded];
+    //  The dimension is the tag so the exchanges of every dimension can be in flight together
+    setup.requests.resize(setup.num_bounded + num_recv_bounded);
+    MPI_Request* send_requests = setup.requests.data();
+    MPI_Request* recv_requests = send_requests + setup.num_bounded;
     index = 0;
     int index2 = 0;
-    Omega_h::HostWrite<Omega_h::LO> recv_rlids(num_recv_bound_ents);
-    Omega_h::HostWrite<Omega_h::LO> boundary_rlids_host(boundary_rlids);
+    setup.recv_rlids = Omega_h::HostWrite<Omega_h::LO>(num_recv_bound_ents);
     for (int i = 0; i < comm_size; ++i) {
-      if (is_complete_host[i] == 1) {
-        int start = boundary_ent_offsets_host[i];
-        int deg = boundary_degree_host[i];
-        MPI_Isend(&(boundary_rlids_host[start]), deg, MPI_INT, i, 0,
+      if (setup.is_complete_host[i] == 1) {
+        int start = setup.boundary_ent_offsets_host[i];
+        int deg = setup.boundary_degree_host[i];
+        MPI_Isend(&(setup.boundary_rlids_host[start]), deg, MPI_INT, i, edim,
                   commptr->get_impl(), send_requests + index++);
       }
       if (recv_boundary_degree_host[i] > 0) {
         int start = recv_boundary_offset_host[i];
         int deg = recv_boundary_degree_host[i];
-        MPI_Irecv(&(recv_rlids[start]), deg, MPI_INT, i, 0,
+        MPI_Irecv(&(setup.recv_rlids[start]), deg, MPI_INT, i, edim,
                   commptr->get_impl(), recv_requests + index2++);
       }
     }
-    if (num_bounded > 0) {
-      MPI_Waitall(num_bounded, send_requests, MPI_STATUSES_IGNORE);
-      delete [] send_requests;
-    }
-    if (num_recv_bounded > 0) {
-      MPI_Waitall(num_recv_bounded, recv_requests, MPI_STATUSES_IGNORE);
-      delete [] recv_requests;
-    }
-    Omega_h::Write<Omega_h::LO> recv_boundary(recv_rlids);
-    offset_bounded_per_dim[edim] =
-      Omega_h::HostWrite<Omega_h::LO>(recv_boundary_offset_host);
+  }
+
+  void Mesh::setupComm_end(CommSetup& setup) {
+    if (!setup.exchange)
+      return;
+    if (setup.requests.size() > 0)
+      MPI_Waitall(setup.requests.size(), setup.requests.data(), MPI_STATUSES_IGNORE);
+    const int edim = setup.dim;
+    Omega_h::Write<Omega_h::LO> recv_boundary(setup.recv_rlids);
+    offset_bounded_per_dim[edim] = setup.recv_boundary_offset_host;
     bounded_ent_ids[edim] = Omega_h::LOs(recv_boundary);
+    setup = CommSetup();
+  }
+
+  void Mesh::deferComm(int edim, Omega_h::LOs global_ents_per_rank,
+                       Omega_h::LOs picpart_ents_per_rank) {
+    comm_built[edim] = false;
+    comm_global_ents_per_rank[edim] = global_ents_per_rank;
+    comm_picpart_ents_per_rank[edim] = picpart_ents_per_rank;
+  }
+
+  void Mesh::buildComm(int edim) {
+    if (comm_built[edim])
+      return;
+    setupComm(edim, comm_global_ents_per_rank[edim], comm_picpart_ents_per_rank[edim],
+              ent_owner_per_dim[edim]);
+    releaseCommSetup(edim);
+  }
+
+  void Mesh::buildComm() {
+    const int d = dim();
+    std::vector<CommSetup> setups(d + 1);
+    //Start the alltoalls of every dimension, then their boundary exchanges, then wait on all
+    for (int i = 0; i <= d; ++i)
+      if (!comm_built[i])
+        setupComm_begin(i, comm_global_ents_per_rank[i], comm_picpart_ents_per_rank[i],
+                        ent_owner_per_dim[i], setups[i]);
+    for (int i = 0; i <= d; ++i)
+      if (!comm_built[i])
+        setupComm_exchange(setups[i]);
+    for (int i = 0; i <= d; ++i)
+      if (!comm_built[i]) {
+        setupComm_end(setups[i]);
+        releaseCommSetup(i);
+      }
+  }
+
+  void Mesh::releaseCommSetup(int edim) {
+    comm_built[edim] = true;
+    comm_global_ents_per_rank[edim] = Omega_h::LOs();
+    comm_picpart_ents_per_rank[edim] = Omega_h::LOs();
+    rank_lids_per_dim[edim] = Omega_h::LOs();
+  }
+
+  Omega_h::LOs Mesh::rankLocalIndex(int edim) {
+    buildComm(edim);
+    Omega_h::LOs arr_index = ent_to_comm_arr_index_per_dim[edim];
+    Omega_h::LOs offsets = offset_ents_per_rank_per_dim[edim];
+    Omega_h::LOs owners = ent_owner_per_dim[edim];
+    Omega_h::Write<Omega_h::LO> rank_lids(arr_index.size(), "rank_local_index");
+    auto calculateRankLids = OMEGA_H_LAMBDA(Omega_h::LO ent_id) {
+      rank_lids[ent_id] = arr_index[ent_id] - offsets[owners[ent_id]];
+    };
+    Omega_h::parallel_for(arr_index.size(), calculateRankLids, "rankLocalIndex");
+    return rank_lids;
   }
 
   template <class T>
@@ -191,6 +280,95 @@ namespace pumipic {
     return Omega_h::Write<T>(size,default_value);
   }
 
+  template <class T>
+  Omega_h::Write<T> Mesh::toCommArray(int edim, const std::vector<Omega_h::Read<T> >& arrays) {
+    const int ne = nents(edim);
+    int nvals = 0;
+    for (std::size_t f = 0; f < arrays.size(); ++f) {
+      const int length = arrays[f].size();
+      if (ne*(length / ne) != length) {
+        fprintf(stderr, "[ERROR] Array %lu does not match the entities of dimension %d\n",
+                (unsigned long)f, edim);
+        return Omega_h::Write<T>();
+      }
+      nvals += length / ne;
+    }
+    Omega_h::Write<T> comm_array(ne*nvals, "comm_array");
+    int first = 0;
+    for (std::size_t f = 0; f < arrays.size(); ++f) {
+      Omega_h::Read<T> field = arrays[f];
+      const int field_nvals = field.size() / ne;
+      auto gatherField = OMEGA_H_LAMBDA(const Omega_h::LO id) {
+        for (int i = 0; i < field_nvals; ++i)
+          comm_array[id*nvals + first + i] = field[id*field_nvals + i];
+      };
+      Omega_h::parallel_for(ne, gatherField, "gatherField");
+      first += field_nvals;
+    }
+    return comm_array;
+  }
+
+  template <class T>
+  std::vector<Omega_h::Write<T> > Mesh::fromCommArray(int edim, Omega_h::Read<T> comm_array,
+                                                      const std::vector<int>& widths) {
+    std::vector<Omega_h::Write<T> > arrays;
+    const int ne = nents(edim);
+    int nvals = 0;
+    for (std::size_t f = 0; f < widths.size(); ++f)
+      nvals += widths[f];
+    if (comm_array.size() != ne*nvals) {
+      fprintf(stderr, "[ERROR] Comm array size does not match the widths for dimension %d\n",
+              edim);
+      return arrays;
+    }
+    int first = 0;
+    for (std::size_t f = 0; f < widths.size(); ++f) {
+      const int field_nvals = widths[f];
+      Omega_h::Write<T> field(ne*field_nvals, "comm_array_field");
+      auto scatterField = OMEGA_H_LAMBDA(const Omega_h::LO id) {
+        for (int i = 0; i < field_nvals; ++i)
+          field[id*field_nvals + i] = comm_array[id*nvals + first + i];
+      };
+      Omega_h::parallel_for(ne, scatterField, "scatterField");
+      arrays.push_back(field);
+      first += field_nvals;
+    }
+    return arrays;
+  }
+
+  template <class T>
+  void Mesh::reduceTags(int edim, Op op, const std::vector<std::string>& tag_names,
+                        const std::string& reduced_tag) {
+    std::vector<Omega_h::Read<T> > arrays;
+    for (std::size_t f = 0; f < tag_names.size(); ++f)
+      arrays.push_back(picpart->get_array<T>(edim, tag_names[f]));
+    Omega_h::Write<T> comm_array = toCommArray(edim, arrays);
+    reduceCommArray(edim, op, comm_array);
+    //The reduced array becomes the tag without another copy
+    picpart->set_tag(edim, reduced_tag, Omega_h::Read<T>(comm_array));
+  }
+
+  template <class T>
+  void Mesh::reduceTags(int edim, Op op, const std::vector<std::string>& tag_names) {
+    //A single tag is reduced in its own layout
+    if (tag_names.size() == 1) {
+      reduceTags<T>(edim, op, tag_names, tag_names[0]);
+      return;
+    }
+    std::vector<Omega_h::Read<T> > arrays;
+    std::vector<int> widths;
+    for (std::size_t f = 0; f < tag_names.size(); ++f) {
+      arrays.push_back(picpart->get_array<T>(edim, tag_names[f]));
+      widths.push_back(picpart->get_tag<T>(edim, tag_names[f])->ncomps());
+    }
+    Omega_h::Write<T> comm_array = toCommArray(edim, arrays);
+    reduceCommArray(edim, op, comm_array);
+    std::vector<Omega_h::Write<T> > reduced = fromCommArray(edim, Omega_h::Read<T>(comm_array),
+                                                            widths);
+    for (std::size_t f = 0; f < reduced.size(); ++f)
+      picpart->set_tag(edim, tag_names[f], Omega_h::Read<T>(reduced[f]));
+  }
+
 
   //Max and min operations taken from: https://www.geeksforgeeks.org/compute-the-minimum-or-maximum-max-of-two-integers-without-branching/
   //NOTE These only work for ints, not using them for now
@@ -218,230 +396,488 @@ namespace pumipic {
     return y;
   }
 
-  //Reductions are done by a bulk fan-in fan-out through the core region of each picpart
+  //Combines a received value y into x
+  template <class T>
+  OMEGA_H_DEVICE void reduceValue(Mesh::Op op, T& x, const T y) {
+    if (op == Mesh::SUM_OP)
+      Kokkos::atomic_add(&x, y);
+    else if (op == Mesh::MAX_OP)
+      x = maxReduce(x, y);
+    else if (op == Mesh::MIN_OP)
+      x = minReduce(x, y);
+  }
+
+  template <class T>
+  CommPlan<T>& Mesh::commPlan(int edim, int nvals) {
+    const std::tuple<int, int, std::type_index> key(edim, nvals, std::type_index(typeid(T)));
+    std::vector<CommPlanBase*>& plans = comm_plans[key];
+    for (std::size_t i = 0; i < plans.size(); ++i) {
+      CommPlan<T>* plan = static_cast<CommPlan<T>*>(plans[i]);
+      if (!plan->busy)
+        return *plan;
+    }
+    CommPlan<T>* plan = new CommPlan<T>;
+    plans.push_back(plan);
+    typedef typename CommPlan<T>::DeviceView DeviceView;
+    typedef typename CommPlan<T>::StageView StageView;
+    const int length = nents(edim) * nvals;
+    MPI_Comm mpi_comm = commptr->get_impl();
+    MPI_Datatype mpi_type = MpiTraits<T>::datatype();
+    plan->nvals = nvals;
+    plan->staged = particle_structs::NeedsStaging<device_type>::value;
+
+    Omega_h::HostRead<Omega_h::LO> ent_offsets(offset_ents_per_rank_per_dim[edim]);
+    const int rank = commptr->rank();
+    const int my_num_entries = ent_offsets[rank+1] - ent_offsets[rank];
+    const int start_index = ent_offsets[rank]*nvals;
+
+    //Layout of the fan in messages from complete buffers (tag 2) and bounding parts (tag 1)
+    plan->recv_offsets.assign(1, 0);
+    for (int i = 0; i < num_cores[edim]; ++i) {
+      int sender = buffered_parts[edim][i];
+      if (ent_offsets[sender+1] != ent_offsets[sender] && is_complete_part[edim][sender] == 2) {
+        plan->recv_ranks.push_back(sender);
+        plan->recv_tags.push_back(2);
+        plan->recv_offsets.push_back(plan->recv_offsets.back() + my_num_entries*nvals);
+      }
+    }
+    for (Omega_h::LO i = 0; i < num_boundaries[edim]; ++i) {
+      int sender = boundary_parts[edim][i];
+      int size = offset_bounded_per_dim[edim][sender+1] - offset_bounded_per_dim[edim][sender];
+      plan->recv_ranks.push_back(sender);
+      plan->recv_tags.push_back(1);
+      plan->recv_offsets.push_back(plan->recv_offsets.back() + size*nvals);
+    }
+
+    //Buffers the persistent requests are bound to
+    plan->array = DeviceView(Kokkos::ViewAllocateWithoutInitializing("comm_plan_array"), length);
+    plan->recv_buffer = DeviceView(Kokkos::ViewAllocateWithoutInitializing("comm_plan_recv"),
+                                   plan->recv_offsets.back());
+    plan->boundary_array = DeviceView(Kokkos::ViewAllocateWithoutInitializing("comm_plan_bound"),
+                                      bounded_ent_ids[edim].size()*nvals);
+    T* data = plan->array.data();
+    T* recv_data = plan->recv_buffer.data();
+    T* boundary_data = plan->boundary_array.data();
+    if (plan->staged) {
+      plan->array_stage =
+        StageView(Kokkos::ViewAllocateWithoutInitializing("comm_plan_array_stage"),
+                  plan->array.size());
+      plan->recv_stage =
+        StageView(Kokkos::ViewAllocateWithoutInitializing("comm_plan_recv_stage"),
+                  plan->recv_buffer.size());
+      plan->boundary_stage =
+        StageView(Kokkos::ViewAllocateWithoutInitializing("comm_plan_bound_stage"),
+                  plan->boundary_array.size());
+      data = plan->array_stage.data();
+      recv_data = plan->recv_stage.data();
+      boundary_data = plan->boundary_stage.data();
+    }
+    plan->memory.track("pumipic_comm_plans", plan->bytes());
+
+    //Fan in: send the values of each buffered core to its owner
+    const int num_recvs = plan->recv_ranks.size();
+    plan->fan_in_recvs.resize(num_recvs);
+    for (int i = 0; i < num_recvs; ++i)
+      MPI_Recv_init(recv_data + plan->recv_offsets[i],
+                    plan->recv_offsets[i+1] - plan->recv_offsets[i], mpi_type,
+                    plan->recv_ranks[i], plan->recv_tags[i], mpi_comm, &(plan->fan_in_recvs[i]));
+    for (int i = 0; i < num_cores[edim]; ++i) {
+      int dest = buffered_parts[edim][i];
+      int num_entries = ent_offsets[dest+1] - ent_offsets[dest];
+      if (num_entries > 0) {
+        plan->fan_in_sends.push_back(MPI_Request());
+        MPI_Send_init(data + ent_offsets[dest]*nvals, num_entries*nvals, mpi_type, dest,
+                      is_complete_part[edim][dest], mpi_comm, &(plan->fan_in_sends.back()));
+      }
+    }
+
+    //Fan out: receive every buffered core from its owner, send the owned values to
+    //  complete buffers and the bounded values to bounding parts
+    for (int i = 0; i < num_cores[edim]; ++i) {
+      int other = buffered_parts[edim][i];
+      int num_entries = ent_offsets[other+1] - ent_offsets[other];
+      if (num_entries > 0) {
+        if (is_complete_part[edim][other]==2) {
+          plan->fan_out_sends.push_back(MPI_Request());
+          MPI_Send_init(data + start_index, my_num_entries*nvals, mpi_type, other, 3, mpi_comm,
+                        &(plan->fan_out_sends.back()));
+        }
+        plan->fan_out_recvs.push_back(MPI_Request());
+        MPI_Recv_init(data + ent_offsets[other]*nvals, num_entries*nvals, mpi_type, other, 3,
+                      mpi_comm, &(plan->fan_out_recvs.back()));
+      }
+    }
+    for (int i = 0; i < num_boundaries[edim]; ++i) {
+      int other = boundary_parts[edim][i];
+      int size = offset_bounded_per_dim[edim][other+1] - offset_bounded_per_dim[edim][other];
+      int start = offset_bounded_per_dim[edim][other]*nvals;
+      plan->fan_out_sends.push_back(MPI_Request());
+      MPI_Send_init(boundary_data + start, size*nvals, mpi_type, other, 3, mpi_comm,
+                    &(plan->fan_out_sends.back()));
+    }
+    return *plan;
+  }
+
+  static MPI_Op mpiOp(Mesh::Op op) {
+    if (op == Mesh::MAX_OP)
+      return MPI_MAX;
+    else if (op == Mesh::MIN_OP)
+      return MPI_MIN;
+    return MPI_SUM;
+  }
+
   template <class T>
   void Mesh::reduceCommArray(int edim, Op op, Omega_h::Write<T> comm_array) {
-    int length = comm_array.size();
-    int ne = nents(edim);
-    int nvals = length / ne;
-    if (ne*nvals != length) {
-      fprintf(stderr, "Comm array size does not match the expected size for dimension %d\n",edim);
+    ReduceHandle<T> handle = reduceCommArray_begin(edim, op, comm_array);
+    reduceCommArray_end(handle);
+  }
+
+  template <class T>
+  void Mesh::reduceCommArrays(int edim, const std::vector<Op>& ops,
+                              const std::vector<Omega_h::Write<T> >& comm_arrays) {
+    ReduceHandle<T> handle = reduceCommArrays_begin(edim, ops, comm_arrays);
+    reduceCommArray_end(handle);
+  }
+
+  template <class T>
+  ReduceHandle<T> Mesh::reduceCommArray_begin(int edim, Op op, Omega_h::Write<T> comm_array) {
+    return reduceCommArrays_begin(edim, std::vector<Op>(1, op),
+                                  std::vector<Omega_h::Write<T> >(1, comm_array));
+  }
+
+  template <class T>
+  void Mesh::startFullReduction(int edim, Op op, FullReduction<T>& full) {
+    typedef Kokkos::View<T*, device_type, Kokkos::MemoryTraits<Kokkos::Unmanaged> > DeviceView;
+    typedef typename CommPlan<T>::StageView StageView;
+    const bool staged = particle_structs::NeedsStaging<device_type>::value;
+    MPI_Comm mpi_comm = commptr->get_impl();
+    MPI_Datatype mpi_type = MpiTraits<T>::datatype();
+    Omega_h::Write<T> comm_array = full.array;
+    const int length = comm_array.size();
+    if (!full.scatter) {
+      if (staged) {
+        full.stage = StageView(Kokkos::ViewAllocateWithoutInitializing("full_reduce_stage"),
+                               length);
+        Kokkos::deep_copy(full.stage, DeviceView(comm_array.data(), length));
+        MPI_Iallreduce(MPI_IN_PLACE, full.stage.data(), length, mpi_type, mpiOp(op),
+                       mpi_comm, &(full.request));
+      }
+      else {
+        Kokkos::fence();
+        MPI_Iallreduce(MPI_IN_PLACE, comm_array.data(), length, mpi_type, mpiOp(op),
+                       mpi_comm, &(full.request));
+      }
       return;
     }
-    if (commptr->size() == 1)
-      return;
-    //If full mesh then perform an allreduce on the array
-    if (isFullMesh() && op != BCAST_OP) {
-      Omega_h::HostWrite<T> array_host(comm_array);
-      MPI_Op mpi_op;
-      if (op == SUM_OP)
-        mpi_op = MPI_SUM;
-      else if (op == MAX_OP)
-        mpi_op = MPI_MAX;
-      else if (op == MIN_OP)
-        mpi_op = MPI_MIN;
-      MPI_Allreduce(MPI_IN_PLACE, array_host.data(), array_host.size(),
-                    MpiTraits<T>::datatype(), mpi_op, commptr->get_impl());
-      comm_array = Omega_h::Write<T>(array_host);
+
+    //Shift to bulk communication ordering so the entities of each owner are contiguous
+    const int nvals = full.nvals;
+    Omega_h::HostRead<Omega_h::LO> ent_offsets(offset_ents_per_rank_per_dim[edim]);
+    const int comm_size = commptr->size();
+    full.counts.resize(comm_size);
+    full.displacements.resize(comm_size);
+    for (int i = 0; i < comm_size; ++i) {
+      full.counts[i] = (ent_offsets[i+1] - ent_offsets[i]) * nvals;
+      full.displacements[i] = ent_offsets[i] * nvals;
+    }
+    const int num_owned = full.counts[commptr->rank()];
+    full.bulk = typename CommPlan<T>::DeviceView(
+      Kokkos::ViewAllocateWithoutInitializing("full_reduce_bulk"), length);
+    full.owned = typename CommPlan<T>::DeviceView(
+      Kokkos::ViewAllocateWithoutInitializing("full_reduce_owned"), num_owned);
+    Omega_h::Read<Omega_h::LO> arr_index = commArrayIndex(edim);
+    auto bulk = full.bulk;
+    auto convertToComm = OMEGA_H_LAMBDA(const Omega_h::LO id) {
+      const Omega_h::LO index = arr_index[id];
+      for (int i = 0; i < nvals; ++i)
+        bulk(index*nvals + i) = comm_array[id*nvals + i];
+    };
+    Omega_h::parallel_for(length / nvals, convertToComm, "convertToComm");
+    T* send_data = full.bulk.data();
+    T* owned_data = full.owned.data();
+    if (staged) {
+      full.stage = StageView(Kokkos::ViewAllocateWithoutInitializing("full_reduce_stage"),
+                             length);
+      full.owned_stage =
+        StageView(Kokkos::ViewAllocateWithoutInitializing("full_reduce_owned_stage"),
+                  num_owned);
+      Kokkos::deep_copy(full.stage, full.bulk);
+      send_data = full.stage.data();
+      owned_data = full.owned_stage.data();
+    }
+    else
+      Kokkos::fence();
+    MPI_Ireduce_scatter(send_data, owned_data, full.counts.data(), mpi_type, mpiOp(op),
+                        mpi_comm, &(full.request));
+  }
+
+  template <class T>
+  void Mesh::finishFullReduction(int edim, FullReduction<T>& full) {
+    typedef Kokkos::View<T*, device_type, Kokkos::MemoryTraits<Kokkos::Unmanaged> > DeviceView;
+    MPI_Wait(&(full.request), MPI_STATUS_IGNORE);
+    Omega_h::Write<T> comm_array = full.array;
+    const int length = comm_array.size();
+    if (!full.scatter) {
+      if (particle_structs::NeedsStaging<device_type>::value)
+        Kokkos::deep_copy(DeviceView(comm_array.data(), length), full.stage);
       return;
     }
+    //Gather the owned entities of every rank back into the bulk array
+    const bool staged = particle_structs::NeedsStaging<device_type>::value;
+    T* owned_data = staged ? full.owned_stage.data() : full.owned.data();
+    T* bulk_data = staged ? full.stage.data() : full.bulk.data();
+    MPI_Allgatherv(owned_data, full.counts[commptr->rank()], MpiTraits<T>::datatype(),
+                   bulk_data, full.counts.data(), full.displacements.data(),
+                   MpiTraits<T>::datatype(), commptr->get_impl());
+    if (staged)
+      Kokkos::deep_copy(full.bulk, full.stage);
+    const int nvals = full.nvals;
+    Omega_h::Read<Omega_h::LO> arr_index = commArrayIndex(edim);
+    auto bulk = full.bulk;
+    auto convertFromComm = OMEGA_H_LAMBDA(const Omega_h::LO id) {
+      const Omega_h::LO index = arr_index[id];
+      for (int i = 0; i < nvals; ++i)
+        comm_array[id*nvals + i] = bulk(index*nvals + i);
+    };
+    Omega_h::parallel_for(length / nvals, convertFromComm, "convertFromComm");
+  }
+
+  /* Reductions are done by a bulk fan-in fan-out through the core region of each picpart
+
+     The arrays are packed entity by entity into one bulk ordered array, so every neighbor
+     gets one message for all of them and each entry is reduced with the op of its array.
+     Packing, unpacking and the reduction stay on the device. The messages use the persistent
+     requests and buffers of a CommPlan of (edim, total entries per entity, T), so each call
+     only starts and waits them. MPI is given device pointers when it is device aware (or
+     memory is on the host), otherwise the plan stages them through pinned host buffers.
+
+     _begin packs and starts the fan in (or the allreduces of a full mesh), _end reduces the
+     fan in messages as they arrive, then performs the fan out and unpacks.
+  */
+  template <class T>
+  ReduceHandle<T> Mesh::reduceCommArrays_begin(int edim, const std::vector<Op>& ops,
+                                               const std::vector<Omega_h::Write<T> >&
+                                                 comm_arrays) {
+    ReduceHandle<T> handle;
+    if (ops.size() != comm_arrays.size()) {
+      fprintf(stderr, "Number of ops does not match the number of comm arrays\n");
+      return handle;
+    }
+    buildComm(edim);
+    int ne = nents(edim);
+    for (std::size_t f = 0; f < comm_arrays.size(); ++f) {
+      int length = comm_arrays[f].size();
+      if (ne*(length / ne) != length) {
+        fprintf(stderr, "Comm array size does not match the expected size for dimension %d\n",
+                edim);
+        return handle;
+      }
+    }
+    if (commptr->size() == 1)
+      return handle;
+    handle.active = true;
+    handle.dim = edim;
+
+    //Full mesh arrays are reduced by MPI collectives, only broadcasts are communicated
+    std::vector<Op> field_ops;
+    //Reserved so the counts of reductions in flight do not move
+    handle.full_reductions.reserve(comm_arrays.size());
+    for (std::size_t f = 0; f < comm_arrays.size(); ++f) {
+      if (isFullMesh() && ops[f] != BCAST_OP) {
+        handle.full_reductions.push_back(FullReduction<T>());
+        FullReduction<T>& full = handle.full_reductions.back();
+        full.array = comm_arrays[f];
+        full.nvals = full.array.size() / ne;
+        const std::size_t bytes = full.array.size() * sizeof(T);
+        full.scatter = full_reduce_mode == SCATTER_FULL_REDUCE ||
+          (full_reduce_mode == AUTO_FULL_REDUCE && bytes >= full_reduce_threshold);
+        startFullReduction(edim, ops[f], full);
+      }
+      else {
+        field_ops.push_back(ops[f]);
+        handle.fields.push_back(comm_arrays[f]);
+      }
+    }
+    if (handle.fields.size() == 0)
+      return handle;
+
+    //Entries per entity and reduction op of each entry of the packed array
+    int nvals = 0;
+    std::vector<int> val_ops;
+    for (std::size_t f = 0; f < handle.fields.size(); ++f) {
+      const int field_nvals = handle.fields[f].size() / ne;
+      nvals += field_nvals;
+      val_ops.insert(val_ops.end(), field_nvals, field_ops[f]);
+      handle.fan_in = handle.fan_in || field_ops[f] != BCAST_OP;
+    }
+    handle.nvals = nvals;
+    CommPlan<T>& plan = commPlan<T>(edim, nvals);
+    plan.busy = true;
+    handle.plan = &plan;
+    if (plan.val_ops_host != val_ops) {
+      plan.val_ops_host = val_ops;
+      plan.val_ops = Kokkos::View<int*, device_type>("comm_plan_ops", nvals);
+      Kokkos::View<int*, Kokkos::HostSpace, Kokkos::MemoryTraits<Kokkos::Unmanaged> >
+        val_ops_host(plan.val_ops_host.data(), nvals);
+      Kokkos::deep_copy(plan.val_ops, val_ops_host);
+    }
 
     //Shift comm_array indexing to bulk communication ordering
     Omega_h::Read<Omega_h::LO> arr_index = commArrayIndex(edim);
-    Omega_h::Write<T> array(length, 0);
-    auto convertToComm = OMEGA_H_LAMBDA(const Omega_h::LO id) {
-      for (int i = 0; i < nvals; ++i) {
+    auto array = plan.array;
+    int first = 0;
+    for (std::size_t f = 0; f < handle.fields.size(); ++f) {
+      Omega_h::Write<T> comm_array = handle.fields[f];
+      const int field_nvals = comm_array.size() / ne;
+      auto convertToComm = OMEGA_H_LAMBDA(const Omega_h::LO id) {
         const Omega_h::LO index = arr_index[id];
-        array[index*nvals + i] = comm_array[id*nvals + i];
-      }
-    };
-    Omega_h::parallel_for(ne, convertToComm, "convertToComm");
+        for (int i = 0; i < field_nvals; ++i)
+          array(index*nvals + first + i) = comm_array[id*field_nvals + i];
+      };
+      Omega_h::parallel_for(ne, convertToComm, "convertToComm");
+      first += field_nvals;
+    }
 
     /***************** Fan In ******************/
-    //Move values to host
-    Omega_h::HostWrite<T> host_array(array);
-    T* data = host_array.data();
+    //Fan in is skipped when every op is accept_op
+    if (handle.fan_in) {
+      if (plan.staged)
+        Kokkos::deep_copy(plan.array_stage, array);
+      else
+        Kokkos::fence();
+      if (plan.fan_in_recvs.size() > 0)
+        MPI_Startall(plan.fan_in_recvs.size(), plan.fan_in_recvs.data());
+      if (plan.fan_in_sends.size() > 0)
+        MPI_Startall(plan.fan_in_sends.size(), plan.fan_in_sends.data());
+    }
+    return handle;
+  }
 
-    //Prepare sending and receiving data of cores to the owner of that region
+  template <class T>
+  void Mesh::reduceCommArray_end(ReduceHandle<T>& handle) {
+    if (!handle.active)
+      return;
+    handle.active = false;
+    typedef Kokkos::pair<std::size_t, std::size_t> Range;
+
+    //Finish the reductions of a full mesh
+    for (std::size_t f = 0; f < handle.full_reductions.size(); ++f)
+      finishFullReduction(handle.dim, handle.full_reductions[f]);
+    handle.full_reductions.clear();
+    if (handle.plan == NULL)
+      return;
+
+    CommPlan<T>& plan = *handle.plan;
+    const int edim = handle.dim;
+    const int nvals = handle.nvals;
+    const int ne = nents(edim);
+    auto array = plan.array;
+    auto entry_ops = plan.val_ops;
     Omega_h::HostRead<Omega_h::LO> ent_offsets(offset_ents_per_rank_per_dim[edim]);
-    int my_num_entries = ent_offsets[commptr->rank()+1] - ent_offsets[commptr->rank()];
-    int num_recvs = num_cores[edim] - num_bounds[edim] + num_boundaries[edim];
-    int num_sends = num_cores[edim];
-    Omega_h::HostWrite<T>** neighbor_arrays = new Omega_h::HostWrite<T>*[num_recvs];
-    for (int i = 0; i < num_recvs; ++i)
-      neighbor_arrays[i] = new Omega_h::HostWrite<T>(my_num_entries*nvals);
-    MPI_Request* send_requests = new MPI_Request[num_sends];
-    MPI_Request* recv_requests = new MPI_Request[num_recvs];
-    int index = 0;
-    //Fan in is skipped for accept_op
-    if (op != BCAST_OP) {
-      for (int i = 0; i < num_cores[edim]; ++i) {
-        int rank = buffered_parts[edim][i];
-        int num_entries = ent_offsets[rank+1] - ent_offsets[rank];
-        if (num_entries > 0) {
-          MPI_Isend(data + ent_offsets[rank]*nvals, num_entries*nvals, MpiTraits<T>::datatype(),
-                    rank, is_complete_part[edim][rank], commptr->get_impl(), send_requests + i);
-          if (is_complete_part[edim][rank] == 2) {
-            T* neighbor_data = neighbor_arrays[index]->data();
-            MPI_Irecv(neighbor_data, my_num_entries*nvals, MpiTraits<T>::datatype(), rank, 2,
-                      commptr->get_impl(), recv_requests + index++);
-          }
-        }
-      }
+    const int rank = commptr->rank();
+    int my_num_entries = ent_offsets[rank+1] - ent_offsets[rank];
+    const Omega_h::LO start_index = ent_offsets[rank]*nvals;
+    Omega_h::LOs bounded_ent_ids_local = bounded_ent_ids[edim];
 
-      //Recv data from bounding parts
-      for (Omega_h::LO i = 0; i < num_boundaries[edim]; ++i) {
-        int rank = boundary_parts[edim][i];
-        T* neighbor_data = neighbor_arrays[index]->data();
-        int size = offset_bounded_per_dim[edim][rank+1] - offset_bounded_per_dim[edim][rank];
-        MPI_Irecv(neighbor_data, size*nvals, MpiTraits<T>::datatype(), rank, 1,
-                  commptr->get_impl(), recv_requests + index++);
-      }
-      //Wait for recv completion
-      Omega_h::LOs bounded_ent_ids_local = bounded_ent_ids[edim];
-      for (Omega_h::LO i = 0; i < num_recvs; ++i) {
-        int finished_neighbor = -1;
-        MPI_Status status;
-        MPI_Waitany(num_recvs, recv_requests, &finished_neighbor, &status);
-        //When recv finishes copy data to the device and perform op
-        const Omega_h::LO start_index = ent_offsets[commptr->rank()]*nvals;
-        Omega_h::Write<T> recv_array(*(neighbor_arrays[finished_neighbor]));
-        if (status.MPI_TAG == 2) {
-          if (op == SUM_OP) {
-            auto reduce_op = OMEGA_H_LAMBDA(Omega_h::LO i) {
-              Kokkos::atomic_fetch_add(&(array[start_index + i]),recv_array[i]);
-            };
-            Omega_h::parallel_for(recv_array.size(), reduce_op, "reduce_op");
-          }
-          else if (op == MAX_OP) {
-            auto reduce_op = OMEGA_H_LAMBDA(Omega_h::LO i) {
-              const T x = array[start_index + i];
-              const T y = recv_array[i];
-              array[start_index + i] = maxReduce(x,y);
-            };
-            Omega_h::parallel_for(recv_array.size(), reduce_op, "reduce_op");
-          }
-          else if (op == MIN_OP) {
-            auto reduce_op = OMEGA_H_LAMBDA(Omega_h::LO i) {
-              const T x = array[start_index + i];
-              const T y = recv_array[i];
-              array[start_index + i] = minReduce(x,y);
-            };
-            Omega_h::parallel_for(recv_array.size(), reduce_op, "reduce_op");
-          }
+    /***************** Fan In ******************/
+    if (handle.fan_in) {
+      //Reduce each message on the device as it arrives
+      const int num_recvs = plan.fan_in_recvs.size();
+      auto recv_buffer = plan.recv_buffer;
+      for (int i = 0; i < num_recvs; ++i) {
+        int finished = -1;
+        MPI_Waitany(num_recvs, plan.fan_in_recvs.data(), &finished, MPI_STATUS_IGNORE);
+        const std::size_t recv_start = plan.recv_offsets[finished];
+        if (plan.staged) {
+          Range range(recv_start, plan.recv_offsets[finished+1]);
+          Kokkos::deep_copy(Kokkos::subview(recv_buffer, range),
+                            Kokkos::subview(plan.recv_stage, range));
+        }
+        if (plan.recv_tags[finished] == 2) {
+          auto reduce_op = OMEGA_H_LAMBDA(Omega_h::LO i) {
+            reduceValue(Op(entry_ops(i % nvals)), array(start_index + i),
+                        recv_buffer(recv_start + i));
+          };
+          Omega_h::parallel_for(my_num_entries*nvals, reduce_op, "reduce_op");
         }
         else {
-          const int size = offset_bounded_per_dim[edim][finished_neighbor+1] -
-            offset_bounded_per_dim[edim][finished_neighbor];
-          const int start = offset_bounded_per_dim[edim][finished_neighbor];
-          if (op == SUM_OP) {
-            auto reduce_op = OMEGA_H_LAMBDA(Omega_h::LO i) {
-              int index = bounded_ent_ids_local[start+i];
-              for (int j = 0; j < nvals; ++j) {
-                Kokkos::atomic_fetch_add(&(array[start_index + index*nvals + j]),
-                                         recv_array[i*nvals + j]);
-              }
-            };
-            Omega_h::parallel_for(size, reduce_op, "reduce_op");
-          }
-          else if (op == MAX_OP) {
-            auto reduce_op = OMEGA_H_LAMBDA(Omega_h::LO i) {
-              int index = bounded_ent_ids_local[start+i];
-              for (int j = 0; j < nvals; ++j) {
-                const Omega_h::LO k = start_index + index*nvals + j;
-                const T x = array[k];
-                const T y = recv_array[i*nvals + j];
-                array[k] = maxReduce(x,y);
-              }
-            };
-            Omega_h::parallel_for(size, reduce_op, "reduce_op");
-          }
-          else if (op == MIN_OP) {
-            auto reduce_op = OMEGA_H_LAMBDA(Omega_h::LO i) {
-              int index = bounded_ent_ids_local[start+i];
-              for (int j = 0; j < nvals; ++j) {
-                const Omega_h::LO k = start_index + index*nvals + j;
-                const T x = array[k];
-                const T y = recv_array[i*nvals + j];
-                array[k] = minReduce(x,y);
-              }
-            };
-            Omega_h::parallel_for(size, reduce_op, "reduce_op");
-          }
+          const int sender = plan.recv_ranks[finished];
+          const int size = offset_bounded_per_dim[edim][sender+1] -
+            offset_bounded_per_dim[edim][sender];
+          const int start = offset_bounded_per_dim[edim][sender];
+          auto reduce_op = OMEGA_H_LAMBDA(Omega_h::LO i) {
+            int index = bounded_ent_ids_local[start+i];
+            for (int j = 0; j < nvals; ++j)
+              reduceValue(Op(entry_ops(j)), array(start_index + index*nvals + j),
+                          recv_buffer(recv_start + i*nvals + j));
+          };
+          Omega_h::parallel_for(size, reduce_op, "reduce_op");
         }
-        delete neighbor_arrays[finished_neighbor];
       }
-      MPI_Waitall(num_sends, send_requests,MPI_STATUSES_IGNORE);
-      delete [] neighbor_arrays;
+      MPI_Waitall(plan.fan_in_sends.size(), plan.fan_in_sends.data(), MPI_STATUSES_IGNORE);
     }
+
     /***************** Fan Out ******************/
-    //Flip the sizes of the request arrays
-    MPI_Request* temp = send_requests;
-    send_requests = recv_requests;
-    recv_requests = temp;
-    int tempi = num_sends;
-    num_sends = num_recvs;
-    num_recvs = tempi;
-    Omega_h::HostWrite<T> reduced_host_array(array);
-    data = reduced_host_array.data();
-    index = 0;
-    for (int i = 0; i < num_cores[edim]; ++i) {
-      int rank = buffered_parts[edim][i];
-      int num_entries = ent_offsets[rank+1] - ent_offsets[rank];
-      if (num_entries > 0) {
-        if (is_complete_part[edim][rank]==2) {
-          MPI_Isend(data + ent_offsets[commptr->rank()]*nvals, my_num_entries*nvals,
-                    MpiTraits<T>::datatype(), rank, 3,
-                    commptr->get_impl(), send_requests + index++);
-        }
-        MPI_Irecv(data + ent_offsets[rank]*nvals, num_entries*nvals, MpiTraits<T>::datatype(),
-                  rank, 3, commptr->get_impl(), recv_requests + i);
-      }
-    }
     //Gather the boundary data to send
-    Omega_h::LOs bounded_ent_ids_local = bounded_ent_ids[edim];
-    Omega_h::Write<T> boundary_array(bounded_ent_ids_local.size()*nvals);
-    const Omega_h::LO start_index = ent_offsets[commptr->rank()]*nvals;
+    auto boundary_array = plan.boundary_array;
     auto gatherBoundaryData = OMEGA_H_LAMBDA(const Omega_h::LO id) {
       const Omega_h::LO index = bounded_ent_ids_local[id];
       for (int i = 0; i < nvals; ++i)
-        boundary_array[id*nvals + i] = array[start_index + index*nvals + i];
+        boundary_array(id*nvals + i) = array(start_index + index*nvals + i);
     };
     Omega_h::parallel_for(bounded_ent_ids_local.size(),gatherBoundaryData, "gatherBoundaryData");
+    if (plan.staged) {
+      Kokkos::deep_copy(plan.boundary_stage, boundary_array);
+      Kokkos::deep_copy(plan.array_stage, array);
+    }
+    else
+      Kokkos::fence();
+    if (plan.fan_out_recvs.size() > 0)
+      MPI_Startall(plan.fan_out_recvs.size(), plan.fan_out_recvs.data());
+    if (plan.fan_out_sends.size() > 0)
+      MPI_Startall(plan.fan_out_sends.size(), plan.fan_out_sends.data());
+    MPI_Waitall(plan.fan_out_recvs.size(), plan.fan_out_recvs.data(), MPI_STATUSES_IGNORE);
+    MPI_Waitall(plan.fan_out_sends.size(), plan.fan_out_sends.data(), MPI_STATUSES_IGNORE);
+    if (plan.staged)
+      Kokkos::deep_copy(array, plan.array_stage);
 
-    Omega_h::HostWrite<T> boundary_array_host(boundary_array);
-    T* sending_data = boundary_array_host.data();
-    for (int i = 0; i < num_boundaries[edim]; ++i) {
-      int rank = boundary_parts[edim][i];
-      int size = offset_bounded_per_dim[edim][rank+1] - offset_bounded_per_dim[edim][rank];
-      int start = offset_bounded_per_dim[edim][rank]*nvals;
-      MPI_Isend(sending_data+start, size*nvals, MpiTraits<T>::datatype(), rank, 3,
-                commptr->get_impl(), send_requests + index++);
-    }
-    MPI_Waitall(num_recvs, recv_requests,MPI_STATUSES_IGNORE);
-    MPI_Waitall(num_sends, send_requests,MPI_STATUSES_IGNORE);
-    delete [] send_requests;
-    delete [] recv_requests;
-
-    //Copy reduced array from host to device
-    Omega_h::Write<T> reduced_array(reduced_host_array);
-    auto setArrayValues = OMEGA_H_LAMBDA(Omega_h::LO i) {
-      array[i] = reduced_array[i];
-    };
-    Omega_h::parallel_for(array.size(), setArrayValues, "setArrayValues");
-
-    auto convertFromComm = OMEGA_H_LAMBDA(const Omega_h::LO id) {
-      const Omega_h::LO index = arr_index[id];
-      for (int i = 0; i < nvals; ++i)
-        comm_array[id*nvals + i] = array[index*nvals + i];
-    };
-    Omega_h::parallel_for(ne, convertFromComm, "convertFromComm");
+    Omega_h::Read<Omega_h::LO> arr_index = commArrayIndex(edim);
+    int first = 0;
+    for (std::size_t f = 0; f < handle.fields.size(); ++f) {
+      Omega_h::Write<T> comm_array = handle.fields[f];
+      const int field_nvals = comm_array.size() / ne;
+      auto convertFromComm = OMEGA_H_LAMBDA(const Omega_h::LO id) {
+        const Omega_h::LO index = arr_index[id];
+        for (int i = 0; i < field_nvals; ++i)
+          comm_array[id*field_nvals + i] = array(index*nvals + first + i);
+      };
+      Omega_h::parallel_for(ne, convertFromComm, "convertFromComm");
+      first += field_nvals;
+    }
+    Kokkos::fence();
+    plan.busy = false;
+    handle.plan = NULL;
   }
 
 
 #define INST(T)                                                         \
   template Omega_h::Write<T> Mesh::createCommArray(int, int, T);        \
-  template void Mesh::reduceCommArray(int, Op, Omega_h::Write<T>);
+  template CommPlan<T>& Mesh::commPlan<T>(int, int);                    \
+  template void Mesh::reduceCommArray(int, Op, Omega_h::Write<T>);      \
+  template void Mesh::reduceCommArrays(int, const std::vector<Op>&,     \
+    const std::vector<Omega_h::Write<T> >&);                            \
+  template ReduceHandle<T> Mesh::reduceCommArray_begin(int, Op,         \
+    Omega_h::Write<T>);                                                 \
+  template ReduceHandle<T> Mesh::reduceCommArrays_begin(int,            \
+    const std::vector<Op>&, const std::vector<Omega_h::Write<T> >&);    \
+  template void Mesh::reduceCommArray_end(ReduceHandle<T>&);            \
+  template Omega_h::Write<T> Mesh::toCommArray(int,                     \
+    const std::vector<Omega_h::Read<T> >&);                             \
+  template std::vector<Omega_h::Write<T> > Mesh::fromCommArray(int,     \
+    Omega_h::Read<T>, const std::vector<int>&);                         \
+  template void Mesh::reduceTags<T>(int, Op,                            \
+    const std::vector<std::string>&, const std::string&);               \
+  template void Mesh::reduceTags<T>(int, Op, const std::vector<std::string>&);
 
   INST(Omega_h::LO)
   INST(Omega_h::Real)
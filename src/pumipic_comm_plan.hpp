@@ -0,0 +1,131 @@
+#pragma once
+#include <Kokkos_Core.hpp>
+#include <Omega_h_array.hpp>
+#include <BufferPool.h>
+#include <MemoryTracker.h>
+#include <mpi.h>
+#include <vector>
+#include "pumipic_kktypes.hpp"
+
+namespace pumipic {
+  class Mesh;
+
+  //Type erased base so plans of every type can be stored by the Mesh
+  struct CommPlanBase {
+    virtual ~CommPlanBase() {}
+    //Device and staging memory held by the plan
+    virtual std::size_t bytes() const = 0;
+    //bytes() of the plan tracked as pumipic_comm_plans
+    particle_structs::TrackedBytes memory;
+  };
+
+  /* Persistent communication of reduceCommArray for one (dimension, entries per entity, type)
+
+     The ranks, offsets and message sizes of a picpart are fixed once it is built, so the plan
+     is created on the first reduction. It owns the bulk ordered array, the receive and
+     boundary buffers (with their pinned host stages when MPI can not read device memory) and
+     persistent requests (MPI_Send_init/MPI_Recv_init) bound to them. After that a reduction
+     only starts/waits the requests and runs the reduction kernels.
+
+     Note: A plan is used by one reduction at a time, reductions in flight together get
+           separate plans.
+  */
+  template <class T>
+  struct CommPlan : public CommPlanBase {
+    typedef Kokkos::View<T*, device_type> DeviceView;
+    typedef Kokkos::View<T*, particle_structs::StagingDevice> StageView;
+
+    CommPlan() : nvals(0), staged(false), busy(false) {}
+    ~CommPlan() {
+      int finalized;
+      MPI_Finalized(&finalized);
+      if (finalized)
+        return;
+      freeRequests(fan_in_sends);
+      freeRequests(fan_in_recvs);
+      freeRequests(fan_out_sends);
+      freeRequests(fan_out_recvs);
+    }
+
+    std::size_t bytes() const {
+      return (array.size() + array_stage.size() + recv_buffer.size() + recv_stage.size() +
+              boundary_array.size() + boundary_stage.size()) * sizeof(T) +
+        val_ops.size() * sizeof(int);
+    }
+
+    int nvals;
+    bool staged;
+    //True while a reduction using the plan is in flight
+    bool busy;
+    //Comm array in bulk communication ordering
+    DeviceView array;
+    StageView array_stage;
+    //Fan in messages from complete buffers (tag 2) and bounding parts (tag 1)
+    DeviceView recv_buffer;
+    StageView recv_stage;
+    std::vector<std::size_t> recv_offsets;
+    std::vector<int> recv_ranks;
+    std::vector<int> recv_tags;
+    //Owned values of the entities bounded by each bounding part
+    DeviceView boundary_array;
+    StageView boundary_stage;
+    //Reduction op of each of the nvals entries of an entity, updated when the ops change
+    std::vector<int> val_ops_host;
+    Kokkos::View<int*, device_type> val_ops;
+    //Persistent requests of each phase
+    std::vector<MPI_Request> fan_in_sends, fan_in_recvs;
+    std::vector<MPI_Request> fan_out_sends, fan_out_recvs;
+
+  private:
+    static void freeRequests(std::vector<MPI_Request>& requests) {
+      for (std::size_t i = 0; i < requests.size(); ++i)
+        if (requests[i] != MPI_REQUEST_NULL)
+          MPI_Request_free(&(requests[i]));
+    }
+  };
+
+  /* Reduction of one array of a full mesh picpart
+       allreduce - MPI_Iallreduce of the whole array
+       scatter - MPI_Ireduce_scatter of the bulk ordered array so each rank gets its owned
+                 entities, then an MPI_Allgatherv of the owned entities
+  */
+  template <class T>
+  struct FullReduction {
+    Omega_h::Write<T> array;
+    int nvals;
+    bool scatter;
+    //Bulk ordered array and the owned entries (scatter only)
+    typename CommPlan<T>::DeviceView bulk, owned;
+    //Host stages of the array (or bulk array) and owned entries
+    typename CommPlan<T>::StageView stage, owned_stage;
+    //Entries owned by each rank and their offsets in the bulk array (scatter only)
+    std::vector<int> counts, displacements;
+    MPI_Request request;
+  };
+
+  /* State of a reduction between Mesh::reduceCommArray(s)_begin and reduceCommArray_end
+       Only valid for the Mesh that created it
+  */
+  template <class T>
+  class ReduceHandle {
+  public:
+    ReduceHandle() : active(false), dim(0), nvals(0), fan_in(false), plan(NULL) {}
+    ReduceHandle(const ReduceHandle&) = delete;
+    ReduceHandle& operator=(const ReduceHandle&) = delete;
+    ReduceHandle(ReduceHandle&&) = default;
+    ReduceHandle& operator=(ReduceHandle&&) = default;
+    //True between begin and end
+    bool isActive() const {return active;}
+  private:
+    friend class Mesh;
+    bool active;
+    int dim, nvals;
+    //False if every op is a broadcast
+    bool fan_in;
+    CommPlan<T>* plan;
+    //Arrays reduced through the plan
+    std::vector<Omega_h::Write<T> > fields;
+    //Full mesh reductions in flight
+    std::vector<FullReduction<T> > full_reductions;
+  };
+}
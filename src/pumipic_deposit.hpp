@@ -0,0 +1,214 @@
+#pragma once
+#include <cstdio>
+#include <Omega_h_for.hpp>
+#include <Omega_h_shape.hpp>
+#include <Omega_h_sort.hpp>
+#include <particle_structs.hpp>
+#include "pumipic_mesh.hpp"
+#include "pumipic_profiling.hpp"
+
+namespace pumipic {
+
+  /* Back ends of deposit
+       DEPOSIT_ATOMIC - one atomic add per particle and element vertex
+       DEPOSIT_TEAM - one team per element (SellCSigma structures only) reduces the
+                      contributions of its particles before one atomic add per vertex
+       DEPOSIT_SORTED - particles emit their vertex contributions, which are sorted and
+                        summed per vertex without atomics (results do not depend on the
+                        order of the particles)
+       DEPOSIT_AUTO - TEAM on SellCSigma, otherwise SORTED when the particles per vertex
+                      exceed sort_threshold and ATOMIC elsewhere
+  */
+  enum DepositEngine {
+    DEPOSIT_ATOMIC,
+    DEPOSIT_TEAM,
+    DEPOSIT_SORTED,
+    DEPOSIT_AUTO
+  };
+
+  /* Interpolation from a particle to the vertices of its element
+       DEPOSIT_ORDER_ELEMENT - equal shares to every vertex (order 0)
+       DEPOSIT_ORDER_LINEAR - barycentric coordinates of the particle position (order 1)
+  */
+  enum DepositOrder {
+    DEPOSIT_ORDER_ELEMENT = 0,
+    DEPOSIT_ORDER_LINEAR = 1
+  };
+
+  namespace deposit_impl {
+    //First index of sorted[0, size) that is not less than value
+    OMEGA_H_INLINE Omega_h::LO lowerBound(const Omega_h::LOs& sorted, Omega_h::LO size,
+                                          Omega_h::LO value) {
+      Omega_h::LO first = 0;
+      while (size > 0) {
+        const Omega_h::LO half = size / 2;
+        if (sorted[first + half] < value) {
+          first += half + 1;
+          size -= half + 1;
+        }
+        else
+          size = half;
+      }
+      return first;
+    }
+
+    //Shares of a particle for each vertex of its element
+    template <int DIM, class Segment>
+    struct VertexShares {
+      VertexShares(Omega_h::Mesh& mesh, Segment x_ps, DepositOrder deposit_order) :
+        coords(mesh.coords()), x(x_ps), linear(deposit_order == DEPOSIT_ORDER_LINEAR) {}
+      OMEGA_H_DEVICE Omega_h::Vector<DIM + 1> operator()(const Omega_h::LO pid,
+          const Omega_h::Few<Omega_h::LO, DIM + 1>& verts) const {
+        Omega_h::Vector<DIM + 1> shares;
+        if (!linear) {
+          for (int i = 0; i < DIM + 1; ++i)
+            shares[i] = 1.0 / (DIM + 1);
+          return shares;
+        }
+        const auto vertCoords = Omega_h::gather_vectors<DIM + 1, DIM>(coords, verts);
+        Omega_h::Vector<DIM> pos;
+        for (int i = 0; i < DIM; ++i)
+          pos[i] = x(pid, i);
+        return Omega_h::barycentric_from_global<DIM, DIM>(pos, vertCoords);
+      }
+      Omega_h::Reals coords;
+      Segment x;
+      bool linear;
+    };
+
+    template <int DIM, int PTCL_X, int PTCL_W, class ParticleStruct>
+    void depositDim(Omega_h::Mesh& mesh, ParticleStruct* ptcls, DepositOrder order,
+                    DepositEngine engine, Omega_h::Write<Omega_h::Real> array) {
+      typedef particle_structs::SellCSigma<typename ParticleStruct::Types,
+                                           typename ParticleStruct::memory_space> SCS;
+      const auto elem_verts = mesh.ask_elem_verts();
+      const Omega_h::LO nverts = mesh.nverts();
+      auto x = ptcls->template get<PTCL_X>();
+      auto w = ptcls->template get<PTCL_W>();
+      const VertexShares<DIM, decltype(x)> shares(mesh, x, order);
+      if (engine == DEPOSIT_TEAM) {
+        SCS* scs = dynamic_cast<SCS*>(ptcls);
+        const Omega_h::LO nelems = mesh.nelems();
+        //The vertex sums of the element are reduced in scratch before one atomic each
+        const std::size_t bytes = (DIM + 1) * sizeof(Omega_h::Real);
+        auto depositElement = PS_LAMBDA(const typename SCS::TeamMember& team, const int& e,
+                                        const typename SCS::RowParticles& row) {
+          Omega_h::Real* sums = (Omega_h::Real*)team.team_shmem().get_shmem(bytes);
+          if (e >= nelems)
+            return;
+          const auto verts = Omega_h::gather_verts<DIM + 1>(elem_verts, e);
+          Kokkos::single(Kokkos::PerTeam(team), [=]() {
+            for (int j = 0; j < DIM + 1; ++j)
+              sums[j] = 0;
+          });
+          team.team_barrier();
+          Kokkos::parallel_for(Kokkos::TeamThreadRange(team, row.size()), [=](const int& i) {
+            if (row.mask(i)) {
+              const auto pid = row(i);
+              const auto s = shares(pid, verts);
+              for (int j = 0; j < DIM + 1; ++j)
+                Kokkos::atomic_fetch_add(&(sums[j]), w(pid) * s[j]);
+            }
+          });
+          team.team_barrier();
+          Kokkos::parallel_for(Kokkos::TeamThreadRange(team, DIM + 1), [=](const int& j) {
+            if (sums[j] != 0)
+              Kokkos::atomic_fetch_add(&(array[verts[j]]), sums[j]);
+          });
+        };
+        scs->parallel_for_elements(depositElement, bytes, -1, "pumipic_deposit_team");
+      }
+      else if (engine == DEPOSIT_SORTED) {
+        //Each slot emits a key and value for every vertex (key nverts if empty)
+        const Omega_h::LO nkeys = ptcls->capacity() * (DIM + 1);
+        Omega_h::Write<Omega_h::LO> keys(nkeys, "deposit_keys");
+        Omega_h::Write<Omega_h::Real> values(nkeys, "deposit_values");
+        auto emit = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+          for (int j = 0; j < DIM + 1; ++j) {
+            keys[pid * (DIM + 1) + j] = nverts;
+            values[pid * (DIM + 1) + j] = 0;
+          }
+          if (mask) {
+            const auto verts = Omega_h::gather_verts<DIM + 1>(elem_verts, e);
+            const auto s = shares(pid, verts);
+            for (int j = 0; j < DIM + 1; ++j) {
+              keys[pid * (DIM + 1) + j] = verts[j];
+              values[pid * (DIM + 1) + j] = w(pid) * s[j];
+            }
+          }
+        };
+        particle_structs::parallel_for(ptcls, emit, "pumipic_deposit_emit");
+        Omega_h::LOs order = Omega_h::sort_by_keys(Omega_h::LOs(keys));
+        Omega_h::Write<Omega_h::LO> sorted(nkeys, "deposit_sorted_keys");
+        auto orderKeys = OMEGA_H_LAMBDA(const Omega_h::LO& i) {
+          sorted[i] = keys[order[i]];
+        };
+        Omega_h::parallel_for(nkeys, orderKeys, "pumipic_deposit_order");
+        Omega_h::LOs sorted_keys(sorted);
+        auto sumRuns = OMEGA_H_LAMBDA(const Omega_h::LO& v) {
+          const Omega_h::LO first = lowerBound(sorted_keys, nkeys, v);
+          const Omega_h::LO last = lowerBound(sorted_keys, nkeys, v + 1);
+          Omega_h::Real sum = 0;
+          for (Omega_h::LO i = first; i < last; ++i)
+            sum += values[order[i]];
+          array[v] += sum;
+        };
+        Omega_h::parallel_for(nverts, sumRuns, "pumipic_deposit_sum");
+      }
+      else {
+        auto depositParticle = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+          if (mask) {
+            const auto verts = Omega_h::gather_verts<DIM + 1>(elem_verts, e);
+            const auto s = shares(pid, verts);
+            for (int j = 0; j < DIM + 1; ++j)
+              Kokkos::atomic_fetch_add(&(array[verts[j]]), w(pid) * s[j]);
+          }
+        };
+        particle_structs::parallel_for(ptcls, depositParticle, "pumipic_deposit_atomic");
+      }
+    }
+  }
+
+  /* Deposits a particle member onto the vertices of the picpart and sums the picparts
+       PTCL_X - member of the particle positions (3 components, 2 used on 2d meshes)
+       PTCL_W - scalar member deposited (i.e. charge, or one current component)
+       order - interpolation from each particle to its element vertices
+       engine - back end, DEPOSIT_AUTO picks it from the structure and the particles per
+                vertex compared to sort_threshold
+     Returns the vertex communication array (Mesh::createCommArray) after
+       reduceCommArray(SUM_OP), so every copy of a vertex holds the total of all picparts
+     ParticleStruct is any particle structure, passing the concrete structure (i.e.
+       SellCSigma) dispatches the kernels statically.
+     Note: this is a collective call over the picparts
+  */
+  template <int PTCL_X, int PTCL_W, class ParticleStruct>
+  Omega_h::Write<Omega_h::Real> deposit(Mesh& picparts, ParticleStruct* ptcls,
+      DepositOrder order = DEPOSIT_ORDER_LINEAR, DepositEngine engine = DEPOSIT_AUTO,
+      double sort_threshold = 16) {
+    Kokkos::Profiling::pushRegion("pumipic_deposit");
+    Omega_h::Mesh& mesh = *picparts.mesh();
+    const int dim = mesh.dim();
+    Omega_h::Write<Omega_h::Real> array = picparts.createCommArray<Omega_h::Real>(0, 1, 0);
+    typedef particle_structs::SellCSigma<typename ParticleStruct::Types,
+                                         typename ParticleStruct::memory_space> SCS;
+    const bool is_scs = dynamic_cast<SCS*>(ptcls) != NULL;
+    if (engine == DEPOSIT_TEAM && !is_scs) {
+      fprintf(stderr, "[WARNING] Team deposition requires a SellCSigma, using atomics\n");
+      engine = DEPOSIT_ATOMIC;
+    }
+    if (engine == DEPOSIT_AUTO) {
+      const double ptcls_per_vert = (double)ptcls->nPtcls() * (dim + 1) / (mesh.nverts() + 1);
+      engine = is_scs ? DEPOSIT_TEAM :
+        ptcls_per_vert > sort_threshold ? DEPOSIT_SORTED : DEPOSIT_ATOMIC;
+    }
+    if (dim == 3)
+      deposit_impl::depositDim<3, PTCL_X, PTCL_W>(mesh, ptcls, order, engine, array);
+    else if (dim == 2)
+      deposit_impl::depositDim<2, PTCL_X, PTCL_W>(mesh, ptcls, order, engine, array);
+    else
+      fprintf(stderr, "[ERROR] deposit only supports 2d and 3d meshes\n");
+    picparts.reduceCommArray(0, Mesh::SUM_OP, array);
+    Kokkos::Profiling::popRegion();
+    return array;
+  }
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <Omega_h_array.hpp>
+
+namespace pumipic {
+
+  /* Immutable global id to local id lookup of the entities of one dimension
+
+     The global ids are sorted once with the local id of each beside them, so a lookup is a
+     binary search over one contiguous array instead of probing a hash table. The object is a
+     pair of reference counted arrays and is copied by value into device lambdas.
+
+     Note: find returns -1 for a global id that is not in the picpart
+  */
+  class GlobalIdIndex {
+  public:
+    GlobalIdIndex() {}
+    //Builds the index of gids sized nents
+    explicit GlobalIdIndex(Omega_h::GOs gids);
+
+    bool exists() const {return sorted_gids.exists();}
+    Omega_h::LO size() const {return sorted_gids.size();}
+    //Global ids in increasing order and the local id of each
+    Omega_h::GOs sortedIds() const {return sorted_gids;}
+    Omega_h::LOs sortedLids() const {return sorted_lids;}
+
+    OMEGA_H_DEVICE Omega_h::LO find(const Omega_h::GO gid) const {
+      Omega_h::LO first = 0;
+      Omega_h::LO last = sorted_gids.size();
+      while (first < last) {
+        const Omega_h::LO mid = first + (last - first) / 2;
+        if (sorted_gids[mid] < gid)
+          first = mid + 1;
+        else
+          last = mid;
+      }
+      if (first < sorted_gids.size() && sorted_gids[first] == gid)
+        return sorted_lids[first];
+      return -1;
+    }
+
+  private:
+    Omega_h::GOs sorted_gids;
+    Omega_h::LOs sorted_lids;
+  };
+}
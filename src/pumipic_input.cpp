@@ -1,8 +1,130 @@
 #include "pumipic_input.hpp"
+#include <Omega_h_comm.hpp>
+#include <mpi.h>
 #include <fstream>
 #include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
 
 namespace {
+  //Leading bytes of a binary partition file
+  const char binary_magic[8] = {'P', 'U', 'M', 'I', 'P', 'T', 'N', '\0'};
+
+  //Reads every integer of a text file with one read of the file
+  bool readTextFile(const char* filename, std::vector<int>& values) {
+    FILE* file = fopen(filename, "rb");
+    if (!file)
+      return false;
+    fseek(file, 0, SEEK_END);
+    const long bytes = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    std::vector<char> text(bytes + 1, '\0');
+    const bool read = fread(text.data(), 1, bytes, file) == (std::size_t)bytes;
+    fclose(file);
+    if (!read)
+      return false;
+    char* pos = text.data();
+    char* end = pos;
+    while (true) {
+      const long value = strtol(pos, &end, 10);
+      if (end == pos)
+        break;
+      values.push_back(value);
+      pos = end;
+    }
+    return true;
+  }
+
+  /* Binary partition layout (native byte order)
+       8 bytes - binary_magic
+       int32 - ownership rule (Input::PARTITION or Input::CLASSIFICATION)
+       int32 - n
+       n int32 - owner of each element (PARTITION) or of each classification id
+  */
+  bool readBinaryFile(const char* filename, int& rule, std::vector<int>& values) {
+    FILE* file = fopen(filename, "rb");
+    if (!file)
+      return false;
+    char magic[8];
+    int header[2];
+    bool read = fread(magic, 1, 8, file) == 8 && memcmp(magic, binary_magic, 8) == 0 &&
+      fread(header, sizeof(int), 2, file) == 2 && header[1] >= 0;
+    if (read) {
+      rule = header[0];
+      values.resize(header[1]);
+      read = fread(values.data(), sizeof(int), header[1], file) == (std::size_t)header[1];
+    }
+    fclose(file);
+    return read;
+  }
+
+  //Dense owners of each classification id from the (size, cid own ...) values of a .cpn
+  std::vector<int> classificationOwners(const std::vector<int>& values) {
+    std::vector<int> owners(values.size() > 0 ? values[0] + 1 : 0, 0);
+    for (std::size_t i = 1; i + 1 < values.size(); i += 2)
+      if (values[i] >= 0 && values[i] < (int)owners.size())
+        owners[values[i]] = values[i+1];
+    return owners;
+  }
+
+  /* Reads a partition file on rank 0 and broadcasts it to the other ranks
+       ptn/cpn - text element or classification partition
+       bpn - binary partition written by Input::convertPartition
+     Returns false on every rank if the file can not be read
+  */
+  bool loadPartition(Omega_h::CommPtr comm, const char* filename, const char* extension,
+                     int& rule, std::vector<int>& owners) {
+    int header[2] = {-1, 0};
+    if (!comm->rank()) {
+      std::vector<int> values;
+      bool read = false;
+      if (strcmp(extension, "bpn") == 0)
+        read = readBinaryFile(filename, rule, owners);
+      else if (readTextFile(filename, values)) {
+        read = true;
+        rule = strcmp(extension, "cpn") == 0 ? pumipic::Input::CLASSIFICATION :
+          pumipic::Input::PARTITION;
+        if (rule == pumipic::Input::CLASSIFICATION)
+          owners = classificationOwners(values);
+        else
+          owners.swap(values);
+      }
+      if (read) {
+        header[0] = rule;
+        header[1] = owners.size();
+      }
+    }
+    MPI_Comm mpi_comm = comm->get_impl();
+    MPI_Bcast(header, 2, MPI_INT, 0, mpi_comm);
+    if (header[0] < 0)
+      return false;
+    rule = header[0];
+    owners.resize(header[1]);
+    MPI_Bcast(owners.data(), header[1], MPI_INT, 0, mpi_comm);
+    return true;
+  }
+
+  //FNV-1a hash of bytes continuing from hash
+  std::uint64_t hashBytes(std::uint64_t hash, const void* data, std::size_t bytes) {
+    const unsigned char* values = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < bytes; ++i) {
+      hash ^= values[i];
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+  template <typename T>
+  std::uint64_t hashArray(std::uint64_t hash, Omega_h::Read<T> array) {
+    Omega_h::HostRead<T> array_h(array);
+    const int size = array_h.size();
+    hash = hashBytes(hash, &size, sizeof(int));
+    if (size)
+      hash = hashBytes(hash, array_h.data(), size * sizeof(T));
+    return hash;
+  }
+
   std::string getMethodString(pumipic::Input::Method m) {
     if( m == pumipic::Input::FULL )
       return "FULL";
@@ -40,42 +162,29 @@ namespace pumipic {
         throw std::runtime_error("Filename has no extension");
       }
       char* extension = partition_filename + dot + 1;
-      if (strcmp(extension, "ptn") == 0) {
-        Omega_h::HostWrite<Omega_h::LO> partition_vector(mesh.nelems());
-        std::ifstream in_str(partition_filename);
-        if (!in_str) {
-          if (!comm_rank)
-            fprintf(stderr,"Cannot open file %s\n", partition_filename);
-          throw std::runtime_error("Cannot open file");
-        }
-        int own;
-        int index = 0;
-        while(in_str >> own)
-          partition_vector[index++] = own;
-        partition = Omega_h::LOs(Omega_h::Write<Omega_h::LO>(partition_vector));
+      if (strcmp(extension, "ptn") != 0 && strcmp(extension, "cpn") != 0 &&
+          strcmp(extension, "bpn") != 0) {
+        fprintf(stderr, "[ERROR] Only .ptn, .cpn and .bpn partitions are supported");
+        throw std::runtime_error("Invalid partition file extension");
       }
-      else if (strcmp(extension, "cpn") == 0) {
-        ownership_rule=CLASSIFICATION;
-        std::ifstream in_str(partition_filename);
-        if (!in_str) {
-          if (!comm_rank)
-            fprintf(stderr,"Cannot open file %s\n", partition_filename);
-          throw std::runtime_error("Cannot open file");
-        }
-        int size;
-        in_str>>size;
-        Omega_h::HostWrite<Omega_h::LO> host_owners(size+1, "host_owners");
-        int cid, own;
-        while(in_str >> cid >> own)
-          host_owners[cid] = own;
-
-        partition = Omega_h::LOs(Omega_h::Write<Omega_h::LO>(host_owners));
-
+      int rule;
+      std::vector<int> owners;
+      if (!loadPartition(comm, partition_filename, extension, rule, owners)) {
+        if (!comm_rank)
+          fprintf(stderr,"Cannot open file %s\n", partition_filename);
+        throw std::runtime_error("Cannot open file");
       }
-      else {
-        fprintf(stderr, "[ERROR] Only .ptn and .cpn partitions are supported");
-        throw std::runtime_error("Invalid partition file extension");
+      ownership_rule = rule == CLASSIFICATION ? CLASSIFICATION : PARTITION;
+      if (ownership_rule == PARTITION && (int)owners.size() != mesh.nelems()) {
+        if (!comm_rank)
+          fprintf(stderr, "[ERROR] Partition %s has %d entries for %d elements\n",
+                  partition_filename, (int)owners.size(), mesh.nelems());
+        throw std::runtime_error("Partition size does not match the mesh");
       }
+      Omega_h::HostWrite<Omega_h::LO> host_owners(owners.size(), "host_owners");
+      for (std::size_t i = 0; i < owners.size(); ++i)
+        host_owners[i] = owners[i];
+      partition = Omega_h::LOs(Omega_h::Write<Omega_h::LO>(host_owners));
     }
     bufferMethod = bufferMethod_;
     if (bufferMethod == NONE) {
@@ -88,6 +197,8 @@ namespace pumipic {
     bridge_dim = 0;
     bufferBFSLayers = 3;
     safeBFSLayers = 1;
+    reorder_elements = false;
+    share_node_buffers = false;
 
     if (bufferMethod == MINIMUM)
       bufferBFSLayers = 0;
@@ -115,6 +226,40 @@ namespace pumipic {
     bridge_dim = 0;
     bufferBFSLayers = 3;
     safeBFSLayers = 1;
+    reorder_elements = false;
+    share_node_buffers = false;
+
+    if (bufferMethod == MINIMUM)
+      bufferBFSLayers = 0;
+    if (safeMethod == MINIMUM)
+      safeBFSLayers = 0;
+  }
+
+  Input::Input(Omega_h::Mesh& mesh, Method bufferMethod_, Method safeMethod_,
+               Omega_h::CommPtr c) : m(mesh) {
+    ownership_rule = DISTRIBUTED;
+    if (!c)
+      comm = mesh.comm();
+    else
+      comm = c;
+    bufferMethod = bufferMethod_;
+    if (bufferMethod == FULL) {
+      if (!comm->rank())
+        fprintf(stderr, "[ERROR] bufferMethod FULL requires the full mesh on every process\n");
+      throw std::runtime_error("Invalid buffer method for a distributed mesh");
+    }
+    if (bufferMethod == NONE) {
+      if (!comm->rank())
+        printf("[WARNING] bufferMethod given as NONE, setting to MINIMUM\n");
+      bufferMethod=MINIMUM;
+    }
+    safeMethod = safeMethod_;
+
+    bridge_dim = 0;
+    bufferBFSLayers = 3;
+    safeBFSLayers = 1;
+    reorder_elements = false;
+    share_node_buffers = false;
 
     if (bufferMethod == MINIMUM)
       bufferBFSLayers = 0;
@@ -122,6 +267,31 @@ namespace pumipic {
       safeBFSLayers = 0;
   }
 
+  bool Input::convertPartition(const char* text_filename, const char* binary_filename) {
+    int len = strlen(text_filename);
+    const bool classification = len > 4 && strcmp(text_filename + len - 4, ".cpn") == 0;
+    std::vector<int> values;
+    if (!readTextFile(text_filename, values)) {
+      fprintf(stderr, "[ERROR] Cannot open file %s\n", text_filename);
+      return false;
+    }
+    if (classification)
+      values = classificationOwners(values);
+    FILE* file = fopen(binary_filename, "wb");
+    if (!file) {
+      fprintf(stderr, "[ERROR] Cannot open file %s\n", binary_filename);
+      return false;
+    }
+    const int header[2] = {classification ? CLASSIFICATION : PARTITION, (int)values.size()};
+    const bool written = fwrite(binary_magic, 1, 8, file) == 8 &&
+      fwrite(header, sizeof(int), 2, file) == 2 &&
+      fwrite(values.data(), sizeof(int), values.size(), file) == values.size();
+    fclose(file);
+    if (!written)
+      fprintf(stderr, "[ERROR] Failed writing %s\n", binary_filename);
+    return written;
+  }
+
   Input::Method Input::getMethod(std::string s) {
     const char* cs = s.c_str();
     if( !strcasecmp(cs,"FULL") )
@@ -136,6 +306,24 @@ namespace pumipic {
       return Input::INVALID;
   }
 
+  std::uint64_t Input::cacheKey() const {
+    const int settings[9] = {comm->size(), comm->rank() * (ownership_rule == DISTRIBUTED),
+                             ownership_rule, bufferMethod, safeMethod, bridge_dim,
+                             bufferBFSLayers, safeBFSLayers, reorder_elements};
+    std::uint64_t hash = hashBytes(14695981039346656037ULL, settings, sizeof(settings));
+    Omega_h::Mesh& mesh = m;
+    for (int i = 0; i <= mesh.dim(); ++i) {
+      const Omega_h::LO nents = mesh.nents(i);
+      hash = hashBytes(hash, &nents, sizeof(nents));
+      hash = hashArray(hash, mesh.get_array<Omega_h::ClassId>(i, "class_id"));
+    }
+    hash = hashArray(hash, mesh.coords());
+    hash = hashArray(hash, mesh.ask_elem_verts());
+    if (ownership_rule != DISTRIBUTED)
+      hash = hashArray(hash, partition);
+    return hash;
+  }
+
   void Input::printInfo() {
     std::string bname = getMethodString(bufferMethod);
     std::string sname = getMethodString(safeMethod);
@@ -1,5 +1,7 @@
 #pragma once
 #include <Omega_h_mesh.hpp>
+#include <cstdint>
+#include <string>
 
 namespace pumipic {
 
@@ -20,7 +22,8 @@ namespace pumipic {
     //Defines the type of info given in partition_vector
     enum Ownership {
       PARTITION, //partition vector holds ownership for each entitiy
-      CLASSIFICATION //partition vector holds ownership for each classification id
+      CLASSIFICATION, //partition vector holds ownership for each classification id
+      DISTRIBUTED //the mesh is already partitioned, each process owns its elements
     };
 
     Input(Omega_h::Mesh& mesh, char* partition_filename,
@@ -31,8 +34,20 @@ namespace pumipic {
           Method bufferMethod, Method safeMethod,
           Omega_h::CommPtr comm = nullptr);
 
+    /* Picparts of a mesh that is already distributed (i.e. read in parallel)
+         Each process only gathers the parts it buffers, the full mesh is never loaded.
+         bufferMethod can not be FULL. comm defaults to the mesh's communicator.
+    */
+    Input(Omega_h::Mesh& partitioned_mesh, Method bufferMethod, Method safeMethod,
+          Omega_h::CommPtr comm = nullptr);
+
     void printInfo();
     static Method getMethod(std::string s);
+    /* Converts a text partition (.ptn, or .cpn for classification) to the binary .bpn format
+         Binary partitions are read with one read by rank 0 and broadcast, like the text ones
+         Returns false if a file can not be read or written
+    */
+    static bool convertPartition(const char* text_filename, const char* binary_filename);
 
     //Bridge dim for BFS (defaults to 0)
     int bridge_dim;
@@ -40,6 +55,21 @@ namespace pumipic {
     int bufferBFSLayers;
     //For Method = BFS, # of layers of BFS to go out for safe zone (defaults to 1)
     int safeBFSLayers;
+    /* Number the picpart elements along a Morton curve of their centroids (defaults to false)
+         Neighboring elements are then close in memory. Ignored when the full mesh is
+         buffered since the picpart is the given mesh.
+    */
+    bool reorder_elements;
+    //Share the picpart arrays that are identical on the processes of a node (see
+    //  Mesh::shareNodeArrays, host only) (defaults to false)
+    bool share_node_buffers;
+    /* Existing directory of the picpart cache (defaults to empty, no caching)
+         Mesh(Input&) loads the picparts cached for cacheKey() if present, otherwise it
+         constructs and caches them
+    */
+    std::string cache_directory;
+    //Hash of the mesh, partition, number of processes and settings of this input
+    std::uint64_t cacheKey() const;
 
     friend class Mesh;
   private:
@@ -1,12 +1,194 @@
 #include "pumipic_mesh.hpp"
+#include <Omega_h_tag.hpp>
+#include <Omega_h_sort.hpp>
+#include <Omega_h_map.hpp>
+#include <Kokkos_Core.hpp>
+#include <mpi.h>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+  /* Copies array into a window shared by the processes of group
+       Returns array if it is not the same on every process of group, the processes of a
+       group built their picparts independently
+  */
+  template <typename T>
+  Omega_h::Read<T> shareArray(MPI_Comm group, Omega_h::Read<T> array,
+                              std::vector<pumipic::NodeSharedWindow*>& windows) {
+    typedef Kokkos::View<T*, Kokkos::MemoryTraits<Kokkos::Unmanaged> > UnmanagedView;
+    if (!array.exists())
+      return array;
+    const Omega_h::LO size = array.size();
+    int sizes[2] = {size, -size};
+    MPI_Allreduce(MPI_IN_PLACE, sizes, 2, MPI_INT, MPI_MIN, group);
+    if (sizes[0] != -sizes[1])
+      return array;
+    pumipic::NodeSharedWindow* window = new pumipic::NodeSharedWindow(group, size * sizeof(T));
+    UnmanagedView shared(static_cast<T*>(window->data()), size);
+    if (window->isOwner())
+      Kokkos::deep_copy(shared, UnmanagedView(const_cast<T*>(array.data()), size));
+    Kokkos::fence();
+    MPI_Barrier(group);
+    int same = window->isOwner() || !size ||
+      !std::memcmp(window->data(), array.data(), size * sizeof(T));
+    MPI_Allreduce(MPI_IN_PLACE, &same, 1, MPI_INT, MPI_MIN, group);
+    if (!same) {
+      delete window;
+      return array;
+    }
+    windows.push_back(window);
+    return Omega_h::Write<T>(Kokkos::View<T*>(shared));
+  }
+
+  //FNV-1a hash of the global ids of the entities of every dimension
+  std::uint64_t hashGlobalIds(pumipic::Mesh& mesh) {
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i <= mesh.dim(); ++i) {
+      Omega_h::HostRead<Omega_h::GO> gids(mesh.globalIds(i));
+      const unsigned char* bytes = reinterpret_cast<const unsigned char*>(gids.data());
+      const std::size_t num_bytes = gids.size() * sizeof(Omega_h::GO);
+      for (std::size_t j = 0; j < num_bytes; ++j) {
+        hash ^= bytes[j];
+        hash *= 1099511628211ULL;
+      }
+    }
+    return hash;
+  }
+
+  template <typename T>
+  std::size_t arrayBytes(const Omega_h::Read<T>& array) {
+    return array.exists() ? array.size() * sizeof(T) : 0;
+  }
+  std::size_t typeBytes(Omega_h_Type type) {
+    switch (type) {
+      case OMEGA_H_I8: return 1;
+      case OMEGA_H_I32: return 4;
+      default: return 8;
+    }
+  }
+}
 
 namespace pumipic {
   Mesh::~Mesh() {
+    for (auto itr = comm_plans.begin(); itr != comm_plans.end(); ++itr)
+      for (std::size_t i = 0; i < itr->second.size(); ++i)
+        delete itr->second[i];
     if (!isFullMesh())
       delete picpart;
+    for (std::size_t i = 0; i < node_windows.size(); ++i)
+      delete node_windows[i];
+  }
+
+  void Mesh::shareNodeArrays() {
+#ifdef PS_USE_CUDA
+    if (!commptr->rank())
+      fprintf(stderr, "[WARNING] Node shared arrays require host accessible memory\n");
+    return;
+#else
+    if (!node_windows.empty())
+      return;
+    MPI_Comm node_comm;
+    MPI_Comm_split_type(commptr->get_impl(), MPI_COMM_TYPE_SHARED, commptr->rank(),
+                        MPI_INFO_NULL, &node_comm);
+    int node_rank, node_size;
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_size(node_comm, &node_size);
+    //Processes of the node with the same picpart entities share, the first one of each
+    //  holds the memory. Every process of the node has the same picpart with the full mesh.
+    int color = 0;
+    if (!isFullMesh()) {
+      const std::uint64_t hash = hashGlobalIds(*this);
+      std::vector<std::uint64_t> hashes(node_size);
+      MPI_Allgather(&hash, 1, MPI_UINT64_T, hashes.data(), 1, MPI_UINT64_T, node_comm);
+      while (hashes[color] != hash)
+        ++color;
+    }
+    MPI_Comm group;
+    MPI_Comm_split(node_comm, color, node_rank, &group);
+    MPI_Comm_free(&node_comm);
+    buildComm();
+    for (int i = 0; i <= dim(); ++i) {
+      global_ids_per_dim[i] = shareArray(group, global_ids_per_dim[i], node_windows);
+      ent_owner_per_dim[i] = shareArray(group, ent_owner_per_dim[i], node_windows);
+      offset_ents_per_rank_per_dim[i] = shareArray(group, offset_ents_per_rank_per_dim[i],
+                                                   node_windows);
+      ent_to_comm_arr_index_per_dim[i] = shareArray(group, ent_to_comm_arr_index_per_dim[i],
+                                                    node_windows);
+      if (picpart->has_tag(i, "class_id"))
+        picpart->set_tag(i, "class_id",
+                         shareArray(group, picpart->get_array<Omega_h::ClassId>(i, "class_id"),
+                                    node_windows));
+      if (picpart->has_tag(i, "class_dim"))
+        picpart->set_tag(i, "class_dim",
+                         shareArray(group, picpart->get_array<Omega_h::I8>(i, "class_dim"),
+                                    node_windows));
+    }
+    picpart->set_coords(shareArray(group, picpart->coords(), node_windows));
+    MPI_Comm_free(&group);
+#endif
+  }
+
+  GlobalIdIndex::GlobalIdIndex(Omega_h::GOs gids) {
+    sorted_lids = Omega_h::sort_by_keys(gids);
+    sorted_gids = Omega_h::unmap(sorted_lids, gids, 1);
+  }
+
+  GlobalIdIndex Mesh::globalIdIndex(int edim) {
+    if (!gid_index[edim].exists())
+      gid_index[edim] = GlobalIdIndex(global_ids_per_dim[edim]);
+    return gid_index[edim];
   }
 
   bool Mesh::isFullMesh() const {
     return is_full_mesh;
   }
+
+  std::map<std::string, std::size_t> Mesh::memoryUsage() const {
+    std::map<std::string, std::size_t> usage;
+    const int d = dim();
+    std::size_t& tags = usage["picpart_tags"];
+    for (int i = 0; i <= d; ++i)
+      for (int j = 0; j < picpart->ntags(i); ++j) {
+        const Omega_h::TagBase* tag = picpart->get_tag(i, j);
+        tags += picpart->nents(i) * tag->ncomps() * typeBytes(tag->type());
+      }
+    usage["safe_tag"] = arrayBytes(is_ent_safe);
+    usage["buffer_distance"] = arrayBytes(buffer_distance);
+    std::size_t& gids = usage["global_ids"];
+    std::size_t& gid_lookup = usage["global_id_index"];
+    std::size_t& rlids = usage["rank_lids"];
+    std::size_t& owners = usage["owners"];
+    std::size_t& offsets = usage["nents_offsets"];
+    std::size_t& index = usage["comm_array_index"];
+    std::size_t& bounded = usage["bounded_ent_ids"];
+    std::size_t& deferred = usage["deferred_comm_setup"];
+    std::size_t& host = usage["part_lists_host"];
+    for (int i = 0; i <= d; ++i) {
+      gids += arrayBytes(global_ids_per_dim[i]);
+      gid_lookup += arrayBytes(gid_index[i].sortedIds()) +
+        arrayBytes(gid_index[i].sortedLids());
+      rlids += arrayBytes(rank_lids_per_dim[i]);
+      owners += arrayBytes(ent_owner_per_dim[i]);
+      offsets += arrayBytes(offset_ents_per_rank_per_dim[i]);
+      index += arrayBytes(ent_to_comm_arr_index_per_dim[i]);
+      bounded += arrayBytes(bounded_ent_ids[i]);
+      deferred += arrayBytes(comm_global_ents_per_rank[i]) +
+        arrayBytes(comm_picpart_ents_per_rank[i]);
+      if (comm_built[i]) {
+        host += (buffered_parts[i].size() + is_complete_part[i].size()) * sizeof(Omega_h::LO);
+        if (i < d)
+          host += (boundary_parts[i].size() + offset_bounded_per_dim[i].size()) *
+            sizeof(Omega_h::LO);
+      }
+    }
+    //The node shared arrays are counted above on every process of the node
+    std::size_t& shared = usage["node_shared_windows"];
+    for (std::size_t i = 0; i < node_windows.size(); ++i)
+      shared += node_windows[i]->allocated();
+    std::size_t& plans = usage["comm_plans"];
+    for (auto itr = comm_plans.begin(); itr != comm_plans.end(); ++itr)
+      for (std::size_t i = 0; i < itr->second.size(); ++i)
+        plans += itr->second[i]->bytes();
+    return usage;
+  }
 }
@@ -2,6 +2,15 @@
 #include <Omega_h_mesh.hpp>
 #include "pumipic_library.hpp"
 #include "pumipic_input.hpp"
+#include "pumipic_comm_plan.hpp"
+#include "pumipic_node_shared.hpp"
+#include "pumipic_gid_index.hpp"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+#include <typeindex>
+#include <vector>
 
 namespace pumipic {
   class Mesh {
@@ -36,24 +45,89 @@ namespace pumipic {
     //Returns the commptr
     Omega_h::CommPtr comm() const {return commptr;}
 
-    //Returns the number of parts buffered
-    int numBuffers(int dim) const {return num_cores[dim] + 1;}
-    //Returns a host array of the ranks buffered
-    Omega_h::HostWrite<Omega_h::LO> bufferedRanks(int dim) const {return buffered_parts[dim];}
+    /* Communication information of a dimension is built when it is first needed
+         The accessors marked (comm) and the comm array functions build it, which communicates
+         with the other processes. Call them on every process like any other collective.
+    */
+    //Builds the communication information of every dimension not built yet with the
+    //  exchanges of all of them in flight together (collective)
+    //  Faster than the dimensions being built one at a time by their first use
+    void buildComm();
+    //Returns the number of parts buffered (comm)
+    int numBuffers(int dim) {buildComm(dim); return num_cores[dim] + 1;}
+    //Returns a host array of the ranks buffered (comm)
+    Omega_h::HostWrite<Omega_h::LO> bufferedRanks(int dim) {
+      buildComm(dim);
+      return buffered_parts[dim];
+    }
 
 
     //Picpart global ID array over entities sized nents
     Omega_h::GOs globalIds(int dim) {return global_ids_per_dim[dim];}
     //Safe tag over elements sized nelems (1 - safe, 0 - unsafe)
     Omega_h::LOs safeTag() {return is_ent_safe;}
-    //Offset array for number of entities per rank sized comm_size
-    Omega_h::LOs nentsOffsets(int dim) {return offset_ents_per_rank_per_dim[dim];}
-    //Mapping from local id to comm array index sized nents
-    Omega_h::LOs commArrayIndex(int dim) {return ent_to_comm_arr_index_per_dim[dim];}
+    /* Element layers (bridged by vertices) between each element and the edge of the buffer
+         0 - the element touches a full mesh element that is not in the picpart
+        -1 - the buffer has no edge (i.e. the full mesh is buffered)
+       A particle that moves at most one element layer per step can take d steps from an
+         element at distance d before it can leave the picpart
+    */
+    Omega_h::LOs bufferDistance() {return buffer_distance;}
+    //Offset array for number of entities per rank sized comm_size (comm)
+    Omega_h::LOs nentsOffsets(int dim) {
+      buildComm(dim);
+      return offset_ents_per_rank_per_dim[dim];
+    }
+    //Mapping from local id to comm array index sized nents (comm)
+    Omega_h::LOs commArrayIndex(int dim) {
+      buildComm(dim);
+      return ent_to_comm_arr_index_per_dim[dim];
+    }
+    //Lookup from global id to local id of the picpart entities, built on first use
+    //  Shared by copy with particle structures and comm routines instead of each building
+    //  its own map
+    GlobalIdIndex globalIdIndex(int dim);
     //Array of owners of an entity sized nents
     Omega_h::LOs entOwners(int dim) {return ent_owner_per_dim[dim];}
-    //The local index of an entity in its own core region sized nents
-    Omega_h::LOs rankLocalIndex(int dim) {return ent_local_rank_id_per_dim[dim];}
+    //The local index of an entity in its own core region sized nents (comm)
+    //  Note: This is derived from the comm array index on every call
+    Omega_h::LOs rankLocalIndex(int dim);
+
+    /* Replaces the global ids, owners, nents offsets, comm array indices, coordinates and
+       classification of the picpart with one read-only copy per node in MPI-3 shared
+       memory windows
+         The processes of a node with the same picpart entities (every process when the
+         full mesh is buffered) share one copy, an array that differs between them stays
+         private as does the safe tag. Builds the communication of every dimension, so it
+         is collective.
+       Note: The connectivity (i.e. the element to vertex array) stays per process, omega_h
+             holds the adjacencies of a built mesh privately
+       Note: Host only, the windows are host memory that GPU builds can not hand to omega_h,
+             so CUDA builds keep every array per process
+    */
+    void shareNodeArrays();
+
+    //Bytes held by each structure of the picparts (on the device unless the name says host)
+    std::map<std::string, std::size_t> memoryUsage() const;
+
+    /* Repartitioning of the core regions to balance particles
+       balancedPartition - new owner of each element of full_mesh
+         The full mesh elements ordered along a Morton curve of their centroids are split in
+         comm size contiguous pieces of about equal weight (elem_weight per element plus 1 per
+         particle).
+         elem_particles - particles in each picpart element on this process, the counts of
+                          every process holding a copy of an element are summed
+       fullMeshElementIds - element of full_mesh of each picpart element sized nelems
+         Unlike the global ids, these do not change when the picparts are rebuilt
+       Rebalancing constructs new picparts from the new owners and moves the particles with
+         SellCSigma::repartition using the full mesh element ids of the old and new picparts.
+       Note: full_mesh must be the mesh the picparts were constructed from, picparts built from
+             a distributed mesh or read from a cache of buffered parts are not supported.
+             balancedPartition is collective.
+    */
+    Omega_h::LOs balancedPartition(Omega_h::Mesh& full_mesh, Omega_h::LOs elem_particles,
+                                   Omega_h::LO elem_weight = 1);
+    Omega_h::LOs fullMeshElementIds(Omega_h::Mesh& full_mesh);
 
     //Creates an array of size num_entreis_per_entity * nents for communication
     template <class T>
@@ -65,9 +139,72 @@ namespace pumipic {
       MIN_OP, //Take min of all contributions
       BCAST_OP //Take the owner's value
     };
+    //Reduction used by full mesh picparts
+    enum FullReduceMode {
+      ALLREDUCE_FULL_REDUCE, //MPI_Allreduce of the whole array
+      SCATTER_FULL_REDUCE, //MPI_Reduce_scatter to the owners then MPI_Allgatherv
+      AUTO_FULL_REDUCE //Scatter for arrays of at least threshold_bytes (default 1MB)
+    };
+    void setFullReduceMode(FullReduceMode mode, std::size_t threshold_bytes = 1 << 20) {
+      full_reduce_mode = mode;
+      full_reduce_threshold = threshold_bytes;
+    }
     //Performs an MPI reduction on a communication array across all picparts
     template <class T>
     void reduceCommArray(int dim, Op op, Omega_h::Write<T> array);
+    //Performs the reductions of several communication arrays of one type together with one
+    //  message per neighbor, ops[i] is applied to arrays[i]
+    template <class T>
+    void reduceCommArrays(int dim, const std::vector<Op>& ops,
+                          const std::vector<Omega_h::Write<T> >& arrays);
+
+    /* Two phase reductions to overlap communication with other work
+       reduceCommArray(s)_begin - packs the arrays and starts the fan in (arguments are the
+                                  same as reduceCommArray(s))
+       reduceCommArray_end - reduces the received values, performs the fan out and unpacks
+       reduceCommArray(s) is _begin immediately followed by _end
+       Notes:
+         The arrays must not be read or written between the two calls
+         Like any collective, _begin and _end must be called in the same order on every
+           process when several reductions are in flight
+    */
+    template <class T>
+    ReduceHandle<T> reduceCommArray_begin(int dim, Op op, Omega_h::Write<T> array);
+    template <class T>
+    ReduceHandle<T> reduceCommArrays_begin(int dim, const std::vector<Op>& ops,
+                                           const std::vector<Omega_h::Write<T> >& arrays);
+    template <class T>
+    void reduceCommArray_end(ReduceHandle<T>& handle);
+
+    /* Gather and scatter between entity arrays and comm arrays
+       toCommArray - comm array of the arrays (each sized width * nents) with the entries of
+                     every entity in the order of the arrays
+       fromCommArray - arrays of widths[i] entries per entity taken back out of a comm array
+       reduceTags - reduces the tags of dim (T must be the type of the tags) together
+         With reduced_tag, the result is set as one tag with the entries of all the tags
+           without another copy (i.e. the fwd and bkwd tags of gyroSync into a 2 entry tag)
+         Otherwise each tag is replaced by its reduced values
+    */
+    template <class T>
+    Omega_h::Write<T> toCommArray(int dim, const std::vector<Omega_h::Read<T> >& arrays);
+    template <class T>
+    std::vector<Omega_h::Write<T> > fromCommArray(int dim, Omega_h::Read<T> array,
+                                                  const std::vector<int>& widths);
+    template <class T>
+    void reduceTags(int dim, Op op, const std::vector<std::string>& tag_names,
+                    const std::string& reduced_tag);
+    template <class T>
+    void reduceTags(int dim, Op op, const std::vector<std::string>& tag_names);
+
+    /* Picpart cache for restarts (see Input::cache_directory)
+         writeCache - writes this process's picpart to <prefix>.ppc (and <prefix>.osh)
+         readCache - collectively loads the picparts written by writeCache, returns false on
+                     every process if any of them has no cache for key
+    */
+    static std::string cachePrefix(const std::string& directory, std::uint64_t key, int rank);
+    bool writeCache(const std::string& prefix, std::uint64_t key);
+    bool readCache(Omega_h::Mesh& full_mesh, Omega_h::CommPtr comm, const std::string& prefix,
+                   std::uint64_t key);
 
     //Users should not run the following functions.
     //They are meant to be private, but must be public for enclosing lambdas
@@ -75,12 +212,42 @@ namespace pumipic {
     void constructPICPart(Omega_h::Mesh& mesh, Omega_h::CommPtr comm,
                           Omega_h::LOs owner,
                           Omega_h::Write<Omega_h::LO> has_part,
-                          Omega_h::Write<Omega_h::LO> is_safe);
+                          Omega_h::Write<Omega_h::LO> is_safe,
+                          bool reorder_elements = false);
+    void constructDistributedPICPart(Input& in);
+    //Breadth first search of bufferDistance from the exposed interior sides of the picpart
+    void computeBufferDistance();
 
     //Communication setup
     void setupComm(int dim, Omega_h::LOs global_ents_per_rank,
                    Omega_h::LOs picpart_ents_per_rank,
                    Omega_h::LOs ent_owners);
+    /* Phases of setupComm, so the exchanges of several dimensions can be in flight together
+         _begin - computes the comm array indices and starts the alltoall of boundary counts
+         _exchange - waits on the alltoall and starts the sends/recvs of the boundary ids
+         _end - waits on the boundary ids and stores them
+    */
+    struct CommSetup;
+    void setupComm_begin(int dim, Omega_h::LOs global_ents_per_rank,
+                         Omega_h::LOs picpart_ents_per_rank,
+                         Omega_h::LOs ent_owners, CommSetup& setup);
+    void setupComm_exchange(CommSetup& setup);
+    void setupComm_end(CommSetup& setup);
+    //Keeps the arguments of setupComm until buildComm(dim) needs them
+    void deferComm(int dim, Omega_h::LOs global_ents_per_rank,
+                   Omega_h::LOs picpart_ents_per_rank);
+    //Runs the deferred setupComm of dim once, then releases the arrays only setup uses
+    void buildComm(int dim);
+    //Marks dim as built and releases the deferred setup arrays
+    void releaseCommSetup(int dim);
+    //Start and finish the MPI collective reduction of a full mesh array
+    template <class T>
+    void startFullReduction(int dim, Op op, FullReduction<T>& full);
+    template <class T>
+    void finishFullReduction(int dim, FullReduction<T>& full);
+    //Returns a persistent plan of reduceCommArray that is not in use, built on first use
+    template <class T>
+    CommPlan<T>& commPlan(int dim, int num_entries_per_entity);
 
   private:
     Omega_h::CommPtr commptr;
@@ -93,10 +260,14 @@ namespace pumipic {
     int num_cores[4];
     //Global ID of each mesh entity per dimension
     Omega_h::GOs global_ids_per_dim[4];
-    //Global ID of each mesh entity per dimension
+    //Index of each mesh entity in its owner's core per dimension (released after setup)
     Omega_h::LOs rank_lids_per_dim[4];
     //Safe tag defined on the mesh elements
     Omega_h::LOs is_ent_safe;
+    //Element layers to the edge of the buffer
+    Omega_h::LOs buffer_distance;
+    //Sorted global ids of each dimension (built by globalIdIndex)
+    GlobalIdIndex gid_index[4];
 
     //Per Dimension communication information
     //List of core parts that are buffered (doesn't include self)
@@ -108,9 +279,10 @@ namespace pumipic {
     Omega_h::LOs ent_to_comm_arr_index_per_dim[4];
     //The owning part of each entity per dimension
     Omega_h::LOs ent_owner_per_dim[4];
-    //Mapping from entity id to local index of the core it belongs to
-    //  Note: This is stored in case needed, but is not used beyond setup.
-    Omega_h::LOs ent_local_rank_id_per_dim[4];
+    //Deferred arguments of setupComm, released once the dimension is built
+    bool comm_built[4];
+    Omega_h::LOs comm_global_ents_per_rank[4];
+    Omega_h::LOs comm_picpart_ents_per_rank[4];
     /*Flag for each buffered part. True if the entire part is buffered
      * 2 = complete
      * 1 = partial
@@ -128,5 +300,13 @@ namespace pumipic {
     Omega_h::HostWrite<Omega_h::LO> offset_bounded_per_dim[4];
     //The entities to send to each part for boundary
     Omega_h::LOs bounded_ent_ids[4];
+
+    FullReduceMode full_reduce_mode;
+    std::size_t full_reduce_threshold;
+    //Persistent plans of reduceCommArray keyed by (dim, entries per entity, type)
+    //  More than one plan of a key exists if reductions of it were in flight together
+    std::map<std::tuple<int, int, std::type_index>, std::vector<CommPlanBase*> > comm_plans;
+    //Shared memory backing the arrays of shareNodeArrays
+    std::vector<NodeSharedWindow*> node_windows;
   };
 }
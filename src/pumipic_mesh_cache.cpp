@@ -0,0 +1,172 @@
+#include "pumipic_mesh.hpp"
+#include <Omega_h_file.hpp>
+#include <mpi.h>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+  //Leading bytes and version of a picpart cache file
+  const char cache_magic[8] = {'P', 'U', 'M', 'I', 'P', 'P', 'C', '\0'};
+  const int cache_version = 2;
+
+  template <typename T>
+  bool writeValues(FILE* file, const T* values, int size) {
+    return fwrite(&size, sizeof(int), 1, file) == 1 &&
+      (size == 0 || fwrite(values, sizeof(T), size, file) == (std::size_t)size);
+  }
+  template <typename T>
+  bool writeArray(FILE* file, Omega_h::Read<T> array) {
+    Omega_h::HostRead<T> array_h(array);
+    return writeValues(file, array_h.data(), array_h.size());
+  }
+  template <typename T>
+  bool writeHostArray(FILE* file, const Omega_h::HostWrite<T>& array) {
+    return writeValues(file, array.data(), array.size());
+  }
+
+  template <typename T>
+  bool readHostArray(FILE* file, Omega_h::HostWrite<T>& array) {
+    int size;
+    if (fread(&size, sizeof(int), 1, file) != 1 || size < 0)
+      return false;
+    array = Omega_h::HostWrite<T>(size, "cached_array");
+    return size == 0 || fread(array.data(), sizeof(T), size, file) == (std::size_t)size;
+  }
+  template <typename T>
+  bool readArray(FILE* file, Omega_h::Read<T>& array) {
+    Omega_h::HostWrite<T> array_h;
+    if (!readHostArray(file, array_h))
+      return false;
+    array = Omega_h::Read<T>(array_h.write());
+    return true;
+  }
+}
+
+namespace pumipic {
+  std::string Mesh::cachePrefix(const std::string& directory, std::uint64_t key, int rank) {
+    std::stringstream ss;
+    ss << directory << "/picpart_" << std::hex << key << std::dec << "_" << rank;
+    return ss.str();
+  }
+
+  /* Picpart cache layout (native byte order)
+       8 bytes - cache_magic
+       int32 - cache_version
+       uint64 - key
+       int32 x 4 - comm size, rank, is_full_mesh, dim
+       the safe tag, then for each dimension the PICpart information and communication
+       information of pumipic_mesh.hpp that remains after setup (arrays as int32 size followed by the values)
+     The omega_h picpart is written beside it to <prefix>.osh unless the full mesh is buffered
+  */
+  bool Mesh::writeCache(const std::string& prefix, std::uint64_t key) {
+    const int d = dim();
+    //The cache holds the communication information of every dimension
+    buildComm();
+    if (!isFullMesh())
+      Omega_h::binary::write(prefix + ".osh", picpart);
+    FILE* file = fopen((prefix + ".ppc").c_str(), "wb");
+    if (!file) {
+      fprintf(stderr, "[WARNING] Cannot write picpart cache %s.ppc\n", prefix.c_str());
+      return false;
+    }
+    const int header[4] = {commptr->size(), commptr->rank(), is_full_mesh, d};
+    bool success = fwrite(cache_magic, 1, 8, file) == 8 &&
+      fwrite(&cache_version, sizeof(int), 1, file) == 1 &&
+      fwrite(&key, sizeof(key), 1, file) == 1 &&
+      fwrite(header, sizeof(int), 4, file) == 4 &&
+      writeArray(file, is_ent_safe);
+    for (int i = 0; i <= d && success; ++i) {
+      const int counts[3] = {num_cores[i], num_bounds[i], num_boundaries[i]};
+      success = fwrite(counts, sizeof(int), 3, file) == 3 &&
+        writeArray(file, global_ids_per_dim[i]) &&
+        writeHostArray(file, buffered_parts[i]) &&
+        writeArray(file, offset_ents_per_rank_per_dim[i]) &&
+        writeArray(file, ent_to_comm_arr_index_per_dim[i]) &&
+        writeArray(file, ent_owner_per_dim[i]) &&
+        writeValues(file, is_complete_part[i].data(), is_complete_part[i].size());
+      //Boundary part information only exists below the element dimension
+      if (success && i < d)
+        success = writeHostArray(file, boundary_parts[i]) &&
+          writeHostArray(file, offset_bounded_per_dim[i]) &&
+          writeArray(file, bounded_ent_ids[i]);
+    }
+    fclose(file);
+    if (!success)
+      fprintf(stderr, "[WARNING] Failed writing picpart cache %s.ppc\n", prefix.c_str());
+    return success;
+  }
+
+  bool Mesh::readCache(Omega_h::Mesh& full_mesh, Omega_h::CommPtr comm,
+                       const std::string& prefix, std::uint64_t key) {
+    commptr = comm;
+    full_reduce_mode = AUTO_FULL_REDUCE;
+    full_reduce_threshold = 1 << 20;
+    int header[4] = {-1, -1, 0, 0};
+    FILE* file = fopen((prefix + ".ppc").c_str(), "rb");
+    bool success = file != NULL;
+    if (success) {
+      char magic[8];
+      int version;
+      std::uint64_t file_key;
+      success = fread(magic, 1, 8, file) == 8 && memcmp(magic, cache_magic, 8) == 0 &&
+        fread(&version, sizeof(int), 1, file) == 1 && version == cache_version &&
+        fread(&file_key, sizeof(file_key), 1, file) == 1 && file_key == key &&
+        fread(header, sizeof(int), 4, file) == 4 && header[0] == comm->size() &&
+        header[1] == comm->rank() && header[3] == full_mesh.dim();
+    }
+    //Every process must load its cache, otherwise all of them construct the picparts
+    int all_success = success;
+    MPI_Allreduce(MPI_IN_PLACE, &all_success, 1, MPI_INT, MPI_MIN, comm->get_impl());
+    if (!all_success) {
+      if (file)
+        fclose(file);
+      return false;
+    }
+
+    is_full_mesh = header[2];
+    const int d = header[3];
+    success = readArray(file, is_ent_safe);
+    for (int i = 0; i <= d && success; ++i) {
+      int counts[3];
+      Omega_h::HostWrite<Omega_h::LO> is_complete;
+      success = fread(counts, sizeof(int), 3, file) == 3 &&
+        readArray(file, global_ids_per_dim[i]) &&
+        readHostArray(file, buffered_parts[i]) &&
+        readArray(file, offset_ents_per_rank_per_dim[i]) &&
+        readArray(file, ent_to_comm_arr_index_per_dim[i]) &&
+        readArray(file, ent_owner_per_dim[i]) &&
+        readHostArray(file, is_complete);
+      if (!success)
+        break;
+      comm_built[i] = true;
+      num_cores[i] = counts[0];
+      num_bounds[i] = counts[1];
+      num_boundaries[i] = counts[2];
+      is_complete_part[i] = Omega_h::HostRead<Omega_h::LO>(is_complete.write());
+      if (i < d)
+        success = readHostArray(file, boundary_parts[i]) &&
+          readHostArray(file, offset_bounded_per_dim[i]) &&
+          readArray(file, bounded_ent_ids[i]);
+    }
+    fclose(file);
+    //A cache that passed the header check but is truncated can not be recovered from
+    if (!success) {
+      fprintf(stderr, "[ERROR] Corrupt picpart cache %s.ppc\n", prefix.c_str());
+      throw std::runtime_error("Corrupt picpart cache");
+    }
+
+    if (isFullMesh()) {
+      picpart = &full_mesh;
+      for (int i = 0; i <= d; ++i)
+        full_mesh.add_tag(i, "ownership", 1, ent_owner_per_dim[i]);
+    }
+    else {
+      picpart = new Omega_h::Mesh(full_mesh.library());
+      Omega_h::binary::read(prefix + ".osh", full_mesh.library()->self(), picpart);
+    }
+    computeBufferDistance();
+    return true;
+  }
+}
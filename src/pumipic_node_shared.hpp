@@ -0,0 +1,50 @@
+#pragma once
+#include <mpi.h>
+#include <cstddef>
+
+namespace pumipic {
+
+  /* Host memory shared by the processes of a node through an MPI-3 shared memory window
+
+     The first process of node_comm allocates the memory, the others map the same memory.
+     The owner of the memory must fill it and synchronize (i.e. MPI_Barrier on node_comm)
+     before the other processes read it.
+
+     Note: The window is freed on destruction unless MPI is already finalized
+  */
+  class NodeSharedWindow {
+  public:
+    NodeSharedWindow(MPI_Comm node_comm, std::size_t bytes) : base(NULL), size(bytes) {
+      int node_rank;
+      MPI_Comm_rank(node_comm, &node_rank);
+      const MPI_Aint local_bytes = node_rank ? 0 : bytes;
+      MPI_Win_allocate_shared(local_bytes, 1, MPI_INFO_NULL, node_comm, &base, &window);
+      if (node_rank) {
+        MPI_Aint shared_bytes;
+        int disp_unit;
+        MPI_Win_shared_query(window, 0, &shared_bytes, &disp_unit, &base);
+      }
+      owner = !node_rank;
+    }
+    NodeSharedWindow(const NodeSharedWindow&) = delete;
+    NodeSharedWindow& operator=(const NodeSharedWindow&) = delete;
+    ~NodeSharedWindow() {
+      int finalized;
+      MPI_Finalized(&finalized);
+      if (!finalized)
+        MPI_Win_free(&window);
+    }
+
+    void* data() const {return base;}
+    //True on the process holding the memory
+    bool isOwner() const {return owner;}
+    //Bytes of the shared memory allocated by this process
+    std::size_t allocated() const {return owner ? size : 0;}
+
+  private:
+    MPI_Win window;
+    void* base;
+    std::size_t size;
+    bool owner;
+  };
+}
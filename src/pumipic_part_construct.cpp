@@ -1,4 +1,5 @@
 #include "pumipic_mesh.hpp"
+#include "pumipic_profiling.hpp"
 #include <Omega_h_for.hpp>
 #include <Omega_h_element.hpp>
 #include <Omega_h_class.hpp>
@@ -6,6 +7,14 @@
 #include <Omega_h_int_scan.hpp>
 #include <Omega_h_scan.hpp>
 #include <Omega_h_file.hpp>
+#include <Omega_h_sort.hpp>
+#include <Omega_h_map.hpp>
+#include <mpi.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <vector>
 namespace {
   void setOwnerByClassification(Omega_h::Mesh& m, Omega_h::LOs class_owners, int self,
                                 Omega_h::Write<Omega_h::LO> owns);
@@ -26,6 +35,14 @@ namespace {
   void buildAndClassify(Omega_h::Mesh& full_mesh, Omega_h::Mesh* picpart, int dim, int num_ents,
                         Omega_h::LOs ent_ids, Omega_h::LOs vert_ids,
                         Omega_h::Write<Omega_h::Real> new_coords);
+  Omega_h::LOs sfcElementOrder(Omega_h::Mesh& mesh, Omega_h::LOs elem_ids,
+                               Omega_h::LO num_elems);
+  void packCoreEnts(Omega_h::Mesh& mesh, int ent_dim, int rank, Omega_h::LOs elem_owner,
+                    Omega_h::LOs owner, Omega_h::LOs rlids,
+                    std::vector<Omega_h::GO>& ents, std::vector<Omega_h::Real>& coords);
+  template <typename T>
+  std::vector<T> exchangeCores(MPI_Comm comm, MPI_Datatype type,
+                               const std::vector<int>& receivers, const std::vector<T>& send);
 }
 
 namespace pumipic {
@@ -63,10 +80,32 @@ namespace pumipic {
   }
 
   Mesh::Mesh(Input& in) {
+    //Phases of the construction are timed under pumipic_picpart_*
+    particle_structs::RegionTimer construct_timer("pumipic_picpart_construct");
     Omega_h::CommPtr comm = in.comm;
     int rank = comm->rank();
     int comm_size = comm->size();
 
+    /*********** Load the cached picparts of a previous run ****************/
+    std::string cache;
+    std::uint64_t key = 0;
+    if (!in.cache_directory.empty()) {
+      key = in.cacheKey();
+      cache = cachePrefix(in.cache_directory, key, rank);
+      particle_structs::RegionTimer read_timer("pumipic_picpart_cache_read");
+      if (readCache(in.m, comm, cache, key)) {
+        if (in.share_node_buffers)
+          shareNodeArrays();
+        return;
+      }
+    }
+    if (in.ownership_rule == Input::DISTRIBUTED) {
+      constructDistributedPICPart(in);
+      if (!cache.empty())
+        writeCache(cache, key);
+      return;
+    }
+
     /*********** Set safe zone and buffer to be entire mesh****************/
     Omega_h::LOs owners = in.partition;
     if (in.ownership_rule == Input::CLASSIFICATION) {
@@ -81,6 +120,7 @@ namespace pumipic {
       Omega_h::Write<Omega_h::LO> safe(in.m.nelems(), 0, "safe");
       Omega_h::Write<Omega_h::LO> part(comm_size, 0, "part");
 
+      particle_structs::RegionTimer buffer_timer("pumipic_picpart_buffer");
       bfsBufferLayers(in.m, in.bridge_dim, comm, in.safeBFSLayers, in.bufferBFSLayers, safe,
                       owners, part);
 
@@ -95,15 +135,27 @@ namespace pumipic {
     else
       is_full_mesh = false;
 
-    constructPICPart(in.m, in.comm, owners, has_part, is_safe);
+    {
+      particle_structs::RegionTimer build_timer("pumipic_picpart_build");
+      constructPICPart(in.m, in.comm, owners, has_part, is_safe, in.reorder_elements);
+    }
+    if (!cache.empty()) {
+      particle_structs::RegionTimer write_timer("pumipic_picpart_cache_write");
+      writeCache(cache, key);
+    }
+    if (in.share_node_buffers)
+      shareNodeArrays();
   }
 
   void Mesh::constructPICPart(Omega_h::Mesh& mesh, Omega_h::CommPtr comm,
                               Omega_h::LOs owner, Omega_h::Write<Omega_h::LO> has_part,
-                              Omega_h::Write<Omega_h::LO> is_safe) {
+                              Omega_h::Write<Omega_h::LO> is_safe,
+                              bool reorder_elements) {
     int rank = comm->rank();
     int comm_size = comm->size();
     int dim = mesh.dim();
+    full_reduce_mode = AUTO_FULL_REDUCE;
+    full_reduce_threshold = 1 << 20;
 
     /************* Define Ownership of each lower dimension entity ************/
     Omega_h::LOs owner_dim[4];
@@ -159,6 +211,20 @@ namespace pumipic {
       ent_ids[i] = numbering;
     }
 
+    //Renumber the picpart elements along a space filling curve
+    //  Vertices keep the full mesh order the lower dimension numberings depend on
+    if (reorder_elements && !isFullMesh()) {
+      Omega_h::LOs sfc_ids = sfcElementOrder(mesh, ent_ids[dim], num_ents[dim]);
+      Omega_h::LOs elem_ids = ent_ids[dim];
+      Omega_h::Write<Omega_h::LO> numbering(mesh.nelems(), -1);
+      auto reorderElements = OMEGA_H_LAMBDA(Omega_h::LO elm) {
+        if (elem_ids[elm] >= 0)
+          numbering[elm] = sfc_ids[elem_ids[elm]];
+      };
+      Omega_h::parallel_for(mesh.nelems(), reorderElements, "reorderElements");
+      ent_ids[dim] = numbering;
+    }
+
     //If full mesh buffer then we don't need to make new mesh for the picparts
     if (isFullMesh()) {
       //Set picpart to point to the mesh
@@ -172,9 +238,10 @@ namespace pumipic {
         ent_owner_per_dim[i] = owner_dim[i];
         //We dont need to setup communication arrays because an allreduce is used
         Omega_h::LOs picpart_offset_nents = calculateOwnerOffset(owner_dim[i], comm_size);
-        setupComm(i, rank_offset_nents[i], picpart_offset_nents, owner_dim[i]);
+        deferComm(i, rank_offset_nents[i], picpart_offset_nents);
 
       }
+      computeBufferDistance();
       return;
     }
 
@@ -236,8 +303,364 @@ namespace pumipic {
 
       //**************** Build communication information ********************//
       Omega_h::LOs picpart_offset_nents = calculateOwnerOffset(new_ent_owners, comm_size);
-      setupComm(i, rank_offset_nents[i], picpart_offset_nents, new_ent_owners);
+      deferComm(i, rank_offset_nents[i], picpart_offset_nents);
+    }
+    computeBufferDistance();
+  }
+
+  /* Picpart construction from a mesh that is already distributed
+
+     The partitioned mesh is ghosted so each process sees every element within its buffer
+     layers and the full star of each entity bounding its core. From the ghosted mesh each
+     process defines the owners of its core's entities, numbers the entities it owns by their
+     omega_h global id and sends the closure of its core to every process that buffers it.
+     The received cores are assembled into the picpart, so no process holds more than its
+     buffered parts.
+  */
+  void Mesh::constructDistributedPICPart(Input& in) {
+    Omega_h::CommPtr comm = in.comm;
+    MPI_Comm mpi_comm = comm->get_impl();
+    int rank = comm->rank();
+    int comm_size = comm->size();
+    int dim = in.m.dim();
+    full_reduce_mode = AUTO_FULL_REDUCE;
+    full_reduce_threshold = 1 << 20;
+    is_full_mesh = false;
+    commptr = comm;
+
+    /************* Ghost the partitioned mesh ************/
+    const int nlayers = std::max(std::max(in.bufferBFSLayers, in.safeBFSLayers), 1);
+    Omega_h::Mesh ghosted = in.m;
+    ghosted.set_parting(OMEGA_H_GHOSTED, nlayers, false);
+    Omega_h::LOs owner_dim[4];
+    owner_dim[dim] = ghosted.ask_owners(dim).ranks;
+
+    /*********** Determine safe zone and buffered parts ***********/
+    Omega_h::Write<Omega_h::LO> is_safe(ghosted.nelems(), in.safeMethod == Input::FULL,
+                                        "is_safe");
+    Omega_h::Write<Omega_h::LO> has_part(comm_size, 0, "has_part");
+    Omega_h::Write<Omega_h::LO> safe(ghosted.nelems(), 0, "safe");
+    bfsBufferLayers(ghosted, in.bridge_dim, comm, in.safeBFSLayers, in.bufferBFSLayers, safe,
+                    owner_dim[dim], has_part);
+    if (in.safeMethod == Input::BFS || in.safeMethod == Input::MINIMUM)
+      is_safe = safe;
+    num_cores[dim] = sumPositives(has_part.size(), has_part) - 1;
+    for (int i = 0; i < dim; ++i)
+      num_cores[i] = 0;
+
+    //Processes that buffer this process's core
+    Omega_h::HostRead<Omega_h::LO> has_part_h(Omega_h::LOs(has_part));
+    std::vector<int> buffers(comm_size), buffered_by(comm_size);
+    for (int i = 0; i < comm_size; ++i)
+      buffers[i] = has_part_h[i];
+    MPI_Alltoall(buffers.data(), 1, MPI_INT, buffered_by.data(), 1, MPI_INT, mpi_comm);
+
+    /************* Owners and rank local ids of each dimension ************/
+    Omega_h::LOs rank_offset_nents[4];
+    std::vector<Omega_h::GO> recv_ents[4];
+    std::vector<Omega_h::Real> recv_coords;
+    for (int i = 0; i <= dim; ++i) {
+      if (i < dim)
+        owner_dim[i] = defineOwners(ghosted, i, comm, owner_dim[dim]);
+      //Owned entities are numbered in the order of their omega_h global ids
+      Omega_h::HostRead<Omega_h::LO> owner_h(owner_dim[i]);
+      Omega_h::HostRead<Omega_h::GO> gids_h(ghosted.globals(i));
+      std::vector<std::pair<Omega_h::GO, Omega_h::LO> > owned;
+      for (int j = 0; j < owner_h.size(); ++j)
+        if (owner_h[j] == rank)
+          owned.push_back(std::make_pair(gids_h[j], j));
+      std::sort(owned.begin(), owned.end());
+      Omega_h::HostWrite<Omega_h::LO> rlids_h(owner_h.size(), 0, 0, "owned_rlids");
+      for (std::size_t j = 0; j < owned.size(); ++j)
+        rlids_h[owned[j].second] = j;
+      //Non owners contribute 0 to the sum so every copy gets the owner's rank lid
+      Omega_h::LOs owned_rlids(rlids_h.write());
+      Omega_h::LOs rlids = ghosted.sync_array(i, ghosted.reduce_array(i, owned_rlids, 1,
+                                                                      OMEGA_H_SUM), 1);
+
+      int num_owned = owned.size();
+      std::vector<int> owned_counts(comm_size);
+      MPI_Allgather(&num_owned, 1, MPI_INT, owned_counts.data(), 1, MPI_INT, mpi_comm);
+      Omega_h::HostWrite<Omega_h::LO> offsets_h(comm_size + 1, 0, 0, "rank_offset_nents");
+      for (int j = 0; j < comm_size; ++j)
+        offsets_h[j + 1] = offsets_h[j] + owned_counts[j];
+      rank_offset_nents[i] = offsets_h.write();
+
+      /************* Send the closure of the core to the buffering processes ************/
+      std::vector<Omega_h::GO> ents;
+      std::vector<Omega_h::Real> coords;
+      packCoreEnts(ghosted, i, rank, owner_dim[dim], owner_dim[i], rlids, ents, coords);
+      recv_ents[i] = exchangeCores(mpi_comm, MPI_INT64_T, buffered_by, ents);
+      if (i == 0)
+        recv_coords = exchangeCores(mpi_comm, MPI_DOUBLE, buffered_by, coords);
+    }
+
+    //Global ids of the safe elements
+    std::set<Omega_h::GO> safe_elems;
+    {
+      Omega_h::HostRead<Omega_h::LO> safe_h(Omega_h::LOs(is_safe));
+      Omega_h::HostRead<Omega_h::GO> elem_gids_h(ghosted.globals(dim));
+      for (int j = 0; j < safe_h.size(); ++j)
+        if (safe_h[j])
+          safe_elems.insert(elem_gids_h[j]);
+    }
+
+    /************* Assemble the picpart from the received cores ************/
+    //Entities shared by several cores are received once per core, keep the first record
+    std::map<Omega_h::GO, std::size_t> ent_records[4];
+    for (int i = 0; i <= dim; ++i) {
+      const std::size_t record = 4 + (i ? i + 1 : 0);
+      for (std::size_t j = 0; j < recv_ents[i].size(); j += record)
+        ent_records[i].insert(std::make_pair(recv_ents[i][j], j));
+    }
+    std::map<Omega_h::GO, Omega_h::LO> vert_ids;
+    for (std::map<Omega_h::GO, std::size_t>::iterator itr = ent_records[0].begin();
+         itr != ent_records[0].end(); ++itr)
+      vert_ids.insert(std::make_pair(itr->first, (Omega_h::LO)vert_ids.size()));
+
+    Omega_h::LOs ent2v[4];
+    Omega_h::Read<Omega_h::ClassId> ent_class[4];
+    Omega_h::HostWrite<Omega_h::GO> ent_gids_h[4];
+    Omega_h::HostWrite<Omega_h::LO> ent_owners_h[4];
+    Omega_h::HostWrite<Omega_h::LO> ent_rlids_h[4];
+    Omega_h::HostWrite<Omega_h::Real> coords_h(ent_records[0].size() * dim, "coords");
+    std::map<std::vector<Omega_h::LO>, Omega_h::LO> ent_by_verts[4];
+    for (int i = 0; i <= dim; ++i) {
+      const Omega_h::LO nents = ent_records[i].size();
+      const int nvpe = i + 1;
+      const std::size_t record = 4 + (i ? nvpe : 0);
+      Omega_h::HostWrite<Omega_h::LO> ent2v_h(nents * nvpe, "ent2v");
+      Omega_h::HostWrite<Omega_h::ClassId> class_h(nents, "ent_class");
+      ent_gids_h[i] = Omega_h::HostWrite<Omega_h::GO>(nents, "ent_gids");
+      ent_owners_h[i] = Omega_h::HostWrite<Omega_h::LO>(nents, "ent_owners");
+      ent_rlids_h[i] = Omega_h::HostWrite<Omega_h::LO>(nents, "ent_rlids");
+      Omega_h::LO index = 0;
+      for (std::map<Omega_h::GO, std::size_t>::iterator itr = ent_records[i].begin();
+           itr != ent_records[i].end(); ++itr, ++index) {
+        const Omega_h::GO* rec = recv_ents[i].data() + itr->second;
+        ent_gids_h[i][index] = rec[0];
+        class_h[index] = rec[1];
+        ent_owners_h[i][index] = rec[2];
+        ent_rlids_h[i][index] = rec[3];
+        if (i == 0) {
+          ent2v_h[index] = index;
+          const std::size_t vert = itr->second / record;
+          for (int d = 0; d < dim; ++d)
+            coords_h[index * dim + d] = recv_coords[vert * dim + d];
+          continue;
+        }
+        std::vector<Omega_h::LO> verts(nvpe);
+        for (int j = 0; j < nvpe; ++j)
+          ent2v_h[index * nvpe + j] = verts[j] = vert_ids[rec[4 + j]];
+        std::sort(verts.begin(), verts.end());
+        if (i < dim)
+          ent_by_verts[i].insert(std::make_pair(verts, index));
+      }
+      ent2v[i] = ent2v_h.write();
+      ent_class[i] = class_h.write();
+    }
+
+    Omega_h::Library* lib = in.m.library();
+    picpart = new Omega_h::Mesh(lib);
+    Omega_h::build_from_elems_and_coords(picpart, in.m.family(), dim, ent2v[dim],
+                                         coords_h.write());
+    for (int i = dim; i >= 0; --i)
+      Omega_h::classify_equal_order(picpart, i, ent2v[i], ent_class[i]);
+    Omega_h::finalize_classification(picpart);
+    if(!picpart->nelems()) {
+      fprintf(stderr,"%s: empty part on rank %d\n", __func__, rank);
+    }
+    assert(picpart->nelems());
+
+    /****************Safe tags, gids, owners and rank lids of the picpart***********/
+    Omega_h::HostWrite<Omega_h::LO> new_safe_h(picpart->nelems(), "safe_tag");
+    for (int j = 0; j < new_safe_h.size(); ++j)
+      new_safe_h[j] = safe_elems.count(ent_gids_h[dim][j]);
+    is_ent_safe = Omega_h::LOs(new_safe_h.write());
+    picpart->add_tag(dim, "safe", 1, is_ent_safe);
+
+    for (int i = 0; i <= dim; ++i) {
+      //Vertices and elements keep the assembled order, the built edges and faces are matched
+      //  to the received ones by their vertices
+      const Omega_h::LO nents = picpart->nents(i);
+      std::vector<Omega_h::LO> received(nents);
+      if (i == 0 || i == dim) {
+        for (Omega_h::LO j = 0; j < nents; ++j)
+          received[j] = j;
+      }
+      else {
+        const int nvpe = i + 1;
+        Omega_h::HostRead<Omega_h::LO> built_verts(picpart->ask_verts_of(i));
+        for (Omega_h::LO j = 0; j < nents; ++j) {
+          std::vector<Omega_h::LO> verts(built_verts.data() + j * nvpe,
+                                         built_verts.data() + (j + 1) * nvpe);
+          std::sort(verts.begin(), verts.end());
+          received[j] = ent_by_verts[i][verts];
+        }
+      }
+      Omega_h::HostRead<Omega_h::LO> offsets_h(rank_offset_nents[i]);
+      Omega_h::HostWrite<Omega_h::GO> new_ent_gid(nents, "global_ids");
+      Omega_h::HostWrite<Omega_h::LO> new_ent_owners(nents, "ent_owners");
+      Omega_h::HostWrite<Omega_h::LO> new_ent_rlids(nents, "ent_rlids");
+      for (Omega_h::LO j = 0; j < nents; ++j) {
+        const Omega_h::LO ent = received[j];
+        new_ent_owners[j] = ent_owners_h[i][ent];
+        new_ent_rlids[j] = ent_rlids_h[i][ent];
+        new_ent_gid[j] = offsets_h[new_ent_owners[j]] + new_ent_rlids[j];
+      }
+      global_ids_per_dim[i] = Omega_h::GOs(new_ent_gid.write());
+      rank_lids_per_dim[i] = Omega_h::LOs(new_ent_rlids.write());
+      ent_owner_per_dim[i] = Omega_h::LOs(new_ent_owners.write());
+
+      //**************** Build communication information ********************//
+      Omega_h::LOs picpart_offset_nents = calculateOwnerOffset(ent_owner_per_dim[i], comm_size);
+      deferComm(i, rank_offset_nents[i], picpart_offset_nents);
+    }
+    computeBufferDistance();
+  }
+
+  void Mesh::computeBufferDistance() {
+    const int dim = picpart->dim();
+    const Omega_h::LO nelems = picpart->nelems();
+
+    //Sides with one element that are inside the full mesh are on the edge of the buffer
+    const auto side2elems = picpart->ask_up(dim - 1, dim);
+    const auto side_class = picpart->get_array<Omega_h::I8>(dim - 1, "class_dim");
+    const auto side2verts = picpart->ask_verts_of(dim - 1);
+    const int nvps = dim;
+    Omega_h::Write<Omega_h::LO> edge_verts(picpart->nverts(), 0, "buffer_edge_verts");
+    auto markEdgeVerts = OMEGA_H_LAMBDA(Omega_h::LO side) {
+      const bool exposed = side2elems.a2ab[side + 1] - side2elems.a2ab[side] == 1;
+      if (exposed && side_class[side] == dim)
+        for (int i = 0; i < nvps; ++i)
+          edge_verts[side2verts[side * nvps + i]] = 1;
+    };
+    Omega_h::parallel_for(picpart->nents(dim - 1), markEdgeVerts, "markEdgeVerts");
+
+    //Frontier BFS through the vertices from the elements touching the edge
+    const auto elem2verts = picpart->ask_elem_verts();
+    const int nvpe = dim + 1;
+    const auto vert2elems = picpart->ask_up(0, dim);
+    Omega_h::Write<Omega_h::LO> distance(nelems, -1, "buffer_distance");
+    Omega_h::Write<Omega_h::LO> frontier(nelems, "distance_frontier");
+    Omega_h::Write<Omega_h::LO> next_frontier(nelems, "distance_next_frontier");
+    Omega_h::Write<Omega_h::LO> frontier_size(1, 0, "distance_frontier_size");
+    auto initEdge = OMEGA_H_LAMBDA(Omega_h::LO elm) {
+      for (int i = 0; i < nvpe; ++i) {
+        if (edge_verts[elem2verts[elm * nvpe + i]]) {
+          distance[elm] = 0;
+          frontier[Kokkos::atomic_fetch_add(&frontier_size[0], 1)] = elm;
+          return;
+        }
+      }
+    };
+    Omega_h::parallel_for(nelems, initEdge, "initBufferEdge");
+    Omega_h::LO size = Omega_h::HostRead<Omega_h::LO>(Omega_h::LOs(frontier_size))[0];
+    for (Omega_h::LO layer = 1; size > 0; ++layer) {
+      Omega_h::Write<Omega_h::LO> next_size(1, 0, "distance_next_frontier_size");
+      const Omega_h::Write<Omega_h::LO> current = frontier;
+      const Omega_h::Write<Omega_h::LO> next = next_frontier;
+      auto expandFrontier = OMEGA_H_LAMBDA(Omega_h::LO index) {
+        const Omega_h::LO elm = current[index];
+        for (int i = 0; i < nvpe; ++i) {
+          const Omega_h::LO vert = elem2verts[elm * nvpe + i];
+          for (auto j = vert2elems.a2ab[vert]; j < vert2elems.a2ab[vert + 1]; ++j) {
+            const Omega_h::LO adj = vert2elems.ab2b[j];
+            if (distance[adj] == -1 &&
+                Kokkos::atomic_compare_exchange(&distance[adj], -1, layer) == -1)
+              next[Kokkos::atomic_fetch_add(&next_size[0], 1)] = adj;
+          }
+        }
+      };
+      Omega_h::parallel_for(size, expandFrontier, "expandDistanceFrontier");
+      size = Omega_h::HostRead<Omega_h::LO>(Omega_h::LOs(next_size))[0];
+      std::swap(frontier, next_frontier);
     }
+    buffer_distance = Omega_h::LOs(distance);
+  }
+
+  Omega_h::LOs Mesh::fullMeshElementIds(Omega_h::Mesh& full_mesh) {
+    const int dim = full_mesh.dim();
+    if (!full_mesh.has_tag(dim, "ownership")) {
+      fprintf(stderr, "[ERROR] The full mesh has no element ownership of the picparts\n");
+      throw std::runtime_error("Missing full mesh ownership");
+    }
+    //The element global ids number the full mesh elements by owner
+    Omega_h::LOs owners = full_mesh.get_array<Omega_h::LO>(dim, "ownership");
+    Omega_h::Write<Omega_h::GO> gids(full_mesh.nelems(), "global_ids");
+    createGlobalNumbering(owners, commptr->size(), gids);
+    Omega_h::Write<Omega_h::LO> gid_elems(full_mesh.nelems(), -1, "gid_elems");
+    auto invertNumbering = OMEGA_H_LAMBDA(Omega_h::LO elm) {
+      gid_elems[gids[elm]] = elm;
+    };
+    Omega_h::parallel_for(full_mesh.nelems(), invertNumbering, "invertNumbering");
+
+    Omega_h::GOs elem_gids = global_ids_per_dim[dim];
+    Omega_h::Write<Omega_h::LO> full_ids(nelems(), "full_mesh_element_ids");
+    auto setFullIds = OMEGA_H_LAMBDA(Omega_h::LO elm) {
+      full_ids[elm] = gid_elems[elem_gids[elm]];
+    };
+    Omega_h::parallel_for(nelems(), setFullIds, "setFullIds");
+    return Omega_h::LOs(full_ids);
+  }
+
+  Omega_h::LOs Mesh::balancedPartition(Omega_h::Mesh& full_mesh, Omega_h::LOs elem_particles,
+                                       Omega_h::LO elem_weight) {
+    const int dim = full_mesh.dim();
+    const int rank = commptr->rank();
+    const int comm_size = commptr->size();
+    const Omega_h::LO nelems_full = full_mesh.nelems();
+    Omega_h::LOs full_ids = fullMeshElementIds(full_mesh);
+
+    /************* Sum the particles of each element over its copies ***********/
+    Omega_h::Write<Omega_h::LO> counts = createCommArray(dim, 1, 0);
+    auto setCounts = OMEGA_H_LAMBDA(Omega_h::LO elm) {
+      counts[elm] = elem_particles[elm];
+    };
+    Omega_h::parallel_for(nelems(), setCounts, "setCounts");
+    reduceCommArray(dim, SUM_OP, counts);
+
+    //Every process gets the particles of the full mesh elements from their owners
+    Omega_h::LOs owners = ent_owner_per_dim[dim];
+    Omega_h::Write<Omega_h::LO> full_counts(nelems_full, 0, "full_mesh_particles");
+    auto setOwnedCounts = OMEGA_H_LAMBDA(Omega_h::LO elm) {
+      if (owners[elm] == rank)
+        full_counts[full_ids[elm]] = counts[elm];
+    };
+    Omega_h::parallel_for(nelems(), setOwnedCounts, "setOwnedCounts");
+    Omega_h::HostWrite<Omega_h::LO> full_counts_h(full_counts);
+    MPI_Allreduce(MPI_IN_PLACE, full_counts_h.data(), nelems_full, MPI_INT, MPI_SUM,
+                  commptr->get_impl());
+    Omega_h::LOs particles(full_counts_h.write());
+
+    /************* Split the weight along a space filling curve ***********/
+    Omega_h::LOs curve_ids = sfcElementOrder(full_mesh, Omega_h::LOs(nelems_full, 0, 1),
+                                             nelems_full);
+    Omega_h::LOs curve_elems = Omega_h::invert_permutation(curve_ids);
+    //Integer weights so every process computes the same owners
+    Omega_h::Write<Omega_h::GO> midpoints(nelems_full, "curve_weight_midpoints");
+    Kokkos::parallel_scan("curveWeights", nelems_full,
+      KOKKOS_LAMBDA(const Omega_h::LO& i, Omega_h::GO& sum, const bool& final) {
+        const Omega_h::GO weight = elem_weight + particles[curve_elems[i]];
+        //Twice the midpoint of the element's weight
+        if (final)
+          midpoints[i] = 2 * sum + weight;
+        sum += weight;
+      });
+    Omega_h::GO total = 0;
+    Kokkos::parallel_reduce("totalWeight", nelems_full,
+      KOKKOS_LAMBDA(const Omega_h::LO& i, Omega_h::GO& sum) {
+        sum += elem_weight + particles[i];
+      }, total);
+    //An element belongs to the part its weight's midpoint falls in
+    Omega_h::Write<Omega_h::LO> new_owners(nelems_full, "balanced_owners");
+    auto setOwners = OMEGA_H_LAMBDA(Omega_h::LO i) {
+      Omega_h::LO part = (Omega_h::LO)(midpoints[i] * comm_size / (2 * total));
+      part = part < comm_size ? part : comm_size - 1;
+      new_owners[curve_elems[i]] = part;
+    };
+    Omega_h::parallel_for(nelems_full, setOwners, "setBalancedOwners");
+    return Omega_h::LOs(new_owners);
   }
 }
 
@@ -344,52 +767,77 @@ namespace {
     return ent_rank_lids;
   }
 
+  //Bit of index i in an array of 32 bit words
+  OMEGA_H_INLINE Omega_h::LO maskBit(Omega_h::LO i) {
+    return static_cast<Omega_h::LO>(1u << (i & 31));
+  }
+
+  /* Multi-source BFS from the core elements that only touches the expanding frontier
+       Visited elements and reached parts are bitmasks, so each layer costs the frontier's
+       adjacencies instead of a pass over every bridge entity and element of the mesh
+  */
   void bfsBufferLayers(Omega_h::Mesh& mesh, int bridge_dim, Omega_h::CommPtr comm,
                        int safe_layers, int ghost_layers,
                        Omega_h::Write<Omega_h::LO> is_safe,
                        Omega_h::LOs owner, Omega_h::Write<Omega_h::LO> has_part) {
     int rank = comm->rank();
     int comm_size = comm->size();
-    Omega_h::Write<Omega_h::LO> is_visited(mesh.nelems());
-    Omega_h::Write<Omega_h::LO> is_visited_next(mesh.nelems());
+    const Omega_h::LO nelems = mesh.nelems();
+    Omega_h::Write<Omega_h::LO> visited((nelems + 31) / 32, 0, "visited_mask");
+    Omega_h::Write<Omega_h::LO> reached((comm_size + 31) / 32, 0, "reached_parts_mask");
+    Omega_h::Write<Omega_h::LO> frontier(nelems, "bfs_frontier");
+    Omega_h::Write<Omega_h::LO> next_frontier(nelems, "bfs_next_frontier");
+    Omega_h::Write<Omega_h::LO> frontier_size(1, 0, "bfs_frontier_size");
     const auto initVisit = OMEGA_H_LAMBDA( Omega_h::LO elem_id){
-      is_visited[elem_id] = is_safe[elem_id] = (owner[elem_id] == rank);
-      is_visited_next[elem_id] = is_visited[elem_id];
+      is_safe[elem_id] = (owner[elem_id] == rank);
+      if (is_safe[elem_id]) {
+        Kokkos::atomic_fetch_or(&visited[elem_id >> 5], maskBit(elem_id));
+        frontier[Kokkos::atomic_fetch_add(&frontier_size[0], 1)] = elem_id;
+      }
     };
-    Omega_h::parallel_for(mesh.nelems(), initVisit, "initVisit");
-    auto initHasPart = OMEGA_H_LAMBDA(Omega_h::LO i) {
-      has_part[i] = (i == rank);
+    Omega_h::parallel_for(nelems, initVisit, "initVisit");
+    auto initReached = OMEGA_H_LAMBDA(Omega_h::LO i) {
+      reached[rank >> 5] = maskBit(rank);
     };
-    Omega_h::parallel_for(comm_size, initHasPart);
+    Omega_h::parallel_for(1, initReached, "initReached");
 
-    const auto bridge2elems = mesh.ask_up(bridge_dim, mesh.dim());
-    auto ghostingBFS = OMEGA_H_LAMBDA( Omega_h::LO bridge_id) {
-      const auto deg = bridge2elems.a2ab[bridge_id + 1] - bridge2elems.a2ab[bridge_id];
-      const auto firstElm = bridge2elems.a2ab[bridge_id];
-      bool is_visited_here = false;
-      for (int j = 0; j < deg; ++j) {
-        const auto elm = bridge2elems.ab2b[firstElm+j];
-        if (is_visited[elm])
-          is_visited_here = 1;
-      }
-      for (int j = 0; j < deg*is_visited_here; ++j) {
-        const auto elm = bridge2elems.ab2b[firstElm+j];
-        is_visited_next[elm] = true;
-      }
-    };
-    for (int i = 0; i < ghost_layers || i < safe_layers; ++i) {
-      Omega_h::parallel_for(mesh.nents(bridge_dim), ghostingBFS,"ghostingBFS");
-      auto copyVisit = OMEGA_H_LAMBDA( Omega_h::LO elm_id) {
-        is_visited[elm_id] = is_visited_next[elm_id];
-        if (i < safe_layers)
-          is_safe[elm_id] = is_visited_next[elm_id];
-        if (i < ghost_layers)
-          if (is_visited[elm_id])
-            has_part[owner[elm_id]] = 1;
+    const int dim = mesh.dim();
+    const auto elem2bridges = mesh.ask_down(dim, bridge_dim);
+    const int deg = Omega_h::element_degree(mesh.family(), dim, bridge_dim);
+    const auto bridge2elems = mesh.ask_up(bridge_dim, dim);
+    Omega_h::LO size = Omega_h::HostRead<Omega_h::LO>(Omega_h::LOs(frontier_size))[0];
+    for (int i = 0; (i < ghost_layers || i < safe_layers) && size > 0; ++i) {
+      Omega_h::Write<Omega_h::LO> next_size(1, 0, "bfs_next_frontier_size");
+      const Omega_h::Write<Omega_h::LO> current = frontier;
+      const Omega_h::Write<Omega_h::LO> next = next_frontier;
+      auto expandFrontier = OMEGA_H_LAMBDA(Omega_h::LO index) {
+        const Omega_h::LO elm = current[index];
+        for (int j = 0; j < deg; ++j) {
+          const Omega_h::LO bridge = elem2bridges.ab2b[elm * deg + j];
+          for (auto k = bridge2elems.a2ab[bridge]; k < bridge2elems.a2ab[bridge + 1]; ++k) {
+            const Omega_h::LO adj = bridge2elems.ab2b[k];
+            const Omega_h::LO bit = maskBit(adj);
+            if (visited[adj >> 5] & bit)
+              continue;
+            if (Kokkos::atomic_fetch_or(&visited[adj >> 5], bit) & bit)
+              continue;
+            next[Kokkos::atomic_fetch_add(&next_size[0], 1)] = adj;
+            if (i < safe_layers)
+              is_safe[adj] = 1;
+            if (i < ghost_layers)
+              Kokkos::atomic_fetch_or(&reached[owner[adj] >> 5], maskBit(owner[adj]));
+          }
+        }
       };
-
-      Omega_h::parallel_for(mesh.nelems(), copyVisit, "copyVisit");
+      Omega_h::parallel_for(size, expandFrontier, "expandFrontier");
+      size = Omega_h::HostRead<Omega_h::LO>(Omega_h::LOs(next_size))[0];
+      std::swap(frontier, next_frontier);
     }
+
+    auto setHasPart = OMEGA_H_LAMBDA(Omega_h::LO part) {
+      has_part[part] = (reached[part >> 5] & maskBit(part)) != 0;
+    };
+    Omega_h::parallel_for(comm_size, setHasPart, "setHasPart");
   }
 
   void setSafeEnts(Omega_h::Mesh& mesh, int dim, int size, Omega_h::Write<Omega_h::LO> has_part,
@@ -419,7 +867,7 @@ namespace {
   //TODO Replace with omega_h reduce/scan
   Omega_h::LO sumPositives(Omega_h::LO size, Omega_h::Write<Omega_h::LO> arr) {
     Omega_h::LO sum = 0;
-    Kokkos::parallel_reduce(size, OMEGA_H_LAMBDA(const int i, Omega_h::LO& lsum) {
+    Kokkos::parallel_reduce("sumPositives", size, OMEGA_H_LAMBDA(const int i, Omega_h::LO& lsum) {
         lsum += arr[i] > 0 ;
       }, sum);
     return sum;
@@ -481,4 +929,152 @@ namespace {
                                          ent2v, new_coords);
     Omega_h::classify_equal_order(picpart, dim, ent2v, ent_class);
   }
+
+  //Spreads the low bits of x so they are dim bits apart
+  OMEGA_H_INLINE Omega_h::GO spreadBits(Omega_h::GO x, int dim, int bits) {
+    Omega_h::GO spread = 0;
+    for (int b = 0; b < bits; ++b)
+      spread |= ((x >> b) & 1) << (b * dim);
+    return spread;
+  }
+
+  /* New id of each picpart element along a Morton curve of the element centroids
+       elem_ids - picpart id of each element of the mesh, -1 if it is not in the picpart
+  */
+  Omega_h::LOs sfcElementOrder(Omega_h::Mesh& mesh, Omega_h::LOs elem_ids,
+                               Omega_h::LO num_elems) {
+    const int dim = mesh.dim();
+    const int nvpe = dim + 1;
+    const Omega_h::Reals coords = mesh.coords();
+    const Omega_h::LOs elem_verts = mesh.ask_elem_verts();
+    //Bounding box of the mesh
+    Omega_h::Vector<3> low, extent;
+    for (int d = 0; d < 3; ++d) {
+      low[d] = 0;
+      extent[d] = 1;
+    }
+    for (int d = 0; d < dim; ++d) {
+      Omega_h::Real mn, mx;
+      Kokkos::parallel_reduce("sfc_min", mesh.nverts(),
+        KOKKOS_LAMBDA(const Omega_h::LO& v, Omega_h::Real& m) {
+          m = coords[v * dim + d] < m ? coords[v * dim + d] : m;
+        }, Kokkos::Min<Omega_h::Real>(mn));
+      Kokkos::parallel_reduce("sfc_max", mesh.nverts(),
+        KOKKOS_LAMBDA(const Omega_h::LO& v, Omega_h::Real& m) {
+          m = coords[v * dim + d] > m ? coords[v * dim + d] : m;
+        }, Kokkos::Max<Omega_h::Real>(mx));
+      low[d] = mn;
+      extent[d] = mx > mn ? mx - mn : 1;
+    }
+
+    //21 bits per coordinate in 3D and 31 in 2D so each key fits in 63 bits
+    const int bits = dim == 3 ? 21 : 31;
+    const Omega_h::Real max_cell = (Omega_h::Real)(((Omega_h::GO)1 << bits) - 1);
+    Omega_h::Write<Omega_h::GO> keys(num_elems, 0, "sfc_keys");
+    auto computeKeys = OMEGA_H_LAMBDA(Omega_h::LO elm) {
+      const Omega_h::LO new_elm = elem_ids[elm];
+      if (new_elm < 0)
+        return;
+      Omega_h::GO key = 0;
+      for (int d = 0; d < dim; ++d) {
+        Omega_h::Real centroid = 0;
+        for (int v = 0; v < nvpe; ++v)
+          centroid += coords[elem_verts[elm * nvpe + v] * dim + d];
+        centroid /= nvpe;
+        Omega_h::Real cell = (centroid - low[d]) / extent[d] * max_cell;
+        cell = cell < 0 ? 0 : (cell > max_cell ? max_cell : cell);
+        key |= spreadBits((Omega_h::GO)cell, dim, bits) << d;
+      }
+      keys[new_elm] = key;
+    };
+    Omega_h::parallel_for(mesh.nelems(), computeKeys, "computeSFCKeys");
+    //sort_by_keys gives the old element of each new id, invert it for the new ids
+    return Omega_h::invert_permutation(Omega_h::sort_by_keys(Omega_h::GOs(keys)));
+  }
+
+  /* Records of the entities of one dimension in the closure of this process's core
+       ents - (global id, class id, owner, rank lid) followed by the global ids of the
+              vertices for dimensions > 0
+       coords - coordinates of each vertex record
+  */
+  void packCoreEnts(Omega_h::Mesh& mesh, int ent_dim, int rank, Omega_h::LOs elem_owner,
+                    Omega_h::LOs owner, Omega_h::LOs rlids,
+                    std::vector<Omega_h::GO>& ents, std::vector<Omega_h::Real>& coords) {
+    const int dim = mesh.dim();
+    Omega_h::Write<Omega_h::LO> in_core(mesh.nents(ent_dim), 0, "in_core");
+    if (ent_dim == dim) {
+      auto markCore = OMEGA_H_LAMBDA(Omega_h::LO elm_id) {
+        in_core[elm_id] = (elem_owner[elm_id] == rank);
+      };
+      Omega_h::parallel_for(mesh.nelems(), markCore, "markCore");
+    }
+    else {
+      const Omega_h::Adj downAdj = mesh.ask_down(dim, ent_dim);
+      auto deg = Omega_h::element_degree(mesh.family(), dim, ent_dim);
+      auto markCoreClosure = OMEGA_H_LAMBDA(Omega_h::LO elm_id) {
+        if (elem_owner[elm_id] == rank)
+          for (int j = 0; j < deg; ++j)
+            in_core[downAdj.ab2b[elm_id * deg + j]] = 1;
+      };
+      Omega_h::parallel_for(mesh.nelems(), markCoreClosure, "markCoreClosure");
+    }
+    Omega_h::HostRead<Omega_h::LO> in_core_h(Omega_h::LOs(in_core));
+    Omega_h::HostRead<Omega_h::GO> gids_h(mesh.globals(ent_dim));
+    Omega_h::HostRead<Omega_h::ClassId> class_h(mesh.get_array<Omega_h::ClassId>(ent_dim,
+                                                                                 "class_id"));
+    Omega_h::HostRead<Omega_h::LO> owner_h(owner);
+    Omega_h::HostRead<Omega_h::LO> rlids_h(rlids);
+    for (int i = 0; i < in_core_h.size(); ++i) {
+      if (!in_core_h[i])
+        continue;
+      ents.push_back(gids_h[i]);
+      ents.push_back(class_h[i]);
+      ents.push_back(owner_h[i]);
+      ents.push_back(rlids_h[i]);
+    }
+    if (ent_dim == 0) {
+      Omega_h::HostRead<Omega_h::Real> coords_h(mesh.coords());
+      for (int i = 0; i < in_core_h.size(); ++i)
+        if (in_core_h[i])
+          for (int d = 0; d < dim; ++d)
+            coords.push_back(coords_h[i * dim + d]);
+      return;
+    }
+    //Insert the vertices after each record
+    const int nvpe = ent_dim + 1;
+    const std::size_t record = 4 + nvpe;
+    std::vector<Omega_h::GO> with_verts(ents.size() / 4 * record);
+    Omega_h::HostRead<Omega_h::LO> verts_h(mesh.ask_verts_of(ent_dim));
+    Omega_h::HostRead<Omega_h::GO> vert_gids_h(mesh.globals(0));
+    std::size_t index = 0;
+    for (int i = 0; i < in_core_h.size(); ++i) {
+      if (!in_core_h[i])
+        continue;
+      for (int j = 0; j < 4; ++j)
+        with_verts[index * record + j] = ents[index * 4 + j];
+      for (int j = 0; j < nvpe; ++j)
+        with_verts[index * record + 4 + j] = vert_gids_h[verts_h[i * nvpe + j]];
+      ++index;
+    }
+    ents.swap(with_verts);
+  }
+
+  //Sends the same values to every process with receivers[rank] set and returns the values
+  //  sent to this process in rank order
+  template <typename T>
+  std::vector<T> exchangeCores(MPI_Comm comm, MPI_Datatype type,
+                               const std::vector<int>& receivers, const std::vector<T>& send) {
+    const int comm_size = receivers.size();
+    std::vector<int> send_counts(comm_size), send_displs(comm_size, 0);
+    for (int i = 0; i < comm_size; ++i)
+      send_counts[i] = receivers[i] ? send.size() : 0;
+    std::vector<int> recv_counts(comm_size), recv_displs(comm_size + 1, 0);
+    MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, comm);
+    for (int i = 0; i < comm_size; ++i)
+      recv_displs[i + 1] = recv_displs[i] + recv_counts[i];
+    std::vector<T> recv(recv_displs[comm_size]);
+    MPI_Alltoallv(const_cast<T*>(send.data()), send_counts.data(), send_displs.data(), type,
+                  recv.data(), recv_counts.data(), recv_displs.data(), type, comm);
+    return recv;
+  }
 }
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <Omega_h_mesh.hpp>
+#include <Omega_h_for.hpp>
+#include <Omega_h_scan.hpp>
+#include <Kokkos_Core.hpp>
+#include <cmath>
+#include "pumipic_mesh.hpp"
+
+namespace o = Omega_h;
+
+namespace pumipic {
+
+  /* Direct point location on the device with a uniform grid of element bounding boxes
+
+     The bounding box of the mesh is split into roughly cells_per_elem * nelems cubic cells.
+     Each cell stores (in CSR form) the elements whose bounding box overlaps it, so locating a
+     point only tests the barycentric coordinates of the few elements in the point's cell
+     instead of walking the mesh from a seed element.
+
+     Usage:
+       PointLocator locator(picparts);
+       o::LOs elems = locator.locate(points); //dim coordinates per point
+
+     Note: Elements are triangles (2d) or tetrahedrons (3d). Points outside every element of
+           the mesh are located in element -1.
+   */
+  class PointLocator {
+  public:
+    explicit PointLocator(o::Mesh& mesh, o::Real cells_per_elem = 1) {
+      build(mesh, cells_per_elem);
+    }
+    explicit PointLocator(Mesh& picparts, o::Real cells_per_elem = 1) {
+      build(*picparts.mesh(), cells_per_elem);
+    }
+
+    int dim() const {return mesh_dim;}
+    o::LO numCells() const {return num_cells[0] * num_cells[1] * num_cells[2];}
+
+    //Element containing each of the points, -1 for points outside the mesh
+    o::LOs locate(o::Reals points, o::Real tol = 1e-10) const {
+      const int dim = mesh_dim;
+      const o::LO npts = points.size() / dim;
+      o::Write<o::LO> located(npts, -1, "located_elements");
+      const auto lo = low;
+      const auto h = cell_size;
+      const auto n = num_cells;
+      const auto offsets = cell_offsets;
+      const auto elems = cell_elems;
+      const auto pos = coords;
+      const auto verts = elem_verts;
+      auto locatePoint = OMEGA_H_LAMBDA(const o::LO& pt) {
+        o::Real p[3] = {0, 0, 0};
+        for (int d = 0; d < dim; ++d)
+          p[d] = points[pt * dim + d];
+        o::LO cell = 0;
+        for (int d = dim - 1; d >= 0; --d) {
+          const o::LO c = (o::LO)floor((p[d] - lo[d]) / h[d]);
+          if (c < 0 || c >= n[d])
+            return;
+          cell = cell * n[d] + c;
+        }
+        for (o::LO i = offsets[cell]; i < offsets[cell + 1]; ++i) {
+          const o::LO elm = elems[i];
+          if (elementContains(dim, pos, verts, elm, p, tol)) {
+            located[pt] = elm;
+            return;
+          }
+        }
+      };
+      o::parallel_for(npts, locatePoint, "locatePoints");
+      return o::LOs(located);
+    }
+
+    //Barycentric containment test of point p in triangle/tetrahedron elm
+    OMEGA_H_DEVICE static bool elementContains(int dim, const o::Reals& pos,
+                                               const o::LOs& verts, o::LO elm,
+                                               const o::Real* p, o::Real tol) {
+      const int nv = dim + 1;
+      o::Real x[4][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+      for (int v = 0; v < nv; ++v)
+        for (int d = 0; d < dim; ++d)
+          x[v][d] = pos[verts[elm * nv + v] * dim + d];
+      if (dim == 2) {
+        //Scaling by the signed area handles either element orientation
+        const o::Real area = signedArea(x[0], x[1], x[2]);
+        const o::Real lim = -tol * area * area;
+        return signedArea(p, x[1], x[2]) * area >= lim &&
+               signedArea(x[0], p, x[2]) * area >= lim &&
+               signedArea(x[0], x[1], p) * area >= lim;
+      }
+      const o::Real vol = signedVolume(x[0], x[1], x[2], x[3]);
+      const o::Real lim = -tol * vol * vol;
+      return signedVolume(p, x[1], x[2], x[3]) * vol >= lim &&
+             signedVolume(x[0], p, x[2], x[3]) * vol >= lim &&
+             signedVolume(x[0], x[1], p, x[3]) * vol >= lim &&
+             signedVolume(x[0], x[1], x[2], p) * vol >= lim;
+    }
+
+    //Public so device lambdas can be created; called by the constructors
+    void build(o::Mesh& mesh, o::Real cells_per_elem) {
+      mesh_dim = mesh.dim();
+      const int dim = mesh_dim;
+      coords = mesh.coords();
+      elem_verts = mesh.ask_elem_verts();
+      const o::LO nverts = mesh.nverts();
+      const o::LO nelems = mesh.nelems();
+
+      //Bounding box of the mesh
+      o::Real volume = 1;
+      for (int d = 0; d < 3; ++d) {
+        low[d] = 0;
+        cell_size[d] = 1;
+        num_cells[d] = 1;
+      }
+      o::Real extent[3] = {0, 0, 0};
+      const auto pos = coords;
+      for (int d = 0; d < dim; ++d) {
+        o::Real mn, mx;
+        Kokkos::parallel_reduce("point_locator_min", nverts,
+          KOKKOS_LAMBDA(const o::LO& v, o::Real& m) {
+            m = pos[v * dim + d] < m ? pos[v * dim + d] : m;
+          }, Kokkos::Min<o::Real>(mn));
+        Kokkos::parallel_reduce("point_locator_max", nverts,
+          KOKKOS_LAMBDA(const o::LO& v, o::Real& m) {
+            m = pos[v * dim + d] > m ? pos[v * dim + d] : m;
+          }, Kokkos::Max<o::Real>(mx));
+        //Pad the box so points on the boundary fall inside the last cell
+        const o::Real pad = (mx - mn) * 1e-8 + 1e-12;
+        low[d] = mn - pad;
+        extent[d] = mx - mn + 2 * pad;
+        volume *= extent[d];
+      }
+      const o::Real ncells = cells_per_elem * nelems > 1 ? cells_per_elem * nelems : 1;
+      const o::Real width = std::pow(volume / ncells, 1.0 / dim);
+      for (int d = 0; d < dim; ++d) {
+        num_cells[d] = (o::LO)std::ceil(extent[d] / width);
+        if (num_cells[d] < 1)
+          num_cells[d] = 1;
+        cell_size[d] = extent[d] / num_cells[d];
+      }
+
+      //Count, scan and fill the elements overlapping each cell
+      const auto lo = low;
+      const auto h = cell_size;
+      const auto n = num_cells;
+      const auto verts = elem_verts;
+      const int nv = dim + 1;
+      auto cellRange = OMEGA_H_LAMBDA(const o::LO& elm, o::LO* first, o::LO* last) {
+        for (int d = 0; d < 3; ++d) {
+          first[d] = 0;
+          last[d] = 0;
+        }
+        for (int d = 0; d < dim; ++d) {
+          o::Real mn = pos[verts[elm * nv] * dim + d];
+          o::Real mx = mn;
+          for (int v = 1; v < nv; ++v) {
+            const o::Real x = pos[verts[elm * nv + v] * dim + d];
+            mn = x < mn ? x : mn;
+            mx = x > mx ? x : mx;
+          }
+          first[d] = (o::LO)floor((mn - lo[d]) / h[d]);
+          last[d] = (o::LO)floor((mx - lo[d]) / h[d]);
+          first[d] = first[d] < 0 ? 0 : first[d];
+          last[d] = last[d] >= n[d] ? n[d] - 1 : last[d];
+        }
+      };
+      o::Write<o::LO> counts(numCells(), 0, "point_locator_counts");
+      auto countCells = OMEGA_H_LAMBDA(const o::LO& elm) {
+        o::LO first[3], last[3];
+        cellRange(elm, first, last);
+        for (o::LO k = first[2]; k <= last[2]; ++k)
+          for (o::LO j = first[1]; j <= last[1]; ++j)
+            for (o::LO i = first[0]; i <= last[0]; ++i)
+              Kokkos::atomic_add(&counts[(k * n[1] + j) * n[0] + i], 1);
+      };
+      o::parallel_for(nelems, countCells, "point_locator_count");
+      cell_offsets = o::offset_scan(o::LOs(counts));
+      const auto offsets = cell_offsets;
+      o::Write<o::LO> filled(numCells(), 0, "point_locator_filled");
+      o::Write<o::LO> elems(cell_offsets.last(), "point_locator_elems");
+      auto fillCells = OMEGA_H_LAMBDA(const o::LO& elm) {
+        o::LO first[3], last[3];
+        cellRange(elm, first, last);
+        for (o::LO k = first[2]; k <= last[2]; ++k)
+          for (o::LO j = first[1]; j <= last[1]; ++j)
+            for (o::LO i = first[0]; i <= last[0]; ++i) {
+              const o::LO cell = (k * n[1] + j) * n[0] + i;
+              elems[offsets[cell] + Kokkos::atomic_fetch_add(&filled[cell], 1)] = elm;
+            }
+      };
+      o::parallel_for(nelems, fillCells, "point_locator_fill");
+      cell_elems = o::LOs(elems);
+    }
+
+  private:
+    OMEGA_H_DEVICE static o::Real signedArea(const o::Real* a, const o::Real* b,
+                                             const o::Real* c) {
+      return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+    }
+    OMEGA_H_DEVICE static o::Real signedVolume(const o::Real* a, const o::Real* b,
+                                               const o::Real* c, const o::Real* d) {
+      const o::Real u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+      const o::Real v[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+      const o::Real w[3] = {d[0] - a[0], d[1] - a[1], d[2] - a[2]};
+      return u[0] * (v[1] * w[2] - v[2] * w[1]) - u[1] * (v[0] * w[2] - v[2] * w[0]) +
+             u[2] * (v[0] * w[1] - v[1] * w[0]);
+    }
+
+    int mesh_dim;
+    o::Vector<3> low;
+    o::Vector<3> cell_size;
+    o::Few<o::LO, 3> num_cells;
+    o::Reals coords;
+    o::LOs elem_verts;
+    //CSR of grid cells to the elements whose bounding box overlaps them
+    o::LOs cell_offsets;
+    o::LOs cell_elems;
+  };
+}
@@ -2,6 +2,14 @@
 #define PUMIPIC_PROFILING_H
 
 #include "Kokkos_Core.hpp"
+#include <RegionTimers.h>
+#include <ImbalanceMonitor.h>
+
+/* Timers and counters of pumipic are recorded in the particle_structs registry
+   see particle_structs::getRegionTimes and particle_structs::writeRegionSummary
+   The prebarrier waits of the searches are recorded by the imbalance monitor, see
+   particle_structs::reduceImbalance
+*/
 
 void pumipic_enable_prebarrier();
 
@@ -4,11 +4,15 @@
 #include <iostream>
 #include <cmath>
 #include <utility>
+#include <cstdio>
 
 #include "Omega_h_adj.hpp"
 #include "Omega_h_array_ops.hpp"
 #include "Omega_h_scalar.hpp" //divide
 #include "Omega_h_fail.hpp"
+#include "Omega_h_shape.hpp" //barycentric_from_global
+#include "Omega_h_for.hpp"
+#include <particle_structs.hpp>
 
 #include "pumipic_utils.hpp"
 #include "pumipic_constants.hpp"
@@ -74,5 +78,155 @@ OMEGA_H_INLINE void pushBoris(Omega_h::LO nelems, Omega_h::Write<Omega_h::Real>
   Omega_h::parallel_for(1,  pushPtcl, "push");
 }
 
+//Species parameters of pushBoris on a particle structure
+struct BorisSpecies {
+  Omega_h::Real charge; //elementary charges
+  Omega_h::Real amu; //atomic mass units
+};
+
+//Boris velocity update with the fields at the particle
+OMEGA_H_INLINE Omega_h::Vector<3> borisVelocity(const Omega_h::Vector<3>& vel,
+                                                const Omega_h::Vector<3>& eField,
+                                                const Omega_h::Vector<3>& bField,
+                                                const Omega_h::Real qPrime) {
+  const Omega_h::Real bFieldMag = osh_mag(bField);
+  const Omega_h::Real coeff = 2.0*qPrime/(1.0+(qPrime*bFieldMag)*(qPrime*bFieldMag));
+  const Omega_h::Vector<3> qpE = qPrime*eField;
+  //v_minus = v + q_prime*E
+  const Omega_h::Vector<3> vMinus = vel + qpE;
+  //v_prime = v_minus + q_prime*(v_minus x B)
+  const Omega_h::Vector<3> vPrime = vMinus + qPrime*Omega_h::cross(vMinus, bField);
+  //v = v_minus + coeff*(v_prime x B) + q_prime*E
+  return vMinus + coeff*Omega_h::cross(vPrime, bField) + qpE;
+}
+
+//Barycentric coordinates of the position of a particle in its element
+template <int DIM, class Segment>
+struct SolvedWeights {
+  SolvedWeights(Omega_h::Mesh& mesh, Segment x_ps) :
+    coords(mesh.coords()), x(x_ps) {}
+  OMEGA_H_DEVICE Omega_h::Vector<DIM + 1> operator()(const Omega_h::LO pid,
+      const Omega_h::Few<Omega_h::LO, DIM + 1>& verts) const {
+    const auto vertCoords = Omega_h::gather_vectors<DIM + 1, DIM>(coords, verts);
+    Omega_h::Vector<DIM> pos;
+    for(int i = 0; i < DIM; ++i)
+      pos[i] = x(pid, i);
+    return Omega_h::barycentric_from_global<DIM, DIM>(pos, vertCoords);
+  }
+  Omega_h::Reals coords;
+  Segment x;
+};
+
+//Barycentric coordinates stored by the search, see BarycentricFinish
+template <int DIM, class Segment>
+struct CachedWeights {
+  CachedWeights(Segment bcc_ps) : bcc(bcc_ps) {}
+  OMEGA_H_DEVICE Omega_h::Vector<DIM + 1> operator()(const Omega_h::LO pid,
+      const Omega_h::Few<Omega_h::LO, DIM + 1>&) const {
+    Omega_h::Vector<DIM + 1> weights;
+    for(int i = 0; i < DIM + 1; ++i)
+      weights[i] = bcc(pid, i);
+    return weights;
+  }
+  Segment bcc;
+};
+
+template <int DIM, int PTCL_X, int PTCL_XTGT, int PTCL_V, class ParticleStruct, class Weights>
+void pushBorisDim(ParticleStruct* ptcls, Omega_h::Mesh& mesh, Omega_h::Reals eField,
+                  Omega_h::Reals bField, const Omega_h::Real qPrime, const Omega_h::Real dt,
+                  const Weights& weights) {
+  const auto elem_verts = mesh.ask_elem_verts();
+  auto x = ptcls->template get<PTCL_X>();
+  auto xtgt = ptcls->template get<PTCL_XTGT>();
+  auto v = ptcls->template get<PTCL_V>();
+  auto push = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask) {
+      //interpolate the vertex fields to the particle in its parent element
+      const auto verts = Omega_h::gather_verts<DIM + 1>(elem_verts, e);
+      const auto bcc = weights(pid, verts);
+      Omega_h::Vector<3> eAt = Omega_h::zero_vector<3>();
+      Omega_h::Vector<3> bAt = Omega_h::zero_vector<3>();
+      for(int j = 0; j < DIM + 1; ++j) {
+        for(int i = 0; i < 3; ++i) {
+          eAt[i] += bcc[j] * eField[verts[j]*3 + i];
+          bAt[i] += bcc[j] * bField[verts[j]*3 + i];
+        }
+      }
+      Omega_h::Vector<3> vel;
+      for(int i = 0; i < 3; ++i)
+        vel[i] = v(pid, i);
+      vel = borisVelocity(vel, eAt, bAt, qPrime);
+      for(int i = 0; i < 3; ++i)
+        v(pid, i) = vel[i];
+      //only the components locating the particle in the mesh move
+      for(int i = 0; i < DIM; ++i)
+        xtgt(pid, i) = x(pid, i) + vel[i] * dt;
+    }
+  };
+  particle_structs::parallel_for(ptcls, push, "pumipic_pushBoris");
+}
+
+/* Boris push of every particle of a particle structure in one kernel
+     PTCL_X - member of the current positions (3 components)
+     PTCL_XTGT - member written with the pushed positions x + v*dt for the adjacency search
+     PTCL_V - member of the velocities (3 components), updated in place
+     efield_tag, bfield_tag - 3 component Real vertex tags of the electric and magnetic
+                              fields, interpolated with the barycentric coordinates of the
+                              particle in its element of the structure
+   On 2d meshes the first two components of the position locate the particle, the third
+   component of PTCL_XTGT is not written.
+*/
+template <int PTCL_X, int PTCL_XTGT, int PTCL_V, class ParticleStruct>
+void pushBoris(ParticleStruct* ptcls, Omega_h::Mesh& mesh, const char* efield_tag,
+               const char* bfield_tag, const BorisSpecies& species, Omega_h::Real dt) {
+  if(species.amu <= 0 || dt <= 0) {
+    fprintf(stderr, "[ERROR] pushBoris needs a positive mass and time step\n");
+    return;
+  }
+  Kokkos::Profiling::pushRegion("pumipic_pushBoris");
+  const auto eField = mesh.get_array<Omega_h::Real>(0, efield_tag);
+  const auto bField = mesh.get_array<Omega_h::Real>(0, bfield_tag);
+  const Omega_h::Real qPrime = species.charge*1.60217662e-19/(species.amu*1.6737236e-27)*dt*0.5;
+  auto x = ptcls->template get<PTCL_X>();
+  typedef decltype(x) Segment;
+  if(mesh.dim() == 3)
+    pushBorisDim<3, PTCL_X, PTCL_XTGT, PTCL_V>(ptcls, mesh, eField, bField, qPrime, dt,
+                                               SolvedWeights<3, Segment>(mesh, x));
+  else if(mesh.dim() == 2)
+    pushBorisDim<2, PTCL_X, PTCL_XTGT, PTCL_V>(ptcls, mesh, eField, bField, qPrime, dt,
+                                               SolvedWeights<2, Segment>(mesh, x));
+  else
+    fprintf(stderr, "[ERROR] pushBoris only supports 2d and 3d meshes\n");
+  Kokkos::Profiling::popRegion();
+}
+
+/* pushBoris reading the barycentric coordinates of PTCL_X from the member PTCL_BCC
+     PTCL_BCC - mesh dim + 1 coordinates in the element of each particle, written by the
+                last search with BarycentricFinish (which moved xtgt to x)
+*/
+template <int PTCL_X, int PTCL_XTGT, int PTCL_V, int PTCL_BCC, class ParticleStruct>
+void pushBoris(ParticleStruct* ptcls, Omega_h::Mesh& mesh, const char* efield_tag,
+               const char* bfield_tag, const BorisSpecies& species, Omega_h::Real dt) {
+  if(species.amu <= 0 || dt <= 0) {
+    fprintf(stderr, "[ERROR] pushBoris needs a positive mass and time step\n");
+    return;
+  }
+  Kokkos::Profiling::pushRegion("pumipic_pushBoris_cached");
+  const auto eField = mesh.get_array<Omega_h::Real>(0, efield_tag);
+  const auto bField = mesh.get_array<Omega_h::Real>(0, bfield_tag);
+  const Omega_h::Real qPrime = species.charge*1.60217662e-19/(species.amu*1.6737236e-27)*dt*0.5;
+  auto bcc = ptcls->template get<PTCL_BCC>();
+  typedef decltype(bcc) Segment;
+  if(mesh.dim() == 3)
+    pushBorisDim<3, PTCL_X, PTCL_XTGT, PTCL_V>(ptcls, mesh, eField, bField, qPrime, dt,
+                                               CachedWeights<3, Segment>(bcc));
+  else if(mesh.dim() == 2)
+    pushBorisDim<2, PTCL_X, PTCL_XTGT, PTCL_V>(ptcls, mesh, eField, bField, qPrime, dt,
+                                               CachedWeights<2, Segment>(bcc));
+  else
+    fprintf(stderr, "[ERROR] pushBoris only supports 2d and 3d meshes\n");
+  Kokkos::Profiling::popRegion();
+}
+
 } //namespace
 #endif // PUMIPIC_PUSH_HPP_INCLUDED
@@ -0,0 +1,112 @@
+#include <cstdlib>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include <Omega_h_file.hpp>
+#include <Omega_h_for.hpp>
+#include <pumipic_mesh.hpp>
+#include <pumipic_profiling.hpp>
+
+/* Benchmark of picpart construction and communication array reductions
+     Construction is timed by phase (pumipic_picpart_*), each reduction of every Op, entity
+     dimension and entries per entity is timed under bench_reduce_<op>_d<dim>_n<entries>
+     with its bytes and entities recorded, so the summary reports the latency (min),
+     bandwidth and entities/s of each. Memory per rank is recorded as counters.
+   Run on several rank counts with the same mesh (strong scaling) or a mesh per rank count
+   (weak scaling) and compare the JSON files.
+*/
+
+namespace {
+  const char* opName(pumipic::Mesh::Op op) {
+    if (op == pumipic::Mesh::SUM_OP)
+      return "sum";
+    if (op == pumipic::Mesh::MAX_OP)
+      return "max";
+    if (op == pumipic::Mesh::MIN_OP)
+      return "min";
+    return "bcast";
+  }
+
+  long long memoryBytes(pumipic::Mesh& picparts) {
+    std::map<std::string, std::size_t> usage = picparts.memoryUsage();
+    long long total = 0;
+    for (auto itr = usage.begin(); itr != usage.end(); ++itr)
+      total += itr->second;
+    return total;
+  }
+
+  void benchReduce(pumipic::Mesh& picparts, int dim, pumipic::Mesh::Op op, int entries,
+                   int iterations) {
+    std::stringstream ss;
+    ss << "bench_reduce_" << opName(op) << "_d" << dim << "_n" << entries;
+    const std::string name = ss.str();
+    const Omega_h::LO nents = picparts.nents(dim);
+    Omega_h::Write<Omega_h::Real> array = picparts.createCommArray(dim, entries, 1.0);
+    //The first reduction builds the communication plan of the shape, it is timed apart
+    {
+      particle_structs::RegionTimer plan_timer(name + "_first");
+      picparts.reduceCommArray(dim, op, array);
+    }
+    for (int i = 0; i < iterations; ++i) {
+      MPI_Barrier(MPI_COMM_WORLD);
+      particle_structs::RegionTimer timer(name);
+      picparts.reduceCommArray(dim, op, array);
+      particle_structs::recordKernelWork(name, (long long)nents * entries *
+                                         sizeof(Omega_h::Real), nents);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  pumipic::Library pic_lib(&argc, &argv);
+  Omega_h::Library& lib = pic_lib.omega_h_lib();
+  int rank = lib.world()->rank();
+  if (argc < 4 || argc > 7) {
+    if (!rank)
+      fprintf(stderr, "Usage: %s <mesh> <partition filename> <buffer method FULL|BFS|MINIMUM> "
+              "[safe method (default buffer method)] [iterations (default 10)] "
+              "[output (default bench_comm.json)]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  const pumipic::Input::Method buffer_method = pumipic::Input::getMethod(argv[3]);
+  const pumipic::Input::Method safe_method = argc > 4 ? pumipic::Input::getMethod(argv[4]) :
+    buffer_method;
+  const int iterations = argc > 5 ? atoi(argv[5]) : 10;
+  const std::string output = argc > 6 ? argv[6] : "bench_comm.json";
+  if (buffer_method == pumipic::Input::INVALID || safe_method == pumipic::Input::INVALID ||
+      buffer_method == pumipic::Input::NONE || iterations < 1) {
+    if (!rank)
+      fprintf(stderr, "[ERROR] Invalid buffer/safe method or iterations\n");
+    return EXIT_FAILURE;
+  }
+
+  Omega_h::Mesh mesh = Omega_h::read_mesh_file(argv[1], lib.self());
+  particle_structs::setTimePrints(false);
+  particle_structs::setKernelWork(true);
+  particle_structs::resetRegionTimes();
+
+  pumipic::Input input(mesh, argv[2], buffer_method, safe_method);
+  if (!rank)
+    input.printInfo();
+  MPI_Barrier(MPI_COMM_WORLD);
+  pumipic::Mesh picparts(input);
+  particle_structs::addToCounter("bench_memory_construct_bytes", memoryBytes(picparts));
+  particle_structs::addToCounter("bench_elements", picparts->nelems());
+
+  const pumipic::Mesh::Op ops[4] = {pumipic::Mesh::SUM_OP, pumipic::Mesh::MAX_OP,
+                                   pumipic::Mesh::MIN_OP, pumipic::Mesh::BCAST_OP};
+  const int entries[3] = {1, 4, 16};
+  const int dims[2] = {0, picparts.dim()};
+  for (int d = 0; d < 2; ++d)
+    for (int o = 0; o < 4; ++o)
+      for (int e = 0; e < 3; ++e)
+        benchReduce(picparts, dims[d], ops[o], entries[e], iterations);
+  particle_structs::addToCounter("bench_memory_reduce_bytes", memoryBytes(picparts));
+
+  particle_structs::printRegionSummary();
+  particle_structs::writeRegionSummary(output);
+  if (!rank)
+    printf("Wrote %s\n", output.c_str());
+  return 0;
+}
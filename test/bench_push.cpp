@@ -0,0 +1,609 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <Omega_h_bbox.hpp>
+#include <Omega_h_file.hpp>
+#include <Omega_h_for.hpp>
+#include <particle_structs.hpp>
+#include <DeviceDistribute.h>
+#include "pumipic_adjacency.hpp"
+#include "pumipic_mesh.hpp"
+#include "pumipic_profiling.hpp"
+#include "pumipic_push.hpp"
+
+/* Push, search and migrate benchmark of the standard workloads
+     Every workload runs the same step (push, search, migrate) on a mesh and partition.
+     Usage: bench_push <mesh> <partition|none> <workload> [key=value ...]
+       partition - .ptn, .cpn or .bpn partition, none for one rank
+       workload - one of the standard workloads below, its settings are overridden by
+         ptcls=<particles per rank> dist=even|uniform|gaussian|exponential
+         push=linear|elliptical|boris species=<n> steps=<n> seed=<n>
+         search=loop|walk|team buffer=FULL|BFS|MINIMUM safe=FULL|BFS|MINIMUM|NONE
+         output=<file.json> (default bench_push.json)
+     The output has the workload, the time of each phase (max and mean of the ranks, their
+       ratio is the imbalance), particles/s of each phase (particles of every rank and step
+       over the max time) and the particle imbalance (max over mean particles per rank) of
+       the steps. The region summary with the timers of pumipic and particle_structs is
+       written next to it as <output>_regions.json.
+     Push models
+       linear - each step moves the particles along a fixed direction by 1/50 of the
+                largest extent of the mesh
+       elliptical - each step rotates the particles 2 degrees around the center of the mesh
+                    on an ellipse with the aspect ratio of the mesh in x-y
+       boris - Boris push in uniform fields, B along z and E along x
+     Species s of n moves (s + 1) / n as far (linear, elliptical) or has a mass of s + 1
+       (boris).
+*/
+
+using particle_structs::lid_t;
+using particle_structs::MemberTypes;
+using particle_structs::SellCSigma;
+using pumipic::fp_t;
+using pumipic::Vector3d;
+
+namespace o = Omega_h;
+namespace p = pumipic;
+namespace ps = particle_structs;
+
+namespace {
+  enum {PTCL_X, PTCL_XTGT, PTCL_V, PTCL_ID, PTCL_SPECIES, PTCL_B, PTCL_PHI};
+  //Position, pushed position, velocity, id, species and the ellipse of each particle
+  typedef MemberTypes<Vector3d, Vector3d, Vector3d, int, int, fp_t, fp_t> Particle;
+  typedef SellCSigma<Particle> SCS;
+  typedef ps::MultiSpecies<Particle, PTCL_SPECIES> Species;
+
+  enum PushModel {PUSH_LINEAR, PUSH_ELLIPTICAL, PUSH_BORIS};
+  enum SearchMethod {SEARCH_LOOP, SEARCH_WALK, SEARCH_TEAM};
+
+  struct Workload {
+    std::string name;
+    long ptcls; //per rank
+    int dist;
+    int push;
+    int species;
+    int steps;
+  };
+
+  //The standard workloads, keep their settings fixed so results compare across releases
+  const Workload standard_workloads[] = {
+    {"linear_uniform", 10000, ps::DIST_UNIFORM, PUSH_LINEAR, 1, 10},
+    {"linear_gaussian_2species", 10000, ps::DIST_GAUSSIAN, PUSH_LINEAR, 2, 10},
+    {"elliptical_even", 10000, ps::DIST_EVEN, PUSH_ELLIPTICAL, 1, 10},
+    {"boris_exponential_3species", 10000, ps::DIST_EXPONENTIAL, PUSH_BORIS, 3, 10}
+  };
+  const int num_standard_workloads = sizeof(standard_workloads) / sizeof(Workload);
+
+  const char* dist_names[] = {"even", "uniform", "gaussian", "exponential"};
+  const char* push_names[] = {"linear", "elliptical", "boris"};
+  const char* search_names[] = {"loop", "walk", "team"};
+
+  int findName(const char* const* names, int n, const std::string& s) {
+    for (int i = 0; i < n; ++i)
+      if (s == names[i])
+        return i;
+    return -1;
+  }
+
+  //Extents of the mesh in each direction (the third is 0 on 2d meshes)
+  struct Box {
+    o::Real min[3];
+    o::Real max[3];
+    o::Real length() const {
+      o::Real len = 0;
+      for (int i = 0; i < 3; ++i)
+        len = std::max(len, max[i] - min[i]);
+      return len;
+    }
+  };
+
+  Box boundingBox(o::Mesh& mesh) {
+    Box box = {{0, 0, 0}, {0, 0, 0}};
+    if (mesh.dim() == 3) {
+      const auto bb = o::get_bounding_box<3>(&mesh);
+      for (int i = 0; i < 3; ++i) {
+        box.min[i] = bb.min[i];
+        box.max[i] = bb.max[i];
+      }
+    }
+    else {
+      const auto bb = o::get_bounding_box<2>(&mesh);
+      for (int i = 0; i < 2; ++i) {
+        box.min[i] = bb.min[i];
+        box.max[i] = bb.max[i];
+      }
+    }
+    return box;
+  }
+
+  /* Creates the particles of this rank in the elements it owns
+       The distribution is over the owned elements so no particle starts in the buffer
+  */
+  SCS* createParticles(p::Mesh& picparts, const Workload& workload, uint64_t seed) {
+    const int comm_rank = picparts.comm()->rank();
+    const int dim = picparts.dim();
+    const o::LO ne = picparts.nelems();
+    const lid_t np = workload.ptcls;
+    const o::LOs owners = picparts.entOwners(dim);
+    SCS::kkLidView owned("owned_elements", ne);
+    lid_t num_owned = 0;
+    Kokkos::parallel_scan("bench_owned_elements", ne,
+                          KOKKOS_LAMBDA(const lid_t& i, lid_t& cur, const bool& final) {
+      if (owners[i] == comm_rank) {
+        if (final)
+          owned(cur) = i;
+        ++cur;
+      }
+    }, num_owned);
+    SCS::kkLidView ptcls_per_elem("ptcls_per_elem", ne);
+    SCS::kkLidView particle_elements("particle_elements", np);
+    if (num_owned > 0) {
+      SCS::kkLidView owned_ppe("owned_ptcls_per_elem", num_owned);
+      if (!ps::distributeParticles(num_owned, np, workload.dist, seed, comm_rank, owned_ppe,
+                                   particle_elements))
+        return NULL;
+      Kokkos::parallel_for("bench_owned_ppe", num_owned, KOKKOS_LAMBDA(const lid_t& i) {
+        ptcls_per_elem(owned(i)) = owned_ppe(i);
+      });
+      Kokkos::parallel_for("bench_owned_particles", np, KOKKOS_LAMBDA(const lid_t& i) {
+        particle_elements(i) = owned(particle_elements(i));
+      });
+    }
+    else if (np > 0) {
+      fprintf(stderr, "[WARNING] Rank %d owns no elements, it has no particles\n", comm_rank);
+    }
+    const lid_t actual = num_owned > 0 ? np : 0;
+    SCS::kkGidView element_gids("element_gids", ne);
+    const o::GOs mesh_gids = picparts.globalIds(dim);
+    Kokkos::parallel_for("bench_element_gids", ne, KOKKOS_LAMBDA(const lid_t& i) {
+      element_gids(i) = mesh_gids[i];
+    });
+    Kokkos::TeamPolicy<Kokkos::DefaultExecutionSpace> policy(10000, 32);
+    SCS* ptcls = new SCS(policy, INT_MAX, 1024, ne, actual, ptcls_per_elem, element_gids,
+                         actual > 0 ? particle_elements : SCS::kkLidView());
+
+    //Each particle starts at the centroid of its element
+    const auto elem_verts = picparts.mesh()->ask_elem_verts();
+    const auto coords = picparts.mesh()->coords();
+    const int nverts = dim + 1;
+    const int num_species = workload.species;
+    auto x = ptcls->get<PTCL_X>();
+    auto xtgt = ptcls->get<PTCL_XTGT>();
+    auto v = ptcls->get<PTCL_V>();
+    auto ids = ptcls->get<PTCL_ID>();
+    auto species = ptcls->get<PTCL_SPECIES>();
+    auto setParticles = PS_LAMBDA(const lid_t& e, const lid_t& pid, const bool& mask) {
+      for (int i = 0; i < 3; ++i) {
+        x(pid, i) = 0;
+        xtgt(pid, i) = 0;
+        v(pid, i) = 0;
+      }
+      if (mask) {
+        for (int j = 0; j < nverts; ++j) {
+          const o::LO vert = elem_verts[e * nverts + j];
+          for (int i = 0; i < dim; ++i)
+            x(pid, i) += coords[vert * dim + i] / nverts;
+        }
+      }
+      ids(pid) = pid;
+      species(pid) = pid % num_species;
+    };
+    ps::parallel_for(ptcls, setParticles, "bench_set_particles");
+    return ptcls;
+  }
+
+  //Settings of the push models derived from the mesh
+  struct PushSettings {
+    o::Real distance; //linear step
+    o::Real dir[3];
+    o::Real center[2]; //elliptical
+    o::Real ratio;
+    o::Real degrees;
+    o::Real dt; //boris
+    o::Real efield[3];
+    o::Real bfield[3];
+  };
+
+  PushSettings pushSettings(o::Mesh& mesh) {
+    const Box box = boundingBox(mesh);
+    PushSettings settings;
+    settings.distance = box.length() / 50;
+    const o::Real dir[3] = {1, 0.5, mesh.dim() == 3 ? 0.25 : 0};
+    const o::Real norm = std::sqrt(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+    for (int i = 0; i < 3; ++i)
+      settings.dir[i] = dir[i] / norm;
+    for (int i = 0; i < 2; ++i)
+      settings.center[i] = (box.min[i] + box.max[i]) / 2;
+    const o::Real height = box.max[1] - box.min[1];
+    settings.ratio = height > 0 ? (box.max[0] - box.min[0]) / height : 1;
+    settings.degrees = 2;
+    /* A proton moves distance in dt and turns about 6 degrees per step in B,
+         E drifts the particles by a fifth of that speed
+    */
+    settings.dt = 1e-8;
+    const o::Real speed = settings.distance / settings.dt;
+    const o::Real qm = 1.60217662e-19 / 1.6737236e-27;
+    const o::Real b = 0.1 / (qm * settings.dt / 2);
+    for (int i = 0; i < 3; ++i) {
+      settings.efield[i] = 0;
+      settings.bfield[i] = 0;
+    }
+    settings.bfield[2] = b;
+    settings.efield[0] = 0.2 * speed * b;
+    return settings;
+  }
+
+  //Sets the ellipse (b, phi) and the velocity of each particle from its position
+  void setupPush(Species& species, const PushSettings& settings) {
+    SCS* ptcls = static_cast<SCS*>(species.structure());
+    if (ptcls->nPtcls() == 0)
+      return;
+    auto x = ptcls->get<PTCL_X>();
+    auto v = ptcls->get<PTCL_V>();
+    auto ptcl_b = ptcls->get<PTCL_B>();
+    auto ptcl_phi = ptcls->get<PTCL_PHI>();
+    const o::Real h = settings.center[0];
+    const o::Real k = settings.center[1];
+    const o::Real d = settings.ratio;
+    const o::Real speed = settings.distance / settings.dt;
+    const o::Real dx = settings.dir[0] * speed;
+    const o::Real dy = settings.dir[1] * speed;
+    auto setup = PS_LAMBDA(const lid_t&, const lid_t& pid, const bool& mask) {
+      if (mask) {
+        //x = b d cos(phi) + h, y = b sin(phi) + k
+        const o::Real w = (x(pid, 0) - h) / d;
+        const o::Real z = x(pid, 1) - k;
+        ptcl_b(pid) = std::sqrt(w * w + z * z);
+        ptcl_phi(pid) = atan2(z, w);
+        v(pid, 0) = dx;
+        v(pid, 1) = dy;
+        v(pid, 2) = 0;
+      }
+    };
+    ps::parallel_for(ptcls, setup, "bench_setup_push");
+  }
+
+  void pushLinear(Species& species, const PushSettings& settings) {
+    SCS* ptcls = static_cast<SCS*>(species.structure());
+    auto x = ptcls->get<PTCL_X>();
+    auto xtgt = ptcls->get<PTCL_XTGT>();
+    const o::Real dx = settings.dir[0];
+    const o::Real dy = settings.dir[1];
+    const o::Real dz = settings.dir[2];
+    for (int s = 0; s < species.numSpecies(); ++s) {
+      const o::Real distance = settings.distance * (s + 1) / species.numSpecies();
+      auto push = PS_LAMBDA(const lid_t&, const lid_t& pid, const bool& mask) {
+        if (mask) {
+          xtgt(pid, 0) = x(pid, 0) + distance * dx;
+          xtgt(pid, 1) = x(pid, 1) + distance * dy;
+          xtgt(pid, 2) = x(pid, 2) + distance * dz;
+        }
+      };
+      species.parallel_for(s, push, "bench_push_linear");
+    }
+  }
+
+  void pushElliptical(Species& species, const PushSettings& settings) {
+    SCS* ptcls = static_cast<SCS*>(species.structure());
+    auto x = ptcls->get<PTCL_X>();
+    auto xtgt = ptcls->get<PTCL_XTGT>();
+    auto ptcl_b = ptcls->get<PTCL_B>();
+    auto ptcl_phi = ptcls->get<PTCL_PHI>();
+    const o::Real h = settings.center[0];
+    const o::Real k = settings.center[1];
+    const o::Real d = settings.ratio;
+    for (int s = 0; s < species.numSpecies(); ++s) {
+      const o::Real rad = settings.degrees * (s + 1) / species.numSpecies() * M_PI / 180.0;
+      auto push = PS_LAMBDA(const lid_t&, const lid_t& pid, const bool& mask) {
+        if (mask) {
+          const o::Real phi = ptcl_phi(pid) + rad;
+          const o::Real b = ptcl_b(pid);
+          xtgt(pid, 0) = b * d * std::cos(phi) + h;
+          xtgt(pid, 1) = b * std::sin(phi) + k;
+          xtgt(pid, 2) = x(pid, 2);
+          ptcl_phi(pid) = phi;
+        }
+      };
+      species.parallel_for(s, push, "bench_push_elliptical");
+    }
+  }
+
+  void pushBoris(Species& species, const PushSettings& settings) {
+    SCS* ptcls = static_cast<SCS*>(species.structure());
+    auto x = ptcls->get<PTCL_X>();
+    auto xtgt = ptcls->get<PTCL_XTGT>();
+    auto v = ptcls->get<PTCL_V>();
+    const o::Vector<3> eField = o::vector_3(settings.efield[0], settings.efield[1],
+                                            settings.efield[2]);
+    const o::Vector<3> bField = o::vector_3(settings.bfield[0], settings.bfield[1],
+                                            settings.bfield[2]);
+    const o::Real dt = settings.dt;
+    for (int s = 0; s < species.numSpecies(); ++s) {
+      const o::Real amu = s + 1;
+      const o::Real qPrime = 1.60217662e-19 / (amu * 1.6737236e-27) * dt * 0.5;
+      auto push = PS_LAMBDA(const lid_t&, const lid_t& pid, const bool& mask) {
+        if (mask) {
+          o::Vector<3> vel;
+          for (int i = 0; i < 3; ++i)
+            vel[i] = v(pid, i);
+          vel = p::borisVelocity(vel, eField, bField, qPrime);
+          for (int i = 0; i < 3; ++i) {
+            v(pid, i) = vel[i];
+            xtgt(pid, i) = x(pid, i) + vel[i] * dt;
+          }
+        }
+      };
+      species.parallel_for(s, push, "bench_push_boris");
+    }
+  }
+
+  void push(Species& species, int model, const PushSettings& settings) {
+    if (model == PUSH_LINEAR)
+      pushLinear(species, settings);
+    else if (model == PUSH_ELLIPTICAL)
+      pushElliptical(species, settings);
+    else
+      pushBoris(species, settings);
+  }
+
+  //Finds the element of the pushed positions, sets the migration targets and moves x
+  void search(p::Mesh& picparts, p::SearchContext& context, SCS* ptcls, int method,
+              SCS::kkLidView new_element, SCS::kkLidView new_process) {
+    const int maxLoops = 200;
+    const lid_t capacity = ptcls->capacity();
+    auto x = ptcls->get<PTCL_X>();
+    auto xtgt = ptcls->get<PTCL_XTGT>();
+    auto pid = ptcls->get<PTCL_ID>();
+    o::Write<o::LO> elem_ids(capacity, -1, "bench_elem_ids");
+    bool found = true;
+    if (picparts.dim() == 3) {
+      if (method == SEARCH_WALK)
+        found = p::search_mesh_walk(context, ptcls, x, xtgt, pid, elem_ids,
+                                    o::Write<o::Real>(), o::Write<o::LO>(), maxLoops);
+      else if (method == SEARCH_TEAM)
+        found = p::search_mesh_team(context, ptcls, x, xtgt, pid, elem_ids,
+                                    o::Write<o::Real>(), o::Write<o::LO>(), maxLoops);
+      else {
+        o::Write<o::Real> xpoints(3 * capacity, "bench_xpoints");
+        o::Write<o::LO> xfaces(capacity, "bench_xfaces");
+        found = p::search_mesh(context, ptcls, x, xtgt, pid, elem_ids, xpoints, xfaces,
+                               maxLoops);
+      }
+    }
+    else {
+      if (method == SEARCH_WALK)
+        found = p::search_mesh_2d_walk(context, ptcls, x, xtgt, pid, elem_ids, maxLoops);
+      else if (method == SEARCH_TEAM)
+        found = p::search_mesh_2d_team(context, ptcls, x, xtgt, pid, elem_ids, maxLoops);
+      else
+        found = p::search_mesh_2d(context, ptcls, x, xtgt, pid, elem_ids, maxLoops);
+    }
+    if (!found)
+      fprintf(stderr, "[WARNING] The search did not finish every particle on rank %d\n",
+              picparts.comm()->rank());
+    const p::MigrateTargets targets(picparts, new_element, new_process, x, xtgt);
+    auto setTargets = PS_LAMBDA(const lid_t&, const lid_t& ptcl, const bool& mask) {
+      if (mask)
+        targets(ptcl, elem_ids[ptcl]);
+    };
+    ps::parallel_for(ptcls, setTargets, "bench_migrate_targets");
+  }
+
+  //Max and mean of a value over the ranks
+  void maxMean(double value, double& max, double& mean) {
+    int comm_size;
+    MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+    MPI_Allreduce(&value, &max, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    MPI_Allreduce(&value, &mean, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    mean /= comm_size;
+  }
+
+  double imbalance(double max, double mean) {
+    return mean > 0 ? max / mean : 1;
+  }
+
+  bool parseSetting(Workload& workload, int& search_method, p::Input::Method& buffer,
+                    p::Input::Method& safe, uint64_t& seed, std::string& output,
+                    const std::string& arg) {
+    const std::size_t eq = arg.find('=');
+    if (eq == std::string::npos)
+      return false;
+    const std::string key = arg.substr(0, eq);
+    const std::string value = arg.substr(eq + 1);
+    if (key == "ptcls")
+      workload.ptcls = atol(value.c_str());
+    else if (key == "dist")
+      workload.dist = findName(dist_names, 4, value);
+    else if (key == "push")
+      workload.push = findName(push_names, 3, value);
+    else if (key == "species")
+      workload.species = atoi(value.c_str());
+    else if (key == "steps")
+      workload.steps = atoi(value.c_str());
+    else if (key == "seed")
+      seed = strtoull(value.c_str(), NULL, 10);
+    else if (key == "search")
+      search_method = findName(search_names, 3, value);
+    else if (key == "buffer")
+      buffer = p::Input::getMethod(value);
+    else if (key == "safe")
+      safe = p::Input::getMethod(value);
+    else if (key == "output")
+      output = value;
+    else
+      return false;
+    return true;
+  }
+
+  void printUsage(const char* exe) {
+    fprintf(stderr, "Usage: %s <mesh> <partition|none> <workload> [key=value ...]\n"
+            "  keys: ptcls dist push species steps seed search buffer safe output\n"
+            "  workloads:", exe);
+    for (int i = 0; i < num_standard_workloads; ++i)
+      fprintf(stderr, " %s", standard_workloads[i].name.c_str());
+    fprintf(stderr, "\n");
+  }
+}
+
+int main(int argc, char** argv) {
+  pumipic::Library pic_lib(&argc, &argv);
+  Omega_h::Library& lib = pic_lib.omega_h_lib();
+  int comm_rank, comm_size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+  if (argc < 4) {
+    if (!comm_rank)
+      printUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  int index = -1;
+  for (int i = 0; i < num_standard_workloads; ++i)
+    if (standard_workloads[i].name == argv[3])
+      index = i;
+  if (index < 0) {
+    if (!comm_rank) {
+      fprintf(stderr, "[ERROR] Unknown workload %s\n", argv[3]);
+      printUsage(argv[0]);
+    }
+    return EXIT_FAILURE;
+  }
+  Workload workload = standard_workloads[index];
+  int search_method = SEARCH_LOOP;
+  p::Input::Method buffer_method = p::Input::BFS;
+  p::Input::Method safe_method = p::Input::BFS;
+  uint64_t seed = 1024;
+  std::string output = "bench_push.json";
+  for (int i = 4; i < argc; ++i) {
+    if (!parseSetting(workload, search_method, buffer_method, safe_method, seed, output,
+                      argv[i])) {
+      if (!comm_rank)
+        fprintf(stderr, "[ERROR] Unknown setting %s\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (workload.ptcls < 0 || workload.dist < 0 || workload.push < 0 ||
+      workload.species < 1 || workload.steps < 1 || search_method < 0 ||
+      buffer_method == p::Input::INVALID || buffer_method == p::Input::NONE ||
+      safe_method == p::Input::INVALID) {
+    if (!comm_rank)
+      fprintf(stderr, "[ERROR] Invalid settings of workload %s\n", workload.name.c_str());
+    return EXIT_FAILURE;
+  }
+  const bool partitioned = strcmp(argv[2], "none") != 0;
+  if (!partitioned && comm_size > 1) {
+    if (!comm_rank)
+      fprintf(stderr, "[ERROR] A partition is needed for more than one rank\n");
+    return EXIT_FAILURE;
+  }
+
+  particle_structs::setTimePrints(false);
+  particle_structs::setKernelWork(true);
+  particle_structs::resetRegionTimes();
+  o::Mesh full_mesh = o::read_mesh_file(argv[1], lib.self());
+  p::Input* input = partitioned ?
+    new p::Input(full_mesh, argv[2], buffer_method, safe_method) :
+    new p::Input(full_mesh, p::Input::PARTITION, o::LOs(full_mesh.nelems(), 0),
+                 p::Input::FULL, p::Input::FULL);
+  p::Mesh picparts(*input);
+  delete input;
+  o::Mesh* mesh = picparts.mesh();
+  mesh->ask_elem_verts();
+
+  SCS* ptcls = createParticles(picparts, workload, seed);
+  if (!ptcls)
+    return EXIT_FAILURE;
+  Species species(ptcls, workload.species);
+  const PushSettings settings = pushSettings(*mesh);
+  setupPush(species, settings);
+  p::SearchContext context(picparts);
+
+  double initial_max, initial_mean;
+  maxMean(ptcls->nPtcls(), initial_max, initial_mean);
+  double max_ptcl_imbalance = imbalance(initial_max, initial_mean);
+  double sum_ptcl_imbalance = 0;
+  double total_ptcls = 0;
+  int steps_run = 0;
+  double phase_times[3] = {0, 0, 0};
+  const char* phase_names[3] = {"bench_push", "bench_search", "bench_migrate"};
+  for (int step = 0; step < workload.steps; ++step) {
+    double np_max, np_mean;
+    maxMean(ptcls->nPtcls(), np_max, np_mean);
+    if (np_max == 0) {
+      if (!comm_rank)
+        fprintf(stderr, "[WARNING] No particles remain after %d steps\n", step);
+      break;
+    }
+    max_ptcl_imbalance = std::max(max_ptcl_imbalance, imbalance(np_max, np_mean));
+    sum_ptcl_imbalance += imbalance(np_max, np_mean);
+    total_ptcls += np_mean * comm_size;
+    ++steps_run;
+    const lid_t np = ptcls->nPtcls();
+    ps::ScopedRegion step_region("bench_step");
+    {
+      ps::RegionTimer timer(phase_names[0]);
+      push(species, workload.push, settings);
+      Kokkos::fence();
+      phase_times[0] += timer.seconds();
+    }
+    SCS::kkLidView new_element("new_element", ptcls->capacity());
+    SCS::kkLidView new_process("new_process", ptcls->capacity());
+    {
+      ps::RegionTimer timer(phase_names[1]);
+      search(picparts, context, ptcls, search_method, new_element, new_process);
+      Kokkos::fence();
+      phase_times[1] += timer.seconds();
+    }
+    {
+      ps::RegionTimer timer(phase_names[2]);
+      species.migrate(new_element, new_process);
+      phase_times[2] += timer.seconds();
+    }
+    for (int i = 0; i < 3; ++i)
+      ps::recordKernelWork(phase_names[i], 0, np);
+  }
+  double final_max, final_mean;
+  maxMean(ptcls->nPtcls(), final_max, final_mean);
+  double phase_max[3], phase_mean[3];
+  for (int i = 0; i < 3; ++i)
+    maxMean(phase_times[i], phase_max[i], phase_mean[i]);
+
+  const std::string base = output.size() > 5 && output.substr(output.size() - 5) == ".json" ?
+    output.substr(0, output.size() - 5) : output;
+  ps::printRegionSummary();
+  ps::writeRegionSummary(base + "_regions.json");
+  if (!comm_rank) {
+    FILE* out = fopen(output.c_str(), "w");
+    if (!out) {
+      fprintf(stderr, "[ERROR] Cannot open %s to write the benchmark results\n",
+              output.c_str());
+      delete ptcls;
+      return EXIT_FAILURE;
+    }
+    fprintf(out, "{\n  \"workload\": {\"name\": \"%s\", \"mesh\": \"%s\", \"ranks\": %d, "
+            "\"ptcls_per_rank\": %ld, \"distribution\": \"%s\", \"push\": \"%s\", "
+            "\"species\": %d, \"steps\": %d, \"search\": \"%s\", \"seed\": %llu},\n",
+            workload.name.c_str(), argv[1], comm_size, workload.ptcls,
+            dist_names[workload.dist], push_names[workload.push], workload.species,
+            steps_run, search_names[search_method], (unsigned long long)seed);
+    fprintf(out, "  \"phases\": [");
+    for (int i = 0; i < 3; ++i)
+      fprintf(out, "%s\n    {\"name\": \"%s\", \"max\": %g, \"mean\": %g, \"imbalance\": %g, "
+              "\"particles_per_second\": %g}", i ? "," : "", phase_names[i] + 6,
+              phase_max[i], phase_mean[i], imbalance(phase_max[i], phase_mean[i]),
+              phase_max[i] > 0 ? total_ptcls / phase_max[i] : 0);
+    fprintf(out, "\n  ],\n  \"particles\": {\"initial\": %.0f, \"final\": %.0f, "
+            "\"max_imbalance\": %g, \"mean_imbalance\": %g},\n",
+            initial_mean * comm_size, final_mean * comm_size, max_ptcl_imbalance,
+            steps_run > 0 ? sum_ptcl_imbalance / steps_run : 1);
+    fprintf(out, "  \"regions\": \"%s\"\n}\n", (base + "_regions.json").c_str());
+    fclose(out);
+    printf("Wrote %s\n", output.c_str());
+  }
+  delete ptcls;
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include <cstdlib>
+#include <string>
+
+#include <xgcp_mesh.hpp>
+#include <xgcp_particle.hpp>
+#include <xgcp_push.hpp>
+#include <particle_structs.hpp>
+#include <Omega_h_for.hpp>
+
+/* Benchmark of the direct and hierarchical migrations of xgcp
+     Ions on every owned element are pushed around the flux surfaces across the planes
+     for a number of steps, each step's search and migration is timed under
+     bench_migrate_<mode> with the particles on the rank as its work. The ps_migrate and
+     ps_rebuild regions report the exchanges and rebuilds behind it: one of each per step
+     for the direct migration, one per torodial stage plus the mesh stage for the
+     hierarchical one.
+   Run once per mode with the same arguments and compare the JSON files.
+*/
+
+namespace {
+  namespace o = Omega_h;
+  namespace ps = particle_structs;
+  using xgcp::PS_I;
+
+  //Center of the flux surfaces of the 24k mesh
+  const double h = 1.72479370-.08;
+  const double k = .020558260;
+
+  PS_I* createIons(xgcp::Mesh& mesh) {
+    const int rank = mesh.pumipicMesh()->comm()->rank();
+    const o::LO ne = mesh.nelems();
+    const auto owners = mesh.pumipicMesh()->entOwners(mesh.dim());
+    Omega_h::GOs mesh_element_gids = mesh.pumipicMesh()->globalIds(mesh.dim());
+    PS_I::kkLidView ptcls_per_elem("ptcls_per_elem", ne);
+    PS_I::kkGidView element_gids("element_gids", ne);
+    o::Write<o::LO> ppe(ne, "ppe");
+    o::parallel_for(ne, OMEGA_H_LAMBDA(const o::LO& i) {
+      ppe[i] = owners[i] == rank ? 1 + i % 3 : 0;
+      ptcls_per_elem(i) = ppe[i];
+      element_gids(i) = mesh_element_gids[i];
+    });
+    return xgcp::initializeIons(mesh, o::get_sum(o::LOs(ppe)), ptcls_per_elem, element_gids);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  pumipic::Library pic_lib(&argc, &argv);
+  Omega_h::Library& lib = pic_lib.omega_h_lib();
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if (argc < 6 || argc > 9) {
+    if (!rank)
+      fprintf(stderr, "Usage: %s <mesh> <owner_file> <num planes> <num procs per group> "
+              "<direct|hierarchical> [steps (default 5)] [degrees per step (default 20)] "
+              "[output (default bench_xgcp_migrate.json)]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  const std::string mode = argv[5];
+  const int steps = argc > 6 ? atoi(argv[6]) : 5;
+  const double degPerPush = argc > 7 ? atof(argv[7]) : 20;
+  const std::string output = argc > 8 ? argv[8] : "bench_xgcp_migrate.json";
+  if ((mode != "direct" && mode != "hierarchical") || steps < 1) {
+    if (!rank)
+      fprintf(stderr, "[ERROR] Invalid migration mode or steps\n");
+    return EXIT_FAILURE;
+  }
+  xgcp::Input input(lib, argv[1], argv[2], atoi(argv[3]), atoi(argv[4]),
+                    pumipic::Input::getMethod("full"), pumipic::Input::getMethod("bfs"));
+  input.setHierarchicalMigration(mode == "hierarchical");
+  xgcp::Mesh mesh(input);
+  ps::setTimePrints(false);
+  ps::setKernelWork(true);
+
+  PS_I* ions = createIons(mesh);
+  xgcp::ellipticalPush::setup(ions, h, k, 0.6);
+  pumipic::SearchContext context(*(mesh.omegaMesh()));
+  ps::resetRegionTimes();
+  const std::string name = "bench_migrate_" + mode;
+  for (int iter = 0; iter < steps; ++iter) {
+    xgcp::ellipticalPush::push(ions, *mesh.omegaMesh(), degPerPush, iter);
+    MPI_Barrier(MPI_COMM_WORLD);
+    ps::RegionTimer timer(name);
+    xgcp::search(mesh, ions, context);
+    ps::recordKernelWork(name, 0, ions->nPtcls());
+  }
+  ps::addToCounter("bench_ions", ions->nPtcls());
+  delete ions;
+
+  ps::printRegionSummary();
+  ps::writeRegionSummary(output);
+  if (!rank)
+    printf("Wrote %s\n", output.c_str());
+  return 0;
+}
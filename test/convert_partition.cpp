@@ -0,0 +1,15 @@
+#include <cstdio>
+#include <cstdlib>
+#include <pumipic_input.hpp>
+
+//Converts a text partition (.ptn/.cpn) to the binary partition format (.bpn)
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <text partition (.ptn/.cpn)> <binary partition (.bpn)>\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (!pumipic::Input::convertPartition(argv[1], argv[2]))
+    return EXIT_FAILURE;
+  return EXIT_SUCCESS;
+}
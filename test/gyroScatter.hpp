@@ -2,6 +2,7 @@
 #define GYRO_SCATTER_H
 
 #include "pseudoXGCmTypes.hpp"
+#include <pumipic_point_locator.hpp>
 
 namespace {
   o::Real gyro_rmax = 0.038; //max ring radius
@@ -22,69 +23,28 @@ void printGyroConfig() {
       gyro_rmax, gyro_num_rings, gyro_points_per_ring, gyro_theta);
 }
 
-o::LOs searchAndBuildMap(o::Mesh* mesh, o::Reals element_centroids,
-                               o::Reals projected_points, o::LOs starting_element) {
-  o::LO num_points = starting_element.size();
-
-  //Create PS for the projected points to perform adjacency search on
-  PSpt::kkLidView ptcls_per_elem("ptcls_per_elem", mesh->nelems());
-  PSpt::kkLidView point_element("point_element", num_points);
-  auto point_info = particle_structs::createMemberViews<Point>(num_points);
-  auto start_pos = particle_structs::getMemberView<Point, 0>(point_info);
-  auto end_pos = particle_structs::getMemberView<Point, 1>(point_info);
-  auto point_id = particle_structs::getMemberView<Point, 2>(point_info);
-  auto countPointsInElement = OMEGA_H_LAMBDA(const o::LO& id) {
-    const o::LO elm = starting_element[id];
-    Kokkos::atomic_fetch_add(&(ptcls_per_elem(elm)), 1); //can just be 'add', no fetch needed
-    point_id(id) = id;
-    point_element(id) = elm;
-    for (int i = 0; i < 2; ++i) {
-      start_pos(id,i) = element_centroids[elm*2+i];
-      end_pos(id,i) = projected_points[id*2+i];
-    }
-  };
-  o::parallel_for(num_points, countPointsInElement, "countPointsInElement");
-
-  const int sigma = INT_MAX;
-  const int V = 64;
-  Kokkos::TeamPolicy<Kokkos::DefaultExecutionSpace> policy(10000, 32);
-  PSpt::kkGidView empty_gids("empty_gids", 0);
-  PSpt* gyro_ps = new ps::SellCSigma<Point>(policy, sigma, V,
-                                            mesh->nelems(), num_points,
-                                            ptcls_per_elem, empty_gids,
-                                            point_element, point_info);
-  printf("created ps for gyro mapping with %d points and %d elms\n",
-      num_points, mesh->nelems());
-
-  //Adjacency search
-  auto start = gyro_ps->get<0>();
-  auto end = gyro_ps->get<1>();
-  auto pids = gyro_ps->get<2>();
-  int maxLoops = 100;
-  int psCapacity = gyro_ps->capacity();
-  o::Write<o::LO> elem_ids(psCapacity, -1);
-  bool isFound = p::search_mesh_2d(*mesh, gyro_ps, start, end, pids,
-                                   elem_ids, maxLoops);
-  assert(isFound);
+o::LOs buildGyroMap(o::Mesh* mesh, const p::PointLocator& locator,
+                    o::Reals projected_points) {
+  //Locate the projected points directly instead of walking from a seed element
+  o::LOs point_elems = locator.locate(projected_points);
+  const o::LO num_points = point_elems.size();
 
   const auto numElms = mesh->nelems();
   //Gyro avg mapping: 3 vertices per ring point (Assumes all elements are triangles)
   const o::LO nvpe = 3;
-  o::Write<o::LO> gyro_avg_map(nvpe * num_points, -1);
+  o::Write<o::LO> gyro_avg_map(nvpe * num_points, -1, "gyro_map");
   auto elm2Verts = mesh->ask_down(mesh->dim(), 0);
-  auto createGyroMapping = PS_LAMBDA(const int&, const int& pid, const int& mask) {
-    const o::LO parent = elem_ids[pid];
-    if (mask && parent >= 0) { //skip points outside the domain (parent == -1)
+  auto createGyroMapping = OMEGA_H_LAMBDA(const o::LO& id) {
+    const o::LO parent = point_elems[id];
+    if (parent >= 0) { //skip points outside the domain (parent == -1)
       assert(parent>=0 && parent<numElms);
-      const o::LO id = pids(pid);
       const o::LO start_index = id* nvpe;
       const o::LO start_elm = parent*nvpe;
       for (int i = 0; i < 3; ++i)
         gyro_avg_map[start_index+i] = elm2Verts.ab2b[start_elm+i];
     }
   };
-  ps::parallel_for(gyro_ps, createGyroMapping);
-  delete gyro_ps;
+  o::parallel_for(num_points, createGyroMapping, "createGyroMapping");
   return o::LOs(gyro_avg_map);
 }
 
@@ -131,36 +91,10 @@ void createGyroRingMappings(o::Mesh* mesh, o::LOs& forward_map,
   };
   o::parallel_for(num_points, projectCoords, "projectCoords");
 
-  //Use adjacency search to find the element that the projected point is in
-  o::Write<o::LO> starting_element(num_points,0, "starting_element");
-  auto verts2Elm = mesh->ask_up(0, mesh->dim());
-  auto setInitialElement = OMEGA_H_LAMBDA(const o::LO& id) {
-    //Note: Setting initial element to be the first element adjacent to the vertex
-    const o::LO vert_id = id / gppr / gnr;
-    const auto firstElm = verts2Elm.a2ab[vert_id];
-    starting_element[id] = verts2Elm.ab2b[firstElm];
-  };
-  o::parallel_for(num_points, setInitialElement, "setInitialElement");
-
-  //Calculate centroids of each element
-  o::Write<o::Real> element_centroids(mesh->nelems()*2);
-  auto cells2nodes = mesh->get_adj(mesh->dim(), o::VERT).ab2b;
-  auto calculateCentroids = OMEGA_H_LAMBDA(const o::LO& elm) {
-    auto elmVerts = o::gather_verts<3>(cells2nodes, elm);
-    auto vtxCoords = o::gather_vectors<3,2>(coords, elmVerts);
-    auto center = average(vtxCoords);
-    element_centroids[elm*2] = center[0];
-    element_centroids[elm*2+1] = center[1];
-  };
-  o::parallel_for(mesh->nelems(), calculateCentroids, "calculateCentroids");
-
   //Create both mapping
-  forward_map = searchAndBuildMap(mesh, o::Reals(element_centroids),
-                                  o::Reals(forward_ring_points),
-                                  o::LOs(starting_element));
-  backward_map = searchAndBuildMap(mesh, o::Reals(element_centroids),
-                                   o::Reals(backward_ring_points),
-                                   o::LOs(starting_element));
+  p::PointLocator locator(*mesh);
+  forward_map = buildGyroMap(mesh, locator, o::Reals(forward_ring_points));
+  backward_map = buildGyroMap(mesh, locator, o::Reals(backward_ring_points));
   Kokkos::Profiling::popRegion();
 }
 
@@ -236,22 +170,14 @@ void gyroSync(p::Mesh& picparts, const std::string& fwdTagName,
   int rank, comm_size;
   MPI_Comm_rank(MPI_COMM_WORLD,&rank);
   MPI_Comm_size(MPI_COMM_WORLD,&comm_size);
-  Omega_h::Write<Omega_h::Real> sync_array = picparts.createCommArray(0, 2, Omega_h::Real(0.0));
-  Omega_h::Mesh* mesh = picparts.mesh();
-  Omega_h::Read<Omega_h::Real> fwdTag = mesh->get_array<Omega_h::Real>(0, fwdTagName);
-  Omega_h::Read<Omega_h::Real> bkwdTag = mesh->get_array<Omega_h::Real>(0, bkwdTagName);
-
-  auto setSyncArray = OMEGA_H_LAMBDA(const Omega_h::LO vtx_id) {
-    sync_array[2*vtx_id] = fwdTag[vtx_id];
-    sync_array[2*vtx_id+1] = bkwdTag[vtx_id];
-  };
-  Omega_h::parallel_for(mesh->nverts(), setSyncArray);
+  std::vector<std::string> tagNames;
+  tagNames.push_back(fwdTagName);
+  tagNames.push_back(bkwdTagName);
 
   Kokkos::Timer reducetimer;
-  picparts.reduceCommArray(0, p::Mesh::Op::SUM_OP, sync_array);
+  picparts.reduceTags<Omega_h::Real>(0, p::Mesh::Op::SUM_OP, tagNames, syncTagName);
   const auto rtime = reducetimer.seconds();
 
-  mesh->set_tag(0, syncTagName, Omega_h::Reals(sync_array));
   if(!rank || rank == comm_size/2) {
     fprintf(stderr, "%d gyro sync times (sec): sync %f pre-barrier %f reduction %f\n",
         rank, timer.seconds(), btime, rtime);
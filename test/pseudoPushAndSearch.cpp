@@ -1,5 +1,6 @@
 #include <Omega_h_mesh.hpp>
 #include <Omega_h_bbox.hpp>
+#include <Omega_h_build.hpp>
 #include "pumipic_kktypes.hpp"
 #include "pumipic_adjacency.hpp"
 #include <particle_structs.hpp>
@@ -391,6 +392,33 @@ o::Mesh readMesh(char* meshFile, o::Library& lib) {
   }
 }
 
+//A walk whose segment misses every face of its tet, all of them exposed, is not found
+//  instead of looping without a loop limit
+bool testNoExit(o::Library& lib) {
+  o::Mesh tet(&lib);
+  o::build_from_elems_and_coords(&tet, OMEGA_H_SIMPLEX, 3, o::LOs({0, 1, 2, 3}),
+                                 o::Reals({0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1}));
+  p::SearchContext search(tet);
+  const p::TetWalk walker(search);
+  o::Write<o::LO> result(2, -2, "no_exit_result");
+  auto walk = OMEGA_H_LAMBDA(const o::LO&) {
+    o::LO elm = 0;
+    int crossings = 0;
+    auto xpoint = o::zero_vector<3>();
+    const o::Vector<3> orig{2, 2, 2};
+    const o::Vector<3> dest{3, 2, 2};
+    result[0] = walker(elm, orig, dest, 0, crossings, xpoint);
+    result[1] = elm;
+  };
+  o::parallel_for(1, walk, "test_no_exit");
+  const o::HostRead<o::LO> result_h(result);
+  const bool success = result_h[0] == 0 && result_h[1] == 0;
+  if (!success)
+    fprintf(stderr, "[ERROR] walk without an exit returned %d in element %d\n",
+            result_h[0], result_h[1]);
+  return success;
+}
+
 int main(int argc, char** argv) {
   pumipic::Library pic_lib(&argc, &argv);
   Omega_h::Library& lib = pic_lib.omega_h_lib();
@@ -415,6 +443,8 @@ int main(int argc, char** argv) {
            typeid (Kokkos::DefaultHostExecutionSpace).name());
     printTimerResolution();
   }
+  if (!testNoExit(lib))
+    return EXIT_FAILURE;
   auto full_mesh = readMesh(argv[1], lib);
   Omega_h::HostWrite<Omega_h::LO> host_owners(full_mesh.nelems());
   if (comm_size > 1) {
@@ -98,23 +98,8 @@ void tagParentElements(p::Mesh& picparts, PS* ptcls, int loop) {
   mesh->set_tag(o::FACE, "has_particles", ehp_nm0_r);
 }
 
-void updatePtclPositions(PS* ptcls) {
-  auto x_ps_d = ptcls->get<0>();
-  auto xtgt_ps_d = ptcls->get<1>();
-  auto updatePtclPos = PS_LAMBDA(const int&, const int& pid, const bool&) {
-    x_ps_d(pid,0) = xtgt_ps_d(pid,0);
-    x_ps_d(pid,1) = xtgt_ps_d(pid,1);
-    x_ps_d(pid,2) = xtgt_ps_d(pid,2);
-    xtgt_ps_d(pid,0) = 0;
-    xtgt_ps_d(pid,1) = 0;
-    xtgt_ps_d(pid,2) = 0;
-  };
-  ps::parallel_for(ptcls, updatePtclPos);
-}
-
-void rebuild(p::Mesh& picparts, PS* ptcls, o::LOs elem_ids, const bool output) {
-  updatePtclPositions(ptcls);
-  const int ps_capacity = ptcls->capacity();
+void rebuild(p::Mesh& picparts, PS* ptcls, o::LOs elem_ids, PS::kkLidView ps_elem_ids,
+             PS::kkLidView ps_process_ids, const bool output) {
   auto ids = ptcls->get<2>();
   auto printElmIds = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
     if(output && mask > 0)
@@ -122,24 +107,8 @@ void rebuild(p::Mesh& picparts, PS* ptcls, o::LOs elem_ids, const bool output) {
   };
   ps::parallel_for(ptcls, printElmIds);
 
-  PS::kkLidView ps_elem_ids("ps_elem_ids", ps_capacity);
-  PS::kkLidView ps_process_ids("ps_process_ids", ps_capacity);
-  Omega_h::LOs is_safe = picparts.safeTag();
-  Omega_h::LOs elm_owners = picparts.entOwners(picparts.dim());
   int comm_rank;
   MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
-  auto lamb = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
-    if (mask) {
-      int new_elem = elem_ids[pid];
-      ps_elem_ids(pid) = new_elem;
-      ps_process_ids(pid) = comm_rank;
-      if (new_elem != -1 && is_safe[new_elem] == 0) {
-        ps_process_ids(pid) = elm_owners[new_elem];
-      }
-    }
-  };
-  ps::parallel_for(ptcls, lamb);
-
   ptcls->migrate(ps_elem_ids, ps_process_ids);
 
   ids = ptcls->get<2>();
@@ -152,7 +121,7 @@ void rebuild(p::Mesh& picparts, PS* ptcls, o::LOs elem_ids, const bool output) {
   }
 }
 
-void search(p::Mesh& picparts, PS* ptcls, bool output) {
+void search(p::Mesh& picparts, p::SearchContext& searchContext, PS* ptcls, bool output) {
   int comm_rank;
   MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
   o::Mesh* mesh = picparts.mesh();
@@ -163,10 +132,15 @@ void search(p::Mesh& picparts, PS* ptcls, bool output) {
   auto x = ptcls->get<0>();
   auto xtgt = ptcls->get<1>();
   auto pid = ptcls->get<2>();
-  bool isFound = p::search_mesh_2d(*mesh, ptcls, x, xtgt, pid, elem_ids, maxLoops);
+  //the search sets the migrate inputs and moves particles to their targets
+  PS::kkLidView ps_elem_ids("ps_elem_ids", psCapacity);
+  PS::kkLidView ps_process_ids("ps_process_ids", psCapacity);
+  p::MigrateTargets targets(picparts, ps_elem_ids, ps_process_ids, x, xtgt);
+  bool isFound = p::search_mesh_2d(searchContext, ptcls, x, xtgt, pid, elem_ids, maxLoops,
+                                   targets);
   assert(isFound);
   //rebuild the PS to set the new element-to-particle lists
-  rebuild(picparts, ptcls, elem_ids, output);
+  rebuild(picparts, ptcls, elem_ids, ps_elem_ids, ps_process_ids, output);
 }
 
 void setPtclIds(PS* ptcls) {
@@ -494,6 +468,8 @@ int main(int argc, char** argv) {
     particle_structs::enable_prebarrier();
     pumipic_enable_prebarrier();
   }
+  //mesh adjacency used by every search
+  p::SearchContext searchContext(picparts);
   Kokkos::Timer timer;
   Kokkos::Timer fullTimer;
   int iter;
@@ -516,7 +492,7 @@ int main(int argc, char** argv) {
     ellipticalPush::push(ptcls, *mesh, degPerPush, iter);
     MPI_Barrier(MPI_COMM_WORLD);
     timer.reset();
-    search(picparts,ptcls, output);
+    search(picparts, searchContext, ptcls, output);
     ps_np = ptcls->nPtcls();
     MPI_Allreduce(&ps_np, &totNp, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
     if(totNp == 0) {
@@ -101,6 +101,18 @@ void search(p::Mesh& picparts, PS* ptcls, bool output=false) {
   bool isFound = p::search_mesh_2d(*mesh, ptcls, x, xtgt, pid, elem_ids, maxLoops);
   fprintf(stderr, "search_mesh (seconds) %f\n", timer.seconds());
   assert(isFound);
+  //the float first barycentric tests must find the same elements
+  p::SearchContext mixedSearch(*mesh);
+  mixedSearch.setMixedPrecision(true);
+  mixedSearch.enableStatistics();
+  o::Write<o::LO> mixed_elem_ids(psCapacity,-1);
+  timer.reset();
+  isFound = p::search_mesh_2d(mixedSearch, ptcls, x, xtgt, pid, mixed_elem_ids, maxLoops);
+  fprintf(stderr, "mixed precision search_mesh (seconds) %f\n", timer.seconds());
+  assert(isFound);
+  assert(o::LOs(elem_ids) == o::LOs(mixed_elem_ids));
+  //every particle is binned once by its number of crossings
+  assert(o::get_sum(mixedSearch.crossingHistogram()) == ptcls->nPtcls());
   //rebuild the PS to set the new element-to-particle lists
   timer.reset();
   rebuild(picparts, ptcls, elem_ids, output);
@@ -337,6 +349,82 @@ void testItg24k(Omega_h::Library& lib, std::string meshDir) {
   }
 }
 
+//A search with holes in the particle structure must not resume the unfinished particles
+//  of the previous search whose slots are now empty
+void testSearchWithHoles(Omega_h::Library& lib, std::string meshDir) {
+  const auto meshName = meshDir+"/plate/tri8_parDiag.osh";
+  auto full_mesh = readMesh(meshName.c_str(), lib);
+  Omega_h::Write<Omega_h::LO> owner(full_mesh.nelems(), 0);
+  pumipic::Input input(full_mesh, pumipic::Input::PARTITION, owner, pumipic::Input::FULL,
+                       pumipic::Input::BFS);
+  p::Mesh picparts(input);
+  o::Mesh* mesh = picparts.mesh();
+  Omega_h::GOs mesh_element_gids = picparts.globalIds(picparts.dim());
+  const auto ne = mesh->nelems();
+  const int ppe = 4;
+  PS::kkLidView ptcls_per_elem("ptcls_per_elem", ne);
+  PS::kkGidView element_gids("element_gids", ne);
+  Omega_h::parallel_for(ne, OMEGA_H_LAMBDA(const int& i) {
+    element_gids(i) = mesh_element_gids[i];
+    ptcls_per_elem(i) = ppe;
+  });
+  Kokkos::TeamPolicy<Kokkos::DefaultExecutionSpace> policy(10000, 32);
+  SellCSigma<Particle>* scs = new SellCSigma<Particle>(policy, INT_MAX, 32, ne, ne * ppe,
+                                                       ptcls_per_elem, element_gids);
+  scs->setSkipEmpty(true, true);
+  PS* ptcls = scs;
+  setPtclIds(ptcls);
+
+  //every particle starts at the centroid of its element and moves to the top left corner
+  const auto faces2verts = mesh->ask_elem_verts();
+  const auto coords = mesh->coords();
+  auto x = ptcls->get<0>();
+  auto xtgt = ptcls->get<1>();
+  auto setPositions = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask) {
+      const auto faceCoords = o::gather_vectors<3,2>(coords, o::gather_verts<3>(faces2verts, e));
+      for(int i = 0; i < 2; ++i) {
+        x(pid,i) = (faceCoords[0][i] + faceCoords[1][i] + faceCoords[2][i]) / 3;
+        xtgt(pid,i) = i == 0 ? 0.05 : 0.95;
+      }
+    }
+  };
+  ps::parallel_for(ptcls, setPositions);
+  p::SearchContext search(*mesh);
+  o::Write<o::LO> elem_ids(ptcls->capacity(), -1);
+  //one crossing is not enough for the particles far from the corner
+  bool isFound = p::search_mesh_2d(search, ptcls, x, xtgt, ptcls->get<2>(), elem_ids, 1);
+  assert(!isFound);
+
+  //only the particles of element 0 are kept, the slots of the unfinished ones are holes
+  PS::kkLidView new_elems("new_elems", ptcls->capacity());
+  auto removeOthers = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    new_elems(pid) = (mask && e == 0) ? 0 : -1;
+  };
+  ps::parallel_for(ptcls, removeOthers);
+  ptcls->rebuild(new_elems);
+  assert(ptcls->nPtcls() == ppe);
+
+  //the kept particles stay in element 0
+  x = ptcls->get<0>();
+  xtgt = ptcls->get<1>();
+  auto stay = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask)
+      for(int i = 0; i < 2; ++i)
+        xtgt(pid,i) = x(pid,i);
+  };
+  ps::parallel_for(ptcls, stay);
+  elem_ids = o::Write<o::LO>(ptcls->capacity(), -1);
+  isFound = p::search_mesh_2d(search, ptcls, x, xtgt, ptcls->get<2>(), elem_ids, 100);
+  assert(isFound);
+  o::LOs found_elems(elem_ids);
+  auto checkElems = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    assert(found_elems[pid] == (mask ? 0 : -1));
+  };
+  ps::parallel_for(ptcls, checkElems);
+  delete scs;
+}
+
 int main(int argc, char** argv) {
   pumipic::Library pic_lib(&argc, &argv);
   Omega_h::Library& lib = pic_lib.omega_h_lib();
@@ -349,6 +437,7 @@ int main(int argc, char** argv) {
   std::string meshDir(argv[1]);
   testTri8(lib,meshDir);
   testItg24k(lib,meshDir);
+  testSearchWithHoles(lib,meshDir);
   if (!comm_rank)
     fprintf(stderr, "done\n");
   return 0;
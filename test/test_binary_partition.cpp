@@ -0,0 +1,43 @@
+#include <Omega_h_file.hpp>  //gmsh
+#include <pumipic_mesh.hpp>
+
+//Picparts built from a text partition and its binary conversion must be identical
+int main(int argc, char** argv) {
+  pumipic::Library pic_lib(&argc, &argv);
+  Omega_h::Library& lib = pic_lib.omega_h_lib();
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  if (argc != 4) {
+    if (!rank)
+      fprintf(stderr, "Usage: %s <mesh> <text partition> <binary partition>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  //**********Load the mesh in serial everywhere*************//
+  Omega_h::Mesh mesh = Omega_h::read_mesh_file(argv[1], lib.self());
+  int dim = mesh.dim();
+
+  pumipic::Input text_input(mesh, argv[2], pumipic::Input::BFS, pumipic::Input::BFS);
+  pumipic::Input binary_input(mesh, argv[3], pumipic::Input::BFS, pumipic::Input::BFS);
+  pumipic::Mesh text_picparts(text_input);
+  pumipic::Mesh binary_picparts(binary_input);
+
+  int fail = 0;
+  for (int i = 0; i <= dim; ++i) {
+    if (text_picparts.nents(i) != binary_picparts.nents(i)) {
+      fprintf(stderr, "Entity counts of dimension %d differ on rank %d\n", i, rank);
+      ++fail;
+      continue;
+    }
+    Omega_h::HostRead<Omega_h::LO> text_owners(text_picparts.entOwners(i));
+    Omega_h::HostRead<Omega_h::LO> binary_owners(binary_picparts.entOwners(i));
+    for (int j = 0; j < text_owners.size(); ++j) {
+      if (text_owners[j] != binary_owners[j]) {
+        fprintf(stderr, "Owners of dimension %d differ on rank %d\n", i, rank);
+        ++fail;
+        break;
+      }
+    }
+  }
+  return fail;
+}
@@ -1,4 +1,5 @@
 #include <fstream>
+#include <vector>
 
 #include <Omega_h_for.hpp>
 #include <Omega_h_file.hpp>
@@ -8,6 +9,102 @@
 
 bool minOwnership(pumipic::Mesh& picparts, int dim);
 bool sumEntities(pumipic::Mesh& picparts, int dim);
+bool batchedReduction(pumipic::Mesh& picparts, int dim);
+bool overlappedReduction(pumipic::Mesh& picparts, int dim);
+bool tagReduction(pumipic::Mesh& picparts, int dim);
+bool batchedReduction(pumipic::Mesh& picparts, int dim) {
+  //Reduce an owner min and a two entry occurrence sum together and compare to separate calls
+  int rank = picparts.comm()->rank();
+  Omega_h::LOs owners = picparts.entOwners(dim);
+  Omega_h::Write<Omega_h::LO> owner_comm = picparts.createCommArray(dim, 1, INT_MAX);
+  auto setOwned = OMEGA_H_LAMBDA(Omega_h::LO id) {
+    if (owners[id] == rank)
+      owner_comm[id] = rank;
+  };
+  Omega_h::parallel_for(picparts.nents(dim), setOwned, "setOwned");
+  Omega_h::Write<Omega_h::LO> sum_comm = picparts.createCommArray(dim, 2, 1);
+  Omega_h::Write<Omega_h::LO> expected_sum = picparts.createCommArray(dim, 1, 1);
+  picparts.reduceCommArray(dim, pumipic::Mesh::SUM_OP, expected_sum);
+
+  std::vector<pumipic::Mesh::Op> ops;
+  ops.push_back(pumipic::Mesh::MIN_OP);
+  ops.push_back(pumipic::Mesh::SUM_OP);
+  std::vector<Omega_h::Write<Omega_h::LO> > arrays;
+  arrays.push_back(owner_comm);
+  arrays.push_back(sum_comm);
+  picparts.reduceCommArrays(dim, ops, arrays);
+
+  Omega_h::Write<Omega_h::LO> fail(1, 0);
+  auto checkEnts = OMEGA_H_LAMBDA(Omega_h::LO id) {
+    if (owner_comm[id] != owners[id])
+      fail[0] = 1;
+    for (int i = 0; i < 2; ++i)
+      if (sum_comm[id*2 + i] != expected_sum[id])
+        fail[0] = 1;
+  };
+  Omega_h::parallel_for(picparts.nents(dim), checkEnts, "checkEnts");
+
+  Omega_h::HostWrite<Omega_h::LO> fail_host(fail);
+  return !fail_host[0];
+}
+
+bool overlappedReduction(pumipic::Mesh& picparts, int dim) {
+  //Two reductions of the same shape in flight together match a blocking reduction
+  Omega_h::Write<Omega_h::LO> expected_sum = picparts.createCommArray(dim, 1, 1);
+  picparts.reduceCommArray(dim, pumipic::Mesh::SUM_OP, expected_sum);
+  Omega_h::Write<Omega_h::LO> sum_a = picparts.createCommArray(dim, 1, 1);
+  Omega_h::Write<Omega_h::LO> sum_b = picparts.createCommArray(dim, 1, 2);
+  pumipic::ReduceHandle<Omega_h::LO> handle_a =
+    picparts.reduceCommArray_begin(dim, pumipic::Mesh::SUM_OP, sum_a);
+  pumipic::ReduceHandle<Omega_h::LO> handle_b =
+    picparts.reduceCommArray_begin(dim, pumipic::Mesh::SUM_OP, sum_b);
+  picparts.reduceCommArray_end(handle_a);
+  picparts.reduceCommArray_end(handle_b);
+
+  Omega_h::Write<Omega_h::LO> fail(1, 0);
+  auto checkEnts = OMEGA_H_LAMBDA(Omega_h::LO id) {
+    if (sum_a[id] != expected_sum[id] || sum_b[id] != 2 * expected_sum[id])
+      fail[0] = 1;
+  };
+  Omega_h::parallel_for(picparts.nents(dim), checkEnts, "checkEnts");
+
+  Omega_h::HostWrite<Omega_h::LO> fail_host(fail);
+  return !fail_host[0];
+}
+
+bool tagReduction(pumipic::Mesh& picparts, int dim) {
+  //Reduce a one entry tag and a two entry tag into one tag, then each tag in place
+  Omega_h::Write<Omega_h::LO> expected_sum = picparts.createCommArray(dim, 1, 1);
+  picparts.reduceCommArray(dim, pumipic::Mesh::SUM_OP, expected_sum);
+  const int ne = picparts.nents(dim);
+  picparts->add_tag(dim, "tag_a", 1, Omega_h::LOs(ne, 1));
+  picparts->add_tag(dim, "tag_b", 2, Omega_h::LOs(2*ne, 2));
+  std::vector<std::string> names;
+  names.push_back("tag_a");
+  names.push_back("tag_b");
+  picparts.reduceTags<Omega_h::LO>(dim, pumipic::Mesh::SUM_OP, names, "tag_ab");
+  picparts.reduceTags<Omega_h::LO>(dim, pumipic::Mesh::SUM_OP, names);
+  Omega_h::LOs tag_ab = picparts->get_array<Omega_h::LO>(dim, "tag_ab");
+  Omega_h::LOs tag_a = picparts->get_array<Omega_h::LO>(dim, "tag_a");
+  Omega_h::LOs tag_b = picparts->get_array<Omega_h::LO>(dim, "tag_b");
+
+  Omega_h::Write<Omega_h::LO> fail(1, 0);
+  auto checkEnts = OMEGA_H_LAMBDA(Omega_h::LO id) {
+    const Omega_h::LO sum = expected_sum[id];
+    if (tag_ab[id*3] != sum || tag_ab[id*3 + 1] != 2*sum || tag_ab[id*3 + 2] != 2*sum)
+      fail[0] = 1;
+    if (tag_a[id] != sum || tag_b[id*2] != 2*sum || tag_b[id*2 + 1] != 2*sum)
+      fail[0] = 1;
+  };
+  Omega_h::parallel_for(ne, checkEnts, "checkEnts");
+  picparts->remove_tag(dim, "tag_a");
+  picparts->remove_tag(dim, "tag_b");
+  picparts->remove_tag(dim, "tag_ab");
+
+  Omega_h::HostWrite<Omega_h::LO> fail_host(fail);
+  return !fail_host[0];
+}
+
 bool fullBufferTest(Omega_h::Mesh& mesh, Omega_h::Write<Omega_h::LO> owner, int dim);
 
 int main(int argc, char** argv) {
@@ -54,6 +151,9 @@ int main(int argc, char** argv) {
   
   //********* Construct the PIC parts *********//
   pumipic::Mesh picparts(mesh, owner, 1, 0);
+  //Communication information is only built by the first reduction of each dimension
+  if (picparts.memoryUsage()["comm_array_index"] != 0)
+    fprintf(stderr, "Communication was built during construction on rank %d\n", rank);
 
   for (int i = 0; i <= picparts.dim(); ++i) {
     if (!minOwnership(picparts, i))
@@ -69,6 +169,17 @@ int main(int argc, char** argv) {
 
   MPI_Barrier(MPI_COMM_WORLD);
 
+  for (int i = 0; i <= picparts.dim(); ++i) {
+    if (!batchedReduction(picparts, i))
+      printf("batchedReduction on dimension %d failed on rank %d\n", i, rank);
+    if (!overlappedReduction(picparts, i))
+      printf("overlappedReduction on dimension %d failed on rank %d\n", i, rank);
+    if (!tagReduction(picparts, i))
+      printf("tagReduction on dimension %d failed on rank %d\n", i, rank);
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+
   Omega_h::Write<Omega_h::Real> max_comm = picparts.createCommArray(0, 1, 0.0);
   auto setLIDVtx = OMEGA_H_LAMBDA(Omega_h::LO vtx_id) {
     max_comm[vtx_id] = vtx_id;
@@ -87,6 +198,8 @@ int main(int argc, char** argv) {
   if (fail_host[0]) {
     fprintf(stderr, "Max reduce failed on %d\n", rank);
   }
+  if (picparts.memoryUsage()["comm_array_index"] == 0)
+    fprintf(stderr, "Communication was not built by the reductions on rank %d\n", rank);
   MPI_Barrier(MPI_COMM_WORLD);
 
   //Create an array with initial values of 0
@@ -195,6 +308,17 @@ bool fullBufferTest(Omega_h::Mesh& mesh, Omega_h::Write<Omega_h::LO> owner, int
   };
   Omega_h::parallel_for(picparts.mesh()->nents(dim), checkCommArr);
 
+  //Reduce scatter of the owned entities followed by an allgather
+  picparts.setFullReduceMode(pumipic::Mesh::SCATTER_FULL_REDUCE);
+  Omega_h::Write<Omega_h::Real> scatter_arr = picparts.createCommArray(dim, 2, 1.0);
+  picparts.reduceCommArray(dim, pumipic::Mesh::SUM_OP, scatter_arr);
+  auto checkScatterArr = OMEGA_H_LAMBDA(const Omega_h::LO& id) {
+    for (int i = 0; i < 2; ++i)
+      if (scatter_arr[id*2 + i] != comm_size)
+        fail[0] = 1;
+  };
+  Omega_h::parallel_for(picparts.mesh()->nents(dim), checkScatterArr);
+
   Omega_h::HostWrite<Omega_h::LO> fail_host(fail);
   if (fail_host[0]) {
     return false;
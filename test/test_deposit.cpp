@@ -0,0 +1,122 @@
+#include <Omega_h_mesh.hpp>
+#include <Omega_h_array_ops.hpp>
+#include <Omega_h_file.hpp>
+#include "pumipic_kktypes.hpp"
+#include <particle_structs.hpp>
+#include <Kokkos_Core.hpp>
+#include "pumipic_mesh.hpp"
+#include "pumipic_deposit.hpp"
+
+using particle_structs::SellCSigma;
+using particle_structs::MemberTypes;
+using pumipic::Vector3d;
+
+namespace o = Omega_h;
+namespace p = pumipic;
+
+o::Mesh readMesh(const char* meshFile, o::Library& lib) {
+  std::string fn(meshFile);
+  auto ext = fn.substr(fn.find_last_of(".") + 1);
+  if( ext == "msh") {
+    std::cout << "reading gmsh mesh " << meshFile << "\n";
+    return Omega_h::gmsh::read(meshFile, lib.self());
+  } else if( ext == "osh" ) {
+    std::cout << "reading omegah mesh " << meshFile << "\n";
+    return Omega_h::binary::read(meshFile, lib.self());
+  } else {
+    std::cout << "error: unrecognized mesh extension \'" << ext << "\'\n";
+    exit(EXIT_FAILURE);
+  }
+}
+
+//Particles with a position and a weight for the deposition
+typedef MemberTypes<Vector3d, double> WeightedParticle;
+
+void testDeposit(Omega_h::Library& lib, std::string meshDir) {
+  const auto meshName = meshDir+"/plate/tri8_parDiag.osh";
+  auto full_mesh = readMesh(meshName.c_str(), lib);
+  Omega_h::Write<Omega_h::LO> owner(full_mesh.nelems(), 0);
+  pumipic::Input input(full_mesh, pumipic::Input::PARTITION, owner, pumipic::Input::FULL,
+                       pumipic::Input::BFS);
+  p::Mesh picparts(input);
+  o::Mesh* mesh = picparts.mesh();
+  Omega_h::GOs mesh_element_gids = picparts.globalIds(picparts.dim());
+  const auto ne = mesh->nelems();
+  const int ppe = 3;
+  ps::ParticleStructure<WeightedParticle>::kkLidView ptcls_per_elem("ptcls_per_elem", ne);
+  ps::ParticleStructure<WeightedParticle>::kkGidView element_gids("element_gids", ne);
+  Omega_h::parallel_for(ne, OMEGA_H_LAMBDA(const int& i) {
+    element_gids(i) = mesh_element_gids[i];
+    ptcls_per_elem(i) = ppe;
+  });
+  Kokkos::TeamPolicy<Kokkos::DefaultExecutionSpace> policy(10000, 32);
+  SellCSigma<WeightedParticle>* ptcls =
+    new SellCSigma<WeightedParticle>(policy, INT_MAX, 32, ne, ne * ppe, ptcls_per_elem,
+                                     element_gids);
+
+  //particles sit between the centroid and the first vertex of their element
+  const auto faces2verts = mesh->ask_elem_verts();
+  const auto coords = mesh->coords();
+  auto x = ptcls->get<0>();
+  auto w = ptcls->get<1>();
+  auto setParticles = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask) {
+      const auto faceCoords = o::gather_vectors<3,2>(coords, o::gather_verts<3>(faces2verts, e));
+      for(int i = 0; i < 2; ++i)
+        x(pid,i) = ((faceCoords[0][i] + faceCoords[1][i] + faceCoords[2][i]) / 3 +
+                    faceCoords[0][i]) / 2;
+      x(pid,2) = 0;
+      w(pid) = 1 + pid % 2;
+    }
+  };
+  ps::parallel_for(ptcls, setParticles);
+  o::Write<o::Real> weights(1, 0);
+  auto sumWeights = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask)
+      Kokkos::atomic_fetch_add(&(weights[0]), w(pid));
+  };
+  ps::parallel_for(ptcls, sumWeights);
+  const o::Real total = o::HostRead<o::Real>(o::Reals(weights))[0];
+
+  //every engine deposits the same vertex values, which sum to the total weight
+  const p::DepositEngine engines[3] = {p::DEPOSIT_ATOMIC, p::DEPOSIT_TEAM, p::DEPOSIT_SORTED};
+  const p::DepositOrder orders[2] = {p::DEPOSIT_ORDER_ELEMENT, p::DEPOSIT_ORDER_LINEAR};
+  for (int i = 0; i < 2; ++i) {
+    o::Reals reference = p::deposit<0, 1>(picparts, ptcls, orders[i], engines[0]);
+    const o::Real sum = o::get_sum(reference);
+    if (fabs(sum - total) > 1e-10 * total) {
+      fprintf(stderr, "Deposit of order %d sums to %f instead of %f\n", orders[i], sum, total);
+      exit(EXIT_FAILURE);
+    }
+    for (int j = 1; j < 3; ++j) {
+      o::Reals values = p::deposit<0, 1>(picparts, ptcls, orders[i], engines[j]);
+      o::Write<o::Real> differences(values.size());
+      o::parallel_for(values.size(), OMEGA_H_LAMBDA(const o::LO& v) {
+        differences[v] = fabs(values[v] - reference[v]);
+      });
+      const o::Real diff = o::get_max(o::Reals(differences));
+      if (diff > 1e-10) {
+        fprintf(stderr, "Deposit engine %d of order %d differs from atomics by %e\n",
+                engines[j], orders[i], diff);
+        exit(EXIT_FAILURE);
+      }
+    }
+  }
+  delete ptcls;
+}
+
+int main(int argc, char** argv) {
+  pumipic::Library pic_lib(&argc, &argv);
+  Omega_h::Library& lib = pic_lib.omega_h_lib();
+  int comm_rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+  if( argc != 2 ) {
+    std::cout << "Usage: " << argv[0] << " <testMeshDir>\n";
+    exit(1);
+  }
+  std::string meshDir(argv[1]);
+  testDeposit(lib,meshDir);
+  if (!comm_rank)
+    fprintf(stderr, "done\n");
+  return 0;
+}
@@ -0,0 +1,108 @@
+#include <climits>
+#include <vector>
+#include <Omega_h_file.hpp>  //gmsh
+#include <Omega_h_for.hpp>
+#include <pumipic_mesh.hpp>
+
+//Counts of the picpart's entities owned by each process
+std::vector<int> ownerCounts(pumipic::Mesh& picparts, int dim, int comm_size) {
+  std::vector<int> counts(comm_size, 0);
+  Omega_h::HostRead<Omega_h::LO> owners(picparts.entOwners(dim));
+  for (int i = 0; i < owners.size(); ++i)
+    ++counts[owners[i]];
+  return counts;
+}
+
+/* Picparts built from a distributed mesh must match the picparts built from the serial mesh
+   with the same partition */
+int main(int argc, char** argv) {
+  pumipic::Library pic_lib(&argc, &argv);
+  Omega_h::Library& lib = pic_lib.omega_h_lib();
+  Omega_h::CommPtr world = lib.world();
+  int rank = world->rank();
+  int comm_size = world->size();
+  if (argc != 2) {
+    if (!rank)
+      fprintf(stderr, "Usage: %s <mesh>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  //**********Distribute the mesh read on rank 0*************//
+  Omega_h::Mesh serial = Omega_h::read_mesh_file(argv[1], lib.self());
+  int dim = serial.dim();
+  Omega_h::Mesh mesh(&lib);
+  if (!rank) {
+    mesh = serial;
+    mesh.add_tag(dim, "serial_id", 1, Omega_h::LOs(mesh.nelems(), 0, 1));
+  }
+  mesh.set_comm(world);
+  mesh.balance();
+
+  //Partition of the serial mesh from where each element was balanced to
+  Omega_h::HostRead<Omega_h::LO> serial_ids(mesh.get_array<Omega_h::LO>(dim, "serial_id"));
+  int nlocal = serial_ids.size();
+  std::vector<int> counts(comm_size), displs(comm_size + 1, 0);
+  MPI_Allgather(&nlocal, 1, MPI_INT, counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+  for (int i = 0; i < comm_size; ++i)
+    displs[i + 1] = displs[i] + counts[i];
+  std::vector<int> ids(displs[comm_size]);
+  MPI_Allgatherv(const_cast<int*>(serial_ids.data()), nlocal, MPI_INT, ids.data(),
+                 counts.data(), displs.data(), MPI_INT, MPI_COMM_WORLD);
+  Omega_h::HostWrite<Omega_h::LO> host_owners(serial.nelems());
+  for (int i = 0; i < comm_size; ++i)
+    for (int j = displs[i]; j < displs[i + 1]; ++j)
+      host_owners[ids[j]] = i;
+
+  pumipic::Input serial_input(serial, pumipic::Input::PARTITION, host_owners.write(),
+                              pumipic::Input::BFS, pumipic::Input::BFS);
+  pumipic::Input distributed_input(mesh, pumipic::Input::BFS, pumipic::Input::BFS);
+  pumipic::Mesh serial_picparts(serial_input);
+  pumipic::Mesh distributed_picparts(distributed_input);
+  //Build every dimension of one together, the other builds each on first use
+  distributed_picparts.buildComm();
+
+  int fail = 0;
+  for (int i = 0; i <= dim; ++i) {
+    if (serial_picparts.nents(i) != distributed_picparts.nents(i) ||
+        ownerCounts(serial_picparts, i, comm_size) !=
+        ownerCounts(distributed_picparts, i, comm_size)) {
+      fprintf(stderr, "Entities of dimension %d differ on rank %d\n", i, rank);
+      ++fail;
+    }
+    if (serial_picparts.numBuffers(i) != distributed_picparts.numBuffers(i)) {
+      fprintf(stderr, "Buffered parts of dimension %d differ on rank %d\n", i, rank);
+      ++fail;
+    }
+
+    //Reducing the owner of each entity must give back the owner
+    Omega_h::Write<Omega_h::LO> owner_comm = distributed_picparts.createCommArray(i, 1, INT_MAX);
+    Omega_h::LOs owners = distributed_picparts.entOwners(i);
+    auto setOwned = OMEGA_H_LAMBDA(Omega_h::LO id) {
+      if (owners[id] == rank)
+        owner_comm[id] = rank;
+    };
+    Omega_h::parallel_for(owners.size(), setOwned, "setOwned");
+    distributed_picparts.reduceCommArray(i, pumipic::Mesh::MIN_OP, owner_comm);
+    Omega_h::HostRead<Omega_h::LO> owner_comm_h(Omega_h::LOs(owner_comm));
+    Omega_h::HostRead<Omega_h::LO> owners_h(owners);
+    for (int j = 0; j < owners_h.size(); ++j) {
+      if (owner_comm_h[j] != owners_h[j]) {
+        fprintf(stderr, "Owner reduction of dimension %d failed on rank %d\n", i, rank);
+        ++fail;
+        break;
+      }
+    }
+  }
+  int safe_serial = 0, safe_distributed = 0;
+  Omega_h::HostRead<Omega_h::LO> serial_safe(serial_picparts.safeTag());
+  Omega_h::HostRead<Omega_h::LO> distributed_safe(distributed_picparts.safeTag());
+  for (int i = 0; i < serial_safe.size(); ++i)
+    safe_serial += serial_safe[i];
+  for (int i = 0; i < distributed_safe.size(); ++i)
+    safe_distributed += distributed_safe[i];
+  if (safe_serial != safe_distributed) {
+    fprintf(stderr, "Safe elements differ on rank %d\n", rank);
+    ++fail;
+  }
+  return fail;
+}
@@ -53,6 +53,54 @@ int main(int argc, char** argv) {
     }
   }
 
+  //Node shared arrays keep the values of the private ones
+  Omega_h::HostRead<Omega_h::GO> gids(picparts.globalIds(dim));
+  Omega_h::HostRead<Omega_h::LO> index_h(picparts.commArrayIndex(dim));
+  Omega_h::HostRead<Omega_h::Real> coords(picparts.mesh()->coords());
+  picparts.shareNodeArrays();
+  Omega_h::HostRead<Omega_h::GO> shared_gids(picparts.globalIds(dim));
+  Omega_h::HostRead<Omega_h::LO> shared_index(picparts.commArrayIndex(dim));
+  for (int i = 0; i < gids.size(); ++i) {
+    if (gids[i] != shared_gids[i] || index_h[i] != shared_index[i]) {
+      fprintf(stderr, "Node shared arrays differ on process %d\n", rank);
+      return EXIT_FAILURE;
+    }
+  }
+  Omega_h::HostRead<Omega_h::Real> shared_coords(picparts.mesh()->coords());
+  for (int i = 0; i < coords.size(); ++i) {
+    if (coords[i] != shared_coords[i]) {
+      fprintf(stderr, "Node shared coordinates differ on process %d\n", rank);
+      return EXIT_FAILURE;
+    }
+  }
+
+  //One process of each node holds one copy of every shared array
+  std::size_t copy_bytes = picparts.mesh()->coords().size() * sizeof(Omega_h::Real);
+  for (int i = 0; i <= dim; ++i) {
+    const std::size_t nents = picparts.mesh()->nents(i);
+    copy_bytes += nents * (sizeof(Omega_h::GO) + sizeof(Omega_h::LO)) +
+      picparts.commArrayIndex(i).size() * sizeof(Omega_h::LO) +
+      picparts.nentsOffsets(i).size() * sizeof(Omega_h::LO);
+    if (picparts.mesh()->has_tag(i, "class_id"))
+      copy_bytes += nents * sizeof(Omega_h::ClassId);
+    if (picparts.mesh()->has_tag(i, "class_dim"))
+      copy_bytes += nents * sizeof(Omega_h::I8);
+  }
+  MPI_Comm node_comm;
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+  const long long allocated = picparts.memoryUsage()["node_shared_windows"];
+  long long node_allocated, max_allocated;
+  MPI_Allreduce(&allocated, &node_allocated, 1, MPI_LONG_LONG, MPI_SUM, node_comm);
+  MPI_Allreduce(&allocated, &max_allocated, 1, MPI_LONG_LONG, MPI_MAX, node_comm);
+  MPI_Comm_free(&node_comm);
+#ifndef PS_USE_CUDA
+  if (node_allocated != (long long)copy_bytes || max_allocated != node_allocated) {
+    fprintf(stderr, "Process %d: node shared windows hold %lld bytes (%lld on one process) "
+            "instead of %zu\n", rank, node_allocated, max_allocated, copy_bytes);
+    return EXIT_FAILURE;
+  }
+#endif
+
   char vtk_name[100];
   sprintf(vtk_name, "picpart%d", rank);
   Omega_h::vtk::write_parallel(vtk_name, picparts.mesh(), dim);
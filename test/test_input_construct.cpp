@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <fstream>
+#include <map>
+#include <vector>
 
 #include <Omega_h_file.hpp>  //gmsh
 #include <pumipic_mesh.hpp>
@@ -7,6 +10,10 @@
 bool constructFullBFS(Omega_h::Mesh&, char* partition_file);
 bool constructMinNone(Omega_h::Mesh&, char* partition_file);
 bool constructClassMinBFS(Omega_h::Mesh&, char* class_file);
+bool constructCached(Omega_h::Mesh&, char* partition_file);
+bool constructReordered(Omega_h::Mesh&, char* partition_file);
+bool constructBalanced(Omega_h::Mesh&, char* partition_file);
+bool checkBufferDistance(pumipic::Mesh& picparts, int layers);
 
 int main(int argc, char** argv) {
   pumipic::Library pic_lib(&argc, &argv);
@@ -37,6 +44,18 @@ int main(int argc, char** argv) {
     fprintf(stderr, "constructMinNone failed on rank %d\n",rank);
     ++fail;
   }
+  if (!constructCached(mesh, argv[2])) {
+    fprintf(stderr, "constructCached failed on rank %d\n",rank);
+    ++fail;
+  }
+  if (!constructReordered(mesh, argv[2])) {
+    fprintf(stderr, "constructReordered failed on rank %d\n",rank);
+    ++fail;
+  }
+  if (!constructBalanced(mesh, argv[2])) {
+    fprintf(stderr, "constructBalanced failed on rank %d\n",rank);
+    ++fail;
+  }
   if (argc >= 4 && !constructClassMinBFS(mesh, argv[3])) {
     fprintf(stderr, "constructClassMinBFS failed on rank %d\n",rank);
     ++fail;
@@ -77,6 +96,11 @@ bool constructFullBFS(Omega_h::Mesh& mesh, char* partition_file) {
     if (picparts.nents(i) != mesh.nents(i))
       return false;
   }
+  //The full mesh has no buffer edge
+  Omega_h::HostRead<Omega_h::LO> distance(picparts.bufferDistance());
+  for (int i = 0; i < distance.size(); ++i)
+    if (distance[i] != -1)
+      return false;
   return true;
 }
 bool constructMinNone(Omega_h::Mesh& mesh, char* partition_file) {
@@ -155,3 +179,159 @@ bool constructClassMinBFS(Omega_h::Mesh& mesh, char* class_file) {
   return true;
 
 }
+
+bool constructCached(Omega_h::Mesh& mesh, char* partition_file) {
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  pumipic::Input input(mesh, partition_file, pumipic::Input::BFS, pumipic::Input::BFS);
+  pumipic::Mesh picparts(input);
+
+  //The first cached construction writes the cache, the second loads it
+  input.cache_directory = ".";
+  for (int run = 0; run < 2; ++run) {
+    pumipic::Mesh cached(input);
+    if (cached.isFullMesh() != picparts.isFullMesh())
+      return false;
+    for (int i = 0; i <= mesh.dim(); ++i) {
+      if (cached.nents(i) != picparts.nents(i) || cached.numBuffers(i) != picparts.numBuffers(i))
+        return false;
+      Omega_h::HostRead<Omega_h::GO> gids(picparts.globalIds(i));
+      Omega_h::HostRead<Omega_h::GO> cached_gids(cached.globalIds(i));
+      Omega_h::HostRead<Omega_h::LO> index(picparts.commArrayIndex(i));
+      Omega_h::HostRead<Omega_h::LO> cached_index(cached.commArrayIndex(i));
+      for (int j = 0; j < gids.size(); ++j)
+        if (gids[j] != cached_gids[j] || index[j] != cached_index[j])
+          return false;
+      //Reductions over the cached picparts match the constructed ones
+      Omega_h::Write<Omega_h::LO> sums = picparts.createCommArray(i, 1, 1);
+      Omega_h::Write<Omega_h::LO> cached_sums = cached.createCommArray(i, 1, 1);
+      picparts.reduceCommArray(i, pumipic::Mesh::SUM_OP, sums);
+      cached.reduceCommArray(i, pumipic::Mesh::SUM_OP, cached_sums);
+      Omega_h::HostRead<Omega_h::LO> sums_h(Omega_h::LOs(sums));
+      Omega_h::HostRead<Omega_h::LO> cached_sums_h(Omega_h::LOs(cached_sums));
+      for (int j = 0; j < sums_h.size(); ++j)
+        if (sums_h[j] != cached_sums_h[j])
+          return false;
+    }
+  }
+  return true;
+}
+
+bool constructReordered(Omega_h::Mesh& mesh, char* partition_file) {
+  pumipic::Input input(mesh, partition_file, pumipic::Input::BFS, pumipic::Input::BFS);
+  pumipic::Mesh picparts(input);
+  input.reorder_elements = true;
+  pumipic::Mesh reordered(input);
+  const int dim = mesh.dim();
+  if (reordered.nelems() != picparts.nelems())
+    return false;
+  if (!checkBufferDistance(picparts, input.bufferBFSLayers))
+    return false;
+
+  //Elements of the same global id keep their safe tag and comm array value
+  Omega_h::Write<Omega_h::LO> sums = picparts.createCommArray(dim, 1, 1);
+  Omega_h::Write<Omega_h::LO> reordered_sums = reordered.createCommArray(dim, 1, 1);
+  picparts.reduceCommArray(dim, pumipic::Mesh::SUM_OP, sums);
+  reordered.reduceCommArray(dim, pumipic::Mesh::SUM_OP, reordered_sums);
+  std::map<Omega_h::GO, std::pair<int, int> > elems;
+  Omega_h::HostRead<Omega_h::GO> gids(picparts.globalIds(dim));
+  Omega_h::HostRead<Omega_h::LO> safe(picparts.safeTag());
+  Omega_h::HostRead<Omega_h::LO> sums_h(Omega_h::LOs(sums));
+  for (int i = 0; i < gids.size(); ++i)
+    elems[gids[i]] = std::make_pair(safe[i], sums_h[i]);
+  Omega_h::HostRead<Omega_h::GO> reordered_gids(reordered.globalIds(dim));
+  Omega_h::HostRead<Omega_h::LO> reordered_safe(reordered.safeTag());
+  Omega_h::HostRead<Omega_h::LO> reordered_sums_h(Omega_h::LOs(reordered_sums));
+  for (int i = 0; i < reordered_gids.size(); ++i) {
+    std::map<Omega_h::GO, std::pair<int, int> >::iterator itr = elems.find(reordered_gids[i]);
+    if (itr == elems.end() || itr->second != std::make_pair(reordered_safe[i],
+                                                           reordered_sums_h[i]))
+      return false;
+  }
+
+  //The global id index of the picparts finds the element of each reordered element
+  pumipic::GlobalIdIndex index = picparts.globalIdIndex(dim);
+  Omega_h::GOs picpart_gids = picparts.globalIds(dim);
+  Omega_h::GOs elem_gids = reordered.globalIds(dim);
+  Omega_h::Write<Omega_h::LO> fail(1, 0);
+  auto checkIndex = OMEGA_H_LAMBDA(Omega_h::LO id) {
+    const Omega_h::LO lid = index.find(elem_gids[id]);
+    if (lid < 0 || picpart_gids[lid] != elem_gids[id] || index.find(-1 - id) != -1)
+      fail[0] = 1;
+  };
+  Omega_h::parallel_for(elem_gids.size(), checkIndex, "checkIndex");
+  Omega_h::HostWrite<Omega_h::LO> fail_host(fail);
+  return !fail_host[0];
+}
+
+bool constructBalanced(Omega_h::Mesh& mesh, char* partition_file) {
+  pumipic::Input input(mesh, partition_file, pumipic::Input::BFS, pumipic::Input::BFS);
+  pumipic::Mesh picparts(input);
+  const int dim = mesh.dim();
+  int rank, comm_size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+
+  //All particles are in the core of rank 0
+  const int ppe = 10;
+  Omega_h::LOs owners = picparts.entOwners(dim);
+  Omega_h::Write<Omega_h::LO> particles(picparts.nelems(), 0);
+  auto setParticles = OMEGA_H_LAMBDA(Omega_h::LO elm) {
+    if (rank == 0 && owners[elm] == 0)
+      particles[elm] = ppe;
+  };
+  Omega_h::parallel_for(picparts.nelems(), setParticles, "setParticles");
+  Omega_h::LOs balanced = picparts.balancedPartition(mesh, particles);
+
+  //Every process must find the same partition and no part is much heavier than the average
+  Omega_h::HostRead<Omega_h::LO> balanced_h(balanced);
+  Omega_h::HostRead<Omega_h::LO> old_h(mesh.get_array<Omega_h::LO>(dim, "ownership"));
+  std::vector<long> weights(comm_size, 0);
+  long total = 0, max_weight = 1, checksum = 0;
+  for (int i = 0; i < balanced_h.size(); ++i) {
+    const long weight = 1 + (old_h[i] == 0) * ppe;
+    if (balanced_h[i] < 0 || balanced_h[i] >= comm_size)
+      return false;
+    weights[balanced_h[i]] += weight;
+    total += weight;
+    max_weight = std::max(max_weight, weight);
+    checksum += (long)i * balanced_h[i];
+  }
+  long min_checksum, max_checksum;
+  MPI_Allreduce(&checksum, &min_checksum, 1, MPI_LONG, MPI_MIN, MPI_COMM_WORLD);
+  MPI_Allreduce(&checksum, &max_checksum, 1, MPI_LONG, MPI_MAX, MPI_COMM_WORLD);
+  if (min_checksum != max_checksum)
+    return false;
+  for (int i = 0; i < comm_size; ++i)
+    if (weights[i] > total / comm_size + max_weight)
+      return false;
+
+  //The core of the rebuilt picparts holds the elements given to this process
+  pumipic::Input balanced_input(mesh, pumipic::Input::PARTITION, balanced,
+                                pumipic::Input::BFS, pumipic::Input::BFS);
+  pumipic::Mesh rebalanced(balanced_input);
+  Omega_h::HostRead<Omega_h::LO> full_ids(rebalanced.fullMeshElementIds(mesh));
+  Omega_h::HostRead<Omega_h::LO> new_owners(rebalanced.entOwners(dim));
+  int owned = 0;
+  for (int i = 0; i < full_ids.size(); ++i) {
+    if (balanced_h[full_ids[i]] != new_owners[i])
+      return false;
+    owned += new_owners[i] == rank;
+  }
+  int core = 0;
+  for (int i = 0; i < balanced_h.size(); ++i)
+    core += balanced_h[i] == rank;
+  return owned == core;
+}
+
+//The core is buffered by at least layers elements
+bool checkBufferDistance(pumipic::Mesh& picparts, int layers) {
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  Omega_h::HostRead<Omega_h::LO> distance(picparts.bufferDistance());
+  Omega_h::HostRead<Omega_h::LO> owners(picparts.entOwners(picparts.dim()));
+  for (int i = 0; i < distance.size(); ++i)
+    if (owners[i] == rank && distance[i] != -1 && distance[i] < layers)
+      return false;
+  return true;
+}
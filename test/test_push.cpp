@@ -0,0 +1,140 @@
+#include <Omega_h_mesh.hpp>
+#include <Omega_h_file.hpp>
+#include "pumipic_kktypes.hpp"
+#include "pumipic_push.hpp"
+#include <particle_structs.hpp>
+#include <Kokkos_Core.hpp>
+#include "pumipic_library.hpp"
+
+using particle_structs::SellCSigma;
+using particle_structs::MemberTypes;
+using pumipic::Vector3d;
+
+namespace o = Omega_h;
+namespace p = pumipic;
+namespace ps = particle_structs;
+
+//Current position, pushed position and velocity
+typedef MemberTypes<Vector3d, Vector3d, Vector3d> Particle;
+typedef ps::ParticleStructure<Particle> PS;
+typedef SellCSigma<Particle> SCS;
+
+o::Mesh readMesh(const char* meshFile, o::Library& lib) {
+  std::string fn(meshFile);
+  auto ext = fn.substr(fn.find_last_of(".") + 1);
+  if( ext == "msh") {
+    std::cout << "reading gmsh mesh " << meshFile << "\n";
+    return Omega_h::gmsh::read(meshFile, lib.self());
+  } else if( ext == "osh" ) {
+    std::cout << "reading omegah mesh " << meshFile << "\n";
+    return Omega_h::binary::read(meshFile, lib.self());
+  } else {
+    std::cout << "error: unrecognized mesh extension \'" << ext << "\'\n";
+    exit(EXIT_FAILURE);
+  }
+}
+
+/* One Boris push in a uniform magnetic field along z and no electric field rotates the
+   velocity in the xy plane by 2*atan(q*B*dt/(2*m)) without changing its magnitude, the
+   pushed position is x + v*dt in the mesh dimensions and its third component is left
+   unchanged on 2d meshes
+*/
+bool testGyration(o::Mesh& mesh, const char* name) {
+  const int dim = mesh.dim();
+  const o::LO ne = mesh.nelems();
+  PS::kkLidView ptcls_per_elem("ptcls_per_elem", ne);
+  PS::kkGidView element_gids("element_gids", ne);
+  o::parallel_for(ne, OMEGA_H_LAMBDA(const o::LO& e) {
+    ptcls_per_elem(e) = e % 4 == 0;
+    element_gids(e) = e;
+  });
+  Kokkos::TeamPolicy<Kokkos::DefaultExecutionSpace> policy(10000, 32);
+  SCS* ptcls = new SCS(policy, INT_MAX, 32, ne, (ne + 3) / 4, ptcls_per_elem,
+                       element_gids);
+  const o::Real speed = 1e4;
+  const o::Real unset = -3;
+  const auto elem_verts = mesh.ask_elem_verts();
+  const auto coords = mesh.coords();
+  auto x = ptcls->get<0>();
+  auto xtgt = ptcls->get<1>();
+  auto v = ptcls->get<2>();
+  auto setParticle = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask) {
+      const o::LO nverts = dim + 1;
+      for(int i = 0; i < 3; ++i) {
+        x(pid,i) = 0;
+        xtgt(pid,i) = unset;
+        v(pid,i) = 0;
+      }
+      for(int i = 0; i < dim; ++i)
+        for(int j = 0; j < nverts; ++j)
+          x(pid,i) += coords[elem_verts[e * nverts + j] * dim + i] / nverts;
+      v(pid,0) = speed;
+    }
+  };
+  ps::parallel_for(ptcls, setParticle);
+
+  const o::Real bz = 0.5;
+  o::Write<o::Real> bField(3 * mesh.nverts(), 0, "bField");
+  o::parallel_for(mesh.nverts(), OMEGA_H_LAMBDA(const o::LO& i) {
+    bField[i * 3 + 2] = bz;
+  });
+  mesh.add_tag(o::VERT, "push_efield", 3, o::Reals(3 * mesh.nverts(), 0));
+  mesh.add_tag(o::VERT, "push_bfield", 3, o::Reals(bField));
+  const p::BorisSpecies species = {1, 1};
+  const o::Real dt = 1e-8;
+  p::pushBoris<0, 1, 2>(ptcls, mesh, "push_efield", "push_bfield", species, dt);
+  mesh.remove_tag(o::VERT, "push_efield");
+  mesh.remove_tag(o::VERT, "push_bfield");
+
+  //the Boris rotation of a positive charge is clockwise about B
+  const o::Real qPrime = species.charge*1.60217662e-19/(species.amu*1.6737236e-27)*dt*0.5;
+  const o::Real angle = 2 * std::atan(qPrime * bz);
+  const o::Real vel[3] = {speed * std::cos(angle), -speed * std::sin(angle), 0};
+  Kokkos::View<int*> mismatches("mismatches", 1);
+  auto check = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask) {
+      bool match = true;
+      for(int i = 0; i < 3; ++i) {
+        match = match && std::fabs(v(pid,i) - vel[i]) < 1e-10 * speed;
+        const o::Real expected = i < dim ? x(pid,i) + vel[i] * dt : unset;
+        match = match && std::fabs(xtgt(pid,i) - expected) < 1e-12;
+      }
+      if(!match)
+        Kokkos::atomic_fetch_add(&(mismatches(0)), 1);
+    }
+  };
+  ps::parallel_for(ptcls, check);
+  const int push_diff = ps::getLastValue<int>(mismatches);
+  delete ptcls;
+  if(push_diff) {
+    fprintf(stderr, "[ERROR] %s Boris push differs from the analytic gyration for %d "
+            "particles\n", name, push_diff);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  pumipic::Library pic_lib(&argc, &argv);
+  Omega_h::Library& lib = pic_lib.omega_h_lib();
+  int comm_rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+  if( argc != 2 ) {
+    std::cout << "Usage: " << argv[0] << " <testMeshDir>\n";
+    exit(1);
+  }
+  std::string meshDir(argv[1]);
+  bool passed = true;
+  {
+    auto mesh = readMesh((meshDir + "/cube/7k.osh").c_str(), lib);
+    passed = testGyration(mesh, "cube") && passed;
+  }
+  {
+    auto mesh = readMesh((meshDir + "/xgc/24k.osh").c_str(), lib);
+    passed = testGyration(mesh, "xgc 24k") && passed;
+  }
+  if (!comm_rank)
+    fprintf(stderr, passed ? "done\n" : "[ERROR] push tests failed\n");
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
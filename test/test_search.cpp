@@ -0,0 +1,650 @@
+#include <Omega_h_mesh.hpp>
+#include <Omega_h_bbox.hpp>
+#include <Omega_h_file.hpp>
+#include "pumipic_kktypes.hpp"
+#include "pumipic_adjacency.hpp"
+#include <particle_structs.hpp>
+#include <Kokkos_Core.hpp>
+#include "pumipic_mesh.hpp"
+
+using particle_structs::SellCSigma;
+using particle_structs::MemberTypes;
+using pumipic::Vector3d;
+
+namespace o = Omega_h;
+namespace p = pumipic;
+namespace ps = particle_structs;
+
+//Current and target positions and the particle id
+typedef MemberTypes<Vector3d, Vector3d, int> Particle;
+typedef ps::ParticleStructure<Particle> PS;
+typedef SellCSigma<Particle> SCS;
+//Particle with the barycentric coordinates of its target, see BarycentricFinish
+typedef MemberTypes<Vector3d, Vector3d, int, double[4]> BccParticle;
+typedef ps::ParticleStructure<BccParticle> BccPS;
+typedef SellCSigma<BccParticle> BccSCS;
+
+//Searches compared by the tests
+enum SearchMethod {
+  SEARCH_WORKLIST,
+  SEARCH_WALK,
+  SEARCH_TEAM
+};
+const char* methodName(SearchMethod method) {
+  const char* names[3] = {"worklist", "walk", "team"};
+  return names[method];
+}
+
+o::Mesh readMesh(const char* meshFile, o::Library& lib) {
+  std::string fn(meshFile);
+  auto ext = fn.substr(fn.find_last_of(".") + 1);
+  if( ext == "msh") {
+    std::cout << "reading gmsh mesh " << meshFile << "\n";
+    return Omega_h::gmsh::read(meshFile, lib.self());
+  } else if( ext == "osh" ) {
+    std::cout << "reading omegah mesh " << meshFile << "\n";
+    return Omega_h::binary::read(meshFile, lib.self());
+  } else {
+    std::cout << "error: unrecognized mesh extension \'" << ext << "\'\n";
+    exit(EXIT_FAILURE);
+  }
+}
+
+//ppe particles in every element with use != 0 (every element if use is empty)
+template <class Types = Particle>
+SellCSigma<Types>* createParticles(p::Mesh& picparts, int ppe, o::LOs use = o::LOs()) {
+  typedef ps::ParticleStructure<Types> PS;
+  typedef SellCSigma<Types> SCS;
+  o::Mesh* mesh = picparts.mesh();
+  Omega_h::GOs mesh_element_gids = picparts.globalIds(picparts.dim());
+  const auto ne = mesh->nelems();
+  const bool all = !use.exists();
+  PS::kkLidView ptcls_per_elem("ptcls_per_elem", ne);
+  PS::kkGidView element_gids("element_gids", ne);
+  Kokkos::View<int*> num_ptcls("num_ptcls", 1);
+  Omega_h::parallel_for(ne, OMEGA_H_LAMBDA(const int& i) {
+    element_gids(i) = mesh_element_gids[i];
+    ptcls_per_elem(i) = (all || use[i]) ? ppe : 0;
+    Kokkos::atomic_fetch_add(&(num_ptcls(0)), ptcls_per_elem(i));
+  });
+  Kokkos::TeamPolicy<Kokkos::DefaultExecutionSpace> policy(10000, 32);
+  SCS* scs = new SCS(policy, INT_MAX, 32, ne, ps::getLastValue<int>(num_ptcls),
+                     ptcls_per_elem, element_gids);
+  auto ids = scs->template get<2>();
+  auto setIds = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask)
+      ids(pid) = pid;
+  };
+  ps::parallel_for(scs, setIds);
+  return scs;
+}
+
+/* Starts every particle at the centroid of its element and sends it in a direction set by
+   its slot, a quarter of the mesh bounding box away, so particles cross many elements and
+   some leave the domain
+*/
+template <int DIM, class ParticleStruct>
+void setPositions(o::Mesh& mesh, ParticleStruct* ptcls) {
+  const auto bb = o::get_bounding_box<DIM>(&mesh);
+  const o::Real len = 0.25 * (bb.max[0] - bb.min[0]);
+  const auto elem_verts = mesh.ask_elem_verts();
+  const auto coords = mesh.coords();
+  auto x = ptcls->template get<0>();
+  auto xtgt = ptcls->template get<1>();
+  auto setPosition = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask) {
+      const auto verts = o::gather_verts<DIM + 1>(elem_verts, e);
+      const auto elemCoords = o::gather_vectors<DIM + 1, DIM>(coords, verts);
+      const o::Real a = 0.7 * pid;
+      const o::Real b = 1.3 * pid;
+      const o::Real dir[3] = {std::cos(a) * std::cos(b), std::sin(a) * std::cos(b),
+                              std::sin(b)};
+      for(int i = 0; i < 3; ++i) {
+        x(pid,i) = 0;
+        xtgt(pid,i) = 0;
+      }
+      for(int i = 0; i < DIM; ++i) {
+        for(int v = 0; v < DIM + 1; ++v)
+          x(pid,i) += elemCoords[v][i] / (DIM + 1);
+        xtgt(pid,i) = x(pid,i) + len * dir[i];
+      }
+    }
+  };
+  ps::parallel_for(ptcls, setPosition);
+}
+
+//Number of particles outside of the domain after a search
+o::LO countLeft(PS* ptcls, o::LOs elem_ids) {
+  Kokkos::View<int*> left("left", 1);
+  auto count = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask && elem_ids[pid] < 0)
+      Kokkos::atomic_fetch_add(&(left(0)), 1);
+  };
+  ps::parallel_for(ptcls, count);
+  return ps::getLastValue<int>(left);
+}
+
+/* Runs one of the searches of the mesh dimension
+     The worklist and walk searches take the particles through ptcls (either the structure
+     or scs itself), the team search always takes scs
+*/
+template <class ParticleStruct>
+bool searchAs(SearchMethod method, int dim, p::SearchContext& search,
+              ParticleStruct* ptcls, SCS* scs, o::Write<o::LO> elem_ids, int looplimit = 0) {
+  auto x = ptcls->template get<0>();
+  auto xtgt = ptcls->template get<1>();
+  auto pid = ptcls->template get<2>();
+  o::Write<o::Real> xpoints(3 * ptcls->capacity(), 0, "xpoints");
+  o::Write<o::LO> xfaces(ptcls->capacity(), -1, "xfaces");
+  if(dim == 3) {
+    if(method == SEARCH_WORKLIST)
+      return p::search_mesh(search, ptcls, x, xtgt, pid, elem_ids, xpoints, xfaces, looplimit);
+    if(method == SEARCH_WALK)
+      return p::search_mesh_walk(search, ptcls, x, xtgt, pid, elem_ids, xpoints, xfaces,
+                                 looplimit);
+    return p::search_mesh_team(search, scs, x, xtgt, pid, elem_ids, xpoints, xfaces,
+                               looplimit);
+  }
+  if(method == SEARCH_WORKLIST)
+    return p::search_mesh_2d(search, ptcls, x, xtgt, pid, elem_ids, looplimit);
+  if(method == SEARCH_WALK)
+    return p::search_mesh_2d_walk(search, ptcls, x, xtgt, pid, elem_ids, looplimit);
+  return p::search_mesh_2d_team(search, scs, x, xtgt, pid, elem_ids, looplimit);
+}
+
+//Runs one of the searches through the particle structure
+bool searchWith(SearchMethod method, int dim, p::SearchContext& search, SCS* scs,
+                o::Write<o::LO> elem_ids, int looplimit = 0) {
+  return searchAs(method, dim, search, static_cast<PS*>(scs), scs, elem_ids, looplimit);
+}
+
+/* Number of particles found in different elements by two searches
+     A target on a side shared by both elements (within 1e-8) may be found in either
+*/
+template <int DIM>
+o::LO countElementMismatches(o::Mesh& mesh, PS* ptcls, o::LOs a, o::LOs b) {
+  const auto elem_verts = mesh.ask_elem_verts();
+  const auto coords = mesh.coords();
+  auto xtgt = ptcls->get<1>();
+  Kokkos::View<int*> mismatches("mismatches", 1);
+  auto compare = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask && a[pid] != b[pid]) {
+      bool shared = a[pid] >= 0 && b[pid] >= 0;
+      const o::LO elms[2] = {a[pid], b[pid]};
+      o::Vector<DIM> dest;
+      for(int i = 0; i < DIM; ++i)
+        dest[i] = xtgt(pid,i);
+      for(int j = 0; j < 2 && shared; ++j) {
+        const auto verts = o::gather_verts<DIM + 1>(elem_verts, elms[j]);
+        const auto bcc = o::barycentric_from_global<DIM, DIM>(
+            dest, o::gather_vectors<DIM + 1, DIM>(coords, verts));
+        for(int i = 0; i < DIM + 1; ++i)
+          shared = shared && bcc[i] > -1e-8;
+      }
+      if(!shared)
+        Kokkos::atomic_fetch_add(&(mismatches(0)), 1);
+    }
+  };
+  ps::parallel_for(ptcls, compare);
+  return ps::getLastValue<int>(mismatches);
+}
+
+//Number of particles that left the domain in both searches at exit points 1e-8 apart
+o::LO countExitMismatches(PS* ptcls, o::LOs elms_a, o::Reals xpts_a, o::LOs elms_b,
+                          o::Reals xpts_b) {
+  Kokkos::View<int*> mismatches("mismatches", 1);
+  auto compare = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask && elms_a[pid] < 0 && elms_b[pid] < 0) {
+      o::Real dist = 0;
+      for(int i = 0; i < 3; ++i)
+        dist += std::fabs(xpts_a[pid * 3 + i] - xpts_b[pid * 3 + i]);
+      if(dist > 1e-8)
+        Kokkos::atomic_fetch_add(&(mismatches(0)), 1);
+    }
+  };
+  ps::parallel_for(ptcls, compare);
+  return ps::getLastValue<int>(mismatches);
+}
+
+/* The worklist, walk and team searches find the same elements and, in 3d, the same exit
+   points for particles crossing many elements and leaving the domain
+*/
+template <int DIM>
+bool testSearchesAgree(o::Mesh& mesh, p::Mesh& picparts, const char* name) {
+  SCS* scs = createParticles(picparts, 2);
+  PS* ptcls = scs;
+  setPositions<DIM>(mesh, ptcls);
+  const o::LO capacity = ptcls->capacity();
+  bool success = true;
+  const SearchMethod methods[3] = {SEARCH_WORKLIST, SEARCH_WALK, SEARCH_TEAM};
+  o::LOs elem_ids[3];
+  o::Reals xpoints[3];
+  for(int m = 0; m < 3; ++m) {
+    p::SearchContext search(mesh);
+    o::Write<o::LO> found_elems(capacity, -1, "elem_ids");
+    if(!searchWith(methods[m], DIM, search, scs, found_elems)) {
+      fprintf(stderr, "[ERROR] %s %s search did not find every particle\n", name,
+              methodName(methods[m]));
+      success = false;
+    }
+    elem_ids[m] = found_elems;
+    if(DIM == 3)
+      xpoints[m] = search.xpoints;
+  }
+  if(countLeft(ptcls, elem_ids[0]) == ptcls->nPtcls()) {
+    fprintf(stderr, "[ERROR] %s every particle left the domain\n", name);
+    success = false;
+  }
+  for(int m = 1; m < 3; ++m) {
+    const o::LO elm_diff = countElementMismatches<DIM>(mesh, ptcls, elem_ids[0], elem_ids[m]);
+    const o::LO exit_diff = DIM == 3 ?
+      countExitMismatches(ptcls, elem_ids[0], xpoints[0], elem_ids[m], xpoints[m]) : 0;
+    if(elm_diff || exit_diff) {
+      fprintf(stderr, "[ERROR] %s %s search differs from the worklist search for %d "
+              "elements and %d exit points\n", name, methodName(methods[m]), elm_diff,
+              exit_diff);
+      success = false;
+    }
+  }
+  delete scs;
+  return success;
+}
+
+/* The team search stops each walk at the loop limit: with a limit of one crossing it
+   reports the particles needing more as not found and none crosses more than once
+*/
+template <int DIM>
+bool testTeamLoopLimit(o::Mesh& mesh, p::Mesh& picparts, const char* name) {
+  SCS* scs = createParticles(picparts, 2);
+  PS* ptcls = scs;
+  setPositions<DIM>(mesh, ptcls);
+  p::SearchContext search(mesh);
+  search.enableStatistics(4);
+  o::Write<o::LO> elem_ids(ptcls->capacity(), -1, "elem_ids");
+  bool success = true;
+  if(searchWith(SEARCH_TEAM, DIM, search, scs, elem_ids, 1)) {
+    fprintf(stderr, "[ERROR] %s team search with a loop limit of 1 found every particle\n",
+            name);
+    success = false;
+  }
+  const o::HostRead<o::LO> histogram(search.crossingHistogram());
+  if(histogram[1] == 0 || histogram[2] != 0 || histogram[3] != 0) {
+    fprintf(stderr, "[ERROR] %s team search with a loop limit of 1 crossed once %d times, "
+            "twice %d times and more %d times\n", name, histogram[1], histogram[2],
+            histogram[3]);
+    success = false;
+  }
+  delete scs;
+  return success;
+}
+
+/* BarycentricFinish stores the coordinates of the target in the element found, as computed
+   directly from the vertices, and leaves those of particles leaving the domain unchanged
+*/
+template <int DIM>
+bool testBarycentricFinish(o::Mesh& mesh, p::Mesh& picparts, const char* name) {
+  BccSCS* scs = createParticles<BccParticle>(picparts, 2);
+  BccPS* ptcls = scs;
+  setPositions<DIM>(mesh, ptcls);
+  auto x = ptcls->get<0>();
+  auto xtgt = ptcls->get<1>();
+  auto pid = ptcls->get<2>();
+  auto bcc = ptcls->get<3>();
+  const double unset = -7;
+  auto fillBcc = PS_LAMBDA(const int& e, const int& ptcl, const int& mask) {
+    for(int i = 0; i < 4; ++i)
+      bcc(ptcl,i) = unset;
+  };
+  ps::parallel_for(ptcls, fillBcc);
+  const o::LO capacity = ptcls->capacity();
+  p::SearchContext search(mesh);
+  o::Write<o::LO> elem_ids(capacity, -1, "elem_ids");
+  auto finish = p::makeBarycentricFinish<DIM>(search, xtgt, bcc, p::NoSearchFinish());
+  bool found;
+  if(DIM == 3) {
+    o::Write<o::Real> xpoints(3 * capacity, 0, "xpoints");
+    o::Write<o::LO> xfaces(capacity, -1, "xfaces");
+    found = p::search_mesh(search, ptcls, x, xtgt, pid, elem_ids, xpoints, xfaces, 0, finish);
+  }
+  else
+    found = p::search_mesh_2d(search, ptcls, x, xtgt, pid, elem_ids, 0, finish);
+  bool success = true;
+  if(!found) {
+    fprintf(stderr, "[ERROR] %s search with barycentric coordinates did not find every "
+            "particle\n", name);
+    success = false;
+  }
+  const auto elem_verts = mesh.ask_elem_verts();
+  const auto coords = mesh.coords();
+  Kokkos::View<int*> mismatches("mismatches", 1);
+  auto compare = PS_LAMBDA(const int& e, const int& ptcl, const int& mask) {
+    if(!mask)
+      return;
+    const o::LO elm = elem_ids[ptcl];
+    bool match = true;
+    if(elm < 0) {
+      for(int i = 0; i < DIM + 1; ++i)
+        match = match && bcc(ptcl,i) == unset;
+    }
+    else {
+      o::Vector<DIM> dest;
+      for(int i = 0; i < DIM; ++i)
+        dest[i] = xtgt(ptcl,i);
+      const auto verts = o::gather_verts<DIM + 1>(elem_verts, elm);
+      const auto weights = o::barycentric_from_global<DIM, DIM>(
+          dest, o::gather_vectors<DIM + 1, DIM>(coords, verts));
+      for(int i = 0; i < DIM + 1; ++i)
+        match = match && std::fabs(bcc(ptcl,i) - weights[i]) < 1e-12;
+    }
+    if(!match)
+      Kokkos::atomic_fetch_add(&(mismatches(0)), 1);
+  };
+  ps::parallel_for(ptcls, compare);
+  const int bcc_diff = ps::getLastValue<int>(mismatches);
+  if(bcc_diff) {
+    fprintf(stderr, "[ERROR] %s search stored wrong barycentric coordinates for %d "
+            "particles\n", name, bcc_diff);
+    success = false;
+  }
+  delete scs;
+  return success;
+}
+
+/* The boundary buffer of the 3d search holds one hit per particle leaving the domain, with
+   the exit point of the search, on an exposed side of the element it was last in
+*/
+bool testBoundaryHits(o::Mesh& mesh, p::Mesh& picparts, const char* name) {
+  SCS* scs = createParticles(picparts, 2);
+  PS* ptcls = scs;
+  setPositions<3>(mesh, ptcls);
+  const o::LO capacity = ptcls->capacity();
+  p::SearchContext search(mesh);
+  search.enableBoundaryBuffer(capacity);
+  search.enableStatistics();
+  o::Write<o::LO> elem_ids(capacity, -1, "elem_ids");
+  bool success = true;
+  if(!searchWith(SEARCH_WORKLIST, 3, search, scs, elem_ids)) {
+    fprintf(stderr, "[ERROR] %s search with the boundary buffer did not find every "
+            "particle\n", name);
+    success = false;
+  }
+  const o::LO left = countLeft(ptcls, elem_ids);
+  const p::BoundaryHits& hits = search.boundaryBuffer();
+  const o::LO nhits = hits.size();
+  if(left == 0 || nhits != left || search.boundaryHits() != left) {
+    fprintf(stderr, "[ERROR] %s search recorded %d boundary hits and counted %d for %d "
+            "particles leaving the domain\n", name, nhits, search.boundaryHits(), left);
+    success = false;
+  }
+  const o::LO nstored = nhits < capacity ? nhits : capacity;
+  const auto hit_ptcls = hits.ptcls;
+  const auto hit_elems = hits.elems;
+  const auto hit_sides = hits.sides;
+  const auto hit_xpoints = hits.xpoints;
+  const auto xpoints = search.xpoints;
+  const auto exposed = search.side_is_exposed;
+  const auto elem_verts = mesh.ask_elem_verts();
+  const auto coords = mesh.coords();
+  const auto elem_faces = mesh.ask_down(3, 2).ab2b;
+  o::Write<o::LO> hits_per_ptcl(capacity, 0, "hits_per_ptcl");
+  Kokkos::View<int*> mismatches("mismatches", 1);
+  o::parallel_for(nstored, OMEGA_H_LAMBDA(const o::LO& i) {
+    const o::LO ptcl = hit_ptcls[i];
+    const o::LO elm = hit_elems[i];
+    const o::LO side = hit_sides[i];
+    bool match = elem_ids[ptcl] < 0 && elm >= 0 && exposed[side];
+    bool side_of_elm = false;
+    for(int f = 0; f < 4; ++f)
+      side_of_elm = side_of_elm || elem_faces[elm * 4 + f] == side;
+    o::Vector<3> xpoint;
+    for(int c = 0; c < 3; ++c) {
+      xpoint[c] = hit_xpoints[i * 3 + c];
+      match = match && std::fabs(xpoint[c] - xpoints[ptcl * 3 + c]) < 1e-8;
+    }
+    const auto verts = o::gather_verts<4>(elem_verts, elm);
+    const auto bcc = o::barycentric_from_global<3, 3>(
+        xpoint, o::gather_vectors<4, 3>(coords, verts));
+    for(int v = 0; v < 4; ++v)
+      match = match && bcc[v] > -1e-8;
+    if(Kokkos::atomic_fetch_add(&hits_per_ptcl[ptcl], 1) > 0 || !match || !side_of_elm)
+      Kokkos::atomic_fetch_add(&(mismatches(0)), 1);
+  });
+  const int hit_diff = ps::getLastValue<int>(mismatches);
+  if(hit_diff) {
+    fprintf(stderr, "[ERROR] %s search recorded %d boundary hits that do not match the "
+            "particles leaving the domain\n", name, hit_diff);
+    success = false;
+  }
+  delete scs;
+  return success;
+}
+
+/* Particles sent from their owned element to the centroid of an element of the full mesh
+   picked from their global id need more than one round of search_mesh_2d_continued, each
+   particle found ends in the element of its target (the particle id holds its global id)
+*/
+bool testContinuedSearch(o::Mesh& full_mesh, p::Mesh& picparts, const char* name) {
+  o::Mesh& mesh = *picparts.mesh();
+  const int rank = picparts.comm()->rank();
+  const auto owners = picparts.entOwners(picparts.dim());
+  o::Write<o::LO> owned(mesh.nelems(), "owned");
+  o::parallel_for(mesh.nelems(), OMEGA_H_LAMBDA(const o::LO& e) {
+    owned[e] = owners[e] == rank;
+  });
+  SCS* scs = createParticles(picparts, 1, o::LOs(owned));
+  PS* ptcls = scs;
+  setPositions<2>(mesh, ptcls);
+  const o::LO nfull = full_mesh.nelems();
+  const auto full_verts = full_mesh.ask_elem_verts();
+  const auto full_coords = full_mesh.coords();
+  const auto gids = picparts.globalIds(picparts.dim());
+  auto xtgt = ptcls->get<1>();
+  auto ids = ptcls->get<2>();
+  auto setTarget = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask) {
+      const o::LO tgt = (gids[e] * 7919 + 13) % nfull;
+      const auto verts = o::gather_verts<3>(full_verts, tgt);
+      const auto elemCoords = o::gather_vectors<3, 2>(full_coords, verts);
+      for(int i = 0; i < 2; ++i)
+        xtgt(pid,i) = (elemCoords[0][i] + elemCoords[1][i] + elemCoords[2][i]) / 3;
+      ids(pid) = tgt;
+    }
+  };
+  ps::parallel_for(ptcls, setTarget);
+
+  p::SearchContext search(picparts);
+  search.enableContinuation(picparts);
+  o::Write<o::LO> elem_ids;
+  int rounds = 0;
+  bool success = true;
+  if(!p::search_mesh_2d_continued<0, 1, 2>(search, picparts, ptcls, elem_ids, 0, 8,
+                                           &rounds)) {
+    fprintf(stderr, "[ERROR] %s continued search did not find every particle\n", name);
+    success = false;
+  }
+  int max_rounds = 0;
+  MPI_Allreduce(&rounds, &max_rounds, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  if(max_rounds < 2) {
+    fprintf(stderr, "[ERROR] %s continued search ended after %d rounds\n", name, max_rounds);
+    success = false;
+  }
+  ids = ptcls->get<2>();
+  Kokkos::View<int*> counts("counts", 2);
+  auto checkTarget = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask && elem_ids[pid] >= 0) {
+      Kokkos::atomic_fetch_add(&(counts(0)), 1);
+      if(gids[elem_ids[pid]] != ids(pid))
+        Kokkos::atomic_fetch_add(&(counts(1)), 1);
+    }
+  };
+  ps::parallel_for(ptcls, checkTarget);
+  Kokkos::View<int*, Kokkos::HostSpace> counts_h("counts_h", 2);
+  Kokkos::deep_copy(counts_h, counts);
+  int global_counts[2];
+  MPI_Allreduce(counts_h.data(), global_counts, 2, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+  if(global_counts[0] == 0 || global_counts[1] != 0) {
+    fprintf(stderr, "[ERROR] %s continued search found %d particles, %d not in the element "
+            "of their target\n", name, global_counts[0], global_counts[1]);
+    success = false;
+  }
+  delete scs;
+  return success;
+}
+
+/* The worklist and walk searches given the SellCSigma itself, so their kernels are
+   dispatched statically, find the elements found through the particle structure
+*/
+template <int DIM>
+bool testStaticDispatch(o::Mesh& mesh, p::Mesh& picparts, const char* name) {
+  SCS* scs = createParticles(picparts, 2);
+  PS* ptcls = scs;
+  setPositions<DIM>(mesh, ptcls);
+  const o::LO capacity = ptcls->capacity();
+  bool success = true;
+  const SearchMethod methods[2] = {SEARCH_WORKLIST, SEARCH_WALK};
+  for(int m = 0; m < 2; ++m) {
+    p::SearchContext dynamic_search(mesh);
+    p::SearchContext static_search(mesh);
+    o::Write<o::LO> dynamic_elems(capacity, -1, "dynamic_elem_ids");
+    o::Write<o::LO> static_elems(capacity, -1, "static_elem_ids");
+    const bool dynamic_found = searchWith(methods[m], DIM, dynamic_search, scs,
+                                          dynamic_elems);
+    const bool static_found = searchAs(methods[m], DIM, static_search, scs, scs,
+                                       static_elems);
+    const o::LO elm_diff = countElementMismatches<DIM>(mesh, ptcls, dynamic_elems,
+                                                       static_elems);
+    if(dynamic_found != static_found || elm_diff) {
+      fprintf(stderr, "[ERROR] %s %s search of the SellCSigma differs from the search of "
+              "the particle structure for %d elements\n", name, methodName(methods[m]),
+              elm_diff);
+      success = false;
+    }
+  }
+  delete scs;
+  return success;
+}
+
+//Scales the mesh vertex coordinates and the particle positions and targets by factor
+void scaleGeometry(o::Mesh& mesh, PS* ptcls, o::Real factor) {
+  const auto coords = mesh.coords();
+  o::Write<o::Real> scaled(coords.size(), "scaled_coords");
+  o::parallel_for(coords.size(), OMEGA_H_LAMBDA(const o::LO& i) {
+    scaled[i] = factor * coords[i];
+  });
+  mesh.set_coords(o::Reals(scaled));
+  auto x = ptcls->get<0>();
+  auto xtgt = ptcls->get<1>();
+  auto scale = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if(mask) {
+      for(int i = 0; i < 3; ++i) {
+        x(pid,i) *= factor;
+        xtgt(pid,i) *= factor;
+      }
+    }
+  };
+  ps::parallel_for(ptcls, scale);
+}
+
+/* Searches with the geometry cache find the same elements as searches without it, also
+   after the mesh coordinates and particles are scaled and both contexts are updated,
+   then the scaled search finds the elements of the unscaled one
+*/
+template <int DIM>
+bool testCachedSearch(o::Mesh& mesh, p::Mesh& picparts, const char* name) {
+  SCS* scs = createParticles(picparts, 2);
+  PS* ptcls = scs;
+  setPositions<DIM>(mesh, ptcls);
+  const o::LO capacity = ptcls->capacity();
+  p::SearchContext uncached(mesh);
+  p::SearchContext cached(mesh);
+  cached.cacheGeometry();
+  bool success = true;
+  const o::Real factors[2] = {1, 2};
+  o::LOs unscaled_elems;
+  for(int f = 0; f < 2; ++f) {
+    if(factors[f] != 1) {
+      scaleGeometry(mesh, ptcls, factors[f]);
+      uncached.updateCoordinates();
+      cached.updateCoordinates();
+    }
+    o::Write<o::LO> uncached_elems(capacity, -1, "uncached_elem_ids");
+    o::Write<o::LO> cached_elems(capacity, -1, "cached_elem_ids");
+    const bool uncached_found = searchWith(SEARCH_WORKLIST, DIM, uncached, scs,
+                                           uncached_elems);
+    const bool cached_found = searchWith(SEARCH_WORKLIST, DIM, cached, scs, cached_elems);
+    if(!uncached_found || !cached_found) {
+      fprintf(stderr, "[ERROR] %s search with coordinates scaled by %.1f did not find every "
+              "particle\n", name, factors[f]);
+      success = false;
+    }
+    const o::LO elm_diff = countElementMismatches<DIM>(mesh, ptcls, uncached_elems,
+                                                       cached_elems);
+    if(elm_diff) {
+      fprintf(stderr, "[ERROR] %s cached search with coordinates scaled by %.1f differs "
+              "from the uncached search for %d elements\n", name, factors[f], elm_diff);
+      success = false;
+    }
+    if(f == 0)
+      unscaled_elems = uncached_elems;
+    else if(countElementMismatches<DIM>(mesh, ptcls, unscaled_elems, cached_elems)) {
+      fprintf(stderr, "[ERROR] %s search did not follow the coordinate change\n", name);
+      success = false;
+    }
+  }
+  scaleGeometry(mesh, ptcls, 1 / factors[1]);
+  delete scs;
+  return success;
+}
+
+int main(int argc, char** argv) {
+  pumipic::Library pic_lib(&argc, &argv);
+  Omega_h::Library& lib = pic_lib.omega_h_lib();
+  int comm_rank, comm_size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
+  if( argc != 2 ) {
+    std::cout << "Usage: " << argv[0] << " <testMeshDir>\n";
+    exit(1);
+  }
+  std::string meshDir(argv[1]);
+  bool passed = true;
+  //every rank holds the full mesh
+  {
+    auto full_mesh = readMesh((meshDir + "/cube/7k.osh").c_str(), lib);
+    Omega_h::Write<Omega_h::LO> owner(full_mesh.nelems(), 0);
+    pumipic::Input input(full_mesh, pumipic::Input::PARTITION, owner, pumipic::Input::FULL,
+                         pumipic::Input::BFS);
+    p::Mesh picparts(input);
+    o::Mesh& mesh = *picparts.mesh();
+    passed = testSearchesAgree<3>(mesh, picparts, "cube") && passed;
+    passed = testCachedSearch<3>(mesh, picparts, "cube") && passed;
+    passed = testTeamLoopLimit<3>(mesh, picparts, "cube") && passed;
+    passed = testBarycentricFinish<3>(mesh, picparts, "cube") && passed;
+    passed = testBoundaryHits(mesh, picparts, "cube") && passed;
+    passed = testStaticDispatch<3>(mesh, picparts, "cube") && passed;
+  }
+  {
+    auto full_mesh = readMesh((meshDir + "/xgc/24k.osh").c_str(), lib);
+    Omega_h::Write<Omega_h::LO> owner(full_mesh.nelems(), 0);
+    pumipic::Input input(full_mesh, pumipic::Input::PARTITION, owner, pumipic::Input::FULL,
+                         pumipic::Input::BFS);
+    p::Mesh picparts(input);
+    o::Mesh& mesh = *picparts.mesh();
+    passed = testSearchesAgree<2>(mesh, picparts, "xgc 24k") && passed;
+    passed = testCachedSearch<2>(mesh, picparts, "xgc 24k") && passed;
+    passed = testTeamLoopLimit<2>(mesh, picparts, "xgc 24k") && passed;
+    passed = testBarycentricFinish<2>(mesh, picparts, "xgc 24k") && passed;
+    passed = testStaticDispatch<2>(mesh, picparts, "xgc 24k") && passed;
+  }
+  //partitioned picparts handing particles over between ranks
+  if(comm_size == 4) {
+    auto full_mesh = readMesh((meshDir + "/xgc/24k.osh").c_str(), lib);
+    std::string partition = meshDir + "/xgc/24k_4.cpn";
+    pumipic::Input input(full_mesh, &partition[0], pumipic::Input::BFS, pumipic::Input::BFS);
+    p::Mesh picparts(input);
+    passed = testContinuedSearch(full_mesh, picparts, "xgc 24k on 4 ranks") && passed;
+  }
+  if (!comm_rank)
+    fprintf(stderr, passed ? "done\n" : "[ERROR] search tests failed\n");
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,187 @@
+#include <xgcp_mesh.hpp>
+#include <xgcp_gyro_scatter.hpp>
+#include <Omega_h_array_ops.hpp>
+#include <Omega_h_for.hpp>
+#include <cmath>
+#include <cstdio>
+
+namespace o = Omega_h;
+
+//True if every process has the same major and minor maps
+bool sameMaps(o::LOs major, o::LOs minor, o::LOs other_major, o::LOs other_minor) {
+  int same = major == other_major && minor == other_minor;
+  int all_same;
+  MPI_Allreduce(&same, &all_same, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+  return all_same;
+}
+
+//True if every process has its gyro map cache file
+bool cacheExists(const std::string& prefix) {
+  FILE* file = fopen((prefix + ".gmap").c_str(), "rb");
+  int exists = file != NULL;
+  if (file)
+    fclose(file);
+  int all_exist;
+  MPI_Allreduce(&exists, &all_exist, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+  return all_exist;
+}
+
+bool testGyroCache(xgcp::Input& input, const char* directory) {
+  input.setGyroCache(directory);
+  xgcp::Mesh built(input);
+  const int rank = built.worldRank();
+  const std::string prefix = xgcp::gyroMapPrefix(directory,
+      xgcp::gyroMapKey(built.omegaMesh(), built.getMajorPlaneAngle(),
+                       built.getMinorPlaneAngle()), rank);
+  if (!cacheExists(prefix)) {
+    if (!rank)
+      fprintf(stderr, "[ERROR] The gyro maps were not cached in %s\n", directory);
+    return false;
+  }
+  o::LOs major, minor;
+  built.getIonGyroMappings(major, minor);
+
+  //The cached maps are the ones built without the cache
+  remove((prefix + ".gmap").c_str());
+  input.setGyroCache(NULL);
+  xgcp::Mesh uncached(input);
+  o::LOs uncached_major, uncached_minor;
+  uncached.getIonGyroMappings(uncached_major, uncached_minor);
+  if (!sameMaps(major, minor, uncached_major, uncached_minor)) {
+    if (!rank)
+      fprintf(stderr, "[ERROR] The gyro maps differ from the maps built without the cache\n");
+    return false;
+  }
+
+  //A cache written by a mesh is loaded by the next one
+  input.setGyroCache(directory);
+  xgcp::Mesh writer(input);
+  if (!cacheExists(prefix)) {
+    if (!rank)
+      fprintf(stderr, "[ERROR] The gyro maps were not cached again in %s\n", directory);
+    return false;
+  }
+  xgcp::Mesh loaded(input);
+  o::LOs loaded_major, loaded_minor;
+  loaded.getIonGyroMappings(loaded_major, loaded_minor);
+  if (!sameMaps(major, minor, loaded_major, loaded_minor)) {
+    if (!rank)
+      fprintf(stderr, "[ERROR] The cached gyro maps differ from the built maps\n");
+    return false;
+  }
+
+  //Rotations by one ring point permute the maps into the ones built at the new angle
+  const o::Real theta = 360.0 / 8;
+  loaded.setGyroTheta(theta);
+  o::LOs rotated_major, rotated_minor;
+  loaded.getIonGyroMappings(rotated_major, rotated_minor);
+  o::LOs rebuilt_major, rebuilt_minor;
+  xgcp::createIonGyroRingMappings(loaded.omegaMesh(), rebuilt_major, rebuilt_minor);
+  if (!sameMaps(rotated_major, rotated_minor, rebuilt_major, rebuilt_minor)) {
+    if (!rank)
+      fprintf(stderr, "[ERROR] The rotated gyro maps differ from the maps built at %f\n",
+              theta);
+    return false;
+  }
+  return true;
+}
+
+//Sum of a[i] * b[i]
+o::Real dot(o::Reals a, o::Reals b) {
+  o::Write<o::Real> products(a.size(), 0);
+  o::parallel_for(a.size(), OMEGA_H_LAMBDA(const o::LO& i) {
+    products[i] = a[i] * b[i];
+  });
+  return o::get_sum(o::Reals(products));
+}
+
+/* The operator scatters ring values like the loop over the mapping of each ring point and
+   its transpose is the adjoint of the scatter: (A x) . z == x . (A^T z)
+*/
+bool testGyroOperator(xgcp::Input& input) {
+  xgcp::Mesh mesh(input);
+  const int rank = mesh.worldRank();
+  const o::LO nverts = mesh->nverts();
+  o::LOs maps[2];
+  mesh.getIonGyroMappings(maps[0], maps[1]);
+  xgcp::GyroOperator ops[2];
+  mesh.getIonGyroOperators(ops[0], ops[1]);
+  int fail = 0;
+  for (int m = 0; m < 2; ++m) {
+    const xgcp::GyroOperator& op = ops[m];
+    o::LOs v2v = maps[m];
+    const o::LO num_rings = op.numCols();
+    if (op.numRows() != nverts || num_rings == 0 || num_rings % nverts != 0) {
+      fprintf(stderr, "[ERROR] Process %d: gyro operator is %d x %d for %d vertices\n", rank,
+              op.numRows(), num_rings, nverts);
+      fail = 1;
+      break;
+    }
+    const o::LO gppr = v2v.size() / (3 * num_rings);
+    o::Write<o::Real> x(num_rings, 0);
+    o::parallel_for(num_rings, OMEGA_H_LAMBDA(const o::LO& r) {
+      x[r] = 1 + r % 5;
+    });
+    o::Write<o::Real> expected(nverts, 0);
+    auto scatterRing = OMEGA_H_LAMBDA(const o::LO& r) {
+      for (o::LO i = r * 3 * gppr; i < (r + 1) * 3 * gppr; ++i)
+        if (v2v[i] >= 0)
+          Kokkos::atomic_fetch_add(&(expected[v2v[i]]), x[r] / gppr);
+    };
+    o::parallel_for(num_rings, scatterRing, "testGyroScatterRings");
+    o::Write<o::Real> y(nverts, 0);
+    op.apply(o::Reals(x), y);
+    o::Write<o::Real> differences(nverts, 0);
+    o::parallel_for(nverts, OMEGA_H_LAMBDA(const o::LO& v) {
+      differences[v] = fabs(y[v] - expected[v]) / (1 + fabs(expected[v]));
+    });
+    const o::Real diff = o::get_max(o::Reals(differences));
+    if (diff > 1e-12) {
+      fprintf(stderr, "[ERROR] Process %d: gyro operator %d differs from the mapping by %e\n",
+              rank, m, diff);
+      fail = 1;
+    }
+
+    o::Write<o::Real> z(nverts, 0);
+    o::parallel_for(nverts, OMEGA_H_LAMBDA(const o::LO& v) {
+      z[v] = 1 + v % 7;
+    });
+    o::Write<o::Real> w(num_rings, 0);
+    op.applyTranspose(o::Reals(z), w);
+    const o::Real scattered = dot(o::Reals(y), o::Reals(z));
+    const o::Real averaged = dot(o::Reals(x), o::Reals(w));
+    if (fabs(scattered - averaged) > 1e-10 * (1 + fabs(scattered))) {
+      fprintf(stderr, "[ERROR] Process %d: gyro operator %d transpose gives %f instead of %f\n",
+              rank, m, averaged, scattered);
+      fail = 1;
+    }
+  }
+  int any_fail;
+  MPI_Allreduce(&fail, &any_fail, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  return !any_fail;
+}
+
+int main(int argc, char* argv[]) {
+  pumipic::Library pic_lib(&argc, &argv);
+  Omega_h::Library& lib = pic_lib.omega_h_lib();
+  int comm_rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+  if (argc != 6) {
+    if (comm_rank == 0)
+      fprintf(stderr, "Usage: %s <mesh> <owner_file> <num planes> <num procs per group> "
+              "<gyro cache directory>\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+  xgcp::Input input(lib, argv[1], argv[2], atoi(argv[3]), atoi(argv[4]),
+                    pumipic::Input::getMethod("full"), pumipic::Input::getMethod("bfs"));
+  bool passed = true;
+  if (!testGyroCache(input, argv[5]))
+    passed = false;
+  input.setGyroCache(NULL);
+  if (!testGyroOperator(input))
+    passed = false;
+  if (!comm_rank && passed)
+    fprintf(stderr, "done\n");
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,190 @@
+#include <xgcp_mesh.hpp>
+#include <xgcp_particle.hpp>
+#include <xgcp_output.hpp>
+#include <particle_structs.hpp>
+#include <Omega_h_for.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+using xgcp::PS_I;
+
+namespace p = pumipic;
+namespace ps = particle_structs;
+namespace o = Omega_h;
+
+//Name of the output file of a step
+std::string outputFile(const char* directory, int step, int rank) {
+  std::stringstream ss;
+  ss << directory << "/step_" << step << "_" << rank << ".xgo";
+  return ss.str();
+}
+
+//Reads an output file back into a snapshot, false if the file is truncated or not an output
+bool readOutput(const std::string& filename, xgcp::OutputWriter::Snapshot& snapshot) {
+  FILE* file = fopen(filename.c_str(), "rb");
+  if (!file) {
+    fprintf(stderr, "[ERROR] Cannot open output %s\n", filename.c_str());
+    return false;
+  }
+  char magic[8];
+  int version, nverts = 0, nptcls = 0;
+  bool success = fread(magic, 1, 8, file) == 8 && !strcmp(magic, "XGCPOUT") &&
+    fread(&version, sizeof(int), 1, file) == 1 && version == 1 &&
+    fread(snapshot.header, sizeof(int), 4, file) == 4 &&
+    fread(&nverts, sizeof(int), 1, file) == 1 && nverts >= 0;
+  if (success) {
+    snapshot.major.resize(nverts);
+    snapshot.minor.resize(nverts);
+    success = fread(snapshot.major.data(), sizeof(double), nverts, file) == (size_t)nverts &&
+      fread(snapshot.minor.data(), sizeof(double), nverts, file) == (size_t)nverts &&
+      fread(&nptcls, sizeof(int), 1, file) == 1 && nptcls >= 0;
+  }
+  if (success) {
+    snapshot.coords.resize(3 * nptcls);
+    snapshot.ids.resize(nptcls);
+    success = fread(snapshot.coords.data(), sizeof(double), 3 * nptcls, file) ==
+      (size_t)(3 * nptcls) &&
+      fread(snapshot.ids.data(), sizeof(int), nptcls, file) == (size_t)nptcls;
+  }
+  fclose(file);
+  if (!success)
+    fprintf(stderr, "[ERROR] Output %s is not a complete output file\n", filename.c_str());
+  return success;
+}
+
+/* A step written with the fields and a particle sample is read back with the same header,
+   the fields on the group leader only and exactly the particles with an id on the stride
+*/
+bool testOutput(xgcp::Mesh& mesh, const char* directory) {
+  const int rank = mesh.worldRank();
+  xgcp::Mesh::GyroField major_plane, minor_plane;
+  mesh.getGyroFields(major_plane, minor_plane);
+  o::parallel_for(major_plane.size(), OMEGA_H_LAMBDA(const o::LO& i) {
+    major_plane[i] = i;
+    minor_plane[i] = -0.5 * i;
+  });
+  const int nverts = major_plane.size();
+
+  //One particle per element
+  const o::LO ne = mesh.nelems();
+  PS_I::kkLidView ptcls_per_elem("ptcls_per_elem", ne);
+  PS_I::kkGidView element_gids("element_gids", ne);
+  Omega_h::GOs mesh_element_gids = mesh.pumipicMesh()->globalIds(mesh.dim());
+  Omega_h::parallel_for(ne, OMEGA_H_LAMBDA(const int& i) {
+    ptcls_per_elem(i) = 1;
+    element_gids(i) = mesh_element_gids[i];
+  });
+  PS_I* ions = xgcp::initializeIons(mesh, ne, ptcls_per_elem, element_gids);
+  const int stride = 3;
+  auto x = ions->get<xgcp::PTCL_COORDS>();
+  auto pids = ions->get<xgcp::PTCL_IDS>();
+  Kokkos::View<int*> sampled("sampled", 1);
+  Kokkos::View<double*> coordinate_sum("coordinate_sum", 1);
+  auto countSample = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if (mask && pids(pid) % stride == 0) {
+      Kokkos::atomic_fetch_add(&(sampled(0)), 1);
+      Kokkos::atomic_fetch_add(&(coordinate_sum(0)), x(pid, 0) + x(pid, 1) + x(pid, 2));
+    }
+  };
+  ps::parallel_for(ions, countSample, "count_sample");
+  const int expected_count = ps::getLastValue<int>(sampled);
+  const double expected_sum = ps::getLastValue<double>(coordinate_sum);
+
+  //The write of the second step waits for the first
+  {
+    xgcp::OutputWriter output(mesh, directory, stride);
+    output.write(7, ions);
+    output.write(8);
+  }
+  delete ions;
+
+  int fail = 0;
+  xgcp::OutputWriter::Snapshot sampled_step, fields_step;
+  const std::string sampled_file = outputFile(directory, 7, rank);
+  const std::string fields_file = outputFile(directory, 8, rank);
+  if (!readOutput(sampled_file, sampled_step) || !readOutput(fields_file, fields_step))
+    fail = 1;
+  else {
+    const int header[4] = {7, mesh.torodialRank(), mesh.meshRank(), mesh.groupRank()};
+    for (int i = 0; i < 4; ++i) {
+      if (sampled_step.header[i] != header[i]) {
+        fprintf(stderr, "[ERROR] Process %d: output header %d is %d instead of %d\n", rank, i,
+                sampled_step.header[i], header[i]);
+        fail = 1;
+      }
+    }
+    if (fields_step.header[0] != 8) {
+      fprintf(stderr, "[ERROR] Process %d: output of step 8 is labeled step %d\n", rank,
+              fields_step.header[0]);
+      fail = 1;
+    }
+    const int expected_verts = mesh.isGroupLeader() ? nverts : 0;
+    if ((int)sampled_step.major.size() != expected_verts) {
+      fprintf(stderr, "[ERROR] Process %d wrote %d field values instead of %d\n", rank,
+              (int)sampled_step.major.size(), expected_verts);
+      fail = 1;
+    }
+    for (size_t i = 0; i < sampled_step.major.size(); ++i) {
+      if (sampled_step.major[i] != (double)i || sampled_step.minor[i] != -0.5 * i) {
+        fprintf(stderr, "[ERROR] Process %d: output field values of vertex %d are %f and %f\n",
+                rank, (int)i, sampled_step.major[i], sampled_step.minor[i]);
+        fail = 1;
+        break;
+      }
+    }
+    if ((int)sampled_step.ids.size() != expected_count || !fields_step.ids.empty()) {
+      fprintf(stderr, "[ERROR] Process %d wrote %d and %d particles instead of %d and 0\n",
+              rank, (int)sampled_step.ids.size(), (int)fields_step.ids.size(), expected_count);
+      fail = 1;
+    }
+    double sum = 0;
+    for (size_t i = 0; i < sampled_step.ids.size(); ++i) {
+      if (sampled_step.ids[i] % stride != 0) {
+        fprintf(stderr, "[ERROR] Process %d wrote particle %d off of the stride %d\n", rank,
+                sampled_step.ids[i], stride);
+        fail = 1;
+        break;
+      }
+      sum += sampled_step.coords[3 * i] + sampled_step.coords[3 * i + 1] +
+        sampled_step.coords[3 * i + 2];
+    }
+    if (fabs(sum - expected_sum) > 1e-10 * (1 + fabs(expected_sum))) {
+      fprintf(stderr, "[ERROR] Process %d: output coordinates sum to %f instead of %f\n", rank,
+              sum, expected_sum);
+      fail = 1;
+    }
+  }
+  remove(sampled_file.c_str());
+  remove(fields_file.c_str());
+  int any_fail;
+  MPI_Allreduce(&fail, &any_fail, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  return !any_fail;
+}
+
+int main(int argc, char* argv[]) {
+  pumipic::Library pic_lib(&argc, &argv);
+  Omega_h::Library& lib = pic_lib.omega_h_lib();
+  int comm_rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+  if (argc != 6) {
+    if (comm_rank == 0)
+      fprintf(stderr, "Usage: %s <mesh> <owner_file> <num planes> <num procs per group> "
+              "<output directory>\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+  xgcp::Input input(lib, argv[1], argv[2], atoi(argv[3]), atoi(argv[4]),
+                    pumipic::Input::getMethod("full"), pumipic::Input::getMethod("bfs"));
+  xgcp::Mesh mesh(input);
+  bool passed = true;
+  if (!testOutput(mesh, argv[5])) {
+    passed = false;
+    if (!comm_rank)
+      fprintf(stderr, "[ERROR] testOutput() failed\n");
+  }
+  if (!comm_rank && passed)
+    fprintf(stderr, "done\n");
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,300 @@
+#include <xgcp_mesh.hpp>
+#include <xgcp_particle.hpp>
+#include <xgcp_push.hpp>
+#include <particle_structs.hpp>
+#include <Omega_h_for.hpp>
+#include <cmath>
+
+using xgcp::PS_I;
+using xgcp::PS_E;
+
+namespace p = pumipic;
+namespace ps = particle_structs;
+namespace o = Omega_h;
+
+//Center of the flux surfaces of the 24k mesh
+const double h = 1.72479370-.08;
+const double k = .020558260;
+
+//Particles per owned element classified on a model face up to mdlFace
+int setSourceElements(p::Mesh* picparts, PS_I::kkLidView ppe, const int mdlFace) {
+  const int comm_rank = picparts->comm()->rank();
+  const auto elm_dim = picparts->dim();
+  o::Mesh* mesh = picparts->mesh();
+  auto class_ids = mesh->get_array<o::ClassId>(elm_dim, "class_id");
+  auto owners = picparts->entOwners(elm_dim);
+  o::Write<o::LO> ppe_write(mesh->nelems(), 0);
+  o::parallel_for(mesh->nelems(), OMEGA_H_LAMBDA(const o::LO& i) {
+    if (class_ids[i] <= mdlFace && owners[i] == comm_rank)
+      ppe_write[i] = 1 + i % 3;
+    ppe(i) = ppe_write[i];
+  });
+  return o::get_sum(o::LOs(ppe_write));
+}
+
+//Global ids of the elements of the picpart
+PS_I::kkGidView elementGids(xgcp::Mesh& mesh) {
+  PS_I::kkGidView element_gids("element_gids", mesh.nelems());
+  Omega_h::GOs mesh_element_gids = mesh.pumipicMesh()->globalIds(mesh.dim());
+  Omega_h::parallel_for(mesh.nelems(), OMEGA_H_LAMBDA(const int& i) {
+    element_gids(i) = mesh_element_gids[i];
+  });
+  return element_gids;
+}
+
+//Number of particles whose poloidal coordinates are outside of their element
+template <class PS>
+int countMisplaced(xgcp::Mesh& mesh, PS* ptcls) {
+  auto coords = mesh->coords();
+  auto faces2verts = mesh->ask_elem_verts();
+  auto x = ptcls->template get<xgcp::PTCL_COORDS>();
+  Kokkos::View<int*> misplaced("misplaced", 1);
+  auto checkPlacement = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if (mask) {
+      const auto verts = o::gather_verts<3>(faces2verts, e);
+      const auto vertCoords = o::gather_vectors<3, 2>(coords, verts);
+      o::Vector<2> pos;
+      pos[0] = x(pid, 0);
+      pos[1] = x(pid, 1);
+      const auto bcc = o::barycentric_from_global<2, 2>(pos, vertCoords);
+      if (bcc[0] < -1e-8 || bcc[1] < -1e-8 || bcc[2] < -1e-8)
+        Kokkos::atomic_fetch_add(&(misplaced(0)), 1);
+    }
+  };
+  ps::parallel_for(ptcls, checkPlacement, "count_misplaced");
+  return ps::getLastValue<int>(misplaced);
+}
+
+//Global sum of the poloidal distances of the particles to the center
+template <class PS>
+double sumRadii(xgcp::Mesh& mesh, PS* ptcls) {
+  auto x = ptcls->template get<xgcp::PTCL_COORDS>();
+  Kokkos::View<double*> sum("sum", 1);
+  auto sumRadius = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+    if (mask) {
+      const double dx = x(pid, 0) - h;
+      const double dy = x(pid, 1) - k;
+      Kokkos::atomic_fetch_add(&(sum(0)), sqrt(dx * dx + dy * dy));
+    }
+  };
+  ps::parallel_for(ptcls, sumRadius, "sum_radii");
+  double local = ps::getLastValue<double>(sum), total;
+  MPI_Allreduce(&local, &total, 1, MPI_DOUBLE, MPI_SUM, mesh.worldComm());
+  return total;
+}
+
+//Sums of the coordinates of the particles of the process
+template <class PS>
+void sumCoordinates(PS* ptcls, double sums[3]) {
+  auto x = ptcls->template get<xgcp::PTCL_COORDS>();
+  for (int i = 0; i < 3; ++i) {
+    Kokkos::View<double*> sum("sum", 1);
+    auto sumCoordinate = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+      if (mask)
+        Kokkos::atomic_fetch_add(&(sum(0)), (double)x(pid, i));
+    };
+    ps::parallel_for(ptcls, sumCoordinate, "sum_coordinates");
+    sums[i] = ps::getLastValue<double>(sum);
+  }
+}
+
+/* Electrons pulled toward the center over several substeps are kept, end inside their
+   elements and move
+*/
+bool testElectronSubcycle(xgcp::Mesh& mesh, const int mdlFace) {
+  const int rank = mesh.worldRank();
+  PS_E::kkLidView ptcls_per_elem("ptcls_per_elem", mesh.nelems());
+  const int np = setSourceElements(mesh.pumipicMesh(), ptcls_per_elem, mdlFace);
+  PS_E* electrons = xgcp::initializeElectrons(mesh, np, ptcls_per_elem, elementGids(mesh));
+  const ps::gid_t initial_count = xgcp::getGlobalParticleCount(electrons, mesh.worldComm());
+  const double initial_radii = sumRadii(mesh, electrons);
+
+  p::SearchContext context(*mesh.omegaMesh());
+  auto x = electrons->get<xgcp::PTCL_COORDS>();
+  auto xtgt = electrons->get<xgcp::PTCL_TARGET>();
+  auto pull = [&](int substep) {
+    auto pullToCenter = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+      if (mask) {
+        xtgt(pid, 0) = x(pid, 0) + .02 * (h - x(pid, 0));
+        xtgt(pid, 1) = x(pid, 1) + .02 * (k - x(pid, 1));
+        xtgt(pid, 2) = x(pid, 2);
+      }
+    };
+    ps::parallel_for(electrons, pullToCenter, "pull_to_center");
+  };
+  const int num_substeps = 4;
+  xgcp::subcycleElectrons(mesh, electrons, context, num_substeps, pull);
+
+  int fail = 0;
+  const ps::gid_t count = xgcp::getGlobalParticleCount(electrons, mesh.worldComm());
+  if (count != initial_count) {
+    if (!rank)
+      fprintf(stderr, "[ERROR] %ld electrons after subcycling instead of %ld\n",
+              (long)count, (long)initial_count);
+    fail = 1;
+  }
+  const int misplaced = countMisplaced(mesh, electrons);
+  if (misplaced) {
+    fprintf(stderr, "[ERROR] Process %d has %d electrons outside of their elements\n",
+            rank, misplaced);
+    fail = 1;
+  }
+  const double radii = sumRadii(mesh, electrons);
+  if (radii >= initial_radii) {
+    if (!rank)
+      fprintf(stderr, "[ERROR] Subcycled electrons did not move toward the center, the sum of "
+              "their radii is %f (%f initially)\n", radii, initial_radii);
+    fail = 1;
+  }
+  delete electrons;
+  int any_fail;
+  MPI_Allreduce(&fail, &any_fail, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  return !any_fail;
+}
+
+/* Ions pushed across the planes reach the same processes with the torodial then mesh
+   stages of the hierarchical migration as with the direct migration
+*/
+bool testHierarchicalMigration(xgcp::Input& input, const int mdlFace) {
+  input.setHierarchicalMigration(false);
+  xgcp::Mesh direct_mesh(input);
+  input.setHierarchicalMigration(true);
+  xgcp::Mesh staged_mesh(input);
+  input.setHierarchicalMigration(false);
+  const int rank = staged_mesh.worldRank();
+  if (!staged_mesh.hierarchicalMigration()) {
+    fprintf(stderr, "[ERROR] Process %d: the mesh does not use the hierarchical migration\n",
+            rank);
+    return false;
+  }
+
+  PS_I::kkLidView ptcls_per_elem("ptcls_per_elem", direct_mesh.nelems());
+  const int np = setSourceElements(direct_mesh.pumipicMesh(), ptcls_per_elem, mdlFace);
+  PS_I* direct = xgcp::initializeIons(direct_mesh, np, ptcls_per_elem,
+                                      elementGids(direct_mesh));
+  PS_I* staged = xgcp::initializeIons(staged_mesh, np, ptcls_per_elem,
+                                      elementGids(staged_mesh));
+
+  //Large steps so ions leave their torodial section
+  const double d = 0.6;
+  const double degPerPush = 20;
+  xgcp::ellipticalPush::setup(direct, h, k, d);
+  xgcp::ellipticalPush::setup(staged, h, k, d);
+  for (int iter = 0; iter < 3; ++iter) {
+    xgcp::ellipticalPush::push(direct, *direct_mesh.omegaMesh(), degPerPush, iter);
+    xgcp::search(direct_mesh, direct);
+    xgcp::ellipticalPush::push(staged, *staged_mesh.omegaMesh(), degPerPush, iter);
+    xgcp::search(staged_mesh, staged);
+  }
+
+  int fail = 0;
+  const ps::gid_t count = xgcp::getGlobalParticleCount(staged, MPI_COMM_WORLD);
+  const ps::gid_t direct_count = xgcp::getGlobalParticleCount(direct, MPI_COMM_WORLD);
+  if (count != direct_count) {
+    if (!rank)
+      fprintf(stderr, "[ERROR] %ld ions after the hierarchical migrations instead of %ld\n",
+              (long)count, (long)direct_count);
+    fail = 1;
+  }
+  if (staged->nPtcls() != direct->nPtcls()) {
+    fprintf(stderr, "[ERROR] Process %d has %d ions with the hierarchical migration instead "
+            "of %d\n", rank, staged->nPtcls(), direct->nPtcls());
+    fail = 1;
+  }
+  double direct_sums[3], staged_sums[3];
+  sumCoordinates(direct, direct_sums);
+  sumCoordinates(staged, staged_sums);
+  for (int i = 0; i < 3; ++i) {
+    if (fabs(direct_sums[i] - staged_sums[i]) > 1e-10 * (1 + fabs(direct_sums[i]))) {
+      fprintf(stderr, "[ERROR] Process %d: hierarchical coordinate %d sums to %f instead of "
+              "%f\n", rank, i, staged_sums[i], direct_sums[i]);
+      fail = 1;
+    }
+  }
+  delete direct;
+  delete staged;
+  int any_fail;
+  MPI_Allreduce(&fail, &any_fail, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  return !any_fail;
+}
+
+/* Ions created only on the first process of each group are spread evenly over the group
+   and keep their elements
+*/
+bool testBalanceGroup(xgcp::Mesh& mesh, const int mdlFace) {
+  const int rank = mesh.worldRank();
+  const int gr = mesh.groupRank(), gs = mesh.groupSize();
+  PS_I::kkLidView ptcls_per_elem("ptcls_per_elem", mesh.nelems());
+  int np = setSourceElements(mesh.pumipicMesh(), ptcls_per_elem, mdlFace);
+  if (gr != 0) {
+    Kokkos::deep_copy(ptcls_per_elem, 0);
+    np = 0;
+  }
+  PS_I* ions = xgcp::initializeIons(mesh, np, ptcls_per_elem, elementGids(mesh));
+  const ps::gid_t total = xgcp::getGlobalParticleCount(ions, mesh.groupComm());
+
+  xgcp::balanceGroup(mesh, ions);
+
+  int fail = 0;
+  const ps::gid_t count = xgcp::getGlobalParticleCount(ions, mesh.groupComm());
+  if (count != total) {
+    fprintf(stderr, "[ERROR] Process %d: the group has %ld ions after balancing instead of "
+            "%ld\n", rank, (long)count, (long)total);
+    fail = 1;
+  }
+  const ps::gid_t expected = total / gs + (gr < total % gs);
+  if (ions->nPtcls() != expected) {
+    fprintf(stderr, "[ERROR] Process %d has %d ions after balancing instead of %ld\n",
+            rank, ions->nPtcls(), (long)expected);
+    fail = 1;
+  }
+  const int misplaced = countMisplaced(mesh, ions);
+  if (misplaced) {
+    fprintf(stderr, "[ERROR] Process %d has %d balanced ions outside of their elements\n",
+            rank, misplaced);
+    fail = 1;
+  }
+  delete ions;
+  int any_fail;
+  MPI_Allreduce(&fail, &any_fail, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+  return !any_fail;
+}
+
+int main(int argc, char* argv[]) {
+  pumipic::Library pic_lib(&argc, &argv);
+  Omega_h::Library& lib = pic_lib.omega_h_lib();
+  int comm_rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+  if (argc != 6) {
+    if (comm_rank == 0)
+      fprintf(stderr, "Usage: %s <mesh> <owner_file> <num planes> <num procs per group> "
+              "<max initial model face>\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+  xgcp::Input input(lib, argv[1], argv[2], atoi(argv[3]), atoi(argv[4]),
+                    pumipic::Input::getMethod("full"), pumipic::Input::getMethod("bfs"));
+  const int mdlFace = atoi(argv[5]);
+  bool passed = true;
+  {
+    xgcp::Mesh mesh(input);
+    if (!testElectronSubcycle(mesh, mdlFace)) {
+      passed = false;
+      if (!comm_rank)
+        fprintf(stderr, "[ERROR] testElectronSubcycle() failed\n");
+    }
+    if (!testBalanceGroup(mesh, mdlFace)) {
+      passed = false;
+      if (!comm_rank)
+        fprintf(stderr, "[ERROR] testBalanceGroup() failed\n");
+    }
+  }
+  if (!testHierarchicalMigration(input, mdlFace)) {
+    passed = false;
+    if (!comm_rank)
+      fprintf(stderr, "[ERROR] testHierarchicalMigration() failed\n");
+  }
+  if (!comm_rank && passed)
+    fprintf(stderr, "done\n");
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,188 @@
+#include <xgcp_mesh.hpp>
+#include <xgcp_push.hpp>
+#include <xgcp_gyro_scatter.hpp>
+#include <xgcp_particle.hpp>
+#include <xgcp_pipeline.hpp>
+#include <particle_structs.hpp>
+#include <Omega_h_for.hpp>
+#include <cmath>
+
+using xgcp::PS_I;
+
+namespace p = pumipic;
+namespace ps = particle_structs;
+namespace o = Omega_h;
+
+//Particles per owned element classified on a model face up to mdlFace
+int setSourceElements(p::Mesh* picparts, PS_I::kkLidView ppe, const int mdlFace);
+//Sums of the coordinates of the particles
+void sumCoordinates(PS_I* ptcls, double sums[3]);
+//Clears the gyro fields of the mesh, the scatter adds to them
+void zeroGyroFields(xgcp::Mesh& mesh);
+//Copies of the gyro fields of the mesh
+void copyGyroFields(xgcp::Mesh& mesh, o::Reals& major, o::Reals& minor);
+//Largest difference between two fields across the processes
+double maxDifference(o::Reals a, o::Reals b);
+
+/* Runs one timestep of push, search and gyro scatter on two identical ion structures,
+   one through the serial calls and one through the stages of a Pipeline, and checks that
+   the particles and gyro fields match
+*/
+int main(int argc, char* argv[]) {
+  pumipic::Library pic_lib(&argc, &argv);
+  Omega_h::Library& lib = pic_lib.omega_h_lib();
+  int comm_rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
+  if (argc != 6) {
+    if (comm_rank == 0)
+      fprintf(stderr, "Usage: %s <mesh> <owner_file> <num planes> <num procs per group> "
+              "<max initial model face>\n", argv[0]);
+    MPI_Finalize();
+    return EXIT_FAILURE;
+  }
+  xgcp::Input input(lib, argv[1], argv[2], atoi(argv[3]), atoi(argv[4]),
+                    pumipic::Input::getMethod("full"), pumipic::Input::getMethod("bfs"));
+  xgcp::Mesh mesh(input);
+  p::Mesh* picparts = mesh.pumipicMesh();
+  o::Mesh* omesh = mesh.omegaMesh();
+
+  const o::LO ne = mesh.nelems();
+  PS_I::kkLidView ptcls_per_elem("ptcls_per_elem", ne);
+  PS_I::kkGidView element_gids("element_gids", ne);
+  Omega_h::GOs mesh_element_gids = picparts->globalIds(mesh.dim());
+  Omega_h::parallel_for(ne, OMEGA_H_LAMBDA(const int& i) {
+    element_gids(i) = mesh_element_gids[i];
+  });
+  const int np = setSourceElements(picparts, ptcls_per_elem, atoi(argv[5]));
+
+  const double h = 1.72479370-.08;
+  const double k = .020558260;
+  const double d = 0.6;
+  const double degPerPush = 0.5;
+  PS_I* serial = xgcp::initializeIons(mesh, np, ptcls_per_elem, element_gids);
+  PS_I* pipelined = xgcp::initializeIons(mesh, np, ptcls_per_elem, element_gids);
+  xgcp::ellipticalPush::setup(serial, h, k, d);
+  xgcp::ellipticalPush::setup(pipelined, h, k, d);
+
+  //Serial timestep
+  zeroGyroFields(mesh);
+  p::SearchContext serial_context(*omesh);
+  xgcp::ellipticalPush::push(serial, *omesh, degPerPush, 1);
+  xgcp::search(mesh, serial, serial_context);
+  xgcp::gyroScatter(mesh, serial);
+  o::Reals serial_major, serial_minor;
+  copyGyroFields(mesh, serial_major, serial_minor);
+
+  //Pipelined timestep
+  zeroGyroFields(mesh);
+  xgcp::Pipeline step(1);
+  pipelined->setExecutionSpace(step.executionSpace(0));
+  p::SearchContext context(*omesh);
+  xgcp::SearchHandle<PS_I> handle;
+  const int push = step.addStage("ion_push", 0, [&]() {
+    xgcp::ellipticalPush::push(pipelined, *omesh, degPerPush, 1);
+  });
+  const int search = step.addStage("ion_search", 0,
+                                   [&]() {xgcp::searchBegin(mesh, pipelined, context, handle);},
+                                   [&]() {xgcp::searchEnd(mesh, pipelined, handle);}, {push});
+  step.addStage("ion_scatter", 0, [&]() {xgcp::gyroScatter(mesh, pipelined);},
+                xgcp::Pipeline::Work(), {search});
+  step.run();
+  o::Reals pipelined_major, pipelined_minor;
+  copyGyroFields(mesh, pipelined_major, pipelined_minor);
+  if (comm_rank == 0)
+    step.printTimes();
+
+  int fail = 0;
+  if (serial->nPtcls() != pipelined->nPtcls()) {
+    fprintf(stderr, "[ERROR] Process %d has %d pipelined particles instead of %d\n",
+            comm_rank, pipelined->nPtcls(), serial->nPtcls());
+    fail = 1;
+  }
+  double serial_sums[3], pipelined_sums[3];
+  sumCoordinates(serial, serial_sums);
+  sumCoordinates(pipelined, pipelined_sums);
+  for (int i = 0; i < 3; ++i) {
+    if (fabs(serial_sums[i] - pipelined_sums[i]) > 1e-10 * (1 + fabs(serial_sums[i]))) {
+      fprintf(stderr, "[ERROR] Process %d: pipelined coordinate %d sums to %f instead of %f\n",
+              comm_rank, i, pipelined_sums[i], serial_sums[i]);
+      fail = 1;
+    }
+  }
+  const double major_diff = maxDifference(serial_major, pipelined_major);
+  const double minor_diff = maxDifference(serial_minor, pipelined_minor);
+  if (major_diff > 1e-10 || minor_diff > 1e-10) {
+    if (comm_rank == 0)
+      fprintf(stderr, "[ERROR] Pipelined gyro fields differ by %e (major) and %e (minor)\n",
+              major_diff, minor_diff);
+    fail = 1;
+  }
+  int any_fail;
+  MPI_Allreduce(&fail, &any_fail, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+  delete serial;
+  delete pipelined;
+  if (!comm_rank && !any_fail)
+    fprintf(stderr, "done\n");
+  return any_fail ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+int setSourceElements(p::Mesh* picparts, PS_I::kkLidView ppe, const int mdlFace) {
+  const int comm_rank = picparts->comm()->rank();
+  const auto elm_dim = picparts->dim();
+  o::Mesh* mesh = picparts->mesh();
+  auto class_ids = mesh->get_array<o::ClassId>(elm_dim, "class_id");
+  auto owners = picparts->entOwners(elm_dim);
+  o::Write<o::LO> ppe_write(mesh->nelems(), 0);
+  o::parallel_for(mesh->nelems(), OMEGA_H_LAMBDA(const o::LO& i) {
+    if (class_ids[i] <= mdlFace && owners[i] == comm_rank)
+      ppe_write[i] = 1 + i % 3;
+    ppe(i) = ppe_write[i];
+  });
+  return o::get_sum(o::LOs(ppe_write));
+}
+
+void sumCoordinates(PS_I* ptcls, double sums[3]) {
+  auto x = ptcls->get<xgcp::PTCL_COORDS>();
+  for (int i = 0; i < 3; ++i) {
+    Kokkos::View<double*> sum("sum", 1);
+    auto sumCoordinate = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+      if (mask)
+        Kokkos::atomic_fetch_add(&(sum(0)), (double)x(pid, i));
+    };
+    ps::parallel_for(ptcls, sumCoordinate);
+    sums[i] = ps::getLastValue<double>(sum);
+  }
+}
+
+void zeroGyroFields(xgcp::Mesh& mesh) {
+  xgcp::Mesh::GyroField major_plane, minor_plane;
+  mesh.getGyroFields(major_plane, minor_plane);
+  o::parallel_for(major_plane.size(), OMEGA_H_LAMBDA(const o::LO& i) {
+    major_plane[i] = 0;
+    minor_plane[i] = 0;
+  });
+}
+
+void copyGyroFields(xgcp::Mesh& mesh, o::Reals& major, o::Reals& minor) {
+  xgcp::Mesh::GyroField major_plane, minor_plane;
+  mesh.getGyroFields(major_plane, minor_plane);
+  major = o::deep_copy(o::Reals(major_plane));
+  minor = o::deep_copy(o::Reals(minor_plane));
+}
+
+double maxDifference(o::Reals a, o::Reals b) {
+  double diff = 0;
+  if (a.size() != b.size())
+    diff = 1;
+  else if (a.size() > 0) {
+    o::Write<o::Real> differences(a.size());
+    o::parallel_for(a.size(), OMEGA_H_LAMBDA(const o::LO& i) {
+      differences[i] = fabs(a[i] - b[i]) / (1 + fabs(a[i]));
+    });
+    diff = o::get_max(o::Reals(differences));
+  }
+  double max_diff;
+  MPI_Allreduce(&diff, &max_diff, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  return max_diff;
+}
@@ -33,6 +33,17 @@ mpi_test(pseudoPushAndSearch_cube_t2 1
 mpi_test(search2d 1 ./search2d
   ${TEST_DATA_DIR})
 
+mpi_test(deposit 1 ./deposit
+  ${TEST_DATA_DIR})
+
+mpi_test(search 1 ./search
+  ${TEST_DATA_DIR})
+mpi_test(search_4 4 ./search
+  ${TEST_DATA_DIR})
+
+mpi_test(push 1 ./push
+  ${TEST_DATA_DIR})
+
 mpi_test(pseudoXGCm_scatter 1
   ./pseudoXGCm_scatter --kokkos-threads=1
   ${TEST_DATA_DIR}/plate/tri8_parDiag.osh)
@@ -55,6 +66,11 @@ mpi_test(pseudoXGCm_120kElms_4 4
   ${TEST_DATA_DIR}/xgc/120k.osh ${TEST_DATA_DIR}/xgc/120k_4.cpn
   10000 141 10 full bfs 0.5 0)
 
+mpi_test(bench_push_elliptical_24kElms_4 4
+  ./bench_push --kokkos-threads=1
+  ${TEST_DATA_DIR}/xgc/24k.osh ${TEST_DATA_DIR}/xgc/24k_4.cpn
+  elliptical_even ptcls=1000 steps=3 output=bench_push_elliptical_24k_4.json)
+
 mpi_test(XGCp_24kElms_1m_2p_2g 4
   ./XGCp --kokkos-threads=1
   ${TEST_DATA_DIR}/xgc/24k.osh ${TEST_DATA_DIR}/xgc/24k_4.cpn
@@ -65,12 +81,45 @@ mpi_test(XGCp_24kElms_4m_2p_1g 8
   ${TEST_DATA_DIR}/xgc/24k.osh ${TEST_DATA_DIR}/xgc/24k_4.cpn
   1000 2 1 51 100 full bfs 0.5 0 0)
 
+mpi_test(XGCp_24kElms_4m_2p_1g_deferred_migration 8
+  ./XGCp --kokkos-threads=1
+  ${TEST_DATA_DIR}/xgc/24k.osh ${TEST_DATA_DIR}/xgc/24k_4.cpn
+  1000 2 1 51 100 bfs bfs 0.5 0 0 5 2)
+
+mpi_test(xgcp_pipeline_24kElms_1m_2p_2g 4
+  ./xgcp_pipeline --kokkos-threads=1
+  ${TEST_DATA_DIR}/xgc/24k.osh ${TEST_DATA_DIR}/xgc/24k_4.cpn 2 2 51)
+
+mpi_test(xgcp_gyro_24kElms_1m_2p_2g 4
+  ./xgcp_gyro --kokkos-threads=1
+  ${TEST_DATA_DIR}/xgc/24k.osh ${TEST_DATA_DIR}/xgc/24k_4.cpn 2 2 .)
+
+mpi_test(xgcp_particles_24kElms_1m_2p_2g 4
+  ./xgcp_particles --kokkos-threads=1
+  ${TEST_DATA_DIR}/xgc/24k.osh ${TEST_DATA_DIR}/xgc/24k_4.cpn 2 2 51)
+
+mpi_test(bench_xgcp_migrate_direct_24kElms_4m_2p_1g 8
+  ./bench_xgcp_migrate --kokkos-threads=1
+  ${TEST_DATA_DIR}/xgc/24k.osh ${TEST_DATA_DIR}/xgc/24k_4.cpn 2 1
+  direct 3 20 bench_xgcp_migrate_direct_24k.json)
+mpi_test(bench_xgcp_migrate_hierarchical_24kElms_4m_2p_1g 8
+  ./bench_xgcp_migrate --kokkos-threads=1
+  ${TEST_DATA_DIR}/xgc/24k.osh ${TEST_DATA_DIR}/xgc/24k_4.cpn 2 1
+  hierarchical 3 20 bench_xgcp_migrate_hierarchical_24k.json)
+
+mpi_test(xgcp_output_24kElms_1m_2p_2g 4
+  ./xgcp_output --kokkos-threads=1
+  ${TEST_DATA_DIR}/xgc/24k.osh ${TEST_DATA_DIR}/xgc/24k_4.cpn 2 2 .)
+
 #MPI+X testing
 mpi_test(print_partition_cube_2 2 ./print_partition ${TEST_DATA_DIR}/cube.msh testing_cube)
 mpi_test(ptn_loading_cube 2 ./ptn_loading ${TEST_DATA_DIR}/cube.msh testing_cube_2.ptn 1 3)
 
 mpi_test(print_partition_cube_4 4 ./print_partition ${TEST_DATA_DIR}/cube.msh testing_cube)
 mpi_test(ptn_loading_cube_4 4 ./ptn_loading ${TEST_DATA_DIR}/cube.msh testing_cube_4.ptn 1 3)
+mpi_test(convert_partition_cube_4 1 ./convert_partition testing_cube_4.ptn testing_cube_4.bpn)
+mpi_test(binary_partition_cube_4 4
+         ./binary_partition ${TEST_DATA_DIR}/cube.msh testing_cube_4.ptn testing_cube_4.bpn)
 
 mpi_test(print_partition_pisces_4 4
          ./print_partition ${TEST_DATA_DIR}/pisces/gitr.msh testing_pisces)
@@ -85,3 +134,11 @@ mpi_test(input_construct_cube 4
 
 mpi_test(comm_array_pisces 4
          ./comm_array ${TEST_DATA_DIR}/pisces/gitr.msh testing_pisces_4.ptn)
+mpi_test(bench_comm_cube_4 4
+         ./bench_comm ${TEST_DATA_DIR}/cube.msh testing_cube_4.ptn BFS BFS 2 bench_comm_cube_4.json)
+mpi_test(bench_push_boris_cube_4 4
+         ./bench_push ${TEST_DATA_DIR}/cube.msh testing_cube_4.ptn
+         boris_exponential_3species ptcls=1000 steps=3 search=walk output=bench_push_cube_4.json)
+
+mpi_test(distributed_construct_cube_4 4
+         ./distributed_construct ${TEST_DATA_DIR}/cube.msh)
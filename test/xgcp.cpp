@@ -35,7 +35,7 @@ int main(int argc, char* argv[]) {
   MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
   MPI_Comm_size(MPI_COMM_WORLD, &comm_size);
   const int numargs = 13;
-  if( argc != numargs ) {
+  if( argc != numargs && argc != numargs + 2 ) {
     if (comm_rank == 0) {
       printf("numargs %d expected %d\n", argc, numargs);
       auto args = " <mesh> <owner_file> <numPtcls> "
@@ -43,7 +43,8 @@ int main(int argc, char* argv[]) {
         "<max initial model face> <maxIterations> "
         "<buffer method=[bfs|full]> <safe method=[bfs|full]> "
         "<degrees per elliptical push> "
-        "<enable prebarrier> <enable rendering>";
+        "<enable prebarrier> <enable rendering> "
+        "[<searches per migration> <migration layers>]";
       std::cout << "Usage: " << argv[0] << args << "\n";
     }
     exit(1);
@@ -72,6 +73,8 @@ int main(int argc, char* argv[]) {
   int num_processes_per_group = atoi(argv[5]);
   xgcp::Input input(lib, mesh_file, partition_file, num_planes, num_processes_per_group,
                     bufferMethod, safeMethod);
+  if (argc == numargs + 2)
+    input.setMigrationPolicy(atoi(argv[13]), atoi(argv[14]));
   xgcp::Mesh mesh(input);
   p::Mesh* picparts = mesh.pumipicMesh();
   o::Mesh* omesh = mesh.omegaMesh();
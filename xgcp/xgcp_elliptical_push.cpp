@@ -5,69 +5,168 @@
 namespace xgcp {
   namespace ellipticalPush {
     double h,k,d;
+    namespace {
+      typedef ps::SellCSigma<Ion> SCS_I;
+
+      //Kernels of each step templated on the structure, see the public functions below
+      template <class PS>
+      void setupIons(PS* ptcls) {
+        auto x_nm1 = ptcls->template get<PTCL_COORDS>();
+        auto ptcl_b = ptcls->template get<ION_B>();
+        auto ptcl_phi = ptcls->template get<ION_PHI>();
+        const auto h_d = h;
+        const auto k_d = k;
+        const auto d_d = d;
+        auto setMajorAxis = PS_LAMBDA(const int&, const int& pid, const int& mask) {
+          if(mask) {
+            const auto w = x_nm1(pid,0);
+            const auto z = x_nm1(pid,1);
+            const auto v = std::sqrt(std::pow(w-h_d,2) + std::pow(z-k_d,2));
+            const auto phi = atan2(d_d*(z-k_d),w-h_d);
+            const auto b = (z - k_d)/sin(phi);
+            ptcl_phi(pid) = phi;
+            ptcl_b(pid) = b;
+          }
+        };
+        ps::parallel_for(ptcls, setMajorAxis);
+      }
+
+      template <class PS>
+      void pushIons(PS* ptcls, Omega_h::Mesh& m, const double deg) {
+        const auto btime = pumipic_prebarrier();
+        Kokkos::Profiling::pushRegion("ellipticalPush");
+        Kokkos::Timer timer;
+        int rank, comm_size;
+        MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+        MPI_Comm_size(MPI_COMM_WORLD,&comm_size);
+        auto class_ids = m.get_array<Omega_h::ClassId>(m.dim(), "class_id");
+        auto x_c = ptcls->template get<PTCL_COORDS>();
+        auto x_nm0 = ptcls->template get<PTCL_TARGET>();
+        auto ptcl_b = ptcls->template get<ION_B>();
+        auto ptcl_phi = ptcls->template get<ION_PHI>();
+        const auto h_d = h;
+        const auto k_d = k;
+        const auto d_d = d;
+        auto setPosition = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+          if(mask) {
+            const double centerFactor = class_ids[e] == 1 ? 0.01 : 1.0;
+            const double distByClass = centerFactor * (double) 1.0 / class_ids[e];
+            const auto degP = deg*distByClass;
+            const auto phi = ptcl_phi(pid);
+            const auto b = ptcl_b(pid);
+            const auto a = b*d_d;
+            const auto rad = phi+degP*M_PI/180.0;
+            const auto x = a*std::cos(rad)+h_d;
+            const auto y = b*std::sin(rad)+k_d;
+            x_nm0(pid,0) = x;
+            x_nm0(pid,1) = y;
+            x_nm0(pid,2) = x_c(pid, 2) + degP * M_PI/180.0;
+            x_nm0(pid,2) -= (x_nm0(pid,2) > M_PI * 2) * M_PI * 2;
+            ptcl_phi(pid) = rad;
+          }
+        };
+        ps::parallel_for(ptcls, setPosition);
+        if(!rank || rank == comm_size/2)
+          fprintf(stderr, "%d elliptical push (seconds) %f pre-barrier (seconds) %f\n",
+                  rank, timer.seconds(), btime);
+        Kokkos::Profiling::popRegion();
+      }
+
+      template <class PS>
+      void pushFusedIons(PS* ptcls, pumipic::SearchContext& search, Omega_h::Mesh& m,
+                         const double deg) {
+        const auto btime = pumipic_prebarrier();
+        Kokkos::Profiling::pushRegion("ellipticalPushFused");
+        Kokkos::Timer timer;
+        int rank, comm_size;
+        MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+        MPI_Comm_size(MPI_COMM_WORLD,&comm_size);
+        auto class_ids = m.get_array<Omega_h::ClassId>(m.dim(), "class_id");
+        //The angle of a step only depends on the element
+        const Omega_h::LO nelems = m.nelems();
+        Omega_h::Write<float> step_rad(nelems, "elliptical_step_rad");
+        Omega_h::Write<float> step_cos(nelems, "elliptical_step_cos");
+        Omega_h::Write<float> step_sin(nelems, "elliptical_step_sin");
+        auto setSteps = OMEGA_H_LAMBDA(const Omega_h::LO& e) {
+          const double centerFactor = class_ids[e] == 1 ? 0.01 : 1.0;
+          const double distByClass = centerFactor * (double) 1.0 / class_ids[e];
+          const float rad = deg*distByClass*M_PI/180.0;
+          step_rad[e] = rad;
+          step_cos[e] = std::cos(rad);
+          step_sin[e] = std::sin(rad);
+        };
+        Omega_h::parallel_for(nelems, setSteps, "elliptical_steps");
+
+        auto x_c = ptcls->template get<PTCL_COORDS>();
+        auto x_nm0 = ptcls->template get<PTCL_TARGET>();
+        auto ptcl_b = ptcls->template get<ION_B>();
+        auto ptcl_phi = ptcls->template get<ION_PHI>();
+        const float h_d = h;
+        const float k_d = k;
+        const float d_d = d;
+        Omega_h::Write<Omega_h::I8> stayed(ptcls->capacity(), 0, "elliptical_stayed");
+        const auto elem_verts = search.elem_verts;
+        const auto coords = search.coords;
+        const auto tri_area = search.tri_area;
+        auto setPosition = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+          if(mask) {
+            const float phi = ptcl_phi(pid);
+            const float b = ptcl_b(pid);
+            const float a = b*d_d;
+            //cos and sin of phi + step from the trig of the step
+            const float c = std::cos(phi);
+            const float s = std::sin(phi);
+            const float cos_rad = c*step_cos[e] - s*step_sin[e];
+            const float sin_rad = s*step_cos[e] + c*step_sin[e];
+            x_nm0(pid,0) = a*cos_rad+h_d;
+            x_nm0(pid,1) = b*sin_rad+k_d;
+            x_nm0(pid,2) = x_c(pid, 2) + step_rad[e];
+            x_nm0(pid,2) -= (x_nm0(pid,2) > M_PI * 2) * M_PI * 2;
+            ptcl_phi(pid) = phi + step_rad[e];
+            const auto faceVerts = Omega_h::gather_verts<3>(elem_verts, e);
+            const auto faceCoords = Omega_h::gather_vectors<3,2>(coords, faceVerts);
+            int edge;
+            stayed[pid] = pumipic::tri_contains(tri_area, faceCoords,
+                                                pumipic::makeVector2(pid, x_nm0), e, true,
+                                                EPSILON, edge);
+          }
+        };
+        ps::parallel_for(ptcls, setPosition);
+        search.setStayed(stayed);
+        if(!rank || rank == comm_size/2)
+          fprintf(stderr, "%d elliptical fused push (seconds) %f pre-barrier (seconds) %f\n",
+                  rank, timer.seconds(), btime);
+        Kokkos::Profiling::popRegion();
+      }
+    }
+
+    /* The structure is resolved once per step so the kernels of the step are dispatched
+       statically on a SellCSigma
+    */
     void setup(PS_I* ptcls, const double h_, const double k_, const double d_) {
       h = h_;
       k = k_;
       d = d_;
-      auto x_nm1 = ptcls->get<PTCL_COORDS>();
-      auto ptcl_id = ptcls->get<PTCL_IDS>();
-      auto ptcl_b = ptcls->get<ION_B>();
-      auto ptcl_phi = ptcls->get<ION_PHI>();
-      const auto h_d = h;
-      const auto k_d = k;
-      const auto d_d = d;
-      auto setMajorAxis = PS_LAMBDA(const int&, const int& pid, const int& mask) {
-        if(mask) {
-          const auto w = x_nm1(pid,0);
-          const auto z = x_nm1(pid,1);
-          const auto v = std::sqrt(std::pow(w-h_d,2) + std::pow(z-k_d,2));
-          const auto phi = atan2(d_d*(z-k_d),w-h_d);
-          const auto b = (z - k_d)/sin(phi);
-          ptcl_phi(pid) = phi;
-          ptcl_b(pid) = b;
-        }
-      };
-      ps::parallel_for(ptcls, setMajorAxis);
+      SCS_I* scs = dynamic_cast<SCS_I*>(ptcls);
+      if (scs)
+        setupIons(scs);
+      else
+        setupIons(ptcls);
     }
     void push(PS_I* ptcls, Omega_h::Mesh& m, const double deg, const int iter) {
-      const auto btime = pumipic_prebarrier();
-      Kokkos::Profiling::pushRegion("ellipticalPush");
-      Kokkos::Timer timer;
-      int rank, comm_size;
-      MPI_Comm_rank(MPI_COMM_WORLD,&rank);
-      MPI_Comm_size(MPI_COMM_WORLD,&comm_size);
-      auto class_ids = m.get_array<Omega_h::ClassId>(m.dim(), "class_id");
-      auto x_c = ptcls->get<PTCL_COORDS>();
-      auto x_nm0 = ptcls->get<PTCL_TARGET>();
-      auto ptcl_id = ptcls->get<PTCL_IDS>();
-      auto ptcl_b = ptcls->get<ION_B>();
-      auto ptcl_phi = ptcls->get<ION_PHI>();
-      const auto h_d = h;
-      const auto k_d = k;
-      const auto d_d = d;
-      auto setPosition = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
-        if(mask) {
-          const double centerFactor = class_ids[e] == 1 ? 0.01 : 1.0;
-          const double distByClass = centerFactor * (double) 1.0 / class_ids[e];
-          const auto degP = deg*distByClass;
-          const auto phi = ptcl_phi(pid);
-          const auto b = ptcl_b(pid);
-          const auto a = b*d_d;
-          const auto rad = phi+degP*M_PI/180.0;
-          const auto x = a*std::cos(rad)+h_d;
-          const auto y = b*std::sin(rad)+k_d;
-          x_nm0(pid,0) = x;
-          x_nm0(pid,1) = y;
-          x_nm0(pid,2) = x_c(pid, 2) + degP * M_PI/180.0;
-          x_nm0(pid,2) -= (x_nm0(pid,2) > M_PI * 2) * M_PI * 2;
-          ptcl_phi(pid) = rad;
-        }
-      };
-      ps::parallel_for(ptcls, setPosition);
-      if(!rank || rank == comm_size/2)
-        fprintf(stderr, "%d elliptical push (seconds) %f pre-barrier (seconds) %f\n",
-                rank, timer.seconds(), btime);
-      Kokkos::Profiling::popRegion();
+      SCS_I* scs = dynamic_cast<SCS_I*>(ptcls);
+      if (scs)
+        pushIons(scs, m, deg);
+      else
+        pushIons(ptcls, m, deg);
+    }
+    void pushFused(PS_I* ptcls, pumipic::SearchContext& search, Omega_h::Mesh& m,
+                   const double deg, const int iter) {
+      SCS_I* scs = dynamic_cast<SCS_I*>(ptcls);
+      if (scs)
+        pushFusedIons(scs, search, m, deg);
+      else
+        pushFusedIons(ptcls, search, m, deg);
     }
   }
 }
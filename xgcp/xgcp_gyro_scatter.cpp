@@ -1,6 +1,11 @@
 #include "xgcp_gyro_scatter.hpp"
-#include <pumipic_adjacency.hpp>
+#include <pumipic_point_locator.hpp>
 #include <Omega_h_for.hpp>
+#include <Omega_h_sort.hpp>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
 
 namespace xgcp {
   using GyroField=Mesh::GyroField;
@@ -12,9 +17,71 @@ namespace xgcp {
     o::LO gyro_points_per_ring = 8;
     o::Real gyro_theta = 0;
 
-    typedef ps::MemberTypes<Vector3d, Vector3d, int> Point;
-    typedef ps::ParticleStructure<Point> PSpt;
+    //Leading bytes and version of a gyro map cache file
+    const char gyro_cache_magic[8] = {'X', 'G', 'C', 'P', 'G', 'Y', 'R', '\0'};
+    const int gyro_cache_version = 1;
 
+    std::uint64_t hashBytes(std::uint64_t hash, const void* data, std::size_t bytes) {
+      const unsigned char* values = static_cast<const unsigned char*>(data);
+      for (std::size_t i = 0; i < bytes; ++i) {
+        hash ^= values[i];
+        hash *= 1099511628211ULL;
+      }
+      return hash;
+    }
+    template <typename T>
+    std::uint64_t hashArray(std::uint64_t hash, o::Read<T> array) {
+      o::HostRead<T> array_h(array);
+      const int size = array_h.size();
+      hash = hashBytes(hash, &size, sizeof(int));
+      if (size)
+        hash = hashBytes(hash, array_h.data(), size * sizeof(T));
+      return hash;
+    }
+
+    GyroScatterEngine gyro_engine = GYRO_SCATTER_AUTO;
+    double gyro_sort_threshold = 16;
+
+    //Lower ring crossed by a particle, it also contributes to the ring above
+    PS_INLINE int ringBelow(double ringWidth, int gnr) {
+      const auto ptclRadius = ringWidth*1.125; //TODO compute the radius
+      assert(ptclRadius >= ringWidth);
+      int ringDown = 0;
+      for(int i=2; i<=gnr; i++)
+        ringDown += (ptclRadius >= ringWidth*i);
+      assert(ringDown+1<gnr);
+      return ringDown;
+    }
+
+    //First index of the ascending array with a value of at least value
+    OMEGA_H_INLINE o::LO lowerBound(const o::Write<o::LO>& sorted, o::LO size, o::LO value) {
+      o::LO lo = 0, hi = size;
+      while (lo < hi) {
+        const o::LO mid = (lo + hi) / 2;
+        if (sorted[mid] < value)
+          lo = mid + 1;
+        else
+          hi = mid;
+      }
+      return lo;
+    }
+
+    bool writeMap(FILE* file, o::LOs map) {
+      o::HostRead<o::LO> map_h(map);
+      const int size = map_h.size();
+      return fwrite(&size, sizeof(int), 1, file) == 1 &&
+        (size == 0 || fwrite(map_h.data(), sizeof(o::LO), size, file) == (std::size_t)size);
+    }
+    bool readMap(FILE* file, o::LOs& map) {
+      int size;
+      if (fread(&size, sizeof(int), 1, file) != 1 || size < 0)
+        return false;
+      o::HostWrite<o::LO> map_h(size, "cached_gyro_map");
+      if (size && fread(map_h.data(), sizeof(o::LO), size, file) != (std::size_t)size)
+        return false;
+      map = o::LOs(map_h.write());
+      return true;
+    }
   }
 
   void setGyroConfig(Input& input) {
@@ -29,69 +96,28 @@ namespace xgcp {
            gyro_rmax, gyro_num_rings, gyro_points_per_ring, gyro_theta);
   }
 
-  o::LOs searchAndBuildMap(o::Mesh* mesh, o::Reals element_centroids,
-                           o::Reals projected_points, o::LOs starting_element) {
-    o::LO num_points = starting_element.size();
-
-    //Create PS for the projected points to perform adjacency search on
-    PSpt::kkLidView ptcls_per_elem("ptcls_per_elem", mesh->nelems());
-    PSpt::kkLidView point_element("point_element", num_points);
-    auto point_info = particle_structs::createMemberViews<Point>(num_points);
-    auto start_pos = particle_structs::getMemberView<Point, 0>(point_info);
-    auto end_pos = particle_structs::getMemberView<Point, 1>(point_info);
-    auto point_id = particle_structs::getMemberView<Point, 2>(point_info);
-    auto countPointsInElement = OMEGA_H_LAMBDA(const o::LO& id) {
-      const o::LO elm = starting_element[id];
-      Kokkos::atomic_fetch_add(&(ptcls_per_elem(elm)), 1); //can just be 'add', no fetch needed
-      point_id(id) = id;
-      point_element(id) = elm;
-      for (int i = 0; i < 2; ++i) {
-        start_pos(id,i) = element_centroids[elm*2+i];
-        end_pos(id,i) = projected_points[id*2+i];
-      }
-    };
-    o::parallel_for(num_points, countPointsInElement, "countPointsInElement");
-
-    const int sigma = INT_MAX;
-    const int V = 64;
-    Kokkos::TeamPolicy<Kokkos::DefaultExecutionSpace> policy(10000, 32);
-    PSpt::kkGidView empty_gids("empty_gids", 0);
-    PSpt* gyro_ps = new ps::SellCSigma<Point>(policy, sigma, V,
-                                              mesh->nelems(), num_points,
-                                              ptcls_per_elem, empty_gids,
-                                              point_element, point_info);
-    printf("created ps for gyro mapping with %d points and %d elms\n",
-           num_points, mesh->nelems());
-
-    //Adjacency search
-    auto start = gyro_ps->get<PTCL_COORDS>();
-    auto end = gyro_ps->get<PTCL_TARGET>();
-    auto pids = gyro_ps->get<PTCL_IDS>();
-    int maxLoops = 100;
-    int psCapacity = gyro_ps->capacity();
-    o::Write<o::LO> elem_ids(psCapacity, -1);
-    bool isFound = p::search_mesh_2d(*mesh, gyro_ps, start, end, pids,
-                                     elem_ids, maxLoops);
-    assert(isFound);
+  o::LOs buildGyroMap(o::Mesh* mesh, const p::PointLocator& locator,
+                      o::Reals projected_points) {
+    //Locate the projected points directly instead of walking from a seed element
+    o::LOs point_elems = locator.locate(projected_points);
+    const o::LO num_points = point_elems.size();
 
     const auto numElms = mesh->nelems();
     //Gyro avg mapping: 3 vertices per ring point (Assumes all elements are triangles)
     const o::LO nvpe = 3;
     o::Write<o::LO> gyro_avg_map(nvpe * num_points, -1, "gyro_map");
     auto elm2Verts = mesh->ask_down(mesh->dim(), 0);
-    auto createGyroMapping = PS_LAMBDA(const int&, const int& pid, const int& mask) {
-      const o::LO parent = elem_ids[pid];
-      if (mask && parent >= 0) { //skip points outside the domain (parent == -1)
+    auto createGyroMapping = OMEGA_H_LAMBDA(const o::LO& id) {
+      const o::LO parent = point_elems[id];
+      if (parent >= 0) { //skip points outside the domain (parent == -1)
         assert(parent>=0 && parent<numElms);
-        const o::LO id = pids(pid);
         const o::LO start_index = id* nvpe;
         const o::LO start_elm = parent*nvpe;
         for (int i = 0; i < 3; ++i)
           gyro_avg_map[start_index+i] = elm2Verts.ab2b[start_elm+i];
       }
     };
-    ps::parallel_for(gyro_ps, createGyroMapping);
-    delete gyro_ps;
+    o::parallel_for(num_points, createGyroMapping, "createGyroMapping");
     return o::LOs(gyro_avg_map);
   }
 
@@ -135,37 +161,297 @@ namespace xgcp {
     };
     o::parallel_for(num_points, projectCoords, "projectCoords");
 
-    //Use adjacency search to find the element that the projected point is in
-    o::Write<o::LO> starting_element(num_points,0, "starting_element");
-    auto verts2Elm = mesh->ask_up(0, mesh->dim());
-    auto setInitialElement = OMEGA_H_LAMBDA(const o::LO& id) {
-      //Note: Setting initial element to be the first element adjacent to the vertex
-      const o::LO vert_id = id / gppr / gnr;
-      const auto firstElm = verts2Elm.a2ab[vert_id];
-      starting_element[id] = verts2Elm.ab2b[firstElm];
+    //Create both mapping
+    p::PointLocator locator(*mesh);
+    major_map = buildGyroMap(mesh, locator, o::Reals(major_ring_points));
+    minor_map = buildGyroMap(mesh, locator, o::Reals(minor_ring_points));
+    Kokkos::Profiling::popRegion();
+  }
+
+  bool rotateIonGyroRingMappings(o::Mesh* mesh, o::Real theta, o::LOs& major_map,
+                                 o::LOs& minor_map) {
+    const auto gnr = gyro_num_rings;
+    const auto gppr = gyro_points_per_ring;
+    //Rotations by whole ring points move each point onto another point of its ring
+    const o::Real spacing = 360.0 / gppr;
+    const o::Real steps = (theta - gyro_theta) / spacing;
+    const o::Real whole_steps = std::round(steps);
+    gyro_theta = theta;
+    if (std::fabs(steps - whole_steps) > 1e-9) {
+      createIonGyroRingMappings(mesh, major_map, minor_map);
+      return false;
+    }
+    const o::LO shift = ((o::LO)whole_steps % gppr + gppr) % gppr;
+    if (shift == 0)
+      return true;
+    const o::LO nvpe = 3;
+    const o::LO num_points = mesh->nverts() * gnr * gppr;
+    o::LOs maps[2] = {major_map, minor_map};
+    for (int m = 0; m < 2; ++m) {
+      o::LOs old_map = maps[m];
+      o::Write<o::LO> new_map(old_map.size(), "gyro_map");
+      //Point p of the rotated ring is at the angle of point p + shift of the old ring
+      auto permutePoints = OMEGA_H_LAMBDA(const o::LO& id) {
+        const o::LO point_id = id % gppr;
+        const o::LO ring_start = id - point_id;
+        const o::LO old_id = ring_start + (point_id + shift) % gppr;
+        for (int i = 0; i < nvpe; ++i)
+          new_map[id * nvpe + i] = old_map[old_id * nvpe + i];
+      };
+      o::parallel_for(num_points, permutePoints, "permuteGyroPoints");
+      maps[m] = o::LOs(new_map);
+    }
+    major_map = maps[0];
+    minor_map = maps[1];
+    return true;
+  }
+
+  std::uint64_t gyroMapKey(o::Mesh* mesh, fp_t major_phi, fp_t minor_phi) {
+    const o::Real config[4] = {gyro_rmax, gyro_theta, (o::Real)major_phi,
+                               (o::Real)minor_phi};
+    const o::LO counts[4] = {gyro_num_rings, gyro_points_per_ring, mesh->nverts(),
+                             mesh->nelems()};
+    std::uint64_t hash = hashBytes(14695981039346656037ULL, config, sizeof(config));
+    hash = hashBytes(hash, counts, sizeof(counts));
+    hash = hashArray(hash, mesh->coords());
+    return hashArray(hash, mesh->ask_elem_verts());
+  }
+
+  std::string gyroMapPrefix(const std::string& directory, std::uint64_t key, int rank) {
+    std::stringstream ss;
+    ss << directory << "/gyro_" << std::hex << key << std::dec << "_" << rank;
+    return ss.str();
+  }
+
+  /* Gyro map cache layout (native byte order)
+       8 bytes - gyro_cache_magic
+       int32 - gyro_cache_version
+       uint64 - key
+       the major and minor maps (int32 size followed by the values)
+  */
+  bool writeIonGyroMappings(const std::string& prefix, std::uint64_t key,
+                            o::LOs major_map, o::LOs minor_map) {
+    FILE* file = fopen((prefix + ".gmap").c_str(), "wb");
+    if (!file) {
+      fprintf(stderr, "[WARNING] Cannot write gyro map cache %s.gmap\n", prefix.c_str());
+      return false;
+    }
+    const bool success = fwrite(gyro_cache_magic, 1, 8, file) == 8 &&
+      fwrite(&gyro_cache_version, sizeof(int), 1, file) == 1 &&
+      fwrite(&key, sizeof(key), 1, file) == 1 &&
+      writeMap(file, major_map) && writeMap(file, minor_map);
+    fclose(file);
+    if (!success)
+      fprintf(stderr, "[WARNING] Failed writing gyro map cache %s.gmap\n", prefix.c_str());
+    return success;
+  }
+
+  bool readIonGyroMappings(const std::string& prefix, std::uint64_t key,
+                           o::LOs& major_map, o::LOs& minor_map) {
+    FILE* file = fopen((prefix + ".gmap").c_str(), "rb");
+    if (!file)
+      return false;
+    char magic[8];
+    int version;
+    std::uint64_t file_key;
+    o::LOs major, minor;
+    const bool success = fread(magic, 1, 8, file) == 8 &&
+      memcmp(magic, gyro_cache_magic, 8) == 0 &&
+      fread(&version, sizeof(int), 1, file) == 1 && version == gyro_cache_version &&
+      fread(&file_key, sizeof(file_key), 1, file) == 1 && file_key == key &&
+      readMap(file, major) && readMap(file, minor);
+    fclose(file);
+    if (!success)
+      return false;
+    major_map = major;
+    minor_map = minor;
+    return true;
+  }
+
+  void setGyroScatterEngine(GyroScatterEngine engine, double sort_threshold) {
+    gyro_engine = engine;
+    gyro_sort_threshold = sort_threshold;
+  }
+
+  GyroOperator::GyroOperator(o::LOs offs, o::LOs cols, o::Reals vals, o::LOs t_offs,
+                             o::LOs t_cols, o::Reals t_vals) :
+    num_rows(offs.size() - 1), num_cols(t_offs.size() - 1), offsets(offs), columns(cols),
+    values(vals), t_offsets(t_offs), t_columns(t_cols), t_values(t_vals) {}
+
+  namespace {
+    void multiplyCSR(o::LOs offsets, o::LOs columns, o::Reals values, o::LO num_rows,
+                     o::Reals x, o::Write<o::Real> y, int nfields) {
+      auto multiplyRow = OMEGA_H_LAMBDA(const o::LO& r) {
+        for (int f = 0; f < nfields; ++f) {
+          o::Real sum = 0;
+          for (o::LO i = offsets[r]; i < offsets[r+1]; ++i)
+            sum += values[i] * x[columns[i] * nfields + f];
+          y[r * nfields + f] += sum;
+        }
+      };
+      o::parallel_for(num_rows, multiplyRow, "gyroOperatorMultiply");
+    }
+  }
+
+  void GyroOperator::apply(o::Reals x, o::Write<o::Real> y, int nfields) const {
+    multiplyCSR(offsets, columns, values, num_rows, x, y, nfields);
+  }
+  void GyroOperator::applyTranspose(o::Reals x, o::Write<o::Real> y, int nfields) const {
+    multiplyCSR(t_offsets, t_columns, t_values, num_cols, x, y, nfields);
+  }
+
+  GyroOperator buildGyroOperator(o::Mesh* mesh, o::LOs v2v) {
+    const o::LO nverts = mesh->nverts();
+    const o::LO gppr = gyro_points_per_ring;
+    const o::LO num_rings = nverts * gyro_num_rings;
+    const o::LO nentries = v2v.size();
+    const o::Real weight = 1.0 / gppr;
+    //Unmapped entries (-1) are ordered after every vertex
+    o::Write<o::LO> targets(nentries, "gyro_op_targets");
+    auto setTargets = OMEGA_H_LAMBDA(const o::LO& i) {
+      targets[i] = v2v[i] >= 0 ? v2v[i] : nverts;
+    };
+    o::parallel_for(nentries, setTargets, "setGyroOperatorTargets");
+    o::LOs order = o::sort_by_keys(o::LOs(targets));
+    o::Write<o::LO> sorted(nentries, "gyro_op_sorted");
+    o::Write<o::LO> columns(nentries, "gyro_op_columns");
+    //Entry i of the map belongs to ring i / (3 * points per ring)
+    auto orderEntries = OMEGA_H_LAMBDA(const o::LO& i) {
+      sorted[i] = targets[order[i]];
+      columns[i] = order[i] / (3 * gppr);
     };
-    o::parallel_for(num_points, setInitialElement, "setInitialElement");
-
-    //Calculate centroids of each element
-    o::Write<o::Real> element_centroids(mesh->nelems()*2);
-    auto cells2nodes = mesh->get_adj(mesh->dim(), o::VERT).ab2b;
-    auto calculateCentroids = OMEGA_H_LAMBDA(const o::LO& elm) {
-      auto elmVerts = o::gather_verts<3>(cells2nodes, elm);
-      auto vtxCoords = o::gather_vectors<3,2>(coords, elmVerts);
-      auto center = average(vtxCoords);
-      element_centroids[elm*2] = center[0];
-      element_centroids[elm*2+1] = center[1];
+    o::parallel_for(nentries, orderEntries, "orderGyroOperator");
+    o::Write<o::LO> offsets(nverts + 1, "gyro_op_offsets");
+    auto findOffsets = OMEGA_H_LAMBDA(const o::LO& v) {
+      offsets[v] = lowerBound(sorted, nentries, v);
     };
-    o::parallel_for(mesh->nelems(), calculateCentroids, "calculateCentroids");
+    o::parallel_for(nverts + 1, findOffsets, "findGyroOperatorOffsets");
 
-    //Create both mapping
-    major_map = searchAndBuildMap(mesh, o::Reals(element_centroids),
-                                    o::Reals(major_ring_points),
-                                    o::LOs(starting_element));
-    minor_map = searchAndBuildMap(mesh, o::Reals(element_centroids),
-                                     o::Reals(minor_ring_points),
-                                     o::LOs(starting_element));
-    Kokkos::Profiling::popRegion();
+    //The rows of the transpose are the entries of the map, unmapped entries add nothing
+    o::Write<o::LO> t_offsets(num_rings + 1, "gyro_op_t_offsets");
+    auto setRingOffsets = OMEGA_H_LAMBDA(const o::LO& r) {
+      t_offsets[r] = r * 3 * gppr;
+    };
+    o::parallel_for(num_rings + 1, setRingOffsets, "setGyroOperatorRings");
+    o::Write<o::LO> t_columns(nentries, "gyro_op_t_columns");
+    o::Write<o::Real> t_values(nentries, "gyro_op_t_values");
+    auto setRingEntries = OMEGA_H_LAMBDA(const o::LO& i) {
+      t_columns[i] = v2v[i] >= 0 ? v2v[i] : 0;
+      t_values[i] = v2v[i] >= 0 ? weight : 0;
+    };
+    o::parallel_for(nentries, setRingEntries, "setGyroOperatorEntries");
+    return GyroOperator(o::LOs(offsets), o::LOs(columns), o::Reals(nentries, weight),
+                        o::LOs(t_offsets), o::LOs(t_columns), o::Reals(t_values));
+  }
+
+  namespace {
+    typedef ps::SellCSigma<Ion> SCS_I;
+
+    //Number of particles of each ring of every vertex, scs is ptcls if it is a SellCSigma
+    template <class PS>
+    o::Write<o::Real> accumulateRings(Mesh& mesh, PS* ptcls, SCS_I* scs) {
+      const auto gr = gyro_rmax;
+      const auto gnr = gyro_num_rings;
+      const o::LO nverts = mesh->nverts();
+      const o::LO num_rings = gnr * nverts;
+      auto elm2verts = mesh->ask_down(mesh->dim(), 0);
+      const int nvpe = 3; //triangles
+      const double ringWidth = gr/gnr;
+      o::Write<o::Real> ring_accum(num_rings, 0, "ring_accumulator");
+
+      GyroScatterEngine engine = gyro_engine;
+      if (engine == GYRO_SCATTER_TEAM && !scs) {
+        fprintf(stderr, "[WARNING] Team gyro scatter requires a SellCSigma, using atomics\n");
+        engine = GYRO_SCATTER_ATOMIC;
+      }
+      if (engine == GYRO_SCATTER_AUTO) {
+        const double ptcls_per_ring = (double)ptcls->nPtcls() * 2 * nvpe / (num_rings + 1);
+        engine = scs ? GYRO_SCATTER_TEAM :
+          ptcls_per_ring > gyro_sort_threshold ? GYRO_SCATTER_SORTED : GYRO_SCATTER_ATOMIC;
+      }
+
+      if (engine == GYRO_SCATTER_TEAM) {
+        //Rings of the element's particles are counted in scratch and added once per vertex
+        const std::size_t bytes = gnr * sizeof(o::Real);
+        const o::LO nelems = mesh->nelems();
+        auto accumulateElement = PS_LAMBDA(const SCS_I::TeamMember& team, const int& e,
+                                           const SCS_I::RowParticles& row) {
+          o::Real* counts = (o::Real*)team.team_shmem().get_shmem(bytes);
+          if (e >= nelems)
+            return;
+          Kokkos::parallel_for(Kokkos::TeamThreadRange(team, gnr), [=](const int& r) {
+            counts[r] = 0;
+          });
+          team.team_barrier();
+          Kokkos::parallel_for(Kokkos::TeamThreadRange(team, row.size()), [=](const int& i) {
+            if (row.mask(i)) {
+              const int ringDown = ringBelow(ringWidth, gnr);
+              Kokkos::atomic_fetch_add(&(counts[ringDown]), 1.0);
+              Kokkos::atomic_fetch_add(&(counts[ringDown+1]), 1.0);
+            }
+          });
+          team.team_barrier();
+          Kokkos::parallel_for(Kokkos::TeamThreadRange(team, nvpe * gnr), [=](const int& j) {
+            const int ring = j % gnr;
+            if (counts[ring] > 0) {
+              const auto v = elm2verts.ab2b[e*nvpe + j / gnr];
+              Kokkos::atomic_fetch_add(&(ring_accum[v*gnr + ring]), counts[ring]);
+            }
+          });
+        };
+        scs->parallel_for_elements(accumulateElement, bytes, -1, "xgcm_accumulateElements");
+      }
+      else if (engine == GYRO_SCATTER_SORTED) {
+        //Each slot emits the 2 rings of its 3 vertices (num_rings if empty)
+        const o::LO nkeys = ptcls->capacity() * 2 * nvpe;
+        o::Write<o::LO> keys(nkeys, "gyro_ring_keys");
+        auto emitRings = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+          const int ringDown = mask > 0 ? ringBelow(ringWidth, gnr) : 0;
+          for(int i=0; i<nvpe; i++) {
+            const auto v = elm2verts.ab2b[e*nvpe + i];
+            const o::LO first = (pid * nvpe + i) * 2;
+            keys[first] = mask > 0 ? v*gnr + ringDown : num_rings;
+            keys[first+1] = mask > 0 ? v*gnr + ringDown + 1 : num_rings;
+          }
+        };
+        ps::parallel_for(ptcls, emitRings);
+        o::LOs order = o::sort_by_keys(o::LOs(keys));
+        o::Write<o::LO> sorted(nkeys, "gyro_sorted_rings");
+        auto orderKeys = OMEGA_H_LAMBDA(const o::LO& i) {
+          sorted[i] = keys[order[i]];
+        };
+        o::parallel_for(nkeys, orderKeys, "orderGyroRings");
+        //Every pair adds 1, so a ring's value is the length of its run of keys
+        auto countRings = OMEGA_H_LAMBDA(const o::LO& k) {
+          ring_accum[k] = lowerBound(sorted, nkeys, k + 1) - lowerBound(sorted, nkeys, k);
+        };
+        o::parallel_for(num_rings, countRings, "countGyroRings");
+      }
+      else {
+        auto accumulate = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
+          if(mask > 0) {
+            const int ringDown = ringBelow(ringWidth, gnr);
+            const auto firstVtx = e*nvpe;
+            for(int i=0; i<nvpe; i++) {
+              const auto v = elm2verts.ab2b[firstVtx+i];
+              const auto vtxIdx = v*gnr;
+              Kokkos::atomic_fetch_add(&(ring_accum[vtxIdx+ringDown+1]), 1);
+              Kokkos::atomic_fetch_add(&(ring_accum[vtxIdx+ringDown]), 1);
+            }
+          }
+        };
+        ps::parallel_for(ptcls, accumulate);
+      }
+      return ring_accum;
+    }
+
+    //The structure is resolved once so the kernels of the step are dispatched statically
+    o::Write<o::Real> accumulateToRings(Mesh& mesh, PS_I* ptcls) {
+      SCS_I* scs = dynamic_cast<SCS_I*>(ptcls);
+      if (scs)
+        return accumulateRings(mesh, scs, scs);
+      return accumulateRings(mesh, ptcls, scs);
+    }
   }
 
   void gyroScatter(Mesh& mesh, PS_I* ptcls, o::LOs v2v, GyroField scatter_w) {
@@ -175,36 +461,10 @@ namespace xgcp {
     int rank, comm_size;
     MPI_Comm_rank(MPI_COMM_WORLD,&rank);
     MPI_Comm_size(MPI_COMM_WORLD,&comm_size);
-    const auto gr = gyro_rmax;
     const auto gnr = gyro_num_rings;
     const auto gppr = gyro_points_per_ring;
-    auto elm2verts = mesh->ask_down(mesh->dim(), 0);
     auto nvpe = 3; //triangles
-    const double ringWidth = gr/gnr;
-    o::Write<o::Real> ring_accum(gnr*mesh->nverts(),0, "ring_accumulator");
-    auto accumulateToRings = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
-      if(mask > 0) {
-        const auto ptclRadius = ringWidth*1.125; //TODO compute the radius
-        assert(ptclRadius >= ringWidth);
-        auto ringDown = 0;
-        for(int i=2; i<=gnr; i++)
-          ringDown += (ptclRadius >= ringWidth*i);
-        auto ringUp = ringDown+1;
-        assert(ringUp<gnr);
-        assert(ptclRadius >= ringWidth*(ringDown+1));
-        assert(ptclRadius < ringWidth*(ringUp+1));
-        const auto firstVtx = e*nvpe;
-        for(int i=0; i<nvpe; i++) {
-          const auto v = elm2verts.ab2b[firstVtx+i];
-          const auto vtxIdx = v*gnr;
-          const auto ringUpIdx = vtxIdx+ringUp;
-          const auto ringDownIdx = vtxIdx+ringDown;
-          Kokkos::atomic_fetch_add(&(ring_accum[ringUpIdx]), 1); //replace with add
-          Kokkos::atomic_fetch_add(&(ring_accum[ringDownIdx]), 1); //replace with add
-        }
-      }
-    };
-    ps::parallel_for(ptcls, accumulateToRings);
+    o::Write<o::Real> ring_accum = accumulateToRings(mesh, ptcls);
     auto scatterToMappedVerts = OMEGA_H_LAMBDA(const o::LO& v) {
       const auto vtxIdx = v*gnr*gppr;
       const auto gyroVtxIdx = v*gnr;
@@ -217,7 +477,7 @@ namespace xgcp {
             const auto mappedIdx = ptIdx + elmVtx;
             const auto mappedVtx = v2v[mappedIdx];
             if (mappedVtx >= 0)
-              Kokkos::atomic_fetch_add(&(scatter_w[mappedVtx]), accumRingVal); //replace with add
+              Kokkos::atomic_fetch_add(&(scatter_w[mappedVtx]), accumRingVal);
           }
         }
       }
@@ -229,6 +489,22 @@ namespace xgcp {
     Kokkos::Profiling::popRegion();
   }
 
+  void gyroScatter(Mesh& mesh, PS_I* ptcls, const GyroOperator& op,
+                   GyroField scatter_w) {
+    const auto btime = pumipic_prebarrier();
+    Kokkos::Timer timer;
+    Kokkos::Profiling::pushRegion("xgcm_gyroScatter");
+    int rank, comm_size;
+    MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+    MPI_Comm_size(MPI_COMM_WORLD,&comm_size);
+    o::Write<o::Real> ring_accum = accumulateToRings(mesh, ptcls);
+    op.apply(o::Reals(ring_accum), scatter_w);
+    if(!rank || rank == comm_size/2)
+      fprintf(stderr, "%d gyro scatter (seconds) %f pre-barrier (seconds) %f\n",
+              rank, timer.seconds(), btime);
+    Kokkos::Profiling::popRegion();
+  }
+
   void gyroSync(Mesh& m, GyroField major, GyroField minor) {
     const auto btime = pumipic_prebarrier();
     Kokkos::Timer timer;
@@ -257,10 +533,10 @@ namespace xgcp {
   void gyroScatter(Mesh& mesh, PS_I* ptcls) {
     GyroField major, minor;
     mesh.getGyroFields(major,minor);
-    Omega_h::LOs major_map, minor_map;
-    mesh.getIonGyroMappings(major_map, minor_map);
-    gyroScatter(mesh, ptcls, major_map, major);
-    gyroScatter(mesh, ptcls, minor_map, minor);
+    GyroOperator major_op, minor_op;
+    mesh.getIonGyroOperators(major_op, minor_op);
+    gyroScatter(mesh, ptcls, major_op, major);
+    gyroScatter(mesh, ptcls, minor_op, minor);
     gyroSync(mesh, major, minor);
   }
 
@@ -1,5 +1,7 @@
 #pragma once
 #include "xgcp_mesh.hpp"
+#include <cstdint>
+#include <string>
 
 namespace xgcp {
 
@@ -9,10 +11,52 @@ namespace xgcp {
   void createIonGyroRingMappings(o::Mesh* mesh, o::LOs& forward_map,
                                  o::LOs& backward_map);
 
+  /* Rotates the ion gyro rings of the maps to theta degrees
+       When the rotation is a multiple of the angle between ring points the maps are
+       permuted, returns false if the maps were rebuilt with createIonGyroRingMappings
+  */
+  bool rotateIonGyroRingMappings(o::Mesh* mesh, o::Real theta, o::LOs& forward_map,
+                                 o::LOs& backward_map);
+
+  /* Ion gyro map cache
+       gyroMapKey - hash of the mesh, plane angles and gyro configuration
+       writeIonGyroMappings - writes the maps to <prefix>.gmap
+       readIonGyroMappings - loads the maps written for key, false if there are none
+  */
+  std::uint64_t gyroMapKey(o::Mesh* mesh, fp_t major_phi, fp_t minor_phi);
+  std::string gyroMapPrefix(const std::string& directory, std::uint64_t key, int rank);
+  bool writeIonGyroMappings(const std::string& prefix, std::uint64_t key,
+                            o::LOs forward_map, o::LOs backward_map);
+  bool readIonGyroMappings(const std::string& prefix, std::uint64_t key,
+                           o::LOs& forward_map, o::LOs& backward_map);
+
+  /* Accumulation of particles to the gyro rings of gyroScatter
+       GYRO_SCATTER_ATOMIC - one atomic add per particle and ring
+       GYRO_SCATTER_SORTED - particles emit their rings, which are sorted and counted per
+                             ring without atomics
+       GYRO_SCATTER_TEAM - one team per element (SellCSigma structures only) counts the rings
+                           of its particles in team scratch, then adds once per element
+       GYRO_SCATTER_AUTO - TEAM on SellCSigma, otherwise SORTED when the particles per ring
+                           exceed gyro_sort_threshold and ATOMIC elsewhere (default)
+  */
+  enum GyroScatterEngine {
+    GYRO_SCATTER_ATOMIC,
+    GYRO_SCATTER_SORTED,
+    GYRO_SCATTER_TEAM,
+    GYRO_SCATTER_AUTO
+  };
+  void setGyroScatterEngine(GyroScatterEngine engine, double sort_threshold = 16);
+
+  //Builds the gyro average operator of a gyro mapping
+  GyroOperator buildGyroOperator(o::Mesh* mesh, o::LOs v2v);
+
   void gyroScatter(Mesh& mesh, PS_I* ptcls);
   void gyroScatter(Mesh& mesh, PS_E* ptcls);
 
   void gyroScatter(Mesh& mesh, PS_I* ptcls, o::LOs v2v, std::string scatterTagName);
+  //Scatter to the vertices with the gyro average operator (no atomics)
+  void gyroScatter(Mesh& mesh, PS_I* ptcls, const GyroOperator& op,
+                   Mesh::GyroField scatter_w);
 
   void gyroSync(Mesh& mesh, const std::string& fwdTagName,
                 const std::string& bkwdTagName, const std::string& syncTagName);
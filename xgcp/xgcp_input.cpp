@@ -24,6 +24,11 @@ namespace xgcp {
       throw std::runtime_error("Incorrect number of ranks");
     }
 
+    migration_period = 1;
+    migration_layers = 1;
+    hierarchical_migration = false;
+    field_chunks = 4;
+
     //Default gyro parameters
     gyro_rmax = 0.038;
     gyro_num_rings = 3;
@@ -31,4 +36,13 @@ namespace xgcp {
     gyro_theta = 0;
 
   }
+
+  void Input::setMigrationPolicy(int period, int layers) {
+    migration_period = period > 1 ? period : 1;
+    migration_layers = layers > 1 ? layers : 1;
+  }
+
+  void Input::setFieldChunks(int chunks) {
+    field_chunks = chunks > 1 ? chunks : 1;
+  }
 }
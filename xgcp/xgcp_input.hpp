@@ -1,6 +1,7 @@
 #pragma once
 #include "xgcp_types.hpp"
 #include <pumipic_input.hpp>
+#include <string>
 namespace xgcp {
 
   class Mesh;
@@ -14,6 +15,35 @@ namespace xgcp {
           pumipic::Input::Method buffer_method, pumipic::Input::Method safe_method);
     //TODO create input constructor that reads inputs from a file?
 
+    /* Reduce how often particles are migrated out of unsafe elements
+         period - particles in unsafe elements migrate to the owner every period searches
+         layers - particles within layers of the edge of the buffer
+                  (pumipic::Mesh::bufferDistance) migrate on every search, at least 1
+       Particles that change torodial sections always migrate
+       The default period of 1 migrates every particle in an unsafe element on every search
+    */
+    void setMigrationPolicy(int period, int layers);
+
+    /* Migrate particles in two stages of neighbor exchanges (defaults to false)
+         The torodial stage moves particles one plane per exchange to the torodial neighbor
+         of the same mesh part, then the mesh stage moves them to the owner of their element
+         on the new plane. Particle structures only exchange with these neighbors, see
+         Mesh::migrationNeighbors
+    */
+    void setHierarchicalMigration(bool on) {hierarchical_migration = on;}
+
+    /* Split fields into chunks that move through the partitioning levels of
+       Mesh::gatherField and Mesh::scatterField as a pipeline
+         chunks - messages per field and level, at least 1 (default 4)
+    */
+    void setFieldChunks(int chunks);
+
+    /* Existing directory of the ion gyro map cache (defaults to NULL, no caching)
+         Mesh(Input&) loads the maps cached for its picpart, planes and gyro configuration
+         if present, otherwise it builds and caches them
+    */
+    void setGyroCache(const char* directory) {gyro_cache_directory = directory ? directory : "";}
+
 
     //Friends that can access private contents
     friend class Mesh;
@@ -33,11 +63,20 @@ namespace xgcp {
     p::Input::Method buffer_method;
     p::Input::Method safe_method;
 
+    //Migration policy
+    int migration_period;
+    int migration_layers;
+    bool hierarchical_migration;
+
+    //Field pipeline
+    int field_chunks;
+
     //Gyro paramaters
     o::Real gyro_rmax;
     o::LO gyro_num_rings;
     o::LO gyro_points_per_ring;
     o::Real gyro_theta;
+    std::string gyro_cache_directory;
 
   };
 }
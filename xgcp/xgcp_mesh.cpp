@@ -33,6 +33,11 @@ namespace xgcp {
     //Breakup group/torodial partitioning
     int num_cores = input.num_core_regions;
     nplanes_ = input.num_planes;
+    migration_period = input.migration_period;
+    migration_layers = input.migration_layers;
+    hierarchical_migration = input.hierarchical_migration;
+    num_searches = 0;
+    field_chunks = input.field_chunks;
     int group_size = input.num_processes_per_group;
     partition_communicator(input.library, num_cores, nplanes_, group_size,
                            mesh_comm, torodial_comm, group_comm);
@@ -55,18 +60,33 @@ namespace xgcp {
     }
     o::Mesh* mesh = picparts->mesh();
 
+    //Build plane information
+    fp_t delta_phi = 2* M_PI / nplanes_;
+    major_phi = delta_phi * (torodial_comm->rank() + 1);
+    minor_phi = major_phi - delta_phi;
+
     //Build gyro mappings
     setGyroConfig(input);
     if (!worldRank())
       printGyroConfig();
-    createIonGyroRingMappings(mesh, major_ion_gyro_map, minor_ion_gyro_map);
+    gyro_cache_directory = input.gyro_cache_directory;
+    std::string gyro_cache;
+    std::uint64_t gyro_key = 0;
+    if (!gyro_cache_directory.empty()) {
+      gyro_key = gyroMapKey(mesh, major_phi, minor_phi);
+      gyro_cache = gyroMapPrefix(gyro_cache_directory, gyro_key, worldRank());
+    }
+    if (gyro_cache.empty() ||
+        !readIonGyroMappings(gyro_cache, gyro_key, major_ion_gyro_map, minor_ion_gyro_map)) {
+      createIonGyroRingMappings(mesh, major_ion_gyro_map, minor_ion_gyro_map);
+      if (!gyro_cache.empty())
+        writeIonGyroMappings(gyro_cache, gyro_key, major_ion_gyro_map, minor_ion_gyro_map);
+    }
 
-    //TODO build electron mapping
+    major_ion_gyro_op = buildGyroOperator(mesh, major_ion_gyro_map);
+    minor_ion_gyro_op = buildGyroOperator(mesh, minor_ion_gyro_map);
 
-    //Build plane information
-    fp_t delta_phi = 2* M_PI / nplanes_;
-    major_phi = delta_phi * (torodial_comm->rank() + 1);
-    minor_phi = major_phi - delta_phi;
+    //TODO build electron mapping
     major_plane = GyroField(mesh->nverts(), 0.0, "major_plane_field");
     minor_plane = GyroField(mesh->nverts(), 0.0, "major_plane_field");
     mesh->add_tag(0, "major_plane", 1, GyroFieldR(major_plane));
@@ -92,6 +112,40 @@ namespace xgcp {
     major_map = major_ion_gyro_map;
     minor_map = minor_ion_gyro_map;
   }
+  void Mesh::getIonGyroOperators(GyroOperator& major_op, GyroOperator& minor_op) {
+    major_op = major_ion_gyro_op;
+    minor_op = minor_ion_gyro_op;
+  }
+  void Mesh::setGyroTheta(fp_t theta) {
+    o::Mesh* mesh = omegaMesh();
+    rotateIonGyroRingMappings(mesh, theta, major_ion_gyro_map, minor_ion_gyro_map);
+    major_ion_gyro_op = buildGyroOperator(mesh, major_ion_gyro_map);
+    minor_ion_gyro_op = buildGyroOperator(mesh, minor_ion_gyro_map);
+    if (!gyro_cache_directory.empty()) {
+      const std::uint64_t key = gyroMapKey(mesh, major_phi, minor_phi);
+      writeIonGyroMappings(gyroMapPrefix(gyro_cache_directory, key, worldRank()), key,
+                           major_ion_gyro_map, minor_ion_gyro_map);
+    }
+  }
+
+  std::vector<int> Mesh::migrationNeighbors() {
+    const int tr = torodialRank(), mr = meshRank(), gr = groupRank();
+    const int ts = torodialSize(), ms = meshSize(), gs = groupSize();
+    std::vector<int> ranks;
+    if (ts > 1) {
+      ranks.push_back(getWorldRank(torodialMinorNeighbor(), mr, gr, ts, ms, gs));
+      if (torodialMajorNeighbor() != torodialMinorNeighbor())
+        ranks.push_back(getWorldRank(torodialMajorNeighbor(), mr, gr, ts, ms, gs));
+    }
+    Omega_h::HostWrite<Omega_h::LO> buffered = picparts->bufferedRanks(dim());
+    for (int i = 0; i < buffered.size(); ++i)
+      if (buffered[i] != mr)
+        ranks.push_back(getWorldRank(tr, buffered[i], gr, ts, ms, gs));
+    for (int i = 0; i < gs; ++i)
+      if (i != gr)
+        ranks.push_back(getWorldRank(tr, mr, i, ts, ms, gs));
+    return ranks;
+  }
 
   bool createDirectory(const char* directory, int rank) {
     DIR* dir = opendir(directory);
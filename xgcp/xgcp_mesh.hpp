@@ -3,6 +3,8 @@
 #include "xgcp_input.hpp"
 #include <pumipic_mesh.hpp>
 #include <Omega_h_comm.hpp>
+#include <type_traits>
+#include <vector>
 
 using Omega_h::MpiTraits;
 
@@ -24,6 +26,42 @@ using Omega_h::MpiTraits;
  */
 
 namespace xgcp {
+  /* Sparse gyro average operator of a gyro mapping in CSR format
+       Rows are the mesh vertices and columns the rings around every vertex
+       (vertex * num_rings + ring). Each ring point adds 1/points_per_ring of its ring to the
+       3 vertices the mapping projects it to, so apply scatters ring values to the vertices
+       (gyroScatter) and applyTranspose averages vertex values over the rings.
+
+     Several fields are applied in one pass by interleaving them, value f of row r is at
+       r * nfields + f of x and y.
+  */
+  class GyroOperator {
+  public:
+    GyroOperator() : num_rows(0), num_cols(0) {}
+    GyroOperator(Omega_h::LOs offsets, Omega_h::LOs columns, Omega_h::Reals values,
+                 Omega_h::LOs t_offsets, Omega_h::LOs t_columns, Omega_h::Reals t_values);
+    Omega_h::LO numRows() const {return num_rows;}
+    Omega_h::LO numCols() const {return num_cols;}
+    Omega_h::LO nnz() const {return columns.size();}
+    //y += A x, x holds numCols() and y numRows() values per field
+    void apply(Omega_h::Reals x, Omega_h::Write<Omega_h::Real> y, int nfields = 1) const;
+    //y += A^T x, x holds numRows() and y numCols() values per field
+    void applyTranspose(Omega_h::Reals x, Omega_h::Write<Omega_h::Real> y,
+                        int nfields = 1) const;
+
+    //CSR arrays of the operator for external sparse kernels
+    Omega_h::LOs rowOffsets() const {return offsets;}
+    Omega_h::LOs columnIds() const {return columns;}
+    Omega_h::Reals entries() const {return values;}
+  private:
+    Omega_h::LO num_rows, num_cols;
+    Omega_h::LOs offsets, columns;
+    Omega_h::Reals values;
+    //CSR of the transpose
+    Omega_h::LOs t_offsets, t_columns;
+    Omega_h::Reals t_values;
+  };
+
   class Mesh {
   public:
     Mesh(xgcp::Input&);
@@ -74,6 +112,17 @@ namespace xgcp {
     fp_t getMajorPlaneAngle() {return major_phi;}
     fp_t getMinorPlaneAngle() {return minor_phi;}
 
+    /********Migration policy (see Input::setMigrationPolicy)********/
+    //Counts a search, true if particles in unsafe elements migrate to the owner in it
+    bool nextMigrationStep() {return num_searches++ % migration_period == 0;}
+    int migrationLayers() const {return migration_layers;}
+    bool hierarchicalMigration() const {return hierarchical_migration;}
+    /* World ranks of the hierarchical migration exchanges
+         The torodial neighbors of this mesh part and group rank, the buffered mesh parts
+         of this plane and group rank, and the other members of the group (see balanceGroup)
+    */
+    std::vector<int> migrationNeighbors();
+
     typedef Omega_h::Write<Omega_h::Real> GyroField;
     typedef Omega_h::Read<Omega_h::Real> GyroFieldR;
     //Get the pointers to the major and minor plane fields
@@ -82,6 +131,13 @@ namespace xgcp {
     void applyGyroFieldsToTags();
     //Get the gyro mappings for major and minor planes for ions
     void getIonGyroMappings(Omega_h::LOs& major_map, Omega_h::LOs& minor_map);
+    /* Offset the ion gyro ring points to theta degrees
+         The mappings are permuted instead of rebuilt when the change is a multiple of the
+         angle between the points of a ring
+    */
+    void setGyroTheta(fp_t theta);
+    //Get the gyro average operators of the major and minor plane ion gyro mappings
+    void getIonGyroOperators(GyroOperator& major_op, GyroOperator& minor_op);
 
     enum PartitionLevel {
       GROUP,
@@ -106,6 +162,10 @@ namespace xgcp {
        MESH gather is done using pumipic::Mesh's reduceCommArray for each group
          leader's major plane
 
+       The fields are split into Input::setFieldChunks chunks. The GROUP reductions and
+       TORODIAL exchanges of every chunk are posted at once and each chunk is summed as soon
+       as both levels completed it, so the two levels overlap.
+
        Note: end_level must be greater than start_level
      */
     template <class T>
@@ -130,6 +190,9 @@ namespace xgcp {
          to the neighboring plane's minor plane
        GROUP scatter is done by scattering field values from the group leader to each group member
 
+       The group leader broadcasts the major and minor plane values of a chunk in one message
+       as soon as the chunk's minor plane values arrived from the torodial neighbor.
+
        Note: end_level must be greater than start_level
      */
     template <class T>
@@ -148,6 +211,13 @@ namespace xgcp {
 
     //Number of planes
     int nplanes_;
+    //Searches between migrations out of unsafe elements and the layers that always migrate
+    int migration_period, migration_layers;
+    int num_searches;
+    bool hierarchical_migration;
+    //Chunks of the field pipeline of gatherField and scatterField
+    int field_chunks;
+    int fieldChunks(int length) const {return length < field_chunks ? length : field_chunks;}
     //Torodial angle of the plane that this process is not leader of
     fp_t minor_phi;
     //Torodial angle of the plane that this process is leader of
@@ -155,6 +225,9 @@ namespace xgcp {
 
     //Major and minor ion projection mapping for each ring point to 3 mesh vertices
     Omega_h::LOs major_ion_gyro_map, minor_ion_gyro_map;
+    GyroOperator major_ion_gyro_op, minor_ion_gyro_op;
+    //Directory of the gyro map cache (empty if not cached)
+    std::string gyro_cache_directory;
 
     //Major and minor electron projection mapping for each vertex to 3 mesh vertices
     Omega_h::LOs major_electron_gyro_map, minor_electron_gyro_map;
@@ -176,39 +249,109 @@ namespace xgcp {
     mr = wr / gs / ts;
   }
 
-  //TODO Create methods to distringuish between CUDA_AWARE MPI and non cuda aware
+  /* Device array passed to MPI
+       MPI reads and writes the array directly when it is device aware (or the array is on
+       the host), otherwise a pinned host copy that is synchronized with the array.
+  */
+  template <class T>
+  class MpiField {
+  public:
+    typedef typename std::remove_const<T>::type Value;
+    typedef Kokkos::View<T*, pumipic::device_type,
+                         Kokkos::MemoryTraits<Kokkos::Unmanaged> > DeviceView;
+    typedef Kokkos::View<Value*, particle_structs::StagingDevice> StageView;
+    MpiField(T* data, int size) : array(data, size) {
+      if (particle_structs::NeedsStaging<pumipic::device_type>::value)
+        stage = StageView(Kokkos::ViewAllocateWithoutInitializing("mpi_field_stage"), size);
+    }
+    T* data() const {return stage.size() ? stage.data() : array.data();}
+    int size() const {return array.size();}
+    //Makes the array readable by MPI
+    void toMpi() {
+      if (stage.size())
+        Kokkos::deep_copy(stage, array);
+      else
+        Kokkos::fence();
+    }
+    //Copies values MPI wrote back to the array
+    void fromMpi() {
+      if (stage.size())
+        Kokkos::deep_copy(array, stage);
+    }
+    //Copies values MPI wrote to [first, first+count) back to the array
+    void fromMpi(int first, int count) {
+      if (stage.size()) {
+        const Kokkos::pair<int, int> range(first, first + count);
+        Kokkos::deep_copy(Kokkos::subview(array, range), Kokkos::subview(stage, range));
+      }
+    }
+  private:
+    DeviceView array;
+    StageView stage;
+  };
+
+  //First value of chunk c of a field split into nchunks chunks
+  inline int chunkStart(int length, int nchunks, int c) {
+    return (long)length * c / nchunks;
+  }
+
   template <class T>
   void Mesh::gatherField(int dim, Omega_h::Write<T>& major, Omega_h::Read<T> minor,
                          PartitionLevel start_level, PartitionLevel end_level) {
-    if (start_level <= TORODIAL && end_level >= GROUP) {
-      Omega_h::HostWrite<T> major_host(major);
-      Omega_h::HostRead<T> minor_host(minor);
-      //Reduce to group leader
-      if (start_level <= GROUP && end_level >= GROUP) {
-        if(isGroupLeader())
-          MPI_Reduce(MPI_IN_PLACE, major_host.data(), major_host.size(), MpiTraits<T>::datatype(),
-                     MPI_SUM, groupLeader(), groupComm());
-        else
-          MPI_Reduce(major_host.data(), major_host.data(), major_host.size(),
-                     MpiTraits<T>::datatype(), MPI_SUM, groupLeader(), groupComm());
+    const bool group = start_level <= GROUP && end_level >= GROUP;
+    const bool torodial = start_level <= TORODIAL && end_level >= TORODIAL && isGroupLeader();
+    if (group || torodial) {
+      MPI_Datatype mpi_type = MpiTraits<T>::datatype();
+      const int length = major.size();
+      const int nchunks = fieldChunks(length);
+      MpiField<T> major_mpi(major.data(), length);
+      major_mpi.toMpi();
+      MpiField<const T> minor_mpi(minor.data(), torodial ? minor.size() : 0);
+      Omega_h::Write<T> major_recv(torodial ? length : 0, "major_recv");
+      MpiField<T> recv_mpi(major_recv.data(), major_recv.size());
+      if (torodial)
+        minor_mpi.toMpi();
+      //Post both levels of every chunk, request c of each level belongs to chunk c
+      std::vector<MPI_Request> reduce_reqs(nchunks, MPI_REQUEST_NULL);
+      std::vector<MPI_Request> recv_reqs(nchunks, MPI_REQUEST_NULL);
+      std::vector<MPI_Request> send_reqs(nchunks, MPI_REQUEST_NULL);
+      for (int c = 0; c < nchunks; ++c) {
+        const int first = chunkStart(length, nchunks, c);
+        const int count = chunkStart(length, nchunks, c + 1) - first;
+        //Reduce to group leader
+        if (group) {
+          T* chunk = major_mpi.data() + first;
+          MPI_Ireduce(isGroupLeader() ? MPI_IN_PLACE : chunk, chunk, count, mpi_type, MPI_SUM,
+                      groupLeader(), groupComm(), &reduce_reqs[c]);
+        }
+        //Send minor contributions to neighbor and recv the neighbor's for the major plane
+        if (torodial) {
+          MPI_Isend(minor_mpi.data() + first, count, mpi_type, torodialMinorNeighbor(), c,
+                    torodialComm(), &send_reqs[c]);
+          MPI_Irecv(recv_mpi.data() + first, count, mpi_type, torodialMajorNeighbor(), c,
+                    torodialComm(), &recv_reqs[c]);
+        }
       }
-      //Send minor contributions to neighbor and recv to major plane
-      if (start_level <= TORODIAL && end_level >= TORODIAL && isGroupLeader()) {
-        MPI_Request minor_req, major_req;
-        MPI_Isend(minor_host.data(), minor_host.size(), MpiTraits<T>::datatype(),
-                  torodialMinorNeighbor(), 0, torodialComm(), &minor_req);
-        Omega_h::HostWrite<T> major_recv(major_host.size(), "major_recv");
-        MPI_Irecv(major_recv.data(), major_recv.size(), MpiTraits<T>::datatype(),
-                  torodialMajorNeighbor(), 0, torodialComm(), &major_req);
-        MPI_Status minor_stat, major_stat;
-        MPI_Wait(&major_req, &major_stat);
-
-        //??? Is it worth moving the data to the device to sum?
-        for (int i = 0; i < major_recv.size(); ++i)
-          major_host[i] += major_recv[i];
-        MPI_Wait(&minor_req, &minor_stat);
+      //Sum each chunk while the later chunks are in flight
+      if (isGroupLeader()) {
+        Omega_h::Write<T> major_local = major;
+        for (int c = 0; c < nchunks; ++c) {
+          const int first = chunkStart(length, nchunks, c);
+          const int count = chunkStart(length, nchunks, c + 1) - first;
+          MPI_Wait(&reduce_reqs[c], MPI_STATUS_IGNORE);
+          MPI_Wait(&recv_reqs[c], MPI_STATUS_IGNORE);
+          major_mpi.fromMpi(first, count);
+          if (!torodial)
+            continue;
+          recv_mpi.fromMpi(first, count);
+          auto sumMinor = OMEGA_H_LAMBDA(const Omega_h::LO i) {
+            major_local[first + i] += major_recv[first + i];
+          };
+          Omega_h::parallel_for(count, sumMinor, "torodial_gather");
+        }
       }
-      major = Omega_h::Write<T>(major_host);
+      MPI_Waitall(nchunks, reduce_reqs.data(), MPI_STATUSES_IGNORE);
+      MPI_Waitall(nchunks, send_reqs.data(), MPI_STATUSES_IGNORE);
     }
     //Perform mesh reduce on mesh for each plane
     if (start_level <= MESH && end_level >= MESH && isGroupLeader()) {
@@ -222,34 +365,79 @@ namespace xgcp {
     if (start_level >= MESH && end_level <= MESH && isGroupLeader()) {
       picparts->reduceCommArray(0, pumipic::Mesh::BCAST_OP, major);
     }
-    if (start_level >= GROUP && end_level <= TORODIAL) {
-      Omega_h::HostWrite<T> major_host(major);
-      Omega_h::HostWrite<T> minor_host(minor);
-      //Send major contributions to neighbor and recv to minor plane
-      if (start_level >= TORODIAL && end_level <= TORODIAL && isGroupLeader()) {
-        MPI_Request minor_req, major_req;
-        MPI_Isend(major_host.data(), major_host.size(), MpiTraits<T>::datatype(),
-                  torodialMajorNeighbor(), 0, torodialComm(), &major_req);
-        Omega_h::HostWrite<T> minor_recv(minor_host.size(), "minor_recv");
-        MPI_Irecv(minor_recv.data(), minor_recv.size(), MpiTraits<T>::datatype(),
-                  torodialMinorNeighbor(), 0, torodialComm(), &minor_req);
-        MPI_Status minor_stat, major_stat;
-        MPI_Wait(&minor_req, &minor_stat);
-
-        //??? Is it worth moving the data to the device to set values?
-        for (int i = 0; i < minor_recv.size(); ++i)
-          minor_host[i] = minor_recv[i];
-        MPI_Wait(&major_req, &major_stat);
+    const bool torodial = start_level >= TORODIAL && end_level <= TORODIAL && isGroupLeader();
+    const bool group = end_level <= GROUP;
+    if (!torodial && !group)
+      return;
+    MPI_Datatype mpi_type = MpiTraits<T>::datatype();
+    const int length = major.size();
+    const int nchunks = fieldChunks(length);
+    //Chunk c of the broadcast holds the major then the minor plane values of the chunk
+    Omega_h::Write<T> planes(group ? 2 * length : 0, "scatter_planes");
+    MpiField<T> planes_mpi(planes.data(), planes.size());
+    MpiField<T> major_mpi(major.data(), torodial ? length : 0);
+    MpiField<T> minor_mpi(minor.data(), torodial && !group ? length : 0);
+    Omega_h::Write<T> major_local = major;
+    Omega_h::Write<T> minor_local = minor;
+    if (group && isGroupLeader()) {
+      const bool pack_minor = !torodial;
+      for (int c = 0; c < nchunks; ++c) {
+        const int first = chunkStart(length, nchunks, c);
+        const int count = chunkStart(length, nchunks, c + 1) - first;
+        auto packPlanes = OMEGA_H_LAMBDA(const Omega_h::LO i) {
+          planes[2 * first + i] = major_local[first + i];
+          if (pack_minor)
+            planes[2 * first + count + i] = minor_local[first + i];
+        };
+        Omega_h::parallel_for(count, packPlanes, "pack_planes");
       }
-      if (start_level >= GROUP && end_level <= GROUP) {
-        MPI_Bcast(minor_host.data(), minor_host.size(), MpiTraits<T>::datatype(),
-                  groupLeader(), groupComm());
-        MPI_Bcast(major_host.data(), major_host.size(), MpiTraits<T>::datatype(),
-                  groupLeader(), groupComm());
-
+      planes_mpi.toMpi();
+    }
+    //Send major contributions to neighbor and recv to minor plane (or its broadcast slots)
+    std::vector<MPI_Request> send_reqs(nchunks, MPI_REQUEST_NULL);
+    std::vector<MPI_Request> recv_reqs(nchunks, MPI_REQUEST_NULL);
+    std::vector<MPI_Request> bcast_reqs(nchunks, MPI_REQUEST_NULL);
+    if (torodial) {
+      major_mpi.toMpi();
+      for (int c = 0; c < nchunks; ++c) {
+        const int first = chunkStart(length, nchunks, c);
+        const int count = chunkStart(length, nchunks, c + 1) - first;
+        T* recv = group ? planes_mpi.data() + 2 * first + count : minor_mpi.data() + first;
+        MPI_Isend(major_mpi.data() + first, count, mpi_type, torodialMajorNeighbor(), c,
+                  torodialComm(), &send_reqs[c]);
+        MPI_Irecv(recv, count, mpi_type, torodialMinorNeighbor(), c, torodialComm(),
+                  &recv_reqs[c]);
       }
-      minor = Omega_h::Write<T>(minor_host);
-      major = Omega_h::Write<T>(major_host);
+    }
+    //Broadcast each chunk once its minor plane values arrived
+    for (int c = 0; c < nchunks; ++c) {
+      MPI_Wait(&recv_reqs[c], MPI_STATUS_IGNORE);
+      if (!group)
+        continue;
+      const int first = chunkStart(length, nchunks, c);
+      const int count = chunkStart(length, nchunks, c + 1) - first;
+      MPI_Ibcast(planes_mpi.data() + 2 * first, 2 * count, mpi_type, groupLeader(),
+                 groupComm(), &bcast_reqs[c]);
+    }
+    MPI_Waitall(nchunks, bcast_reqs.data(), MPI_STATUSES_IGNORE);
+    MPI_Waitall(nchunks, send_reqs.data(), MPI_STATUSES_IGNORE);
+    if (!group) {
+      minor_mpi.fromMpi();
+      return;
+    }
+    //The leader only takes the minor plane values it received
+    planes_mpi.fromMpi();
+    const bool unpack_major = !isGroupLeader();
+    const bool unpack_minor = !isGroupLeader() || torodial;
+    for (int c = 0; c < nchunks && unpack_minor; ++c) {
+      const int first = chunkStart(length, nchunks, c);
+      const int count = chunkStart(length, nchunks, c + 1) - first;
+      auto unpackPlanes = OMEGA_H_LAMBDA(const Omega_h::LO i) {
+        if (unpack_major)
+          major_local[first + i] = planes[2 * first + i];
+        minor_local[first + i] = planes[2 * first + count + i];
+      };
+      Omega_h::parallel_for(count, unpackPlanes, "unpack_planes");
     }
   }
 }
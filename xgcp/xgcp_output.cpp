@@ -0,0 +1,95 @@
+#include "xgcp_output.hpp"
+#include <cstdio>
+#include <sstream>
+
+namespace {
+  const char output_magic[8] = {'X', 'G', 'C', 'P', 'O', 'U', 'T', '\0'};
+  const int output_version = 1;
+
+  template <typename T>
+  bool writeValues(FILE* file, const std::vector<T>& values, int count) {
+    return count == 0 || fwrite(values.data(), sizeof(T), count, file) == (std::size_t)count;
+  }
+
+  void writeSnapshot(xgcp::OutputWriter::Snapshot* snapshot) {
+    FILE* file = fopen(snapshot->filename.c_str(), "wb");
+    if (!file) {
+      fprintf(stderr, "[WARNING] Cannot write output %s\n", snapshot->filename.c_str());
+      delete snapshot;
+      return;
+    }
+    const int nverts = snapshot->major.size();
+    const int nptcls = snapshot->ids.size();
+    const bool success = fwrite(output_magic, 1, 8, file) == 8 &&
+      fwrite(&output_version, sizeof(int), 1, file) == 1 &&
+      fwrite(snapshot->header, sizeof(int), 4, file) == 4 &&
+      fwrite(&nverts, sizeof(int), 1, file) == 1 &&
+      writeValues(file, snapshot->major, nverts) &&
+      writeValues(file, snapshot->minor, nverts) &&
+      fwrite(&nptcls, sizeof(int), 1, file) == 1 &&
+      writeValues(file, snapshot->coords, 3 * nptcls) &&
+      writeValues(file, snapshot->ids, nptcls);
+    fclose(file);
+    if (!success)
+      fprintf(stderr, "[WARNING] Failed writing output %s\n", snapshot->filename.c_str());
+    delete snapshot;
+  }
+}
+
+namespace xgcp {
+  OutputWriter::OutputWriter(Mesh& m, const char* dir, int particle_stride) :
+    mesh(m), directory(dir), stride(particle_stride) {}
+
+  void OutputWriter::wait() {
+    if (writer.joinable())
+      writer.join();
+  }
+
+  void OutputWriter::write(int step, PS_I* ptcls) {
+    Kokkos::Profiling::pushRegion("xgcp_output_snapshot");
+    wait();
+    Snapshot* snapshot = new Snapshot;
+    std::stringstream ss;
+    ss << directory << "/step_" << step << "_" << mesh.worldRank() << ".xgo";
+    snapshot->filename = ss.str();
+    snapshot->header[0] = step;
+    snapshot->header[1] = mesh.torodialRank();
+    snapshot->header[2] = mesh.meshRank();
+    snapshot->header[3] = mesh.groupRank();
+
+    if (mesh.isGroupLeader()) {
+      Mesh::GyroField major_plane, minor_plane;
+      mesh.getGyroFields(major_plane, minor_plane);
+      o::HostRead<o::Real> major_h(major_plane), minor_h(minor_plane);
+      snapshot->major.assign(major_h.data(), major_h.data() + major_h.size());
+      snapshot->minor.assign(minor_h.data(), minor_h.data() + minor_h.size());
+    }
+
+    if (ptcls && stride > 0) {
+      //Compact the sampled particles on the device before copying them
+      const int sample_stride = stride;
+      const auto capacity = ptcls->capacity();
+      auto x = ptcls->get<PTCL_COORDS>();
+      auto pids = ptcls->get<PTCL_IDS>();
+      Kokkos::View<fp_t*> coords_d("output_coords", 3 * capacity);
+      Kokkos::View<int*> ids_d("output_ids", capacity);
+      Kokkos::View<int*> count_d("output_count", 1);
+      auto sample = PS_LAMBDA(const int& e, const int& p, const int& mask) {
+        if (mask && pids(p) % sample_stride == 0) {
+          const int index = Kokkos::atomic_fetch_add(&(count_d(0)), 1);
+          ids_d(index) = pids(p);
+          for (int i = 0; i < 3; ++i)
+            coords_d(3 * index + i) = x(p,i);
+        }
+      };
+      ps::parallel_for(ptcls, sample, "output_sample");
+      const int count = ps::getLastValue<int>(count_d);
+      auto coords_h = Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace(), coords_d);
+      auto ids_h = Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace(), ids_d);
+      snapshot->coords.assign(coords_h.data(), coords_h.data() + 3 * count);
+      snapshot->ids.assign(ids_h.data(), ids_h.data() + count);
+    }
+    writer = std::thread(writeSnapshot, snapshot);
+    Kokkos::Profiling::popRegion();
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "xgcp_types.hpp"
+#include "xgcp_mesh.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace xgcp {
+  /* Periodic output written off of the compute timeline
+
+     write(step, ptcls) copies the gyro fields of the mesh and a sample of the particles to
+     a host staging buffer, then writes them on a helper thread to
+       <directory>/step_<step>_<world rank>.xgo
+     The next write (or wait) first waits for the file of the previous step, so at most
+     one snapshot is held besides the one being taken.
+
+     File layout (native byte order)
+       8 bytes - "XGCPOUT\0", int32 - version, int32 x 4 - step, torodial, mesh and group rank
+       int32 - vertices then the major and minor plane fields (doubles), only written by the
+               group leader since the members of a group hold the same fields (0 otherwise)
+       int32 - particles then their coordinates (3 doubles each) and ids (int32)
+
+     Usage:
+       OutputWriter output(mesh, "output", 100);
+       for (int step = 0; ...; ++step) {
+         ...
+         if (step % period == 0)
+           output.write(step, ptcls);
+       }
+  */
+  class OutputWriter {
+  public:
+    /* directory - existing directory of the files
+       particle_stride - particles with an id that is a multiple of the stride are written,
+                         0 writes no particles
+    */
+    OutputWriter(Mesh& mesh, const char* directory, int particle_stride = 0);
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+    ~OutputWriter() {wait();}
+
+    //Snapshots the fields and the particle sample, ptcls may be NULL
+    void write(int step, PS_I* ptcls = NULL);
+    //Waits for the file being written
+    void wait();
+
+    //Host copy of one step
+    struct Snapshot {
+      std::string filename;
+      int header[4];
+      std::vector<double> major, minor;
+      std::vector<double> coords;
+      std::vector<int> ids;
+    };
+  private:
+    Mesh& mesh;
+    std::string directory;
+    int stride;
+    std::thread writer;
+  };
+}
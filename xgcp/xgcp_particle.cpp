@@ -6,28 +6,51 @@
 #define PARTICLE_SEED 512*512
 
 namespace xgcp {
-  void setInitialPtclCoords(Mesh& m, PS_I* ptcls);
-  void setPtclIds(PS_I* ptcls);
+  template <class PS>
+  void setInitialPtclCoords(Mesh& m, PS* ptcls);
+  template <class PS>
+  void setPtclIds(PS* ptcls);
 
   PS_I* initializeIons(Mesh& m, ps::gid_t nPtcls, PS_I::kkLidView ptcls_per_elem,
                        PS_I::kkGidView element_gids) {
     ps::lid_t nElems = m.nelems();
     //TODO: Read PS parameters from some input source
-    //'sigma', 'V', and the 'policy' control the layout of the PS structure
-    //in memory and can be ignored until performance is being evaluated.  These
-    //are reasonable initial settings for OpenMP.
+    //'sigma' and 'V' control the layout of the PS structure in memory and can be
+    //ignored until performance is being evaluated.  These are reasonable initial
+    //settings. The team policy is chosen for the backend (see recommendedPolicy).
 
     const int sigma = INT_MAX; // full sorting
     const int V = 1024;
-    Kokkos::TeamPolicy<PS_I::execution_space> policy(10000, 32);
-    PS_I* ptcls = new ps::SellCSigma<Ion>(policy, sigma, V, nElems, nPtcls,
-                                          ptcls_per_elem, element_gids);
+    //Particles move between mesh parts and torodial sections, so migrate over the world
+    ps::SellCSigma<Ion>* ptcls = new ps::SellCSigma<Ion>(sigma, V, nElems, nPtcls,
+                                                         ptcls_per_elem, element_gids,
+                                                         PS_I::kkLidView(), NULL,
+                                                         m.worldComm());
+    if (m.hierarchicalMigration())
+      ptcls->setMigrationNeighbors(m.migrationNeighbors());
     setInitialPtclCoords(m, ptcls);
     setPtclIds(ptcls);
     return ptcls;
   }
 
-  void setInitialPtclCoords(Mesh& m, PS_I* ptcls) {
+  PS_E* initializeElectrons(Mesh& m, ps::gid_t nPtcls, PS_E::kkLidView ptcls_per_elem,
+                            PS_E::kkGidView element_gids) {
+    ps::lid_t nElems = m.nelems();
+    //Same layout as the ions, see initializeIons
+    const int sigma = INT_MAX;
+    const int V = 1024;
+    ps::SellCSigma<Electron>* ptcls =
+      new ps::SellCSigma<Electron>(sigma, V, nElems, nPtcls, ptcls_per_elem,
+                                   element_gids, PS_E::kkLidView(), NULL, m.worldComm());
+    if (m.hierarchicalMigration())
+      ptcls->setMigrationNeighbors(m.migrationNeighbors());
+    setInitialPtclCoords(m, ptcls);
+    setPtclIds(ptcls);
+    return ptcls;
+  }
+
+  template <class PS>
+  void setInitialPtclCoords(Mesh& m, PS* ptcls) {
     //Randomly distrubite particles within each element (uniformly within the element)
     //Create a deterministic generation of random numbers on the host with 3 number per particle
     //Use comm rank to make each process different
@@ -57,7 +80,7 @@ namespace xgcp {
     auto cells2nodes = m->get_adj(o::FACE, o::VERT).ab2b;
     auto nodes2coords = m->coords();
     //set particle positions and parent element ids
-    auto x_ps_d = ptcls->get<PTCL_COORDS>();
+    auto x_ps_d = ptcls->template get<PTCL_COORDS>();
     auto lamb = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
       if(mask > 0) {
         auto elmVerts = o::gather_verts<3>(cells2nodes, o::LO(e));
@@ -77,8 +100,9 @@ namespace xgcp {
     ps::parallel_for(ptcls, lamb);
   }
 
-  void setPtclIds(PS_I* ptcls) {
-    auto pid_d = ptcls->get<PTCL_IDS>();
+  template <class PS>
+  void setPtclIds(PS* ptcls) {
+    auto pid_d = ptcls->template get<PTCL_IDS>();
     auto setIDs = PS_LAMBDA(const int& eid, const int& pid, const bool& mask) {
       pid_d(pid) = pid;
     };
@@ -3,9 +3,9 @@
 #include "xgcp_mesh.hpp"
 #include <pumipic_adjacency.hpp>
 namespace xgcp {
-  //Get the total number of particles across all processes
+  //Get the total number of particles across all processes of comm
   template <class PS>
-  ps::gid_t getGlobalParticleCount(PS* ptcls);
+  ps::gid_t getGlobalParticleCount(PS* ptcls, MPI_Comm comm = MPI_COMM_WORLD);
 
   /* Create the particle structure of ions and set initial values
      m - the XGCp mesh
@@ -16,15 +16,60 @@ namespace xgcp {
   PS_I* initializeIons(Mesh& m, ps::gid_t nPtcls, PS_I::kkLidView ptcls_per_elem,
                        PS_I::kkGidView element_gids);
   /* Create the particle structure of electrons and set initial values
-     TODO
+     m - the XGCp mesh
+     nPtcls - number of particles
+     ptcls_per_elem - number of particles in each mesh elements
+     element_gids - global IDs of mesh elements
   */
-  PS_E* initializeElectrons();
+  PS_E* initializeElectrons(Mesh& m, ps::gid_t nPtcls, PS_E::kkLidView ptcls_per_elem,
+                            PS_E::kkGidView element_gids);
 
   /* Performs adjacency search and migrates/rebuilds the particle structure
 
    */
   template <typename PS>
   void search(Mesh& mesh, PS_I* ptcls);
+  /* Search with a context reused across steps
+       context - search context of the picpart, its stayed flags (see
+                 ellipticalPush::pushFused) are used and cleared
+   */
+  template <typename PS>
+  void search(Mesh& mesh, PS* ptcls, p::SearchContext& context);
+
+  /* State of a search between searchBegin and searchEnd
+       The migration of SellCSigma structures is posted with migrate_begin and completed in
+       searchEnd, so the communication overlaps the work done in between (see Pipeline).
+       Other structures and hierarchical migration migrate in searchBegin.
+   */
+  template <typename PS>
+  class SearchHandle {
+  public:
+    typedef ps::SellCSigma<typename PS::Types> SCS;
+    SearchHandle() : scs(NULL), migrated_unsafe(true), active(false) {}
+    //True between searchBegin and searchEnd
+    bool isActive() const {return active;}
+  private:
+    template <typename T>
+    friend void searchBegin(Mesh&, T*, p::SearchContext&, SearchHandle<T>&);
+    template <typename T>
+    friend void searchEnd(Mesh&, T*, SearchHandle<T>&);
+    SCS* scs;
+    typename SCS::MigrateHandle migration;
+    bool migrated_unsafe;
+    bool active;
+  };
+
+  /* Two phase search to overlap the migration with other work
+       searchBegin - searches and starts the migration of the particles
+       searchEnd - completes the migration and checks the placement like migrate
+     search(mesh, ptcls, context) is searchBegin immediately followed by searchEnd
+     Note: the structure must not be changed between the two calls, see migrate_begin
+   */
+  template <typename PS>
+  void searchBegin(Mesh& mesh, PS* ptcls, p::SearchContext& context,
+                   SearchHandle<PS>& handle);
+  template <typename PS>
+  void searchEnd(Mesh& mesh, PS* ptcls, SearchHandle<PS>& handle);
 
   /* Migrate particles and rebuild particle structure
 
@@ -32,80 +77,231 @@ namespace xgcp {
   template <typename PS>
   void rebuild(Mesh& mesh, PS* ptcls, o::LOs elem_ids);
 
+  //True if a particle in elm migrates to the owner of elm, see Input::setMigrationPolicy
+  OMEGA_H_INLINE bool leavesPicpart(const o::LOs& is_safe, const o::LOs& distance,
+                                    o::LO elm, bool migrate_all, int layers) {
+    return elm >= 0 && !is_safe[elm] &&
+      (migrate_all || (distance[elm] >= 0 && distance[elm] < layers));
+  }
+
+  /* Sets the migrate inputs of an ion from the element its search finished in
+
+     The mesh rank is the owner of unsafe elements, the torodial rank follows the
+     destination angle. The destination becomes the particle position (x = xtgt, xtgt = 0).
+     Unless migrate_unsafe is set, only unsafe elements within the migration layers of the
+     edge of the buffer send particles to their owner.
+   */
+  struct IonTargets {
+    IonTargets(Mesh& mesh, PS_I* ptcls, PS_I::kkLidView new_elem, PS_I::kkLidView new_proc,
+               bool migrate_unsafe = true) :
+      new_element(new_elem), new_process(new_proc),
+      is_safe(mesh.pumipicMesh()->safeTag()),
+      owners(mesh.pumipicMesh()->entOwners(mesh.pumipicMesh()->dim())),
+      distance(mesh.pumipicMesh()->bufferDistance()),
+      x(ptcls->get<PTCL_COORDS>()), xtgt(ptcls->get<PTCL_TARGET>()),
+      migrate_all(migrate_unsafe), layers(mesh.migrationLayers()),
+      mr(mesh.meshRank()), gr(mesh.groupRank()), ms(mesh.meshSize()),
+      gs(mesh.groupSize()), ts(mesh.torodialSize()), nplanes(mesh.nplanes()) {}
+
+    OMEGA_H_DEVICE void operator()(const o::LO pid, const o::LO elm) const {
+      new_element(pid) = elm;
+      for (int i = 0; i < 3; ++i) {
+        x(pid,i) = xtgt(pid,i);
+        xtgt(pid,i) = 0;
+      }
+      const bool leave = leavesPicpart(is_safe, distance, elm, migrate_all, layers);
+      const int mesh_rank = leave ? owners[elm] : mr;
+      const int torodial_rank = x(pid,2) * nplanes / (2 * M_PI);
+      new_process(pid) = getWorldRank(torodial_rank, mesh_rank, gr, ts, ms, gs);
+    }
+
+    PS_I::kkLidView new_element;
+    PS_I::kkLidView new_process;
+    o::LOs is_safe;
+    o::LOs owners;
+    o::LOs distance;
+    p::Segment3d x;
+    p::Segment3d xtgt;
+    bool migrate_all;
+    int layers;
+    int mr, gr, ms, gs, ts, nplanes;
+  };
+
+  /* Ends an electron substep in the element the search finished in
+
+     The destination becomes the particle position (x = xtgt, xtgt = 0). Electrons that
+     reach an unsafe element or leave the domain are stopped for the rest of the ion step.
+   */
+  struct ElectronSubstep {
+    ElectronSubstep(Mesh& mesh, PS_E* ptcls, o::Write<o::LO> stop) :
+      stopped(stop), is_safe(mesh.pumipicMesh()->safeTag()),
+      x(ptcls->get<PTCL_COORDS>()), xtgt(ptcls->get<PTCL_TARGET>()) {}
+
+    OMEGA_H_DEVICE void operator()(const o::LO pid, const o::LO elm) const {
+      for (int i = 0; i < 3; ++i) {
+        x(pid,i) = xtgt(pid,i);
+        xtgt(pid,i) = 0;
+      }
+      if (elm < 0 || !is_safe[elm])
+        stopped[pid] = 1;
+    }
+
+    o::Write<o::LO> stopped;
+    o::LOs is_safe;
+    p::Segment3d x;
+    p::Segment3d xtgt;
+  };
+
+  /* Advances electrons num_substeps pushes in one ion step and migrates them once
+       search - search context of the picpart, reused by every substep
+       push(substep) - sets PTCL_TARGET of every electron from PTCL_COORDS
+
+     Electrons stay in their slots of the particle structure during the substeps. Each
+     substep searches from the element the previous substep reached, so only the element
+     changes are tracked. Electrons that reach an unsafe element are held there for the
+     remaining substeps, so they never leave the buffer of the picpart. After the last
+     substep, the electrons in unsafe elements migrate to the owner, those that changed
+     torodial section go to the rank of their new section, and the structure is rebuilt.
+   */
+  template <class Push>
+  void subcycleElectrons(Mesh& mesh, PS_E* ptcls, p::SearchContext& search,
+                         int num_substeps, Push push);
+
+  /* Migrate particles with the gathered elements/processes and check their placement
+       migrated_unsafe - false when particles were allowed to stay in unsafe elements
+   */
+  template <typename PS>
+  void migrate(Mesh& mesh, PS* ptcls, PS_I::kkLidView ps_elem_ids,
+               PS_I::kkLidView ps_process_ids, bool migrated_unsafe = true);
+  //Reports the particles outside of the torodial section or in unsafe elements
+  template <typename PS>
+  void checkMigration(Mesh& mesh, PS* ptcls, bool migrated_unsafe = true);
+
+  /* Evens out the particle counts of the processes of the group in one migration
+     The members of a group hold the same picpart and plane, so particles keep their
+     element. Processes above the average send their extra particles to the processes
+     below it, matched in group rank order.
+     Note: this is a collective call over the world, the processes outside of the group
+           take part in the migration of the particle structure
+   */
+  template <typename PS>
+  void balanceGroup(Mesh& mesh, PS* ptcls);
+
+  /* Migrate particles in the torodial then mesh stages of Input::setHierarchicalMigration
+       ps_elem_ids - the new element of each particle
+       migrated_unsafe - see migrate
+     The processes of the particles are recomputed for each stage from their torodial angle
+     and element. One world reduction finds the number of torodial stages, each stage is
+     an exchange with the migration neighbors only.
+   Tradeoff: every stage is a full migrate, so a step moving particles across n planes
+     costs n+1 exchanges and rebuilds and the reduction, where the direct migration costs
+     one exchange and one rebuild. In return each process only exchanges with its two
+     torodial neighbors and the owners of its buffered elements instead of any process of
+     the world. It pays off when the world is large and particles cross few planes per
+     step, bench_xgcp_migrate compares both on a mesh.
+   */
+  template <typename PS>
+  void migrateHierarchical(Mesh& mesh, PS* ptcls, PS_I::kkLidView ps_elem_ids,
+                           bool migrated_unsafe);
+
   template <class PS>
-  ps::gid_t getGlobalParticleCount(PS* ptcls) {
+  ps::gid_t getGlobalParticleCount(PS* ptcls, MPI_Comm comm) {
     ps::gid_t np = ptcls->nPtcls(), total_ptcls;
-    MPI_Allreduce(&np, &total_ptcls, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+    MPI_Allreduce(&np, &total_ptcls, 1, MPI_LONG, MPI_SUM, comm);
     return total_ptcls;
   }
 
   template <typename PS>
   void search(Mesh& mesh, PS* ptcls) {
+    p::SearchContext context(*(mesh.omegaMesh()));
+    search(mesh, ptcls, context);
+  }
+
+  template <typename PS>
+  void search(Mesh& mesh, PS* ptcls, p::SearchContext& context) {
+    SearchHandle<PS> handle;
+    searchBegin(mesh, ptcls, context, handle);
+    searchEnd(mesh, ptcls, handle);
+  }
+
+  template <typename PS>
+  void searchBegin(Mesh& mesh, PS* ptcls, p::SearchContext& context,
+                   SearchHandle<PS>& handle) {
+    if (handle.active) {
+      fprintf(stderr, "[ERROR] searchBegin called with a search in flight\n");
+      return;
+    }
     Omega_h::LO maxLoops = 200;
     const auto psCapacity = ptcls->capacity();
     o::Write<o::LO> elem_ids(psCapacity, -1);
     auto x_ps_d = ptcls->template get<PTCL_COORDS>();
     auto xtgt_ps_d = ptcls->template get<PTCL_TARGET>();
     auto pid = ptcls->template get<PTCL_IDS>();
-    bool isFound = p::search_mesh_2d(*(mesh.omegaMesh()), ptcls, x_ps_d, xtgt_ps_d,
-                                     pid, elem_ids, maxLoops);
+    //The search gathers the new element and new process of each particle
+    PS_I::kkLidView ps_elem_ids("ps_elem_ids", psCapacity);
+    PS_I::kkLidView ps_process_ids("ps_process_ids", psCapacity);
+    const bool migrate_unsafe = mesh.nextMigrationStep();
+    IonTargets targets(mesh, ptcls, ps_elem_ids, ps_process_ids, migrate_unsafe);
+    //The structure is resolved once so the search kernels are dispatched statically
+    typename SearchHandle<PS>::SCS* scs = dynamic_cast<typename SearchHandle<PS>::SCS*>(ptcls);
+    bool isFound = scs ?
+      p::search_mesh_2d(context, scs, x_ps_d, xtgt_ps_d, pid, elem_ids, maxLoops, targets) :
+      p::search_mesh_2d(context, ptcls, x_ps_d, xtgt_ps_d, pid, elem_ids, maxLoops, targets);
     assert(isFound);
-    rebuild(mesh, ptcls, o::LOs(elem_ids));
+    context.clearStayed();
+    handle.active = true;
+    handle.migrated_unsafe = migrate_unsafe;
+    handle.scs = mesh.hierarchicalMigration() ? NULL : scs;
+    if (handle.scs)
+      handle.migration = handle.scs->migrate_begin(ps_elem_ids, ps_process_ids);
+    else if (mesh.hierarchicalMigration())
+      migrateHierarchical(mesh, ptcls, ps_elem_ids, migrate_unsafe);
+    else
+      ptcls->migrate(ps_elem_ids, ps_process_ids);
   }
 
   template <typename PS>
-  void updatePtclPositions(PS* ptcls) {
-    auto x_ps_d = ptcls->template get<PTCL_COORDS>();
-    auto xtgt_ps_d = ptcls->template get<PTCL_TARGET>();
-    auto updatePtclPos = PS_LAMBDA(const int&, const int& pid, const bool&) {
-      x_ps_d(pid,0) = xtgt_ps_d(pid,0);
-      x_ps_d(pid,1) = xtgt_ps_d(pid,1);
-      x_ps_d(pid,2) = xtgt_ps_d(pid,2);
-      xtgt_ps_d(pid,0) = 0;
-      xtgt_ps_d(pid,1) = 0;
-      xtgt_ps_d(pid,2) = 0;
-    };
-    ps::parallel_for(ptcls, updatePtclPos);
+  void searchEnd(Mesh& mesh, PS* ptcls, SearchHandle<PS>& handle) {
+    if (!handle.active) {
+      fprintf(stderr, "[ERROR] searchEnd called without a search in flight\n");
+      return;
+    }
+    handle.active = false;
+    if (handle.scs && handle.migration.isActive())
+      handle.scs->migrate_end(handle.migration);
+    handle.scs = NULL;
+    checkMigration(mesh, ptcls, handle.migrated_unsafe);
   }
 
   template <typename PS>
   void rebuild(Mesh& mesh, PS* ptcls, o::LOs elem_ids) {
-    p::Mesh* picparts = mesh.pumipicMesh();
-    updatePtclPositions(ptcls);
     const int ps_capacity = ptcls->capacity();
-    auto xs = ptcls->template get<PTCL_COORDS>();
     //Gather new element and new process for migrate/rebuild
     PS_I::kkLidView ps_elem_ids("ps_elem_ids", ps_capacity);
     PS_I::kkLidView ps_process_ids("ps_process_ids", ps_capacity);
-    Omega_h::LOs is_safe = picparts->safeTag();
-    Omega_h::LOs elm_owners = picparts->entOwners(picparts->dim());
-    int comm_rank;
-    MPI_Comm_rank(MPI_COMM_WORLD, &comm_rank);
-    int mr_local = mesh.meshRank();
-    int gr_local = mesh.groupRank();
-    int tr_local = mesh.torodialRank();
-    int ms_local = mesh.meshSize();
-    int gs_local = mesh.groupSize();
-    int ts_local = mesh.torodialSize();
-    int nplanes = mesh.nplanes();
+    IonTargets targets(mesh, ptcls, ps_elem_ids, ps_process_ids);
     auto lamb = PS_LAMBDA(const int& e, const int& pid, const int& mask) {
-      if (mask) {
-        //Gather element
-        int new_elem = elem_ids[pid];
-        ps_elem_ids(pid) = new_elem;
-        //Calculate new process by each process dimension
-        const int mesh_rank = new_elem != -1 ? mr_local : elm_owners[new_elem];
-        const int torodial_rank = xs(pid,2) * nplanes / (2 * M_PI);
-        const int group_rank = gr_local;
-        ps_process_ids(pid) = getWorldRank(torodial_rank, mesh_rank, group_rank,
-                                           ts_local, ms_local, gs_local);
-      }
+      if (mask)
+        targets(pid, elem_ids[pid]);
     };
     ps::parallel_for(ptcls, lamb);
+    migrate(mesh, ptcls, ps_elem_ids, ps_process_ids);
+  }
 
-    ptcls->migrate(ps_elem_ids, ps_process_ids);
+  template <typename PS>
+  void migrate(Mesh& mesh, PS* ptcls, PS_I::kkLidView ps_elem_ids,
+               PS_I::kkLidView ps_process_ids, bool migrated_unsafe) {
+    if (mesh.hierarchicalMigration())
+      migrateHierarchical(mesh, ptcls, ps_elem_ids, migrated_unsafe);
+    else
+      ptcls->migrate(ps_elem_ids, ps_process_ids);
+    checkMigration(mesh, ptcls, migrated_unsafe);
+  }
 
+  template <typename PS>
+  void checkMigration(Mesh& mesh, PS* ptcls, bool migrated_unsafe) {
     //Check to see if particles are all in correct places
+    Omega_h::LOs is_safe = mesh.pumipicMesh()->safeTag();
     fp_t major_phi = mesh.getMajorPlaneAngle();
     fp_t minor_phi = mesh.getMinorPlaneAngle();
     auto coords = ptcls->template get<PTCL_COORDS>();
@@ -113,7 +309,7 @@ namespace xgcp {
     auto checkPtcls = PS_LAMBDA(const int& e, const int& p, const bool& m) {
       if (m) {
         auto pid = pids(p);
-        if (!is_safe[e])
+        if (migrated_unsafe && !is_safe[e])
           printf("Particle %d is in an unsafe element\n", pid);
         if (coords(p,2) < minor_phi || coords(p,2) > major_phi)
           printf("Particle %d is outside torodial section [%f < %f < %f]\n", pid,
@@ -122,4 +318,187 @@ namespace xgcp {
     };
     ps::parallel_for(ptcls, checkPtcls, "check particles");
   }
+
+  template <typename PS>
+  void migrateHierarchical(Mesh& mesh, PS* ptcls, PS_I::kkLidView ps_elem_ids,
+                           bool migrated_unsafe) {
+    Kokkos::Profiling::pushRegion("xgcp_migrateHierarchical");
+    const int tr = mesh.torodialRank(), mr = mesh.meshRank(), gr = mesh.groupRank();
+    const int ts = mesh.torodialSize(), ms = mesh.meshSize(), gs = mesh.groupSize();
+    const int nplanes = mesh.nplanes();
+    const int minor_rank = getWorldRank(mesh.torodialMinorNeighbor(), mr, gr, ts, ms, gs);
+    const int major_rank = getWorldRank(mesh.torodialMajorNeighbor(), mr, gr, ts, ms, gs);
+    const int self = getWorldRank(tr, mr, gr, ts, ms, gs);
+    auto x = ptcls->template get<PTCL_COORDS>();
+
+    //The most planes any particle moves across, the number of torodial stages
+    Kokkos::View<int*> max_hops("max_hops", 1);
+    auto countHops = PS_LAMBDA(const int& e, const int& p, const int& mask) {
+      if (mask && ps_elem_ids(p) >= 0) {
+        const int target = x(p,2) * nplanes / (2 * M_PI);
+        const int forward = (target - tr + ts) % ts;
+        const int hops = forward <= ts - forward ? forward : ts - forward;
+        Kokkos::atomic_fetch_max(&(max_hops(0)), hops);
+      }
+    };
+    ps::parallel_for(ptcls, countHops, "count_torodial_hops");
+    int num_stages = ps::getLastValue<int>(max_hops);
+    MPI_Allreduce(MPI_IN_PLACE, &num_stages, 1, MPI_INT, MPI_MAX, mesh.worldComm());
+
+    //Torodial stages move particles one plane toward their section in the same mesh part
+    for (int s = 0; s < num_stages; ++s) {
+      const auto capacity = ptcls->capacity();
+      PS_I::kkLidView new_elem("torodial_new_elem", capacity);
+      PS_I::kkLidView new_proc("torodial_new_proc", capacity);
+      const bool first = s == 0;
+      auto setTorodial = PS_LAMBDA(const int& e, const int& p, const int& mask) {
+        if (mask) {
+          new_elem(p) = first ? ps_elem_ids(p) : e;
+          const int target = x(p,2) * nplanes / (2 * M_PI);
+          const int forward = (target - tr + ts) % ts;
+          if (forward == 0)
+            new_proc(p) = self;
+          else
+            new_proc(p) = forward <= ts - forward ? major_rank : minor_rank;
+        }
+      };
+      ps::parallel_for(ptcls, setTorodial, "set_torodial_stage");
+      ptcls->migrate(new_elem, new_proc);
+      x = ptcls->template get<PTCL_COORDS>();
+    }
+
+    //The mesh stage moves particles out of unsafe elements on their plane
+    o::LOs is_safe = mesh.pumipicMesh()->safeTag();
+    o::LOs owners = mesh.pumipicMesh()->entOwners(mesh.dim());
+    o::LOs distance = mesh.pumipicMesh()->bufferDistance();
+    const int layers = mesh.migrationLayers();
+    const auto capacity = ptcls->capacity();
+    PS_I::kkLidView new_elem("mesh_new_elem", capacity);
+    PS_I::kkLidView new_proc("mesh_new_proc", capacity);
+    const bool moved = num_stages > 0;
+    auto setMesh = PS_LAMBDA(const int& e, const int& p, const int& mask) {
+      if (mask) {
+        const o::LO elm = moved ? e : ps_elem_ids(p);
+        new_elem(p) = elm;
+        const bool leave = leavesPicpart(is_safe, distance, elm, migrated_unsafe, layers);
+        new_proc(p) = getWorldRank(tr, leave ? owners[elm] : mr, gr, ts, ms, gs);
+      }
+    };
+    ps::parallel_for(ptcls, setMesh, "set_mesh_stage");
+    ptcls->migrate(new_elem, new_proc);
+    Kokkos::Profiling::popRegion();
+  }
+
+  template <typename PS>
+  void balanceGroup(Mesh& mesh, PS* ptcls) {
+    Kokkos::Profiling::pushRegion("xgcp_balanceGroup");
+    const int tr = mesh.torodialRank(), mr = mesh.meshRank(), gr = mesh.groupRank();
+    const int ts = mesh.torodialSize(), ms = mesh.meshSize(), gs = mesh.groupSize();
+    long np = ptcls->nPtcls();
+    std::vector<long> counts(gs);
+    MPI_Allgather(&np, 1, MPI_LONG, counts.data(), 1, MPI_LONG, mesh.groupComm());
+    long total = 0;
+    for (int i = 0; i < gs; ++i)
+      total += counts[i];
+    //The first total % gs processes take one extra particle
+    std::vector<long> excess(gs);
+    for (int i = 0; i < gs; ++i)
+      excess[i] = counts[i] - (total / gs + (i < total % gs));
+
+    //Match senders to receivers in rank order, every process computes the same matching
+    std::vector<int> dests;
+    std::vector<ps::lid_t> send_offsets(1, 0);
+    for (int s = 0, r = 0; s < gs && r < gs;) {
+      if (excess[s] <= 0) {++s; continue;}
+      if (excess[r] >= 0) {++r; continue;}
+      const long num = excess[s] < -excess[r] ? excess[s] : -excess[r];
+      if (s == gr) {
+        dests.push_back(getWorldRank(tr, mr, r, ts, ms, gs));
+        send_offsets.push_back(send_offsets.back() + num);
+      }
+      excess[s] -= num;
+      excess[r] += num;
+    }
+    const int num_dests = dests.size();
+    PS_I::kkLidView dests_d("balance_dests", num_dests);
+    PS_I::kkLidView offsets_d("balance_offsets", num_dests + 1);
+    ps::hostToDevice(dests_d, dests.data());
+    ps::hostToDevice(offsets_d, send_offsets.data());
+
+    //The first particles visited are sent
+    const auto capacity = ptcls->capacity();
+    PS_I::kkLidView new_elem("balance_new_elem", capacity);
+    PS_I::kkLidView new_proc("balance_new_proc", capacity);
+    Kokkos::View<ps::lid_t*> visited("balance_visited", 1);
+    const int self = getWorldRank(tr, mr, gr, ts, ms, gs);
+    auto setTargets = PS_LAMBDA(const int& e, const int& p, const int& mask) {
+      if (mask) {
+        new_elem(p) = e;
+        new_proc(p) = self;
+        if (num_dests > 0) {
+          const ps::lid_t index = Kokkos::atomic_fetch_add(&(visited(0)), 1);
+          for (int i = 0; i < num_dests; ++i)
+            if (index >= offsets_d(i) && index < offsets_d(i + 1))
+              new_proc(p) = dests_d(i);
+        }
+      }
+    };
+    ps::parallel_for(ptcls, setTargets, "balance_targets");
+    ptcls->migrate(new_elem, new_proc);
+    Kokkos::Profiling::popRegion();
+  }
+
+  template <class Push>
+  void subcycleElectrons(Mesh& mesh, PS_E* ptcls, p::SearchContext& search,
+                         int num_substeps, Push push) {
+    Kokkos::Profiling::pushRegion("xgcp_subcycleElectrons");
+    const Omega_h::LO maxLoops = 200;
+    const auto psCapacity = ptcls->capacity();
+    o::Write<o::LO> elem_ids(psCapacity, -1, "electron_elem_ids");
+    o::Write<o::LO> stopped(psCapacity, 0, "electron_stopped");
+    auto x = ptcls->get<PTCL_COORDS>();
+    auto xtgt = ptcls->get<PTCL_TARGET>();
+    auto pid = ptcls->get<PTCL_IDS>();
+    auto setElements = PS_LAMBDA(const int& e, const int& p, const int& mask) {
+      elem_ids[p] = mask ? e : -1;
+    };
+    ps::parallel_for(ptcls, setElements, "electron_elements");
+
+    const bool from_ids = search.startFromElemIds();
+    search.setStartFromElemIds(true);
+    ElectronSubstep finish(mesh, ptcls, stopped);
+    for (int s = 0; s < num_substeps; ++s) {
+      push(s);
+      auto holdStopped = PS_LAMBDA(const int& e, const int& p, const int& mask) {
+        if (mask && stopped[p])
+          for (int i = 0; i < 3; ++i)
+            xtgt(p,i) = x(p,i);
+      };
+      ps::parallel_for(ptcls, holdStopped, "electron_hold_stopped");
+      bool isFound = p::search_mesh_2d(search, ptcls, x, xtgt, pid, elem_ids, maxLoops,
+                                       finish);
+      assert(isFound);
+    }
+    search.setStartFromElemIds(from_ids);
+
+    //Migrate once for all substeps
+    PS_E::kkLidView ps_elem_ids("electron_new_elem", psCapacity);
+    PS_E::kkLidView ps_process_ids("electron_new_process", psCapacity);
+    o::LOs is_safe = mesh.pumipicMesh()->safeTag();
+    o::LOs owners = mesh.pumipicMesh()->entOwners(mesh.dim());
+    const int mr = mesh.meshRank(), gr = mesh.groupRank(), ms = mesh.meshSize();
+    const int gs = mesh.groupSize(), ts = mesh.torodialSize(), nplanes = mesh.nplanes();
+    auto setTargets = PS_LAMBDA(const int& e, const int& p, const int& mask) {
+      if (mask) {
+        const o::LO elm = elem_ids[p];
+        ps_elem_ids(p) = elm;
+        const int mesh_rank = elm >= 0 && !is_safe[elm] ? owners[elm] : mr;
+        const int torodial_rank = x(p,2) * nplanes / (2 * M_PI);
+        ps_process_ids(p) = getWorldRank(torodial_rank, mesh_rank, gr, ts, ms, gs);
+      }
+    };
+    ps::parallel_for(ptcls, setTargets, "electron_targets");
+    migrate(mesh, ptcls, ps_elem_ids, ps_process_ids);
+    Kokkos::Profiling::popRegion();
+  }
 }
@@ -0,0 +1,164 @@
+#include "xgcp_pipeline.hpp"
+#include <RegionTimers.h>
+#include <algorithm>
+#include <mpi.h>
+
+namespace xgcp {
+  Pipeline::Pipeline(int num_lanes) : runs(0), step_time(0), critical_path(0), overlapped(0),
+                                      total_step_time(0), total_critical_path(0),
+                                      total_overlapped(0) {
+    if (num_lanes < 1) {
+      fprintf(stderr, "[WARNING] Pipeline needs at least one lane, using one\n");
+      num_lanes = 1;
+    }
+#ifdef PS_USE_CUDA
+    streams.resize(num_lanes);
+    for (int i = 0; i < num_lanes; ++i) {
+      cudaStreamCreate(&streams[i]);
+      lanes.push_back(execution_space(streams[i]));
+    }
+#else
+    lanes.resize(num_lanes, execution_space());
+#endif
+  }
+
+  Pipeline::~Pipeline() {
+    for (std::size_t i = 0; i < lanes.size(); ++i)
+      lanes[i].fence();
+    lanes.clear();
+#ifdef PS_USE_CUDA
+    for (std::size_t i = 0; i < streams.size(); ++i)
+      cudaStreamDestroy(streams[i]);
+#endif
+  }
+
+  const Pipeline::execution_space& Pipeline::executionSpace(int lane) const {
+    if (lane < 0 || lane >= numLanes()) {
+      fprintf(stderr, "[ERROR] Lane %d is not in [0, %d), using lane 0\n", lane, numLanes());
+      return lanes[0];
+    }
+    return lanes[lane];
+  }
+
+  int Pipeline::addStage(const std::string& name, int lane, Work begin, Work end,
+                         const std::vector<int>& dependencies) {
+    const int index = stages.size();
+    if (!begin) {
+      fprintf(stderr, "[ERROR] Stage %s has no begin\n", name.c_str());
+      return -1;
+    }
+    if (lane < 0 || lane >= numLanes()) {
+      fprintf(stderr, "[ERROR] Lane %d of stage %s is not in [0, %d)\n", lane, name.c_str(),
+              numLanes());
+      return -1;
+    }
+    for (std::size_t i = 0; i < dependencies.size(); ++i) {
+      if (dependencies[i] < 0 || dependencies[i] >= index) {
+        fprintf(stderr, "[ERROR] Dependency %d of stage %s was not added before it\n",
+                dependencies[i], name.c_str());
+        return -1;
+      }
+    }
+    Stage stage;
+    stage.name = name;
+    stage.lane = lane;
+    stage.dependencies = dependencies;
+    stage.begin = begin;
+    stage.end = end;
+    stage.cost = stage.span = stage.total_cost = 0;
+    stages.push_back(stage);
+    return index;
+  }
+
+  void Pipeline::complete(int index) {
+    Stage& stage = stages[index];
+    Kokkos::Profiling::pushRegion("xgcp_pipeline_" + stage.name + "_end");
+    const double start = MPI_Wtime();
+    if (stage.end)
+      stage.end();
+    lanes[stage.lane].fence();
+    const double now = MPI_Wtime();
+    Kokkos::Profiling::popRegion();
+    stage.cost += now - start;
+    stage.span = now - begin_times[index];
+    stage.total_cost += stage.cost;
+    completed[index] = true;
+    ps::addRegionTime("xgcp_pipeline_" + stage.name, stage.cost);
+  }
+
+  void Pipeline::run() {
+    const int n = stages.size();
+    begin_times.assign(n, 0);
+    begun.assign(n, false);
+    completed.assign(n, false);
+    const double step_start = MPI_Wtime();
+    //Stages begun and not completed in the order they began
+    std::vector<int> in_flight;
+    std::size_t next_complete = 0;
+    int num_completed = 0;
+    while (num_completed < n) {
+      bool began = false;
+      for (int i = 0; i < n; ++i) {
+        if (begun[i])
+          continue;
+        bool ready = true;
+        for (std::size_t j = 0; j < stages[i].dependencies.size() && ready; ++j)
+          ready = completed[stages[i].dependencies[j]];
+        if (!ready)
+          continue;
+        Stage& stage = stages[i];
+        Kokkos::Profiling::pushRegion("xgcp_pipeline_" + stage.name + "_begin");
+        begin_times[i] = MPI_Wtime();
+        stage.begin();
+        stage.cost = MPI_Wtime() - begin_times[i];
+        Kokkos::Profiling::popRegion();
+        begun[i] = true;
+        in_flight.push_back(i);
+        began = true;
+      }
+      //Dependencies are added before their stages, so a stage is in flight when none began
+      if (!began) {
+        complete(in_flight[next_complete++]);
+        ++num_completed;
+      }
+    }
+    step_time = MPI_Wtime() - step_start;
+
+    //Longest chain of costs ending at each stage
+    std::vector<double> path(n, 0);
+    critical_path = overlapped = 0;
+    for (int i = 0; i < n; ++i) {
+      double longest = 0;
+      for (std::size_t j = 0; j < stages[i].dependencies.size(); ++j)
+        longest = std::max(longest, path[stages[i].dependencies[j]]);
+      path[i] = longest + stages[i].cost;
+      critical_path = std::max(critical_path, path[i]);
+      overlapped += std::max(0.0, stages[i].span - stages[i].cost);
+    }
+    ++runs;
+    total_step_time += step_time;
+    total_critical_path += critical_path;
+    total_overlapped += overlapped;
+  }
+
+  double Pipeline::criticalFraction() const {
+    return step_time > 0 ? critical_path / step_time : 1;
+  }
+
+  void Pipeline::printTimes(FILE* out) const {
+    fprintf(out, "%-32s %6s %12s %12s %12s\n", "Stage", "Lane", "Cost(s)", "Span(s)",
+            "TotalCost(s)");
+    for (std::size_t i = 0; i < stages.size(); ++i) {
+      const Stage& s = stages[i];
+      fprintf(out, "%-32s %6d %12.6f %12.6f %12.6f\n", s.name.c_str(), s.lane, s.cost,
+              s.span, s.total_cost);
+    }
+    fprintf(out, "%-32s %12s %12s %12s %8s\n", "Pipeline", "Step(s)", "Critical(s)",
+            "Overlap(s)", "Critical");
+    fprintf(out, "%-32s %12.6f %12.6f %12.6f %8.3f\n", "last", step_time, critical_path,
+            overlapped, criticalFraction());
+    fprintf(out, "%-32s %12.6f %12.6f %12.6f %8.3f\n", "total", total_step_time,
+            total_critical_path, total_overlapped,
+            total_step_time > 0 ? total_critical_path / total_step_time : 1);
+  }
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include "xgcp_types.hpp"
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace xgcp {
+  /* Timestep of stages with dependencies that overlaps the independent ones
+
+     A stage has a begin, which launches its work, and an optional end, which completes it.
+     Two phase operations post their communication in begin and wait for it in end, i.e.
+     searchBegin/searchEnd, ps::SellCSigma::migrate_begin/migrate_end and
+     pumipic::Mesh::reduceCommArray_begin/_end. Each stage runs in a lane with its own
+     execution space instance (a CUDA stream on GPUs); give each species a lane and the
+     structure of the species that lane's instance (setExecutionSpace), so its kernels run
+     concurrently with those of the other species. A stage is complete once its end
+     returned and its lane was fenced.
+
+     run() begins every stage whose dependencies completed in the order the stages were
+     added. A stage is only completed when no other stage can begin, the one begun first,
+     so the host launches the work of the other species while the communication and
+     kernels already in flight progress. For example, with
+       ion_push -> ion_search -> ion_scatter    (lane 0)
+       elc_push -> elc_search -> elc_scatter    (lane 1)
+     the ion migration is in flight while the electrons are pushed and searched.
+
+     After each run the times of the stages are kept (see Stage):
+       cost - time in the begin and end of the stage, its end includes the wait for the
+              communication and kernels that were not hidden by other stages
+       span - time from the start of the begin to the completion of the stage
+       critical path - longest dependency chain of stage costs, the step time if every
+                       independent stage overlapped perfectly
+       overlapped - sum over stages of span - cost, the time work of a stage was in flight
+                    while the host ran other stages
+     Usage:
+       Pipeline step(2);
+       ions->setExecutionSpace(step.executionSpace(0));
+       electrons->setExecutionSpace(step.executionSpace(1));
+       SearchHandle<PS_I> ion_search;
+       const int push = step.addStage("ion_push", 0, [&]() {...});
+       step.addStage("ion_search", 0,
+                     [&]() {searchBegin(mesh, ions, ion_context, ion_search);},
+                     [&]() {searchEnd(mesh, ions, ion_search);}, {push});
+       ...
+       for (int i = 0; i < nsteps; ++i)
+         step.run();
+       step.printTimes();
+     Notes:
+       Like any collective, run() begins and completes the stages in the same order on
+         every process as long as every process adds the same stages
+       Stages reading data of another lane must depend on the stage that wrote it
+       Structures that share a BufferPool can not migrate in independent stages
+  */
+  class Pipeline {
+  public:
+    typedef PS_I::execution_space execution_space;
+    typedef std::function<void()> Work;
+
+    struct Stage {
+      std::string name;
+      int lane;
+      std::vector<int> dependencies;
+      Work begin, end;
+      //Times of the last run in seconds
+      double cost, span;
+      //Costs of every run summed
+      double total_cost;
+    };
+
+    //num_lanes - lanes of the stages, each with its own execution space instance
+    Pipeline(int num_lanes = 1);
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+    ~Pipeline();
+
+    int numLanes() const {return lanes.size();}
+    const execution_space& executionSpace(int lane) const;
+
+    /* Adds a stage and returns its index
+         dependencies - indices of stages that complete before this stage begins
+       Note: dependencies must be added before the stage
+    */
+    int addStage(const std::string& name, int lane, Work begin, Work end = Work(),
+                 const std::vector<int>& dependencies = std::vector<int>());
+    int numStages() const {return stages.size();}
+    const Stage& stage(int index) const {return stages[index];}
+
+    //Runs every stage once
+    void run();
+
+    //Times of the last run in seconds
+    double stepTime() const {return step_time;}
+    double criticalPath() const {return critical_path;}
+    double overlappedTime() const {return overlapped;}
+    //Critical path over step time of the last run, 1 when the step is as short as its
+    //  dependencies allow
+    double criticalFraction() const;
+
+    //Times of the stages and the step of the last run and the runs so far
+    void printTimes(FILE* out = stderr) const;
+
+  private:
+    void complete(int index);
+
+    std::vector<execution_space> lanes;
+#ifdef PS_USE_CUDA
+    std::vector<cudaStream_t> streams;
+#endif
+    std::vector<Stage> stages;
+    //State of the run, begin time of each stage and true once it completed
+    std::vector<double> begin_times;
+    std::vector<bool> begun, completed;
+    int runs;
+    double step_time, critical_path, overlapped;
+    double total_step_time, total_critical_path, total_overlapped;
+  };
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "xgcp_types.hpp"
+#include <pumipic_adjacency.hpp>
 
 namespace xgcp {
   //Nonphysical elliptical push that pushes particles in an ellipse shape
@@ -18,5 +19,16 @@ namespace xgcp {
       iter - the iteration number
      */
     void push(PS_I* ptcls, Omega_h::Mesh& m, const double deg, const int iter);
+    /* Push that also tests if each particle stays in its element
+      ps - the particle structure
+      search - search context of m, its stayed flags are set for the next search
+      m - the mesh
+      deg - number of degrees to move around the ellipse
+      iter - the iteration number
+      The step of each element is computed once per push and the ellipse is evaluated
+      in the float precision of ION_B and ION_PHI.
+     */
+    void pushFused(PS_I* ptcls, pumipic::SearchContext& search, Omega_h::Mesh& m,
+                   const double deg, const int iter);
   }
 }